@@ -0,0 +1,81 @@
+// Counts heap traffic of the benchmark process by interposing the glibc
+// allocator entry points. Arenas draw from malloc directly, so hooking
+// operator new alone would miss most of what the core allocates. Counts are
+// per thread so multi-threaded benchmarks do not see each other's traffic.
+
+#include "bench_util.hpp"
+
+#include <cstddef>
+
+extern "C" {
+void* __libc_malloc(std::size_t);
+void* __libc_calloc(std::size_t, std::size_t);
+void* __libc_realloc(void*, std::size_t);
+void* __libc_memalign(std::size_t, std::size_t);
+}
+
+namespace {
+
+thread_local std::uint64_t alloc_count = 0;
+thread_local std::uint64_t alloc_bytes = 0;
+
+inline void note(std::size_t size) noexcept
+{
+    ++alloc_count;
+    alloc_bytes += size;
+}
+
+} // namespace
+
+namespace yeni::bench {
+
+alloc_stats alloc_snapshot() noexcept
+{
+    return {alloc_count, alloc_bytes};
+}
+
+} // namespace yeni::bench
+
+extern "C" {
+
+void* malloc(std::size_t size)
+{
+    note(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size)
+{
+    note(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, std::size_t size)
+{
+    note(size);
+    return __libc_realloc(p, size);
+}
+
+void* aligned_alloc(std::size_t align, std::size_t size)
+{
+    note(size);
+    return __libc_memalign(align, size);
+}
+
+void* memalign(std::size_t align, std::size_t size)
+{
+    note(size);
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void** out, std::size_t align, std::size_t size)
+{
+    note(size);
+    void* p = __libc_memalign(align, size);
+    if (!p)
+        return 12; // ENOMEM
+    *out = p;
+    return 0;
+}
+
+} // extern "C"
@@ -0,0 +1,50 @@
+#include "bench_util.hpp"
+
+#include "yeni/admission.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+namespace {
+
+// One admit() per op: the overload check against two monitors, then the
+// tenant's bucket, out of 1024 tenants that stay within their budget.
+void bm_admit(benchmark::State& state)
+{
+    yeni::codel_monitor ingest_delay, io_delay;
+    yeni::admission_controller ac({.rate = 1'000'000'000, .burst = 1'000'000});
+    ac.watch(ingest_delay);
+    ac.watch(io_delay);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0, admitted = 0, tenant = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1024; ++i)
+            admitted += bool(ac.admit(tenant++ & 1023, 1, t0));
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), 1024);
+        ops += 1024;
+    }
+    probe.finish(ops);
+    benchmark::DoNotOptimize(admitted);
+}
+
+// One observe() per op, each closing no window but the last of its 100 ms.
+void bm_observe(benchmark::State& state)
+{
+    yeni::codel_monitor m;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1024; ++i)
+            m.observe(std::chrono::microseconds(i), t0);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), 1024);
+        ops += 1024;
+    }
+    probe.finish(ops);
+}
+
+BENCHMARK(bm_admit)->Name("admission/admit/1024_tenants")->UseRealTime();
+BENCHMARK(bm_observe)->Name("admission/codel/observe")->UseRealTime();
+
+} // namespace
@@ -0,0 +1,62 @@
+#include "bench_util.hpp"
+
+#include "yeni/bloom_filter.hpp"
+#include "yeni/hash.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Probes for absent keys against a filter over `range(0)` keys; the
+// false-positive rate is reported alongside.
+void bm_bloom_probe(benchmark::State& state, bool simd)
+{
+    if (simd && !yeni::bloom_filter_simd()) {
+        state.SkipWithError("no avx2");
+        return;
+    }
+    const auto n = std::size_t(state.range(0));
+    std::vector<std::uint64_t> keys(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] = 2 * yeni::mix64(i);
+    const std::vector<std::byte> bytes = yeni::bloom_filter::build(keys);
+    const yeni::bloom_filter filter(bytes);
+
+    yeni::bench::probe probe(state);
+    std::uint64_t k = 1, ops = 0, passed = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            const bool hit = simd ? filter.may_contain(k) : filter.may_contain_portable(k);
+            benchmark::DoNotOptimize(hit);
+            passed += hit;
+        });
+        k += 2; // odd, so never one of the keys
+        ++ops;
+    }
+    probe.finish(ops);
+    state.counters["fp_rate"] = double(passed) / double(ops);
+    state.counters["bits_per_key"] = 8.0 * double(filter.size_bytes()) / double(n);
+}
+BENCHMARK_CAPTURE(bm_bloom_probe, simd, true)->Name("bloom/probe/simd")->Arg(1 << 16)->Arg(1 << 22);
+BENCHMARK_CAPTURE(bm_bloom_probe, portable, false)->Name("bloom/probe/portable")->Arg(1 << 16)->Arg(1 << 22);
+
+void bm_bloom_build(benchmark::State& state)
+{
+    const auto n = std::size_t(state.range(0));
+    std::vector<std::uint64_t> keys(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] = yeni::mix64(i);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(yeni::bloom_filter::build(keys));
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), n);
+        ops += n;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_bloom_build)->Name("bloom/build")->Arg(1 << 16)->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,185 @@
+#include "bench_util.hpp"
+
+#include "yeni/btree.hpp"
+#include "yeni/hash.hpp"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t entries = 1 << 20;
+
+// Keys a secondary index on a text column sees: a long shared prefix, then
+// a few distinguishing bytes.
+std::string text_key(std::uint64_t i)
+{
+    return "tenant-0042/orders/" + std::to_string(yeni::mix64(i) % 100'000'000);
+}
+
+std::span<const std::byte> as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+std::vector<std::string> text_keys(std::size_t n, std::uint64_t salt)
+{
+    std::vector<std::string> keys(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] = text_key(i ^ salt);
+    return keys;
+}
+
+void bm_insert(benchmark::State& state)
+{
+    const auto keys = text_keys(entries, 0);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto tree = std::make_unique<yeni::btree_index>();
+        state.ResumeTiming();
+        const auto t0 = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < entries; ++i)
+            tree->insert(as_bytes(keys[i]), i);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            entries);
+        ops += entries;
+        state.counters["bytes_per_key"] = double(tree->node_count() * yeni::btree_index::node_bytes) / double(entries);
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_insert)->Name("btree/insert")->Unit(benchmark::kMillisecond);
+
+// Concurrent inserts of disjoint keys into one tree, which is reset every
+// 2^20 keys.
+void bm_insert_mt(benchmark::State& state)
+{
+    static std::unique_ptr<yeni::btree_index> tree;
+    static std::atomic<std::uint64_t> inserted;
+    if (state.thread_index() == 0) {
+        tree = std::make_unique<yeni::btree_index>();
+        inserted = 0;
+    }
+    yeni::bench::probe probe(state);
+    std::uint64_t next = std::uint64_t(state.thread_index()) << 40, ops = 0;
+    for (auto _ : state) {
+        const std::string key = text_key(next++);
+        probe.measure([&] { tree->insert(as_bytes(key), next); });
+        ++ops;
+    }
+    probe.finish(ops);
+    if (state.thread_index() == 0)
+        tree.reset();
+}
+BENCHMARK(bm_insert_mt)->Name("btree/insert_mt")->Threads(1)->Threads(4)->UseRealTime();
+
+// Point lookups in a tree (in memory or serialized) and, for scale, an
+// ordered std::map; `range(0)` 1 probes present keys, 0 absent ones.
+template <class Tree>
+void bm_find(benchmark::State& state, Tree& tree, const std::vector<std::string>& present)
+{
+    const auto probes = state.range(0) ? present : text_keys(entries, 0x9e3779b97f4a7c15ULL);
+    yeni::bench::probe probe(state);
+    std::size_t i = 0, found = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { found += tree.find(as_bytes(probes[i])).has_value(); });
+        if (++i == probes.size())
+            i = 0;
+        ++ops;
+    }
+    benchmark::DoNotOptimize(found);
+    probe.finish(ops);
+}
+
+struct fixture {
+    std::vector<std::string> keys = text_keys(entries, 0);
+    yeni::btree_index tree;
+    std::vector<std::byte> persisted;
+    yeni::btree_view view;
+
+    fixture()
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            tree.insert(as_bytes(keys[i]), i);
+        persisted = tree.serialize();
+        view = yeni::btree_view(persisted);
+    }
+
+    static fixture& get()
+    {
+        static fixture f;
+        return f;
+    }
+};
+
+void bm_find_memory(benchmark::State& state)
+{
+    auto& f = fixture::get();
+    bm_find(state, f.tree, f.keys);
+    state.counters["height"] = double(f.tree.height());
+}
+BENCHMARK(bm_find_memory)->Name("btree/find")->Arg(1)->Arg(0);
+
+void bm_find_view(benchmark::State& state)
+{
+    auto& f = fixture::get();
+    bm_find(state, f.view, f.keys);
+    state.counters["height"] = double(f.view.height());
+    state.counters["bytes_per_key"] = double(f.persisted.size()) / double(entries);
+}
+BENCHMARK(bm_find_view)->Name("btree_view/find")->Arg(1)->Arg(0);
+
+void bm_find_std_map(benchmark::State& state)
+{
+    static const auto keys = text_keys(entries, 0);
+    static const auto map = [] {
+        std::map<std::string, std::uint64_t, std::less<>> m;
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            m.emplace(keys[i], i);
+        return m;
+    }();
+    struct adapter {
+        const std::map<std::string, std::uint64_t, std::less<>>& m;
+        std::optional<std::uint64_t> find(std::span<const std::byte> k) const
+        {
+            const auto it = m.find(std::string_view(reinterpret_cast<const char*>(k.data()), k.size()));
+            return it == m.end() ? std::nullopt : std::optional(it->second);
+        }
+    } a{map};
+    bm_find(state, a, keys);
+}
+BENCHMARK(bm_find_std_map)->Name("std_map/find")->Arg(1)->Arg(0);
+
+// Secondary-index range query over a u64 column of 2^20 rows with values
+// in [0, 2^20): `range(0)` rows per query on average.
+void bm_secondary_range(benchmark::State& state)
+{
+    static const auto index = [] {
+        auto idx = std::make_unique<yeni::secondary_index<std::uint64_t>>();
+        for (std::uint64_t row = 0; row < entries; ++row)
+            idx->insert(yeni::mix64(row) % entries, row);
+        return idx;
+    }();
+    const auto width = std::uint64_t(state.range(0));
+    yeni::bench::probe probe(state);
+    std::uint64_t q = 0, ops = 0, rows = 0;
+    for (auto _ : state) {
+        const std::uint64_t lo = yeni::mix64(q++) % (entries - width);
+        probe.measure([&] { index->range(lo, lo + width - 1, [&](std::uint64_t, std::uint64_t) { ++rows; }); });
+        ++ops;
+    }
+    probe.finish(ops);
+    state.counters["rows_per_query"] = double(rows) / double(ops);
+}
+BENCHMARK(bm_secondary_range)->Name("btree/secondary_range")->Arg(16)->Arg(1024);
+
+} // namespace
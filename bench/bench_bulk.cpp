@@ -0,0 +1,146 @@
+#include "bench_util.hpp"
+
+#include "yeni/bulk.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/predicate.hpp"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t rows = 1 << 18;
+
+using ct = yeni::segment_format::column_type;
+
+const yeni::schema& order_schema()
+{
+    static const yeni::schema s({{"id", ct::u64}, {"ts", ct::i64}, {"price", ct::f64}, {"qty", ct::u32},
+        {"region", ct::binary}, {"note", ct::binary}});
+    return s;
+}
+
+const std::array<std::string, 6> regions = {"eu-west", "eu-central", "us-east", "us-west", "ap-south", "sa-east"};
+
+// Notes that need quoting in CSV or escaping in JSON now and then.
+const std::array<std::string, 4> notes = {"", "leave at the door", "ring twice, then \"knock\"",
+    "fragile\nthis side up"};
+
+std::span<const std::byte> as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+std::filesystem::path bench_file(yeni::text_format f)
+{
+    return std::filesystem::temp_directory_path()
+        / (f == yeni::text_format::csv ? "yeni_bench_bulk.csv" : "yeni_bench_bulk.ndjson");
+}
+
+void emit_orders(const yeni::bulk_emit& emit)
+{
+    const yeni::schema& s = order_schema();
+    std::vector<yeni::schema::value> values(s.size());
+    std::vector<std::byte> rec;
+    for (std::size_t i = 0; i < rows; ++i) {
+        const std::uint64_t h = yeni::mix64(i);
+        values[0] = std::uint64_t(i);
+        values[1] = std::int64_t(1'700'000'000'000 + i * 7);
+        values[2] = double(h % 100'000) / 100;
+        values[3] = std::uint32_t(1 + h % 50);
+        values[4] = as_bytes(regions[h % regions.size()]);
+        values[5] = as_bytes(notes[(h >> 8) % notes.size()]);
+        s.encode_into(rec, values);
+        emit(rec);
+    }
+}
+
+// The input file for `f`, exported once.
+std::uint64_t prepare(yeni::text_format f)
+{
+    static std::array<std::uint64_t, 2> bytes{};
+    std::uint64_t& b = bytes[std::size_t(f)];
+    if (!b) {
+        yeni::bulk_options o;
+        o.format = f;
+        b = yeni::export_text(bench_file(f), order_schema(), emit_orders, o).bytes;
+    }
+    return b;
+}
+
+// Whole-file import through the pipeline at `level`; one op is one row.
+void bm_import(benchmark::State& state, yeni::text_format f, yeni::simd_level level)
+{
+    const yeni::simd_level saved = yeni::active_simd_level();
+    yeni::set_simd_level(level);
+    if (yeni::active_simd_level() != level) {
+        yeni::set_simd_level(saved);
+        state.SkipWithError("instruction set not supported on this CPU");
+        return;
+    }
+    const std::uint64_t bytes = prepare(f);
+    yeni::bulk_options o;
+    o.format = f;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        std::uint64_t seen = 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        yeni::import_text(bench_file(f), order_schema(),
+            [&](std::span<const std::span<const std::byte>> batch) { seen += batch.size(); }, o);
+        benchmark::DoNotOptimize(seen);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    state.SetBytesProcessed(std::int64_t(state.iterations() * bytes));
+    yeni::set_simd_level(saved);
+}
+BENCHMARK_CAPTURE(bm_import, csv_scalar, yeni::text_format::csv, yeni::simd_level::scalar)
+    ->Name("bulk/import/csv/scalar")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_import, csv_avx2, yeni::text_format::csv, yeni::simd_level::avx2)
+    ->Name("bulk/import/csv/avx2")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_import, ndjson_scalar, yeni::text_format::ndjson, yeni::simd_level::scalar)
+    ->Name("bulk/import/ndjson/scalar")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_import, ndjson_avx2, yeni::text_format::ndjson, yeni::simd_level::avx2)
+    ->Name("bulk/import/ndjson/avx2")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Whole-file export, synced and renamed into place; one op is one row.
+void bm_export(benchmark::State& state, yeni::text_format f)
+{
+    const auto out = std::filesystem::temp_directory_path() / "yeni_bench_bulk_out";
+    yeni::bulk_options o;
+    o.format = f;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        bytes += yeni::export_text(out, order_schema(), emit_orders, o).bytes;
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    state.SetBytesProcessed(std::int64_t(bytes));
+    std::filesystem::remove(out);
+}
+BENCHMARK_CAPTURE(bm_export, csv, yeni::text_format::csv)
+    ->Name("bulk/export/csv")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_export, ndjson, yeni::text_format::ndjson)
+    ->Name("bulk/export/ndjson")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
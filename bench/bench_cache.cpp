@@ -0,0 +1,87 @@
+#include "bench_util.hpp"
+
+#include "yeni/block_cache.hpp"
+#include "yeni/hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t block_bytes = 4096;
+
+// Every thread looks up blocks that are all resident: the lock-free hit
+// path, one pin and one unpin per get.
+void bm_cache_hit(benchmark::State& state)
+{
+    static std::unique_ptr<yeni::block_cache> cache;
+    constexpr std::uint64_t blocks = 1 << 12;
+    if (state.thread_index() == 0) {
+        cache = std::make_unique<yeni::block_cache>(
+            yeni::block_cache_options{.capacity_bytes = 2 * blocks * block_bytes, .block_bytes = block_bytes});
+        for (std::uint64_t b = 0; b < blocks; ++b)
+            cache->get({1, b * block_bytes}, block_bytes, [](std::span<std::byte> out) {
+                std::memset(out.data(), 0x5a, out.size());
+            });
+    }
+    yeni::bench::probe probe(state);
+    std::uint64_t k = std::uint64_t(state.thread_index()), ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            auto h = cache->lookup({1, (yeni::mix64(k) % blocks) * block_bytes});
+            benchmark::DoNotOptimize(h.data().data());
+        });
+        ++k;
+        ++ops;
+    }
+    probe.finish(ops);
+    if (state.thread_index() == 0)
+        cache.reset();
+}
+BENCHMARK(bm_cache_hit)->Name("cache/hit")->Threads(1)->Threads(4)->UseRealTime();
+
+// Zipf-distributed gets over a working set `range(0)` times the capacity;
+// misses fill the block with memset, standing in for a read. hit_ratio is
+// what the eviction policy keeps resident.
+void bm_cache_zipf(benchmark::State& state)
+{
+    const auto ratio = std::uint64_t(state.range(0));
+    constexpr std::uint64_t capacity_blocks = 1 << 12;
+    const std::uint64_t universe = ratio * capacity_blocks;
+    yeni::block_cache cache({.capacity_bytes = capacity_blocks * block_bytes, .block_bytes = block_bytes});
+
+    // s = 0.99, drawn by inverse CDF up front.
+    std::vector<double> cdf(universe);
+    double total = 0;
+    for (std::uint64_t i = 0; i < universe; ++i)
+        cdf[i] = total += 1.0 / std::pow(double(i + 1), 0.99);
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> u(0, total);
+    std::vector<std::uint64_t> trace(1 << 20);
+    for (auto& b : trace)
+        b = yeni::mix64(std::uint64_t(std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin())) % universe;
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0, misses = 0;
+    for (auto _ : state) {
+        const std::uint64_t block = trace[ops % trace.size()];
+        probe.measure([&] {
+            auto h = cache.get({1, block * block_bytes}, block_bytes, [&](std::span<std::byte> out) {
+                std::memset(out.data(), 0x5a, out.size());
+                ++misses;
+            });
+            benchmark::DoNotOptimize(h.data().data());
+        });
+        ++ops;
+    }
+    probe.finish(ops);
+    state.counters["hit_ratio"] = ops ? 1.0 - double(misses) / double(ops) : 0.0;
+}
+BENCHMARK(bm_cache_zipf)->Name("cache/get_zipf")->Arg(4)->Arg(16);
+
+} // namespace
@@ -0,0 +1,140 @@
+#include "bench_util.hpp"
+
+#include "yeni/codec.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/segment.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t rows = 1 << 20;
+
+// A column each packed encoding is meant for: timestamps a few ms apart,
+// readings in a narrow band, a dozen categories.
+std::vector<std::uint64_t> column_for(yeni::column_encoding e)
+{
+    std::vector<std::uint64_t> c(rows);
+    std::uint64_t ts = 1'700'000'000'000;
+    for (std::size_t i = 0; i < rows; ++i) {
+        const std::uint64_t h = yeni::mix64(i);
+        switch (e) {
+        case yeni::column_encoding::delta:
+            c[i] = ts += h % 16;
+            break;
+        case yeni::column_encoding::frame_of_reference:
+            c[i] = 40'000 + h % 4096;
+            break;
+        default:
+            c[i] = 1'000'003 * (h % 12);
+            break;
+        }
+    }
+    return c;
+}
+
+// Decodes the whole column page by page at `level`; one op is one row.
+void bm_decode(benchmark::State& state, yeni::column_encoding e, yeni::simd_level level)
+{
+    const yeni::simd_level saved = yeni::active_simd_level();
+    yeni::set_simd_level(level);
+    if (yeni::active_simd_level() != level) {
+        yeni::set_simd_level(saved);
+        state.SkipWithError("instruction set not supported on this CPU");
+        return;
+    }
+    const auto values = column_for(e);
+    const std::vector<std::byte> packed = yeni::encode_packed<std::uint64_t>(values, e);
+    const yeni::packed_column<std::uint64_t> column(packed, e);
+    std::vector<std::uint64_t> page(yeni::packed_page_rows);
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (std::size_t p = 0; p < column.pages(); ++p)
+            column.decode_page(p, page.data());
+        benchmark::DoNotOptimize(page.data());
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    state.counters["bits_per_row"] = 8.0 * double(packed.size()) / double(rows);
+    yeni::set_simd_level(saved);
+}
+
+void bm_lz4(benchmark::State& state, bool compress)
+{
+    const auto values = column_for(yeni::column_encoding::delta);
+    const auto raw = std::as_bytes(std::span(values));
+    const std::vector<std::byte> block = yeni::compress_block(raw, yeni::column_encoding::lz4);
+    std::vector<std::byte> out(raw.size());
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (compress)
+            benchmark::DoNotOptimize(yeni::compress_block(raw, yeni::column_encoding::lz4));
+        else
+            yeni::decompress_block(block, yeni::column_encoding::lz4, out);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    state.SetBytesProcessed(std::int64_t(ops * sizeof(std::uint64_t)));
+    state.counters["bits_per_row"] = 8.0 * double(block.size()) / double(rows);
+}
+BENCHMARK_CAPTURE(bm_lz4, compress, true)->Name("codec/lz4/compress")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(bm_lz4, decompress, false)->Name("codec/lz4/decompress")->Unit(benchmark::kMicrosecond);
+
+// filter_compare() straight off a segment column, plain (in place) or
+// frame-of-reference packed (decoded a page at a time).
+void bm_segment_scan(benchmark::State& state, bool encode)
+{
+    const auto values = column_for(yeni::column_encoding::frame_of_reference);
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "yeni_bench_codec.seg";
+    {
+        yeni::codec_options codec;
+        codec.encode = encode;
+        yeni::segment_writer w(path, nullptr, codec);
+        w.add_column<std::uint64_t>("reading", values);
+        w.finish();
+    }
+    const yeni::segment seg = yeni::segment::open(path);
+    std::filesystem::remove(path);
+
+    yeni::selection_bitmap sel;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        yeni::filter_compare<std::uint64_t>(seg, "reading", yeni::compare_op::lt, 41'000, sel);
+        benchmark::DoNotOptimize(sel.words().data());
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    state.counters["bits_per_row"] = 8.0 * double(seg.find_block("reading")->size) / double(rows);
+}
+BENCHMARK_CAPTURE(bm_segment_scan, plain, false)->Name("codec/scan_lt/plain")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(bm_segment_scan, packed, true)->Name("codec/scan_lt/frame_of_reference")->Unit(benchmark::kMicrosecond);
+
+const bool registered = [] {
+    for (auto e : {yeni::column_encoding::frame_of_reference, yeni::column_encoding::delta,
+             yeni::column_encoding::dictionary}) {
+        for (auto level : {yeni::simd_level::scalar, yeni::simd_level::avx2}) {
+            const std::string name = "codec/decode/" + std::string(yeni::to_string(e)) + "/"
+                + std::string(yeni::to_string(level));
+            benchmark::RegisterBenchmark(name.c_str(), [e, level](benchmark::State& s) { bm_decode(s, e, level); })
+                ->Unit(benchmark::kMicrosecond);
+        }
+    }
+    return true;
+}();
+
+} // namespace
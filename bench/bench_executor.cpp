@@ -0,0 +1,145 @@
+#include "bench_util.hpp"
+
+#include "yeni/executor.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/scheduler.hpp"
+#include "yeni/segment.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t rows = 1 << 22;
+
+// Packed columns, so that a whole-column filter decodes into a bitmap the
+// size of the column while the pipeline decodes a page at a time.
+struct fixture {
+    yeni::segment seg = open();
+
+    static yeni::segment open()
+    {
+        std::vector<std::uint64_t> price(rows);
+        std::vector<std::uint32_t> qty(rows);
+        for (std::size_t i = 0; i < rows; ++i) {
+            const std::uint64_t h = yeni::mix64(i);
+            price[i] = h % 10000;
+            qty[i] = std::uint32_t(h >> 40) % 50;
+        }
+        const auto path = std::filesystem::temp_directory_path() / "yeni_bench_executor.seg";
+        yeni::codec_options codec;
+        codec.encode = true;
+        yeni::segment_writer w(path, nullptr, codec);
+        w.add_column<std::uint64_t>("price", price);
+        w.add_column<std::uint32_t>("qty", qty);
+        w.finish();
+        return yeni::segment::open(path);
+    }
+
+    static fixture& get()
+    {
+        static fixture f;
+        return f;
+    }
+};
+
+// sum(price) where qty < 10 and 1000 <= price <= 5000; one op is one row.
+std::uint64_t pipeline_sum(yeni::query_executor& exec, const yeni::segment& seg)
+{
+    std::vector<std::uint64_t> sums(exec.slots());
+    exec.run(yeni::pipeline({{&seg}})
+                 .where<std::uint32_t>("qty", yeni::compare_op::lt, 10)
+                 .where_between<std::uint64_t>("price", 1000, 5000)
+                 .project<std::uint64_t>("price")
+                 .sink([&](const yeni::row_vector& v) {
+                     const auto price = v.column<std::uint64_t>(0);
+                     std::uint64_t s = 0;
+                     v.selection.for_each([&](std::size_t i) { s += price[i]; });
+                     sums[v.slot] += s;
+                 }));
+    std::uint64_t total = 0;
+    for (std::uint64_t s : sums)
+        total += s;
+    return total;
+}
+
+void bm_pipeline(benchmark::State& state)
+{
+    auto& f = fixture::get();
+    yeni::query_executor exec;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0, checksum = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        checksum += pipeline_sum(exec, f.seg);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    benchmark::DoNotOptimize(checksum);
+}
+
+// The same query column at a time: each filter over the whole segment,
+// then the selected prices summed in parallel_for chunks.
+void bm_whole_columns(benchmark::State& state)
+{
+    auto& f = fixture::get();
+    auto& sched = yeni::scheduler::instance();
+    const auto price = f.seg.column<std::uint64_t>("price");
+    yeni::selection_bitmap sel, other;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0, checksum = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        yeni::filter_compare<std::uint32_t>(f.seg, "qty", yeni::compare_op::lt, 10, sel);
+        yeni::filter_range<std::uint64_t>(f.seg, "price", 1000, 5000, other);
+        sel &= other;
+        checksum += sched.parallel_reduce(
+            0, sel.words().size(), 0, std::uint64_t(0),
+            [&](std::size_t b, std::size_t e) {
+                std::uint64_t s = 0;
+                for (std::size_t w = b; w < e; ++w)
+                    for (std::uint64_t bits = sel.words()[w]; bits; bits &= bits - 1)
+                        s += price[w * 64 + std::size_t(std::countr_zero(bits))];
+                return s;
+            },
+            [](std::uint64_t a, std::uint64_t b) { return a + b; });
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    benchmark::DoNotOptimize(checksum);
+}
+
+// Four queries at once from their own threads, sharing one executor's
+// drivers; one op is one row of one query.
+void bm_concurrent(benchmark::State& state)
+{
+    auto& f = fixture::get();
+    yeni::query_executor exec;
+    constexpr unsigned queries = 4;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned q = 0; q < queries; ++q)
+            threads.emplace_back([&] { benchmark::DoNotOptimize(pipeline_sum(exec, f.seg)); });
+        for (auto& t : threads)
+            t.join();
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            queries * rows);
+        ops += queries * rows;
+    }
+    probe.finish(ops);
+}
+
+BENCHMARK(bm_pipeline)->Name("executor/filter_sum/pipeline")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(bm_whole_columns)->Name("executor/filter_sum/whole_columns")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(bm_concurrent)->Name("executor/filter_sum/concurrent4")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
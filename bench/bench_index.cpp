@@ -0,0 +1,167 @@
+#include "bench_util.hpp"
+
+#include "yeni/flat_hash_map.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/record_store.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::vector<std::uint64_t> make_keys(std::size_t n, std::uint64_t salt)
+{
+    std::vector<std::uint64_t> keys(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] = yeni::mix64(i ^ salt);
+    return keys;
+}
+
+// Probing in insertion order would walk node-based maps through memory in
+// allocation order, which no real workload does.
+std::vector<std::uint64_t> shuffled(std::vector<std::uint64_t> keys)
+{
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(7));
+    return keys;
+}
+
+template <class Map>
+void bm_lookup(benchmark::State& state)
+{
+    const std::size_t n = std::size_t(state.range(0));
+    const bool hit = state.range(1) != 0;
+    auto keys = make_keys(n, 0);
+    Map map;
+    map.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        map.insert({keys[i], i});
+    auto probes = shuffled(hit ? keys : make_keys(n, 0x9e3779b97f4a7c15ULL));
+
+    yeni::bench::probe probe(state);
+    std::size_t i = 0, found = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { found += map.find(probes[i]) != map.end(); });
+        if (++i == n)
+            i = 0;
+        ++ops;
+    }
+    benchmark::DoNotOptimize(found);
+    probe.finish(ops);
+}
+BENCHMARK_TEMPLATE(bm_lookup, yeni::flat_hash_map<std::uint64_t, std::uint64_t>)
+    ->Name("flat_hash_map/find")
+    ->ArgsProduct({{1 << 12, 1 << 20, 1 << 23}, {0, 1}});
+BENCHMARK_TEMPLATE(bm_lookup, std::unordered_map<std::uint64_t, std::uint64_t>)
+    ->Name("std_unordered_map/find")
+    ->ArgsProduct({{1 << 12, 1 << 20, 1 << 23}, {0, 1}});
+
+void bm_flat_hash_map_insert(benchmark::State& state)
+{
+    const std::size_t n = std::size_t(state.range(0));
+    auto keys = make_keys(n, 0);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        yeni::flat_hash_map<std::uint64_t, std::uint64_t> map;
+        auto t0 = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < n; ++i)
+            map.insert({keys[i], i});
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), n);
+        benchmark::DoNotOptimize(map.size());
+        ops += n;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_flat_hash_map_insert)->Name("flat_hash_map/insert")->Arg(1 << 16)->Arg(1 << 20);
+
+void bm_record_store_find(benchmark::State& state)
+{
+    const std::size_t n = std::size_t(state.range(0));
+    yeni::record_store store;
+    std::vector<std::byte> value(32, std::byte{0x5a});
+    auto keys = make_keys(n, 0);
+    for (auto k : keys)
+        store.append(k, value);
+    keys = shuffled(std::move(keys));
+
+    yeni::bench::probe probe(state);
+    std::size_t i = 0, found = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { found += store.find(keys[i]) != nullptr; });
+        if (++i == n)
+            i = 0;
+        ++ops;
+    }
+    benchmark::DoNotOptimize(found);
+    probe.finish(ops);
+}
+BENCHMARK(bm_record_store_find)->Name("record_store/find")->Arg(1 << 20);
+
+// find_many() over batches of `range(1)` keys from the same shuffled
+// order; one op is one key.
+void bm_record_store_find_many(benchmark::State& state)
+{
+    const std::size_t n = std::size_t(state.range(0));
+    const std::size_t batch = std::size_t(state.range(1));
+    yeni::record_store store;
+    std::vector<std::byte> value(32, std::byte{0x5a});
+    auto keys = make_keys(n, 0);
+    for (auto k : keys)
+        store.append(k, value);
+    keys = shuffled(std::move(keys));
+
+    std::vector<const yeni::record*> out(batch);
+    yeni::bench::probe probe(state);
+    std::size_t i = 0, found = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        found += store.find_many(std::span(keys).subspan(i, batch), out);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            batch);
+        i = i + 2 * batch > n ? 0 : i + batch;
+        ops += batch;
+    }
+    benchmark::DoNotOptimize(found);
+    probe.finish(ops);
+    state.SetItemsProcessed(std::int64_t(ops));
+}
+BENCHMARK(bm_record_store_find_many)->Name("record_store/find_many")->Args({1 << 20, 64})->Args({1 << 20, 512});
+
+// append_many() of 32-byte values in batches of `range(0)` into a store
+// reset every 2^20 records; a batch of one is the per-call baseline.
+void bm_record_store_append_many(benchmark::State& state)
+{
+    const std::size_t batch = std::size_t(state.range(0));
+    yeni::record_store store;
+    std::vector<std::byte> value(32, std::byte{0x5a});
+    std::vector<std::uint64_t> keys(batch);
+    std::vector<std::span<const std::byte>> values(batch, value);
+    yeni::bench::probe probe(state);
+    std::uint64_t next = 0, ops = 0;
+    for (auto _ : state) {
+        for (auto& k : keys)
+            k = yeni::mix64(next++);
+        const auto t0 = std::chrono::steady_clock::now();
+        store.append_many(keys, values);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            batch);
+        ops += batch;
+        if (next % (1 << 20) < batch) {
+            state.PauseTiming();
+            store.reset();
+            state.ResumeTiming();
+        }
+    }
+    probe.finish(ops);
+    state.SetItemsProcessed(std::int64_t(ops));
+}
+BENCHMARK(bm_record_store_append_many)->Name("record_store/append_many")->Arg(1)->Arg(64)->Arg(512);
+
+} // namespace
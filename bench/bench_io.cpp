@@ -0,0 +1,131 @@
+#include "bench_util.hpp"
+
+#include "yeni/futex.hpp"
+#include "yeni/io.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t file_blocks = 4096;
+constexpr std::size_t block = 4096;
+
+struct bench_file {
+    bench_file()
+    {
+        path = std::filesystem::temp_directory_path() / "yeni_bench_io.dat";
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        std::vector<std::byte> chunk(block * 64, std::byte{0x5a});
+        for (std::size_t i = 0; i < file_blocks / 64; ++i)
+            benchmark::DoNotOptimize(::pwrite(fd, chunk.data(), chunk.size(), off_t(i * chunk.size())));
+    }
+    ~bench_file()
+    {
+        ::close(fd);
+        std::filesystem::remove(path);
+    }
+    std::filesystem::path path;
+    int fd;
+};
+
+// Blocking pread of page-cached 4 KiB blocks: the floor the async paths pay
+// their handoff on top of.
+void bm_pread(benchmark::State& state)
+{
+    bench_file f;
+    std::vector<std::byte> buf(block);
+    yeni::bench::probe probe(state);
+    std::size_t i = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(::pread(f.fd, buf.data(), block, off_t(i * block))); });
+        i = (i + 1) % file_blocks;
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_pread)->Name("io/read_4k/pread");
+
+struct counted_request : yeni::io_request {
+    std::atomic<std::uint32_t>* remaining;
+};
+
+// `batch` reads submitted with one call and reaped together.
+void bm_batch(benchmark::State& state, bool fallback)
+{
+    const std::size_t batch = std::size_t(state.range(0));
+    bench_file f;
+    yeni::io_context io({.force_fallback = fallback});
+    std::vector<std::byte> buf(batch * block);
+    std::vector<counted_request> reqs(batch);
+    std::vector<yeni::io_request*> ptrs(batch);
+    std::atomic<std::uint32_t> remaining{0};
+    for (std::size_t k = 0; k < batch; ++k) {
+        reqs[k].opcode = yeni::io_request::op::read;
+        reqs[k].fd = f.fd;
+        reqs[k].data = buf.data() + k * block;
+        reqs[k].size = block;
+        reqs[k].remaining = &remaining;
+        reqs[k].complete = [](yeni::io_request* r) noexcept {
+            auto* c = static_cast<counted_request*>(r);
+            if (c->remaining->fetch_sub(1, std::memory_order_acq_rel) == 1)
+                yeni::futex_wake(*c->remaining);
+        };
+        ptrs[k] = &reqs[k];
+    }
+
+    yeni::bench::probe probe(state);
+    std::size_t next = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        remaining.store(std::uint32_t(batch), std::memory_order_relaxed);
+        for (auto& r : reqs) {
+            r.offset = next * block;
+            next = (next + 1) % file_blocks;
+        }
+        io.submit(ptrs);
+        for (std::uint32_t v; (v = remaining.load(std::memory_order_acquire)) != 0;)
+            yeni::futex_wait(remaining, v);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), batch);
+        ops += batch;
+    }
+    probe.finish(ops);
+}
+BENCHMARK_CAPTURE(bm_batch, io_uring, false)->Name("io/read_4k_batch/io_uring")->Arg(1)->Arg(32);
+BENCHMARK_CAPTURE(bm_batch, thread_pool, true)->Name("io/read_4k_batch/thread_pool")->Arg(1)->Arg(32);
+
+yeni::io_task<std::size_t> read_chain(yeni::io_context& io, int fd, std::span<std::byte> buf, std::size_t n)
+{
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        total += co_await io.read(fd, buf, (i % file_blocks) * block);
+    co_return total;
+}
+
+// One coroutine issuing dependent reads: measures the suspend/resume round
+// trip through the completion thread.
+void bm_coroutine(benchmark::State& state)
+{
+    bench_file f;
+    yeni::io_context io;
+    std::vector<std::byte> buf(block);
+    constexpr std::size_t chain = 256;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(sync_wait(read_chain(io, f.fd, buf, chain)));
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), chain);
+        ops += chain;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_coroutine)->Name("io/read_4k_await")->Unit(benchmark::kMicrosecond);
+
+} // namespace
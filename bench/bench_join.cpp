@@ -0,0 +1,109 @@
+#include "bench_util.hpp"
+
+#include "yeni/hash.hpp"
+#include "yeni/join.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/segment.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t customers = 1 << 20;
+constexpr std::size_t orders = 1 << 21;
+
+std::filesystem::path bench_path(const char* name)
+{
+    return std::filesystem::temp_directory_path() / name;
+}
+
+// Customers with unique, scattered ids, and orders each naming a random
+// customer, with a quantity the probe side is filtered on.
+struct fixture {
+    yeni::segment left = open("yeni_bench_join_customers.seg", customers, false);
+    yeni::segment right = open("yeni_bench_join_orders.seg", orders, true);
+    yeni::selection_bitmap selection;
+
+    fixture() { yeni::filter_compare<std::uint32_t>(right, "qty", yeni::compare_op::lt, 40, selection); }
+
+    static yeni::segment open(const char* name, std::size_t rows, bool foreign)
+    {
+        std::vector<std::uint64_t> id(rows);
+        std::vector<std::uint32_t> qty(rows);
+        for (std::size_t i = 0; i < rows; ++i) {
+            const std::uint64_t h = yeni::mix64(i);
+            id[i] = yeni::mix64(foreign ? h % customers : i);
+            qty[i] = std::uint32_t(h >> 40) % 50;
+        }
+        const auto path = bench_path(name);
+        yeni::segment_writer w(path);
+        w.add_column<std::uint64_t>("id", id);
+        w.add_column<std::uint32_t>("qty", qty);
+        w.finish();
+        return yeni::segment::open(path);
+    }
+
+    static fixture& get()
+    {
+        static fixture f;
+        return f;
+    }
+};
+
+// Customers joined with the orders of qty < 40; one op is one input row
+// (both sides, before the filter). A small budget forces spilling.
+template <class Join>
+void bm_join(benchmark::State& state, Join join, std::size_t budget)
+{
+    auto& f = fixture::get();
+    yeni::join_options options;
+    options.memory_budget = budget;
+    const yeni::join_input left{&f.left, "id"}, right{&f.right, "id", &f.selection};
+    std::atomic<std::uint64_t> checksum{0};
+    const yeni::join_sink sink = [&](std::span<const std::uint32_t> l, std::span<const std::uint32_t> r) {
+        std::uint64_t x = 0;
+        for (std::size_t i = 0; i < l.size(); ++i)
+            x += l[i] ^ r[i];
+        checksum.fetch_add(x, std::memory_order_relaxed);
+    };
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    yeni::join_stats stats;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        stats = join(left, right, sink, options);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            customers + orders);
+        ops += customers + orders;
+    }
+    probe.finish(ops);
+    benchmark::DoNotOptimize(checksum.load());
+    state.counters["matches"] = double(stats.matches);
+    state.counters["spill_mb"] = double(stats.spill_bytes) / double(1 << 20);
+}
+
+constexpr std::size_t in_memory = std::size_t(1) << 30;
+constexpr std::size_t spilling = std::size_t(16) << 20;
+
+BENCHMARK_CAPTURE(bm_join, radix, yeni::radix_hash_join, in_memory)
+    ->Name("join/radix_hash")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_join, radix_spill, yeni::radix_hash_join, spilling)
+    ->Name("join/radix_hash/spill")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_join, sort_merge, yeni::sort_merge_join, in_memory)
+    ->Name("join/sort_merge")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(bm_join, sort_merge_spill, yeni::sort_merge_join, spilling)
+    ->Name("join/sort_merge/spill")
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
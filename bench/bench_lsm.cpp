@@ -0,0 +1,131 @@
+#include "bench_util.hpp"
+
+#include "yeni/lsm_tree.hpp"
+#include "yeni/record_store.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr std::uint64_t keys_per_flush = 1 << 16;
+
+std::filesystem::path bench_dir()
+{
+    return std::filesystem::temp_directory_path() / "yeni_bench_lsm";
+}
+
+// `flushes` overlapping level-0 segments, each rewriting every key with
+// stride `flushes`, so a hit lands in a random one of them.
+std::unique_ptr<yeni::lsm_tree> build(std::size_t flushes, bool compact)
+{
+    std::filesystem::remove_all(bench_dir());
+    yeni::compaction_options options;
+    options.level0_trigger = compact ? 1 : flushes + 1;
+    options.bytes_per_second = 0;
+    auto tree = std::make_unique<yeni::lsm_tree>(bench_dir(), options);
+    std::vector<std::byte> value(64, std::byte{0x5a});
+    for (std::size_t f = 0; f < flushes; ++f) {
+        yeni::record_store store;
+        for (std::uint64_t k = f; k < keys_per_flush * flushes; k += flushes)
+            store.append(k, value);
+        tree->flush(store);
+    }
+    tree->wait_for_compactions();
+    return tree;
+}
+
+// Point gets, half of them misses, against the same data left as level-0
+// segments or compacted: ns/op tracks read amplification.
+void bm_get(benchmark::State& state, bool compact)
+{
+    const auto flushes = std::size_t(state.range(0));
+    auto tree = build(flushes, compact);
+    const yeni::epoch::guard pin;
+    const auto* version = &tree->current(pin);
+    state.counters["read_amp"] = double(version->read_amplification());
+    yeni::bench::probe probe(state);
+    std::uint64_t k = 0, ops = 0;
+    const std::uint64_t span = 2 * keys_per_flush * flushes;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(version->find(k)); });
+        k = (k + 0x9e3779b97f4a7c15ULL) % span;
+        ++ops;
+    }
+    probe.finish(ops);
+    tree.reset();
+    std::filesystem::remove_all(bench_dir());
+}
+BENCHMARK_CAPTURE(bm_get, level0, false)->Name("lsm/get/level0")->Arg(8);
+BENCHMARK_CAPTURE(bm_get, compacted, true)->Name("lsm/get/compacted")->Arg(8);
+
+// Gets for keys no segment holds. Level-0 segments are not range-checked,
+// so without the key filters each miss would binary-search all of them.
+// `key_probes_per_miss` counts the segments whose filter let a key through.
+void bm_get_miss(benchmark::State& state)
+{
+    const auto flushes = std::size_t(state.range(0));
+    auto tree = build(flushes, false);
+    const yeni::epoch::guard pin;
+    const auto* version = &tree->current(pin);
+    const std::uint64_t span = keys_per_flush * flushes;
+    std::uint64_t passed = 0;
+    for (std::uint64_t k = 0; k < span; k += 16)
+        for (const auto& s : version->level(0))
+            passed += s->get().key_filter().may_contain(span + k);
+    state.counters["key_probes_per_miss"] = double(passed) / double(span / 16);
+    yeni::bench::probe probe(state);
+    std::uint64_t k = 0, ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(version->find(span + k)); });
+        k = (k + 0x9e3779b97f4a7c15ULL) % span;
+        ++ops;
+    }
+    probe.finish(ops);
+    tree.reset();
+    std::filesystem::remove_all(bench_dir());
+}
+BENCHMARK(bm_get_miss)->Name("lsm/get_miss/level0")->Arg(8);
+
+// Full merge of `flushes` level-0 segments into level 1, unthrottled.
+void bm_compact(benchmark::State& state)
+{
+    const auto flushes = std::size_t(state.range(0));
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::remove_all(bench_dir());
+        yeni::compaction_options options;
+        options.level0_trigger = flushes;
+        options.bytes_per_second = 0;
+        auto tree = std::make_unique<yeni::lsm_tree>(bench_dir(), options);
+        std::vector<std::byte> value(64, std::byte{0x5a});
+        for (std::size_t f = 0; f + 1 < flushes; ++f) {
+            yeni::record_store store;
+            for (std::uint64_t k = f; k < keys_per_flush * flushes; k += flushes)
+                store.append(k, value);
+            tree->flush(store);
+        }
+        yeni::record_store last;
+        for (std::uint64_t k = flushes - 1; k < keys_per_flush * flushes; k += flushes)
+            last.append(k, value);
+        state.ResumeTiming();
+        const auto t0 = std::chrono::steady_clock::now();
+        tree->flush(last);
+        tree->wait_for_compactions();
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            keys_per_flush * flushes);
+        ops += keys_per_flush * flushes;
+        state.PauseTiming();
+        tree.reset();
+        state.ResumeTiming();
+    }
+    probe.finish(ops);
+    std::filesystem::remove_all(bench_dir());
+}
+BENCHMARK(bm_compact)->Name("lsm/compact_level0")->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,95 @@
+// Benchmark driver. Results go to the console as usual and, in a fixed
+// column layout sorted by name, to bench_output.txt (or --yeni_out=<path>)
+// so two runs can be compared with a plain diff.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct row {
+    double ns_per_op;
+    double bytes_per_op;
+    double allocs_per_op;
+    double p50_ns;
+    double p99_ns;
+};
+
+double counter_or(const benchmark::BenchmarkReporter::Run& run, const char* name, double fallback)
+{
+    auto it = run.counters.find(name);
+    return it == run.counters.end() ? fallback : double(it->second);
+}
+
+class output_reporter : public benchmark::ConsoleReporter {
+public:
+    void ReportRuns(const std::vector<Run>& runs) override
+    {
+        ConsoleReporter::ReportRuns(runs);
+        for (const Run& run : runs) {
+            // With --benchmark_repetitions the last repetition wins; the
+            // aggregates are already on the console.
+            if (run.error_occurred || run.run_type != Run::RT_Iteration)
+                continue;
+            const double ops = counter_or(run, "ops", double(run.iterations));
+            const double per = ops > 0 ? ops : 1;
+            // Wall time is shared by all threads of a run, so scale it back to
+            // the cost of one operation on one thread.
+            rows_[run.run_name.str()] = row{
+                run.real_accumulated_time * 1e9 * double(run.threads) / per,
+                counter_or(run, "bytes", 0) / per,
+                counter_or(run, "allocs", 0) / per,
+                counter_or(run, "p50_ns", 0),
+                counter_or(run, "p99_ns", 0),
+            };
+        }
+    }
+
+    bool write(const char* path) const
+    {
+        std::FILE* f = std::fopen(path, "w");
+        if (!f)
+            return false;
+        std::fprintf(f, "# yeni benchmark results v1\n");
+        std::fprintf(f, "%-48s %12s %12s %12s %12s %12s\n", "# name", "ns/op", "bytes/op", "allocs/op", "p50_ns", "p99_ns");
+        for (const auto& [name, r] : rows_)
+            std::fprintf(f, "%-48s %12.2f %12.2f %12.4f %12.1f %12.1f\n", name.c_str(), r.ns_per_op, r.bytes_per_op,
+                r.allocs_per_op, r.p50_ns, r.p99_ns);
+        return std::fclose(f) == 0;
+    }
+
+private:
+    std::map<std::string, row> rows_;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* out = "bench_output.txt";
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--yeni_out=", 11) == 0)
+            out = argv[i] + 11;
+        else
+            args.push_back(argv[i]);
+    }
+    int n = int(args.size());
+    benchmark::Initialize(&n, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n, args.data()))
+        return 1;
+
+    output_reporter reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+    if (!reporter.write(out)) {
+        std::fprintf(stderr, "yeni_bench: cannot write %s\n", out);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "bench_util.hpp"
+
+#include "yeni/metrics.hpp"
+
+#include <cstdint>
+
+namespace {
+
+// Cost of one hook on the calling thread; with YENI_METRICS=OFF both
+// collapse to the loop overhead.
+void bm_counter_add(benchmark::State& state)
+{
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { yeni::metrics::local().add(yeni::metrics::counter::inserts); });
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_counter_add)->Name("metrics/counter_add");
+
+void bm_sampled_timer(benchmark::State& state)
+{
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            auto& m = yeni::metrics::local();
+            yeni::metrics::scoped_timer timer(m, yeni::metrics::histogram::lookup,
+                m.sample(yeni::metrics::histogram::lookup));
+            benchmark::ClobberMemory();
+        });
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_sampled_timer)->Name("metrics/sampled_timer");
+
+void bm_prometheus_text(benchmark::State& state)
+{
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(yeni::metrics::prometheus_text().size()); });
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_prometheus_text)->Name("metrics/prometheus_text")->Unit(benchmark::kMicrosecond);
+
+} // namespace
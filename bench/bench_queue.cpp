@@ -0,0 +1,101 @@
+#include "bench_util.hpp"
+
+#include "yeni/mpsc_queue.hpp"
+#include "yeni/shard_group.hpp"
+#include "yeni/spsc_queue.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+using item_queue = yeni::mpsc_queue<yeni::handoff_batch<std::uint64_t>>;
+
+// One producer pushes items through a batching_producer while a dedicated
+// consumer thread drains; ns/op is the per-item producer cost.
+void bm_mpsc_handoff(benchmark::State& state)
+{
+    item_queue queue(1024);
+    std::thread consumer([&] {
+        while (yeni::consume_batches(queue, [](std::uint64_t v) { benchmark::DoNotOptimize(v); }) || !queue.closed()) {
+        }
+    });
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    {
+        yeni::batching_producer<std::uint64_t> producer(queue);
+        for (auto _ : state) {
+            probe.measure([&] { producer.push(ops); });
+            ++ops;
+        }
+    }
+    probe.finish(ops);
+    queue.close();
+    consumer.join();
+}
+BENCHMARK(bm_mpsc_handoff)->Name("mpsc_queue/handoff")->UseRealTime();
+
+void bm_mpsc_push_pop(benchmark::State& state)
+{
+    yeni::mpsc_queue<std::uint64_t> queue(1024);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0, out = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            queue.try_push(ops);
+            queue.try_pop(out);
+        });
+        ++ops;
+    }
+    benchmark::DoNotOptimize(out);
+    probe.finish(ops);
+}
+BENCHMARK(bm_mpsc_push_pop)->Name("mpsc_queue/push_pop_uncontended");
+
+// One producer, one spinning consumer thread; ns/op is the per-item
+// producer cost, full-ring retries included.
+void bm_spsc_handoff(benchmark::State& state)
+{
+    yeni::spsc_queue<std::uint64_t> queue(1024);
+    std::atomic<bool> done{false};
+    std::thread consumer([&] {
+        std::uint64_t out[64];
+        while (!done.load(std::memory_order_acquire) || !queue.empty())
+            benchmark::DoNotOptimize(queue.try_pop_batch(out));
+    });
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            while (!queue.try_push(std::uint64_t(ops)))
+                std::this_thread::yield();
+        });
+        ++ops;
+    }
+    probe.finish(ops);
+    done.store(true, std::memory_order_release);
+    consumer.join();
+}
+BENCHMARK(bm_spsc_handoff)->Name("spsc_queue/handoff")->UseRealTime();
+
+// Round trip of one call from shard 0 to shard 1 and back, over the rings
+// between them.
+void bm_shard_invoke(benchmark::State& state)
+{
+    yeni::shard_group group({.shards = 2, .pin = false});
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    group.invoke_on(0, [&](yeni::shard&) {
+        for (auto _ : state) {
+            probe.measure([&] { benchmark::DoNotOptimize(group.invoke_on(1, [](yeni::shard& s) { return s.id(); })); });
+            ++ops;
+        }
+    });
+    probe.finish(ops);
+}
+BENCHMARK(bm_shard_invoke)->Name("shard_group/invoke_on/remote")->UseRealTime();
+
+} // namespace
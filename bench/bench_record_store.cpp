@@ -0,0 +1,158 @@
+#include "bench_util.hpp"
+
+#include "yeni/aggregate.hpp"
+#include "yeni/index_snapshot.hpp"
+#include "yeni/memory.hpp"
+#include "yeni/record_store.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t batch_records = 1 << 16;
+
+// Appends with a reset every `batch_records`, mirroring the ingest path
+// where arenas are rewound once a batch has been flushed.
+void bm_record_store_append(benchmark::State& state)
+{
+    static yeni::record_store store;
+    if (state.thread_index() == 0)
+        store.reset();
+    std::vector<std::byte> value(std::size_t(state.range(0)), std::byte{0x5a});
+    yeni::bench::probe probe(state);
+    std::uint64_t key = std::uint64_t(state.thread_index()) << 40;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            benchmark::DoNotOptimize(store.append(key++, value));
+        });
+        if (++ops % batch_records == 0 && state.threads() == 1)
+            store.reset();
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_record_store_append)->Name("record_store/append")->Arg(16)->Arg(128)->Arg(1024);
+BENCHMARK(bm_record_store_append)->Name("record_store/append_mt")->Arg(128)->Threads(4)->UseRealTime();
+
+void bm_record_store_scan(benchmark::State& state)
+{
+    yeni::record_store store;
+    std::vector<std::byte> value(std::size_t(state.range(0)), std::byte{0x5a});
+    for (std::uint64_t k = 0; k < batch_records; ++k)
+        store.append(k, value);
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::uint64_t sum = 0;
+        store.for_each([&](const yeni::record& r) { sum += r.key + r.size; });
+        benchmark::DoNotOptimize(sum);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            batch_records);
+        ops += batch_records;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_record_store_scan)->Name("record_store/scan")->Arg(16)->Arg(128);
+
+// Random lookups over a store far bigger than the TLB reaches with base
+// pages, its arenas and index drawn from operator new or a page_provider.
+void bm_record_store_find(benchmark::State& state, std::optional<yeni::page_size> pages)
+{
+    constexpr std::uint64_t keys = 1 << 20;
+    std::unique_ptr<yeni::page_provider> memory;
+    if (pages)
+        memory = std::make_unique<yeni::page_provider>(yeni::page_provider_options{.pages = *pages});
+    auto store = std::make_unique<yeni::record_store>(std::size_t(2) << 20,
+        memory ? *memory : yeni::memory_provider::standard());
+    std::vector<std::byte> value(64, std::byte{0x5a});
+    for (std::uint64_t k = 0; k < keys; ++k)
+        store->append(k, value);
+
+    std::mt19937_64 rng(7);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const std::uint64_t k = rng() % keys;
+        probe.measure([&] { benchmark::DoNotOptimize(store->find(k)); });
+        ++ops;
+    }
+    probe.finish(ops);
+    store.reset();
+    yeni::epoch::synchronize();
+}
+BENCHMARK_CAPTURE(bm_record_store_find, standard, std::nullopt)->Name("record_store/find/standard");
+BENCHMARK_CAPTURE(bm_record_store_find, transparent, yeni::page_size::transparent)
+    ->Name("record_store/find/transparent");
+BENCHMARK_CAPTURE(bm_record_store_find, huge_2m, yeni::page_size::huge_2m)->Name("record_store/find/huge_2m");
+
+// Records folded into a count/sum/max view grouped by a 16-value key, a
+// batch of 64 at a time as the ingest consumer hands them over; ns/op is
+// per record. `binary` groups by a string field instead.
+void bm_aggregate_apply(benchmark::State& state, bool binary)
+{
+    using t = yeni::segment_format::column_type;
+    const yeni::schema s({{"region", t::u32}, {"name", t::binary}, {"qty", t::u64}});
+    yeni::aggregate_view view(s, binary ? "name" : "region",
+        {{yeni::aggregate_op::count, ""}, {yeni::aggregate_op::sum, "qty"}, {yeni::aggregate_op::max, "qty"}});
+    yeni::record_store store;
+    std::vector<const yeni::record*> records(batch_records);
+    for (std::size_t i = 0; i < batch_records; ++i) {
+        const std::string name = "region-" + std::to_string(i % 16);
+        records[i] = store.append(i, s.encode(std::vector<yeni::schema::value>{std::uint32_t(i % 16),
+                                         std::as_bytes(std::span(name.data(), name.size())), std::uint64_t(i)}));
+    }
+
+    constexpr std::size_t batch = 64;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const std::size_t at = ops % batch_records;
+        const auto t0 = std::chrono::steady_clock::now();
+        view.apply(std::span<const yeni::record* const>(records.data() + at, batch));
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), batch);
+        ops += batch;
+    }
+    probe.finish(ops);
+    state.counters["groups"] = double(view.read().size());
+}
+BENCHMARK_CAPTURE(bm_aggregate_apply, u32, false)->Name("aggregate/apply/u32");
+BENCHMARK_CAPTURE(bm_aggregate_apply, binary, true)->Name("aggregate/apply/binary");
+
+// Lookups served straight from a mapped index snapshot of `batch_records`
+// keys, as after a restart; `open_ns` is what mapping it cost.
+void bm_index_snapshot_find(benchmark::State& state)
+{
+    const auto path = std::filesystem::temp_directory_path() / "yeni_bench_index";
+    {
+        yeni::record_store store;
+        std::vector<std::byte> value(64, std::byte{0x5a});
+        for (std::uint64_t k = 0; k < batch_records; ++k)
+            store.append(k, value);
+        yeni::write_index_snapshot(path, store, 1);
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    const auto snap = yeni::index_snapshot::open(path);
+    state.counters["open_ns"] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    yeni::bench::probe probe(state);
+    std::uint64_t k = 0, ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(snap.find(k)); });
+        k = (k + 0x9e3779b97f4a7c15ULL) % (2 * batch_records); // half misses
+        ++ops;
+    }
+    probe.finish(ops);
+    std::filesystem::remove(path);
+}
+BENCHMARK(bm_index_snapshot_find)->Name("index_snapshot/find");
+
+} // namespace
@@ -0,0 +1,106 @@
+#include "bench_util.hpp"
+
+#include "yeni/hash.hpp"
+#include "yeni/predicate.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t rows = 1 << 20;
+
+template <class T>
+std::vector<T> column()
+{
+    std::vector<T> c(rows);
+    for (std::size_t i = 0; i < rows; ++i)
+        c[i] = T(yeni::mix64(i) % 1000);
+    return c;
+}
+
+// Runs `scan` once per iteration at `level`; one op is one row.
+template <class Scan>
+void run_scan(benchmark::State& state, yeni::simd_level level, Scan&& scan)
+{
+    const yeni::simd_level saved = yeni::active_simd_level();
+    yeni::set_simd_level(level);
+    if (yeni::active_simd_level() != level) {
+        yeni::set_simd_level(saved);
+        state.SkipWithError("instruction set not supported on this CPU");
+        return;
+    }
+    yeni::selection_bitmap sel;
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        scan(sel);
+        benchmark::DoNotOptimize(sel.words().data());
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), rows);
+        ops += rows;
+    }
+    probe.finish(ops);
+    yeni::set_simd_level(saved);
+}
+
+template <class T>
+void bm_compare(benchmark::State& state, yeni::simd_level level)
+{
+    const auto c = column<T>();
+    run_scan(state, level, [&](yeni::selection_bitmap& sel) {
+        yeni::filter_compare<T>(c, yeni::compare_op::lt, T(500), sel);
+    });
+}
+
+void bm_range_u64(benchmark::State& state, yeni::simd_level level)
+{
+    const auto c = column<std::uint64_t>();
+    run_scan(state, level, [&](yeni::selection_bitmap& sel) {
+        yeni::filter_range<std::uint64_t>(c, 100, 400, sel);
+    });
+}
+
+void bm_in_u64(benchmark::State& state, yeni::simd_level level)
+{
+    const auto c = column<std::uint64_t>();
+    const std::vector<std::uint64_t> values{3, 17, 99, 256, 511, 740, 801, 999};
+    run_scan(state, level, [&](yeni::selection_bitmap& sel) {
+        yeni::filter_in<std::uint64_t>(c, values, sel);
+    });
+}
+
+void bm_conjunction(benchmark::State& state, yeni::simd_level level)
+{
+    const auto a = column<std::uint64_t>();
+    const auto b = column<double>();
+    yeni::selection_bitmap other;
+    run_scan(state, level, [&](yeni::selection_bitmap& sel) {
+        yeni::filter_range<std::uint64_t>(a, 100, 800, sel);
+        yeni::filter_compare<double>(b, yeni::compare_op::ge, 250.0, other);
+        sel &= other;
+    });
+}
+
+template <class Fn>
+void register_levels(const char* name, Fn fn)
+{
+    for (auto level : {yeni::simd_level::scalar, yeni::simd_level::avx2, yeni::simd_level::avx512}) {
+        const std::string full = std::string("scan/") + name + "/" + std::string(yeni::to_string(level));
+        benchmark::RegisterBenchmark(full.c_str(), [fn, level](benchmark::State& s) { fn(s, level); })
+            ->Unit(benchmark::kMicrosecond);
+    }
+}
+
+const bool registered = [] {
+    register_levels("compare_u32", bm_compare<std::uint32_t>);
+    register_levels("compare_u64", bm_compare<std::uint64_t>);
+    register_levels("compare_f64", bm_compare<double>);
+    register_levels("range_u64", bm_range_u64);
+    register_levels("in8_u64", bm_in_u64);
+    register_levels("range_and_ge", bm_conjunction);
+    return true;
+}();
+
+} // namespace
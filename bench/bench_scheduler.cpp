@@ -0,0 +1,58 @@
+#include "bench_util.hpp"
+
+#include "yeni/scheduler.hpp"
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Fixed cost of one fork/join round trip with trivial chunks.
+void bm_parallel_for_overhead(benchmark::State& state)
+{
+    auto& sched = yeni::scheduler::instance();
+    std::vector<std::uint64_t> slots(sched.worker_count() * 8 * 8);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            sched.parallel_for(0, slots.size(), 8, [&](std::size_t b, std::size_t e) {
+                for (std::size_t i = b; i < e; ++i)
+                    ++slots[i];
+            });
+        });
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_parallel_for_overhead)->Name("scheduler/parallel_for_overhead")->UseRealTime();
+
+void bm_parallel_reduce_sum(benchmark::State& state)
+{
+    auto& sched = yeni::scheduler::instance();
+    std::vector<std::uint64_t> data(std::size_t(state.range(0)));
+    std::iota(data.begin(), data.end(), 0);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        auto sum = sched.parallel_reduce(
+            0, data.size(), 0, std::uint64_t(0),
+            [&](std::size_t b, std::size_t e) {
+                std::uint64_t s = 0;
+                for (std::size_t i = b; i < e; ++i)
+                    s += data[i];
+                return s;
+            },
+            [](std::uint64_t a, std::uint64_t b) { return a + b; });
+        benchmark::DoNotOptimize(sum);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            data.size());
+        ops += data.size();
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_parallel_reduce_sum)->Name("scheduler/parallel_reduce_sum")->Arg(1 << 24)->UseRealTime();
+
+} // namespace
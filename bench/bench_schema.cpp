@@ -0,0 +1,151 @@
+#include "bench_util.hpp"
+
+#include "yeni/hash.hpp"
+#include "yeni/schema.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t records = 1 << 18;
+
+using order = yeni::static_schema<yeni::field<"id", std::uint64_t>, yeni::field<"ts", std::int64_t>,
+    yeni::field<"price", double>, yeni::field<"qty", std::uint32_t>,
+    yeni::field<"region", std::span<const std::byte>>>;
+
+const std::array<std::string, 6> regions = {"eu-west", "eu-central", "us-east", "us-west", "ap-south", "sa-east"};
+
+std::span<const std::byte> as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+// Encoded orders packed back to back, as a record store would hold them.
+struct fixture {
+    std::vector<std::byte> data;
+    std::vector<std::span<const std::byte>> rows;
+
+    fixture()
+    {
+        std::vector<std::size_t> ends;
+        std::vector<std::byte> rec;
+        for (std::size_t i = 0; i < records; ++i) {
+            const std::uint64_t h = yeni::mix64(i);
+            order::encode_into(rec, i, std::int64_t(1'700'000'000'000 + i * 7), double(h % 100'000) / 100,
+                std::uint32_t(1 + h % 50), as_bytes(regions[h % regions.size()]));
+            data.insert(data.end(), rec.begin(), rec.end());
+            ends.push_back(data.size());
+        }
+        for (std::size_t i = 0, begin = 0; i < records; begin = ends[i++])
+            rows.emplace_back(data.data() + begin, ends[i] - begin);
+    }
+
+    static fixture& get()
+    {
+        static fixture f;
+        return f;
+    }
+};
+
+// Order value summed over every record: three field reads each.
+void bm_get(benchmark::State& state, bool compiled)
+{
+    auto& f = fixture::get();
+    const yeni::schema dynamic = order::dynamic();
+    const std::size_t id = *dynamic.index_of("id"), price = *dynamic.index_of("price"),
+                      qty = *dynamic.index_of("qty");
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        const auto t0 = std::chrono::steady_clock::now();
+        double total = 0;
+        std::uint64_t ids = 0;
+        if (compiled) {
+            for (const auto r : f.rows) {
+                ids += order::get<"id">(r);
+                total += order::get<"price">(r) * order::get<"qty">(r);
+            }
+        } else {
+            for (const auto r : f.rows) {
+                ids += std::get<std::uint64_t>(dynamic.get(r, id));
+                total += std::get<double>(dynamic.get(r, price)) * std::get<std::uint32_t>(dynamic.get(r, qty));
+            }
+        }
+        benchmark::DoNotOptimize(total);
+        benchmark::DoNotOptimize(ids);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            records);
+        ops += records;
+    }
+    probe.finish(ops);
+}
+BENCHMARK_CAPTURE(bm_get, static, true)->Name("schema/get/static")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(bm_get, dynamic, false)->Name("schema/get/dynamic")->Unit(benchmark::kMicrosecond);
+
+void bm_encode(benchmark::State& state, bool compiled)
+{
+    const yeni::schema dynamic = order::dynamic();
+    std::vector<std::byte> rec;
+    std::vector<yeni::schema::value> values(dynamic.size());
+    yeni::bench::probe probe(state);
+    std::uint64_t i = 0, ops = 0;
+    for (auto _ : state) {
+        const std::uint64_t h = yeni::mix64(i);
+        const auto region = as_bytes(regions[h % regions.size()]);
+        probe.measure([&] {
+            if (compiled) {
+                order::encode_into(rec, i, std::int64_t(i), double(h % 1000), std::uint32_t(h % 50), region);
+            } else {
+                values[0] = i;
+                values[1] = std::int64_t(i);
+                values[2] = double(h % 1000);
+                values[3] = std::uint32_t(h % 50);
+                values[4] = region;
+                dynamic.encode_into(rec, values);
+            }
+        });
+        benchmark::DoNotOptimize(rec.data());
+        ++i;
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK_CAPTURE(bm_encode, static, true)->Name("schema/encode/static");
+BENCHMARK_CAPTURE(bm_encode, dynamic, false)->Name("schema/encode/dynamic");
+
+// Sort by (region, qty, id); one op is one record sorted.
+void bm_sort(benchmark::State& state, bool compiled)
+{
+    auto& f = fixture::get();
+    const yeni::schema dynamic = order::dynamic();
+    const std::array<std::size_t, 3> key = {*dynamic.index_of("region"), *dynamic.index_of("qty"),
+        *dynamic.index_of("id")};
+    std::vector<std::uint32_t> perm(records);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        std::iota(perm.begin(), perm.end(), 0);
+        const auto t0 = std::chrono::steady_clock::now();
+        if (compiled)
+            std::sort(perm.begin(), perm.end(), [&](std::uint32_t a, std::uint32_t b) {
+                return order::compare<"region", "qty", "id">(f.rows[a], f.rows[b]) < 0;
+            });
+        else
+            std::sort(perm.begin(), perm.end(),
+                [&](std::uint32_t a, std::uint32_t b) { return dynamic.compare(f.rows[a], f.rows[b], key) < 0; });
+        benchmark::DoNotOptimize(perm.data());
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(),
+            records);
+        ops += records;
+    }
+    probe.finish(ops);
+}
+BENCHMARK_CAPTURE(bm_sort, static, true)->Name("schema/sort/static")->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(bm_sort, dynamic, false)->Name("schema/sort/dynamic")->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,166 @@
+#include "bench_util.hpp"
+
+#include "yeni/hash.hpp"
+#include "yeni/intern.hpp"
+#include "yeni/io.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/segment.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::filesystem::path bench_path(const char* name)
+{
+    return std::filesystem::temp_directory_path() / name;
+}
+
+void fill(yeni::record_store& store, std::size_t n, std::size_t value_size)
+{
+    std::vector<std::byte> value(value_size, std::byte{0x5a});
+    for (std::size_t i = 0; i < n; ++i)
+        store.append(yeni::mix64(i), value);
+}
+
+void bm_segment_write(benchmark::State& state, bool pipelined)
+{
+    const std::size_t n = std::size_t(state.range(0));
+    yeni::record_store store;
+    fill(store, n, 64);
+    const auto path = bench_path("yeni_bench_write.seg");
+    std::optional<yeni::io_context> io;
+    if (pipelined)
+        io.emplace();
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        yeni::write_segment(path, store, io ? &*io : nullptr);
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), n);
+        ops += n;
+    }
+    probe.finish(ops);
+    std::filesystem::remove(path);
+}
+BENCHMARK_CAPTURE(bm_segment_write, sync, false)->Name("segment/serialize")->Arg(1 << 16)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(bm_segment_write, pipelined, true)
+    ->Name("segment/serialize_pipelined")
+    ->Arg(1 << 16)
+    ->Unit(benchmark::kMicrosecond);
+
+void bm_segment_open(benchmark::State& state)
+{
+    yeni::record_store store;
+    fill(store, 1 << 16, 64);
+    const auto path = bench_path("yeni_bench_open.seg");
+    yeni::write_segment(path, store);
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(yeni::segment::open(path).rows()); });
+        ++ops;
+    }
+    probe.finish(ops);
+    std::filesystem::remove(path);
+}
+BENCHMARK(bm_segment_open)->Name("segment/open");
+
+void bm_segment_find(benchmark::State& state)
+{
+    const std::size_t n = std::size_t(state.range(0));
+    yeni::record_store store;
+    fill(store, n, 64);
+    const auto path = bench_path("yeni_bench_find.seg");
+    yeni::write_segment(path, store);
+    auto seg = yeni::segment::open(path);
+    auto values = seg.binary(yeni::segment::value_column);
+
+    yeni::bench::probe probe(state);
+    std::size_t i = 0, bytes = 0;
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            if (auto row = seg.find(yeni::mix64(i)))
+                bytes += values[*row].size();
+        });
+        if (++i == n)
+            i = 0;
+        ++ops;
+    }
+    benchmark::DoNotOptimize(bytes);
+    probe.finish(ops);
+    std::filesystem::remove(path);
+}
+BENCHMARK(bm_segment_find)->Name("segment/find")->Arg(1 << 20);
+
+// Sorted tenant-prefixed URLs, the shape front coding is for.
+std::filesystem::path write_urls(yeni::column_encoding e, std::size_t n)
+{
+    const auto path = bench_path("yeni_bench_urls.seg");
+    std::vector<std::string> urls(n);
+    for (std::size_t i = 0; i < n; ++i)
+        urls[i] = "https://tenant-" + std::to_string(i * 16 / n) + ".example.com/items/" + std::to_string(i);
+    yeni::codec_options codec;
+    codec.binary = e;
+    yeni::segment_writer w(path, nullptr, codec);
+    w.add_binary_column("url", n, [&](std::size_t i) { return std::as_bytes(std::span(urls[i].data(), urls[i].size())); });
+    w.finish();
+    return path;
+}
+
+// One op is one row filtered.
+void bm_string_prefix(benchmark::State& state, yeni::column_encoding e)
+{
+    const std::size_t n = 1 << 18;
+    const auto path = write_urls(e, n);
+    const auto seg = yeni::segment::open(path);
+    yeni::selection_bitmap sel;
+    yeni::filter_string_prefix(seg, "url", "https://tenant-7", sel);
+
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        auto t0 = std::chrono::steady_clock::now();
+        yeni::filter_string_prefix(seg, "url", "https://tenant-7", sel);
+        benchmark::DoNotOptimize(sel.words().data());
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), n);
+        ops += n;
+    }
+    probe.finish(ops);
+    state.counters["file_bytes"] = double(seg.file_size());
+    std::filesystem::remove(path);
+}
+BENCHMARK_CAPTURE(bm_string_prefix, plain, yeni::column_encoding::plain)->Name("segment/string_prefix/plain");
+BENCHMARK_CAPTURE(bm_string_prefix, front_coded, yeni::column_encoding::front_coded)
+    ->Name("segment/string_prefix/front_coded");
+
+// One op is one row interned into a fresh table.
+void bm_intern_column(benchmark::State& state, yeni::column_encoding e)
+{
+    const std::size_t n = 1 << 16;
+    const auto path = write_urls(e, n);
+    const auto seg = yeni::segment::open(path);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        yeni::string_interner table;
+        auto t0 = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(yeni::intern_column(seg, "url", table).data());
+        probe.add_sample(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count(), n);
+        ops += n;
+    }
+    probe.finish(ops);
+    std::filesystem::remove(path);
+}
+BENCHMARK_CAPTURE(bm_intern_column, plain, yeni::column_encoding::plain)->Name("segment/intern_column/plain");
+BENCHMARK_CAPTURE(bm_intern_column, front_coded, yeni::column_encoding::front_coded)
+    ->Name("segment/intern_column/front_coded");
+
+} // namespace
@@ -0,0 +1,46 @@
+#include "bench_util.hpp"
+
+#include "yeni/trace.hpp"
+
+#include <cstdint>
+
+namespace {
+
+// An operation span with one nested span, sampling one in range(0)
+// operations (0: tracing off).
+void bm_span(benchmark::State& state)
+{
+    yeni::trace::set_sample_every(std::uint32_t(state.range(0)));
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            const yeni::trace::span op(yeni::trace::span_kind::lookup, ops);
+            const yeni::trace::span probe_span(yeni::trace::span_kind::index_probe);
+            benchmark::ClobberMemory();
+        });
+        ++ops;
+    }
+    probe.finish(ops);
+    yeni::trace::set_sample_every(0);
+}
+BENCHMARK(bm_span)->Name("trace/span")->Arg(0)->Arg(1024)->Arg(1);
+
+// Exporting full rings: one per thread that ever traced.
+void bm_chrome_trace(benchmark::State& state)
+{
+    yeni::trace::set_sample_every(1);
+    for (std::size_t i = 0; i < yeni::trace::ring_capacity; ++i)
+        yeni::trace::span s(yeni::trace::span_kind::decode, i);
+    yeni::trace::set_sample_every(0);
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(yeni::trace::chrome_trace().size()); });
+        ++ops;
+    }
+    probe.finish(ops);
+}
+BENCHMARK(bm_chrome_trace)->Name("trace/chrome_trace")->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace yeni::bench {
+
+struct alloc_stats {
+    std::uint64_t count;
+    std::uint64_t bytes;
+};
+
+/// Allocation totals of the calling thread (see alloc_counter.cpp).
+alloc_stats alloc_snapshot() noexcept;
+
+/// Per-benchmark bookkeeping behind the columns of bench_output.txt.
+///
+/// Wrap each operation in measure(); every `sample_every`-th call is timed
+/// individually for the latency percentiles. finish() publishes the raw
+/// totals as counters and the reporter turns them into per-op figures.
+class probe {
+public:
+    explicit probe(benchmark::State& state, unsigned sample_every = 16, std::size_t max_samples = 1 << 18)
+        : state_(state)
+        , every_(sample_every)
+    {
+        samples_.reserve(max_samples);
+        calibrate();
+        start_ = alloc_snapshot();
+    }
+
+    template <class F>
+    void measure(F&& op)
+    {
+        if (++calls_ % every_ != 0 || samples_.size() == samples_.capacity()) {
+            op();
+            return;
+        }
+        auto t0 = clock::now();
+        op();
+        auto t1 = clock::now();
+        samples_.push_back(std::max(0.0, std::chrono::duration<double, std::nano>(t1 - t0).count() - overhead_ns_));
+    }
+
+    /// Publish counters for `ops` logical operations.
+    void finish(std::uint64_t ops)
+    {
+        alloc_stats end = alloc_snapshot();
+        auto& c = state_.counters;
+        c["ops"] = benchmark::Counter(double(ops));
+        c["allocs"] = benchmark::Counter(double(end.count - start_.count));
+        c["bytes"] = benchmark::Counter(double(end.bytes - start_.bytes));
+        c["p50_ns"] = benchmark::Counter(percentile(0.50), benchmark::Counter::kAvgThreads);
+        c["p99_ns"] = benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+    }
+
+    /// For benchmarks where one iteration is many logical operations: record
+    /// a latency sample that already covers `ops` operations.
+    void add_sample(double total_ns, std::uint64_t ops)
+    {
+        if (samples_.size() < samples_.capacity() && ops)
+            samples_.push_back(total_ns / double(ops));
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // Cost of the two clock reads around a sample, taken off every sample.
+    void calibrate()
+    {
+        double best = 1e9;
+        for (int i = 0; i < 1000; ++i) {
+            auto t0 = clock::now();
+            auto t1 = clock::now();
+            best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count());
+        }
+        overhead_ns_ = best;
+    }
+
+    double percentile(double q)
+    {
+        if (samples_.empty())
+            return 0;
+        auto nth = samples_.begin() + std::ptrdiff_t(q * double(samples_.size() - 1));
+        std::nth_element(samples_.begin(), nth, samples_.end());
+        return *nth;
+    }
+
+    benchmark::State& state_;
+    unsigned every_;
+    std::uint64_t calls_ = 0;
+    double overhead_ns_ = 0;
+    alloc_stats start_;
+    std::vector<double> samples_;
+};
+
+} // namespace yeni::bench
@@ -0,0 +1,88 @@
+#include "bench_util.hpp"
+
+#include "yeni/crc32c.hpp"
+#include "yeni/wal.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace {
+
+std::filesystem::path bench_dir()
+{
+    return std::filesystem::temp_directory_path() / "yeni_bench_wal";
+}
+
+// Every thread appends 128-byte records and waits for each to be durable;
+// the aggregate rate is how far group commit stretches one fdatasync.
+void bm_append_durable(benchmark::State& state)
+{
+    static std::unique_ptr<yeni::wal> log;
+    if (state.thread_index() == 0) {
+        std::filesystem::remove_all(bench_dir());
+        log = std::make_unique<yeni::wal>(bench_dir());
+    }
+    std::vector<std::byte> value(128, std::byte{0x5a});
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] { benchmark::DoNotOptimize(log->append(value)); });
+        ++ops;
+    }
+    probe.finish(ops);
+    if (state.thread_index() == 0) {
+        log.reset();
+        std::filesystem::remove_all(bench_dir());
+    }
+}
+BENCHMARK(bm_append_durable)->Name("wal/append_durable")->Threads(1)->Threads(16)->Threads(64)->UseRealTime();
+
+// One thread keeps `window` appends in flight before waiting on the
+// newest: the pipelined form of the same guarantee.
+void bm_append_pipelined(benchmark::State& state)
+{
+    const auto window = std::uint64_t(state.range(0));
+    std::filesystem::remove_all(bench_dir());
+    std::uint64_t ops = 0;
+    {
+        yeni::wal log(bench_dir());
+        std::vector<std::byte> value(128, std::byte{0x5a});
+        yeni::bench::probe probe(state);
+        for (auto _ : state) {
+            probe.measure([&] {
+                const std::uint64_t lsn = log.append_nowait(value);
+                if (lsn % window == 0)
+                    log.wait_durable(lsn);
+            });
+            ++ops;
+        }
+        probe.finish(ops);
+    }
+    std::filesystem::remove_all(bench_dir());
+}
+BENCHMARK(bm_append_pipelined)->Name("wal/append_pipelined")->Arg(256)->UseRealTime();
+
+void bm_crc32c(benchmark::State& state, bool hardware)
+{
+    if (hardware && !yeni::crc32c_hardware()) {
+        state.SkipWithError("no crc32 instruction");
+        return;
+    }
+    std::vector<std::byte> data(std::size_t(state.range(0)), std::byte{0x5a});
+    yeni::bench::probe probe(state);
+    std::uint64_t ops = 0;
+    for (auto _ : state) {
+        probe.measure([&] {
+            benchmark::DoNotOptimize(hardware ? yeni::crc32c(data) : yeni::crc32c_portable(data));
+        });
+        ++ops;
+    }
+    probe.finish(ops);
+    state.SetBytesProcessed(std::int64_t(ops * data.size()));
+}
+BENCHMARK_CAPTURE(bm_crc32c, hardware, true)->Name("crc32c/hardware")->Arg(64)->Arg(4096)->Arg(65536);
+BENCHMARK_CAPTURE(bm_crc32c, portable, false)->Name("crc32c/portable")->Arg(64)->Arg(4096)->Arg(65536);
+
+} // namespace
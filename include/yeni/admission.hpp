@@ -0,0 +1,187 @@
+#pragma once
+
+#include "yeni/flat_hash_map.hpp"
+#include "yeni/mpsc_queue.hpp"
+#include "yeni/token_bucket.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+namespace yeni {
+
+struct codel_options {
+    /// Queueing delay a queue may keep standing, however long.
+    std::chrono::nanoseconds target = std::chrono::milliseconds(5);
+    /// Window over which the smallest delay seen must stay above `target`
+    /// for the queue to count as overloaded.
+    std::chrono::nanoseconds interval = std::chrono::milliseconds(100);
+};
+
+/// Standing-queue detector after CoDel (Nichols & Jacobson, "Controlling
+/// Queue Delay", ACM Queue 2012).
+///
+/// Consumers report how long each item they dequeue spent queued. A burst
+/// that drains within an interval leaves some small delay in the window,
+/// so only a queue whose minimum delay stayed above target for the whole
+/// interval, one that never caught up, counts as overloaded. That verdict
+/// is what admission_controller rejects new work on, long before anything
+/// queued behind it would time out. Any number of threads may observe.
+///
+/// The monitor only learns from dequeues: without observations for an
+/// interval past the last window, overloaded() reads false again.
+class codel_monitor {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit codel_monitor(codel_options options = {}, clock::time_point now = clock::now()) noexcept;
+
+    codel_monitor(const codel_monitor&) = delete;
+    codel_monitor& operator=(const codel_monitor&) = delete;
+
+    const codel_options& options() const noexcept { return options_; }
+
+    /// An item dequeued at `now` after `sojourn` in the queue. Also
+    /// records it into metrics::histogram::queue_delay.
+    void observe(std::chrono::nanoseconds sojourn, clock::time_point now = clock::now()) noexcept;
+
+    /// The last window's minimum delay exceeded the target.
+    bool overloaded(clock::time_point now = clock::now()) const noexcept;
+    /// Minimum delay of the last window: what a new item would queue for
+    /// at the least, and so the retry-after hint while overloaded.
+    std::chrono::nanoseconds standing_delay() const noexcept
+    {
+        return std::chrono::nanoseconds(standing_.load(std::memory_order_relaxed));
+    }
+
+    /// How long an item may have queued and still be worth serving: the
+    /// interval normally, the target while overloaded, so a backlog is
+    /// cut short instead of served late (the adaptive form of Maurer,
+    /// "Fail at Scale", ACM Queue 2015). For work a consumer may drop.
+    std::chrono::nanoseconds tolerance(clock::time_point now = clock::now()) const noexcept
+    {
+        return overloaded(now) ? options_.target : options_.interval;
+    }
+    bool expired(std::chrono::nanoseconds sojourn, clock::time_point now = clock::now()) const noexcept
+    {
+        return sojourn > tolerance(now);
+    }
+
+private:
+    static constexpr std::int64_t no_delay = INT64_MAX;
+
+    codel_options options_;
+    alignas(64) std::atomic<std::int64_t> window_min_{no_delay};
+    std::atomic<std::int64_t> window_end_;   // clock ticks
+    std::atomic<std::int64_t> standing_{0};  // ns
+    std::atomic<bool> overloaded_{false};
+};
+
+/// consume_batches() that reports every batch's time in the queue to
+/// `delay`. Nothing is dropped: batches carry records already accepted,
+/// so overload is acted on where work enters, through admission_controller.
+template <class T, class F>
+std::size_t consume_batches(mpsc_queue<handoff_batch<T>>& queue, F&& f, codel_monitor& delay,
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max())
+{
+    constexpr std::size_t max_batches = 32;
+    handoff_batch<T> batches[max_batches];
+    std::size_t got = queue.pop_batch(std::span<handoff_batch<T>>(batches, max_batches), timeout);
+    if (got) {
+        const auto now = codel_monitor::clock::now();
+        const std::uint32_t stamp = handoff_clock(now);
+        for (std::size_t b = 0; b < got; ++b)
+            delay.observe(batches[b].age(stamp), now);
+    }
+    std::size_t items = 0;
+    for (std::size_t b = 0; b < got; ++b) {
+        for (const T& item : batches[b].view())
+            f(item);
+        items += batches[b].size;
+    }
+    return items;
+}
+
+struct tenant_limits {
+    /// Cost units per second; 0 for no limit.
+    std::uint64_t rate = 0;
+    /// Units a tenant may spend at once after being idle.
+    std::uint64_t burst = 0;
+};
+
+/// A token_bucket per tenant, created with the default limits on the
+/// tenant's first request. Thread-safe; a known tenant costs a shared lock
+/// on one of the stripes and one compare-and-swap.
+class tenant_limiter {
+public:
+    using clock = token_bucket::clock;
+
+    explicit tenant_limiter(tenant_limits defaults = {});
+
+    /// Limits of `tenant` from now on.
+    void set_limits(std::uint64_t tenant, tenant_limits limits);
+
+    /// Take `cost` units from `tenant`'s bucket: zero when taken, else how
+    /// long until they would be there, with nothing taken. A cost over the
+    /// burst is taken once the bucket is full, leaving the tenant in debt.
+    std::chrono::nanoseconds try_acquire(std::uint64_t tenant, std::uint64_t cost = 1, clock::time_point now = clock::now());
+
+    /// Tenants seen so far.
+    std::size_t tenants() const;
+
+private:
+    static constexpr unsigned stripe_bits = 4;
+
+    struct alignas(64) stripe {
+        mutable std::shared_mutex mutex;
+        flat_hash_map<std::uint64_t, std::unique_ptr<token_bucket>> buckets;
+    };
+
+    token_bucket& bucket(std::uint64_t tenant);
+
+    tenant_limits defaults_;
+    std::array<stripe, 1u << stripe_bits> stripes_;
+};
+
+enum class admission_verdict : std::uint8_t { admitted, rate_limited, overloaded };
+
+struct admission {
+    admission_verdict verdict = admission_verdict::admitted;
+    /// When to try again; zero if admitted.
+    std::chrono::nanoseconds retry_after{};
+
+    explicit operator bool() const noexcept { return verdict == admission_verdict::admitted; }
+};
+
+/// Early rejection on the request path: a request is turned away before
+/// it queues anywhere if a watched queue is overloaded, or if its tenant
+/// is over budget. Either costs a few atomic loads, not a timeout; the
+/// verdict carries a retry-after hint, and rejections are counted in
+/// metrics::counter::admission_rejected_overload / _rate.
+class admission_controller {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit admission_controller(tenant_limits defaults = {}) : tenants_(defaults) {}
+
+    /// Reject while `m` is overloaded. Setup only: not while admit() runs.
+    void watch(const codel_monitor& m) { monitors_.push_back(&m); }
+
+    tenant_limiter& tenants() noexcept { return tenants_; }
+
+    /// Decide on a request of `cost` units from `tenant`. Overload is
+    /// checked first, so shed requests are not charged to their tenant.
+    admission admit(std::uint64_t tenant, std::uint64_t cost = 1, clock::time_point now = clock::now());
+
+private:
+    std::vector<const codel_monitor*> monitors_;
+    tenant_limiter tenants_;
+};
+
+} // namespace yeni
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "yeni/flat_hash_map.hpp"
+#include "yeni/intern.hpp"
+#include "yeni/mpsc_queue.hpp"
+#include "yeni/schema.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace yeni {
+
+class codel_monitor;
+struct record;
+
+enum class aggregate_op : std::uint8_t {
+    count, // rows in the group; takes no field
+    sum,   // u32/u64 sums as u64 and i64 as i64, both wrapping; doubles as double
+    min,
+    max,
+};
+
+struct aggregate_spec {
+    aggregate_op op = aggregate_op::count;
+    std::string field; // numeric field of the view's schema; empty for count
+};
+
+/// count and unsigned sums/min/max are std::uint64_t, i64 ones
+/// std::int64_t, double ones double. A min or max ignores NaNs.
+using aggregate_value = std::variant<std::uint64_t, std::int64_t, double>;
+
+/// One group of an aggregate_view: its key, and one value per spec in
+/// the order the view was given them. A binary key points into the view.
+struct aggregate_group {
+    schema::value key;
+    std::vector<aggregate_value> values;
+};
+
+/// `select <specs> from <records of s> group by <group_by>`, kept up to
+/// date one record at a time instead of recomputed by scanning.
+///
+/// Each thread that applies records folds them into a partial state of
+/// its own, a flat hash map from group key to the group's accumulators,
+/// so applying never writes a line another applier touches and costs a
+/// probe plus a few adds. read() merges the partials, which is work in
+/// the number of groups times the number of threads, not rows. Meant for
+/// low-cardinality keys: every partial holds every group it has seen.
+///
+/// The group key is a u32, u64, i64 or binary field; binary keys are
+/// interned into the view, so they are only copied the first time.
+class aggregate_view {
+public:
+    /// Throws std::invalid_argument for a group_by that is not a u32, u64,
+    /// i64 or binary field of `s`, no specs, or a spec whose field is not
+    /// numeric (or is given for count).
+    aggregate_view(const schema& s, std::string_view group_by, std::vector<aggregate_spec> specs);
+    ~aggregate_view();
+
+    aggregate_view(const aggregate_view&) = delete;
+    aggregate_view& operator=(const aggregate_view&) = delete;
+
+    std::span<const aggregate_spec> specs() const noexcept { return specs_; }
+
+    /// Fold in one record of the schema (a value the schema validated).
+    /// Thread-safe.
+    void apply(std::span<const std::byte> record);
+    /// apply() every record's value, taking the partial's lock once.
+    void apply(std::span<const record* const> records);
+
+    /// Every group seen so far, in ascending key order. Thread-safe; runs
+    /// concurrently with apply(), seeing each partial as of some moment.
+    std::vector<aggregate_group> read() const;
+    /// The values of one group, or nothing if no record had that key.
+    std::optional<std::vector<aggregate_value>> read(const schema::value& key) const;
+
+    /// Forget every group. Thread-safe.
+    void clear();
+
+    /// Partials read() merges: one per thread that has applied records.
+    /// Thread-safe.
+    std::size_t partial_count() const;
+
+private:
+    // One accumulator per spec, resolved against the field's type.
+    enum class kind : std::uint8_t {
+        count,
+        sum_u, sum_i, sum_d,
+        min_u, min_i, min_d,
+        max_u, max_i, max_d,
+    };
+
+    struct step {
+        kind k;
+        segment_format::column_type type;
+        std::uint32_t offset;
+    };
+
+    struct alignas(64) partial {
+        explicit partial(std::uint64_t owner) : owner(owner) {}
+
+        const std::uint64_t owner; // the applying thread's partial_cache::thread
+        mutable std::mutex mutex;
+        flat_hash_map<std::uint64_t, std::uint32_t> groups; // key -> first cell
+        std::vector<std::uint64_t> keys;                    // in order of first sight
+        std::vector<std::uint64_t> cells;                   // specs_.size() per group
+    };
+
+    static void combine(kind k, std::uint64_t& c, std::uint64_t v) noexcept;
+    std::uint64_t key_of(std::span<const std::byte> record);
+    void fold(partial& p, std::span<const std::byte> record);
+    void merge(std::span<std::uint64_t> into, std::span<const std::uint64_t> from) const noexcept;
+    aggregate_group to_group(std::uint64_t key, std::span<const std::uint64_t> cells) const;
+    partial& local_partial();
+    partial& register_partial();
+
+    const std::uint64_t id_;
+    std::vector<aggregate_spec> specs_;
+    std::vector<step> steps_;
+    std::vector<std::uint64_t> initial_; // a new group's cells
+    segment_format::column_type key_type_;
+    std::uint32_t key_offset_;
+    std::unique_ptr<string_interner> strings_; // binary keys only
+    mutable std::mutex partials_mutex_;
+    std::vector<std::unique_ptr<partial>> partials_;
+};
+
+/// Views maintained on ingest, by name. Records handed to apply() or
+/// drained by consume() are folded into every view registered at the
+/// time; a view registered later only counts what comes after.
+class aggregate_registry {
+public:
+    /// Register a view; throws std::invalid_argument if the name is taken,
+    /// or whatever the view's constructor throws. Thread-safe.
+    aggregate_view& add(std::string name, const schema& s, std::string_view group_by,
+        std::vector<aggregate_spec> specs);
+    /// Thread-safe. The view stays valid until remove(name).
+    aggregate_view* find(std::string_view name) const;
+    /// Unregister a view; false if there was none. Must not run while
+    /// another thread still uses the view.
+    bool remove(std::string_view name);
+
+    /// Fold `records` into every view. Thread-safe.
+    void apply(std::span<const record* const> records);
+
+    /// Drain what `queue` holds (waiting up to `timeout` for the first
+    /// batch, like consume_batches()) into every view; returns the number
+    /// of records applied. Reports the batches' queueing delay to `delay`
+    /// if given. Consumer side of the queue only.
+    std::size_t consume(ingest_queue& queue, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max(),
+        codel_monitor* delay = nullptr);
+
+private:
+    struct entry {
+        std::string name;
+        std::unique_ptr<aggregate_view> view;
+    };
+
+    mutable std::shared_mutex mutex_;
+    std::vector<entry> views_;
+};
+
+} // namespace yeni
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "yeni/memory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yeni {
+
+/// Bump allocator over a chain of fixed-size blocks.
+///
+/// An arena is owned by a single thread. Allocation is a pointer bump on the
+/// fast path; memory is only returned wholesale through reset(), which keeps
+/// the standard-sized blocks around so the next batch does not go back to its
+/// memory_provider.
+class arena {
+public:
+    static constexpr std::size_t default_block_size = 256 * 1024;
+
+    /// Blocks come from `memory`, which must outlive the arena.
+    explicit arena(std::size_t block_size = default_block_size,
+        memory_provider& memory = memory_provider::standard());
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t))
+    {
+        auto p = (reinterpret_cast<std::uintptr_t>(cur_) + align - 1) & ~(std::uintptr_t(align) - 1);
+        if (p + size <= reinterpret_cast<std::uintptr_t>(end_)) {
+            cur_ = reinterpret_cast<std::byte*>(p + size);
+            return reinterpret_cast<void*>(p);
+        }
+        return allocate_slow(size, align);
+    }
+
+    /// Drop every allocation. Standard blocks are kept for reuse, oversized
+    /// ones are released.
+    void reset() noexcept;
+
+    /// Bytes handed out since the last reset (excluding alignment padding
+    /// at block tails).
+    std::size_t bytes_used() const noexcept;
+    /// Bytes currently held from the system.
+    std::size_t bytes_reserved() const noexcept { return reserved_; }
+    std::size_t block_size() const noexcept { return block_size_; }
+    memory_provider& memory() const noexcept { return *memory_; }
+
+    /// Visit the used range of every block in allocation order.
+    template <class F>
+    void for_each_block(F&& f) const
+    {
+        for (block* b = head_; b; b = b->next) {
+            std::byte* end = b == current_ ? cur_ : b->used;
+            if (end == nullptr)
+                break;
+            f(b->data(), end);
+            if (b == current_)
+                break;
+        }
+    }
+
+private:
+    struct alignas(std::max_align_t) block {
+        block* next;
+        std::byte* used; // end of the used range once the block is retired
+        std::size_t size;
+
+        std::byte* data() noexcept { return reinterpret_cast<std::byte*>(this + 1); }
+    };
+    static_assert(sizeof(block) % alignof(std::max_align_t) == 0);
+
+    void* allocate_slow(std::size_t size, std::size_t align);
+    block* new_block(std::size_t size);
+    void free_block(block* b) noexcept;
+
+    std::byte* cur_ = nullptr;
+    std::byte* end_ = nullptr;
+    block* head_ = nullptr;
+    block* current_ = nullptr;
+    std::size_t block_size_;
+    std::size_t reserved_ = 0;
+    memory_provider* memory_;
+};
+
+} // namespace yeni
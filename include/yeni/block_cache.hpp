@@ -0,0 +1,155 @@
+#pragma once
+
+#include "yeni/memory.hpp"
+#include "yeni/trace.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace yeni {
+
+struct block_cache_options {
+    /// Bytes of cached block data, pinned blocks included. Never exceeded:
+    /// a block that cannot be made room for is handed out uncached.
+    std::size_t capacity_bytes = std::size_t(256) << 20;
+    /// Power of two; 0 picks one from the hardware thread count.
+    unsigned shards = 0;
+    /// Size of the blocks segment::read_cached() caches. Also sizes the
+    /// entry table of each shard, which evicts early if it runs out of
+    /// entries because blocks are much smaller than this.
+    std::size_t block_bytes = std::size_t(16) << 10;
+    /// Share of each shard's budget given to the probationary FIFO.
+    double small_ratio = 0.1;
+    /// Where block data comes from; must outlive the cache and its handles.
+    /// nullptr for memory_provider::standard().
+    memory_provider* memory = nullptr;
+};
+
+/// Identifies a cached block: a file (see segment::id()) and an offset.
+struct cache_key {
+    std::uint64_t file = 0;
+    std::uint64_t offset = 0;
+
+    friend bool operator==(const cache_key&, const cache_key&) = default;
+};
+
+namespace detail {
+struct cache_entry;
+struct cache_shard;
+} // namespace detail
+
+/// Sharded block cache with S3-FIFO eviction (Yang et al., SOSP '23).
+///
+/// New blocks enter a small probationary FIFO; those read again before
+/// they reach its tail move to the main FIFO, the rest are evicted and
+/// remembered in a ghost table, which sends them straight to main should
+/// they come back. Main evicts in FIFO order, giving blocks one extra lap
+/// per recent read (up to three). A hit therefore only bumps a counter on
+/// the entry: lookups take no lock, and the shard mutex is held by inserts
+/// and evictions only.
+///
+/// A handle pins its block. Pinned blocks are never evicted but still
+/// count against the budget. A block being loaded is pinned by its loader.
+/// Other threads asking for it wait for the load rather than issuing their
+/// own read.
+class block_cache {
+public:
+    /// A pinned block, or nothing. Releasing the handle of an uncached block
+    /// frees it.
+    class handle {
+    public:
+        handle() = default;
+        handle(handle&& other) noexcept { *this = std::move(other); }
+        handle& operator=(handle&& other) noexcept
+        {
+            if (this != &other) {
+                release();
+                entry_ = std::exchange(other.entry_, nullptr);
+                owned_ = std::move(other.owned_);
+                data_ = std::exchange(other.data_, nullptr);
+                size_ = std::exchange(other.size_, 0);
+            }
+            return *this;
+        }
+        ~handle() { release(); }
+
+        handle(const handle&) = delete;
+        handle& operator=(const handle&) = delete;
+
+        explicit operator bool() const noexcept { return entry_ != nullptr || owned_ != nullptr; }
+        std::span<const std::byte> data() const noexcept { return {data_, size_}; }
+        /// True if the block is held by the cache, not just by this handle.
+        bool cached() const noexcept { return entry_ != nullptr; }
+
+        void release() noexcept;
+
+    private:
+        friend class block_cache;
+
+        detail::cache_entry* entry_ = nullptr;
+        memory_ptr owned_; // uncached block
+        std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    explicit block_cache(block_cache_options options = {});
+    /// Every handle must have been released.
+    ~block_cache();
+
+    block_cache(const block_cache&) = delete;
+    block_cache& operator=(const block_cache&) = delete;
+
+    /// Pinned block for `key`, or an empty handle. Waits while another
+    /// thread is loading it.
+    handle lookup(const cache_key& key);
+
+    /// Block for `key`. On a miss, `load(std::span<std::byte>)` fills `size`
+    /// fresh bytes; concurrent misses for the same key load it once. If
+    /// `load` throws, the exception propagates and waiting threads try
+    /// again themselves. `load` must not ask the cache for `key` again.
+    template <class F>
+    handle get(const cache_key& key, std::size_t size, F&& load)
+    {
+        bool loader = false;
+        handle h = acquire(key, size, loader);
+        if (loader) {
+            const trace::span miss(trace::span_kind::cache_miss, size);
+            try {
+                load(std::span<std::byte>(h.data_, h.size_));
+            } catch (...) {
+                abandon(h);
+                throw;
+            }
+            complete(h);
+        }
+        return h;
+    }
+
+    /// get() split up for loaders that complete elsewhere, e.g. through an
+    /// io_context. If `loader` comes back true, the caller must fill
+    /// buffer(h) and then call complete(h) or, on failure, abandon(h).
+    handle acquire(const cache_key& key, std::size_t size, bool& loader);
+    static std::span<std::byte> buffer(handle& h) noexcept { return {h.data_, h.size_}; }
+    void complete(handle& h) noexcept;
+    /// Drops the half-loaded block and releases `h`.
+    void abandon(handle& h) noexcept;
+
+    std::size_t capacity() const noexcept { return options_.capacity_bytes; }
+    std::size_t block_bytes() const noexcept { return options_.block_bytes; }
+    /// Bytes currently charged, pinned blocks included.
+    std::size_t usage() const noexcept;
+
+private:
+    detail::cache_shard& shard_of(std::uint64_t hash) const noexcept;
+    static handle hit(detail::cache_entry* e) noexcept;
+
+    block_cache_options options_;
+    std::uint64_t shard_mask_ = 0;
+    std::vector<std::unique_ptr<detail::cache_shard>> shards_;
+};
+
+} // namespace yeni
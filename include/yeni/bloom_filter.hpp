@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace yeni {
+
+/// Split-block Bloom filter over u64 keys (the layout Impala, Kudu and
+/// Parquet use). A key hashes to one 256-bit block and sets one bit in
+/// each of its eight 32-bit words, so a probe touches a single cache line
+/// and is one AVX2 multiply, shift and test. About 1.3% false positives at
+/// the default 10 bits per key.
+///
+///   header  32 bytes, magic "YENIBLM1", block count
+///   blocks  8 x u32 each
+///
+/// A filter is a view: it reads serialised blocks in place, typically
+/// straight out of a segment mapping.
+class bloom_filter {
+public:
+    static constexpr std::size_t block_bytes = 32;
+    static constexpr std::size_t header_bytes = 32;
+
+    /// Serialised filter holding every one of `keys`.
+    static std::vector<std::byte> build(std::span<const std::uint64_t> keys, double bits_per_key = 10.0);
+
+    /// A filter that passes every key.
+    bloom_filter() = default;
+
+    /// View over build() output, which must outlive the filter. Throws
+    /// format_error if `data` is not a filter.
+    explicit bloom_filter(std::span<const std::byte> data);
+
+    /// False only if `key` was not among the keys the filter was built
+    /// from. Uses AVX2 when the CPU has it.
+    bool may_contain(std::uint64_t key) const noexcept;
+
+    /// may_contain() without SIMD, regardless of CPU (tests, benchmarks).
+    bool may_contain_portable(std::uint64_t key) const noexcept;
+
+    bool empty() const noexcept { return blocks_ == 0; }
+    std::size_t size_bytes() const noexcept { return blocks_ ? header_bytes + std::size_t(blocks_) * block_bytes : 0; }
+
+private:
+    const std::uint32_t* words_ = nullptr;
+    std::uint64_t blocks_ = 0;
+};
+
+/// True when bloom_filter::may_contain() runs on AVX2.
+bool bloom_filter_simd() noexcept;
+
+} // namespace yeni
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace yeni {
+
+class btree_view;
+class segment;
+class segment_writer;
+
+namespace detail {
+
+struct btree_node;
+struct btree_view_source;
+
+/// Entries copied out of one leaf by a scan step, so the caller's
+/// callback never runs on memory other threads may be rewriting.
+struct btree_batch {
+    std::vector<std::byte> keys;     // storage: keys[ends[i-1], ends[i]) is entry i
+    std::vector<std::size_t> ends;
+    std::vector<std::uint64_t> values;
+    std::vector<std::byte> next; // the leaf's upper fence: where to go on
+
+    /// Room for a typical leaf, so a short scan allocates once per vector.
+    btree_batch()
+    {
+        ends.reserve(256);
+        values.reserve(256);
+    }
+
+    std::size_t size() const noexcept { return values.size(); }
+    std::span<const std::byte> key(std::size_t i) const noexcept
+    {
+        const std::size_t begin = i ? ends[i - 1] : 0;
+        return {keys.data() + begin, ends[i] - begin};
+    }
+    void clear() noexcept
+    {
+        ends.clear();
+        values.clear();
+    }
+};
+
+/// Visit lo <= key <= hi of `tree` a leaf at a time through its
+/// next_batch().
+template <class Tree, class F>
+void btree_scan(const Tree& tree, std::span<const std::byte> lo, std::span<const std::byte> hi, F& f)
+{
+    btree_batch batch;
+    std::vector<std::byte> from(lo.begin(), lo.end());
+    bool inclusive = true;
+    for (;;) {
+        const bool more = tree.next_batch(from, inclusive, hi, batch);
+        for (std::size_t i = 0; i < batch.size(); ++i)
+            f(batch.key(i), batch.values[i]);
+        if (!more)
+            return;
+        from.swap(batch.next);
+        inclusive = false;
+    }
+}
+
+} // namespace detail
+
+/// Concurrent in-memory B+tree from byte-string keys to u64 values,
+/// ordered by memcmp.
+///
+/// Nodes are one 4 KiB page. Each stores the prefix its fence keys share
+/// once and only the rest of every key, in a heap at the end of the node;
+/// the slot array at the front holds the first four of those bytes
+/// big-endian beside each heap offset, so a binary search stays within a
+/// few cache lines of slots and only follows a slot into the heap to break
+/// a tie. Leaf splits pick the shortest separator between the two halves.
+///
+/// Concurrency is optimistic lock coupling (Leis et al., 2016): every node
+/// has a version word, readers descend without writing anything and
+/// restart when a version they passed through has moved, and a writer
+/// locks only the node it changes, plus its parent for a split. Inner
+/// nodes that could not take one more separator are split on the way down,
+/// so a split never has to climb. Nodes are never freed before the tree
+/// is (erase() leaves emptied leaves in place), so no reader can be left
+/// holding a dangling one.
+///
+/// serialize() packs the entries into full nodes in the persisted form
+/// btree_view searches in place; save() writes that into a segment.
+class btree_index {
+public:
+    static constexpr std::size_t node_bytes = 4096;
+    static constexpr std::size_t max_key_size = 512;
+
+    btree_index();
+    /// Bulk-load the entries of `from`, leaving nodes part empty so that
+    /// the first inserts do not split every one. Throws format_error if
+    /// they are not in ascending order.
+    explicit btree_index(const btree_view& from);
+    ~btree_index();
+
+    btree_index(const btree_index&) = delete;
+    btree_index& operator=(const btree_index&) = delete;
+
+    /// Add `key`; false, leaving its value alone, if it is already there.
+    /// Throws std::invalid_argument for a key over max_key_size. Thread-safe.
+    bool insert(std::span<const std::byte> key, std::uint64_t value);
+
+    /// Remove `key`; false if it was not there. Thread-safe.
+    bool erase(std::span<const std::byte> key);
+
+    /// Value of `key`, if present. Thread-safe.
+    std::optional<std::uint64_t> find(std::span<const std::byte> key) const;
+
+    /// Call `f(key, value)` for lo <= key <= hi in ascending order. Each
+    /// leaf is a consistent snapshot, the scan as a whole is not: keys
+    /// inserted behind or ahead of it concurrently may or may not be seen.
+    /// Thread-safe.
+    template <class F>
+    void scan(std::span<const std::byte> lo, std::span<const std::byte> hi, F&& f) const
+    {
+        detail::btree_scan(*this, lo, hi, f);
+    }
+
+    std::size_t size() const noexcept { return size_.load(std::memory_order_relaxed); }
+    std::size_t node_count() const noexcept { return nodes_.load(std::memory_order_relaxed); }
+    /// Levels from root to leaf, 1 for a lone leaf.
+    std::size_t height() const noexcept;
+
+    /// The tree in btree_view's format, nodes filled as far as they go.
+    /// May run concurrently with writers, with the guarantees of scan().
+    std::vector<std::byte> serialize() const;
+
+    /// Add serialize() as aux block `name` of `w`.
+    void save(segment_writer& w, std::string_view name) const;
+
+    /// Copy entries from `from` (inclusive, or after it) up to `hi` out
+    /// of the leaf it falls in; true, with batch.next set, unless that
+    /// leaf reaches past `hi` or is the last. Used by scan().
+    bool next_batch(std::span<const std::byte> from, bool inclusive, std::span<const std::byte> hi,
+        detail::btree_batch& batch) const;
+
+private:
+    enum class result { ok, exists, missing, retry };
+
+    result try_insert(std::span<const std::byte> key, std::uint64_t value);
+    result try_erase(std::span<const std::byte> key);
+    detail::btree_node* allocate_node();
+
+    std::atomic<detail::btree_node*> root_;
+    std::atomic<std::size_t> size_{0};
+    std::atomic<std::size_t> nodes_{0};
+};
+
+/// Read-only B+tree in the layout btree_index::serialize() writes,
+/// searched where it lies (typically a segment mapping):
+///
+///   header  64 bytes, magic "YENIBTR1": node size, node count, root
+///           node, height, entry count
+///   nodes   node_bytes each, the in-memory node layout with child
+///           pointers replaced by node numbers
+///
+/// Node contents are bounds-checked as they are visited, so a corrupt
+/// tree throws format_error instead of reading out of bounds.
+class btree_view {
+public:
+    btree_view() = default;
+    /// Check the header against `data`; throws format_error. `data` must
+    /// outlive the view and start on an 8-byte boundary.
+    explicit btree_view(std::span<const std::byte> data);
+
+    /// View over aux block `name` of `s`.
+    static btree_view open(const segment& s, std::string_view name);
+
+    std::size_t size() const noexcept { return entries_; }
+    std::size_t node_count() const noexcept { return nodes_; }
+    std::size_t height() const noexcept { return height_; }
+
+    std::optional<std::uint64_t> find(std::span<const std::byte> key) const;
+
+    template <class F>
+    void scan(std::span<const std::byte> lo, std::span<const std::byte> hi, F&& f) const
+    {
+        detail::btree_scan(*this, lo, hi, f);
+    }
+
+    bool next_batch(std::span<const std::byte> from, bool inclusive, std::span<const std::byte> hi,
+        detail::btree_batch& batch) const;
+
+private:
+    friend struct detail::btree_view_source;
+
+    const std::byte* base_ = nullptr;
+    std::size_t nodes_ = 0;
+    std::uint64_t root_ = 0;
+    std::size_t height_ = 0;
+    std::size_t entries_ = 0;
+};
+
+/// Key encodings whose memcmp order is the numeric order of the value.
+template <class T>
+struct index_key;
+
+template <class T>
+    requires std::is_integral_v<T> && std::is_unsigned_v<T>
+struct index_key<T> {
+    static constexpr std::size_t size = sizeof(T);
+    static T big_endian(T v) noexcept
+    {
+        if constexpr (std::endian::native == std::endian::big || sizeof(T) == 1)
+            return v;
+        else if constexpr (sizeof(T) == 2)
+            return T(__builtin_bswap16(v));
+        else if constexpr (sizeof(T) == 4)
+            return T(__builtin_bswap32(v));
+        else
+            return T(__builtin_bswap64(v));
+    }
+    static void encode(T v, std::byte* out) noexcept
+    {
+        v = big_endian(v);
+        std::memcpy(out, &v, sizeof(v));
+    }
+    static T decode(const std::byte* in) noexcept
+    {
+        T v;
+        std::memcpy(&v, in, sizeof(v));
+        return big_endian(v);
+    }
+};
+
+template <>
+struct index_key<std::int64_t> {
+    static constexpr std::size_t size = 8;
+    static constexpr std::uint64_t sign = std::uint64_t(1) << 63;
+    static void encode(std::int64_t v, std::byte* out) noexcept
+    {
+        index_key<std::uint64_t>::encode(std::uint64_t(v) ^ sign, out);
+    }
+    static std::int64_t decode(const std::byte* in) noexcept
+    {
+        return std::int64_t(index_key<std::uint64_t>::decode(in) ^ sign);
+    }
+};
+
+/// Negative doubles have every bit flipped, the rest only the sign, which
+/// orders them as numbers (-0.0 just below 0.0, NaNs at either end).
+template <>
+struct index_key<double> {
+    static constexpr std::size_t size = 8;
+    static constexpr std::uint64_t sign = std::uint64_t(1) << 63;
+    static void encode(double v, std::byte* out) noexcept
+    {
+        const auto bits = std::bit_cast<std::uint64_t>(v);
+        index_key<std::uint64_t>::encode(bits & sign ? ~bits : bits | sign, out);
+    }
+    static double decode(const std::byte* in) noexcept
+    {
+        const std::uint64_t bits = index_key<std::uint64_t>::decode(in);
+        return std::bit_cast<double>(bits & sign ? bits & ~sign : ~bits);
+    }
+};
+
+/// Secondary index over a column: the (value, id) pairs of every row, in
+/// value order, where id is whatever names the row to the caller (a
+/// primary key, a row number). Each pair is one tree key, the encoded
+/// value followed by the id big-endian, so duplicates of a value sit
+/// together ordered by id and a range query is a single tree scan.
+///
+/// `Tree` is btree_index (secondary_index) or, for an index saved into a
+/// segment, btree_view (secondary_index_view), which is read-only.
+/// Supported value types: std::uint32_t, std::uint64_t, std::int64_t,
+/// double.
+template <class T, class Tree>
+class basic_secondary_index {
+public:
+    static constexpr std::size_t key_size = index_key<T>::size + sizeof(std::uint64_t);
+    using key_type = std::array<std::byte, key_size>;
+
+    basic_secondary_index() = default;
+    explicit basic_secondary_index(Tree tree)
+        requires std::is_move_constructible_v<Tree>
+        : tree_(std::move(tree))
+    {
+    }
+    explicit basic_secondary_index(const btree_view& from)
+        requires std::is_same_v<Tree, btree_index>
+        : tree_(from)
+    {
+    }
+
+    static key_type key(T value, std::uint64_t id) noexcept
+    {
+        key_type k;
+        index_key<T>::encode(value, k.data());
+        index_key<std::uint64_t>::encode(id, k.data() + index_key<T>::size);
+        return k;
+    }
+
+    bool insert(T value, std::uint64_t id)
+        requires std::is_same_v<Tree, btree_index>
+    {
+        return tree_.insert(key(value, id), 0);
+    }
+
+    bool erase(T value, std::uint64_t id)
+        requires std::is_same_v<Tree, btree_index>
+    {
+        return tree_.erase(key(value, id));
+    }
+
+    bool contains(T value, std::uint64_t id) const { return tree_.find(key(value, id)).has_value(); }
+
+    /// Call `f(value, id)` for every row with lo <= value <= hi, ascending
+    /// by value, then id.
+    template <class F>
+    void range(T lo, T hi, F&& f) const
+    {
+        const key_type from = key(lo, 0), to = key(hi, ~std::uint64_t(0));
+        tree_.scan(from, to, [&](std::span<const std::byte> k, std::uint64_t) {
+            f(index_key<T>::decode(k.data()), index_key<std::uint64_t>::decode(k.data() + index_key<T>::size));
+        });
+    }
+
+    /// Ids of the rows holding `value`, ascending.
+    template <class F>
+    void equal(T value, F&& f) const
+    {
+        range(value, value, [&](T, std::uint64_t id) { f(id); });
+    }
+
+    std::size_t size() const noexcept { return tree_.size(); }
+    const Tree& tree() const noexcept { return tree_; }
+
+private:
+    Tree tree_;
+};
+
+template <class T>
+using secondary_index = basic_secondary_index<T, btree_index>;
+template <class T>
+using secondary_index_view = basic_secondary_index<T, btree_view>;
+
+/// Index of column `column` of `s`, with row numbers for ids. Reads packed
+/// columns a page at a time (segment::scan()).
+template <class T>
+void build_secondary_index(const segment& s, std::string_view column, secondary_index<T>& out);
+
+} // namespace yeni
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "yeni/codec.hpp"
+#include "yeni/schema.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace yeni {
+
+class record_store;
+class segment;
+
+enum class text_format : std::uint8_t {
+    csv,    // RFC 4180: quoted fields may hold separators, quotes ("") and newlines
+    ndjson, // one JSON object per line, keys naming fields
+};
+
+/// Bulk loads and exports run as a pipeline of threads over chunks of
+/// the text, each stage handing the next a bounded pool of buffers:
+///
+///   import  reader -> parsers -> the calling thread (the sink)
+///   export  the calling thread (the source) -> formatters -> writer
+///
+/// A stage that gets ahead waits for a free buffer, so memory stays near
+/// 2 * (threads + queue_depth) * chunk_bytes however large the input is,
+/// and the file is read or written in order while chunks are parsed or
+/// formatted in parallel.
+struct bulk_options {
+    text_format format = text_format::csv;
+    /// Text per chunk. A chunk holds whole records, so one record longer
+    /// than this grows its chunk.
+    std::size_t chunk_bytes = std::size_t(4) << 20;
+    /// Chunks a stage may run ahead of the one after it.
+    std::size_t queue_depth = 4;
+    /// Parser (formatter) threads; 0 for one per CPU besides the reader
+    /// (writer) and the calling thread, at least one.
+    std::size_t threads = 0;
+    /// CSV only: field separator, and whether the first line names the
+    /// columns (matched to schema fields by name, unknown ones skipped)
+    /// rather than holding the fields in schema order. Exports write one.
+    char delimiter = ',';
+    bool header = true;
+};
+
+struct bulk_stats {
+    std::uint64_t rows = 0;
+    std::uint64_t bytes = 0; // text read or written
+};
+
+/// Called on the importing thread with each batch of records, encoded in
+/// the schema's layout, in input order. The spans are only valid during
+/// the call.
+using bulk_sink = std::function<void(std::span<const std::span<const std::byte>> records)>;
+
+/// Called on the exporting thread with an `emit` to call for each record
+/// to write, in the schema's layout; `emit` copies it.
+using bulk_emit = std::function<void(std::span<const std::byte> record)>;
+using bulk_source = std::function<void(const bulk_emit& emit)>;
+
+/// Parse `in` into records of `s`.
+///
+/// Each chunk is indexed simdjson-style before it is parsed: a pass with
+/// AVX2 (unless active_simd_level() is scalar) turns every 64 bytes into
+/// bitmasks of the quotes, escapes and separators, prefix-XOR of the
+/// quote mask marks what lies inside strings, and the parser then jumps
+/// from one structural character to the next instead of testing bytes.
+///
+/// Numbers must parse whole (std::from_chars) as the field's type. NDJSON
+/// keys missing from a line leave their field 0 or empty, as does null;
+/// a binary field takes string values unescaped and anything else as its
+/// JSON text. Throws format_error, naming the byte offset of the bad
+/// record, or std::system_error; either stops every stage first.
+bulk_stats import_text(const std::filesystem::path& in, const schema& s, const bulk_sink& sink,
+    const bulk_options& options = {});
+
+/// import_text() into `store`, keyed by the u64 field `key_field`, a
+/// batch per append_many().
+bulk_stats import_text(const std::filesystem::path& in, const schema& s, record_store& store,
+    std::string_view key_field, const bulk_options& options = {});
+
+/// Write the records `source` emits, in the schema's layout, to `out` as
+/// text. NaN and infinite doubles become null in NDJSON; binary fields
+/// are written as they are, so they should hold UTF-8 for NDJSON. Like
+/// segment_writer, writes `out` under a temporary name and renames it
+/// into place once it is complete and synced.
+bulk_stats export_text(const std::filesystem::path& out, const schema& s, const bulk_source& source,
+    const bulk_options& options = {});
+
+/// Export every row of segment `in`, with the schema segment_schema()
+/// reads off it.
+bulk_stats export_text(const std::filesystem::path& out, const segment& in, const bulk_options& options = {});
+
+/// Schema with a field per column block of `s`, in file order.
+schema segment_schema(const segment& s);
+
+/// Rows of segment `in` as records of `s`, whose fields name columns of
+/// `in` with their types. Encoded columns are decoded whole on first use
+/// (segment::column()).
+bulk_source segment_source(const segment& in, const schema& s);
+
+/// Sink writing the records it is given into a series of segments of
+/// `rows_per_segment` rows, one column per field: `prefix`-000000.seg,
+/// `prefix`-000001.seg and so on. Buffers one segment's records. Pass it
+/// to import_text() as std::ref(sink).
+class segment_sink {
+public:
+    segment_sink(std::filesystem::path prefix, schema s, std::size_t rows_per_segment = std::size_t(1) << 20,
+        const codec_options& codec = {});
+
+    segment_sink(const segment_sink&) = delete;
+    segment_sink& operator=(const segment_sink&) = delete;
+
+    void operator()(std::span<const std::span<const std::byte>> records);
+
+    /// Write the last, partial segment.
+    void finish();
+
+    /// Segments written so far.
+    const std::vector<std::filesystem::path>& files() const noexcept { return files_; }
+
+private:
+    void flush();
+
+    std::filesystem::path prefix_;
+    schema schema_;
+    std::size_t rows_per_segment_;
+    codec_options codec_;
+    std::vector<std::byte> data_;
+    std::vector<std::size_t> ends_;
+    std::vector<std::filesystem::path> files_;
+};
+
+} // namespace yeni
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace yeni {
+
+/// How a segment column block is stored (block_desc::encoding).
+///
+/// The packed encodings split a fixed-width column into pages of
+/// packed_page_rows rows and bit-pack each page on its own, so any page
+/// decodes without its neighbours:
+///
+///   frame_of_reference  x - the page minimum
+///   delta               x[i] - x[i-1] - the page's smallest step; sorted
+///                       keys and timestamps pack to a few bits a row
+///   dictionary          index into the column's distinct values
+///
+/// Packed values are laid out across eight 32-bit lanes (value i in lane
+/// i % 8), so AVX2 unpacks eight rows per shift-and-mask whatever the
+/// width. lz4 and zstd compress the plain block whole.
+///
+/// front_coded is for binary columns of redundant strings (URLs, prefixed
+/// ids): rows go in buckets of front_coded_bucket_rows, and every row but
+/// a bucket's first stores only what follows the prefix it shares with
+/// the row before. It is read in place, a bucket at a time.
+enum class column_encoding : std::uint8_t {
+    plain = 0,
+    frame_of_reference = 1,
+    delta = 2,
+    dictionary = 3,
+    lz4 = 4,
+    zstd = 5,
+    front_coded = 6,
+};
+
+std::string_view to_string(column_encoding e) noexcept;
+
+/// Rows per page of a packed column. A multiple of 64, so pages fill
+/// whole selection_bitmap words.
+inline constexpr std::size_t packed_page_rows = 1024;
+
+/// Rows per front-coded bucket; a row is rebuilt from at most this many.
+inline constexpr std::size_t front_coded_bucket_rows = 16;
+
+constexpr bool is_packed(column_encoding e) noexcept
+{
+    return e == column_encoding::frame_of_reference || e == column_encoding::delta
+        || e == column_encoding::dictionary;
+}
+
+/// False when built without libzstd: zstd blocks are then neither written
+/// nor readable.
+bool zstd_supported() noexcept;
+
+struct codec_options {
+    /// Pick an encoding per column; off, every column is written plain.
+    bool encode = true;
+    /// Rows the choice is made from, taken as whole pages spread over the
+    /// column.
+    std::size_t sample_rows = 4 * packed_page_rows;
+    /// Tried on fixed-width columns no packed encoding suits: lz4, zstd, or
+    /// plain for none.
+    column_encoding general = column_encoding::lz4;
+    /// Codec for binary columns: lz4, zstd, front_coded or plain. Anything
+    /// but plain makes segment::binary() decode the column whole into
+    /// memory on first use, so it is off by default; front-coded columns
+    /// are also readable in place through segment::front_coded() and the
+    /// string predicates.
+    column_encoding binary = column_encoding::plain;
+    int zstd_level = 3;
+    /// Share of the plain size an encoding must save to be used.
+    double min_saving = 0.125;
+};
+
+/// Encoding for `values`, estimated from a sample: the packed width of
+/// each sampled page under frame-of-reference and delta, the sample's
+/// distinct values for a dictionary, and a trial compression of the
+/// sample for options.general. Plain if nothing saves options.min_saving.
+///
+/// Supported element types: std::uint32_t, std::uint64_t, std::int64_t,
+/// double (dictionary and general codecs only).
+template <class T>
+column_encoding choose_encoding(std::span<const T> values, const codec_options& options = {});
+
+/// `values` in packed encoding `e`, or empty if `e` cannot hold them: a
+/// page spanning more than 32 bits, more than 65536 distinct values, or
+/// frame-of-reference or delta over doubles.
+template <class T>
+std::vector<std::byte> encode_packed(std::span<const T> values, column_encoding e);
+
+/// `data` compressed with lz4 or zstd.
+std::vector<std::byte> compress_block(std::span<const std::byte> data, column_encoding e, int zstd_level = 3);
+
+/// Size compress_block() input had. Throws format_error if `block` is too
+/// short to be one.
+std::size_t decompressed_size(std::span<const std::byte> block);
+
+/// Most bytes `block`, compressed with `e`, can expand to given its
+/// compressed size: 255x for lz4, 32768x (a run-length block of 128 KiB
+/// in four bytes) for zstd. A larger decompressed_size() is corrupt, and
+/// trusting it would let a few bytes of file allocate anything.
+std::size_t max_decompressed_size(std::span<const std::byte> block, column_encoding e) noexcept;
+
+/// Inverse of compress_block(); `out` must be decompressed_size() long.
+/// Throws format_error on a corrupt block.
+void decompress_block(std::span<const std::byte> block, column_encoding e, std::span<std::byte> out);
+
+/// `raw`, a binary column of `rows` rows in the plain layout (rows + 1 u64
+/// offsets, then the bytes), front-coded.
+std::vector<std::byte> encode_front_coded(std::span<const std::byte> raw, std::size_t rows);
+
+namespace detail {
+
+struct front_coded_header {
+    std::uint64_t rows;
+    std::uint64_t buckets;
+    std::uint64_t data_bytes;  // bytes of row data after the bucket offsets
+    std::uint64_t plain_bytes; // bytes of the rows rebuilt
+};
+static_assert(sizeof(front_coded_header) == 32);
+
+// LEB128, the length fields of front-coded rows. Returns nullptr if the
+// value runs past `end` or over 64 bits.
+inline const std::byte* read_varint(const std::byte* p, const std::byte* end, std::uint64_t& v) noexcept
+{
+    v = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        const auto b = std::uint64_t(*p++);
+        v |= (b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return p;
+    }
+    return nullptr;
+}
+
+struct packed_header {
+    std::uint64_t rows;
+    std::uint32_t pages;
+    std::uint32_t dict_size; // dictionary: 1 << width entries
+    std::uint64_t words;     // u32 words of packed data
+    std::uint32_t width;     // dictionary code width
+    std::uint32_t reserved;
+};
+static_assert(sizeof(packed_header) == 32);
+
+struct page_desc {
+    std::uint64_t base; // frame of reference, or the first value for delta
+    std::uint64_t step; // delta: smallest step, added back to each one
+    std::uint32_t word_offset;
+    std::uint8_t width;
+    std::uint8_t reserved[3];
+};
+static_assert(sizeof(page_desc) == 24);
+
+} // namespace detail
+
+/// View over encode_packed() output, read in place.
+template <class T>
+class packed_column {
+public:
+    /// Checks the page directory against `data` so that decoding never
+    /// reads out of bounds; throws format_error.
+    packed_column(std::span<const std::byte> data, column_encoding e);
+
+    std::size_t size() const noexcept { return std::size_t(header_->rows); }
+    std::size_t pages() const noexcept { return header_->pages; }
+    /// Bytes the packed form occupies.
+    std::size_t size_bytes() const noexcept { return size_bytes_; }
+
+    /// Decode page `page` into `out`; returns its row count, which is
+    /// packed_page_rows but for the last page. Uses AVX2 unless
+    /// active_simd_level() is scalar.
+    std::size_t decode_page(std::size_t page, T* out) const noexcept;
+
+    /// Decode every row; `out` must hold size() values.
+    void decode(std::span<T> out) const noexcept;
+
+private:
+    column_encoding encoding_;
+    const detail::packed_header* header_ = nullptr;
+    const detail::page_desc* pages_ = nullptr;
+    const std::byte* dict_ = nullptr;
+    const std::uint32_t* words_ = nullptr;
+    std::size_t size_bytes_ = 0;
+};
+
+/// View over encode_front_coded() output, read in place.
+///
+///   header          detail::front_coded_header
+///   bucket offsets  buckets + 1 u64, into the row data
+///   row data        per row: varint shared, varint suffix length, suffix;
+///                   shared is 0 for the first row of a bucket
+class front_coded_column {
+public:
+    front_coded_column() = default;
+    /// Checks the header and bucket offsets against `data`; the rows
+    /// themselves are checked as they are read. Throws format_error.
+    explicit front_coded_column(std::span<const std::byte> data);
+
+    std::size_t size() const noexcept { return std::size_t(header_->rows); }
+    std::size_t buckets() const noexcept { return std::size_t(header_->buckets); }
+    /// Bytes the encoded form occupies: plain_bytes() for the rows rebuilt.
+    std::size_t size_bytes() const noexcept { return size_bytes_; }
+    std::size_t plain_bytes() const noexcept { return std::size_t(header_->plain_bytes); }
+
+    /// Call `f(row, shared, suffix)` for every row of bucket `b` in order:
+    /// row `row` is the first `shared` bytes of the row before followed by
+    /// `suffix`. Throws format_error on a damaged bucket.
+    template <class F>
+    void for_each_in_bucket(std::size_t b, F&& f) const
+    {
+        const std::byte* p = data_ + offsets_[b];
+        const std::byte* end = data_ + offsets_[b + 1];
+        const std::size_t first = b * front_coded_bucket_rows;
+        const std::size_t last = std::min(size(), first + front_coded_bucket_rows);
+        std::uint64_t prev = 0;
+        for (std::size_t row = first; row < last; ++row) {
+            std::uint64_t shared = 0, n = 0;
+            if (!(p = detail::read_varint(p, end, shared)) || !(p = detail::read_varint(p, end, n))
+                || std::uint64_t(end - p) < n || shared > prev || (row == first && shared))
+                damaged();
+            f(row, std::size_t(shared), std::span<const std::byte>(p, std::size_t(n)));
+            p += n;
+            prev = shared + n;
+        }
+    }
+
+    /// for_each_in_bucket() over every bucket.
+    template <class F>
+    void for_each(F&& f) const
+    {
+        for (std::size_t b = 0; b < buckets(); ++b)
+            for_each_in_bucket(b, f);
+    }
+
+    /// Row `i` rebuilt into `out`, which is returned.
+    std::span<const std::byte> row(std::size_t i, std::vector<std::byte>& out) const;
+
+    /// Every row in the plain binary layout, for segment::binary().
+    void decode(std::vector<std::byte>& out) const;
+
+private:
+    [[noreturn]] static void damaged();
+
+    const detail::front_coded_header* header_ = nullptr;
+    const std::uint64_t* offsets_ = nullptr;
+    const std::byte* data_ = nullptr;
+    std::size_t size_bytes_ = 0;
+};
+
+} // namespace yeni
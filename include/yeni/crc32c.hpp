@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace yeni {
+
+/// CRC-32C (Castagnoli polynomial, as in iSCSI, ext4 and most storage
+/// engines). Pass a previous result as `crc` to checksum data in pieces:
+/// crc32c(b, crc32c(a)) == crc32c(a + b).
+///
+/// Uses the SSE4.2 crc32 instruction, three streams interleaved, when the
+/// CPU has it; otherwise a slicing-by-8 table.
+std::uint32_t crc32c(std::span<const std::byte> data, std::uint32_t crc = 0) noexcept;
+
+/// True when crc32c() runs on the hardware instruction.
+bool crc32c_hardware() noexcept;
+
+/// The table implementation, regardless of CPU (tests, benchmarks).
+std::uint32_t crc32c_portable(std::span<const std::byte> data, std::uint32_t crc = 0) noexcept;
+
+} // namespace yeni
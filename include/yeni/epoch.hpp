@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Epoch-based memory reclamation (Fraser, 2004), one domain per process.
+///
+/// A reader holds a guard while it follows pointers to shared objects. A
+/// writer unlinks an object and retire()s it rather than deleting it. The
+/// object is freed once the global epoch has moved forward twice, which
+/// only happens after every thread pinned in the object's epoch has
+/// dropped its guard. Entering and leaving a guard touch only the calling
+/// thread's own cache line: a store and a fence, with no shared
+/// read-modify-write the way copying a shared_ptr has.
+///
+/// A guard held for a long time (a scan) delays reclamation for everybody,
+/// never progress.
+namespace yeni::epoch {
+
+namespace detail {
+
+/// A thread's announcement: the global epoch it pinned at, shifted left
+/// and with the low bit set, or 0 while it holds no guard.
+struct alignas(64) participant {
+    std::atomic<std::uint64_t> state{0};
+    unsigned depth = 0; // nested guards, owner only
+    std::atomic<bool> in_use{false};
+    participant* next = nullptr;
+};
+
+extern std::atomic<std::uint64_t> global_epoch;
+
+/// The calling thread's participant, claimed on first use.
+participant& local() noexcept;
+
+} // namespace detail
+
+/// Pins the calling thread for its lifetime. Nests.
+class guard {
+public:
+    guard() noexcept : p_(detail::local())
+    {
+        if (p_.depth++ == 0) {
+            p_.state.store(detail::global_epoch.load(std::memory_order_relaxed) << 1 | 1, std::memory_order_relaxed);
+            // Announce before reading any shared pointer; pairs with the
+            // fence in the collector's scan.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    ~guard()
+    {
+        if (--p_.depth == 0)
+            p_.state.store(0, std::memory_order_release);
+    }
+
+    guard(const guard&) = delete;
+    guard& operator=(const guard&) = delete;
+
+private:
+    detail::participant& p_;
+};
+
+/// Free `p` with `fn` once no guard that could have seen it remains. `p`
+/// must already be unreachable for new readers.
+void retire(void* p, void (*fn)(void*) noexcept);
+
+template <class T>
+void retire(const T* p)
+{
+    retire(const_cast<T*>(p), [](void* q) noexcept { delete static_cast<T*>(q); });
+}
+
+/// For objects the caller keeps to reuse rather than retires: once
+/// reclaimable() holds for a stamp() taken after the object was unlinked,
+/// no guard that could have seen it remains.
+std::uint64_t stamp() noexcept;
+bool reclaimable(std::uint64_t stamp) noexcept;
+
+/// Advance the epoch if every pinned thread has caught up, and free what
+/// that makes safe. retire() calls this itself.
+void collect();
+
+/// Block until everything retired before the call has been freed. Must
+/// not be called while holding a guard.
+void synchronize();
+
+/// Objects retired and not yet freed.
+std::size_t pending();
+
+} // namespace yeni::epoch
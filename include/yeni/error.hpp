@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace yeni {
+
+/// Thrown when on-disk data does not match the format it claims to be.
+class format_error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// Throw std::system_error for the current errno, prefixed with `what`.
+[[noreturn]] inline void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), "yeni: " + what);
+}
+
+} // namespace yeni
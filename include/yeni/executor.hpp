@@ -0,0 +1,232 @@
+#pragma once
+
+#include "yeni/predicate.hpp"
+#include "yeni/segment.hpp"
+#include "yeni/selection.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace yeni {
+
+class scheduler;
+
+namespace detail {
+struct morsel;
+struct query_state;
+} // namespace detail
+
+/// Input of a pipeline: the rows of `seg` that `selection` (one bit per
+/// row) has set, or every row.
+struct scan_source {
+    const segment* seg = nullptr;
+    const selection_bitmap* selection = nullptr;
+};
+
+/// What a pipeline hands its sink: rows [first_row, first_row + rows) of
+/// source `source`, at most packed_page_rows of them, with the ones that
+/// passed every filter set in `selection` (bit i for row first_row + i).
+/// A vector with no row selected is never handed on. Valid only during the
+/// sink call.
+struct row_vector {
+    std::size_t source;
+    const segment* seg;
+    std::uint64_t first_row;
+    std::size_t rows;
+    const selection_bitmap& selection;
+    /// Driver running the vector, below query_executor::slots(). A driver
+    /// runs one vector at a time, so sinks can keep state per slot and
+    /// merge it once the query is done, without locking.
+    unsigned slot;
+    std::span<const void* const> columns;
+
+    /// Column `k` of the pipeline's projections, in the order project()
+    /// added them, over every row of the vector: read in place, or decoded
+    /// into a buffer of the driver's if it is packed.
+    template <class T>
+    std::span<const T> column(std::size_t k) const
+    {
+        return {static_cast<const T*>(columns[k]), rows};
+    }
+};
+
+using vector_sink = std::function<void(const row_vector&)>;
+
+/// Scan, filter, project and sink over a set of segments, the unit a
+/// query_executor runs.
+///
+/// Filters run in the order they were added, a vector at a time, through
+/// the same kernels as filter_compare(); a vector whose selection runs
+/// empty skips the remaining filters and its projections, which are only
+/// decoded for vectors that reach the sink.
+class pipeline {
+public:
+    explicit pipeline(std::vector<scan_source> sources) : sources_(std::move(sources)) {}
+
+    /// column op value.
+    template <class T>
+    pipeline& where(std::string_view column, compare_op op, T value)
+    {
+        filters_.push_back({{std::string(column), type_of<T>()}, false, op, bits(value), 0});
+        return *this;
+    }
+
+    /// lo <= column && column <= hi.
+    template <class T>
+    pipeline& where_between(std::string_view column, T lo, T hi)
+    {
+        filters_.push_back({{std::string(column), type_of<T>()}, true, compare_op::eq, bits(lo), bits(hi)});
+        return *this;
+    }
+
+    /// Hand column `column` to the sink; see row_vector::column().
+    template <class T>
+    pipeline& project(std::string_view column)
+    {
+        projections_.push_back({std::string(column), type_of<T>()});
+        return *this;
+    }
+
+    /// Called for every vector with a row selected, on executor drivers
+    /// and so concurrently. An exception stops the query and is rethrown
+    /// from its query_handle::wait().
+    pipeline& sink(vector_sink f)
+    {
+        sink_ = std::move(f);
+        return *this;
+    }
+
+private:
+    friend class query_executor;
+    friend struct detail::query_state;
+
+    struct column_ref {
+        std::string name;
+        segment_format::column_type type;
+    };
+
+    struct filter_step {
+        column_ref column;
+        bool range;
+        compare_op op;
+        std::uint64_t lo, hi; // the values' bits
+    };
+
+    template <class T>
+    static constexpr segment_format::column_type type_of() noexcept
+    {
+        static_assert(segment_format::type_of<T> != segment_format::column_type::none
+                && segment_format::type_of<T> != segment_format::column_type::binary,
+            "pipelines read fixed-width columns");
+        return segment_format::type_of<T>;
+    }
+
+    template <class T>
+    static std::uint64_t bits(T v) noexcept
+    {
+        std::uint64_t b = 0;
+        std::memcpy(&b, &v, sizeof(v));
+        return b;
+    }
+
+    std::vector<scan_source> sources_;
+    std::vector<filter_step> filters_;
+    std::vector<column_ref> projections_;
+    vector_sink sink_;
+};
+
+struct executor_options {
+    /// Runs the drivers; null for scheduler::instance().
+    scheduler* sched = nullptr;
+    /// Rows per morsel, the unit drivers claim; rounded up to a multiple
+    /// of packed_page_rows.
+    std::size_t morsel_rows = 100000;
+    /// Drivers at most, shared by every query; 0 for one per worker.
+    unsigned max_drivers = 0;
+};
+
+/// A submitted pipeline.
+class query_handle {
+public:
+    query_handle() = default;
+
+    /// Every morsel has run, or the query failed and the ones running
+    /// have finished.
+    bool done() const noexcept;
+    /// Wait until done(), running other tasks meanwhile, and rethrow the
+    /// first exception of the sink.
+    void wait() const;
+
+    std::size_t morsels() const noexcept;
+    /// Drivers running the query's morsels right now.
+    unsigned dop() const noexcept;
+
+private:
+    friend class query_executor;
+
+    std::shared_ptr<detail::query_state> state_;
+    scheduler* sched_ = nullptr;
+};
+
+/// Morsel-driven pipeline execution (Leis et al., "Morsel-Driven
+/// Parallelism", SIGMOD'14) on the work-stealing scheduler.
+///
+/// A submitted pipeline is cut into morsels of morsel_rows rows, each filed
+/// under the NUMA node holding its first column page. A fixed set of
+/// drivers, scheduler tasks shared by every query, claims one morsel at a
+/// time: from the query with the fewest drivers on it, from its own node's
+/// morsels before another's. Degrees of parallelism are therefore not
+/// fixed per query but follow the load: a query starts on the idle
+/// drivers, a newcomer draws drivers over at their next morsel boundary
+/// until the queries share them evenly, and a finished query's drivers go
+/// to the ones still running. Within a morsel, work happens a vector of
+/// packed_page_rows rows at a time, which keeps every column page a
+/// filter decodes in L1.
+class query_executor {
+public:
+    explicit query_executor(executor_options options = {});
+    /// Waits for every submitted query.
+    ~query_executor();
+
+    query_executor(const query_executor&) = delete;
+    query_executor& operator=(const query_executor&) = delete;
+
+    /// Number of drivers, the bound of row_vector::slot.
+    unsigned slots() const noexcept { return unsigned(drivers_.size()); }
+    std::size_t morsel_rows() const noexcept { return morsel_rows_; }
+
+    /// Start `p`. Throws std::invalid_argument, before anything runs, for
+    /// a pipeline without a sink, a missing source segment, a selection
+    /// whose size is not its segment's row count, or a column missing from
+    /// a source or not of the type the pipeline names.
+    query_handle submit(const pipeline& p);
+    /// submit(p).wait().
+    void run(const pipeline& p) { submit(p).wait(); }
+
+private:
+    struct driver;
+
+    static void drive(driver& d) noexcept;
+    std::shared_ptr<detail::query_state> claim(driver& d, unsigned node, detail::morsel& m);
+    std::size_t queue_of_node(unsigned node) const noexcept;
+
+    scheduler& sched_;
+    const std::size_t morsel_rows_;
+    std::vector<unsigned> nodes_; // NUMA node of each morsel queue
+    std::vector<std::unique_ptr<driver>> drivers_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<detail::query_state>> active_; // with morsels left to claim
+    std::vector<unsigned> idle_;                               // drivers not spawned
+    std::atomic<unsigned> running_{0};
+};
+
+} // namespace yeni
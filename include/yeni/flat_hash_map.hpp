@@ -0,0 +1,534 @@
+#pragma once
+
+#include "yeni/hash.hpp"
+#include "yeni/memory.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace yeni {
+
+namespace detail {
+
+/// Control byte of one slot: full slots store the low 7 bits of the hash,
+/// everything else is negative so a single signed compare finds free slots.
+using ctrl_t = std::int8_t;
+inline constexpr ctrl_t ctrl_empty = -128;
+inline constexpr ctrl_t ctrl_deleted = -2;
+inline constexpr ctrl_t ctrl_sentinel = -1;
+
+/// Matching positions inside a probe group. `Shift` converts a bit index
+/// into a slot index (3 for the byte-per-slot SWAR encoding).
+template <class T, int Shift>
+struct group_mask {
+    T bits;
+
+    explicit operator bool() const noexcept { return bits != 0; }
+    unsigned lowest() const noexcept { return unsigned(std::countr_zero(bits)) >> Shift; }
+    void clear_lowest() noexcept { bits &= bits - 1; }
+};
+
+#if defined(__AVX2__)
+
+struct group {
+    static constexpr std::size_t width = 32;
+    using mask = group_mask<std::uint32_t, 0>;
+
+    explicit group(const ctrl_t* p) noexcept : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))) {}
+
+    mask match(std::uint8_t h2) const noexcept
+    {
+        return {std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(char(h2)), ctrl)))};
+    }
+    mask match_empty() const noexcept
+    {
+        return {std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(ctrl_empty), ctrl)))};
+    }
+    mask match_empty_or_deleted() const noexcept
+    {
+        return {std::uint32_t(_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(ctrl_sentinel), ctrl)))};
+    }
+
+    __m256i ctrl;
+};
+
+#elif defined(__SSE2__)
+
+struct group {
+    static constexpr std::size_t width = 16;
+    using mask = group_mask<std::uint32_t, 0>;
+
+    explicit group(const ctrl_t* p) noexcept : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+    mask match(std::uint8_t h2) const noexcept
+    {
+        return {std::uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(char(h2)), ctrl)))};
+    }
+    mask match_empty() const noexcept
+    {
+        return {std::uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(ctrl_empty), ctrl)))};
+    }
+    mask match_empty_or_deleted() const noexcept
+    {
+        return {std::uint32_t(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(ctrl_sentinel), ctrl)))};
+    }
+
+    __m128i ctrl;
+};
+
+#else
+
+// Portable fallback: eight control bytes in a word, matched with SWAR.
+// match() may report false positives, which the key compare filters out.
+struct group {
+    static constexpr std::size_t width = 8;
+    using mask = group_mask<std::uint64_t, 3>;
+
+    static constexpr std::uint64_t lsbs = 0x0101010101010101ULL;
+    static constexpr std::uint64_t msbs = 0x8080808080808080ULL;
+
+    explicit group(const ctrl_t* p) noexcept { std::memcpy(&ctrl, p, sizeof(ctrl)); }
+
+    mask match(std::uint8_t h2) const noexcept
+    {
+        std::uint64_t x = ctrl ^ (lsbs * h2);
+        return {(x - lsbs) & ~x & msbs};
+    }
+    mask match_empty() const noexcept { return {ctrl & ~(ctrl << 6) & msbs}; }
+    mask match_empty_or_deleted() const noexcept { return {ctrl & ~(ctrl << 7) & msbs}; }
+
+    std::uint64_t ctrl;
+};
+
+#endif
+
+} // namespace detail
+
+/// Open-addressing hash map in the Swiss table layout.
+///
+/// Keys and values live inline in one slot array next to a control byte
+/// array that is probed a whole group (16 bytes with SSE2, 32 with AVX2) at
+/// a time. Capacity is always 2^n - 1; the first width-1 control bytes are
+/// mirrored past the end so a group load never has to wrap. Pointers and
+/// iterators are invalidated by any insertion that grows the table. The
+/// table comes from a memory_provider, operator new unless one is given.
+template <class K, class V, class Hash = yeni::hash<K>, class Eq = std::equal_to<K>>
+class flat_hash_map {
+    using ctrl_t = detail::ctrl_t;
+    using group = detail::group;
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = Eq;
+
+    static constexpr std::size_t group_width = group::width;
+
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using value_type = flat_hash_map::value_type;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        basic_iterator() = default;
+        template <bool C = Const, class = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false>& other) noexcept : ctrl_(other.ctrl_), slot_(other.slot_)
+        {
+        }
+
+        reference operator*() const noexcept { return *slot_; }
+        pointer operator->() const noexcept { return slot_; }
+
+        basic_iterator& operator++() noexcept
+        {
+            ++ctrl_;
+            ++slot_;
+            skip_free();
+            return *this;
+        }
+        basic_iterator operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept { return a.ctrl_ == b.ctrl_; }
+
+    private:
+        friend class flat_hash_map;
+        template <bool>
+        friend class basic_iterator;
+
+        basic_iterator(const ctrl_t* ctrl, value_type* slot) noexcept : ctrl_(ctrl), slot_(slot) {}
+
+        void skip_free() noexcept
+        {
+            // The sentinel after the last slot stops the scan.
+            while (*ctrl_ < detail::ctrl_sentinel) {
+                ++ctrl_;
+                ++slot_;
+            }
+        }
+
+        const ctrl_t* ctrl_ = nullptr;
+        value_type* slot_ = nullptr;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    flat_hash_map() = default;
+    explicit flat_hash_map(size_type expected) { reserve(expected); }
+    /// Empty map allocating from `memory`, which must outlive it.
+    explicit flat_hash_map(memory_provider& memory) noexcept : memory_(&memory) {}
+
+    flat_hash_map(const flat_hash_map& other) : memory_(other.memory_), hash_(other.hash_), eq_(other.eq_)
+    {
+        reserve(other.size());
+        for (const auto& kv : other)
+            emplace_unique(hash_(kv.first), kv.first, kv.second);
+    }
+
+    flat_hash_map(flat_hash_map&& other) noexcept { swap(other); }
+
+    flat_hash_map& operator=(flat_hash_map other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~flat_hash_map() { release(); }
+
+    void swap(flat_hash_map& other) noexcept
+    {
+        using std::swap;
+        swap(ctrl_, other.ctrl_);
+        swap(slots_, other.slots_);
+        swap(capacity_, other.capacity_);
+        swap(size_, other.size_);
+        swap(growth_left_, other.growth_left_);
+        swap(memory_, other.memory_);
+        swap(hash_, other.hash_);
+        swap(eq_, other.eq_);
+    }
+
+    iterator begin() noexcept
+    {
+        if (capacity_ == 0)
+            return end();
+        iterator it(ctrl_, slots_);
+        it.skip_free();
+        return it;
+    }
+    iterator end() noexcept { return iterator(ctrl_ + capacity_, slots_ + capacity_); }
+    const_iterator begin() const noexcept { return const_cast<flat_hash_map*>(this)->begin(); }
+    const_iterator end() const noexcept { return const_cast<flat_hash_map*>(this)->end(); }
+
+    size_type size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    size_type capacity() const noexcept { return capacity_; }
+    hasher hash_function() const { return hash_; }
+    key_equal key_eq() const { return eq_; }
+
+    /// Bytes owned by the table (control bytes plus slots).
+    size_type allocated_bytes() const noexcept { return capacity_ ? layout(capacity_).total : 0; }
+
+    void clear() noexcept
+    {
+        if (capacity_ == 0)
+            return;
+        destroy_slots();
+        std::memset(ctrl_, detail::ctrl_empty, capacity_ + group_width);
+        ctrl_[capacity_] = detail::ctrl_sentinel;
+        size_ = 0;
+        growth_left_ = growth_for(capacity_);
+    }
+
+    void reserve(size_type n)
+    {
+        if (n <= size_ + growth_left_)
+            return;
+        size_type cap = group_width - 1;
+        while (growth_for(cap) < n)
+            cap = cap * 2 + 1;
+        resize(cap);
+    }
+
+    iterator find(const K& key) { return find(key, hash_(key)); }
+    const_iterator find(const K& key) const { return find(key, hash_(key)); }
+
+    /// Lookup with a hash computed by the caller via hash_function().
+    iterator find(const K& key, std::size_t hash)
+    {
+        std::size_t i = find_index(key, hash);
+        return i == npos ? end() : iterator(ctrl_ + i, slots_ + i);
+    }
+    const_iterator find(const K& key, std::size_t hash) const
+    {
+        return const_cast<flat_hash_map*>(this)->find(key, hash);
+    }
+
+    /// Start loading the control group and slots that find(key, hash) and
+    /// inserts probe first, so a batch can overlap its cache misses.
+    void prefetch(std::size_t hash) const noexcept
+    {
+        if (capacity_ == 0)
+            return;
+        const std::size_t pos = h1(hash) & capacity_;
+        __builtin_prefetch(ctrl_ + pos);
+        __builtin_prefetch(slots_ + pos);
+    }
+
+    bool contains(const K& key) const { return find_index(key, hash_(key)) != npos; }
+    size_type count(const K& key) const { return contains(key) ? 1 : 0; }
+
+    V& at(const K& key)
+    {
+        std::size_t i = find_index(key, hash_(key));
+        if (i == npos)
+            throw std::out_of_range("yeni::flat_hash_map::at");
+        return slots_[i].second;
+    }
+    const V& at(const K& key) const { return const_cast<flat_hash_map*>(this)->at(key); }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+    {
+        return try_emplace_hashed(key, hash_(key), std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace_hashed(const K& key, std::size_t hash, Args&&... args)
+    {
+        std::size_t i = find_index(key, hash);
+        if (i != npos)
+            return {iterator(ctrl_ + i, slots_ + i), false};
+        i = emplace_unique(hash, key, std::forward<Args>(args)...);
+        return {iterator(ctrl_ + i, slots_ + i), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& kv) { return try_emplace(kv.first, kv.second); }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& value)
+    {
+        return insert_or_assign_hashed(key, hash_(key), std::forward<M>(value));
+    }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign_hashed(const K& key, std::size_t hash, M&& value)
+    {
+        auto res = try_emplace_hashed(key, hash, std::forward<M>(value));
+        if (!res.second)
+            res.first->second = std::forward<M>(value);
+        return res;
+    }
+
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+
+    size_type erase(const K& key)
+    {
+        std::size_t i = find_index(key, hash_(key));
+        if (i == npos)
+            return 0;
+        erase_index(i);
+        return 1;
+    }
+
+    iterator erase(iterator it)
+    {
+        erase_index(std::size_t(it.ctrl_ - ctrl_));
+        ++it;
+        return it;
+    }
+
+private:
+    static constexpr std::size_t npos = ~std::size_t(0);
+    static constexpr std::size_t cloned_bytes = group_width - 1;
+
+    struct layout_info {
+        std::size_t slots_offset;
+        std::size_t total;
+    };
+
+    static constexpr std::size_t table_align = alignof(value_type) > 64 ? alignof(value_type) : 64;
+
+    static layout_info layout(std::size_t cap) noexcept
+    {
+        std::size_t ctrl_bytes = cap + 1 + cloned_bytes;
+        std::size_t offset = (ctrl_bytes + alignof(value_type) - 1) & ~(alignof(value_type) - 1);
+        return {offset, offset + cap * sizeof(value_type)};
+    }
+
+    // Max load 7/8, always leaving at least one empty slot to end probes.
+    static std::size_t growth_for(std::size_t cap) noexcept { return cap - (cap + 1) / 8; }
+
+    static std::size_t h1(std::size_t hash) noexcept { return hash >> 7; }
+    static std::uint8_t h2(std::size_t hash) noexcept { return std::uint8_t(hash & 0x7f); }
+
+    void set_ctrl(std::size_t i, ctrl_t c) noexcept
+    {
+        ctrl_[i] = c;
+        // Keep the mirrored tail in sync so group loads near the end see
+        // the first slots of the table.
+        if (i < cloned_bytes)
+            ctrl_[capacity_ + 1 + i] = c;
+    }
+
+    std::size_t find_index(const K& key, std::size_t hash) const
+    {
+        if (capacity_ == 0)
+            return npos;
+        std::size_t pos = h1(hash) & capacity_;
+        std::size_t step = 0;
+        const std::uint8_t tag = h2(hash);
+        while (true) {
+            group g(ctrl_ + pos);
+            for (auto m = g.match(tag); m; m.clear_lowest()) {
+                std::size_t i = (pos + m.lowest()) & capacity_;
+                if (eq_(slots_[i].first, key)) [[likely]]
+                    return i;
+            }
+            if (g.match_empty())
+                return npos;
+            step += group_width;
+            pos = (pos + step) & capacity_;
+        }
+    }
+
+    std::size_t find_free(std::size_t hash) const noexcept
+    {
+        std::size_t pos = h1(hash) & capacity_;
+        std::size_t step = 0;
+        while (true) {
+            group g(ctrl_ + pos);
+            if (auto m = g.match_empty_or_deleted())
+                return (pos + m.lowest()) & capacity_;
+            step += group_width;
+            pos = (pos + step) & capacity_;
+        }
+    }
+
+    template <class... Args>
+    std::size_t emplace_unique(std::size_t hash, const K& key, Args&&... args)
+    {
+        std::size_t i = capacity_ ? find_free(hash) : npos;
+        if (i == npos || (growth_left_ == 0 && ctrl_[i] != detail::ctrl_deleted)) {
+            rehash_for_insert();
+            i = find_free(hash);
+        }
+        new (slots_ + i) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+            std::forward_as_tuple(std::forward<Args>(args)...));
+        if (ctrl_[i] == detail::ctrl_empty)
+            --growth_left_;
+        set_ctrl(i, ctrl_t(h2(hash)));
+        ++size_;
+        return i;
+    }
+
+    void erase_index(std::size_t i) noexcept
+    {
+        slots_[i].~value_type();
+        set_ctrl(i, detail::ctrl_deleted);
+        --size_;
+    }
+
+    void rehash_for_insert()
+    {
+        // Mostly tombstones: rebuild at the same size instead of doubling.
+        if (capacity_ != 0 && size_ <= capacity_ * 25 / 32)
+            resize(capacity_);
+        else
+            resize(capacity_ == 0 ? group_width - 1 : capacity_ * 2 + 1);
+    }
+
+    void resize(std::size_t new_cap)
+    {
+        ctrl_t* old_ctrl = ctrl_;
+        value_type* old_slots = slots_;
+        std::size_t old_cap = capacity_;
+
+        layout_info l = layout(new_cap);
+        auto* mem = static_cast<std::byte*>(memory_->allocate(l.total, table_align));
+        ctrl_ = reinterpret_cast<ctrl_t*>(mem);
+        slots_ = reinterpret_cast<value_type*>(mem + l.slots_offset);
+        capacity_ = new_cap;
+        std::memset(ctrl_, detail::ctrl_empty, new_cap + 1 + cloned_bytes);
+        ctrl_[new_cap] = detail::ctrl_sentinel;
+        growth_left_ = growth_for(new_cap) - size_;
+
+        for (std::size_t i = 0; i < old_cap; ++i) {
+            if (old_ctrl[i] < 0)
+                continue;
+            std::size_t hash = hash_(old_slots[i].first);
+            std::size_t j = find_free(hash);
+            set_ctrl(j, ctrl_t(h2(hash)));
+            relocate(slots_ + j, old_slots + i);
+        }
+        if (old_cap)
+            memory_->deallocate(old_ctrl, layout(old_cap).total, table_align);
+    }
+
+    static void relocate(value_type* dst, value_type* src) noexcept
+    {
+        if constexpr (std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>) {
+            std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), sizeof(value_type));
+        } else {
+            // The source slot is destroyed right after, so moving out of its
+            // const key is unobservable.
+            new (dst) value_type(std::move(const_cast<K&>(src->first)), std::move(src->second));
+            src->~value_type();
+        }
+    }
+
+    void destroy_slots() noexcept
+    {
+        if constexpr (!std::is_trivially_destructible_v<value_type>) {
+            for (std::size_t i = 0; i < capacity_; ++i)
+                if (ctrl_[i] >= 0)
+                    slots_[i].~value_type();
+        }
+    }
+
+    void release() noexcept
+    {
+        if (capacity_ == 0)
+            return;
+        destroy_slots();
+        memory_->deallocate(ctrl_, layout(capacity_).total, table_align);
+        ctrl_ = nullptr;
+        slots_ = nullptr;
+        capacity_ = size_ = growth_left_ = 0;
+    }
+
+    ctrl_t* ctrl_ = nullptr;
+    value_type* slots_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+    std::size_t growth_left_ = 0;
+    memory_provider* memory_ = &memory_provider::standard();
+    [[no_unique_address]] Hash hash_{};
+    [[no_unique_address]] Eq eq_{};
+};
+
+} // namespace yeni
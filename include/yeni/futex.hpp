@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace yeni {
+
+/// Thin wrappers over the Linux futex syscall on a 32-bit atomic word.
+/// Process-private; spurious returns are allowed, callers re-check.
+inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected) noexcept
+{
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+/// Wait at most `timeout`. Returns false if the timeout expired.
+inline bool futex_wait_for(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+    std::chrono::nanoseconds timeout) noexcept
+{
+    if (timeout <= std::chrono::nanoseconds::zero())
+        return false;
+    timespec ts;
+    ts.tv_sec = time_t(timeout.count() / 1000000000);
+    ts.tv_nsec = long(timeout.count() % 1000000000);
+    long r = ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &ts,
+        nullptr, 0);
+    return !(r == -1 && errno == ETIMEDOUT);
+}
+
+inline void futex_wake(std::atomic<std::uint32_t>& word, int count = INT_MAX) noexcept
+{
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+} // namespace yeni
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+namespace yeni {
+
+/// 64-bit finalizer with full avalanche; the flat hash map takes its
+/// control byte from the low bits and its probe start from the high bits,
+/// so both ends have to be well mixed.
+constexpr std::uint64_t mix64(std::uint64_t x) noexcept
+{
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+    return x;
+}
+
+/// Default hasher for yeni containers. Integers go through mix64(); other
+/// types use std::hash, whose output is mixed again because libstdc++ hashes
+/// integers to themselves.
+template <class T>
+struct hash {
+    std::size_t operator()(const T& v) const noexcept
+    {
+        if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+            return mix64(static_cast<std::uint64_t>(v));
+        else
+            return mix64(std::hash<T>{}(v));
+    }
+};
+
+} // namespace yeni
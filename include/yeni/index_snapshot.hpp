@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+
+namespace yeni {
+
+class record_store;
+struct wal_entry;
+
+/// Persisted image of a record_store's hash index, laid out so that it is
+/// used straight from the mapping: opening a snapshot validates its header
+/// and nothing else, and a lookup faults in the slots it probes and the
+/// value it returns, never the rest of the file.
+///
+///   header   64 bytes, magic "YENIIDX1"
+///   slots    `slots` (a power of two) of 24 bytes, open addressing with
+///            linear probing from mix64(key); at most half of them used
+///   values   the values, each on an 8-byte boundary
+///
+/// A snapshot is taken at a LSN the caller names, the last log record it
+/// covers; after a restart only the log past it needs replaying.
+namespace index_snapshot_format {
+
+inline constexpr char magic[8] = {'Y', 'E', 'N', 'I', 'I', 'D', 'X', '1'};
+inline constexpr std::uint32_t version = 1;
+
+struct header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t crc; // CRC-32C of the header with this field zero
+    std::uint64_t lsn;
+    std::uint64_t entries;
+    std::uint64_t slots;
+    std::uint64_t values_offset;
+    std::uint64_t file_size;
+    std::uint8_t reserved[8];
+};
+static_assert(sizeof(header) == 64);
+
+struct slot {
+    std::uint64_t key;
+    std::uint64_t offset; // from values_offset
+    std::uint32_t size;
+    std::uint32_t used; // 1, or 0 for a free slot
+};
+static_assert(sizeof(slot) == 24);
+
+} // namespace index_snapshot_format
+
+/// A read-only, memory-mapped index snapshot.
+class index_snapshot {
+public:
+    /// Map `path` and check its header. Throws std::system_error or
+    /// format_error.
+    static index_snapshot open(const std::filesystem::path& path);
+
+    index_snapshot(index_snapshot&& other) noexcept;
+    index_snapshot& operator=(index_snapshot&& other) noexcept;
+    ~index_snapshot();
+
+    index_snapshot(const index_snapshot&) = delete;
+    index_snapshot& operator=(const index_snapshot&) = delete;
+
+    /// Last log record the snapshot covers.
+    std::uint64_t lsn() const noexcept { return header_.lsn; }
+    std::uint64_t size() const noexcept { return header_.entries; }
+    std::size_t file_size() const noexcept { return size_; }
+    const std::filesystem::path& path() const noexcept { return path_; }
+
+    /// Value of `key`, pointing into the mapping. Throws format_error if
+    /// a slot it reaches points outside the file.
+    std::optional<std::span<const std::byte>> find(std::uint64_t key) const;
+
+    /// Call `f(key, value)` for every entry, in slot order.
+    template <class F>
+    void for_each(F&& f) const
+    {
+        for (std::uint64_t i = 0; i < header_.slots; ++i) {
+            const index_snapshot_format::slot s = slot_at(i);
+            if (s.used)
+                f(s.key, value_of(s));
+        }
+    }
+
+private:
+    index_snapshot() = default;
+    index_snapshot_format::slot slot_at(std::uint64_t i) const noexcept
+    {
+        index_snapshot_format::slot s;
+        std::memcpy(&s, base_ + sizeof(index_snapshot_format::header) + i * sizeof(s), sizeof(s));
+        return s;
+    }
+    std::span<const std::byte> value_of(const index_snapshot_format::slot& s) const;
+    void release() noexcept;
+
+    std::filesystem::path path_;
+    const std::byte* base_ = nullptr;
+    std::size_t size_ = 0;
+    index_snapshot_format::header header_{};
+};
+
+/// Snapshot the latest version of every key in `store`, over those of
+/// `base` (the previous snapshot, if any) it does not hold, as covering
+/// the log up to `lsn`. Must not run concurrently with appends to `store`.
+/// Writes `path` under a temporary name and renames it into place once it
+/// is complete and synced, so a crash leaves the old snapshot.
+void write_index_snapshot(const std::filesystem::path& path, const record_store& store, std::uint64_t lsn,
+    const index_snapshot* base = nullptr);
+
+/// Restart path: feed `apply` every record of the log in `wal_dir` past
+/// `snapshot`, in LSN order, and return the LSN of the last one (the
+/// snapshot's if there are none). Records it already covers are skipped
+/// by segment, so the cost is the tail's, not the log's.
+std::uint64_t replay_wal_tail(const std::filesystem::path& wal_dir, const index_snapshot& snapshot,
+    const std::function<void(const wal_entry&)>& apply);
+
+} // namespace yeni
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "yeni/arena.hpp"
+#include "yeni/flat_hash_map.hpp"
+#include "yeni/memory.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+namespace yeni {
+
+class segment;
+
+/// Dense id of an interned string. Equal strings interned in one
+/// string_interner get equal ids, so comparing them is one compare.
+using string_id = std::uint32_t;
+
+/// Table giving every distinct string an id, numbered from 0 in the order
+/// they were first interned.
+///
+/// Strings are copied into per-stripe arenas and indexed in striped flat
+/// hash maps, so interning only locks the stripe the string hashes to and
+/// lookups of present strings only share it. view() takes no lock at all:
+/// ids index a directory of fixed-size chunks that never move.
+class string_interner {
+public:
+    /// Most ids one interner hands out.
+    static constexpr std::size_t max_size = std::size_t(1) << 32;
+
+    explicit string_interner(memory_provider& memory = memory_provider::standard());
+    ~string_interner();
+
+    string_interner(const string_interner&) = delete;
+    string_interner& operator=(const string_interner&) = delete;
+
+    /// Process-wide table, created on first use.
+    static string_interner& global();
+
+    /// Id of `s`, interning it if it is new. Thread-safe. Throws
+    /// std::length_error once max_size strings are interned.
+    string_id intern(std::string_view s);
+
+    /// Id of `s` if it has been interned. Thread-safe.
+    std::optional<string_id> find(std::string_view s) const;
+
+    /// The string behind `id`, valid as long as the interner. Thread-safe
+    /// for any id the caller got from intern() or find().
+    std::string_view view(string_id id) const noexcept
+    {
+        return chunks_[id >> chunk_bits].load(std::memory_order_acquire)[id & (chunk_size - 1)];
+    }
+
+    /// Strings interned so far.
+    std::size_t size() const noexcept { return next_id_.load(std::memory_order_acquire); }
+    /// Bytes held by the string arenas.
+    std::size_t bytes_reserved() const;
+
+private:
+    static constexpr unsigned stripe_bits = 6;
+    static constexpr unsigned chunk_bits = 16;
+    static constexpr std::size_t chunk_size = std::size_t(1) << chunk_bits;
+
+    struct alignas(64) stripe {
+        explicit stripe(memory_provider& memory) : map(memory), strings(arena::default_block_size, memory) {}
+
+        mutable std::shared_mutex mutex;
+        flat_hash_map<std::string_view, string_id> map;
+        arena strings;
+    };
+
+    std::string_view* chunk_for(std::size_t id);
+
+    memory_provider& memory_;
+    std::vector<std::unique_ptr<stripe>> stripes_;
+    std::unique_ptr<std::atomic<std::string_view*>[]> chunks_; // max_size / chunk_size entries
+    std::atomic<std::uint64_t> next_id_{0};
+};
+
+/// Column `column` of `s`, a binary column, as ids in `interner`. On a
+/// front-coded column a row repeating the row before reuses its id
+/// without being hashed.
+std::vector<string_id> intern_column(const segment& s, std::string_view column,
+    string_interner& interner = string_interner::global());
+
+} // namespace yeni
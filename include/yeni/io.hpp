@@ -0,0 +1,371 @@
+#pragma once
+
+#include "yeni/mpsc_queue.hpp"
+#include "yeni/scheduler.hpp"
+#include "yeni/trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace yeni {
+
+class codel_monitor;
+
+/// One file operation. Like `task`, owned by the submitter: it must stay
+/// alive until `complete` has been called, which happens exactly once on
+/// the context's completion thread.
+struct io_request {
+    enum class op : std::uint8_t { read, write, read_fixed, write_fixed, fsync, fdatasync };
+
+    op opcode = op::read;
+    /// Registered buffer slot for read_fixed/write_fixed.
+    std::uint16_t buffer_index = 0;
+    int fd = -1;
+    void* data = nullptr;
+    std::uint32_t size = 0;
+    std::uint64_t offset = 0;
+    /// Bytes transferred, or -errno. Short transfers are reported, not retried.
+    std::int64_t result = 0;
+    void (*complete)(io_request*) noexcept = nullptr;
+    /// Set by submit() when the context reports queueing delay.
+    std::int64_t queued_at = 0;
+};
+
+/// A slice of the context's buffer pool. With io_uring these are registered
+/// with the kernel once, so fixed reads and writes skip the per-call page
+/// pinning.
+struct io_buffer {
+    std::byte* data = nullptr;
+    std::size_t size = 0;
+    std::uint16_t index = 0;
+};
+
+struct io_options {
+    /// Submission ring entries; in-flight operations beyond this wait in
+    /// userspace.
+    unsigned queue_depth = 256;
+    /// Buffers carved out for fixed I/O, each `buffer_size` bytes.
+    unsigned buffers = 0;
+    std::size_t buffer_size = 1 << 20;
+    /// Threads serving requests when io_uring is unavailable.
+    unsigned fallback_threads = 4;
+    /// Skip io_uring even if the kernel has it (tests, benchmarks).
+    bool force_fallback = false;
+    /// Where awaiting coroutines are resumed; null resumes them on the
+    /// completion thread, which then must not block.
+    scheduler* resume_on = nullptr;
+    /// Told how long each request waited between submit() and being
+    /// handed to the kernel or a pool thread; null to not measure.
+    codel_monitor* delay = nullptr;
+};
+
+enum class io_backend : std::uint8_t { io_uring, thread_pool };
+
+class io_awaitable;
+
+/// Asynchronous file I/O.
+///
+/// Submitters from any thread push requests into an MPSC queue; a single
+/// completion thread drains it into the io_uring submission ring, issues
+/// one io_uring_enter for the whole batch and dispatches completions. When
+/// the kernel refuses io_uring (old kernel, seccomp, sysctl) the same
+/// interface is served by a small pool of threads doing pread/pwrite.
+class io_context {
+public:
+    explicit io_context(io_options options = {});
+    ~io_context();
+
+    io_context(const io_context&) = delete;
+    io_context& operator=(const io_context&) = delete;
+
+    /// Process-wide context resuming on scheduler::instance(), created on
+    /// first use.
+    static io_context& instance();
+
+    io_backend backend() const noexcept { return ring_fd_ >= 0 ? io_backend::io_uring : io_backend::thread_pool; }
+    scheduler* resume_on() const noexcept { return options_.resume_on; }
+
+    /// Queue one request; its callback runs on the completion thread.
+    void submit(io_request* r) { submit(std::span<io_request* const>(&r, 1)); }
+    /// Queue several requests with a single wakeup of the completion thread.
+    void submit(std::span<io_request* const> requests);
+
+    /// Take a buffer from the pool, or nullopt when it is exhausted.
+    std::optional<io_buffer> try_acquire_buffer();
+    void release_buffer(const io_buffer& b);
+    /// True when the pool is registered with the kernel (fixed ops are then
+    /// cheaper than plain ones; otherwise they degrade to plain ones).
+    bool buffers_registered() const noexcept { return buffers_registered_; }
+
+    io_awaitable read(int fd, std::span<std::byte> out, std::uint64_t offset);
+    io_awaitable write(int fd, std::span<const std::byte> data, std::uint64_t offset);
+    io_awaitable read_fixed(int fd, const io_buffer& b, std::size_t size, std::uint64_t offset);
+    io_awaitable write_fixed(int fd, const io_buffer& b, std::size_t size, std::uint64_t offset);
+    io_awaitable fsync(int fd, bool data_only = true);
+
+private:
+    struct ring;
+
+    bool setup_ring();
+    void setup_buffers();
+    void ring_main();
+    void pool_main();
+    void wake();
+    static void execute(io_request& r) noexcept;
+    void observe_delay(const io_request& r, std::chrono::steady_clock::time_point now) noexcept;
+
+    io_options options_;
+    int ring_fd_ = -1;
+    int event_fd_ = -1;
+    std::unique_ptr<ring> ring_;
+    mpsc_queue<io_request*> queue_;
+    alignas(64) std::atomic<bool> wake_armed_{false};
+    std::atomic<bool> stop_{false};
+
+    // Thread-pool backend.
+    std::mutex pool_mutex_;
+    std::condition_variable pool_cv_;
+    std::deque<io_request*> pool_queue_;
+
+    std::byte* buffer_memory_ = nullptr;
+    bool buffers_registered_ = false;
+    std::mutex buffers_mutex_;
+    std::vector<std::uint16_t> free_buffers_;
+
+    std::vector<std::thread> threads_;
+};
+
+/// `co_await`-able request: suspends the coroutine and resumes it (on the
+/// context's resume_on scheduler, or the completion thread) with the byte
+/// count. Errors are rethrown as std::system_error.
+class io_awaitable {
+public:
+    io_awaitable(io_context& ctx, io_request r) : ctx_(ctx), state_{r, {}, ctx.resume_on(), {}}
+    {
+        state_.complete = &on_complete;
+        state_.resume.run = &on_resume;
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        state_.resume.handle = h;
+        state_.wait.begin(trace::span_kind::io_wait);
+        ctx_.submit(&state_);
+    }
+    std::size_t await_resume()
+    {
+        state_.wait.end(std::uint64_t(state_.result));
+        if (state_.result < 0)
+            throw std::system_error(int(-state_.result), std::generic_category(), "yeni: async io");
+        return std::size_t(state_.result);
+    }
+
+private:
+    struct resume_task : task {
+        std::coroutine_handle<> handle;
+    };
+    struct state : io_request {
+        resume_task resume;
+        scheduler* sched;
+        trace::async_span wait;
+    };
+
+    static void on_complete(io_request* r) noexcept
+    {
+        auto* s = static_cast<state*>(r);
+        if (s->sched)
+            s->sched->spawn(&s->resume);
+        else
+            s->resume.handle.resume();
+    }
+    static void on_resume(task* t) noexcept { static_cast<resume_task*>(t)->handle.resume(); }
+
+    io_context& ctx_;
+    state state_;
+};
+
+/// Lazily started coroutine returning T; `co_await` it from another
+/// coroutine or block on it with sync_wait().
+template <class T = void>
+class io_task;
+
+namespace detail {
+
+struct io_task_waiter {
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+};
+
+struct io_task_promise_base {
+    std::coroutine_handle<> continuation;
+    io_task_waiter* waiter = nullptr;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            auto& p = h.promise();
+            if (p.continuation)
+                return p.continuation;
+            if (p.waiter) {
+                // Notify under the lock: sync_wait() may destroy the waiter
+                // as soon as it sees `done`.
+                std::lock_guard lock(p.waiter->m);
+                p.waiter->done = true;
+                p.waiter->cv.notify_one();
+            }
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <class T>
+struct io_task_promise : io_task_promise_base {
+    std::optional<T> value;
+
+    io_task<T> get_return_object() noexcept;
+    template <class U>
+    void return_value(U&& v)
+    {
+        value.emplace(std::forward<U>(v));
+    }
+    T take()
+    {
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct io_task_promise<void> : io_task_promise_base {
+    io_task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+    void take()
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+} // namespace detail
+
+template <class T>
+class io_task {
+public:
+    using promise_type = detail::io_task_promise<T>;
+
+    explicit io_task(std::coroutine_handle<promise_type> h) noexcept : handle_(h) {}
+    io_task(io_task&& o) noexcept : handle_(std::exchange(o.handle_, {})) {}
+    io_task& operator=(io_task&& o) noexcept
+    {
+        if (this != &o) {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(o.handle_, {});
+        }
+        return *this;
+    }
+    ~io_task()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    auto operator co_await() noexcept
+    {
+        struct awaiter {
+            std::coroutine_handle<promise_type> h;
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+            {
+                h.promise().continuation = caller;
+                return h;
+            }
+            T await_resume() { return h.promise().take(); }
+        };
+        return awaiter{handle_};
+    }
+
+    /// Run to completion, blocking the calling thread. Must not be called
+    /// from the completion thread.
+    friend T sync_wait(io_task t)
+    {
+        detail::io_task_waiter w;
+        t.handle_.promise().waiter = &w;
+        t.handle_.resume();
+        std::unique_lock lock(w.m);
+        w.cv.wait(lock, [&] { return w.done; });
+        return t.handle_.promise().take();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <class T>
+io_task<T> io_task_promise<T>::get_return_object() noexcept
+{
+    return io_task<T>(std::coroutine_handle<io_task_promise<T>>::from_promise(*this));
+}
+
+inline io_task<void> io_task_promise<void>::get_return_object() noexcept
+{
+    return io_task<void>(std::coroutine_handle<io_task_promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+inline io_awaitable io_context::read(int fd, std::span<std::byte> out, std::uint64_t offset)
+{
+    return io_awaitable(*this, {io_request::op::read, 0, fd, out.data(), std::uint32_t(out.size()), offset, 0, nullptr});
+}
+
+inline io_awaitable io_context::write(int fd, std::span<const std::byte> data, std::uint64_t offset)
+{
+    return io_awaitable(*this, {io_request::op::write, 0, fd, const_cast<std::byte*>(data.data()),
+                                   std::uint32_t(data.size()), offset, 0, nullptr});
+}
+
+inline io_awaitable io_context::read_fixed(int fd, const io_buffer& b, std::size_t size, std::uint64_t offset)
+{
+    return io_awaitable(*this, {io_request::op::read_fixed, b.index, fd, b.data, std::uint32_t(size), offset, 0, nullptr});
+}
+
+inline io_awaitable io_context::write_fixed(int fd, const io_buffer& b, std::size_t size, std::uint64_t offset)
+{
+    return io_awaitable(*this, {io_request::op::write_fixed, b.index, fd, b.data, std::uint32_t(size), offset, 0, nullptr});
+}
+
+inline io_awaitable io_context::fsync(int fd, bool data_only)
+{
+    return io_awaitable(*this, {data_only ? io_request::op::fdatasync : io_request::op::fsync, 0, fd, nullptr, 0, 0, 0,
+                                   nullptr});
+}
+
+} // namespace yeni
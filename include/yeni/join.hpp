@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string_view>
+
+namespace yeni {
+
+class scheduler;
+class segment;
+class selection_bitmap;
+
+/// One side of a join: the rows of `seg` that `selection` (one bit per
+/// row, as the predicate kernels leave it) has set, or every row, keyed by
+/// the u32, u64 or i64 column `key`. Signed keys only join signed keys.
+struct join_input {
+    const segment* seg = nullptr;
+    std::string_view key = "key";
+    const selection_bitmap* selection = nullptr;
+};
+
+struct join_options {
+    /// Runs the partition, build and probe tasks; null for
+    /// scheduler::instance().
+    scheduler* sched = nullptr;
+    /// Memory for the (key, row) tuples of both sides, which a join holds
+    /// twice while partitioning. Inputs that need more are split into
+    /// partitions spilled to files under `spill_dir` (empty: the system
+    /// temporary directory) and joined one partition at a time. A single
+    /// partition larger than the budget, from a very frequent key, is
+    /// still joined in memory.
+    std::size_t memory_budget = std::size_t(256) << 20;
+    std::filesystem::path spill_dir;
+    /// Row pairs per sink call.
+    std::size_t batch_rows = 4096;
+};
+
+struct join_stats {
+    std::uint64_t matches = 0;
+    std::uint64_t spill_bytes = 0;     // tuples written to spill files
+    std::size_t spill_partitions = 0;  // 0 when the join ran in memory
+};
+
+/// Called with matching rows: left_rows[i] of the left segment has the
+/// key of right_rows[i] of the right one. Runs on scheduler workers, so
+/// calls may be concurrent; the spans are only valid during the call. An
+/// exception stops the join and is rethrown to its caller.
+using join_sink = std::function<void(std::span<const std::uint32_t> left_rows,
+    std::span<const std::uint32_t> right_rows)>;
+
+/// Equi-join by partitioned radix hashing. The selected keys of both
+/// sides are gathered as (key, row) tuples in parallel, scattered by the
+/// top bits of their hash into partitions small enough that the smaller
+/// side's hash table stays in cache, and each pair of partitions is then
+/// built and probed as its own task. Pairs come in no particular order.
+///
+/// Throws std::invalid_argument for a missing or non-integer key column,
+/// a selection whose size is not the segment's row count, or a segment of
+/// more than 2^32 rows; std::system_error when spilling fails.
+join_stats radix_hash_join(const join_input& left, const join_input& right, const join_sink& sink,
+    const join_options& options = {});
+
+/// Equi-join by sorting. Both sides are range-partitioned on splitters
+/// sampled from their keys, each range is sorted and merged as its own
+/// task, so every sink call holds pairs in ascending key order (numeric
+/// for i64 keys), ties by left then right row. Spilled partitions are key
+/// ranges too. Prefer it for inputs already clustered on the key, or when
+/// the consumer wants sorted runs.
+join_stats sort_merge_join(const join_input& left, const join_input& right, const join_sink& sink,
+    const join_options& options = {});
+
+} // namespace yeni
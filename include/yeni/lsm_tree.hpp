@@ -0,0 +1,212 @@
+#pragma once
+
+#include "yeni/epoch.hpp"
+#include "yeni/segment.hpp"
+#include "yeni/token_bucket.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace yeni {
+
+class io_context;
+class record_store;
+class scheduler;
+
+struct compaction_options {
+    /// Level-0 segments (straight from flush, overlapping each other)
+    /// that trigger a merge into level 1.
+    std::size_t level0_trigger = 4;
+    /// Target size of level 1; each deeper level may be `level_ratio`
+    /// times larger than the one above.
+    std::uint64_t level1_bytes = std::uint64_t(64) << 20;
+    double level_ratio = 10.0;
+    /// Compaction output is cut into segments of about this size.
+    std::uint64_t segment_bytes = std::uint64_t(16) << 20;
+    /// Merge work done per scheduler slice before the job requeues itself.
+    std::uint64_t slice_bytes = std::uint64_t(1) << 20;
+    /// Compaction I/O budget (bytes read + written per second, 0 for no
+    /// limit) and burst. Ignored when `limiter` is set.
+    std::uint64_t bytes_per_second = std::uint64_t(64) << 20;
+    std::uint64_t burst_bytes = std::uint64_t(4) << 20;
+    /// Budget shared with other trees; must outlive this one.
+    token_bucket* limiter = nullptr;
+    /// How the segments the tree writes, flushes included, are encoded.
+    codec_options codec;
+};
+
+/// A segment of an lsm_tree, mapped on first use. Its key range and size
+/// come from the manifest, so opening a tree and routing a key to the
+/// segment that may hold it touch no segment file: a restart only pays
+/// for the segments its reads actually reach.
+class lsm_segment {
+public:
+    lsm_segment(std::filesystem::path path, std::uint64_t min_key, std::uint64_t max_key, std::uint64_t file_size);
+    /// Wrap a segment already open; it must have keys.
+    explicit lsm_segment(segment s);
+    ~lsm_segment();
+
+    lsm_segment(const lsm_segment&) = delete;
+    lsm_segment& operator=(const lsm_segment&) = delete;
+
+    const std::filesystem::path& path() const noexcept { return path_; }
+    std::uint64_t min_key() const noexcept { return min_key_; }
+    std::uint64_t max_key() const noexcept { return max_key_; }
+    std::uint64_t file_size() const noexcept { return file_size_; }
+
+    bool is_open() const noexcept { return open_.load(std::memory_order_acquire) != nullptr; }
+
+    /// The segment, opened on first call. Thread-safe. Throws what
+    /// segment::open() throws, or format_error if the file disagrees with
+    /// the manifest.
+    const segment& get() const
+    {
+        if (const segment* s = open_.load(std::memory_order_acquire)) [[likely]]
+            return *s;
+        return open_slow();
+    }
+
+private:
+    const segment& open_slow() const;
+
+    std::filesystem::path path_;
+    std::uint64_t min_key_;
+    std::uint64_t max_key_;
+    std::uint64_t file_size_;
+    mutable std::mutex open_mutex_;
+    mutable std::unique_ptr<const segment> segment_;
+    mutable std::atomic<const segment*> open_{nullptr};
+};
+
+/// Immutable set of segments by level. A point lookup checks level 0
+/// newest first, then at most one segment per deeper level, each level
+/// being a sorted run of key-disjoint segments.
+///
+/// Versions and the segments they name belong to their tree. A replaced
+/// version, and any segment the new one dropped, is retired through
+/// yeni/epoch.hpp, so readers keep them alive with an epoch::guard rather
+/// than a reference count.
+class lsm_version {
+public:
+    static constexpr std::size_t max_levels = 7;
+
+    using segment_ptr = const lsm_segment*;
+
+    std::span<const segment_ptr> level(std::size_t n) const noexcept { return levels_[n]; }
+    std::uint64_t level_bytes(std::size_t n) const noexcept;
+
+    /// Newest value of `key`; the span stays valid as long as the version.
+    std::optional<std::span<const std::byte>> find(std::uint64_t key) const;
+
+    /// Segments a lookup that misses everywhere may have to probe: every
+    /// level-0 segment plus one per non-empty deeper level.
+    std::size_t read_amplification() const noexcept;
+
+private:
+    friend class lsm_tree;
+
+    std::vector<segment_ptr> levels_[max_levels];
+};
+
+/// Leveled LSM tree of segment files in one directory.
+///
+/// flush() writes a record_store out as a new level-0 segment. When level
+/// 0 holds too many segments, or a deeper level outgrows its target, a
+/// compaction merges segments into the next level, newest value winning.
+/// Compactions run one at a time per tree as background tasks on the
+/// scheduler: in slices of `slice_bytes`, only on workers with nothing
+/// else to do, and paced by a token bucket charged with the bytes each
+/// slice read and wrote.
+///
+/// The MANIFEST file lists the live segments by level, with their key
+/// ranges and sizes, and is replaced atomically on every change; segment
+/// files it does not name (a crash mid-flush or mid-compaction) are deleted
+/// on open. Segments themselves are only mapped when first read (see
+/// lsm_segment), so opening a tree costs the manifest and a directory
+/// listing, whatever the size of the data.
+class lsm_tree {
+public:
+    explicit lsm_tree(std::filesystem::path dir, compaction_options options = {}, scheduler* sched = nullptr,
+        io_context* io = nullptr);
+    /// Abandons a running compaction (its output is discarded) and waits
+    /// for its current slice. No reader may still be using the tree.
+    ~lsm_tree();
+
+    lsm_tree(const lsm_tree&) = delete;
+    lsm_tree& operator=(const lsm_tree&) = delete;
+
+    /// Write the latest version of every key in `store` as the newest
+    /// level-0 segment. Must not run concurrently with appends to `store`.
+    void flush(const record_store& store);
+
+    /// Snapshot to read from. It and every segment it names stay valid,
+    /// even once a compaction has replaced them, for as long as `pin`
+    /// (taken before the call) lives.
+    const lsm_version& current([[maybe_unused]] const epoch::guard& pin) const noexcept
+    {
+        return *current_.load(std::memory_order_acquire);
+    }
+
+    std::optional<std::span<const std::byte>> find(std::uint64_t key, const epoch::guard& pin) const
+    {
+        return current(pin).find(key);
+    }
+
+    std::size_t read_amplification() const
+    {
+        const epoch::guard pin;
+        return current(pin).read_amplification();
+    }
+
+    /// Block until no compaction is pending. Must not be called from a
+    /// worker of the tree's scheduler, which may be the one to run it.
+    void wait_for_compactions();
+
+    /// The error that ended the last failed compaction, if any, including
+    /// one the constructor started. A failed compaction leaves the tree as
+    /// it was and is retried on the next flush.
+    std::exception_ptr last_error() const;
+
+    const std::filesystem::path& directory() const noexcept { return dir_; }
+
+private:
+    struct compaction;
+
+    void load_manifest();
+    void write_manifest(const lsm_version& v);
+    std::filesystem::path next_segment_path();
+    void install(std::unique_ptr<lsm_version> v, std::span<const lsm_version::segment_ptr> dropped = {});
+    const lsm_version& edit_version() const noexcept { return *current_.load(std::memory_order_relaxed); }
+    void maybe_compact_locked();
+    std::unique_ptr<compaction> pick_locked();
+    void finish(compaction* job, std::exception_ptr error) noexcept;
+    std::uint64_t level_target(std::size_t n) const noexcept;
+
+    std::filesystem::path dir_;
+    compaction_options options_;
+    scheduler& sched_;
+    io_context* io_;
+    token_bucket own_limiter_;
+    token_bucket& limiter_;
+
+    // edit_mutex_ serialises version changes (and guards the job state);
+    // readers load current_ under a guard and never wait for an edit.
+    mutable std::mutex edit_mutex_;
+    std::atomic<const lsm_version*> current_{nullptr};
+    compaction* job_ = nullptr;
+    std::uint64_t compact_cursor_[lsm_version::max_levels] = {}; // next key to compact per level
+    std::exception_ptr error_;
+    std::atomic<std::uint64_t> next_file_{1};
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint32_t> busy_{0}; // futex word: 1 while a job exists
+};
+
+} // namespace yeni
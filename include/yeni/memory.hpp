@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace yeni {
+
+/// Where arenas, hash tables and cached blocks get their memory from.
+///
+/// Implementations must be thread-safe. Everything that takes a provider
+/// keeps a reference to it, so the provider has to outlive its users.
+class memory_provider {
+public:
+    virtual ~memory_provider() = default;
+
+    /// `size` bytes aligned to `align`, a power of two of at most 4096.
+    /// Throws std::bad_alloc.
+    virtual void* allocate(std::size_t size, std::size_t align) = 0;
+    /// Return memory from allocate() with the same `size` and `align`.
+    virtual void deallocate(void* p, std::size_t size, std::size_t align) noexcept = 0;
+
+    /// Aligned operator new and delete; the default everywhere.
+    static memory_provider& standard() noexcept;
+};
+
+/// Deleter for byte buffers from a memory_provider.
+struct memory_deleter {
+    memory_provider* memory = nullptr;
+    std::size_t size = 0;
+    std::size_t align = 0;
+
+    void operator()(std::byte* p) const noexcept { memory->deallocate(p, size, align); }
+};
+
+using memory_ptr = std::unique_ptr<std::byte[], memory_deleter>;
+
+/// Uninitialised `size` bytes from `memory`, freed back to it.
+inline memory_ptr allocate_bytes(memory_provider& memory, std::size_t size,
+    std::size_t align = alignof(std::max_align_t))
+{
+    return memory_ptr(static_cast<std::byte*>(memory.allocate(size, align)), memory_deleter{&memory, size, align});
+}
+
+enum class page_size {
+    base,        // the kernel's base pages, no huge pages
+    transparent, // base pages with madvise(MADV_HUGEPAGE)
+    huge_2m,     // MAP_HUGETLB, 2 MiB
+    huge_1g,     // MAP_HUGETLB, 1 GiB
+};
+
+struct page_provider_options {
+    page_size pages = page_size::transparent;
+    /// One pool per NUMA node, bound to it with mbind(); allocations come
+    /// from the pool of the node the calling thread runs on.
+    bool node_local = true;
+    /// Without node_local, bind the single pool to this node; -1 leaves
+    /// placement to the kernel.
+    int node = -1;
+};
+
+/// Memory provider over mmap()ed huge pages.
+///
+/// Each pool cuts 2 MiB chunks from mappings of the configured page size
+/// (1 GiB at a time with huge_1g), carves them into size classes four to
+/// a power of two and keeps freed blocks on per-class free lists; chunks
+/// go back to the system only when the provider is destroyed. Requests
+/// over half a chunk get a mapping of their own, which deallocate()
+/// unmaps.
+///
+/// MAP_HUGETLB needs pages reserved through vm.nr_hugepages (1 GiB pages
+/// usually at boot). Where a mapping cannot get them it falls back, 1 GiB
+/// to 2 MiB to transparent huge pages, and counts a huge_page_fallbacks
+/// metric. A failing mbind() (a single-node host, a seccomp filter) leaves
+/// the pages wherever the kernel puts them.
+class page_provider final : public memory_provider {
+public:
+    /// Size and alignment of the chunks pools carve blocks from.
+    static constexpr std::size_t chunk_bytes = std::size_t(2) << 20;
+
+    explicit page_provider(page_provider_options options = {});
+    /// Unmaps every chunk. Blocks with a mapping of their own must have
+    /// been deallocated.
+    ~page_provider() override;
+
+    page_provider(const page_provider&) = delete;
+    page_provider& operator=(const page_provider&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align) override;
+    void deallocate(void* p, std::size_t size, std::size_t align) noexcept override;
+
+    /// Bytes currently mapped, chunks and large blocks alike.
+    std::size_t bytes_mapped() const noexcept { return mapped_.load(std::memory_order_relaxed); }
+    /// Number of pools: one per NUMA node with node_local, else one.
+    std::size_t pools() const noexcept { return pools_.size(); }
+
+private:
+    struct pool;
+
+    pool& local_pool() noexcept;
+    void* map(std::size_t size, std::size_t align, int node);
+    void unmap(void* p, std::size_t size) noexcept;
+
+    const page_provider_options options_;
+    const std::size_t page_bytes_;
+    const std::size_t region_bytes_; // mapped at once to cut chunks from
+    std::vector<std::unique_ptr<pool>> pools_;
+    std::vector<unsigned> pool_of_node_;
+    std::atomic<std::size_t> mapped_{0};
+};
+
+} // namespace yeni
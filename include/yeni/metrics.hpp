@@ -0,0 +1,286 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Set to 0 (CMake: -DYENI_METRICS=OFF) to compile every hot-path hook down
+// to nothing; collect() then reports zeros.
+#ifndef YENI_METRICS
+#define YENI_METRICS 1
+#endif
+
+namespace yeni::metrics {
+
+inline constexpr bool enabled = YENI_METRICS != 0;
+
+/// Monotonic event counters. Append new entries before `count`.
+enum class counter : std::uint8_t {
+    inserts,
+    insert_bytes,
+    lookups,
+    lookup_hits,
+    segment_lookups,
+    segment_lookup_hits,
+    segment_filter_skips,
+    block_cache_hits,
+    block_cache_misses,
+    block_cache_evictions,
+    column_decodes,
+    column_decode_bytes,
+    scan_rows,
+    flushes,
+    flush_bytes,
+    compactions,
+    compaction_bytes_in,
+    compaction_bytes_out,
+    wal_appends,
+    wal_append_bytes,
+    wal_commits,
+    import_rows,
+    import_bytes,
+    export_rows,
+    export_bytes,
+    join_matches,
+    join_spill_bytes,
+    memory_mapped_bytes,
+    huge_page_fallbacks,
+    replication_batches,
+    replication_bytes,
+    replication_records_applied,
+    shard_messages,
+    shard_ring_full,
+    aggregate_rows,
+    segment_lazy_opens,
+    morsels,
+    morsel_steals,
+    admission_rejected_rate,
+    admission_rejected_overload,
+    queue_delay_overloads,
+    count,
+};
+
+/// Latency distributions, in nanoseconds.
+enum class histogram : std::uint8_t {
+    insert,
+    lookup,
+    scan,
+    flush,
+    compaction,
+    wal_append, // append() until durable
+    wal_commit,  // one group's write + sync
+    queue_delay, // enqueue until dequeue, wherever a codel_monitor watches
+    count,
+};
+
+inline constexpr std::size_t counter_count = std::size_t(counter::count);
+inline constexpr std::size_t histogram_count = std::size_t(histogram::count);
+
+/// Metric name without the "yeni_" prefix and Prometheus suffixes.
+std::string_view name(counter c) noexcept;
+std::string_view name(histogram h) noexcept;
+
+/// Per-operation paths (insert, lookup, wal_append) time one call in this
+/// many; bulk paths (scan, flush, compaction, wal_commit) time every call.
+inline constexpr unsigned latency_sample_every = 64;
+
+/// HDR-style log-linear buckets: values below 2^sub_bits get a bucket
+/// each, every power of two above is split into 2^sub_bits equal buckets,
+/// so a recorded value is off by at most 1/16. Values from 2^max_exponent
+/// ns (~69 s) up land in the last bucket.
+struct histogram_layout {
+    static constexpr unsigned sub_bits = 4;
+    static constexpr unsigned sub_count = 1u << sub_bits;
+    static constexpr unsigned max_exponent = 36;
+    static constexpr std::size_t buckets = (max_exponent - sub_bits + 1) * sub_count;
+
+    static constexpr std::size_t bucket_of(std::uint64_t v) noexcept
+    {
+        if (v < sub_count)
+            return std::size_t(v);
+        const unsigned e = unsigned(std::bit_width(v)) - 1;
+        if (e >= max_exponent)
+            return buckets - 1;
+        return std::size_t(e - sub_bits + 1) * sub_count + std::size_t((v >> (e - sub_bits)) & (sub_count - 1));
+    }
+
+    /// Smallest value that no longer falls into bucket `i`.
+    static constexpr std::uint64_t upper_bound(std::size_t i) noexcept
+    {
+        if (i < sub_count)
+            return i + 1;
+        const unsigned e = unsigned(i / sub_count) + sub_bits - 1;
+        return (std::uint64_t(sub_count + i % sub_count) + 1) << (e - sub_bits);
+    }
+};
+static_assert(histogram_layout::bucket_of(15) == 15 && histogram_layout::bucket_of(16) == 16);
+static_assert(histogram_layout::upper_bound(histogram_layout::bucket_of(1000)) > 1000);
+static_assert(histogram_layout::upper_bound(histogram_layout::bucket_of(1000) - 1) <= 1000);
+
+#if YENI_METRICS
+
+/// The calling thread's metric cells. Only the owning thread writes them
+/// (plain relaxed load + store, no read-modify-write); collect() sums every
+/// thread's cells with relaxed loads, so neither side ever locks. A block
+/// outlives its thread and is handed to the next new thread, which keeps
+/// counting from where it stopped.
+class alignas(64) thread_metrics {
+public:
+    void add(counter c, std::uint64_t n = 1) noexcept { bump(counters_[std::size_t(c)], n); }
+
+    void record(histogram h, std::uint64_t ns) noexcept
+    {
+        auto& cells = histograms_[std::size_t(h)];
+        bump(cells.buckets[histogram_layout::bucket_of(ns)], 1);
+        bump(cells.count, 1);
+        bump(cells.sum, ns);
+        if (ns > cells.max.load(std::memory_order_relaxed))
+            cells.max.store(ns, std::memory_order_relaxed);
+    }
+
+    /// True once every latency_sample_every calls for `h`. Each histogram
+    /// keeps its own tick so interleaved operations do not alias.
+    bool sample(histogram h) noexcept { return ++ticks_[std::size_t(h)] % latency_sample_every == 0; }
+
+private:
+    friend struct registry;
+
+    struct histogram_cells {
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> sum{0};
+        std::atomic<std::uint64_t> max{0};
+        std::array<std::atomic<std::uint64_t>, histogram_layout::buckets> buckets{};
+    };
+
+    static void bump(std::atomic<std::uint64_t>& cell, std::uint64_t n) noexcept
+    {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<std::uint64_t>, counter_count> counters_{};
+    std::array<histogram_cells, histogram_count> histograms_{};
+    std::array<unsigned, histogram_count> ticks_{};
+    std::atomic<bool> in_use_{false};
+    thread_metrics* next_ = nullptr;
+};
+
+/// Cells of the calling thread, claimed on first use.
+thread_metrics& local() noexcept;
+
+/// Records the lifetime of the scope into `h` when `active`.
+class scoped_timer {
+public:
+    scoped_timer(thread_metrics& m, histogram h, bool active = true) noexcept
+        : m_(active ? &m : nullptr)
+        , h_(h)
+    {
+        if (m_)
+            start_ = std::chrono::steady_clock::now();
+    }
+    ~scoped_timer()
+    {
+        if (m_)
+            m_->record(h_, std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start_)
+                                             .count()));
+    }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+private:
+    thread_metrics* m_;
+    histogram h_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#else
+
+class thread_metrics {
+public:
+    void add(counter, std::uint64_t = 1) noexcept {}
+    void record(histogram, std::uint64_t) noexcept {}
+    bool sample(histogram) noexcept { return false; }
+};
+
+inline thread_metrics& local() noexcept
+{
+    static thread_metrics none;
+    return none;
+}
+
+class scoped_timer {
+public:
+    scoped_timer(thread_metrics&, histogram, bool = true) noexcept {}
+};
+
+#endif
+
+struct histogram_snapshot {
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+    std::vector<std::uint64_t> buckets; // histogram_layout::buckets entries
+
+    double mean() const noexcept { return count ? double(sum) / double(count) : 0.0; }
+    /// Upper bound of the bucket holding quantile `q` (0..1), capped at max.
+    std::uint64_t percentile(double q) const noexcept;
+};
+
+/// Process-wide totals at one point in time. Cells are read one by one
+/// while threads keep writing, so totals are consistent per cell, not
+/// across cells.
+struct snapshot {
+    std::array<std::uint64_t, counter_count> counters{};
+    std::array<histogram_snapshot, histogram_count> histograms;
+
+    std::uint64_t operator[](counter c) const noexcept { return counters[std::size_t(c)]; }
+    const histogram_snapshot& operator[](histogram h) const noexcept { return histograms[std::size_t(h)]; }
+};
+
+snapshot collect();
+
+/// Prometheus text exposition (format 0.0.4). Counters become
+/// yeni_<name>_total, histograms yeni_<name>_latency_seconds with one
+/// bucket per power of two.
+std::string prometheus_text(const snapshot& s);
+inline std::string prometheus_text() { return prometheus_text(collect()); }
+
+/// Write prometheus_text() to `path` via a temporary file and rename, as
+/// the node_exporter textfile collector expects.
+void write_prometheus(const std::filesystem::path& path);
+
+/// Minimal HTTP endpoint answering `GET /metrics` on its own thread, and
+/// `GET /trace` with the trace rings as trace::chrome_trace() (or
+/// `?format=otlp`, `?format=folded`). `/trace?sample_every=N` first sets
+/// trace::set_sample_every(N), so sampling can be turned up, down or off
+/// in a running process.
+class http_server {
+public:
+    /// Listen on `address:port`; port 0 picks a free one (see port()).
+    explicit http_server(std::uint16_t port = 0, const std::string& address = "127.0.0.1");
+    ~http_server();
+
+    http_server(const http_server&) = delete;
+    http_server& operator=(const http_server&) = delete;
+
+    std::uint16_t port() const noexcept { return port_; }
+
+private:
+    void serve();
+
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    std::uint16_t port_ = 0;
+    std::thread thread_;
+};
+
+} // namespace yeni::metrics
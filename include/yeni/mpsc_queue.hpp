@@ -0,0 +1,293 @@
+#pragma once
+
+#include "yeni/futex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+
+namespace yeni {
+
+struct record;
+
+/// Bounded lock-free multi-producer/single-consumer ring.
+///
+/// Slots carry a sequence number (Vyukov's bounded queue): a producer
+/// claims a slot with one CAS on the tail, fills it and publishes it by
+/// bumping the slot sequence; the single consumer walks the head without
+/// any atomic read-modify-write. Each slot is cache-line aligned so
+/// producers never false-share. The blocking variants park on futexes and
+/// are only woken when the other side has announced it is waiting.
+template <class T>
+class mpsc_queue {
+public:
+    explicit mpsc_queue(std::size_t capacity)
+    {
+        std::size_t cap = 2;
+        while (cap < capacity)
+            cap <<= 1;
+        mask_ = cap - 1;
+        slots_.reset(new slot[cap]);
+        for (std::size_t i = 0; i < cap; ++i)
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    std::size_t capacity() const noexcept { return mask_ + 1; }
+
+    /// Enqueue unless the ring is full. `v` is only moved from on success.
+    bool try_push(T&& v)
+    {
+        std::uint64_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            slot& s = slots_[pos & mask_];
+            const std::uint64_t seq = s.seq.load(std::memory_order_acquire);
+            const auto diff = std::int64_t(seq - pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.value = std::move(v);
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    wake_consumer();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    bool try_push(const T& v)
+    {
+        T copy(v);
+        return try_push(std::move(copy));
+    }
+
+    /// Enqueue, sleeping while the ring is full. Returns false once the
+    /// queue is closed.
+    bool push(T v)
+    {
+        while (!closed_.load(std::memory_order_relaxed)) {
+            if (try_push(std::move(v)))
+                return true;
+            producers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+            const std::uint32_t e = not_full_.load(std::memory_order_seq_cst);
+            if (try_push(std::move(v))) {
+                producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (!closed_.load(std::memory_order_relaxed))
+                futex_wait(not_full_, e);
+            producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    /// Consumer only.
+    bool try_pop(T& out) { return try_pop_batch(std::span<T>(&out, 1)) == 1; }
+
+    /// Consumer only: dequeue up to out.size() items without blocking.
+    std::size_t try_pop_batch(std::span<T> out)
+    {
+        std::size_t n = 0;
+        while (n < out.size()) {
+            slot& s = slots_[head_ & mask_];
+            if (s.seq.load(std::memory_order_acquire) != head_ + 1)
+                break;
+            out[n++] = std::move(s.value);
+            s.seq.store(head_ + mask_ + 1, std::memory_order_release);
+            ++head_;
+        }
+        if (n)
+            wake_producers();
+        return n;
+    }
+
+    /// Consumer only: dequeue at least one item, sleeping up to `timeout`.
+    /// Returns 0 on timeout or when the queue is closed and drained.
+    std::size_t pop_batch(std::span<T> out, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max())
+    {
+        const auto deadline = timeout == std::chrono::nanoseconds::max()
+            ? std::chrono::steady_clock::time_point::max()
+            : std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            if (std::size_t n = try_pop_batch(out))
+                return n;
+            consumer_waiting_.store(1, std::memory_order_seq_cst);
+            const std::uint32_t e = not_empty_.load(std::memory_order_seq_cst);
+            if (std::size_t n = try_pop_batch(out)) {
+                consumer_waiting_.store(0, std::memory_order_relaxed);
+                return n;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                consumer_waiting_.store(0, std::memory_order_relaxed);
+                return try_pop_batch(out);
+            }
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                futex_wait(not_empty_, e);
+            } else if (!futex_wait_for(not_empty_, e, deadline - std::chrono::steady_clock::now())) {
+                consumer_waiting_.store(0, std::memory_order_relaxed);
+                return try_pop_batch(out);
+            }
+            consumer_waiting_.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /// Wake every sleeper; push() fails from now on, the consumer drains.
+    void close() noexcept
+    {
+        closed_.store(true, std::memory_order_seq_cst);
+        not_empty_.fetch_add(1, std::memory_order_seq_cst);
+        not_full_.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(not_empty_);
+        futex_wake(not_full_);
+    }
+    bool closed() const noexcept { return closed_.load(std::memory_order_acquire); }
+
+    /// Approximate fill level.
+    std::size_t size_approx() const noexcept
+    {
+        const std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const std::uint64_t head = consumed_hint();
+        return tail > head ? std::size_t(tail - head) : 0;
+    }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<std::uint64_t> seq;
+        T value;
+    };
+
+    // head_ is consumer-private; observers read the copy the consumer
+    // publishes after each drain.
+    std::uint64_t consumed_hint() const noexcept { return head_shadow_.load(std::memory_order_relaxed); }
+
+    void wake_consumer() noexcept
+    {
+        // Dekker handshake with pop_batch(): either the consumer's second
+        // try sees our slot, or we see it waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_relaxed)) {
+            not_empty_.fetch_add(1, std::memory_order_relaxed);
+            futex_wake(not_empty_, 1);
+        }
+    }
+
+    void wake_producers() noexcept
+    {
+        head_shadow_.store(head_, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (producers_waiting_.load(std::memory_order_relaxed)) {
+            not_full_.fetch_add(1, std::memory_order_relaxed);
+            futex_wake(not_full_);
+        }
+    }
+
+    std::unique_ptr<slot[]> slots_;
+    std::size_t mask_ = 0;
+    alignas(64) std::atomic<std::uint64_t> tail_{0};
+    alignas(64) std::uint64_t head_ = 0;
+    std::atomic<std::uint64_t> head_shadow_{0};
+    alignas(64) std::atomic<std::uint32_t> consumer_waiting_{0};
+    std::atomic<std::uint32_t> not_empty_{0};
+    alignas(64) std::atomic<std::uint32_t> producers_waiting_{0};
+    std::atomic<std::uint32_t> not_full_{0};
+    std::atomic<bool> closed_{false};
+};
+
+/// Clock of handoff_batch::stamp: steady_clock microseconds, modulo 2^32.
+/// Differences stay right across the wrap for delays under an hour.
+inline std::uint32_t handoff_clock(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) noexcept
+{
+    return std::uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count());
+}
+
+/// A cache line worth of items handed over in one queue slot. Together with
+/// the slot sequence it fills exactly one 64-byte line for pointer-sized T.
+template <class T>
+struct handoff_batch {
+    static constexpr std::size_t capacity = (56 - std::max(2 * sizeof(std::uint32_t), alignof(T))) / sizeof(T);
+
+    std::uint32_t size = 0;
+    /// handoff_clock() when the producer handed the batch over; what a
+    /// consumer measures queueing delay from.
+    std::uint32_t stamp = 0;
+    T items[capacity];
+
+    std::span<const T> view() const noexcept { return {items, size}; }
+
+    /// Time spent queued, as of `now` on the consumer.
+    std::chrono::microseconds age(std::uint32_t now = handoff_clock()) const noexcept
+    {
+        return std::chrono::microseconds(std::uint32_t(now - stamp));
+    }
+};
+
+/// Producer-side accumulator: one queue operation per full batch instead of
+/// one per item. Owned by a single producer thread.
+template <class T>
+class batching_producer {
+public:
+    using queue_type = mpsc_queue<handoff_batch<T>>;
+
+    explicit batching_producer(queue_type& queue) : queue_(queue) {}
+    ~batching_producer() { flush(); }
+
+    batching_producer(const batching_producer&) = delete;
+    batching_producer& operator=(const batching_producer&) = delete;
+
+    /// Returns false if the queue was closed while a full batch was pending.
+    bool push(T v)
+    {
+        batch_.items[batch_.size++] = std::move(v);
+        return batch_.size == handoff_batch<T>::capacity ? flush() : true;
+    }
+
+    /// Hand over a partial batch (e.g. at the end of a network read).
+    bool flush()
+    {
+        if (batch_.size == 0)
+            return true;
+        batch_.stamp = handoff_clock();
+        bool ok = queue_.push(std::move(batch_));
+        batch_.size = 0;
+        return ok;
+    }
+
+private:
+    queue_type& queue_;
+    handoff_batch<T> batch_;
+};
+
+/// Consumer-side drain: pop up to `max_batches` batches (blocking up to
+/// `timeout` for the first) and call `f(item)` for every item. Returns the
+/// number of items consumed.
+template <class T, class F>
+std::size_t consume_batches(mpsc_queue<handoff_batch<T>>& queue, F&& f,
+    std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max())
+{
+    constexpr std::size_t max_batches = 32;
+    handoff_batch<T> batches[max_batches];
+    std::size_t got = queue.pop_batch(std::span<handoff_batch<T>>(batches, max_batches), timeout);
+    std::size_t items = 0;
+    for (std::size_t b = 0; b < got; ++b) {
+        for (const T& item : batches[b].view())
+            f(item);
+        items += batches[b].size;
+    }
+    return items;
+}
+
+/// Queue handing records from network threads to the store's consumer.
+using ingest_queue = mpsc_queue<handoff_batch<const record*>>;
+static_assert(sizeof(handoff_batch<const record*>) + sizeof(std::uint64_t) == 64);
+using ingest_producer = batching_producer<const record*>;
+
+} // namespace yeni
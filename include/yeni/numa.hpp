@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace yeni {
+
+/// CPU/NUMA layout of the host as far as this process may use it.
+///
+/// Read once from /sys/devices/system/node and intersected with the
+/// process affinity mask. Hosts without NUMA information show up as a
+/// single node holding every allowed CPU.
+class numa_topology {
+public:
+    struct node {
+        unsigned id;
+        std::vector<unsigned> cpus;
+    };
+
+    static const numa_topology& system();
+
+    const std::vector<node>& nodes() const noexcept { return nodes_; }
+    std::size_t cpu_count() const noexcept;
+    /// Node owning `cpu`, or 0 if unknown.
+    unsigned node_of_cpu(unsigned cpu) const noexcept;
+
+    /// Parse a sysfs cpulist such as "0-3,8,10-11". Malformed items, and
+    /// ranges reaching CPU_SETSIZE or beyond, are skipped.
+    static std::vector<unsigned> parse_cpulist(std::string_view list);
+
+private:
+    numa_topology();
+
+    std::vector<node> nodes_;
+    std::vector<unsigned> cpu_node_;
+};
+
+} // namespace yeni
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "yeni/selection.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace yeni {
+
+class segment;
+
+enum class compare_op : std::uint8_t { eq, ne, lt, le, gt, ge };
+
+/// Instruction set the predicate kernels run on. Picked once from CPUID;
+/// the YENI_SIMD environment variable ("scalar", "avx2", "avx512") caps it.
+enum class simd_level : std::uint8_t { scalar, avx2, avx512 };
+
+simd_level active_simd_level() noexcept;
+/// Override the level for the whole process (tests, benchmarks). Requests
+/// above what the CPU supports are clamped.
+void set_simd_level(simd_level level) noexcept;
+std::string_view to_string(simd_level level) noexcept;
+
+/// Predicate kernels over fixed-width columns. Each call overwrites `out`
+/// with one bit per row of `column`; combine several predicates with the
+/// bitmap's &= and |=. Floating-point compares follow C++ semantics, so
+/// NaN only satisfies `ne`.
+///
+/// Supported element types: std::uint32_t, std::uint64_t, std::int64_t,
+/// double -- the fixed-width segment column types.
+template <class T>
+void filter_compare(std::span<const T> column, compare_op op, T value, selection_bitmap& out);
+
+/// lo <= x && x <= hi.
+template <class T>
+void filter_range(std::span<const T> column, T lo, T hi, selection_bitmap& out);
+
+/// x is one of `values`. Short lists are matched with SIMD broadcasts,
+/// long ones through a sorted probe.
+template <class T>
+void filter_in(std::span<const T> column, std::span<const T> values, selection_bitmap& out);
+
+/// The kernels behind filter_compare() and filter_range(), writing
+/// (rows.size() + 63) / 64 words to `out` with the bits past the last row
+/// zero. Neither counted nor timed: they serve callers that evaluate a
+/// column a page at a time, like the pipeline executor, and account for
+/// the scan themselves.
+template <class T>
+void compare_rows(std::span<const T> rows, compare_op op, T value, std::uint64_t* out);
+
+template <class T>
+void range_rows(std::span<const T> rows, T lo, T hi, std::uint64_t* out);
+
+/// filter_compare() and filter_range() over column `column` of `s`, in
+/// whatever encoding it is stored. Packed columns are decoded a page at a
+/// time into a buffer that stays in L1 and filtered from there, so the
+/// kernels see plain rows without the column ever being decoded whole.
+template <class T>
+void filter_compare(const segment& s, std::string_view column, compare_op op, T value, selection_bitmap& out);
+
+template <class T>
+void filter_range(const segment& s, std::string_view column, T lo, T hi, selection_bitmap& out);
+
+/// Rows of binary column `column` of `s` that compare to `value` as `op`
+/// says, bytewise as std::string_view compares. Front-coded columns are
+/// evaluated without rebuilding a row: a row sharing more of its
+/// predecessor than the predecessor shares with `value` compares the same
+/// way, and any other row only compares its stored suffix.
+void filter_string_compare(const segment& s, std::string_view column, compare_op op, std::string_view value,
+    selection_bitmap& out);
+
+/// Rows of binary column `column` of `s` that start with `prefix`,
+/// evaluated like filter_string_compare().
+void filter_string_prefix(const segment& s, std::string_view column, std::string_view prefix, selection_bitmap& out);
+
+} // namespace yeni
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "yeni/arena.hpp"
+#include "yeni/epoch.hpp"
+#include "yeni/flat_hash_map.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+namespace yeni {
+
+/// A record as laid out in an arena: fixed header followed by the value
+/// bytes, padded so the next record starts on an 8-byte boundary.
+struct record {
+    std::uint64_t key;
+    std::uint64_t seq;  // position in the store's append order, from 1
+    const record* prev; // the version of `key` this one superseded
+    std::uint32_t size;
+    std::uint32_t flags;
+
+    std::span<const std::byte> value() const noexcept
+    {
+        return {reinterpret_cast<const std::byte*>(this + 1), size};
+    }
+
+    static constexpr std::size_t alignment = 8;
+
+    static constexpr std::size_t footprint(std::size_t value_size) noexcept
+    {
+        return (sizeof(record) + value_size + alignment - 1) & ~(alignment - 1);
+    }
+};
+static_assert(sizeof(record) % record::alignment == 0);
+
+/// Append-only store of records.
+///
+/// Every appending thread gets its own shard with a private arena, so the
+/// insert path is a thread-local lookup plus a pointer bump and never
+/// contends with other writers. Records stay valid until reset(), which is
+/// meant to be called on batch boundaries once every reader is done.
+///
+/// A striped flat hash index maps each key to its most recently appended
+/// record; appends and lookups only lock the stripe the key hashes to.
+///
+/// Every append takes the next sequence number, and the older versions of
+/// a key stay chained behind the newest, so a reader can pin sequence()
+/// and later see the store exactly as it was then (find_at(),
+/// for_each_at()) while appends carry on. reset() retires the arenas
+/// through yeni/epoch.hpp instead of rewinding them: records a reader
+/// found under an epoch::guard stay valid until it drops the guard.
+class record_store {
+public:
+    /// Arenas and the index come from `memory`, which must outlive the
+    /// store and the arenas reset() retired (see epoch::synchronize()).
+    explicit record_store(std::size_t arena_block_size = arena::default_block_size,
+        memory_provider& memory = memory_provider::standard());
+    ~record_store();
+
+    record_store(const record_store&) = delete;
+    record_store& operator=(const record_store&) = delete;
+
+    /// Copy `value` into the calling thread's arena. Thread-safe.
+    const record* append(std::uint64_t key, std::span<const std::byte> value);
+
+    /// Most recent record for `key`, or nullptr. Thread-safe.
+    const record* find(std::uint64_t key) const;
+
+    /// Number of the newest append, to take a snapshot at: find_at() and
+    /// for_each_at() given it see every append numbered up to it and none
+    /// after.
+    std::uint64_t sequence() const noexcept { return next_seq_.load(std::memory_order_acquire); }
+
+    /// Newest record for `key` numbered at most `seq`, or nullptr.
+    /// Thread-safe. Records found under an epoch::guard outlive a reset()
+    /// until the guard is dropped.
+    const record* find_at(std::uint64_t key, std::uint64_t seq) const;
+
+    /// append() for each (keys[i], values[i]) in order, storing the records
+    /// in `out` unless it is empty. Each index stripe the batch touches is
+    /// locked once, and the index is prefetched for a window of keys
+    /// before any of them is inserted. Thread-safe.
+    void append_many(std::span<const std::uint64_t> keys, std::span<const std::span<const std::byte>> values,
+        std::span<const record*> out = {});
+
+    /// out[i] = find(keys[i]), batched like append_many(); returns the
+    /// number of keys found. Thread-safe.
+    std::size_t find_many(std::span<const std::uint64_t> keys, std::span<const record*> out) const;
+
+    /// Visit the newest record numbered at most `seq` of every key, in no
+    /// particular order. Safe against concurrent appends, which it only
+    /// ever holds up for the copy of one index stripe at a time.
+    template <class F>
+    void for_each_at(std::uint64_t seq, F&& f) const
+    {
+        const epoch::guard pin;
+        std::vector<const record*> heads;
+        for (std::size_t i = 0; i < (std::size_t(1) << index_stripe_bits); ++i) {
+            heads.clear();
+            {
+                std::shared_lock lock(index_[i].mutex);
+                heads.reserve(index_[i].map.size());
+                for (const auto& entry : index_[i].map)
+                    heads.push_back(entry.second);
+            }
+            for (const record* r : heads) {
+                while (r && r->seq > seq)
+                    r = r->prev;
+                if (r)
+                    f(*r);
+            }
+        }
+    }
+
+    /// Number of records appended since the last reset.
+    std::size_t size() const;
+    /// Bytes held by all shard arenas.
+    std::size_t bytes_reserved() const;
+
+    /// Visit every record, shard by shard in per-shard append order. Must not
+    /// run concurrently with append() or reset().
+    template <class F>
+    void for_each(F&& f) const
+    {
+        std::lock_guard lock(shards_mutex_);
+        for (const auto& s : shards_) {
+            s->records->for_each_block([&](const std::byte* p, const std::byte* end) {
+                while (p < end) {
+                    auto* r = reinterpret_cast<const record*>(p);
+                    f(*r);
+                    p += record::footprint(r->size);
+                }
+            });
+        }
+    }
+
+    /// Drop every record, retiring the arenas that hold them. Must not run
+    /// concurrently with append() or for_each().
+    void reset();
+
+private:
+    struct shard {
+        shard(std::uint64_t owner, std::size_t block_size, memory_provider& memory)
+            : owner(owner), records(std::make_unique<arena>(block_size, memory))
+        {
+        }
+
+        const std::uint64_t owner; // the appending thread's shard_cache::thread
+        std::unique_ptr<arena> records;
+        // The arena the last reset() swapped out, reused once no guard can
+        // still see its records.
+        std::unique_ptr<arena> spare;
+        std::uint64_t spare_stamp = 0;
+        std::atomic<std::size_t> count{0};
+    };
+
+    static constexpr unsigned index_stripe_bits = 6;
+    // Keys hashed, prefetched and probed together by the batch calls.
+    static constexpr std::size_t batch_window = 64;
+
+    struct alignas(64) index_stripe {
+        mutable std::shared_mutex mutex;
+        flat_hash_map<std::uint64_t, const record*> map;
+    };
+
+    static std::size_t stripe_of(std::size_t hash) noexcept { return hash >> (64 - index_stripe_bits); }
+
+    shard& local_shard();
+    shard& register_shard();
+
+    const std::uint64_t id_;
+    const std::size_t block_size_;
+    memory_provider& memory_;
+    mutable std::mutex shards_mutex_;
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::unique_ptr<index_stripe[]> index_;
+    alignas(64) std::atomic<std::uint64_t> next_seq_{0}; // last number handed out
+};
+
+} // namespace yeni
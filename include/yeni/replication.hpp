@@ -0,0 +1,185 @@
+#pragma once
+
+#include "yeni/wal.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace yeni {
+
+/// Wire format of the replication stream, over TCP, little-endian.
+///
+///   follower -> leader   hello, once, then an ack after every batch
+///   leader -> follower   batch header + `bytes` of log records exactly as
+///                        the leader's segment holds them (wal_format)
+///
+/// The leader sends batches back to back without waiting for acks, up to
+/// a window of unacknowledged bytes per follower.
+namespace replication_format {
+
+inline constexpr char magic[8] = {'Y', 'E', 'N', 'I', 'R', 'E', 'P', '1'};
+inline constexpr std::uint32_t version = 1;
+
+struct hello {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t from_lsn; // first record the follower wants
+};
+static_assert(sizeof(hello) == 24);
+
+struct batch_header {
+    std::uint32_t crc; // CRC-32C of bytes 4..32
+    std::uint32_t flags;
+    std::uint64_t first_lsn;
+    std::uint64_t last_lsn;
+    std::uint64_t bytes;
+};
+static_assert(sizeof(batch_header) == 32);
+
+struct ack {
+    std::uint64_t applied_lsn; // every record up to it applied
+    std::uint64_t durable_lsn; // ... and durable in the follower's own log
+};
+static_assert(sizeof(ack) == 16);
+
+} // namespace replication_format
+
+struct replication_leader_options {
+    /// Listen on `address:port`; port 0 picks a free one (see port()).
+    std::string address = "127.0.0.1";
+    std::uint16_t port = 0;
+    /// Most log bytes in one batch. A commit bigger than this goes out in
+    /// several; smaller commits that land before a send go out together.
+    std::size_t max_batch_bytes = std::size_t(1) << 20;
+    /// Bytes a follower may have unacknowledged before the leader stops
+    /// sending to it.
+    std::size_t max_inflight_bytes = std::size_t(16) << 20;
+};
+
+/// Ships a write-ahead log to followers as it commits.
+///
+/// Followers connect and name the first LSN they want; from then on each
+/// gets a sender thread that follows the log with a wal_cursor and passes
+/// every durable range of records to the socket with sendfile(), straight
+/// from the segment's page cache, and a thread reading its acks. Batches
+/// are the log's own bytes, so nothing is re-encoded on either side.
+class replication_leader {
+public:
+    explicit replication_leader(wal& log, replication_leader_options options = {});
+    /// Disconnects every follower.
+    ~replication_leader();
+
+    replication_leader(const replication_leader&) = delete;
+    replication_leader& operator=(const replication_leader&) = delete;
+
+    std::uint16_t port() const noexcept { return port_; }
+
+    /// Followers currently connected.
+    std::size_t followers() const;
+
+    /// Highest LSN durable on at least `count` connected followers (applied,
+    /// for followers without a log of their own); 0 if there are fewer.
+    std::uint64_t replicated_lsn(std::size_t count) const;
+
+    /// Block until replicated_lsn(count) >= lsn; false if `timeout`
+    /// expired first.
+    bool wait_replicated(std::uint64_t lsn, std::size_t count, std::chrono::nanoseconds timeout);
+
+private:
+    struct follower;
+
+    void serve();
+    void ship(follower& f) noexcept;
+    void receive_acks(follower& f) noexcept;
+    void disconnect(follower& f) noexcept;
+    void reap();
+    std::uint64_t replicated_locked(std::size_t count) const;
+
+    wal& log_;
+    replication_leader_options options_;
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    std::uint16_t port_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable acked_cv_;
+    std::vector<std::unique_ptr<follower>> followers_;
+    std::thread thread_;
+};
+
+struct replication_follower_options {
+    std::string address = "127.0.0.1";
+    std::uint16_t port = 0;
+    /// The follower's own log, which receives every batch as it is before
+    /// it is applied; it must have no other writers. Replication resumes
+    /// at its next_lsn(). Without one, it starts at `from_lsn`.
+    wal* log = nullptr;
+    std::uint64_t from_lsn = 1;
+    /// Key partitions a batch is applied in, in parallel on
+    /// scheduler::instance(); 0 picks the worker count.
+    unsigned partitions = 0;
+    /// Key of a record's payload. Records with equal keys land in the same
+    /// partition and keep their order; without key_of every batch is
+    /// applied as one partition.
+    std::function<std::uint64_t(std::span<const std::byte>)> key_of;
+    /// Apply one partition's records of a batch, in LSN order. Calls for
+    /// different partitions run concurrently; the next batch is applied
+    /// only once every partition of this one is done.
+    std::function<void(unsigned partition, std::span<const wal_entry> records)> apply;
+};
+
+/// Receives a leader's log and applies it batch by batch.
+///
+/// One thread receives batches, checks every record's CRC, appends the
+/// batch to the local log in one copy and applies it partition by
+/// partition; another acks the applied and durable LSNs as the local log
+/// commits. A broken stream stops replication; wait_applied() then
+/// rethrows what broke it.
+class replication_follower {
+public:
+    /// Connects to the leader; throws if it cannot.
+    explicit replication_follower(replication_follower_options options);
+    ~replication_follower();
+
+    replication_follower(const replication_follower&) = delete;
+    replication_follower& operator=(const replication_follower&) = delete;
+
+    std::uint64_t applied_lsn() const noexcept { return applied_lsn_.load(std::memory_order_acquire); }
+
+    /// Block until every record up to `lsn` is applied; false if `timeout`
+    /// expired first. Rethrows the error that stopped replication.
+    bool wait_applied(std::uint64_t lsn, std::chrono::nanoseconds timeout);
+
+private:
+    void receive() noexcept;
+    void send_acks() noexcept;
+    void apply(std::span<const wal_entry> records);
+
+    replication_follower_options options_;
+    int fd_ = -1;
+
+    std::atomic<std::uint64_t> applied_lsn_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_; // set before failed_
+    // Bumped after every batch and on failure; waiters sleep on it.
+    std::atomic<std::uint32_t> batches_{0};
+
+    std::vector<std::vector<wal_entry>> partitions_;
+    std::thread receiver_;
+    std::thread acker_;
+};
+
+} // namespace yeni
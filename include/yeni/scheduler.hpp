@@ -0,0 +1,254 @@
+#pragma once
+
+#include "yeni/work_stealing_deque.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace yeni {
+
+class scheduler;
+
+/// Unit of work for the scheduler. Owned by whoever spawns it; the
+/// scheduler only calls `run` once and never frees it.
+struct task {
+    void (*run)(task*) noexcept;
+};
+
+struct scheduler_options {
+    /// Worker threads; 0 means one per CPU in the process affinity mask.
+    unsigned threads = 0;
+    /// Pin each worker to one CPU, filling NUMA nodes in order.
+    bool pin_workers = true;
+};
+
+/// Work-stealing thread pool.
+///
+/// Every worker owns a Chase-Lev deque: tasks spawned from a worker go to
+/// its own deque, idle workers steal from victims on their NUMA node before
+/// crossing to other nodes. Threads outside the pool submit through one
+/// mutex-protected injection queue: every task they spawn goes there,
+/// including each helper task of a parallel_for/parallel_reduce they start,
+/// while helpers of one started on a worker go to that worker's deque.
+/// parallel_for/parallel_reduce and task_group are the entry points the
+/// rest of the core builds on.
+///
+/// Maintenance work (compaction and the like) goes through a separate
+/// background queue that a worker only looks at once it has found nothing
+/// else to run.
+class scheduler {
+public:
+    explicit scheduler(scheduler_options options = {});
+    ~scheduler();
+
+    scheduler(const scheduler&) = delete;
+    scheduler& operator=(const scheduler&) = delete;
+
+    /// Process-wide pool, created on first use.
+    static scheduler& instance();
+
+    unsigned worker_count() const noexcept { return unsigned(workers_.size()); }
+
+    /// Index of the calling worker of *this* pool, or -1.
+    int current_worker() const noexcept;
+    /// NUMA node of the calling worker, or 0 outside the pool.
+    unsigned current_node() const noexcept;
+
+    /// Queue `t`. Safe from any thread.
+    void spawn(task* t);
+
+    /// Queue `t` at background priority, to run no earlier than
+    /// `not_before`. Only a worker with no other task picks it up, and
+    /// threads helping in wait_until() never do, so foreground work waits
+    /// for at most the background task already running. Long jobs should
+    /// therefore run in slices, requeueing themselves after each one.
+    void spawn_background(task* t, std::chrono::steady_clock::time_point not_before = {});
+
+    /// Take `t` back out of the background queue. False if it is not
+    /// queued (already picked up, or never spawned).
+    bool cancel_background(task* t);
+
+    /// Run one pending task on the calling thread. Returns false when
+    /// nothing was found.
+    bool run_one();
+
+    /// Execute other tasks until `done()` holds.
+    template <class Pred>
+    void wait_until(Pred&& done)
+    {
+        unsigned idle = 0;
+        while (!done()) {
+            if (run_one()) {
+                idle = 0;
+            } else if (++idle < 64) {
+                cpu_relax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /// Call `f(chunk_begin, chunk_end)` over [begin, end) in chunks of
+    /// `grain` (0: pick a grain giving ~8 chunks per worker). Blocks until
+    /// every chunk has run; the first exception is rethrown.
+    template <class F>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& f);
+
+    /// Map every chunk with `map(chunk_begin, chunk_end) -> T` and fold the
+    /// results left to right with `combine`, so the result is deterministic
+    /// for a given grain.
+    template <class T, class Map, class Combine>
+    T parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, T identity, Map&& map,
+        Combine&& combine);
+
+    static void cpu_relax() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+private:
+    struct worker;
+
+    // Shared state of one parallel_for: participants claim chunks from
+    // `next`; the caller waits for every helper it spawned to retire
+    // because the job lives in its stack frame.
+    struct range_job {
+        std::size_t begin, end, grain, chunks;
+        void (*body)(void* ctx, std::size_t chunk, std::size_t b, std::size_t e);
+        void* ctx;
+        alignas(64) std::atomic<std::size_t> next{0};
+        alignas(64) std::atomic<std::size_t> helpers{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+    };
+
+    struct helper_task : task {
+        range_job* job;
+    };
+
+    void run_job(range_job& job);
+    static void run_chunks(range_job& job) noexcept;
+    void worker_main(unsigned index);
+    task* find_task(worker* self);
+    task* find_background(std::chrono::steady_clock::time_point& next_due);
+    void notify();
+
+    std::size_t auto_chunks(std::size_t n, std::size_t& grain) const noexcept
+    {
+        if (grain == 0)
+            grain = std::max<std::size_t>(1, n / (std::size_t(std::max(1u, worker_count())) * 8));
+        return (n + grain - 1) / grain;
+    }
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::mutex inject_mutex_;
+    std::deque<task*> inject_;
+    std::atomic<std::size_t> inject_size_{0};
+    // Min-heap on the due time.
+    std::mutex background_mutex_;
+    std::vector<std::pair<std::chrono::steady_clock::time_point, task*>> background_;
+    std::atomic<std::size_t> background_size_{0};
+    alignas(64) std::atomic<std::uint32_t> wake_epoch_{0};
+    std::atomic<unsigned> sleepers_{0};
+    std::atomic<bool> stop_{false};
+};
+
+/// Fork/join group of heap-allocated closures on a scheduler.
+class task_group {
+public:
+    explicit task_group(scheduler& sched = scheduler::instance()) : sched_(sched) {}
+    ~task_group() { wait_noexcept(); }
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    void run(std::function<void()> fn);
+    /// Wait for every closure started with run(), helping meanwhile, and
+    /// rethrow the first exception.
+    void wait();
+
+private:
+    struct fn_task : task {
+        std::function<void()> fn;
+        task_group* group;
+    };
+
+    void wait_noexcept() noexcept;
+
+    scheduler& sched_;
+    std::atomic<std::size_t> pending_{0};
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+template <class F>
+void scheduler::parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& f)
+{
+    if (end <= begin)
+        return;
+    const std::size_t chunks = auto_chunks(end - begin, grain);
+    if (chunks == 1 || workers_.empty()) {
+        f(begin, end);
+        return;
+    }
+    using fn_type = std::remove_reference_t<F>;
+    range_job job;
+    job.begin = begin;
+    job.end = end;
+    job.grain = grain;
+    job.chunks = chunks;
+    job.ctx = const_cast<void*>(static_cast<const void*>(std::addressof(f)));
+    job.body = [](void* ctx, std::size_t, std::size_t b, std::size_t e) { (*static_cast<fn_type*>(ctx))(b, e); };
+    run_job(job);
+}
+
+template <class T, class Map, class Combine>
+T scheduler::parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, T identity, Map&& map,
+    Combine&& combine)
+{
+    if (end <= begin)
+        return identity;
+    const std::size_t chunks = auto_chunks(end - begin, grain);
+    if (chunks == 1 || workers_.empty())
+        return combine(std::move(identity), map(begin, end));
+
+    struct context {
+        std::remove_reference_t<Map>* map;
+        std::vector<std::optional<T>> partial;
+    };
+    context ctx{std::addressof(map), std::vector<std::optional<T>>(chunks)};
+    range_job job;
+    job.begin = begin;
+    job.end = end;
+    job.grain = grain;
+    job.chunks = chunks;
+    job.ctx = &ctx;
+    job.body = [](void* p, std::size_t chunk, std::size_t b, std::size_t e) {
+        auto* c = static_cast<context*>(p);
+        c->partial[chunk].emplace((*c->map)(b, e));
+    };
+    run_job(job);
+
+    T acc = std::move(identity);
+    for (auto& part : ctx.partial)
+        acc = combine(std::move(acc), std::move(*part));
+    return acc;
+}
+
+} // namespace yeni
@@ -0,0 +1,359 @@
+#pragma once
+
+#include "yeni/segment.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace yeni {
+
+/// Record value layout described by a schema, shared by the run-time
+/// schema and static_schema so either reads what the other wrote:
+///
+///   fixed   every field at a constant offset, no padding: 8-byte numbers
+///           first, then each binary field's {u32 offset, u32 size} (the
+///           offset from the start of the record), then u32s, each group
+///           in declaration order
+///   tail    the bytes of the binary fields, in declaration order
+///
+/// Numbers are stored little-endian, as in segment columns. A record of
+/// a given schema is fixed_size() bytes plus its binary fields.
+namespace detail {
+
+template <class T>
+inline constexpr segment_format::column_type field_type = segment_format::type_of<T>;
+template <>
+inline constexpr segment_format::column_type field_type<std::span<const std::byte>> =
+    segment_format::column_type::binary;
+
+constexpr std::uint32_t field_width(segment_format::column_type type) noexcept
+{
+    return type == segment_format::column_type::u32 ? 4 : 8;
+}
+
+constexpr int field_group(segment_format::column_type type) noexcept
+{
+    switch (type) {
+    case segment_format::column_type::binary:
+        return 1;
+    case segment_format::column_type::u32:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+/// Fill in the offset of each of `types`; returns the fixed part's size.
+constexpr std::uint32_t layout_fields(std::span<const segment_format::column_type> types,
+    std::span<std::uint32_t> offsets) noexcept
+{
+    std::uint32_t at = 0;
+    for (int group = 0; group < 3; ++group)
+        for (std::size_t i = 0; i < types.size(); ++i)
+            if (field_group(types[i]) == group) {
+                offsets[i] = at;
+                at += field_width(types[i]);
+            }
+    return at;
+}
+
+inline std::span<const std::byte> read_binary_field(std::span<const std::byte> record, std::uint32_t offset) noexcept
+{
+    std::uint32_t ref[2];
+    std::memcpy(ref, record.data() + offset, sizeof(ref));
+    return {record.data() + ref[0], ref[1]};
+}
+
+inline bool binary_field_ok(std::span<const std::byte> record, std::uint32_t offset) noexcept
+{
+    std::uint32_t ref[2];
+    std::memcpy(ref, record.data() + offset, sizeof(ref));
+    return std::uint64_t(ref[0]) + ref[1] <= record.size();
+}
+
+/// Three-way comparison of two values of one field.
+template <class T>
+int compare_field(const T& a, const T& b) noexcept
+{
+    if constexpr (std::is_same_v<T, std::span<const std::byte>>) {
+        const std::size_t n = std::min(a.size(), b.size());
+        if (const int c = n ? std::memcmp(a.data(), b.data(), n) : 0)
+            return c < 0 ? -1 : 1;
+        return a.size() < b.size() ? -1 : a.size() > b.size();
+    } else {
+        return a < b ? -1 : b < a;
+    }
+}
+
+/// Size of a record with `tail` bytes of binary fields; throws if that
+/// would overflow the u32 offsets.
+inline std::uint32_t record_size(std::uint32_t fixed_size, std::uint64_t tail)
+{
+    if (tail > std::uint64_t(UINT32_MAX) - fixed_size)
+        throw std::invalid_argument("yeni: record too large for its schema");
+    return fixed_size + std::uint32_t(tail);
+}
+
+} // namespace detail
+
+/// Schema assembled at run time, for record layouts that are only known
+/// then (ad-hoc imports, tools reading someone else's data). Every field
+/// access switches on the field's type; static_schema is the same layout
+/// with that switch resolved at compile time.
+class schema {
+public:
+    struct field {
+        std::string name;
+        segment_format::column_type type;
+    };
+
+    /// One field's value; the alternative index is the column_type less
+    /// one. Binary values point into the record they were read from.
+    using value = std::variant<std::uint32_t, std::uint64_t, std::int64_t, double, std::span<const std::byte>>;
+
+    /// Throws std::invalid_argument for no fields, a name that is empty,
+    /// repeated or too long for a segment column, or a type of none.
+    explicit schema(std::vector<field> fields);
+
+    std::size_t size() const noexcept { return fields_.size(); }
+    std::span<const field> fields() const noexcept { return fields_; }
+    std::uint32_t offset(std::size_t i) const noexcept { return offsets_[i]; }
+    std::uint32_t fixed_size() const noexcept { return fixed_size_; }
+    std::optional<std::size_t> index_of(std::string_view name) const noexcept;
+
+    /// Field `i` of a record validate() accepts.
+    value get(std::span<const std::byte> record, std::size_t i) const noexcept;
+
+    /// Encode one value per field into `out`, replacing its contents.
+    /// Throws std::invalid_argument for the wrong number or types of values.
+    void encode_into(std::vector<std::byte>& out, std::span<const value> values) const;
+    std::vector<std::byte> encode(std::span<const value> values) const;
+    /// encode_into() onto the end of `out`, leaving what it held in front.
+    void append(std::vector<std::byte>& out, std::span<const value> values) const;
+
+    /// Whether `record` holds the fixed part and every binary field lies
+    /// within it: the check for records from outside the process.
+    bool validate(std::span<const std::byte> record) const noexcept;
+
+    /// Three-way comparison of two records on `fields` in turn; numbers
+    /// by value, binary fields by memcmp.
+    int compare(std::span<const std::byte> a, std::span<const std::byte> b,
+        std::span<const std::size_t> fields) const noexcept;
+
+    /// Add a column per field to `w`, named after it, holding the fields
+    /// of `rows` (records validate() accepts).
+    void add_columns(segment_writer& w, std::span<const std::span<const std::byte>> rows) const;
+
+private:
+    std::vector<field> fields_;
+    std::vector<std::uint32_t> offsets_;
+    std::uint32_t fixed_size_ = 0;
+};
+
+/// Compile-time field name, usable as a template argument.
+template <std::size_t N>
+struct fixed_string {
+    char chars[N] = {};
+
+    constexpr fixed_string(const char (&s)[N]) noexcept
+    {
+        for (std::size_t i = 0; i < N; ++i)
+            chars[i] = s[i];
+    }
+    constexpr std::string_view view() const noexcept { return {chars, N - 1}; }
+};
+
+/// One field of a static_schema: std::uint32_t, std::uint64_t,
+/// std::int64_t, double, or std::span<const std::byte> for binary.
+template <fixed_string Name, class T>
+struct field {
+    static_assert(detail::field_type<T> != segment_format::column_type::none, "unsupported field type");
+    static_assert(!Name.view().empty() && Name.view().size() < segment_format::max_name,
+        "field names must fit a segment column name");
+
+    using type = T;
+    static constexpr std::string_view name = Name.view();
+    static constexpr segment_format::column_type column = detail::field_type<T>;
+};
+
+/// Schema fixed at compile time: the layout of yeni::schema (see above)
+/// with every offset a constant, so reading a field is one load from the
+/// record and encode/compare are unrolled over the fields' real types.
+///
+///   using order = static_schema<field<"id", std::uint64_t>,
+///       field<"qty", std::uint32_t>, field<"sku", std::span<const std::byte>>>;
+///   store.append(k, order::encode(id, qty, sku));
+///   std::uint32_t q = order::get<"qty">(r->value());
+template <class... Fields>
+class static_schema {
+public:
+    static constexpr std::size_t size = sizeof...(Fields);
+    static_assert(size > 0, "a schema needs at least one field");
+
+    using tuple_type = std::tuple<typename Fields::type...>;
+    template <std::size_t I>
+    using type = std::tuple_element_t<I, tuple_type>;
+
+    static constexpr std::array<std::string_view, size> names{Fields::name...};
+    static constexpr std::array<segment_format::column_type, size> types{Fields::column...};
+    static constexpr std::array<std::uint32_t, size> offsets = [] {
+        std::array<std::uint32_t, size> o{};
+        detail::layout_fields(types, o);
+        return o;
+    }();
+    static constexpr std::uint32_t fixed_size = [] {
+        std::array<std::uint32_t, size> o{};
+        return detail::layout_fields(types, o);
+    }();
+
+    static_assert([] {
+        for (std::size_t i = 0; i < size; ++i)
+            for (std::size_t j = 0; j < i; ++j)
+                if (names[i] == names[j])
+                    return false;
+        return true;
+    }(), "field names must be unique");
+
+    template <fixed_string Name>
+    static constexpr std::size_t index_of = [] {
+        std::size_t i = 0;
+        while (i < size && names[i] != Name.view())
+            ++i;
+        return i;
+    }();
+
+    /// Field `I` of a record validate() accepts.
+    template <std::size_t I>
+    static type<I> get(std::span<const std::byte> record) noexcept
+    {
+        if constexpr (types[I] == segment_format::column_type::binary) {
+            return detail::read_binary_field(record, offsets[I]);
+        } else {
+            type<I> v;
+            std::memcpy(&v, record.data() + offsets[I], sizeof(v));
+            return v;
+        }
+    }
+
+    template <fixed_string Name>
+    static auto get(std::span<const std::byte> record) noexcept
+    {
+        static_assert(index_of<Name> < size, "no field of that name");
+        return get<index_of<Name>>(record);
+    }
+
+    static tuple_type decode(std::span<const std::byte> record) noexcept
+    {
+        return [&]<std::size_t... I>(std::index_sequence<I...>) {
+            return tuple_type(get<I>(record)...);
+        }(std::make_index_sequence<size>{});
+    }
+
+    /// Encode into `out`, replacing its contents. Throws
+    /// std::invalid_argument if the binary fields overflow the u32 offsets.
+    static void encode_into(std::vector<std::byte>& out, const typename Fields::type&... values)
+    {
+        std::uint64_t tail = 0;
+        ((tail += binary_size(values)), ...);
+        out.resize(detail::record_size(fixed_size, tail));
+        std::uint32_t at = fixed_size;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (put<I>(out.data(), at, values), ...);
+        }(std::make_index_sequence<size>{});
+    }
+
+    static std::vector<std::byte> encode(const typename Fields::type&... values)
+    {
+        std::vector<std::byte> out;
+        encode_into(out, values...);
+        return out;
+    }
+
+    /// See schema::validate().
+    static bool validate(std::span<const std::byte> record) noexcept
+    {
+        if (record.size() < fixed_size)
+            return false;
+        bool ok = true;
+        for (std::size_t i = 0; i < size; ++i)
+            if (types[i] == segment_format::column_type::binary)
+                ok &= detail::binary_field_ok(record, offsets[i]);
+        return ok;
+    }
+
+    /// Three-way comparison of two records on fields `Names` in turn.
+    template <fixed_string... Names>
+    static int compare(std::span<const std::byte> a, std::span<const std::byte> b) noexcept
+    {
+        static_assert(sizeof...(Names) > 0 && ((index_of<Names> < size) && ...), "no field of that name");
+        int c = 0;
+        (void)(((c = detail::compare_field(get<index_of<Names>>(a), get<index_of<Names>>(b))) != 0) || ...);
+        return c;
+    }
+
+    /// See schema::add_columns().
+    static void add_columns(segment_writer& w, std::span<const std::span<const std::byte>> rows)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (add_column<I>(w, rows), ...);
+        }(std::make_index_sequence<size>{});
+    }
+
+    /// The same layout as a run-time schema.
+    static schema dynamic()
+    {
+        return schema(std::vector<schema::field>{{std::string(Fields::name), Fields::column}...});
+    }
+
+private:
+    template <class T>
+    static std::uint64_t binary_size(const T& v) noexcept
+    {
+        if constexpr (std::is_same_v<T, std::span<const std::byte>>)
+            return v.size();
+        else
+            return 0;
+    }
+
+    template <std::size_t I>
+    static void put(std::byte* out, std::uint32_t& at, const type<I>& v) noexcept
+    {
+        if constexpr (types[I] == segment_format::column_type::binary) {
+            const std::uint32_t ref[2] = {at, std::uint32_t(v.size())};
+            std::memcpy(out + offsets[I], ref, sizeof(ref));
+            if (!v.empty())
+                std::memcpy(out + at, v.data(), v.size());
+            at += std::uint32_t(v.size());
+        } else {
+            std::memcpy(out + offsets[I], &v, sizeof(v));
+        }
+    }
+
+    template <std::size_t I>
+    static void add_column(segment_writer& w, std::span<const std::span<const std::byte>> rows)
+    {
+        if constexpr (types[I] == segment_format::column_type::binary) {
+            w.add_binary_column(names[I], rows.size(), [&](std::size_t r) { return get<I>(rows[r]); });
+        } else {
+            std::vector<type<I>> column(rows.size());
+            for (std::size_t r = 0; r < rows.size(); ++r)
+                column[r] = get<I>(rows[r]);
+            w.add_column<type<I>>(names[I], column);
+        }
+    }
+};
+
+} // namespace yeni
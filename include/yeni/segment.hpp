@@ -0,0 +1,368 @@
+#pragma once
+
+#include "yeni/block_cache.hpp"
+#include "yeni/bloom_filter.hpp"
+#include "yeni/codec.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace yeni {
+
+class io_awaitable;
+class io_context;
+class record_store;
+
+namespace detail {
+struct decoded_block;
+} // namespace detail
+
+/// Column-oriented, memory-mappable segment file.
+///
+///   header   64 bytes, magic "YENISEG1"
+///   blocks   each starts on a 64-byte boundary
+///   footer   one block_desc per block
+///   trailer  64 bytes: footer offset, block count, row count, magic
+///
+/// Fixed-width columns are raw little-endian arrays; binary columns store
+/// rows+1 u64 offsets followed by the concatenated bytes. Either may
+/// instead be encoded as block_desc::encoding says (a column_encoding, see
+/// yeni/codec.hpp). Everything a reader needs is reachable from the
+/// trailer, so opening a segment is an mmap plus a footer validation.
+namespace segment_format {
+
+inline constexpr char magic[8] = {'Y', 'E', 'N', 'I', 'S', 'E', 'G', '1'};
+inline constexpr char trailer_magic[8] = {'Y', 'E', 'N', 'I', 'S', 'E', 'G', 'F'};
+inline constexpr std::uint32_t version = 1;
+inline constexpr std::size_t alignment = 64;
+inline constexpr std::size_t max_name = 32;
+
+enum class block_kind : std::uint8_t {
+    column = 1,
+    aux = 2, // filters, indexes and other per-segment metadata
+};
+
+enum class column_type : std::uint8_t {
+    none = 0,
+    u32 = 1,
+    u64 = 2,
+    i64 = 3,
+    f64 = 4,
+    binary = 5,
+};
+
+struct header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint8_t reserved[48];
+};
+static_assert(sizeof(header) == alignment);
+
+struct block_desc {
+    char name[max_name]; // NUL-padded
+    block_kind kind;
+    column_type type;
+    std::uint8_t encoding; // column_encoding for column blocks
+    std::uint8_t reserved0;
+    std::uint32_t reserved1;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t rows;
+
+    std::string_view name_view() const noexcept
+    {
+        std::size_t n = 0;
+        while (n < max_name && name[n])
+            ++n;
+        return {name, n};
+    }
+};
+static_assert(sizeof(block_desc) == alignment);
+
+struct trailer {
+    std::uint64_t footer_offset;
+    std::uint64_t rows;
+    std::uint32_t block_count;
+    std::uint32_t flags;
+    std::uint8_t reserved[32];
+    char magic[8];
+};
+static_assert(sizeof(trailer) == alignment);
+
+template <class T>
+inline constexpr column_type type_of = column_type::none;
+template <>
+inline constexpr column_type type_of<std::uint32_t> = column_type::u32;
+template <>
+inline constexpr column_type type_of<std::uint64_t> = column_type::u64;
+template <>
+inline constexpr column_type type_of<std::int64_t> = column_type::i64;
+template <>
+inline constexpr column_type type_of<double> = column_type::f64;
+
+} // namespace segment_format
+
+/// Streams blocks into a new segment file. The file is written under a
+/// temporary name and renamed into place by finish(), so readers never see
+/// a partial segment.
+///
+/// Given an io_context, full buffers are handed to it and written while
+/// the caller keeps serialising into the next one; the caller only waits
+/// when every pipeline buffer is in flight, and in finish().
+///
+/// Each column is encoded as `codec` picks for it; see choose_encoding().
+class segment_writer {
+public:
+    explicit segment_writer(std::filesystem::path path, io_context* io = nullptr, const codec_options& codec = {});
+    ~segment_writer();
+
+    segment_writer(const segment_writer&) = delete;
+    segment_writer& operator=(const segment_writer&) = delete;
+
+    /// Add a fixed-width column. Every column must have the same row count.
+    template <class T>
+    void add_column(std::string_view name, std::span<const T> values)
+    {
+        static_assert(segment_format::type_of<T> != segment_format::column_type::none, "unsupported column type");
+        add_fixed(name, segment_format::type_of<T>, values.data(), values.size(), sizeof(T));
+    }
+
+    /// Add a binary column; `get(i)` returns row i as a byte span and is
+    /// called twice per row (offsets pass, then data pass).
+    template <class F>
+    void add_binary_column(std::string_view name, std::size_t rows, F&& get)
+    {
+        if (codec_.encode && codec_.binary != column_encoding::plain) {
+            std::vector<std::byte> raw((rows + 1) * sizeof(std::uint64_t));
+            std::uint64_t off = 0;
+            for (std::size_t i = 0; i < rows; ++i) {
+                std::span<const std::byte> v = get(i);
+                raw.insert(raw.end(), v.begin(), v.end());
+                off += v.size();
+                std::memcpy(raw.data() + (i + 1) * sizeof(off), &off, sizeof(off));
+            }
+            add_compressed_binary(name, rows, raw);
+            return;
+        }
+        begin_block(name, segment_format::block_kind::column, segment_format::column_type::binary, rows);
+        std::uint64_t off = 0;
+        put_pod(off);
+        for (std::size_t i = 0; i < rows; ++i) {
+            off += std::span<const std::byte>(get(i)).size();
+            put_pod(off);
+        }
+        for (std::size_t i = 0; i < rows; ++i) {
+            std::span<const std::byte> v = get(i);
+            put(v.data(), v.size());
+        }
+        end_block();
+    }
+
+    /// Add an opaque auxiliary block.
+    void add_block(std::string_view name, std::span<const std::byte> data, std::uint8_t encoding = 0);
+
+    /// Write footer and trailer, sync and publish the file.
+    void finish();
+
+    std::uint64_t bytes_written() const noexcept { return offset_ + buffer_.size(); }
+
+private:
+    void add_fixed(std::string_view name, segment_format::column_type type, const void* data, std::size_t rows,
+        std::size_t width);
+    void add_compressed_binary(std::string_view name, std::size_t rows, std::span<const std::byte> raw);
+    void begin_block(std::string_view name, segment_format::block_kind kind, segment_format::column_type type,
+        std::size_t rows);
+    void end_block();
+    void pad_to_alignment();
+    void put(const void* data, std::size_t size);
+    template <class T>
+    void put_pod(const T& v)
+    {
+        put(&v, sizeof(v));
+    }
+    void flush_buffer();
+
+    struct pipeline;
+
+    std::filesystem::path path_;
+    std::filesystem::path tmp_path_;
+    codec_options codec_;
+    int fd_ = -1;
+    std::unique_ptr<pipeline> pipeline_;
+    std::uint64_t offset_ = 0; // bytes already handed to the kernel
+    std::vector<std::byte> buffer_;
+    std::vector<segment_format::block_desc> blocks_;
+    std::optional<std::uint64_t> rows_;
+    bool finished_ = false;
+};
+
+/// Zero-copy view of a binary column. Offsets are only validated when a
+/// row is read, so opening a segment never touches the whole column.
+class binary_column {
+public:
+    binary_column() = default;
+    binary_column(const std::uint64_t* offsets, const std::byte* data, std::size_t rows, std::uint64_t data_size) noexcept
+        : offsets_(offsets)
+        , data_(data)
+        , rows_(rows)
+        , data_size_(data_size)
+    {
+    }
+
+    std::size_t size() const noexcept { return rows_; }
+    std::span<const std::byte> operator[](std::size_t i) const
+    {
+        const std::uint64_t begin = offsets_[i], end = offsets_[i + 1];
+        if (begin > end || end > data_size_) [[unlikely]]
+            out_of_range();
+        return {data_ + begin, std::size_t(end - begin)};
+    }
+
+private:
+    [[noreturn]] static void out_of_range();
+
+    const std::uint64_t* offsets_ = nullptr;
+    const std::byte* data_ = nullptr;
+    std::size_t rows_ = 0;
+    std::uint64_t data_size_ = 0;
+};
+
+/// A read-only, memory-mapped segment. Column accessors return spans that
+/// stay valid as long as the segment: into the mapping for plain columns,
+/// into memory the column is decoded to on first access otherwise. scan()
+/// and the segment overloads of the predicate kernels read packed columns
+/// a page at a time instead.
+class segment {
+public:
+    static constexpr std::string_view key_column = "key";
+    static constexpr std::string_view value_column = "value";
+    /// Aux block holding a bloom_filter over the key column.
+    static constexpr std::string_view filter_block = "key_filter";
+
+    /// Map and validate `path`. Throws std::system_error or format_error.
+    static segment open(const std::filesystem::path& path);
+
+    segment(segment&& other) noexcept;
+    segment& operator=(segment&& other) noexcept;
+    ~segment();
+
+    segment(const segment&) = delete;
+    segment& operator=(const segment&) = delete;
+
+    std::uint64_t rows() const noexcept { return rows_; }
+    std::size_t file_size() const noexcept { return size_; }
+    const std::filesystem::path& path() const noexcept { return path_; }
+    /// Unique within the process; names the segment's blocks in a
+    /// block_cache.
+    std::uint64_t id() const noexcept { return id_; }
+    std::span<const segment_format::block_desc> blocks() const noexcept { return blocks_; }
+
+    /// Block descriptor by name, or nullptr.
+    const segment_format::block_desc* find_block(std::string_view name) const noexcept;
+
+    /// Raw bytes of a block. Throws format_error if it does not exist.
+    std::span<const std::byte> block_data(std::string_view name) const;
+
+    template <class T>
+    std::span<const T> column(std::string_view name) const
+    {
+        const auto& d = typed_block(name, segment_format::type_of<T>);
+        return {reinterpret_cast<const T*>(column_data(d)), std::size_t(d.rows)};
+    }
+
+    binary_column binary(std::string_view name) const;
+
+    /// Front-coded binary column `name`, read in place. Throws format_error
+    /// if it is stored any other way.
+    front_coded_column front_coded(std::string_view name) const;
+
+    /// How column `name` is stored. Throws format_error if there is none.
+    column_encoding encoding(std::string_view name) const;
+
+    /// Call `f(first_row, rows)` over column `name` in order, packed_page_rows
+    /// rows at a time (the last call may get fewer). Packed columns are
+    /// decoded page by page into a buffer on the stack, so the column is
+    /// never decoded whole; the rest are read in place.
+    template <class T, class F>
+    void scan(std::string_view name, F&& f) const
+    {
+        const auto& d = typed_block(name, segment_format::type_of<T>);
+        if (const auto e = column_encoding(d.encoding); is_packed(e)) {
+            const packed_column<T> c({base_ + d.offset, std::size_t(d.size)}, e);
+            alignas(64) T page[packed_page_rows];
+            for (std::size_t p = 0; p < c.pages(); ++p) {
+                const std::size_t n = c.decode_page(p, page);
+                f(p * packed_page_rows, std::span<const T>(page, n));
+            }
+            return;
+        }
+        const std::span<const T> all = column<T>(name);
+        for (std::size_t i = 0; i < all.size(); i += packed_page_rows)
+            f(i, all.subspan(i, std::min(packed_page_rows, all.size() - i)));
+    }
+
+    /// The u64 key column, empty if the segment has none.
+    std::span<const std::uint64_t> keys() const noexcept { return keys_; }
+
+    /// Filter over the key column; passes every key if the segment has
+    /// none. Reads the mapping in place.
+    const bloom_filter& key_filter() const noexcept { return filter_; }
+
+    /// Row of `key` in the key column, if present. The key column must be
+    /// sorted, as write_segment() produces it. Keys the filter rules out
+    /// never touch the key column.
+    std::optional<std::size_t> find(std::uint64_t key) const;
+
+    /// Read up to out.size() bytes of block `name`, starting `from` bytes
+    /// into it, through `io` instead of the mapping: a cold block then
+    /// costs the awaiting coroutine a suspension rather than a worker a
+    /// stream of page faults. Include yeni/io.hpp to co_await the result.
+    io_awaitable read_async(io_context& io, std::string_view name, std::span<std::byte> out,
+        std::uint64_t from = 0) const;
+
+    /// Chunk `chunk` (cache.block_bytes() long, the last one shorter) of
+    /// block `name` from `cache`, read with pread() on a miss rather than
+    /// faulted in through the mapping. For segments that do not fit in the
+    /// page cache, so that the hot blocks stay resident.
+    block_cache::handle read_cached(block_cache& cache, std::string_view name, std::uint64_t chunk) const;
+
+private:
+    segment() = default;
+    const segment_format::block_desc& typed_block(std::string_view name, segment_format::column_type type) const;
+    /// Why an encoded column block is unreadable, or nullptr. Run at open,
+    /// so that decoding later never reads out of bounds.
+    const char* check_encoded(const segment_format::block_desc& d) const noexcept;
+    /// Plain bytes of a column block, decoding it on first use.
+    const std::byte* column_data(const segment_format::block_desc& d) const;
+    void release() noexcept;
+
+    std::filesystem::path path_;
+    std::uint64_t id_ = 0;
+    int fd_ = -1; // kept open for read_async() and read_cached()
+    const std::byte* base_ = nullptr;
+    std::size_t size_ = 0;
+    std::uint64_t rows_ = 0;
+    std::span<const segment_format::block_desc> blocks_;
+    std::span<const std::uint64_t> keys_;
+    bloom_filter filter_;
+    std::unique_ptr<detail::decoded_block[]> decoded_; // per block, if any is encoded
+};
+
+/// Flush the latest version of every key in `store` into a segment with a
+/// sorted u64 "key" column and a binary "value" column. Must not run
+/// concurrently with appends. With `io`, writes are pipelined through it.
+void write_segment(const std::filesystem::path& path, const record_store& store, io_context* io = nullptr,
+    const codec_options& codec = {});
+
+} // namespace yeni
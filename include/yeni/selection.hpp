@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace yeni {
+
+/// One bit per row: set when the row passed every predicate applied so far.
+///
+/// Bits past size() in the last word are always zero, so count() and the
+/// word-wise combinators never need a tail mask.
+class selection_bitmap {
+public:
+    selection_bitmap() = default;
+    explicit selection_bitmap(std::size_t rows, bool value = false) { assign(rows, value); }
+
+    void assign(std::size_t rows, bool value)
+    {
+        rows_ = rows;
+        words_.assign(word_count(rows), value ? ~std::uint64_t(0) : 0);
+        clear_tail();
+    }
+
+    /// Size for `rows` rows without initialising the words; kernels that
+    /// overwrite every word use this.
+    void resize_for_overwrite(std::size_t rows)
+    {
+        rows_ = rows;
+        words_.resize(word_count(rows));
+    }
+
+    std::size_t size() const noexcept { return rows_; }
+    std::span<std::uint64_t> words() noexcept { return words_; }
+    std::span<const std::uint64_t> words() const noexcept { return words_; }
+
+    bool test(std::size_t i) const noexcept { return (words_[i >> 6] >> (i & 63)) & 1; }
+    void set(std::size_t i) noexcept { words_[i >> 6] |= std::uint64_t(1) << (i & 63); }
+    void reset(std::size_t i) noexcept { words_[i >> 6] &= ~(std::uint64_t(1) << (i & 63)); }
+
+    std::size_t count() const noexcept
+    {
+        std::size_t n = 0;
+        for (std::uint64_t w : words_)
+            n += std::size_t(std::popcount(w));
+        return n;
+    }
+
+    bool none() const noexcept
+    {
+        return std::all_of(words_.begin(), words_.end(), [](std::uint64_t w) { return w == 0; });
+    }
+
+    selection_bitmap& operator&=(const selection_bitmap& o) noexcept
+    {
+        const std::size_t n = std::min(words_.size(), o.words_.size());
+        for (std::size_t i = 0; i < n; ++i)
+            words_[i] &= o.words_[i];
+        std::fill(words_.begin() + std::ptrdiff_t(n), words_.end(), 0);
+        return *this;
+    }
+
+    selection_bitmap& operator|=(const selection_bitmap& o) noexcept
+    {
+        const std::size_t n = std::min(words_.size(), o.words_.size());
+        for (std::size_t i = 0; i < n; ++i)
+            words_[i] |= o.words_[i];
+        clear_tail();
+        return *this;
+    }
+
+    void flip() noexcept
+    {
+        for (auto& w : words_)
+            w = ~w;
+        clear_tail();
+    }
+
+    /// Call `f(row)` for every selected row in ascending order.
+    template <class F>
+    void for_each(F&& f) const
+    {
+        for (std::size_t wi = 0; wi < words_.size(); ++wi) {
+            for (std::uint64_t w = words_[wi]; w; w &= w - 1)
+                f(wi * 64 + std::size_t(std::countr_zero(w)));
+        }
+    }
+
+    /// Write selected row indexes into `out`, starting at word `first_word`.
+    /// Stops before a word that would overflow `out`; `first_word` is left
+    /// at the word to resume from. Returns the number of rows written.
+    std::size_t extract(std::size_t& first_word, std::span<std::uint32_t> out) const noexcept
+    {
+        std::size_t n = 0;
+        std::size_t wi = first_word;
+        for (; wi < words_.size(); ++wi) {
+            std::uint64_t w = words_[wi];
+            if (std::size_t(std::popcount(w)) > out.size() - n)
+                break;
+            for (; w; w &= w - 1)
+                out[n++] = std::uint32_t(wi * 64 + std::size_t(std::countr_zero(w)));
+        }
+        first_word = wi;
+        return n;
+    }
+
+    void clear_tail() noexcept
+    {
+        if (rows_ & 63)
+            words_.back() &= (std::uint64_t(1) << (rows_ & 63)) - 1;
+    }
+
+private:
+    static std::size_t word_count(std::size_t rows) noexcept { return (rows + 63) / 64; }
+
+    std::vector<std::uint64_t> words_;
+    std::size_t rows_ = 0;
+};
+
+} // namespace yeni
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "yeni/block_cache.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/memory.hpp"
+#include "yeni/mpsc_queue.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/spsc_queue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace yeni {
+
+class shard;
+
+/// Unit of work handed to a shard. Owned by whoever posts it; the shard
+/// only calls `run` once, on its own thread, and never frees it.
+struct shard_message {
+    void (*run)(shard_message*, shard&) noexcept;
+};
+
+struct shard_group_options {
+    /// Shards, one thread each; 0 means one per CPU in the process
+    /// affinity mask.
+    unsigned shards = 0;
+    /// Pin each shard's thread to one CPU, filling NUMA nodes in order.
+    bool pin = true;
+    /// Messages each shard-to-shard ring holds.
+    std::size_t ring_capacity = 256;
+    /// Pages of each shard's memory provider, which is bound to the
+    /// shard's node.
+    page_size pages = page_size::transparent;
+    std::size_t arena_block_size = arena::default_block_size;
+    /// Options of each shard's block cache; `memory` is ignored.
+    block_cache_options cache = {.capacity_bytes = std::size_t(16) << 20, .shards = 1};
+};
+
+/// What one shard owns. Only ever touched from the shard's own thread.
+class shard {
+public:
+    unsigned id() const noexcept { return id_; }
+    unsigned node() const noexcept { return node_; }
+
+    memory_provider& memory() noexcept { return *memory_; }
+    record_store& store() noexcept { return *store_; }
+    block_cache& cache() noexcept { return *cache_; }
+
+private:
+    friend class shard_group;
+
+    unsigned id_ = 0;
+    unsigned node_ = 0;
+    int cpu_ = -1; // -1 when not pinned
+    std::unique_ptr<page_provider> memory_;
+    std::unique_ptr<record_store> store_;
+    std::unique_ptr<block_cache> cache_;
+};
+
+/// Shared-nothing mode: the keyspace hash-partitioned across cores.
+///
+/// Each shard is a thread, pinned to a CPU, that owns a memory provider
+/// bound to its NUMA node and a record store and block cache drawing from
+/// it, all created on that thread so their pages are first touched there.
+/// Nothing of a shard is shared: everything else reaches it by message.
+///
+/// Every pair of shards has an spsc_queue of messages of its own, so two
+/// shards talking never write a cache line a third one touches; threads
+/// outside the group post through one mpsc_queue per shard. A shard runs
+/// what its rings hold and sleeps on a futex once they are all empty.
+/// Waiting on a reply, a shard keeps running the messages sent to it, so
+/// shards calling each other cannot deadlock.
+///
+/// This complements the work-stealing scheduler rather than replacing it:
+/// scheduler work shares structures across cores and balances load; work
+/// here stays where its keys live.
+class shard_group {
+public:
+    explicit shard_group(shard_group_options options = {});
+    /// Runs every message already posted, then stops the shards.
+    ~shard_group();
+
+    shard_group(const shard_group&) = delete;
+    shard_group& operator=(const shard_group&) = delete;
+
+    unsigned size() const noexcept { return unsigned(shards_.size()); }
+
+    /// Shard owning `key`.
+    unsigned shard_of(std::uint64_t key) const noexcept { return unsigned(mix64(key) % shards_.size()); }
+
+    /// The calling thread's shard of *this* group, or nullptr.
+    shard* current() const noexcept;
+
+    /// Queue `m` for shard `to`. Safe from any thread; blocks while the
+    /// ring is full, running the caller's own messages meanwhile if it is
+    /// a shard.
+    void post(unsigned to, shard_message& m);
+
+    /// Run `f(shard&)` on shard `to` and return what it returns, rethrowing
+    /// what it throws. Runs inline when called on `to` itself.
+    template <class F>
+    auto invoke_on(unsigned to, F&& f) -> std::invoke_result_t<F&, shard&>;
+
+    /// invoke_on() every shard concurrently; rethrows the first exception
+    /// once all have run.
+    template <class F>
+    void invoke_on_all(F&& f);
+
+    /// record_store::append() on the key's shard.
+    const record* append(std::uint64_t key, std::span<const std::byte> value)
+    {
+        return invoke_on(shard_of(key), [&](shard& s) { return s.store().append(key, value); });
+    }
+
+    /// record_store::find() on the key's shard. The record stays valid
+    /// until its shard's store is reset.
+    const record* find(std::uint64_t key)
+    {
+        return invoke_on(shard_of(key), [&](shard& s) { return s.store().find(key); });
+    }
+
+private:
+    struct alignas(64) mailbox {
+        std::atomic<std::uint32_t> doorbell{0}; // bumped to wake a sleeping shard
+        std::atomic<std::uint32_t> sleeping{0};
+        std::unique_ptr<mpsc_queue<shard_message*>> inject; // from outside the group
+    };
+
+    // A reply being waited for: the caller sleeps on `done`, or on its
+    // shard's doorbell if it is a shard.
+    struct reply {
+        std::atomic<std::uint32_t> done{0};
+        int waiter = -1;
+    };
+
+    template <class F>
+    struct call;
+
+    spsc_queue<shard_message*>& ring(unsigned from, unsigned to) noexcept { return *rings_[to * size() + from]; }
+
+    void shard_main(unsigned index);
+    void stop() noexcept;
+    bool poll(shard& self);
+    void ring_doorbell(unsigned to) noexcept;
+    void complete(reply& r) noexcept;
+    void await(reply& r);
+
+    shard_group_options options_;
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::unique_ptr<mailbox[]> mailboxes_;
+    std::vector<std::unique_ptr<spsc_queue<shard_message*>>> rings_; // [to * size() + from]
+    std::vector<std::thread> threads_;
+    std::vector<std::exception_ptr> start_errors_;
+    std::atomic<std::uint32_t> ready_{0}; // shards done starting
+    std::atomic<bool> stop_{false};
+};
+
+template <class F>
+struct shard_group::call : shard_message {
+    using result_type = std::invoke_result_t<F&, shard&>;
+    using stored_type = std::conditional_t<std::is_void_v<result_type>, bool, result_type>;
+
+    call(shard_group& g, F& fn) noexcept : group(&g), f(&fn)
+    {
+        if (shard* self = g.current())
+            done.waiter = int(self->id());
+        run = [](shard_message* m, shard& s) noexcept {
+            auto* c = static_cast<call*>(m);
+            try {
+                if constexpr (std::is_void_v<result_type>) {
+                    (*c->f)(s);
+                    c->result.emplace(true);
+                } else {
+                    c->result.emplace((*c->f)(s));
+                }
+            } catch (...) {
+                c->error = std::current_exception();
+            }
+            c->group->complete(c->done);
+        };
+    }
+
+    result_type get()
+    {
+        if (error)
+            std::rethrow_exception(error);
+        if constexpr (!std::is_void_v<result_type>)
+            return std::move(*result);
+    }
+
+    shard_group* group;
+    F* f;
+    std::optional<stored_type> result;
+    std::exception_ptr error;
+    reply done;
+};
+
+template <class F>
+auto shard_group::invoke_on(unsigned to, F&& f) -> std::invoke_result_t<F&, shard&>
+{
+    if (shard* self = current(); self && self->id() == to)
+        return f(*self);
+    call<std::remove_reference_t<F>> c(*this, f);
+    post(to, c);
+    await(c.done);
+    return c.get();
+}
+
+template <class F>
+void shard_group::invoke_on_all(F&& f)
+{
+    using call_type = call<std::remove_reference_t<F>>;
+    std::vector<std::unique_ptr<call_type>> calls;
+    calls.reserve(size());
+    for (unsigned i = 0; i < size(); ++i) {
+        calls.push_back(std::make_unique<call_type>(*this, f));
+        post(i, *calls.back());
+    }
+    for (auto& c : calls)
+        await(c->done);
+    for (auto& c : calls)
+        c->get();
+}
+
+} // namespace yeni
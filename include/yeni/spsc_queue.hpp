@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+
+namespace yeni {
+
+/// Bounded lock-free single-producer/single-consumer ring.
+///
+/// Head and tail live on cache lines of their own, and each side keeps a
+/// private copy of the other's index that it refreshes only when the ring
+/// looks full (or empty) through it, so in steady state a push or pop
+/// touches no line the other side writes. Never blocks: waiting is up to
+/// the caller, which is what lets shard_group poll many rings at once.
+template <class T>
+class spsc_queue {
+public:
+    explicit spsc_queue(std::size_t capacity)
+    {
+        std::size_t cap = 2;
+        while (cap < capacity)
+            cap <<= 1;
+        mask_ = cap - 1;
+        slots_.reset(new T[cap]);
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    std::size_t capacity() const noexcept { return mask_ + 1; }
+
+    /// Producer only: enqueue unless the ring is full. `v` is only moved
+    /// from on success.
+    bool try_push(T&& v)
+    {
+        const std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_)
+                return false;
+        }
+        slots_[tail & mask_] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_push(const T& v)
+    {
+        T copy(v);
+        return try_push(std::move(copy));
+    }
+
+    /// Consumer only.
+    bool try_pop(T& out) { return try_pop_batch(std::span<T>(&out, 1)) == 1; }
+
+    /// Consumer only: dequeue up to out.size() items, releasing their slots
+    /// to the producer with one store.
+    std::size_t try_pop_batch(std::span<T> out)
+    {
+        const std::uint64_t head = head_.load(std::memory_order_relaxed);
+        if (tail_cache_ - head < out.size())
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+        const std::size_t n = std::min<std::size_t>(out.size(), std::size_t(tail_cache_ - head));
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = std::move(slots_[(head + i) & mask_]);
+        if (n)
+            head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Either side: true if nothing is queued, as of some recent moment.
+    bool empty() const noexcept
+    {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    /// Approximate fill level.
+    std::size_t size_approx() const noexcept
+    {
+        const std::uint64_t head = head_.load(std::memory_order_relaxed);
+        const std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+        return tail > head ? std::size_t(tail - head) : 0;
+    }
+
+private:
+    std::unique_ptr<T[]> slots_;
+    std::size_t mask_ = 0;
+    alignas(64) std::atomic<std::uint64_t> tail_{0};
+    std::uint64_t head_cache_ = 0; // producer's view of head_
+    alignas(64) std::atomic<std::uint64_t> head_{0};
+    std::uint64_t tail_cache_ = 0; // consumer's view of tail_
+};
+
+} // namespace yeni
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+
+namespace yeni {
+
+/// Lock-free token bucket, kept as a single "virtual time" word (the
+/// GCRA formulation): every token consumed pushes the bucket's clock
+/// 1/rate forward, and a caller is over budget by however far that clock
+/// runs ahead of now plus the burst allowance. One compare-and-swap per
+/// call; any number of threads may share one bucket.
+class token_bucket {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /// `rate` tokens per second, up to `burst` of them at once. A rate of
+    /// zero never limits.
+    explicit token_bucket(std::uint64_t rate, std::uint64_t burst = 0) noexcept { set_rate(rate, burst); }
+
+    token_bucket(const token_bucket&) = delete;
+    token_bucket& operator=(const token_bucket&) = delete;
+
+    void set_rate(std::uint64_t rate, std::uint64_t burst = 0) noexcept
+    {
+        ns_per_token_.store(rate ? 1e9 / double(rate) : 0.0, std::memory_order_relaxed);
+        burst_ns_.store(rate ? std::int64_t(1e9 * double(std::max(burst, std::uint64_t(1))) / double(rate)) : 0,
+            std::memory_order_relaxed);
+    }
+
+    /// Take `n` tokens unconditionally and return how long the caller
+    /// should hold off before its next use, zero while within the burst.
+    /// Going into debt rather than refusing lets callers charge work after
+    /// the fact, when its size is known.
+    std::chrono::nanoseconds consume(std::uint64_t n, clock::time_point now = clock::now()) noexcept
+    {
+        const double per = ns_per_token_.load(std::memory_order_relaxed);
+        if (per == 0.0)
+            return {};
+        const std::int64_t t = now.time_since_epoch().count();
+        const auto cost = std::int64_t(per * double(n));
+        const std::int64_t burst = burst_ns_.load(std::memory_order_relaxed);
+        std::int64_t tat = tat_.load(std::memory_order_relaxed);
+        std::int64_t next;
+        do
+            next = std::max(tat, t) + cost;
+        while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+        return std::chrono::nanoseconds(std::max<std::int64_t>(0, next - t - burst));
+    }
+
+    /// True if `n` tokens are available now; takes them only then.
+    bool try_consume(std::uint64_t n, clock::time_point now = clock::now()) noexcept
+    {
+        return try_acquire(n, now) == std::chrono::nanoseconds::zero();
+    }
+
+    /// try_consume() that says how long the caller would have to wait: zero
+    /// when the tokens were taken, else the time until they would be there,
+    /// for a retry-after hint. Nothing is taken then. More tokens than the
+    /// burst are never there at once; such a request is let through when
+    /// the bucket is full and goes into debt, as with consume().
+    std::chrono::nanoseconds try_acquire(std::uint64_t n, clock::time_point now = clock::now()) noexcept
+    {
+        const double per = ns_per_token_.load(std::memory_order_relaxed);
+        if (per == 0.0)
+            return {};
+        const std::int64_t t = now.time_since_epoch().count();
+        const auto cost = std::int64_t(per * double(n));
+        const std::int64_t burst = burst_ns_.load(std::memory_order_relaxed);
+        std::int64_t tat = tat_.load(std::memory_order_relaxed);
+        std::int64_t next;
+        do {
+            next = std::max(tat, t) + cost;
+            if (next - t > burst && tat > t)
+                return std::chrono::nanoseconds(std::min(next - t - burst, tat - t));
+        } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+        return {};
+    }
+
+private:
+    static_assert(std::is_same_v<clock::duration, std::chrono::nanoseconds>);
+
+    std::atomic<double> ns_per_token_{0.0};
+    std::atomic<std::int64_t> burst_ns_{0};
+    std::atomic<std::int64_t> tat_{0}; // theoretical arrival time, steady_clock ns
+};
+
+} // namespace yeni
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Set to 0 (CMake: -DYENI_TRACE=OFF) to compile every span down to
+// nothing; collect() then returns no events.
+#ifndef YENI_TRACE
+#define YENI_TRACE 1
+#endif
+
+namespace yeni::trace {
+
+inline constexpr bool enabled = YENI_TRACE != 0;
+
+/// What a span times. The first few are operations, which the others nest
+/// under; any kind may also stand alone. Append new entries before `count`.
+enum class span_kind : std::uint8_t {
+    lookup,      // lsm_version::find; arg: key
+    scan,        // one filter over a whole column; arg: rows
+    morsel,      // one executor morsel; arg: rows
+    queue_wait,  // handoff to dequeue, wherever a codel_monitor watches; arg: 0
+    index_probe, // one segment's key index; arg: LSM level
+    cache_miss,  // block_cache load; arg: bytes
+    io_wait,     // io_context submit to completion; arg: result
+    decode,      // a segment column decoded; arg: rows
+    count,
+};
+
+inline constexpr std::size_t span_kind_count = std::size_t(span_kind::count);
+
+std::string_view name(span_kind k) noexcept;
+
+/// Events each thread's ring keeps; older ones are overwritten.
+inline constexpr std::size_t ring_capacity = 4096;
+
+/// One finished span.
+struct event {
+    span_kind kind = span_kind::lookup;
+    /// Ring it was recorded into: one per thread alive at a time, reused
+    /// by a later thread once its thread exits.
+    unsigned thread = 0;
+    std::uint64_t start_ns = 0; // steady_clock
+    std::uint64_t duration_ns = 0;
+    /// Unique per process; parent is 0 for a root span, and trace is the
+    /// id of the root.
+    std::uint64_t id = 0;
+    std::uint64_t parent = 0;
+    std::uint64_t trace = 0;
+    std::uint64_t arg = 0; // low 56 bits
+};
+
+namespace detail {
+inline std::atomic<std::uint32_t> sample_every{0};
+void record_sampled(span_kind kind, std::chrono::steady_clock::time_point start, std::chrono::nanoseconds duration,
+    std::uint64_t arg) noexcept;
+} // namespace detail
+
+/// Trace one operation in `n` per thread, with every span under it; 0
+/// (the default) records nothing and costs a span one relaxed load.
+/// Takes effect for the next operation each thread starts, so it can be
+/// changed at any time, e.g. through metrics::http_server's /trace.
+inline void set_sample_every(std::uint32_t n) noexcept { detail::sample_every.store(n, std::memory_order_relaxed); }
+inline std::uint32_t sample_every() noexcept { return detail::sample_every.load(std::memory_order_relaxed); }
+
+#if YENI_TRACE
+
+/// Times its scope. The outermost span on a thread is the operation and
+/// decides whether it is sampled; spans opened inside it follow its
+/// decision and record it as their trace. Events go to a ring of the
+/// calling thread's that only it writes, so recording never locks.
+class span {
+public:
+    explicit span(span_kind kind, std::uint64_t arg = 0) noexcept : kind_(kind), arg_(arg)
+    {
+        if (detail::sample_every.load(std::memory_order_relaxed))
+            begin();
+    }
+    ~span()
+    {
+        if (entered_)
+            end();
+    }
+
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+
+    /// The span is being recorded.
+    bool sampled() const noexcept { return id_ != 0; }
+    /// Replace the argument, e.g. once a size is known.
+    void set_arg(std::uint64_t arg) noexcept { arg_ = arg; }
+
+private:
+    void begin() noexcept;
+    void end() noexcept;
+
+    span_kind kind_;
+    bool entered_ = false;
+    std::uint64_t arg_;
+    std::uint64_t id_ = 0, parent_ = 0, trace_ = 0, start_ = 0;
+};
+
+/// A span that ends elsewhere: begin() takes the sampling decision and the
+/// parent of the calling thread, end() records into the ring of whichever
+/// thread calls it, as when an I/O completes on another thread or a
+/// coroutine resumes on another worker. Neither may run concurrently with
+/// the other.
+class async_span {
+public:
+    void begin(span_kind kind) noexcept
+    {
+        if (detail::sample_every.load(std::memory_order_relaxed))
+            start(kind);
+    }
+    void end(std::uint64_t arg = 0) noexcept
+    {
+        if (id_)
+            finish(arg);
+    }
+
+private:
+    void start(span_kind kind) noexcept;
+    void finish(std::uint64_t arg) noexcept;
+
+    span_kind kind_ = span_kind::lookup;
+    std::uint64_t id_ = 0, parent_ = 0, trace_ = 0, start_ = 0;
+};
+
+/// A span measured after the fact, such as a queue wait learnt at
+/// dequeue: a child of the thread's open operation if that is sampled, or
+/// an operation of its own.
+inline void record(span_kind kind, std::chrono::steady_clock::time_point start, std::chrono::nanoseconds duration,
+    std::uint64_t arg = 0) noexcept
+{
+    if (detail::sample_every.load(std::memory_order_relaxed))
+        detail::record_sampled(kind, start, duration, arg);
+}
+
+#else
+
+class span {
+public:
+    explicit span(span_kind, std::uint64_t = 0) noexcept {}
+    bool sampled() const noexcept { return false; }
+    void set_arg(std::uint64_t) noexcept {}
+};
+
+class async_span {
+public:
+    void begin(span_kind) noexcept {}
+    void end(std::uint64_t = 0) noexcept {}
+};
+
+inline void record(span_kind, std::chrono::steady_clock::time_point, std::chrono::nanoseconds, std::uint64_t = 0) noexcept
+{
+}
+
+#endif
+
+/// Every event still in a ring, ring by ring and oldest first within one.
+/// Runs alongside recording threads; an event being overwritten while it
+/// is copied is left out.
+std::vector<event> collect();
+
+/// Chrome trace-event JSON (chrome://tracing, Perfetto): one complete
+/// ("X") event per span, threads as tids.
+std::string chrome_trace(const std::vector<event>& events);
+inline std::string chrome_trace() { return chrome_trace(collect()); }
+
+/// OTLP/JSON ExportTraceServiceRequest, as an OpenTelemetry collector's
+/// /v1/traces takes it. Trace ids get a random per-process prefix.
+std::string otlp_json(const std::vector<event>& events);
+inline std::string otlp_json() { return otlp_json(collect()); }
+
+/// Span stacks in the folded format of flamegraph.pl, weighted by self
+/// time in nanoseconds: a latency flamegraph of the sampled operations.
+/// Spans whose parent has been overwritten start their own stack.
+std::string folded_stacks(const std::vector<event>& events);
+
+/// Write the function symbols of the executable and every loaded library,
+/// relocated to where they are mapped, as a perf map ("start size name"
+/// per line, names demangled) to `path`, /tmp/perf-<pid>.map by default.
+/// perf reads it for addresses it cannot resolve itself, such as when the
+/// binary has been replaced on disk or lives in another mount namespace.
+/// Returns the number of symbols written; throws std::system_error if
+/// `path` cannot be written.
+std::size_t write_perf_map(const std::filesystem::path& path = {});
+
+} // namespace yeni::trace
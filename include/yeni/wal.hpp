@@ -0,0 +1,259 @@
+#pragma once
+
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace yeni {
+
+/// Write-ahead log directory: a sequence of fixed-size, preallocated
+/// segment files named wal-<16 hex digit sequence>.log.
+///
+///   header   64 bytes, magic "YENIWAL1", segment sequence, first LSN
+///   records  each on an 8-byte boundary:
+///              u32 crc     CRC-32C of the payload, then of bytes 4..16
+///              u32 size    payload bytes
+///              u64 lsn     log sequence number, +1 per record
+///              payload, zero padding to 8
+///
+/// Files are allocated at full size up front, so appending never changes
+/// their size and fdatasync only has to flush data blocks. The end of a
+/// segment is the first record whose CRC or LSN does not check out:
+/// preallocated space reads as zeros, a torn write as garbage.
+namespace wal_format {
+
+inline constexpr char magic[8] = {'Y', 'E', 'N', 'I', 'W', 'A', 'L', '1'};
+inline constexpr std::uint32_t version = 1;
+inline constexpr std::size_t alignment = 8;
+
+struct header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t sequence;
+    std::uint64_t first_lsn; // 0 while the file is a preallocated spare
+    std::uint8_t reserved[32];
+};
+static_assert(sizeof(header) == 64);
+
+struct record_header {
+    std::uint32_t crc;
+    std::uint32_t size;
+    std::uint64_t lsn;
+};
+static_assert(sizeof(record_header) == 16);
+
+inline constexpr std::size_t footprint(std::size_t payload) noexcept
+{
+    return sizeof(record_header) + ((payload + alignment - 1) & ~(alignment - 1));
+}
+
+} // namespace wal_format
+
+struct wal_options {
+    /// Size of each preallocated segment file; a record must fit in one.
+    std::size_t segment_size = std::size_t(64) << 20;
+    /// Most bytes one group commit writes. Appenders that would overflow
+    /// the open group wait for the next one.
+    std::size_t max_batch_bytes = std::size_t(1) << 20;
+    /// How long the committer may hold an open group to let it fill before
+    /// writing it. Zero writes as soon as the previous commit is done,
+    /// which still groups everything that arrived during it.
+    std::chrono::microseconds max_latency{0};
+    /// fdatasync every group. Off, a commit only reaches the page cache:
+    /// records survive a process crash but not a power loss.
+    bool sync = true;
+};
+
+/// Write-ahead log with group commit.
+///
+/// Appenders copy their record into the open group under a mutex and get
+/// its LSN; one committer thread takes the whole group, writes it with one
+/// pwrite and makes it durable with one fdatasync, then wakes every
+/// appender it covered. The cost of a sync is shared by all records that
+/// arrived while the previous one was running.
+///
+/// Opening a directory that already holds a log continues after its last
+/// valid record, in a fresh segment: the tail of the old one may hold a
+/// torn write, and appending behind it could make stale bytes look valid.
+class wal {
+public:
+    explicit wal(std::filesystem::path dir, wal_options options = {});
+    /// Commits everything appended so far, then stops the committer.
+    ~wal();
+
+    wal(const wal&) = delete;
+    wal& operator=(const wal&) = delete;
+
+    /// Append one record and wait until it is durable; returns its LSN.
+    std::uint64_t append(std::span<const std::byte> payload);
+
+    /// Append without waiting; pair with wait_durable() to overlap
+    /// appends with the commit that covers them.
+    std::uint64_t append_nowait(std::span<const std::byte> payload);
+
+    /// Append records already in the log format, e.g. a batch shipped
+    /// from another log, copying them as they are. Their LSNs must run on
+    /// from next_lsn(); check their CRCs first (decode_wal_records()).
+    /// Returns the last LSN; pair with wait_durable() like append_nowait().
+    std::uint64_t append_records(std::span<const std::byte> records, std::uint64_t first_lsn);
+
+    /// Block until every record up to `lsn` is durable. Rethrows the
+    /// committer's error if the log failed before getting there.
+    void wait_durable(std::uint64_t lsn);
+    /// wait_durable() for at most `timeout`; false if it expired first.
+    bool wait_durable_for(std::uint64_t lsn, std::chrono::nanoseconds timeout);
+
+    /// Highest LSN known durable (0 before the first commit).
+    std::uint64_t durable_lsn() const;
+    /// LSN the next append will get.
+    std::uint64_t next_lsn() const;
+
+    /// Delete segments holding only records below `lsn`, e.g. once a flush
+    /// has made them redundant. The open segment is never deleted.
+    void truncate_before(std::uint64_t lsn);
+
+    const std::filesystem::path& directory() const noexcept { return dir_; }
+
+private:
+    struct group {
+        std::vector<std::byte> bytes;
+        /// Offsets in `bytes` where the log moves to a new segment, with
+        /// the first LSN written there.
+        std::vector<std::pair<std::size_t, std::uint64_t>> rolls;
+        std::uint64_t last_lsn = 0;
+        bool full = false; // cannot take the next record; commit it now
+        std::chrono::steady_clock::time_point opened;
+    };
+
+    void recover();
+    void run() noexcept;
+    void commit(const group& g);
+    void write_out(const std::byte* p, std::size_t n);
+    void roll(std::uint64_t first_lsn);
+    void prepare_spare();
+    int create_segment(std::uint64_t sequence);
+
+    std::filesystem::path dir_;
+    wal_options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_; // committer: group ready, or stop
+    std::condition_variable room_cv_; // appenders: the full group was taken
+    group open_;
+    std::uint64_t next_lsn_ = 1;
+    std::size_t segment_used_ = 0; // bytes of the newest segment, counting the open group
+    bool committer_idle_ = false;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    // Waiters re-check these after every commit, without the mutex: the
+    // futex word counts commits (and the failure), so one wake reaches
+    // everyone a group covered.
+    std::atomic<std::uint64_t> durable_lsn_{0};
+    std::atomic<bool> failed_{false};
+    std::atomic<std::uint32_t> commits_{0};
+
+    // Committer thread only.
+    group committing_;
+    int fd_ = -1;
+    std::uint64_t sequence_ = 0;
+    std::uint64_t offset_ = 0;
+    int spare_fd_ = -1;
+
+    std::thread committer_;
+};
+
+/// One record read back from a log.
+struct wal_entry {
+    std::uint64_t lsn;
+    std::span<const std::byte> payload; // valid until the next call to next()
+};
+
+/// Split `records`, a run of records in the log format, into entries
+/// pointing into it, appending them to `out`. Throws format_error unless
+/// every CRC checks out and the LSNs run on from `first_lsn`.
+void decode_wal_records(std::span<const std::byte> records, std::uint64_t first_lsn, std::vector<wal_entry>& out);
+
+/// Sequential reader over a log directory, for replay after a restart.
+/// It stops at the end of each segment's valid records, so a torn tail
+/// write is skipped rather than reported.
+class wal_reader {
+public:
+    /// Read records with LSN >= `from_lsn`.
+    explicit wal_reader(const std::filesystem::path& dir, std::uint64_t from_lsn = 0);
+    ~wal_reader();
+
+    wal_reader(const wal_reader&) = delete;
+    wal_reader& operator=(const wal_reader&) = delete;
+
+    /// Next record, or false at the end of the log.
+    bool next(wal_entry& out);
+
+private:
+    bool open_next_segment();
+    void unmap() noexcept;
+
+    std::vector<std::filesystem::path> segments_;
+    std::size_t segment_index_ = 0;
+    std::uint64_t from_lsn_;
+    const std::byte* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::size_t offset_ = 0;
+    std::uint64_t expected_lsn_ = 0;
+};
+
+/// A run of durable records as it lies in a segment file.
+struct wal_range {
+    int fd;               // the segment, owned by the cursor
+    std::uint64_t offset; // of the first record in the file
+    std::size_t size;
+    std::uint64_t first_lsn;
+    std::uint64_t last_lsn;
+};
+
+/// Follows a live log, handing out the records each commit makes durable
+/// as byte ranges of the segment files, so that they can be shipped
+/// elsewhere with sendfile() without being read. truncate_before() must
+/// keep the segments a cursor has yet to reach.
+class wal_cursor {
+public:
+    /// Start at `from_lsn`, which must be at most durable_lsn() + 1.
+    /// Throws std::out_of_range if the log does not hold it (any more).
+    wal_cursor(wal& log, std::uint64_t from_lsn);
+    ~wal_cursor();
+
+    wal_cursor(const wal_cursor&) = delete;
+    wal_cursor& operator=(const wal_cursor&) = delete;
+
+    /// The next durable records, whole ones and at most `max_bytes` unless
+    /// the first alone is bigger, all from one segment. Waits up to
+    /// `timeout` for a commit; false if none came. `out` stays valid until
+    /// the next call.
+    bool next(wal_range& out, std::size_t max_bytes, std::chrono::nanoseconds timeout);
+
+    /// LSN of the first record next() has yet to hand out.
+    std::uint64_t next_lsn() const noexcept { return expected_lsn_; }
+
+private:
+    void open_segment(std::uint64_t sequence);
+    void close() noexcept;
+
+    wal& log_;
+    std::uint64_t sequence_ = 0;
+    int fd_ = -1;
+    const std::byte* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::size_t offset_ = 0;
+    std::uint64_t expected_lsn_ = 0;
+};
+
+} // namespace yeni
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace yeni {
+
+/// Chase-Lev work-stealing deque of pointers (Lê et al., "Correct and
+/// Efficient Work-Stealing for Weak Memory Models", PPoPP'13).
+///
+/// The owning thread pushes and pops at the bottom; any thread may steal
+/// from the top. The ring grows on demand; retired rings are kept until
+/// the deque dies because a concurrent thief may still be reading them.
+///
+/// The paper's standalone fences are expressed as seq_cst accesses on
+/// top/bottom instead: same cost on x86 (one locked instruction in pop)
+/// and visible to ThreadSanitizer, which does not model fences.
+template <class T>
+class work_stealing_deque {
+    static_assert(std::is_pointer_v<T>);
+
+public:
+    explicit work_stealing_deque(std::size_t capacity = 256)
+    {
+        std::size_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        rings_.push_back(std::make_unique<ring>(cap));
+        ring_.store(rings_.back().get(), std::memory_order_relaxed);
+    }
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    /// Owner only.
+    void push(T item)
+    {
+        std::int64_t b = bottom_.load(std::memory_order_relaxed);
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        ring* r = ring_.load(std::memory_order_relaxed);
+        if (b - t > std::int64_t(r->mask)) {
+            r = grow(r, t, b);
+        }
+        r->put(b, item);
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    /// Owner only. Returns nullptr when empty.
+    T pop()
+    {
+        std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        ring* r = ring_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_seq_cst);
+        std::int64_t t = top_.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T item = r->get(b);
+        if (t == b) {
+            // Last element: race the thieves for it.
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /// Any thread. Returns nullptr when empty or when it lost a race.
+    T steal()
+    {
+        std::int64_t t = top_.load(std::memory_order_seq_cst);
+        std::int64_t b = bottom_.load(std::memory_order_seq_cst);
+        if (t >= b)
+            return nullptr;
+        ring* r = ring_.load(std::memory_order_acquire);
+        T item = r->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return item;
+    }
+
+    /// Approximate; only meaningful as a hint.
+    bool empty() const noexcept
+    {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct ring {
+        explicit ring(std::size_t cap) : mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+        T get(std::int64_t i) const noexcept { return slots[std::size_t(i) & mask].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T v) noexcept { slots[std::size_t(i) & mask].store(v, std::memory_order_relaxed); }
+
+        std::size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    ring* grow(ring* old, std::int64_t t, std::int64_t b)
+    {
+        auto bigger = std::make_unique<ring>((old->mask + 1) * 2);
+        for (std::int64_t i = t; i < b; ++i)
+            bigger->put(i, old->get(i));
+        ring* r = bigger.get();
+        rings_.push_back(std::move(bigger));
+        ring_.store(r, std::memory_order_release);
+        return r;
+    }
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    alignas(64) std::atomic<ring*> ring_{nullptr};
+    std::vector<std::unique_ptr<ring>> rings_; // owner only
+};
+
+} // namespace yeni
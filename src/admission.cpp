@@ -0,0 +1,118 @@
+#include "yeni/admission.hpp"
+
+#include "yeni/hash.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/trace.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+namespace yeni {
+
+codel_monitor::codel_monitor(codel_options options, clock::time_point now) noexcept
+    : options_(options)
+    , window_end_((now + options.interval).time_since_epoch().count())
+{
+}
+
+void codel_monitor::observe(std::chrono::nanoseconds sojourn, clock::time_point now) noexcept
+{
+    const std::int64_t d = std::max<std::int64_t>(0, sojourn.count());
+    if constexpr (metrics::enabled)
+        metrics::local().record(metrics::histogram::queue_delay, std::uint64_t(d));
+    trace::record(trace::span_kind::queue_wait, now - std::chrono::nanoseconds(d), std::chrono::nanoseconds(d));
+
+    std::int64_t min = window_min_.load(std::memory_order_relaxed);
+    while (d < min && !window_min_.compare_exchange_weak(min, d, std::memory_order_relaxed)) {
+    }
+
+    // Whoever moves the window end on closes the window; an observation
+    // racing with the close lands in the next window instead.
+    const std::int64_t t = now.time_since_epoch().count();
+    std::int64_t end = window_end_.load(std::memory_order_relaxed);
+    if (t < end || !window_end_.compare_exchange_strong(end, t + options_.interval.count(), std::memory_order_relaxed))
+        return;
+    const std::int64_t standing = window_min_.exchange(no_delay, std::memory_order_relaxed);
+    if (standing == no_delay)
+        return;
+    standing_.store(standing, std::memory_order_relaxed);
+    const bool over = standing > options_.target.count();
+    if (over && !overloaded_.exchange(true, std::memory_order_relaxed))
+        metrics::local().add(metrics::counter::queue_delay_overloads);
+    else if (!over)
+        overloaded_.store(false, std::memory_order_relaxed);
+}
+
+bool codel_monitor::overloaded(clock::time_point now) const noexcept
+{
+    if (!overloaded_.load(std::memory_order_relaxed))
+        return false;
+    // A window left open past its end plus an interval saw no dequeues to
+    // judge by.
+    const std::int64_t end = window_end_.load(std::memory_order_relaxed);
+    return now.time_since_epoch().count() < end + options_.interval.count();
+}
+
+tenant_limiter::tenant_limiter(tenant_limits defaults) : defaults_(defaults) {}
+
+void tenant_limiter::set_limits(std::uint64_t tenant, tenant_limits limits)
+{
+    stripe& s = stripes_[mix64(tenant) >> (64 - stripe_bits)];
+    std::unique_lock lock(s.mutex);
+    auto [it, inserted] = s.buckets.try_emplace(tenant);
+    if (inserted)
+        it->second = std::make_unique<token_bucket>(limits.rate, limits.burst);
+    else
+        it->second->set_rate(limits.rate, limits.burst);
+}
+
+token_bucket& tenant_limiter::bucket(std::uint64_t tenant)
+{
+    stripe& s = stripes_[mix64(tenant) >> (64 - stripe_bits)];
+    {
+        std::shared_lock lock(s.mutex);
+        if (auto it = s.buckets.find(tenant); it != s.buckets.end())
+            return *it->second;
+    }
+    std::unique_lock lock(s.mutex);
+    auto [it, inserted] = s.buckets.try_emplace(tenant);
+    if (inserted)
+        it->second = std::make_unique<token_bucket>(defaults_.rate, defaults_.burst);
+    return *it->second;
+}
+
+std::chrono::nanoseconds tenant_limiter::try_acquire(std::uint64_t tenant, std::uint64_t cost, clock::time_point now)
+{
+    return bucket(tenant).try_acquire(cost, now);
+}
+
+std::size_t tenant_limiter::tenants() const
+{
+    std::size_t n = 0;
+    for (const stripe& s : stripes_) {
+        std::shared_lock lock(s.mutex);
+        n += s.buckets.size();
+    }
+    return n;
+}
+
+admission admission_controller::admit(std::uint64_t tenant, std::uint64_t cost, clock::time_point now)
+{
+    admission a;
+    for (const codel_monitor* m : monitors_)
+        if (m->overloaded(now))
+            a.retry_after = std::max(a.retry_after, std::max(m->standing_delay(), m->options().target));
+    if (a.retry_after.count()) {
+        a.verdict = admission_verdict::overloaded;
+        metrics::local().add(metrics::counter::admission_rejected_overload);
+        return a;
+    }
+    a.retry_after = tenants_.try_acquire(tenant, cost, now);
+    if (a.retry_after.count()) {
+        a.verdict = admission_verdict::rate_limited;
+        metrics::local().add(metrics::counter::admission_rejected_rate);
+    }
+    return a;
+}
+
+} // namespace yeni
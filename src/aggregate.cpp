@@ -0,0 +1,473 @@
+#include "yeni/aggregate.hpp"
+
+#include "yeni/admission.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/record_store.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace yeni {
+
+namespace {
+
+using column_type = segment_format::column_type;
+
+std::atomic<std::uint64_t> next_view_id{1};
+std::atomic<std::uint64_t> next_thread_id{1};
+
+// Per-thread map from view id to that thread's partial, as record_store
+// keeps its shards. Ids are never reused, so entries of destroyed views
+// are only ever evicted. An evicted partial stays with its view; the next
+// miss finds it by `thread`.
+struct partial_cache {
+    static constexpr std::size_t capacity = 8;
+
+    // Unlike std::thread::id, never reused by a later thread.
+    const std::uint64_t thread = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+
+    struct entry {
+        std::uint64_t id = 0;
+        void* partial = nullptr;
+    };
+
+    entry entries[capacity];
+    std::size_t next = 0; // slot the next insert overwrites
+
+    void* find(std::uint64_t id) const noexcept
+    {
+        for (const entry& e : entries)
+            if (e.id == id)
+                return e.partial;
+        return nullptr;
+    }
+
+    void insert(std::uint64_t id, void* partial) noexcept
+    {
+        entries[next] = {id, partial};
+        next = (next + 1) % capacity;
+    }
+};
+
+thread_local partial_cache tls_partials;
+
+bool numeric(column_type t) noexcept
+{
+    return t == column_type::u32 || t == column_type::u64 || t == column_type::i64 || t == column_type::f64;
+}
+
+// A field's value as cell bits: unsigned zero-extended, i64 as its two's
+// complement, doubles as their representation.
+std::uint64_t load(std::span<const std::byte> record, column_type type, std::uint32_t offset) noexcept
+{
+    if (type == column_type::u32) {
+        std::uint32_t v;
+        std::memcpy(&v, record.data() + offset, sizeof(v));
+        return v;
+    }
+    std::uint64_t v;
+    std::memcpy(&v, record.data() + offset, sizeof(v));
+    return v;
+}
+
+double as_double(std::uint64_t bits) noexcept
+{
+    return std::bit_cast<double>(bits);
+}
+
+std::int64_t as_signed(std::uint64_t bits) noexcept
+{
+    return std::bit_cast<std::int64_t>(bits);
+}
+
+} // namespace
+
+aggregate_view::aggregate_view(const schema& s, std::string_view group_by, std::vector<aggregate_spec> specs)
+    : id_(next_view_id.fetch_add(1, std::memory_order_relaxed))
+    , specs_(std::move(specs))
+{
+    const auto key = s.index_of(group_by);
+    if (!key)
+        throw std::invalid_argument("yeni: aggregate_view has no field " + std::string(group_by) + " to group by");
+    key_type_ = s.fields()[*key].type;
+    key_offset_ = s.offset(*key);
+    if (key_type_ == column_type::f64)
+        throw std::invalid_argument("yeni: aggregate_view cannot group by double field " + std::string(group_by));
+    if (specs_.empty())
+        throw std::invalid_argument("yeni: aggregate_view needs at least one aggregate");
+    if (key_type_ == column_type::binary)
+        strings_ = std::make_unique<string_interner>();
+
+    for (const aggregate_spec& spec : specs_) {
+        if (spec.op == aggregate_op::count) {
+            if (!spec.field.empty())
+                throw std::invalid_argument("yeni: aggregate_view count takes no field");
+            steps_.push_back({kind::count, column_type::none, 0});
+            initial_.push_back(0);
+            continue;
+        }
+        const auto i = s.index_of(spec.field);
+        if (!i || !numeric(s.fields()[*i].type))
+            throw std::invalid_argument("yeni: aggregate_view needs a numeric field, not " + spec.field);
+        const column_type type = s.fields()[*i].type;
+        const int t = type == column_type::f64 ? 2 : type == column_type::i64 ? 1 : 0;
+        constexpr kind sums[] = {kind::sum_u, kind::sum_i, kind::sum_d};
+        constexpr kind mins[] = {kind::min_u, kind::min_i, kind::min_d};
+        constexpr kind maxes[] = {kind::max_u, kind::max_i, kind::max_d};
+        step st{kind::count, type, s.offset(*i)};
+        std::uint64_t init = 0;
+        switch (spec.op) {
+        case aggregate_op::sum:
+            st.k = sums[t];
+            init = t == 2 ? std::bit_cast<std::uint64_t>(0.0) : 0;
+            break;
+        case aggregate_op::min:
+            st.k = mins[t];
+            init = t == 2 ? std::bit_cast<std::uint64_t>(std::numeric_limits<double>::infinity())
+                : t == 1  ? std::bit_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())
+                          : std::numeric_limits<std::uint64_t>::max();
+            break;
+        case aggregate_op::max:
+            st.k = maxes[t];
+            init = t == 2 ? std::bit_cast<std::uint64_t>(-std::numeric_limits<double>::infinity())
+                : t == 1  ? std::bit_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::min())
+                          : 0;
+            break;
+        case aggregate_op::count:
+            break;
+        }
+        steps_.push_back(st);
+        initial_.push_back(init);
+    }
+}
+
+aggregate_view::~aggregate_view() = default;
+
+aggregate_view::partial& aggregate_view::local_partial()
+{
+    if (void* p = tls_partials.find(id_))
+        return *static_cast<partial*>(p);
+    return register_partial();
+}
+
+aggregate_view::partial& aggregate_view::register_partial()
+{
+    auto& cache = tls_partials;
+    partial* raw = nullptr;
+    {
+        std::lock_guard lock(partials_mutex_);
+        for (const auto& p : partials_) {
+            if (p->owner == cache.thread) {
+                raw = p.get();
+                break;
+            }
+        }
+        if (!raw) {
+            partials_.push_back(std::make_unique<partial>(cache.thread));
+            raw = partials_.back().get();
+        }
+    }
+    cache.insert(id_, raw);
+    return *raw;
+}
+
+std::uint64_t aggregate_view::key_of(std::span<const std::byte> record)
+{
+    if (key_type_ != column_type::binary)
+        return load(record, key_type_, key_offset_);
+    const auto bytes = detail::read_binary_field(record, key_offset_);
+    return strings_->intern(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+// Counts are folded in as sums of ones, so a partial and a row combine
+// the same way.
+void aggregate_view::combine(kind k, std::uint64_t& c, std::uint64_t v) noexcept
+{
+    switch (k) {
+    case kind::count:
+    case kind::sum_u:
+    case kind::sum_i:
+        c += v;
+        break;
+    case kind::sum_d:
+        c = std::bit_cast<std::uint64_t>(as_double(c) + as_double(v));
+        break;
+    case kind::min_u:
+        c = std::min(c, v);
+        break;
+    case kind::min_i:
+        c = as_signed(v) < as_signed(c) ? v : c;
+        break;
+    case kind::min_d:
+        c = as_double(v) < as_double(c) ? v : c;
+        break;
+    case kind::max_u:
+        c = std::max(c, v);
+        break;
+    case kind::max_i:
+        c = as_signed(c) < as_signed(v) ? v : c;
+        break;
+    case kind::max_d:
+        c = as_double(c) < as_double(v) ? v : c;
+        break;
+    }
+}
+
+void aggregate_view::fold(partial& p, std::span<const std::byte> record)
+{
+    const std::uint64_t key = key_of(record);
+    auto [it, inserted] = p.groups.try_emplace(key, std::uint32_t(p.cells.size()));
+    if (inserted) {
+        p.keys.push_back(key);
+        p.cells.insert(p.cells.end(), initial_.begin(), initial_.end());
+    }
+    std::uint64_t* cell = p.cells.data() + it->second;
+    for (const step& st : steps_) {
+        const std::uint64_t v = st.k == kind::count ? 1 : load(record, st.type, st.offset);
+        combine(st.k, *cell++, v);
+    }
+}
+
+void aggregate_view::apply(std::span<const std::byte> record)
+{
+    partial& p = local_partial();
+    {
+        std::lock_guard lock(p.mutex);
+        fold(p, record);
+    }
+    metrics::local().add(metrics::counter::aggregate_rows);
+}
+
+void aggregate_view::apply(std::span<const record* const> records)
+{
+    if (records.empty())
+        return;
+    partial& p = local_partial();
+    {
+        std::lock_guard lock(p.mutex);
+        for (const record* r : records)
+            fold(p, r->value());
+    }
+    metrics::local().add(metrics::counter::aggregate_rows, records.size());
+}
+
+void aggregate_view::merge(std::span<std::uint64_t> into, std::span<const std::uint64_t> from) const noexcept
+{
+    for (std::size_t i = 0; i < steps_.size(); ++i)
+        combine(steps_[i].k, into[i], from[i]);
+}
+
+aggregate_group aggregate_view::to_group(std::uint64_t key, std::span<const std::uint64_t> cells) const
+{
+    aggregate_group g;
+    switch (key_type_) {
+    case column_type::u32:
+        g.key = std::uint32_t(key);
+        break;
+    case column_type::u64:
+        g.key = key;
+        break;
+    case column_type::i64:
+        g.key = as_signed(key);
+        break;
+    default: {
+        const std::string_view s = strings_->view(string_id(key));
+        g.key = std::as_bytes(std::span(s.data(), s.size()));
+        break;
+    }
+    }
+    g.values.reserve(steps_.size());
+    for (std::size_t i = 0; i < steps_.size(); ++i) {
+        switch (steps_[i].k) {
+        case kind::sum_i:
+        case kind::min_i:
+        case kind::max_i:
+            g.values.emplace_back(as_signed(cells[i]));
+            break;
+        case kind::sum_d:
+        case kind::min_d:
+        case kind::max_d:
+            g.values.emplace_back(as_double(cells[i]));
+            break;
+        default:
+            g.values.emplace_back(cells[i]);
+            break;
+        }
+    }
+    return g;
+}
+
+std::vector<aggregate_group> aggregate_view::read() const
+{
+    std::vector<const partial*> partials;
+    {
+        std::lock_guard lock(partials_mutex_);
+        for (const auto& p : partials_)
+            partials.push_back(p.get());
+    }
+    const std::size_t width = steps_.size();
+    flat_hash_map<std::uint64_t, std::uint32_t> index;
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint64_t> cells;
+    for (const partial* p : partials) {
+        std::lock_guard lock(p->mutex);
+        for (const std::uint64_t key : p->keys) {
+            auto [it, inserted] = index.try_emplace(key, std::uint32_t(cells.size()));
+            if (inserted) {
+                keys.push_back(key);
+                cells.insert(cells.end(), initial_.begin(), initial_.end());
+            }
+            const std::uint32_t from = p->groups.find(key)->second;
+            merge(std::span(cells).subspan(it->second, width), std::span(p->cells).subspan(from, width));
+        }
+    }
+
+    std::vector<aggregate_group> out;
+    out.reserve(keys.size());
+    for (const std::uint64_t key : keys)
+        out.push_back(to_group(key, std::span(cells).subspan(index.find(key)->second, width)));
+    std::sort(out.begin(), out.end(), [](const aggregate_group& a, const aggregate_group& b) {
+        return std::visit(
+            [&](const auto& x) {
+                using T = std::decay_t<decltype(x)>;
+                return detail::compare_field<T>(x, std::get<T>(b.key)) < 0;
+            },
+            a.key);
+    });
+    return out;
+}
+
+std::optional<std::vector<aggregate_value>> aggregate_view::read(const schema::value& key) const
+{
+    std::uint64_t k = 0;
+    switch (key_type_) {
+    case column_type::u32:
+        if (const auto* v = std::get_if<std::uint32_t>(&key))
+            k = *v;
+        else
+            return std::nullopt;
+        break;
+    case column_type::u64:
+        if (const auto* v = std::get_if<std::uint64_t>(&key))
+            k = *v;
+        else
+            return std::nullopt;
+        break;
+    case column_type::i64:
+        if (const auto* v = std::get_if<std::int64_t>(&key))
+            k = std::uint64_t(*v);
+        else
+            return std::nullopt;
+        break;
+    default: {
+        const auto* v = std::get_if<std::span<const std::byte>>(&key);
+        if (!v)
+            return std::nullopt;
+        const auto id = strings_->find(std::string_view(reinterpret_cast<const char*>(v->data()), v->size()));
+        if (!id)
+            return std::nullopt;
+        k = *id;
+        break;
+    }
+    }
+
+    std::vector<std::uint64_t> cells(initial_);
+    bool seen = false;
+    std::lock_guard lock(partials_mutex_);
+    for (const auto& p : partials_) {
+        std::lock_guard plock(p->mutex);
+        if (auto it = p->groups.find(k); it != p->groups.end()) {
+            merge(cells, std::span(p->cells).subspan(it->second, steps_.size()));
+            seen = true;
+        }
+    }
+    if (!seen)
+        return std::nullopt;
+    return std::move(to_group(k, cells).values);
+}
+
+void aggregate_view::clear()
+{
+    std::lock_guard lock(partials_mutex_);
+    for (const auto& p : partials_) {
+        std::lock_guard plock(p->mutex);
+        p->groups.clear();
+        p->keys.clear();
+        p->cells.clear();
+    }
+}
+
+std::size_t aggregate_view::partial_count() const
+{
+    std::lock_guard lock(partials_mutex_);
+    return partials_.size();
+}
+
+aggregate_view& aggregate_registry::add(std::string name, const schema& s, std::string_view group_by,
+    std::vector<aggregate_spec> specs)
+{
+    auto view = std::make_unique<aggregate_view>(s, group_by, std::move(specs));
+    std::unique_lock lock(mutex_);
+    for (const entry& e : views_)
+        if (e.name == name)
+            throw std::invalid_argument("yeni: aggregate view " + name + " already exists");
+    views_.push_back({std::move(name), std::move(view)});
+    return *views_.back().view;
+}
+
+aggregate_view* aggregate_registry::find(std::string_view name) const
+{
+    std::shared_lock lock(mutex_);
+    for (const entry& e : views_)
+        if (e.name == name)
+            return e.view.get();
+    return nullptr;
+}
+
+bool aggregate_registry::remove(std::string_view name)
+{
+    std::unique_ptr<aggregate_view> gone;
+    std::unique_lock lock(mutex_);
+    const auto it = std::find_if(views_.begin(), views_.end(), [&](const entry& e) { return e.name == name; });
+    if (it == views_.end())
+        return false;
+    gone = std::move(it->view);
+    views_.erase(it);
+    return true;
+}
+
+void aggregate_registry::apply(std::span<const record* const> records)
+{
+    std::shared_lock lock(mutex_);
+    for (const entry& e : views_)
+        e.view->apply(records);
+}
+
+std::size_t aggregate_registry::consume(ingest_queue& queue, std::chrono::nanoseconds timeout, codel_monitor* delay)
+{
+    constexpr std::size_t max_batches = 32;
+    using batch = handoff_batch<const record*>;
+    batch batches[max_batches];
+    const std::size_t got = queue.pop_batch(std::span<batch>(batches, max_batches), timeout);
+    if (delay && got) {
+        const auto now = codel_monitor::clock::now();
+        const std::uint32_t stamp = handoff_clock(now);
+        for (std::size_t b = 0; b < got; ++b)
+            delay->observe(batches[b].age(stamp), now);
+    }
+    const record* records[max_batches * batch::capacity];
+    std::size_t n = 0;
+    for (std::size_t b = 0; b < got; ++b)
+        for (const record* r : batches[b].view())
+            records[n++] = r;
+    apply(std::span<const record* const>(records, n));
+    return n;
+}
+
+} // namespace yeni
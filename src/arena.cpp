@@ -0,0 +1,91 @@
+#include "yeni/arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace yeni {
+
+arena::arena(std::size_t block_size, memory_provider& memory)
+    : block_size_(std::max(block_size, sizeof(block) + alignof(std::max_align_t)))
+    , memory_(&memory)
+{
+}
+
+arena::~arena()
+{
+    for (block* b = head_; b;) {
+        block* next = b->next;
+        free_block(b);
+        b = next;
+    }
+}
+
+arena::block* arena::new_block(std::size_t size)
+{
+    void* mem = memory_->allocate(sizeof(block) + size, alignof(block));
+    reserved_ += sizeof(block) + size;
+    return new (mem) block{nullptr, nullptr, size};
+}
+
+void arena::free_block(block* b) noexcept
+{
+    memory_->deallocate(b, sizeof(block) + b->size, alignof(block));
+}
+
+void* arena::allocate_slow(std::size_t size, std::size_t align)
+{
+    // Retire the current block; the walkers in for_each_block() rely on
+    // blocks being filled strictly in chain order.
+    if (current_)
+        current_->used = cur_;
+
+    const std::size_t need = size + align;
+    const std::size_t standard = block_size_ - sizeof(block);
+    block* next = current_ ? current_->next : head_;
+    if (!next || next->size < need) {
+        block* b = new_block(std::max(standard, need));
+        b->next = next;
+        if (current_)
+            current_->next = b;
+        else
+            head_ = b;
+        next = b;
+    }
+    current_ = next;
+    current_->used = nullptr;
+    cur_ = current_->data();
+    end_ = cur_ + current_->size;
+    return allocate(size, align);
+}
+
+void arena::reset() noexcept
+{
+    const std::size_t standard = block_size_ - sizeof(block);
+    block** link = &head_;
+    while (block* b = *link) {
+        if (b->size != standard) {
+            *link = b->next;
+            reserved_ -= sizeof(block) + b->size;
+            free_block(b);
+            continue;
+        }
+        b->used = nullptr;
+        link = &b->next;
+    }
+    current_ = head_;
+    if (current_) {
+        cur_ = current_->data();
+        end_ = cur_ + current_->size;
+    } else {
+        cur_ = end_ = nullptr;
+    }
+}
+
+std::size_t arena::bytes_used() const noexcept
+{
+    std::size_t total = 0;
+    for_each_block([&](const std::byte* begin, const std::byte* end) { total += std::size_t(end - begin); });
+    return total;
+}
+
+} // namespace yeni
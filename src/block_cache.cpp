@@ -0,0 +1,434 @@
+#include "yeni/block_cache.hpp"
+
+#include "yeni/futex.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace yeni {
+
+namespace detail {
+
+namespace {
+
+constexpr std::uint32_t dead = 0x80000000U; // refs bit: free, or being evicted
+
+enum : std::uint32_t { loading, ready, failed };
+
+constexpr std::uint8_t max_freq = 3;
+
+} // namespace
+
+// Lookups find entries without the shard mutex, so an entry's memory is
+// never freed while the cache lives; entries are recycled instead. refs
+// carries the pin count, or `dead` while the entry is free: a reader may
+// only use an entry it pinned with a CAS from a live count, and must then
+// check the key again, since the entry may have been recycled for another
+// block between finding and pinning it. Everything below refs is written
+// only while the entry is dead, or by its loader, and published by the
+// release store that revives it.
+struct cache_entry {
+    std::atomic<std::uint64_t> hash{0};
+    std::atomic<std::uint64_t> file{0};
+    std::atomic<std::uint64_t> offset{0};
+    std::atomic<std::uint32_t> refs{dead};
+    std::atomic<std::uint32_t> state{ready}; // futex word while loading
+    std::atomic<std::uint8_t> freq{0};
+
+    cache_shard* shard = nullptr;
+    memory_ptr data;
+    std::size_t size = 0;
+};
+
+/// Bounded FIFO of entry indices.
+class entry_fifo {
+public:
+    explicit entry_fifo(std::size_t n) : ring_(n) {}
+
+    bool empty() const noexcept { return size_ == 0; }
+    std::size_t size() const noexcept { return size_; }
+    void push(std::uint32_t i) noexcept
+    {
+        ring_[(head_ + size_) % ring_.size()] = i;
+        ++size_;
+    }
+    std::uint32_t pop() noexcept
+    {
+        const std::uint32_t i = ring_[head_];
+        head_ = (head_ + 1) % ring_.size();
+        --size_;
+        return i;
+    }
+
+private:
+    std::vector<std::uint32_t> ring_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+};
+
+// The slot table is open-addressed with linear probing and holds entry
+// index + 1, zero for empty. It has at least twice as many slots as there
+// are entries, so a probe always ends. Deletion shifts later slots back
+// instead of leaving tombstones; a concurrent reader may then miss a
+// moving entry, which only costs it a trip through the shard mutex.
+struct cache_shard {
+    cache_shard(std::size_t budget_bytes, std::size_t entry_count, double small_ratio)
+        : budget(budget_bytes)
+        , small_target(std::size_t(double(budget_bytes) * small_ratio))
+        , count(std::uint32_t(entry_count))
+        , entries(std::make_unique<cache_entry[]>(entry_count))
+        , slot_mask(std::bit_ceil(2 * entry_count) - 1)
+        , slots(std::make_unique<std::atomic<std::uint32_t>[]>(slot_mask + 1))
+        , ghost(std::bit_ceil(entry_count))
+        , small(entry_count)
+        , main(entry_count)
+    {
+        free.reserve(entry_count);
+        for (std::uint32_t i = count; i-- > 0;) {
+            entries[i].shard = this;
+            free.push_back(i);
+        }
+    }
+
+    const std::size_t budget;
+    const std::size_t small_target;
+    const std::uint32_t count;
+    const std::unique_ptr<cache_entry[]> entries;
+    const std::size_t slot_mask;
+    const std::unique_ptr<std::atomic<std::uint32_t>[]> slots;
+    std::atomic<std::size_t> used{0};
+
+    alignas(64) std::mutex mutex;
+    // Recently evicted hashes from `small`, direct-mapped, so the ghost
+    // queue of the paper forgets at random rather than in FIFO order.
+    std::vector<std::uint64_t> ghost;
+    entry_fifo small;
+    entry_fifo main;
+    std::size_t small_bytes = 0;
+    std::vector<std::uint32_t> free;
+};
+
+namespace {
+
+std::uint64_t hash_key(const cache_key& key) noexcept
+{
+    return mix64(key.file ^ mix64(key.offset));
+}
+
+bool try_pin(cache_entry& e) noexcept
+{
+    std::uint32_t r = e.refs.load(std::memory_order_relaxed);
+    do {
+        if (r & dead)
+            return false;
+    } while (!e.refs.compare_exchange_weak(r, r + 1, std::memory_order_acquire, std::memory_order_relaxed));
+    return true;
+}
+
+void unpin(cache_entry& e) noexcept
+{
+    e.refs.fetch_sub(1, std::memory_order_release);
+}
+
+// Pinned entry for `key`, or null. Lock-free; exact under the shard mutex.
+cache_entry* pin_existing(cache_shard& s, const cache_key& key, std::uint64_t h) noexcept
+{
+    for (std::size_t i = h & s.slot_mask;; i = (i + 1) & s.slot_mask) {
+        const std::uint32_t v = s.slots[i].load(std::memory_order_acquire);
+        if (v == 0)
+            return nullptr;
+        cache_entry& e = s.entries[v - 1];
+        if (e.hash.load(std::memory_order_relaxed) != h || !try_pin(e))
+            continue;
+        if (e.hash.load(std::memory_order_relaxed) == h && e.file.load(std::memory_order_relaxed) == key.file &&
+            e.offset.load(std::memory_order_relaxed) == key.offset)
+            return &e;
+        unpin(e);
+    }
+}
+
+// Waits out a load in progress; false if it failed.
+bool wait_loaded(cache_entry& e) noexcept
+{
+    std::uint32_t st;
+    while ((st = e.state.load(std::memory_order_acquire)) == loading)
+        futex_wait(e.state, loading);
+    return st == ready;
+}
+
+void touch(cache_entry& e) noexcept
+{
+    const std::uint8_t f = e.freq.load(std::memory_order_relaxed);
+    if (f < max_freq)
+        e.freq.store(std::uint8_t(f + 1), std::memory_order_relaxed);
+}
+
+void insert_slot(cache_shard& s, std::uint32_t index, std::uint64_t h) noexcept
+{
+    std::size_t i = h & s.slot_mask;
+    while (s.slots[i].load(std::memory_order_relaxed) != 0)
+        i = (i + 1) & s.slot_mask;
+    s.slots[i].store(index + 1, std::memory_order_release);
+}
+
+void erase_slot(cache_shard& s, std::uint32_t index) noexcept
+{
+    const std::uint64_t h = s.entries[index].hash.load(std::memory_order_relaxed);
+    std::size_t i = h & s.slot_mask;
+    for (;; i = (i + 1) & s.slot_mask) {
+        const std::uint32_t v = s.slots[i].load(std::memory_order_relaxed);
+        if (v == 0)
+            return; // an abandoned load, already unlinked
+        if (v == index + 1)
+            break;
+    }
+    // Backward-shift: pull up every later entry whose probe started at or
+    // before the hole.
+    for (std::size_t j = (i + 1) & s.slot_mask;; j = (j + 1) & s.slot_mask) {
+        const std::uint32_t v = s.slots[j].load(std::memory_order_relaxed);
+        if (v == 0)
+            break;
+        const std::size_t home = s.entries[v - 1].hash.load(std::memory_order_relaxed) & s.slot_mask;
+        if (((j - home) & s.slot_mask) >= ((j - i) & s.slot_mask)) {
+            s.slots[i].store(v, std::memory_order_release);
+            i = j;
+        }
+    }
+    s.slots[i].store(0, std::memory_order_release);
+}
+
+std::size_t ghost_slot(const cache_shard& s, std::uint64_t h) noexcept
+{
+    return std::size_t(h >> 40) & (s.ghost.size() - 1);
+}
+
+// Frees entry `i`, already popped from its queue, unless it is pinned.
+bool try_evict(cache_shard& s, std::uint32_t i) noexcept
+{
+    cache_entry& e = s.entries[i];
+    std::uint32_t zero = 0;
+    if (!e.refs.compare_exchange_strong(zero, dead, std::memory_order_acquire, std::memory_order_relaxed))
+        return false;
+    erase_slot(s, i);
+    e.data.reset();
+    s.used.store(s.used.load(std::memory_order_relaxed) - e.size, std::memory_order_relaxed);
+    s.free.push_back(i);
+    return true;
+}
+
+// One S3-FIFO eviction. False if everything left is pinned.
+bool evict_one(cache_shard& s) noexcept
+{
+    std::size_t budget = 4 * (s.small.size() + s.main.size()) + 4;
+    while (budget--) {
+        if (!s.small.empty() && (s.small_bytes > s.small_target || s.main.empty())) {
+            const std::uint32_t i = s.small.pop();
+            cache_entry& e = s.entries[i];
+            s.small_bytes -= e.size;
+            const bool dud = e.state.load(std::memory_order_relaxed) == failed;
+            if (!dud && e.freq.load(std::memory_order_relaxed) == 0 && try_evict(s, i)) {
+                s.ghost[ghost_slot(s, e.hash.load(std::memory_order_relaxed))] =
+                    e.hash.load(std::memory_order_relaxed) | 1;
+                metrics::local().add(metrics::counter::block_cache_evictions);
+                return true;
+            }
+            if (dud && try_evict(s, i))
+                return true;
+            // Read again, or pinned (so in use right now): promote.
+            e.freq.store(0, std::memory_order_relaxed);
+            s.main.push(i);
+        } else if (!s.main.empty()) {
+            const std::uint32_t i = s.main.pop();
+            cache_entry& e = s.entries[i];
+            const std::uint8_t f = e.freq.load(std::memory_order_relaxed);
+            const bool dud = e.state.load(std::memory_order_relaxed) == failed;
+            if ((f == 0 || dud) && try_evict(s, i)) {
+                if (!dud)
+                    metrics::local().add(metrics::counter::block_cache_evictions);
+                return true;
+            }
+            if (f > 0)
+                e.freq.store(std::uint8_t(f - 1), std::memory_order_relaxed);
+            s.main.push(i);
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+} // namespace detail
+
+using detail::cache_entry;
+using detail::cache_shard;
+
+void block_cache::handle::release() noexcept
+{
+    if (entry_)
+        detail::unpin(*entry_);
+    entry_ = nullptr;
+    owned_.reset();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+block_cache::block_cache(block_cache_options options) : options_(options)
+{
+    if (!options_.memory)
+        options_.memory = &memory_provider::standard();
+    if (options_.block_bytes == 0)
+        throw std::invalid_argument("yeni: block_cache block_bytes must be positive");
+    if (!(options_.small_ratio > 0.0 && options_.small_ratio < 1.0))
+        throw std::invalid_argument("yeni: block_cache small_ratio must be in (0, 1)");
+    unsigned shards = options_.shards;
+    if (shards == 0) {
+        shards = std::bit_ceil(4 * std::max(1U, std::thread::hardware_concurrency()));
+        while (shards > 1 && options_.capacity_bytes / shards < 64 * options_.block_bytes)
+            shards /= 2;
+    } else if (!std::has_single_bit(shards)) {
+        throw std::invalid_argument("yeni: block_cache shards must be a power of two");
+    }
+    const std::size_t budget = options_.capacity_bytes / shards;
+    const std::size_t entries = std::max<std::size_t>(16, 2 * (budget / options_.block_bytes));
+    shards_.reserve(shards);
+    for (unsigned i = 0; i < shards; ++i)
+        shards_.push_back(std::make_unique<cache_shard>(budget, entries, options_.small_ratio));
+    shard_mask_ = shards - 1;
+}
+
+block_cache::~block_cache() = default;
+
+cache_shard& block_cache::shard_of(std::uint64_t hash) const noexcept
+{
+    return *shards_[(hash >> 32) & shard_mask_];
+}
+
+block_cache::handle block_cache::hit(cache_entry* e) noexcept
+{
+    detail::touch(*e);
+    handle out;
+    out.entry_ = e;
+    out.data_ = e->data.get();
+    out.size_ = e->size;
+    return out;
+}
+
+block_cache::handle block_cache::lookup(const cache_key& key)
+{
+    auto& m = metrics::local();
+    const std::uint64_t h = detail::hash_key(key);
+    cache_shard& s = shard_of(h);
+    for (;;) {
+        cache_entry* e = detail::pin_existing(s, key, h);
+        if (!e) {
+            m.add(metrics::counter::block_cache_misses);
+            return {};
+        }
+        if (detail::wait_loaded(*e)) {
+            m.add(metrics::counter::block_cache_hits);
+            return hit(e);
+        }
+        detail::unpin(*e); // its loader is unlinking it
+    }
+}
+
+block_cache::handle block_cache::acquire(const cache_key& key, std::size_t size, bool& loader)
+{
+    auto& m = metrics::local();
+    const std::uint64_t h = detail::hash_key(key);
+    cache_shard& s = shard_of(h);
+    loader = false;
+    memory_ptr data;
+    for (;;) {
+        cache_entry* e = detail::pin_existing(s, key, h);
+        if (!e) {
+            if (!data)
+                data = allocate_bytes(*options_.memory, size);
+            std::unique_lock lock(s.mutex);
+            e = detail::pin_existing(s, key, h);
+            if (!e) {
+                m.add(metrics::counter::block_cache_misses);
+                loader = true;
+                handle out;
+                out.data_ = data.get();
+                out.size_ = size;
+                bool room = size <= s.budget;
+                while (room && (s.used.load(std::memory_order_relaxed) + size > s.budget || s.free.empty()))
+                    room = detail::evict_one(s);
+                if (!room) {
+                    out.owned_ = std::move(data);
+                    return out;
+                }
+                const std::uint32_t i = s.free.back();
+                s.free.pop_back();
+                cache_entry& n = s.entries[i];
+                n.hash.store(h, std::memory_order_relaxed);
+                n.file.store(key.file, std::memory_order_relaxed);
+                n.offset.store(key.offset, std::memory_order_relaxed);
+                n.state.store(detail::loading, std::memory_order_relaxed);
+                n.freq.store(0, std::memory_order_relaxed);
+                n.data = std::move(data);
+                n.size = size;
+                std::uint64_t& ghost = s.ghost[detail::ghost_slot(s, h)];
+                if (ghost == (h | 1)) {
+                    ghost = 0;
+                    s.main.push(i);
+                } else {
+                    s.small.push(i);
+                    s.small_bytes += size;
+                }
+                s.used.store(s.used.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+                n.refs.store(1, std::memory_order_release); // the loader's pin
+                detail::insert_slot(s, i, h);
+                out.entry_ = &n;
+                return out;
+            }
+        }
+        if (detail::wait_loaded(*e)) {
+            m.add(metrics::counter::block_cache_hits);
+            return hit(e);
+        }
+        detail::unpin(*e);
+    }
+}
+
+void block_cache::complete(handle& h) noexcept
+{
+    if (!h.entry_)
+        return;
+    h.entry_->state.store(detail::ready, std::memory_order_release);
+    futex_wake(h.entry_->state);
+}
+
+void block_cache::abandon(handle& h) noexcept
+{
+    if (cache_entry* e = h.entry_) {
+        cache_shard& s = *e->shard;
+        {
+            std::lock_guard lock(s.mutex);
+            detail::erase_slot(s, std::uint32_t(e - s.entries.get()));
+        }
+        // Left in its queue; eviction frees it without a ghost.
+        e->state.store(detail::failed, std::memory_order_release);
+        futex_wake(e->state);
+    }
+    h.release();
+}
+
+std::size_t block_cache::usage() const noexcept
+{
+    std::size_t n = 0;
+    for (const auto& s : shards_)
+        n += s->used.load(std::memory_order_relaxed);
+    return n;
+}
+
+} // namespace yeni
@@ -0,0 +1,143 @@
+#include "yeni/bloom_filter.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace yeni {
+
+namespace {
+
+constexpr char magic[8] = {'Y', 'E', 'N', 'I', 'B', 'L', 'M', '1'};
+
+struct header {
+    char magic[8];
+    std::uint64_t blocks;
+    std::uint8_t reserved[16];
+};
+static_assert(sizeof(header) == bloom_filter::header_bytes);
+
+// Odd multipliers, one per word, that spread the low hash half over each
+// word's 32 bits (the constants of the Parquet specification).
+constexpr std::uint32_t salt[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+    0x9efc4947U, 0x5c6bfb31U};
+
+// The high half of the hash picks the block, the low half the bits.
+std::uint64_t block_of(std::uint64_t h, std::uint64_t blocks) noexcept
+{
+    return ((h >> 32) * blocks) >> 32;
+}
+
+bool portable(const std::uint32_t* words, std::uint64_t blocks, std::uint64_t key) noexcept
+{
+    const std::uint64_t h = mix64(key);
+    const std::uint32_t* w = words + 8 * block_of(h, blocks);
+    const auto lo = std::uint32_t(h);
+    for (int i = 0; i < 8; ++i)
+        if (!(w[i] & (1U << ((lo * salt[i]) >> 27))))
+            return false;
+    return true;
+}
+
+#if defined(__x86_64__)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+bool avx2(const std::uint32_t* words, std::uint64_t blocks, std::uint64_t key) noexcept
+{
+    const std::uint64_t h = mix64(key);
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + 8 * block_of(h, blocks)));
+    const __m256i salts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(salt));
+    const __m256i bit = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(int(std::uint32_t(h))), salts), 27);
+    const __m256i mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), bit);
+    return _mm256_testc_si256(block, mask); // every mask bit set in block
+}
+
+#pragma GCC pop_options
+
+#endif
+
+using kernel = bool (*)(const std::uint32_t*, std::uint64_t, std::uint64_t) noexcept;
+
+kernel pick() noexcept
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return &avx2;
+#endif
+    return &portable;
+}
+
+kernel active() noexcept
+{
+    static const kernel k = pick();
+    return k;
+}
+
+} // namespace
+
+std::vector<std::byte> bloom_filter::build(std::span<const std::uint64_t> keys, double bits_per_key)
+{
+    const double bits = std::max(1.0, double(keys.size()) * bits_per_key);
+    const auto blocks = std::max<std::uint64_t>(1, std::uint64_t(std::ceil(bits / (8.0 * block_bytes))));
+    if (blocks > std::uint64_t(1) << 32)
+        throw std::length_error("yeni: bloom filter too large");
+
+    std::vector<std::byte> out(header_bytes + blocks * block_bytes);
+    header hdr{};
+    std::memcpy(hdr.magic, magic, sizeof(magic));
+    hdr.blocks = blocks;
+    std::memcpy(out.data(), &hdr, sizeof(hdr));
+
+    auto* words = reinterpret_cast<std::uint32_t*>(out.data() + header_bytes);
+    for (std::uint64_t key : keys) {
+        const std::uint64_t h = mix64(key);
+        std::uint32_t* w = words + 8 * block_of(h, blocks);
+        const auto lo = std::uint32_t(h);
+        for (int i = 0; i < 8; ++i)
+            w[i] |= 1U << ((lo * salt[i]) >> 27);
+    }
+    return out;
+}
+
+bloom_filter::bloom_filter(std::span<const std::byte> data)
+{
+    header hdr;
+    if (data.size() < sizeof(hdr))
+        throw format_error("yeni: bloom filter truncated");
+    std::memcpy(&hdr, data.data(), sizeof(hdr));
+    if (std::memcmp(hdr.magic, magic, sizeof(magic)) != 0)
+        throw format_error("yeni: bad bloom filter magic");
+    if (hdr.blocks == 0 || hdr.blocks > std::uint64_t(1) << 32 || data.size() != header_bytes + hdr.blocks * block_bytes)
+        throw format_error("yeni: bloom filter size mismatch");
+    if (reinterpret_cast<std::uintptr_t>(data.data()) % alignof(std::uint32_t) != 0)
+        throw format_error("yeni: misaligned bloom filter");
+    words_ = reinterpret_cast<const std::uint32_t*>(data.data() + header_bytes);
+    blocks_ = hdr.blocks;
+}
+
+bool bloom_filter::may_contain(std::uint64_t key) const noexcept
+{
+    return blocks_ == 0 || active()(words_, blocks_, key);
+}
+
+bool bloom_filter::may_contain_portable(std::uint64_t key) const noexcept
+{
+    return blocks_ == 0 || portable(words_, blocks_, key);
+}
+
+bool bloom_filter_simd() noexcept
+{
+    return active() != &portable;
+}
+
+} // namespace yeni
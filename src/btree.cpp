@@ -0,0 +1,1041 @@
+#include "yeni/btree.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/segment.hpp"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Optimistic readers race with writers by design and only trust what they
+// read once the node's version has been revalidated, so they are kept out
+// of ThreadSanitizer's view; they also copy and compare key bytes by hand
+// rather than through the (intercepted) libc routines.
+#define YENI_OPTIMISTIC __attribute__((no_sanitize("thread")))
+
+namespace yeni {
+
+namespace detail {
+
+struct btree_slot {
+    std::uint32_t head; // first four suffix bytes, big-endian, zero-padded
+    std::uint16_t offset;
+    std::uint16_t size; // suffix bytes; a u64 payload follows them
+};
+static_assert(sizeof(btree_slot) == 8);
+
+/// One node, leaf or inner, node_bytes long: this header, then the slot
+/// array, free space, and the heap growing down from the end of the node.
+/// The fences sit at the very end, lower above upper. Keys in the node lie
+/// in (lower, upper]; a missing fence is unbounded. Leaf payloads are the
+/// values; inner ones are the child for keys up to the slot's separator,
+/// with upper_child taking the rest.
+struct btree_node {
+    std::atomic<std::uint64_t> version; // bit 1 set while write-locked
+    std::uint64_t upper_child;
+    std::uint16_t count;
+    std::uint8_t leaf;
+    std::uint8_t fences; // has_lower | has_upper
+    std::uint16_t prefix; // bytes shared by both fences, stripped from every key
+    std::uint16_t heap;   // lowest heap byte in use
+    std::uint16_t dead;   // heap bytes no slot refers to any more
+    std::uint16_t lower_size;
+    std::uint16_t upper_size;
+    std::uint16_t reserved;
+};
+static_assert(sizeof(btree_node) == 32);
+
+} // namespace detail
+
+namespace {
+
+using detail::btree_batch;
+using detail::btree_node;
+using detail::btree_slot;
+using bytes = std::span<const std::byte>;
+using fence = std::optional<bytes>;
+
+constexpr std::size_t node_bytes = btree_index::node_bytes;
+constexpr std::size_t header_bytes = sizeof(btree_node);
+constexpr std::size_t payload_bytes = sizeof(std::uint64_t);
+constexpr std::size_t max_slots = (node_bytes - header_bytes) / sizeof(btree_slot);
+constexpr std::uint8_t has_lower = 1;
+constexpr std::uint8_t has_upper = 2;
+// What one more separator can take in an inner node.
+constexpr std::size_t max_entry_bytes = sizeof(btree_slot) + btree_index::max_key_size + payload_bytes;
+constexpr std::uint64_t locked_bit = 2;
+
+static_assert(node_bytes <= 65535 + 1, "heap offsets are 16-bit");
+
+constexpr char file_magic[8] = {'Y', 'E', 'N', 'I', 'B', 'T', 'R', '1'};
+constexpr std::uint32_t file_version = 1;
+
+struct file_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t node_size;
+    std::uint64_t nodes;
+    std::uint64_t root;
+    std::uint64_t entries;
+    std::uint32_t height;
+    std::uint32_t reserved0;
+    std::uint8_t reserved[16];
+};
+static_assert(sizeof(file_header) == 64);
+
+std::size_t entry_bytes(std::size_t suffix) noexcept
+{
+    return sizeof(btree_slot) + suffix + payload_bytes;
+}
+
+std::byte* raw(btree_node* n) noexcept
+{
+    return reinterpret_cast<std::byte*>(n);
+}
+
+const std::byte* raw(const btree_node* n) noexcept
+{
+    return reinterpret_cast<const std::byte*>(n);
+}
+
+btree_slot* slots(btree_node* n) noexcept
+{
+    return reinterpret_cast<btree_slot*>(raw(n) + header_bytes);
+}
+
+const btree_slot* slots(const btree_node* n) noexcept
+{
+    return reinterpret_cast<const btree_slot*>(raw(n) + header_bytes);
+}
+
+YENI_OPTIMISTIC void copy_bytes(std::byte* dst, const std::byte* src, std::size_t n) noexcept
+{
+    for (; n >= 8; n -= 8, dst += 8, src += 8) {
+        std::uint64_t w;
+        __builtin_memcpy(&w, src, 8);
+        __builtin_memcpy(dst, &w, 8);
+    }
+    for (; n; --n)
+        *dst++ = *src++;
+}
+
+YENI_OPTIMISTIC std::uint64_t load64(const std::byte* p) noexcept
+{
+    std::uint64_t v;
+    __builtin_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/// copy_bytes() rounded up to whole words: `n` bytes and up to seven more
+/// of whatever follows them.
+YENI_OPTIMISTIC void copy_words(std::byte* dst, const std::byte* src, std::size_t n) noexcept
+{
+    for (std::size_t i = 0; i < n; i += 8) {
+        const std::uint64_t w = load64(src + i);
+        __builtin_memcpy(dst + i, &w, 8);
+    }
+}
+
+/// memcmp order of `a` and `b`, a shorter prefix first.
+YENI_OPTIMISTIC int compare(bytes a, bytes b) noexcept
+{
+    const std::size_t n = std::min(a.size(), b.size());
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const std::uint64_t x = load64(a.data() + i), y = load64(b.data() + i);
+        if (x != y) {
+            const std::uint64_t bx = __builtin_bswap64(x), by = __builtin_bswap64(y);
+            return bx < by ? -1 : 1;
+        }
+    }
+    for (; i < n; ++i)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+}
+
+std::size_t common_prefix(bytes a, bytes b) noexcept
+{
+    const std::size_t n = std::min(a.size(), b.size());
+    std::size_t i = 0;
+    while (i < n && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+YENI_OPTIMISTIC std::uint32_t head_of(bytes suffix) noexcept
+{
+    std::uint32_t h = 0;
+    for (std::size_t i = 0; i < 4; ++i)
+        h = h << 8 | (i < suffix.size() ? std::uint32_t(suffix[i]) : 0);
+    return h;
+}
+
+/// Bounds-checked reads of a node that may be changing underneath (a
+/// writer holds it) or be corrupt (a mapped one). Once anything is out of
+/// range `ok` drops and the results are harmless placeholders; the caller
+/// then restarts or reports corruption.
+struct reader {
+    const btree_node* n;
+    bool ok = true;
+
+    YENI_OPTIMISTIC bool leaf() const noexcept { return n->leaf != 0; }
+
+    YENI_OPTIMISTIC std::size_t count() noexcept
+    {
+        const std::size_t c = n->count;
+        if (c > max_slots) [[unlikely]] {
+            ok = false;
+            return 0;
+        }
+        return c;
+    }
+
+    YENI_OPTIMISTIC fence lower() noexcept
+    {
+        if (!(n->fences & has_lower))
+            return std::nullopt;
+        const std::size_t size = n->lower_size;
+        if (size > btree_index::max_key_size) [[unlikely]] {
+            ok = false;
+            return bytes{};
+        }
+        return bytes(raw(n) + node_bytes - size, size);
+    }
+
+    YENI_OPTIMISTIC fence upper() noexcept
+    {
+        if (!(n->fences & has_upper))
+            return std::nullopt;
+        const std::size_t size = n->upper_size, below = n->lower_size;
+        if (size > btree_index::max_key_size || below > btree_index::max_key_size) [[unlikely]] {
+            ok = false;
+            return bytes{};
+        }
+        return bytes(raw(n) + node_bytes - below - size, size);
+    }
+
+    YENI_OPTIMISTIC bytes prefix() noexcept
+    {
+        const std::size_t p = n->prefix;
+        if (p == 0)
+            return {};
+        const fence low = lower();
+        if (!low || p > low->size() || p > btree_index::max_key_size) [[unlikely]] {
+            ok = false;
+            return {};
+        }
+        return low->first(p);
+    }
+
+    YENI_OPTIMISTIC btree_slot slot(std::size_t i) noexcept
+    {
+        btree_slot s = slots(n)[i];
+        if (s.offset < header_bytes || std::size_t(s.offset) + s.size + payload_bytes > node_bytes) [[unlikely]] {
+            ok = false;
+            s = {0, std::uint16_t(node_bytes - payload_bytes), 0};
+        }
+        return s;
+    }
+
+    YENI_OPTIMISTIC bytes suffix(const btree_slot& s) const noexcept { return {raw(n) + s.offset, s.size}; }
+    YENI_OPTIMISTIC std::uint64_t payload(const btree_slot& s) const noexcept
+    {
+        return load64(raw(n) + s.offset + s.size);
+    }
+
+    YENI_OPTIMISTIC std::uint64_t payload(std::size_t i) noexcept { return payload(slot(i)); }
+
+    /// First slot whose key is >= `key` (> with `after`), or count();
+    /// `found` says whether it equals `key`.
+    YENI_OPTIMISTIC std::size_t lower_bound(bytes key, bool after, bool& found) noexcept
+    {
+        found = false;
+        const std::size_t p = std::min<std::size_t>(prefix().size(), key.size());
+        const bytes k = key.subspan(p);
+        const std::uint32_t h = head_of(k);
+        std::size_t lo = 0, hi = count();
+        while (lo < hi) {
+            const std::size_t mid = (lo + hi) / 2;
+            const btree_slot s = slot(mid);
+            int c = s.head < h ? -1 : s.head > h ? 1 : compare(suffix(s), k);
+            if (c == 0) {
+                if (!after) {
+                    found = true;
+                    return mid;
+                }
+                c = -1;
+            }
+            if (c < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    /// Child an inner node routes `key` to.
+    YENI_OPTIMISTIC std::uint64_t child(bytes key, bool after) noexcept
+    {
+        bool found;
+        const std::size_t i = lower_bound(key, after, found);
+        return i < count() ? payload(i) : n->upper_child;
+    }
+
+    /// Slot `i`'s whole key written to `out`, which holds max_key_size.
+    YENI_OPTIMISTIC bytes key(std::size_t i, std::byte* out) noexcept
+    {
+        const bytes p = prefix();
+        const btree_slot s = slot(i);
+        if (p.size() + s.size > btree_index::max_key_size) [[unlikely]] {
+            ok = false;
+            return {};
+        }
+        copy_bytes(out, p.data(), p.size());
+        copy_bytes(out + p.size(), raw(n) + s.offset, s.size);
+        return {out, p.size() + s.size};
+    }
+};
+
+// Node construction and modification; the node is private to the caller
+// or write-locked by it.
+
+YENI_OPTIMISTIC std::size_t free_bytes(const btree_node* n) noexcept
+{
+    return n->heap - header_bytes - n->count * sizeof(btree_slot);
+}
+
+void init(btree_node* n, bool leaf, fence lower, fence upper) noexcept
+{
+    n->upper_child = 0;
+    n->count = 0;
+    n->leaf = leaf;
+    n->fences = 0;
+    n->heap = std::uint16_t(node_bytes);
+    n->dead = 0;
+    n->lower_size = n->upper_size = 0;
+    n->reserved = 0;
+    if (lower) {
+        n->heap = std::uint16_t(n->heap - lower->size());
+        std::copy(lower->begin(), lower->end(), raw(n) + n->heap);
+        n->lower_size = std::uint16_t(lower->size());
+        n->fences |= has_lower;
+    }
+    if (upper) {
+        n->heap = std::uint16_t(n->heap - upper->size());
+        std::copy(upper->begin(), upper->end(), raw(n) + n->heap);
+        n->upper_size = std::uint16_t(upper->size());
+        n->fences |= has_upper;
+    }
+    n->prefix = std::uint16_t(lower && upper ? common_prefix(*lower, *upper) : 0);
+}
+
+/// Put `key` at slot `i`; the caller has made room.
+void insert_at(btree_node* n, std::size_t i, bytes key, std::uint64_t payload) noexcept
+{
+    const bytes suffix = key.subspan(n->prefix);
+    n->heap = std::uint16_t(n->heap - suffix.size() - payload_bytes);
+    std::byte* p = raw(n) + n->heap;
+    std::copy(suffix.begin(), suffix.end(), p);
+    std::memcpy(p + suffix.size(), &payload, sizeof(payload));
+    btree_slot* s = slots(n);
+    std::memmove(s + i + 1, s + i, (n->count - i) * sizeof(btree_slot));
+    s[i] = {head_of(suffix), n->heap, std::uint16_t(suffix.size())};
+    ++n->count;
+}
+
+void remove_at(btree_node* n, std::size_t i) noexcept
+{
+    btree_slot* s = slots(n);
+    n->dead = std::uint16_t(n->dead + s[i].size + payload_bytes);
+    std::memmove(s + i, s + i + 1, (n->count - i - 1) * sizeof(btree_slot));
+    --n->count;
+}
+
+/// `dst` = entries [begin, end) of `src` between the given fences.
+void rebuild(btree_node* dst, const btree_node* src, std::size_t begin, std::size_t end, fence lower, fence upper,
+    std::uint64_t upper_child) noexcept
+{
+    init(dst, src->leaf, lower, upper);
+    dst->upper_child = upper_child;
+    reader r{src};
+    std::byte key[btree_index::max_key_size];
+    for (std::size_t i = begin; i < end; ++i)
+        insert_at(dst, i - begin, r.key(i, key), r.payload(i));
+}
+
+/// Overwrite everything in `n` but its version with `from`.
+void replace(btree_node* n, const btree_node* from) noexcept
+{
+    std::memcpy(raw(n) + sizeof(n->version), raw(from) + sizeof(n->version), node_bytes - sizeof(n->version));
+}
+
+struct scratch_node {
+    alignas(64) std::byte bytes[node_bytes];
+    btree_node* get() noexcept { return reinterpret_cast<btree_node*>(bytes); }
+};
+
+/// Make room for an entry of `need` bytes by squeezing out dead heap
+/// space; false if it would still not fit.
+bool make_room(btree_node* n, std::size_t need) noexcept
+{
+    if (free_bytes(n) >= need)
+        return true;
+    if (free_bytes(n) + n->dead < need)
+        return false;
+    scratch_node tmp;
+    reader r{n};
+    rebuild(tmp.get(), n, 0, n->count, r.lower(), r.upper(), n->upper_child);
+    replace(n, tmp.get());
+    return true;
+}
+
+/// Shortest key k with a <= k < b, for a < b.
+bytes separator(bytes a, bytes b) noexcept
+{
+    const std::size_t p = common_prefix(a, b);
+    return p + 1 < b.size() ? b.first(p + 1) : a;
+}
+
+// Optimistic lock coupling on btree_node::version. These stay visible to
+// ThreadSanitizer: they are the synchronisation it has to see.
+
+std::uint64_t read_lock(const btree_node* n) noexcept
+{
+    for (;;) {
+        const std::uint64_t v = n->version.load(std::memory_order_acquire);
+        if (!(v & locked_bit))
+            return v;
+#if defined(__x86_64__)
+        _mm_pause();
+#endif
+    }
+}
+
+bool validate(const btree_node* n, std::uint64_t v) noexcept
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return n->version.load(std::memory_order_relaxed) == v;
+}
+
+bool upgrade(btree_node* n, std::uint64_t v) noexcept
+{
+    return n->version.compare_exchange_strong(v, v + locked_bit, std::memory_order_acquire);
+}
+
+void unlock(btree_node* n) noexcept
+{
+    n->version.fetch_add(locked_bit, std::memory_order_release);
+}
+
+} // namespace
+
+namespace detail {
+
+/// Node access for the read paths shared by btree_index and btree_view.
+struct btree_memory_source {
+    const std::atomic<btree_node*>& root_ptr;
+
+    const btree_node* root() const noexcept { return root_ptr.load(std::memory_order_acquire); }
+    /// A root split publishes the new root before unlocking the old one,
+    /// so a reader that locked a stale root notices here.
+    bool is_root(const btree_node* n) const noexcept { return root_ptr.load(std::memory_order_acquire) == n; }
+    const btree_node* child(std::uint64_t ref, std::size_t) const noexcept
+    {
+        return reinterpret_cast<const btree_node*>(ref);
+    }
+    std::uint64_t lock(const btree_node* n) const noexcept { return read_lock(n); }
+    /// Whether what was read from `n` under `v` holds; false restarts.
+    bool check(const reader& r, std::uint64_t v) const noexcept { return validate(r.n, v) && r.ok; }
+};
+
+struct btree_view_source {
+    const btree_view& view;
+
+    const btree_node* node(std::uint64_t ref) const
+    {
+        if (ref >= view.nodes_)
+            throw format_error("yeni: btree node number out of range");
+        return reinterpret_cast<const btree_node*>(view.base_ + sizeof(file_header) + ref * node_bytes);
+    }
+    const btree_node* root() const { return checked(node(view.root_), 0); }
+    bool is_root(const btree_node*) const noexcept { return true; }
+    const btree_node* child(std::uint64_t ref, std::size_t depth) const { return checked(node(ref), depth); }
+    const btree_node* checked(const btree_node* n, std::size_t depth) const
+    {
+        if (depth >= view.height_ || (n->leaf != 0) != (depth + 1 == view.height_))
+            throw format_error("yeni: btree node at the wrong level");
+        return n;
+    }
+    std::uint64_t lock(const btree_node*) const noexcept { return 0; }
+    bool check(const reader& r, std::uint64_t) const
+    {
+        if (!r.ok)
+            throw format_error("yeni: btree node out of bounds");
+        return true;
+    }
+};
+
+} // namespace detail
+
+namespace {
+
+/// Leaf `key` belongs in (with `after`, the first one that can hold keys
+/// above it), its version in `v`; nullptr to restart.
+template <class Source>
+YENI_OPTIMISTIC const btree_node* descend(const Source& src, bytes key, bool after, std::uint64_t& v)
+{
+    const btree_node* n = src.root();
+    v = src.lock(n);
+    if (!src.is_root(n))
+        return nullptr;
+    for (std::size_t depth = 1; !reader{n}.leaf(); ++depth) {
+        reader r{n};
+        const std::uint64_t ref = r.child(key, after);
+        if (!src.check(r, v))
+            return nullptr;
+        const btree_node* child = src.child(ref, depth);
+        const std::uint64_t child_v = src.lock(child);
+        // The child may have split since `ref` was read; its parent then
+        // has moved on too.
+        if (!src.check(r, v))
+            return nullptr;
+        n = child;
+        v = child_v;
+    }
+    return n;
+}
+
+template <class Source>
+YENI_OPTIMISTIC std::optional<std::uint64_t> find_in(const Source& src, bytes key)
+{
+    for (;;) {
+        std::uint64_t v;
+        const btree_node* n = descend(src, key, false, v);
+        if (!n)
+            continue;
+        reader r{n};
+        bool found;
+        const std::size_t i = r.lower_bound(key, false, found);
+        const std::uint64_t value = found ? r.payload(i) : 0;
+        if (!src.check(r, v))
+            continue;
+        if (found)
+            return value;
+        return std::nullopt;
+    }
+}
+
+template <class Source>
+YENI_OPTIMISTIC bool next_batch_in(const Source& src, bytes from, bool inclusive, bytes hi, btree_batch& batch)
+{
+    for (;;) {
+        batch.clear();
+        std::uint64_t v;
+        const btree_node* n = descend(src, from, !inclusive, v);
+        if (!n)
+            continue;
+        reader r{n};
+        bool found;
+        std::size_t i = r.lower_bound(from, !inclusive, found);
+        const std::size_t count = r.count();
+        const fence upper = r.upper();
+        // Nothing in the leaf can be past `hi` if its upper fence is not.
+        const bool bounded = upper && compare(*upper, hi) <= 0;
+
+        // Keys are copied eight bytes at a time, which may run up to seven
+        // bytes past the end of a suffix into its payload, and of the
+        // prefix into the padding of `prefix`.
+        const bytes p = r.prefix();
+        std::byte prefix[btree_index::max_key_size + 8];
+        copy_bytes(prefix, p.data(), p.size());
+        const std::size_t room = (count - std::min(i, count)) * (p.size() + 8) + node_bytes + 8;
+        if (batch.keys.size() < room)
+            batch.keys.resize(room);
+        std::byte* out = batch.keys.data();
+        std::size_t at = 0;
+        bool past = false;
+        for (; i < count; ++i) {
+            const btree_slot s = r.slot(i);
+            if (p.size() + s.size > btree_index::max_key_size) [[unlikely]]
+                r.ok = false;
+            if (!r.ok)
+                break;
+            std::byte* k = out + at;
+            copy_words(k, prefix, p.size());
+            copy_words(k + p.size(), r.suffix(s).data(), s.size);
+            const std::size_t size = p.size() + s.size;
+            if (!bounded && compare(bytes(k, size), hi) > 0) {
+                past = true;
+                break;
+            }
+            at += size;
+            batch.ends.push_back(at);
+            batch.values.push_back(r.payload(s));
+        }
+        // A fence behind `from` would send the scan round in circles: a
+        // torn read, or a corrupt view.
+        if (upper && compare(*upper, from) < (inclusive ? 0 : 1))
+            r.ok = false;
+        if (upper && !past) {
+            batch.next.resize(upper->size());
+            copy_bytes(batch.next.data(), upper->data(), upper->size());
+        }
+        if (!src.check(r, v))
+            continue;
+        // Past `hi` already once the fence is.
+        return upper && !past && compare(batch.next, hi) < 0;
+    }
+}
+
+struct child_ref {
+    std::vector<std::byte> lower, upper;
+    bool has_lower = false, has_upper = false;
+    std::uint64_t ref = 0;
+};
+
+fence fence_of(const std::vector<std::byte>& key, bool present) noexcept
+{
+    return present ? fence(bytes(key)) : std::nullopt;
+}
+
+/// Pack sorted `entries` into nodes bottom-up, each filled to `budget`
+/// bytes. `alloc()` returns a zeroed node and the reference its parent
+/// stores for it. Returns the root's reference and the tree's height.
+template <class Alloc>
+std::pair<std::uint64_t, std::size_t> bulk_build(const btree_batch& entries, std::size_t budget, Alloc&& alloc)
+{
+    std::vector<child_ref> level;
+    const std::size_t n = entries.size();
+    std::vector<std::byte> lower;
+    bool has_lower = false;
+    std::size_t s = 0;
+    do {
+        // Grow [s, e) while its node fits the budget.
+        std::size_t e = s, keys = 0;
+        bytes upper_e;
+        while (e < n) {
+            const std::size_t next = e + 1;
+            const bool last = next == n;
+            const bytes upper = last ? bytes{} : separator(entries.key(e), entries.key(next));
+            const std::size_t p = has_lower && !last ? common_prefix(lower, upper) : 0;
+            const std::size_t k = keys + entries.key(e).size();
+            const std::size_t need = header_bytes + lower.size() + upper.size()
+                + (next - s) * (sizeof(btree_slot) + payload_bytes) + k - (next - s) * p;
+            if (e > s && need > budget)
+                break;
+            keys = k;
+            upper_e = upper;
+            e = next;
+        }
+        auto [node, ref] = alloc();
+        const bool has_upper = e < n;
+        init(node, true, has_lower ? fence(bytes(lower)) : std::nullopt, has_upper ? fence(upper_e) : std::nullopt);
+        for (std::size_t i = s; i < e; ++i)
+            insert_at(node, i - s, entries.key(i), entries.values[i]);
+        child_ref c;
+        c.lower = lower;
+        c.has_lower = has_lower;
+        c.upper.assign(upper_e.begin(), upper_e.end());
+        c.has_upper = has_upper;
+        c.ref = ref;
+        level.push_back(std::move(c));
+        lower.assign(upper_e.begin(), upper_e.end());
+        has_lower = true;
+        s = e;
+    } while (s < n);
+
+    std::size_t height = 1;
+    while (level.size() > 1) {
+        std::vector<child_ref> up;
+        for (std::size_t s = 0; s < level.size();) {
+            // Children [s, e): e-s-1 separators (their upper fences) and the
+            // last child as upper_child.
+            std::size_t e = s + 1, keys = 0;
+            while (e < level.size()) {
+                const child_ref& first = level[s];
+                const child_ref& last = level[e];
+                const std::size_t p
+                    = first.has_lower && last.has_upper ? common_prefix(first.lower, last.upper) : 0;
+                const std::size_t k = keys + level[e - 1].upper.size();
+                const std::size_t need = header_bytes + first.lower.size() + last.upper.size()
+                    + (e - s) * (sizeof(btree_slot) + payload_bytes) + k - (e - s) * p;
+                if (need > budget)
+                    break;
+                keys = k;
+                ++e;
+            }
+            auto [node, ref] = alloc();
+            const child_ref& first = level[s];
+            const child_ref& last = level[e - 1];
+            init(node, false, fence_of(first.lower, first.has_lower), fence_of(last.upper, last.has_upper));
+            for (std::size_t i = s; i + 1 < e; ++i)
+                insert_at(node, i - s, level[i].upper, level[i].ref);
+            node->upper_child = last.ref;
+            child_ref c;
+            c.lower = first.lower;
+            c.has_lower = first.has_lower;
+            c.upper = last.upper;
+            c.has_upper = last.has_upper;
+            c.ref = ref;
+            up.push_back(std::move(c));
+            s = e;
+        }
+        level = std::move(up);
+        ++height;
+    }
+    return {level.front().ref, height};
+}
+
+void free_subtree(btree_node* n) noexcept
+{
+    if (!n->leaf) {
+        reader r{n};
+        for (std::size_t i = 0; i < n->count; ++i)
+            free_subtree(reinterpret_cast<btree_node*>(r.payload(i)));
+        free_subtree(reinterpret_cast<btree_node*>(n->upper_child));
+    }
+    n->~btree_node();
+    ::operator delete(n, std::align_val_t(node_bytes));
+}
+
+void check_key(bytes key)
+{
+    if (key.size() > btree_index::max_key_size)
+        throw std::invalid_argument("yeni: btree key longer than " + std::to_string(btree_index::max_key_size)
+            + " bytes");
+}
+
+// Every entry, in order.
+template <class Tree>
+btree_batch collect(const Tree& tree)
+{
+    btree_batch all;
+    const std::vector<std::byte> hi(btree_index::max_key_size + 1, std::byte{0xff});
+    tree.scan(bytes{}, hi, [&](bytes k, std::uint64_t v) {
+        all.keys.insert(all.keys.end(), k.begin(), k.end());
+        all.ends.push_back(all.keys.size());
+        all.values.push_back(v);
+    });
+    return all;
+}
+
+} // namespace
+
+btree_index::btree_index()
+{
+    btree_node* n = allocate_node();
+    init(n, true, std::nullopt, std::nullopt);
+    root_.store(n, std::memory_order_release);
+}
+
+btree_index::btree_index(const btree_view& from)
+{
+    const btree_batch all = collect(from);
+    // Node contents are checked as they are read, but not their order
+    // across nodes; bulk_build() relies on it.
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        const bytes k = all.key(i);
+        if (k.size() > max_key_size || (i > 0 && compare(all.key(i - 1), k) >= 0))
+            throw format_error("yeni: btree entries out of order");
+    }
+    // Three quarters full, as random inserts would leave them.
+    const std::uint64_t root = bulk_build(all, node_bytes * 3 / 4, [&] {
+        btree_node* n = allocate_node();
+        return std::pair(n, std::uint64_t(reinterpret_cast<std::uintptr_t>(n)));
+    }).first;
+    root_.store(reinterpret_cast<btree_node*>(root), std::memory_order_release);
+    size_.store(all.size(), std::memory_order_relaxed);
+}
+
+btree_index::~btree_index()
+{
+    free_subtree(root_.load(std::memory_order_relaxed));
+}
+
+btree_node* btree_index::allocate_node()
+{
+    void* p = ::operator new(node_bytes, std::align_val_t(node_bytes));
+    nodes_.fetch_add(1, std::memory_order_relaxed);
+    return new (p) btree_node();
+}
+
+bool btree_index::insert(std::span<const std::byte> key, std::uint64_t value)
+{
+    check_key(key);
+    for (;;) {
+        switch (try_insert(key, value)) {
+        case result::ok:
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        case result::exists:
+            return false;
+        default:
+            break;
+        }
+    }
+}
+
+YENI_OPTIMISTIC btree_index::result btree_index::try_insert(std::span<const std::byte> key, std::uint64_t value)
+{
+    btree_node* parent = nullptr;
+    std::uint64_t parent_v = 0;
+    btree_node* n = root_.load(std::memory_order_acquire);
+    std::uint64_t v = read_lock(n);
+    if (root_.load(std::memory_order_acquire) != n)
+        return result::retry;
+
+    // Split `n` under `parent` (or grow a new root above it), both locked
+    // here; the caller restarts either way.
+    auto split = [&] {
+        if (parent && !upgrade(parent, parent_v))
+            return;
+        if (!upgrade(n, v)) {
+            if (parent)
+                unlock(parent);
+            return;
+        }
+        if (!parent && root_.load(std::memory_order_relaxed) != n) {
+            unlock(n);
+            return;
+        }
+        // Split where the heap bytes cross half way, so that both halves
+        // fit their fences and a maximal key whatever the key sizes.
+        reader r{n};
+        const std::size_t count = n->count;
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < count; ++i)
+            total += r.slot(i).size;
+        std::size_t m = 0;
+        for (std::size_t acc = 0; m + 1 < count && acc + r.slot(m).size <= total / 2; ++m)
+            acc += r.slot(m).size;
+        m = std::clamp<std::size_t>(m, 1, count - 1);
+
+        std::byte a[max_key_size], b[max_key_size];
+        bytes sep;
+        std::size_t right_begin = m;
+        std::uint64_t left_upper_child = 0;
+        if (n->leaf) {
+            sep = separator(r.key(m - 1, a), r.key(m, b));
+        } else {
+            sep = r.key(m, a);
+            left_upper_child = r.payload(m);
+            right_begin = m + 1;
+        }
+
+        btree_node* left = allocate_node();
+        rebuild(left, n, 0, m, r.lower(), sep, left_upper_child);
+        scratch_node right;
+        rebuild(right.get(), n, right_begin, count, sep, r.upper(), n->upper_child);
+        replace(n, right.get());
+
+        const auto left_ref = std::uint64_t(reinterpret_cast<std::uintptr_t>(left));
+        if (parent) {
+            bool found;
+            const std::size_t i = reader{parent}.lower_bound(sep, false, found);
+            make_room(parent, entry_bytes(sep.size() - parent->prefix));
+            insert_at(parent, i, sep, left_ref);
+            unlock(parent);
+        } else {
+            btree_node* root = allocate_node();
+            init(root, false, std::nullopt, std::nullopt);
+            insert_at(root, 0, sep, left_ref);
+            root->upper_child = std::uint64_t(reinterpret_cast<std::uintptr_t>(n));
+            root_.store(root, std::memory_order_release);
+        }
+        unlock(n);
+    };
+
+    while (!n->leaf) {
+        if (free_bytes(n) + n->dead < max_entry_bytes) {
+            if (!validate(n, v))
+                return result::retry;
+            split();
+            return result::retry;
+        }
+        reader r{n};
+        const std::uint64_t ref = r.child(key, false);
+        if (!r.ok || !validate(n, v))
+            return result::retry;
+        auto* child = reinterpret_cast<btree_node*>(ref);
+        const std::uint64_t child_v = read_lock(child);
+        if (!validate(n, v))
+            return result::retry;
+        parent = n;
+        parent_v = v;
+        n = child;
+        v = child_v;
+    }
+
+    reader r{n};
+    bool found;
+    const std::size_t i = r.lower_bound(key, false, found);
+    const std::size_t need = entry_bytes(key.size() - std::min<std::size_t>(key.size(), n->prefix));
+    const bool fits = free_bytes(n) + n->dead >= need;
+    if (!r.ok || !validate(n, v))
+        return result::retry;
+    if (found)
+        return result::exists;
+    if (!fits) {
+        split();
+        return result::retry;
+    }
+    if (!upgrade(n, v))
+        return result::retry;
+    make_room(n, need);
+    insert_at(n, i, key, value);
+    unlock(n);
+    return result::ok;
+}
+
+bool btree_index::erase(std::span<const std::byte> key)
+{
+    for (;;) {
+        switch (try_erase(key)) {
+        case result::ok:
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        case result::missing:
+            return false;
+        default:
+            break;
+        }
+    }
+}
+
+YENI_OPTIMISTIC btree_index::result btree_index::try_erase(std::span<const std::byte> key)
+{
+    std::uint64_t v;
+    const btree_node* leaf = descend(detail::btree_memory_source{root_}, key, false, v);
+    if (!leaf)
+        return result::retry;
+    reader r{leaf};
+    bool found;
+    const std::size_t i = r.lower_bound(key, false, found);
+    if (!r.ok || !validate(leaf, v))
+        return result::retry;
+    if (!found)
+        return result::missing;
+    auto* n = const_cast<btree_node*>(leaf);
+    if (!upgrade(n, v))
+        return result::retry;
+    remove_at(n, i);
+    unlock(n);
+    return result::ok;
+}
+
+std::optional<std::uint64_t> btree_index::find(std::span<const std::byte> key) const
+{
+    return find_in(detail::btree_memory_source{root_}, key);
+}
+
+bool btree_index::next_batch(std::span<const std::byte> from, bool inclusive, std::span<const std::byte> hi,
+    detail::btree_batch& batch) const
+{
+    return next_batch_in(detail::btree_memory_source{root_}, from, inclusive, hi, batch);
+}
+
+YENI_OPTIMISTIC std::size_t btree_index::height() const noexcept
+{
+    // Splits only ever add levels above the root, so every leaf is as deep.
+    std::size_t h = 1;
+    for (const btree_node* n = root_.load(std::memory_order_acquire); !n->leaf; ++h)
+        n = reinterpret_cast<const btree_node*>(n->upper_child);
+    return h;
+}
+
+std::vector<std::byte> btree_index::serialize() const
+{
+    const btree_batch all = collect(*this);
+    std::vector<std::byte> out(sizeof(file_header));
+    std::uint64_t nodes = 0;
+    const auto [root, height] = bulk_build(all, node_bytes, [&] {
+        out.resize(out.size() + node_bytes);
+        return std::pair(reinterpret_cast<btree_node*>(out.data() + out.size() - node_bytes), nodes++);
+    });
+    file_header h{};
+    std::memcpy(h.magic, file_magic, sizeof(h.magic));
+    h.version = file_version;
+    h.node_size = std::uint32_t(node_bytes);
+    h.nodes = nodes;
+    h.root = root;
+    h.entries = all.size();
+    h.height = std::uint32_t(height);
+    std::memcpy(out.data(), &h, sizeof(h));
+    return out;
+}
+
+void btree_index::save(segment_writer& w, std::string_view name) const
+{
+    w.add_block(name, serialize());
+}
+
+btree_view::btree_view(std::span<const std::byte> data)
+{
+    file_header h;
+    if (data.size() < sizeof(h))
+        throw format_error("yeni: btree block too short");
+    std::memcpy(&h, data.data(), sizeof(h));
+    if (std::memcmp(h.magic, file_magic, sizeof(h.magic)) != 0)
+        throw format_error("yeni: bad btree magic");
+    if (h.version != file_version)
+        throw format_error("yeni: unsupported btree version " + std::to_string(h.version));
+    if (h.node_size != node_bytes)
+        throw format_error("yeni: btree node size " + std::to_string(h.node_size) + " differs from "
+            + std::to_string(node_bytes));
+    if (h.nodes == 0 || h.nodes > (data.size() - sizeof(h)) / node_bytes
+        || data.size() != sizeof(h) + h.nodes * node_bytes)
+        throw format_error("yeni: btree node count does not match the block size");
+    if (h.root >= h.nodes || h.height == 0 || h.height > h.nodes)
+        throw format_error("yeni: btree root out of range");
+    if (reinterpret_cast<std::uintptr_t>(data.data()) % alignof(btree_node))
+        throw std::invalid_argument("yeni: btree_view over misaligned data");
+    base_ = data.data();
+    nodes_ = std::size_t(h.nodes);
+    root_ = h.root;
+    height_ = h.height;
+    entries_ = std::size_t(h.entries);
+}
+
+btree_view btree_view::open(const segment& s, std::string_view name)
+{
+    return btree_view(s.block_data(name));
+}
+
+std::optional<std::uint64_t> btree_view::find(std::span<const std::byte> key) const
+{
+    if (!base_)
+        return std::nullopt;
+    return find_in(detail::btree_view_source{*this}, key);
+}
+
+bool btree_view::next_batch(std::span<const std::byte> from, bool inclusive, std::span<const std::byte> hi,
+    detail::btree_batch& batch) const
+{
+    batch.clear();
+    if (!base_)
+        return false;
+    return next_batch_in(detail::btree_view_source{*this}, from, inclusive, hi, batch);
+}
+
+template <class T>
+void build_secondary_index(const segment& s, std::string_view column, secondary_index<T>& out)
+{
+    s.scan<T>(column, [&](std::size_t first, std::span<const T> rows) {
+        for (std::size_t i = 0; i < rows.size(); ++i)
+            out.insert(rows[i], first + i);
+    });
+}
+
+template void build_secondary_index(const segment&, std::string_view, secondary_index<std::uint32_t>&);
+template void build_secondary_index(const segment&, std::string_view, secondary_index<std::uint64_t>&);
+template void build_secondary_index(const segment&, std::string_view, secondary_index<std::int64_t>&);
+template void build_secondary_index(const segment&, std::string_view, secondary_index<double>&);
+
+} // namespace yeni
@@ -0,0 +1,1519 @@
+#include "yeni/bulk.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/segment.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace yeni {
+
+namespace fmt = segment_format;
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Structural index (stage 1): one bit per byte of a chunk, 64 to a word.
+// Chunk buffers are zero-padded to a whole word, and no character the
+// kernels look for is NUL.
+
+constexpr std::size_t block = 64;
+
+struct char_masks {
+    std::uint64_t a, b, c;
+};
+
+char_masks match_portable(const char* p, char a, char b, char c) noexcept
+{
+    char_masks m{0, 0, 0};
+    for (unsigned i = 0; i < block; ++i) {
+        const std::uint64_t bit = std::uint64_t(1) << i;
+        m.a |= p[i] == a ? bit : 0;
+        m.b |= p[i] == b ? bit : 0;
+        m.c |= p[i] == c ? bit : 0;
+    }
+    return m;
+}
+
+/// Bit i set iff an odd number of bits at or below i are: with quote
+/// bits in, the bytes from an opening quote up to its closing one.
+inline std::uint64_t prefix_xor(std::uint64_t x) noexcept
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/// CSV: separators and newlines outside quotes.
+template <class Match>
+__attribute__((always_inline)) inline void index_csv_with(const char* p, std::size_t n, char delim,
+    std::uint64_t* out, Match match) noexcept
+{
+    std::uint64_t inside = 0; // all ones while a quote is open across blocks
+    for (std::size_t w = 0; w * block < n; ++w) {
+        const char_masks m = match(p + w * block, '"', delim, '\n');
+        const std::uint64_t quoted = prefix_xor(m.a) ^ inside;
+        inside = std::uint64_t(std::int64_t(quoted) >> 63);
+        out[w] = (m.b | m.c) & ~quoted;
+    }
+}
+
+/// JSON: quotes that are not backslash-escaped, so that a string runs
+/// from one set bit to the next. Escapes are found as in simdjson: a
+/// character is escaped when an odd-length run of backslashes ends just
+/// before it, which adding the runs' odd-position starts to the backslash
+/// mask tells apart from even-length runs with one carry chain.
+template <class Match>
+__attribute__((always_inline)) inline void index_json_with(const char* p, std::size_t n, std::uint64_t* out,
+    Match match) noexcept
+{
+    constexpr std::uint64_t even = 0x5555555555555555ULL;
+    std::uint64_t carried = 0; // first byte of the block is escaped
+    for (std::size_t w = 0; w * block < n; ++w) {
+        const char_masks m = match(p + w * block, '"', '\\', '"');
+        const std::uint64_t backslash = m.b & ~carried;
+        const std::uint64_t follows = backslash << 1 | carried;
+        const std::uint64_t odd_starts = backslash & ~even & ~follows;
+        std::uint64_t even_starts;
+        carried = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+        const std::uint64_t escaped = (even ^ (even_starts << 1)) & follows;
+        out[w] = m.a & ~escaped;
+    }
+}
+
+/// Quotes in the whole words of [p, p + n).
+template <class Match>
+__attribute__((always_inline)) inline std::uint64_t count_quotes_with(const char* p, std::size_t n,
+    Match match) noexcept
+{
+    std::uint64_t count = 0;
+    for (std::size_t w = 0; w * block < n; ++w)
+        count += std::uint64_t(std::popcount(match(p + w * block, '"', '"', '"').a));
+    return count;
+}
+
+void index_csv_portable(const char* p, std::size_t n, char delim, std::uint64_t* out) noexcept
+{
+    index_csv_with(p, n, delim, out, match_portable);
+}
+
+void index_json_portable(const char* p, std::size_t n, std::uint64_t* out) noexcept
+{
+    index_json_with(p, n, out, match_portable);
+}
+
+std::uint64_t count_quotes_portable(const char* p, std::size_t n) noexcept
+{
+    return count_quotes_with(p, n, match_portable);
+}
+
+#if defined(__x86_64__)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+inline char_masks match_avx2(const char* p, char a, char b, char c) noexcept
+{
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    const auto bits = [&](char ch) {
+        const __m256i v = _mm256_set1_epi8(ch);
+        return std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v))))
+            | std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v)))) << 32;
+    };
+    return {bits(a), bits(b), bits(c)};
+}
+
+void index_csv_avx2(const char* p, std::size_t n, char delim, std::uint64_t* out) noexcept
+{
+    index_csv_with(p, n, delim, out, match_avx2);
+}
+
+void index_json_avx2(const char* p, std::size_t n, std::uint64_t* out) noexcept
+{
+    index_json_with(p, n, out, match_avx2);
+}
+
+std::uint64_t count_quotes_avx2(const char* p, std::size_t n) noexcept
+{
+    return count_quotes_with(p, n, match_avx2);
+}
+
+#pragma GCC pop_options
+
+#endif
+
+bool use_avx2() noexcept
+{
+#if defined(__x86_64__)
+    return active_simd_level() >= simd_level::avx2;
+#else
+    return false;
+#endif
+}
+
+void index_csv(const char* p, std::size_t n, char delim, std::uint64_t* out) noexcept
+{
+#if defined(__x86_64__)
+    if (use_avx2())
+        return index_csv_avx2(p, n, delim, out);
+#endif
+    index_csv_portable(p, n, delim, out);
+}
+
+void index_json(const char* p, std::size_t n, std::uint64_t* out) noexcept
+{
+#if defined(__x86_64__)
+    if (use_avx2())
+        return index_json_avx2(p, n, out);
+#endif
+    index_json_portable(p, n, out);
+}
+
+std::uint64_t count_quotes(const char* p, std::size_t n) noexcept
+{
+#if defined(__x86_64__)
+    if (use_avx2())
+        return count_quotes_avx2(p, n);
+#endif
+    return count_quotes_portable(p, n);
+}
+
+// ---------------------------------------------------------------------------
+// Pipeline plumbing.
+
+/// FIFO between two stages. Never holds more than the pool of buffers
+/// circulating through it, which is what bounds the pipeline.
+template <class T>
+class channel {
+public:
+    bool push(T v)
+    {
+        {
+            std::lock_guard lock(mutex_);
+            if (closed_)
+                return false;
+            items_.push_back(std::move(v));
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+    /// Next item; none once the channel is closed and drained, or
+    /// cancelled.
+    std::optional<T> pop()
+    {
+        std::unique_lock lock(mutex_);
+        ready_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+            return std::nullopt;
+        T v = std::move(items_.front());
+        items_.pop_front();
+        return v;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+    /// close() and drop whatever is queued.
+    void cancel()
+    {
+        std::deque<T> dropped;
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+            dropped.swap(items_);
+        }
+        ready_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+/// First error of any stage; recording it cancels every channel so the
+/// other stages stop at their next handoff.
+class stop_state {
+public:
+    template <class... Channels>
+    explicit stop_state(Channels&... channels)
+    {
+        (cancels_.push_back([&channels] { channels.cancel(); }), ...);
+    }
+
+    void fail(std::exception_ptr e) noexcept
+    {
+        {
+            std::lock_guard lock(mutex_);
+            if (!error_)
+                error_ = std::move(e);
+        }
+        for (auto& cancel : cancels_)
+            cancel();
+    }
+
+    template <class F>
+    void guard(F&& f) noexcept
+    {
+        try {
+            f();
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    }
+
+    void rethrow()
+    {
+        std::lock_guard lock(mutex_);
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::exception_ptr error_;
+    std::vector<std::function<void()>> cancels_;
+};
+
+/// Hands items on in sequence order whatever order they arrive in.
+template <class T>
+class reorder {
+public:
+    template <class F>
+    void push(T v, F&& next)
+    {
+        pending_.emplace(v.seq, std::move(v));
+        while (!pending_.empty() && pending_.begin()->first == next_) {
+            auto node = pending_.extract(pending_.begin());
+            ++next_;
+            next(std::move(node.mapped()));
+        }
+    }
+
+private:
+    std::map<std::uint64_t, T> pending_;
+    std::uint64_t next_ = 0;
+};
+
+struct text_chunk {
+    std::uint64_t seq = 0;
+    std::uint64_t offset = 0; // of data[0] in the file
+    std::size_t size = 0;     // data is zero-padded past it to a whole block
+    std::vector<char> data;
+};
+
+struct row_batch {
+    std::uint64_t seq = 0;
+    std::vector<std::byte> data;
+    std::vector<std::size_t> ends;
+
+    void clear() noexcept
+    {
+        data.clear();
+        ends.clear();
+    }
+    std::size_t size() const noexcept { return ends.size(); }
+    std::span<const std::byte> row(std::size_t i) const noexcept
+    {
+        const std::size_t begin = i ? ends[i - 1] : 0;
+        return {data.data() + begin, ends[i] - begin};
+    }
+};
+
+std::size_t worker_count(const bulk_options& o) noexcept
+{
+    if (o.threads)
+        return o.threads;
+    const unsigned cpus = std::thread::hardware_concurrency();
+    return cpus > 2 ? cpus - 2 : 1;
+}
+
+void check_options(const bulk_options& o)
+{
+    if (o.chunk_bytes == 0 || o.queue_depth == 0)
+        throw std::invalid_argument("yeni: bulk chunk_bytes and queue_depth must be positive");
+    if (o.delimiter == '\0' || o.delimiter == '"' || o.delimiter == '\n' || o.delimiter == '\r')
+        throw std::invalid_argument("yeni: csv delimiter cannot be NUL, a quote or a line break");
+}
+
+std::string_view format_name(text_format f) noexcept
+{
+    return f == text_format::csv ? "csv" : "ndjson";
+}
+
+std::string_view type_name(fmt::column_type t) noexcept
+{
+    switch (t) {
+    case fmt::column_type::u32:
+        return "u32";
+    case fmt::column_type::u64:
+        return "u64";
+    case fmt::column_type::i64:
+        return "i64";
+    case fmt::column_type::f64:
+        return "f64";
+    default:
+        return "binary";
+    }
+}
+
+std::span<const std::byte> as_bytes(std::string_view s) noexcept
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+std::string_view as_text(std::span<const std::byte> b) noexcept
+{
+    return {reinterpret_cast<const char*>(b.data()), b.size()};
+}
+
+schema::value zero_of(fmt::column_type t) noexcept
+{
+    switch (t) {
+    case fmt::column_type::u32:
+        return std::uint32_t(0);
+    case fmt::column_type::u64:
+        return std::uint64_t(0);
+    case fmt::column_type::i64:
+        return std::int64_t(0);
+    case fmt::column_type::f64:
+        return 0.0;
+    default:
+        return std::span<const std::byte>();
+    }
+}
+
+template <class T>
+bool parse_number(std::string_view t, schema::value& out) noexcept
+{
+    T v{};
+    const auto r = std::from_chars(t.data(), t.data() + t.size(), v);
+    if (r.ec != std::errc() || r.ptr != t.data() + t.size())
+        return false;
+    out = v;
+    return true;
+}
+
+/// Text `t` as a value of type `type`; false if it is not one.
+bool parse_value(fmt::column_type type, std::string_view t, schema::value& out) noexcept
+{
+    switch (type) {
+    case fmt::column_type::u32:
+        return parse_number<std::uint32_t>(t, out);
+    case fmt::column_type::u64:
+        return parse_number<std::uint64_t>(t, out);
+    case fmt::column_type::i64:
+        return parse_number<std::int64_t>(t, out);
+    case fmt::column_type::f64:
+        return parse_number<double>(t, out);
+    default:
+        out = as_bytes(t);
+        return true;
+    }
+}
+
+std::string excerpt(std::string_view t)
+{
+    return t.size() > 40 ? std::string(t.substr(0, 40)) + "..." : std::string(t);
+}
+
+class record_error {
+public:
+    record_error(text_format f, std::uint64_t offset)
+        : format_(f)
+        , offset_(offset)
+    {
+    }
+
+    [[noreturn]] void operator()(const std::string& what) const
+    {
+        throw format_error("yeni: " + std::string(format_name(format_)) + " record at byte "
+            + std::to_string(offset_) + ": " + what);
+    }
+
+private:
+    text_format format_;
+    std::uint64_t offset_;
+};
+
+// ---------------------------------------------------------------------------
+// CSV.
+
+/// Position after the last newline outside quotes in [p, p + n), 0 if
+/// there is none. `p` starts outside quotes and is padded.
+std::size_t csv_boundary(const char* p, std::size_t n) noexcept
+{
+    bool odd = count_quotes(p, n) & 1; // quotes open at the end
+    for (std::size_t i = n; i-- > 0;) {
+        if (p[i] == '"')
+            odd = !odd;
+        else if (p[i] == '\n' && !odd)
+            return i + 1;
+    }
+    return 0;
+}
+
+/// Fields of one CSV line, unquoted, for the header.
+std::vector<std::string> split_csv_line(std::string_view line, char delim, const record_error& error)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        const char ch = line[i];
+        if (quoted) {
+            if (ch != '"')
+                fields.back() += ch;
+            else if (i + 1 < line.size() && line[i + 1] == '"')
+                fields.back() += line[++i];
+            else
+                quoted = false;
+        } else if (ch == '"' && fields.back().empty()) {
+            quoted = true;
+        } else if (ch == delim) {
+            fields.emplace_back();
+        } else if (ch != '\r' || i + 1 != line.size()) {
+            fields.back() += ch;
+        }
+    }
+    if (quoted)
+        error("unterminated quote in header");
+    return fields;
+}
+
+class csv_parser {
+public:
+    csv_parser(const schema& s, const std::vector<int>& columns, char delim)
+        : schema_(s)
+        , columns_(columns)
+        , delim_(delim)
+        , values_(s.size())
+        , scratch_(s.size())
+    {
+    }
+
+    void parse(const text_chunk& c, row_batch& out)
+    {
+        const char* p = c.data.data();
+        const std::size_t n = c.size;
+        index_.resize((n + block - 1) / block);
+        index_csv(p, n, delim_, index_.data());
+
+        std::size_t start = 0, row = 0, field = 0;
+        for (std::size_t w = 0; w < index_.size(); ++w) {
+            for (std::uint64_t bits = index_[w]; bits; bits &= bits - 1) {
+                const std::size_t at = w * block + std::size_t(std::countr_zero(bits));
+                if (p[at] != '\n') {
+                    take(c, row, field++, start, at);
+                } else {
+                    const std::size_t end = at > start && p[at - 1] == '\r' ? at - 1 : at;
+                    if (field || end > start) { // blank lines are skipped
+                        take(c, row, field++, start, end);
+                        finish(c, row, field, out);
+                    }
+                    field = 0;
+                    row = at + 1;
+                }
+                start = at + 1;
+            }
+        }
+        if (field || start < n) { // a last line without its newline
+            const std::size_t end = n > start && p[n - 1] == '\r' ? n - 1 : n;
+            take(c, row, field++, start, end);
+            finish(c, row, field, out);
+        }
+    }
+
+private:
+    void take(const text_chunk& c, std::size_t row, std::size_t column, std::size_t begin, std::size_t end)
+    {
+        const record_error error(text_format::csv, c.offset + row);
+        if (column >= columns_.size())
+            error("more than " + std::to_string(columns_.size()) + " fields");
+        const int f = columns_[column];
+        if (f < 0)
+            return;
+        std::string_view t(c.data.data() + begin, end - begin);
+        if (!t.empty() && t.front() == '"') {
+            if (t.size() < 2 || t.back() != '"')
+                error("unterminated quote");
+            t = t.substr(1, t.size() - 2);
+            if (t.find('"') != std::string_view::npos) {
+                std::string& s = scratch_[std::size_t(f)];
+                s.clear();
+                for (std::size_t i = 0; i < t.size(); ++i) {
+                    if (t[i] == '"' && (i + 1 == t.size() || t[++i] != '"'))
+                        error("stray quote inside a quoted field");
+                    s += t[i];
+                }
+                t = s;
+            }
+        }
+        const schema::field& fd = schema_.fields()[std::size_t(f)];
+        if (!parse_value(fd.type, t, values_[std::size_t(f)]))
+            error("field '" + fd.name + "' is not a " + std::string(type_name(fd.type)) + ": '" + excerpt(t) + "'");
+    }
+
+    void finish(const text_chunk& c, std::size_t row, std::size_t fields, row_batch& out)
+    {
+        if (fields != columns_.size())
+            record_error(text_format::csv, c.offset + row)(
+                std::to_string(fields) + " fields, expected " + std::to_string(columns_.size()));
+        schema_.append(out.data, values_);
+        out.ends.push_back(out.data.size());
+    }
+
+    const schema& schema_;
+    const std::vector<int>& columns_; // schema field of each CSV column, -1 to skip it
+    char delim_;
+    std::vector<std::uint64_t> index_;
+    std::vector<schema::value> values_;
+    std::vector<std::string> scratch_; // unquoted field text, per field
+};
+
+// ---------------------------------------------------------------------------
+// NDJSON.
+
+void append_utf8(std::string& s, std::uint32_t cp)
+{
+    if (cp < 0x80) {
+        s += char(cp);
+    } else if (cp < 0x800) {
+        s += char(0xc0 | cp >> 6);
+        s += char(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        s += char(0xe0 | cp >> 12);
+        s += char(0x80 | (cp >> 6 & 0x3f));
+        s += char(0x80 | (cp & 0x3f));
+    } else {
+        s += char(0xf0 | cp >> 18);
+        s += char(0x80 | (cp >> 12 & 0x3f));
+        s += char(0x80 | (cp >> 6 & 0x3f));
+        s += char(0x80 | (cp & 0x3f));
+    }
+}
+
+class json_parser {
+public:
+    explicit json_parser(const schema& s)
+        : schema_(s)
+        , values_(s.size())
+        , scratch_(s.size())
+    {
+    }
+
+    void parse(const text_chunk& c, row_batch& out)
+    {
+        p_ = c.data.data();
+        n_ = c.size;
+        index_.resize((n_ + block - 1) / block);
+        index_json(p_, n_, index_.data());
+
+        std::size_t pos = 0;
+        for (;;) {
+            while (pos < n_ && (p_[pos] == ' ' || p_[pos] == '\t' || p_[pos] == '\r' || p_[pos] == '\n'))
+                ++pos;
+            if (pos == n_)
+                return;
+            const record_error error(text_format::ndjson, c.offset + pos);
+            for (std::size_t i = 0; i < values_.size(); ++i)
+                values_[i] = zero_of(schema_.fields()[i].type);
+            pos = object(pos, error);
+            pos = skip_space(pos);
+            if (pos < n_ && p_[pos] != '\n')
+                error("text after the object");
+            schema_.append(out.data, values_);
+            out.ends.push_back(out.data.size());
+        }
+    }
+
+private:
+    std::size_t skip_space(std::size_t pos) const noexcept
+    {
+        while (pos < n_ && (p_[pos] == ' ' || p_[pos] == '\t' || p_[pos] == '\r'))
+            ++pos;
+        return pos;
+    }
+
+    /// Position of the first unescaped quote at or after `pos`, n_ if none.
+    std::size_t next_quote(std::size_t pos) const noexcept
+    {
+        std::size_t w = pos / block;
+        if (w >= index_.size())
+            return n_;
+        std::uint64_t bits = index_[w] & (~std::uint64_t(0) << (pos % block));
+        while (!bits) {
+            if (++w == index_.size())
+                return n_;
+            bits = index_[w];
+        }
+        return std::min(n_, w * block + std::size_t(std::countr_zero(bits)));
+    }
+
+    /// The string opening at `pos`, unescaped into `scratch` if it needs
+    /// to be; sets `end` past its closing quote.
+    std::string_view string_at(std::size_t pos, std::string& scratch, std::size_t& end, const record_error& error)
+    {
+        const std::size_t close = next_quote(pos + 1);
+        if (close >= n_)
+            error("unterminated string");
+        end = close + 1;
+        const std::string_view raw(p_ + pos + 1, close - pos - 1);
+        if (raw.find('\\') == std::string_view::npos)
+            return raw;
+        scratch.clear();
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] != '\\') {
+                scratch += raw[i];
+                continue;
+            }
+            if (++i == raw.size())
+                error("bad escape");
+            switch (raw[i]) {
+            case '"':
+            case '\\':
+            case '/':
+                scratch += raw[i];
+                break;
+            case 'b':
+                scratch += '\b';
+                break;
+            case 'f':
+                scratch += '\f';
+                break;
+            case 'n':
+                scratch += '\n';
+                break;
+            case 'r':
+                scratch += '\r';
+                break;
+            case 't':
+                scratch += '\t';
+                break;
+            case 'u': {
+                const auto hex4 = [&](std::size_t at) {
+                    std::uint32_t v = 0;
+                    if (at + 4 > raw.size()
+                        || std::from_chars(raw.data() + at, raw.data() + at + 4, v, 16).ptr != raw.data() + at + 4)
+                        error("bad \\u escape");
+                    return v;
+                };
+                std::uint32_t cp = hex4(i + 1);
+                i += 4;
+                if (cp >= 0xd800 && cp < 0xdc00 && i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+                    const std::uint32_t low = hex4(i + 3);
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        i += 6;
+                    }
+                }
+                append_utf8(scratch, cp);
+                break;
+            }
+            default:
+                error("bad escape");
+            }
+        }
+        return scratch;
+    }
+
+    /// Past the object or array opening at `pos`, strings skipped whole.
+    std::size_t skip_nested(std::size_t pos, const record_error& error) const
+    {
+        std::size_t depth = 0;
+        while (pos < n_) {
+            const char ch = p_[pos];
+            if (ch == '"') {
+                pos = next_quote(pos + 1);
+                if (pos >= n_)
+                    break;
+            } else if (ch == '{' || ch == '[') {
+                ++depth;
+            } else if (ch == '}' || ch == ']') {
+                if (--depth == 0)
+                    return pos + 1;
+            } else if (ch == '\n') {
+                break;
+            }
+            ++pos;
+        }
+        error("unterminated object or array");
+    }
+
+    std::size_t object(std::size_t pos, const record_error& error)
+    {
+        if (p_[pos] != '{')
+            error("expected an object");
+        pos = skip_space(pos + 1);
+        if (pos < n_ && p_[pos] == '}')
+            return pos + 1;
+        std::size_t guess = 0; // keys tend to come in the same order on every line
+        for (;;) {
+            if (pos >= n_ || p_[pos] != '"')
+                error("expected a key");
+            const std::string_view key = string_at(pos, key_, pos, error);
+            int f = -1;
+            if (guess < schema_.size() && schema_.fields()[guess].name == key)
+                f = int(guess);
+            else if (const auto i = schema_.index_of(key))
+                f = int(*i);
+            guess = std::size_t(f + 1);
+            pos = skip_space(pos);
+            if (pos >= n_ || p_[pos] != ':')
+                error("expected ':' after a key");
+            pos = value(skip_space(pos + 1), f, error);
+            pos = skip_space(pos);
+            if (pos < n_ && p_[pos] == ',') {
+                pos = skip_space(pos + 1);
+                continue;
+            }
+            if (pos < n_ && p_[pos] == '}')
+                return pos + 1;
+            error("expected ',' or '}'");
+        }
+    }
+
+    /// Parse the value at `pos` into field `f` (none if negative).
+    std::size_t value(std::size_t pos, int f, const record_error& error)
+    {
+        if (pos >= n_)
+            error("expected a value");
+        const schema::field* fd = f < 0 ? nullptr : &schema_.fields()[std::size_t(f)];
+        const bool binary = fd && fd->type == fmt::column_type::binary;
+        const char ch = p_[pos];
+        if (ch == '"') {
+            std::size_t end;
+            const std::string_view s = string_at(pos, f < 0 ? key_ : scratch_[std::size_t(f)], end, error);
+            if (fd && !binary)
+                error("field '" + fd->name + "' expects a number, got a string");
+            if (fd)
+                values_[std::size_t(f)] = as_bytes(s);
+            return end;
+        }
+        if (ch == '{' || ch == '[') {
+            const std::size_t end = skip_nested(pos, error);
+            if (fd && !binary)
+                error("field '" + fd->name + "' expects a number");
+            if (fd)
+                values_[std::size_t(f)] = as_bytes(std::string_view(p_ + pos, end - pos));
+            return end;
+        }
+        std::size_t end = pos;
+        while (end < n_ && p_[end] != ',' && p_[end] != '}' && p_[end] != ' ' && p_[end] != '\t' && p_[end] != '\r'
+            && p_[end] != '\n')
+            ++end;
+        const std::string_view t(p_ + pos, end - pos);
+        if (t.empty())
+            error("expected a value");
+        if (!fd || t == "null")
+            return end;
+        if (!binary && (t == "true" || t == "false")) {
+            parse_value(fd->type, t == "true" ? "1" : "0", values_[std::size_t(f)]);
+            return end;
+        }
+        if (!parse_value(fd->type, t, values_[std::size_t(f)]))
+            error("field '" + fd->name + "' is not a " + std::string(type_name(fd->type)) + ": '" + excerpt(t) + "'");
+        return end;
+    }
+
+    const schema& schema_;
+    const char* p_ = nullptr;
+    std::size_t n_ = 0;
+    std::vector<std::uint64_t> index_;
+    std::vector<schema::value> values_;
+    std::vector<std::string> scratch_; // unescaped strings, per field
+    std::string key_;
+};
+
+// ---------------------------------------------------------------------------
+// Import.
+
+class file_reader {
+public:
+    explicit file_reader(const std::filesystem::path& path)
+        : path_(path)
+    {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+            throw_errno("open " + path.string());
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    ~file_reader() { ::close(fd_); }
+
+    file_reader(const file_reader&) = delete;
+    file_reader& operator=(const file_reader&) = delete;
+
+    /// Read until `size` reaches `want` or the file ends.
+    std::size_t fill(char* data, std::size_t size, std::size_t want)
+    {
+        while (size < want && !eof_) {
+            const ssize_t r = ::read(fd_, data + size, want - size);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw_errno("read " + path_.string());
+            }
+            eof_ = r == 0;
+            size += std::size_t(r);
+        }
+        return size;
+    }
+
+    bool eof() const noexcept { return eof_; }
+
+private:
+    std::filesystem::path path_;
+    int fd_ = -1;
+    bool eof_ = false;
+};
+
+struct import_job {
+    const schema& s;
+    const bulk_options& options;
+    std::vector<int> columns; // CSV: set by the reader before the first chunk goes out
+
+    channel<text_chunk> free_chunks, chunks;
+    channel<row_batch> free_batches, batches;
+    stop_state stop{free_chunks, chunks, free_batches, batches};
+    std::atomic<std::uint64_t> bytes{0};
+
+    import_job(const schema& schema, const bulk_options& o)
+        : s(schema)
+        , options(o)
+    {
+    }
+
+    /// Map header names to fields.
+    void read_header(std::string_view line)
+    {
+        const auto names = split_csv_line(line, options.delimiter, record_error(text_format::csv, 0));
+        columns.assign(names.size(), -1);
+        std::vector<bool> seen(s.size());
+        for (std::size_t i = 0; i < names.size(); ++i)
+            if (const auto f = s.index_of(names[i]); f && !seen[*f]) {
+                columns[i] = int(*f);
+                seen[*f] = true;
+            }
+        for (std::size_t f = 0; f < s.size(); ++f)
+            if (!seen[f])
+                throw format_error("yeni: csv header has no column '" + s.fields()[f].name + "'");
+    }
+
+    /// Cut the file into chunks of whole records.
+    void read(const std::filesystem::path& path)
+    {
+        const bool csv = options.format == text_format::csv;
+        file_reader in(path);
+        std::vector<char> pending;
+        std::uint64_t offset = 0, seq = 0;
+        bool first = true;
+        while (!in.eof() || !pending.empty()) {
+            std::optional<text_chunk> c = free_chunks.pop();
+            if (!c)
+                return;
+            std::vector<char>& d = c->data;
+            std::size_t size = pending.size(), want = options.chunk_bytes, boundary = 0;
+            while (want <= size)
+                want *= 2;
+            d.resize(want + block);
+            std::copy(pending.begin(), pending.end(), d.begin());
+            for (;;) {
+                size = in.fill(d.data(), size, want);
+                std::fill(d.begin() + std::ptrdiff_t(size), d.begin() + std::ptrdiff_t(size + block), '\0');
+                if (in.eof()) {
+                    boundary = size;
+                    break;
+                }
+                if (csv) {
+                    boundary = csv_boundary(d.data(), size);
+                } else {
+                    const void* nl = size ? ::memrchr(d.data(), '\n', size) : nullptr;
+                    boundary = nl ? std::size_t(static_cast<const char*>(nl) - d.data()) + 1 : 0;
+                }
+                if (boundary)
+                    break;
+                want *= 2; // a record longer than the chunk
+                d.resize(want + block);
+            }
+            bytes.fetch_add(size - pending.size(), std::memory_order_relaxed);
+            pending.assign(d.begin() + std::ptrdiff_t(boundary), d.begin() + std::ptrdiff_t(size));
+            std::size_t skip = 0;
+            if (first && csv && boundary) {
+                first = false;
+                if (options.header) {
+                    for (bool quoted = false; skip < boundary && (quoted || d[skip] != '\n'); ++skip)
+                        quoted ^= d[skip] == '"';
+                    read_header(std::string_view(d.data(), skip));
+                    skip = std::min(boundary, skip + 1);
+                } else {
+                    columns.resize(s.size());
+                    for (std::size_t i = 0; i < s.size(); ++i)
+                        columns[i] = int(i);
+                }
+            }
+            if (skip)
+                d.erase(d.begin(), d.begin() + std::ptrdiff_t(skip));
+            c->size = boundary - skip;
+            std::fill(d.begin() + std::ptrdiff_t(c->size), d.begin() + std::ptrdiff_t(c->size + block), '\0');
+            c->offset = offset + skip;
+            offset += boundary;
+            if (c->size == 0) {
+                free_chunks.push(std::move(*c));
+                continue;
+            }
+            c->seq = seq++;
+            if (!chunks.push(std::move(*c)))
+                return;
+        }
+    }
+
+    void parse()
+    {
+        std::optional<csv_parser> csv;
+        std::optional<json_parser> json;
+        if (options.format == text_format::csv)
+            csv.emplace(s, columns, options.delimiter);
+        else
+            json.emplace(s);
+        for (;;) {
+            // A batch first, then a chunk: whoever holds the chunk the sink
+            // waits for then never waits for a batch.
+            std::optional<row_batch> b = free_batches.pop();
+            if (!b)
+                return;
+            std::optional<text_chunk> c = chunks.pop();
+            if (!c)
+                return;
+            b->clear();
+            b->seq = c->seq;
+            if (csv)
+                csv->parse(*c, *b);
+            else
+                json->parse(*c, *b);
+            free_chunks.push(std::move(*c));
+            if (!batches.push(std::move(*b)))
+                return;
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Export.
+
+void write_all(int fd, const char* p, std::size_t n, const std::filesystem::path& path)
+{
+    while (n) {
+        const ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("write " + path.string());
+        }
+        p += w;
+        n -= std::size_t(w);
+    }
+}
+
+void append_csv_text(std::string& out, std::string_view t, char delim)
+{
+    bool quote = false;
+    for (const char ch : t)
+        quote |= ch == delim || ch == '"' || ch == '\n' || ch == '\r';
+    if (!quote) {
+        out += t;
+        return;
+    }
+    out += '"';
+    for (const char ch : t) {
+        if (ch == '"')
+            out += '"';
+        out += ch;
+    }
+    out += '"';
+}
+
+void append_json_string(std::string& out, std::string_view t)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    out += '"';
+    std::size_t run = 0; // start of the bytes not yet copied
+    for (std::size_t i = 0; i < t.size(); ++i) {
+        const auto ch = static_cast<unsigned char>(t[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;
+        out.append(t.data() + run, i - run);
+        run = i + 1;
+        out += '\\';
+        switch (ch) {
+        case '"':
+        case '\\':
+            out += char(ch);
+            break;
+        case '\n':
+            out += 'n';
+            break;
+        case '\r':
+            out += 'r';
+            break;
+        case '\t':
+            out += 't';
+            break;
+        default:
+            out += "u00";
+            out += hex[ch >> 4];
+            out += hex[ch & 15];
+        }
+    }
+    out.append(t.data() + run, t.size() - run);
+    out += '"';
+}
+
+template <class T>
+void append_number(std::string& out, T v)
+{
+    char buf[32];
+    const auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+}
+
+class text_formatter {
+public:
+    text_formatter(const schema& s, const bulk_options& o)
+        : schema_(s)
+        , options_(o)
+    {
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            std::string key(i ? "," : "{");
+            append_json_string(key, s.fields()[i].name);
+            keys_.push_back(key + ":");
+        }
+    }
+
+    std::string header() const
+    {
+        std::string out;
+        if (options_.format == text_format::csv && options_.header) {
+            for (std::size_t i = 0; i < schema_.size(); ++i) {
+                if (i)
+                    out += options_.delimiter;
+                append_csv_text(out, schema_.fields()[i].name, options_.delimiter);
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+    void format(std::span<const std::byte> record, std::string& out) const
+    {
+        const bool csv = options_.format == text_format::csv;
+        for (std::size_t i = 0; i < schema_.size(); ++i) {
+            if (!csv)
+                out += keys_[i];
+            else if (i)
+                out += options_.delimiter;
+            const schema::value v = schema_.get(record, i);
+            switch (v.index()) {
+            case 0:
+                append_number(out, std::get<std::uint32_t>(v));
+                break;
+            case 1:
+                append_number(out, std::get<std::uint64_t>(v));
+                break;
+            case 2:
+                append_number(out, std::get<std::int64_t>(v));
+                break;
+            case 3: {
+                const double d = std::get<double>(v);
+                if (!csv && !std::isfinite(d))
+                    out += "null";
+                else
+                    append_number(out, d);
+                break;
+            }
+            default: {
+                const std::string_view t = as_text(std::get<std::span<const std::byte>>(v));
+                if (csv)
+                    append_csv_text(out, t, options_.delimiter);
+                else
+                    append_json_string(out, t);
+            }
+            }
+        }
+        out += csv ? "\n" : "}\n";
+    }
+
+private:
+    const schema& schema_;
+    const bulk_options& options_;
+    std::vector<std::string> keys_; // NDJSON: `{"name":` or `,"name":`
+};
+
+struct text_out {
+    std::uint64_t seq = 0;
+    std::string data;
+};
+
+/// Thrown through a bulk_source once the export has failed elsewhere.
+struct export_stopped {};
+
+struct export_job {
+    const schema& s;
+    const bulk_options& options;
+    text_formatter formatter;
+
+    channel<row_batch> free_batches, batches;
+    channel<text_out> free_texts, texts;
+    stop_state stop{free_batches, batches, free_texts, texts};
+
+    export_job(const schema& schema, const bulk_options& o)
+        : s(schema)
+        , options(o)
+        , formatter(schema, o)
+    {
+    }
+
+    void format()
+    {
+        for (;;) {
+            std::optional<text_out> t = free_texts.pop();
+            if (!t)
+                return;
+            std::optional<row_batch> b = batches.pop();
+            if (!b)
+                return;
+            t->seq = b->seq;
+            t->data.clear();
+            for (std::size_t i = 0; i < b->size(); ++i)
+                formatter.format(b->row(i), t->data);
+            free_batches.push(std::move(*b));
+            if (!texts.push(std::move(*t)))
+                return;
+        }
+    }
+
+    std::uint64_t write(int fd, const std::filesystem::path& path)
+    {
+        const std::string header = formatter.header();
+        write_all(fd, header.data(), header.size(), path);
+        std::uint64_t bytes = header.size();
+        reorder<text_out> order;
+        while (std::optional<text_out> t = texts.pop()) {
+            order.push(std::move(*t), [&](text_out&& next) {
+                write_all(fd, next.data.data(), next.data.size(), path);
+                bytes += next.data.size();
+                free_texts.push(std::move(next));
+            });
+        }
+        return bytes;
+    }
+};
+
+} // namespace
+
+bulk_stats import_text(const std::filesystem::path& in, const schema& s, const bulk_sink& sink,
+    const bulk_options& options)
+{
+    check_options(options);
+    import_job job(s, options);
+    const std::size_t workers = worker_count(options), buffers = workers + options.queue_depth;
+    for (std::size_t i = 0; i < buffers; ++i) {
+        job.free_chunks.push(text_chunk{});
+        job.free_batches.push(row_batch{});
+    }
+
+    std::atomic<std::size_t> parsing{workers};
+    std::thread reader([&] {
+        job.stop.guard([&] { job.read(in); });
+        job.chunks.close();
+    });
+    std::vector<std::thread> parsers;
+    for (std::size_t i = 0; i < workers; ++i)
+        parsers.emplace_back([&] {
+            job.stop.guard([&] { job.parse(); });
+            if (parsing.fetch_sub(1) == 1)
+                job.batches.close();
+        });
+
+    bulk_stats stats;
+    job.stop.guard([&] {
+        auto& m = metrics::local();
+        reorder<row_batch> order;
+        std::vector<std::span<const std::byte>> rows;
+        while (std::optional<row_batch> b = job.batches.pop()) {
+            order.push(std::move(*b), [&](row_batch&& next) {
+                rows.resize(next.size());
+                for (std::size_t i = 0; i < rows.size(); ++i)
+                    rows[i] = next.row(i);
+                if (!rows.empty())
+                    sink(rows);
+                stats.rows += rows.size();
+                m.add(metrics::counter::import_rows, rows.size());
+                job.free_batches.push(std::move(next));
+            });
+        }
+    });
+    reader.join();
+    for (auto& t : parsers)
+        t.join();
+    job.stop.rethrow();
+    stats.bytes = job.bytes.load(std::memory_order_relaxed);
+    metrics::local().add(metrics::counter::import_bytes, stats.bytes);
+    return stats;
+}
+
+bulk_stats import_text(const std::filesystem::path& in, const schema& s, record_store& store,
+    std::string_view key_field, const bulk_options& options)
+{
+    const auto key = s.index_of(key_field);
+    if (!key || s.fields()[*key].type != fmt::column_type::u64)
+        throw std::invalid_argument("yeni: import key '" + std::string(key_field) + "' is not a u64 field");
+    std::vector<std::uint64_t> keys;
+    return import_text(
+        in, s,
+        [&](std::span<const std::span<const std::byte>> records) {
+            keys.resize(records.size());
+            for (std::size_t i = 0; i < records.size(); ++i)
+                keys[i] = std::get<std::uint64_t>(s.get(records[i], *key));
+            store.append_many(keys, records);
+        },
+        options);
+}
+
+bulk_stats export_text(const std::filesystem::path& out, const schema& s, const bulk_source& source,
+    const bulk_options& options)
+{
+    check_options(options);
+    const std::filesystem::path tmp = out.string() + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw_errno("open " + tmp.string());
+
+    export_job job(s, options);
+    const std::size_t workers = worker_count(options), buffers = workers + options.queue_depth;
+    for (std::size_t i = 0; i < buffers; ++i) {
+        job.free_batches.push(row_batch{});
+        job.free_texts.push(text_out{});
+    }
+
+    std::atomic<std::size_t> formatting{workers};
+    std::vector<std::thread> formatters;
+    for (std::size_t i = 0; i < workers; ++i)
+        formatters.emplace_back([&] {
+            job.stop.guard([&] { job.format(); });
+            if (formatting.fetch_sub(1) == 1)
+                job.texts.close();
+        });
+    bulk_stats stats;
+    std::thread writer([&] { job.stop.guard([&] { stats.bytes = job.write(fd, tmp); }); });
+
+    try {
+        std::optional<row_batch> batch;
+        std::uint64_t seq = 0;
+        const auto hand_over = [&] {
+            batch->seq = seq++;
+            if (!job.batches.push(std::move(*batch)))
+                throw export_stopped{};
+            batch.reset();
+        };
+        source([&](std::span<const std::byte> record) {
+            if (!batch) {
+                batch = job.free_batches.pop();
+                if (!batch)
+                    throw export_stopped{};
+                batch->clear();
+            }
+            batch->data.insert(batch->data.end(), record.begin(), record.end());
+            batch->ends.push_back(batch->data.size());
+            ++stats.rows;
+            if (batch->data.size() >= options.chunk_bytes)
+                hand_over();
+        });
+        if (batch && batch->size())
+            hand_over();
+    } catch (const export_stopped&) {
+    } catch (...) {
+        job.stop.fail(std::current_exception());
+    }
+    job.batches.close();
+    for (auto& t : formatters)
+        t.join();
+    writer.join();
+
+    job.stop.guard([&] {
+        if (::fdatasync(fd) != 0)
+            throw_errno("fdatasync " + tmp.string());
+    });
+    const bool closed = ::close(fd) == 0;
+    try {
+        job.stop.rethrow();
+        if (!closed)
+            throw_errno("close " + tmp.string());
+        if (::rename(tmp.c_str(), out.c_str()) != 0)
+            throw_errno("rename " + out.string());
+    } catch (...) {
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    auto& m = metrics::local();
+    m.add(metrics::counter::export_rows, stats.rows);
+    m.add(metrics::counter::export_bytes, stats.bytes);
+    return stats;
+}
+
+bulk_stats export_text(const std::filesystem::path& out, const segment& in, const bulk_options& options)
+{
+    const schema s = segment_schema(in);
+    return export_text(out, s, segment_source(in, s), options);
+}
+
+schema segment_schema(const segment& s)
+{
+    std::vector<schema::field> fields;
+    for (const auto& b : s.blocks())
+        if (b.kind == fmt::block_kind::column)
+            fields.push_back({std::string(b.name_view()), b.type});
+    if (fields.empty())
+        throw format_error("yeni: segment " + s.path().string() + " has no columns");
+    return schema(std::move(fields));
+}
+
+bulk_source segment_source(const segment& in, const schema& s)
+{
+    return [&in, &s](const bulk_emit& emit) {
+        struct column {
+            fmt::column_type type;
+            const void* fixed;
+            binary_column binary;
+        };
+        std::vector<column> columns;
+        for (const auto& f : s.fields()) {
+            column c{f.type, nullptr, {}};
+            switch (f.type) {
+            case fmt::column_type::u32:
+                c.fixed = in.column<std::uint32_t>(f.name).data();
+                break;
+            case fmt::column_type::u64:
+                c.fixed = in.column<std::uint64_t>(f.name).data();
+                break;
+            case fmt::column_type::i64:
+                c.fixed = in.column<std::int64_t>(f.name).data();
+                break;
+            case fmt::column_type::f64:
+                c.fixed = in.column<double>(f.name).data();
+                break;
+            default:
+                c.binary = in.binary(f.name);
+                break;
+            }
+            columns.push_back(c);
+        }
+        std::vector<schema::value> values(columns.size());
+        std::vector<std::byte> record;
+        for (std::size_t r = 0; r < in.rows(); ++r) {
+            for (std::size_t i = 0; i < columns.size(); ++i) {
+                const column& c = columns[i];
+                switch (c.type) {
+                case fmt::column_type::u32:
+                    values[i] = static_cast<const std::uint32_t*>(c.fixed)[r];
+                    break;
+                case fmt::column_type::u64:
+                    values[i] = static_cast<const std::uint64_t*>(c.fixed)[r];
+                    break;
+                case fmt::column_type::i64:
+                    values[i] = static_cast<const std::int64_t*>(c.fixed)[r];
+                    break;
+                case fmt::column_type::f64:
+                    values[i] = static_cast<const double*>(c.fixed)[r];
+                    break;
+                default:
+                    values[i] = c.binary[r];
+                    break;
+                }
+            }
+            s.encode_into(record, values);
+            emit(record);
+        }
+    };
+}
+
+segment_sink::segment_sink(std::filesystem::path prefix, schema s, std::size_t rows_per_segment,
+    const codec_options& codec)
+    : prefix_(std::move(prefix))
+    , schema_(std::move(s))
+    , rows_per_segment_(rows_per_segment)
+    , codec_(codec)
+{
+    if (rows_per_segment_ == 0)
+        throw std::invalid_argument("yeni: segment_sink rows_per_segment must be positive");
+}
+
+void segment_sink::operator()(std::span<const std::span<const std::byte>> records)
+{
+    for (const auto r : records) {
+        data_.insert(data_.end(), r.begin(), r.end());
+        ends_.push_back(data_.size());
+        if (ends_.size() == rows_per_segment_)
+            flush();
+    }
+}
+
+void segment_sink::finish()
+{
+    if (!ends_.empty())
+        flush();
+}
+
+void segment_sink::flush()
+{
+    std::vector<std::span<const std::byte>> rows(ends_.size());
+    for (std::size_t i = 0, begin = 0; i < rows.size(); begin = ends_[i++])
+        rows[i] = {data_.data() + begin, ends_[i] - begin};
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "-%06zu.seg", files_.size());
+    std::filesystem::path path = prefix_.string() + suffix;
+    segment_writer w(path, nullptr, codec_);
+    schema_.add_columns(w, rows);
+    w.finish();
+    files_.push_back(std::move(path));
+    data_.clear();
+    ends_.clear();
+}
+
+} // namespace yeni
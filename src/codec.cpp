@@ -0,0 +1,729 @@
+#include "yeni/codec.hpp"
+
+#include "lz4.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/predicate.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#ifndef YENI_ZSTD
+#define YENI_ZSTD 0
+#endif
+
+#if YENI_ZSTD
+#include <zstd.h>
+#endif
+
+namespace yeni {
+
+namespace {
+
+using detail::packed_header;
+using detail::page_desc;
+
+constexpr std::size_t lanes = 8;
+constexpr std::size_t max_dictionary = std::size_t(1) << 16;
+
+// Header of an lz4 or zstd block.
+struct general_header {
+    std::uint64_t raw_size;
+    std::uint64_t reserved;
+};
+
+// Unsigned integer of T's width; packed arithmetic wraps in it.
+template <class T>
+using bits_t = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+
+template <class T>
+bits_t<T> to_bits(T v) noexcept
+{
+    return std::bit_cast<bits_t<T>>(v);
+}
+
+std::size_t align32(std::size_t v) noexcept
+{
+    return (v + 31) & ~std::size_t(31);
+}
+
+std::size_t page_rows(std::uint64_t rows, std::size_t page) noexcept
+{
+    return std::size_t(std::min<std::uint64_t>(packed_page_rows, rows - std::uint64_t(page) * packed_page_rows));
+}
+
+// u32 words a page of `rows` values at `width` bits occupies: each lane
+// holds ceil(rows / 8) values.
+std::size_t page_words(std::size_t rows, unsigned width) noexcept
+{
+    const std::size_t per_lane = (rows + lanes - 1) / lanes;
+    return lanes * ((per_lane * width + 31) / 32);
+}
+
+// Value i goes to lane i % 8, which packs its values back to back; word j
+// of lane l is words[8 * j + l].
+void pack(const std::uint32_t* v, std::size_t n, unsigned width, std::uint32_t* words) noexcept
+{
+    if (width == 0)
+        return;
+    const std::size_t per_lane = (n + lanes - 1) / lanes;
+    for (std::size_t k = 0; k < per_lane; ++k) {
+        const std::size_t bit = k * width, j = bit / 32;
+        const unsigned s = unsigned(bit % 32);
+        for (std::size_t l = 0; l < lanes; ++l) {
+            const std::uint32_t x = lanes * k + l < n ? v[lanes * k + l] : 0;
+            words[lanes * j + l] |= x << s;
+            if (s + width > 32)
+                words[lanes * (j + 1) + l] |= x >> (32 - s);
+        }
+    }
+}
+
+// pack() undone for ceil(n / 8) values a lane: writes out[0, 8 * that).
+void unpack_portable(const std::uint32_t* words, unsigned width, std::size_t n, std::uint32_t* out) noexcept
+{
+    const std::size_t per_lane = (n + lanes - 1) / lanes;
+    if (width == 0) {
+        std::fill_n(out, lanes * per_lane, 0u);
+        return;
+    }
+    const std::uint64_t mask = (std::uint64_t(1) << width) - 1;
+    for (std::size_t k = 0; k < per_lane; ++k) {
+        const std::size_t bit = k * width, j = bit / 32;
+        const unsigned s = unsigned(bit % 32);
+        for (std::size_t l = 0; l < lanes; ++l) {
+            std::uint64_t v = words[lanes * j + l];
+            if (s + width > 32)
+                v |= std::uint64_t(words[lanes * (j + 1) + l]) << 32;
+            out[lanes * k + l] = std::uint32_t((v >> s) & mask);
+        }
+    }
+}
+
+template <class T>
+void add_base_portable(const std::uint32_t* in, std::size_t n, std::uint64_t base, T* out) noexcept
+{
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = T(bits_t<T>(base) + in[i]);
+}
+
+template <class T>
+void gather_portable(const T* dict, const std::uint32_t* in, std::size_t n, T* out) noexcept
+{
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = dict[in[i]];
+}
+
+#if defined(__x86_64__)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+// Eight rows per step: shift the lanes' current words right, pull in the
+// next words where a value straddles them, mask.
+void unpack_avx2(const std::uint32_t* words, unsigned width, std::size_t n, std::uint32_t* out) noexcept
+{
+    const std::size_t per_lane = (n + lanes - 1) / lanes;
+    if (width == 0) {
+        std::fill_n(out, lanes * per_lane, 0u);
+        return;
+    }
+    const __m256i mask = _mm256_set1_epi32(width == 32 ? -1 : int((1u << width) - 1));
+    const auto* in = reinterpret_cast<const __m256i*>(words);
+    __m256i cur = _mm256_loadu_si256(in++);
+    unsigned shift = 0;
+    for (std::size_t k = 0; k < per_lane; ++k) {
+        __m256i v = _mm256_srl_epi32(cur, _mm_cvtsi32_si128(int(shift)));
+        shift += width;
+        if (shift >= 32) {
+            shift -= 32;
+            // Past the last value, there is no next word to load.
+            if (shift || k + 1 < per_lane) {
+                cur = _mm256_loadu_si256(in++);
+                if (shift)
+                    v = _mm256_or_si256(v, _mm256_sll_epi32(cur, _mm_cvtsi32_si128(int(width - shift))));
+            }
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + lanes * k), _mm256_and_si256(v, mask));
+    }
+}
+
+template <class T>
+void add_base_avx2(const std::uint32_t* in, std::size_t n, std::uint64_t base, T* out) noexcept
+{
+    std::size_t i = 0;
+    if constexpr (sizeof(T) == 4) {
+        const __m256i b = _mm256_set1_epi32(int(std::uint32_t(base)));
+        for (; i + 8 <= n; i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi32(v, b));
+        }
+    } else {
+        const __m256i b = _mm256_set1_epi64x(static_cast<long long>(base));
+        for (; i + 4 <= n; i += 4) {
+            const __m256i v = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(v, b));
+        }
+    }
+    add_base_portable(in + i, n - i, base, out + i);
+}
+
+template <class T>
+void gather_avx2(const T* dict, const std::uint32_t* in, std::size_t n, T* out) noexcept
+{
+    std::size_t i = 0;
+    if constexpr (sizeof(T) == 4) {
+        for (; i + 8 <= n; i += 8) {
+            const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                _mm256_i32gather_epi32(reinterpret_cast<const int*>(dict), idx, 4));
+        }
+    } else {
+        for (; i + 4 <= n; i += 4) {
+            const __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                _mm256_i32gather_epi64(reinterpret_cast<const long long*>(dict), idx, 8));
+        }
+    }
+    gather_portable(dict, in + i, n - i, out + i);
+}
+
+#pragma GCC pop_options
+
+#endif
+
+bool use_avx2() noexcept
+{
+#if defined(__x86_64__)
+    return active_simd_level() >= simd_level::avx2;
+#else
+    return false;
+#endif
+}
+
+[[noreturn]] void corrupt()
+{
+    throw format_error("yeni: corrupt packed column");
+}
+
+// Packed form of one page under frame-of-reference: false if its range
+// needs more than 32 bits.
+template <class T>
+bool plan_frame(const T* v, std::size_t n, page_desc& d, std::uint32_t* out) noexcept
+{
+    const auto [lo, hi] = std::minmax_element(v, v + n);
+    if (bits_t<T>(to_bits(*hi) - to_bits(*lo)) > std::numeric_limits<std::uint32_t>::max())
+        return false;
+    d.base = to_bits(*lo);
+    std::uint32_t max = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = std::uint32_t(bits_t<T>(to_bits(v[i]) - to_bits(*lo)));
+        max = std::max(max, out[i]);
+    }
+    d.width = std::uint8_t(std::bit_width(max));
+    return true;
+}
+
+// Under delta: steps are taken as signed, so an unsorted page with small
+// jumps either way packs as well as a sorted one.
+template <class T>
+bool plan_delta(const T* v, std::size_t n, page_desc& d, std::uint32_t* out) noexcept
+{
+    using U = bits_t<T>;
+    using S = std::make_signed_t<U>;
+    S lo = std::numeric_limits<S>::max(), hi = std::numeric_limits<S>::min();
+    for (std::size_t i = 1; i < n; ++i) {
+        const auto step = S(U(to_bits(v[i]) - to_bits(v[i - 1])));
+        lo = std::min(lo, step);
+        hi = std::max(hi, step);
+    }
+    if (n < 2)
+        lo = hi = 0;
+    if (U(U(hi) - U(lo)) > std::numeric_limits<std::uint32_t>::max())
+        return false;
+    d.base = to_bits(v[0]);
+    d.step = U(lo);
+    std::uint32_t max = 0;
+    out[0] = 0;
+    for (std::size_t i = 1; i < n; ++i) {
+        out[i] = std::uint32_t(U(U(to_bits(v[i]) - to_bits(v[i - 1])) - U(lo)));
+        max = std::max(max, out[i]);
+    }
+    d.width = std::uint8_t(std::bit_width(max));
+    return true;
+}
+
+} // namespace
+
+std::string_view to_string(column_encoding e) noexcept
+{
+    switch (e) {
+    case column_encoding::plain:
+        return "plain";
+    case column_encoding::frame_of_reference:
+        return "frame_of_reference";
+    case column_encoding::delta:
+        return "delta";
+    case column_encoding::dictionary:
+        return "dictionary";
+    case column_encoding::lz4:
+        return "lz4";
+    case column_encoding::zstd:
+        return "zstd";
+    case column_encoding::front_coded:
+        return "front_coded";
+    }
+    return "unknown";
+}
+
+bool zstd_supported() noexcept
+{
+    return YENI_ZSTD;
+}
+
+template <class T>
+std::vector<std::byte> encode_packed(std::span<const T> values, column_encoding e)
+{
+    using U = bits_t<T>;
+    if (!is_packed(e))
+        throw std::invalid_argument("yeni: " + std::string(to_string(e)) + " is not a packed encoding");
+    if (std::is_floating_point_v<T> && e != column_encoding::dictionary)
+        return {};
+    const std::size_t n = values.size();
+    const std::size_t pages = (n + packed_page_rows - 1) / packed_page_rows;
+    if (pages > std::numeric_limits<std::uint32_t>::max())
+        return {};
+
+    std::vector<U> dict;
+    unsigned dict_width = 0;
+    if (e == column_encoding::dictionary) {
+        dict.reserve(n);
+        for (T v : values)
+            dict.push_back(to_bits(v));
+        std::sort(dict.begin(), dict.end());
+        dict.erase(std::unique(dict.begin(), dict.end()), dict.end());
+        if (dict.size() > max_dictionary)
+            return {};
+        dict_width = dict.size() > 1 ? unsigned(std::bit_width(dict.size() - 1)) : 0;
+        // Pad to every code the width can express, so that a corrupt code
+        // still indexes inside the dictionary.
+        dict.resize(std::size_t(1) << dict_width, dict.empty() ? U(0) : dict.back());
+    }
+
+    std::vector<page_desc> descs(pages);
+    std::vector<std::uint32_t> words;
+    std::uint32_t packed[packed_page_rows];
+    for (std::size_t p = 0; p < pages; ++p) {
+        const T* v = values.data() + p * packed_page_rows;
+        const std::size_t rows = page_rows(n, p);
+        page_desc& d = descs[p];
+        bool ok = true;
+        switch (e) {
+        case column_encoding::frame_of_reference:
+            ok = plan_frame(v, rows, d, packed);
+            break;
+        case column_encoding::delta:
+            ok = plan_delta(v, rows, d, packed);
+            break;
+        default:
+            for (std::size_t i = 0; i < rows; ++i)
+                packed[i] = std::uint32_t(std::lower_bound(dict.begin(), dict.end(), to_bits(v[i])) - dict.begin());
+            d.width = std::uint8_t(dict_width);
+            break;
+        }
+        if (!ok || words.size() > std::numeric_limits<std::uint32_t>::max() - page_words(rows, d.width))
+            return {};
+        d.word_offset = std::uint32_t(words.size());
+        words.resize(words.size() + page_words(rows, d.width));
+        pack(packed, rows, d.width, words.data() + d.word_offset);
+    }
+
+    packed_header h{};
+    h.rows = n;
+    h.pages = std::uint32_t(pages);
+    h.dict_size = std::uint32_t(dict.size());
+    h.words = words.size();
+    h.width = dict_width;
+    const std::size_t dict_at = align32(sizeof(h) + pages * sizeof(page_desc));
+    const std::size_t words_at = align32(dict_at + dict.size() * sizeof(U));
+    std::vector<std::byte> out(words_at + words.size() * sizeof(std::uint32_t));
+    std::memcpy(out.data(), &h, sizeof(h));
+    if (pages)
+        std::memcpy(out.data() + sizeof(h), descs.data(), pages * sizeof(page_desc));
+    if (!dict.empty())
+        std::memcpy(out.data() + dict_at, dict.data(), dict.size() * sizeof(U));
+    if (!words.empty())
+        std::memcpy(out.data() + words_at, words.data(), words.size() * sizeof(std::uint32_t));
+    return out;
+}
+
+template <class T>
+packed_column<T>::packed_column(std::span<const std::byte> data, column_encoding e) : encoding_(e)
+{
+    if (!is_packed(e) || (std::is_floating_point_v<T> && e != column_encoding::dictionary))
+        corrupt();
+    if (data.size() < sizeof(packed_header))
+        corrupt();
+    header_ = reinterpret_cast<const packed_header*>(data.data());
+    const packed_header& h = *header_;
+    if (h.pages != (h.rows + packed_page_rows - 1) / packed_page_rows
+        || h.pages > (data.size() - sizeof(packed_header)) / sizeof(page_desc))
+        corrupt();
+    if (e == column_encoding::dictionary ? h.width > 16 || h.dict_size != 1u << h.width : h.dict_size != 0)
+        corrupt();
+    const std::size_t dict_at = align32(sizeof(packed_header) + std::size_t(h.pages) * sizeof(page_desc));
+    const std::size_t words_at = align32(dict_at + std::size_t(h.dict_size) * sizeof(T));
+    if (words_at > data.size() || h.words != (data.size() - words_at) / sizeof(std::uint32_t)
+        || (data.size() - words_at) % sizeof(std::uint32_t) != 0)
+        corrupt();
+
+    pages_ = reinterpret_cast<const page_desc*>(data.data() + sizeof(packed_header));
+    dict_ = data.data() + dict_at;
+    words_ = reinterpret_cast<const std::uint32_t*>(data.data() + words_at);
+    for (std::size_t p = 0; p < h.pages; ++p) {
+        const page_desc& d = pages_[p];
+        if (d.width > 32 || (e == column_encoding::dictionary && d.width != h.width)
+            || d.word_offset + std::uint64_t(page_words(page_rows(h.rows, p), d.width)) > h.words)
+            corrupt();
+    }
+    size_bytes_ = data.size();
+}
+
+template <class T>
+std::size_t packed_column<T>::decode_page(std::size_t page, T* out) const noexcept
+{
+    const page_desc& d = pages_[page];
+    const std::size_t n = page_rows(header_->rows, page);
+    const bool simd = use_avx2();
+    alignas(32) std::uint32_t packed[packed_page_rows];
+#if defined(__x86_64__)
+    if (simd)
+        unpack_avx2(words_ + d.word_offset, d.width, n, packed);
+    else
+#endif
+        unpack_portable(words_ + d.word_offset, d.width, n, packed);
+
+    switch (encoding_) {
+    case column_encoding::frame_of_reference:
+#if defined(__x86_64__)
+        if (simd) {
+            add_base_avx2(packed, n, d.base, out);
+            break;
+        }
+#endif
+        add_base_portable(packed, n, d.base, out);
+        break;
+    case column_encoding::delta: {
+        // A prefix sum; it does not vectorise across lanes worth the trouble.
+        using U = bits_t<T>;
+        U x = U(d.base);
+        const U step = U(d.step);
+        out[0] = T(x);
+        for (std::size_t i = 1; i < n; ++i) {
+            x += step + packed[i];
+            out[i] = T(x);
+        }
+        break;
+    }
+    default: {
+        const auto* dict = reinterpret_cast<const T*>(dict_);
+#if defined(__x86_64__)
+        if (simd) {
+            gather_avx2(dict, packed, n, out);
+            break;
+        }
+#endif
+        gather_portable(dict, packed, n, out);
+        break;
+    }
+    }
+    return n;
+}
+
+template <class T>
+void packed_column<T>::decode(std::span<T> out) const noexcept
+{
+    for (std::size_t p = 0; p < pages(); ++p)
+        decode_page(p, out.data() + p * packed_page_rows);
+}
+
+std::vector<std::byte> compress_block(std::span<const std::byte> data, column_encoding e, int zstd_level)
+{
+    std::vector<std::byte> out;
+    const general_header h{data.size(), 0};
+    switch (e) {
+    case column_encoding::lz4:
+        out.resize(sizeof(h) + detail::lz4_bound(data.size()));
+        out.resize(sizeof(h) + detail::lz4_compress(data.data(), data.size(), out.data() + sizeof(h)));
+        break;
+#if YENI_ZSTD
+    case column_encoding::zstd: {
+        out.resize(sizeof(h) + ZSTD_compressBound(data.size()));
+        const std::size_t n = ZSTD_compress(out.data() + sizeof(h), out.size() - sizeof(h), data.data(), data.size(),
+            zstd_level);
+        if (ZSTD_isError(n))
+            throw std::runtime_error(std::string("yeni: zstd: ") + ZSTD_getErrorName(n));
+        out.resize(sizeof(h) + n);
+        break;
+    }
+#endif
+    default:
+        (void)zstd_level;
+        throw std::invalid_argument("yeni: cannot compress with " + std::string(to_string(e)));
+    }
+    std::memcpy(out.data(), &h, sizeof(h));
+    return out;
+}
+
+std::size_t decompressed_size(std::span<const std::byte> block)
+{
+    general_header h;
+    if (block.size() < sizeof(h))
+        throw format_error("yeni: compressed block too short");
+    std::memcpy(&h, block.data(), sizeof(h));
+    if (h.raw_size > std::numeric_limits<std::size_t>::max() / 2)
+        throw format_error("yeni: compressed block size implausible");
+    return std::size_t(h.raw_size);
+}
+
+std::size_t max_decompressed_size(std::span<const std::byte> block, column_encoding e) noexcept
+{
+    const std::size_t payload = block.size() - std::min(block.size(), sizeof(general_header));
+    // Cannot overflow: the block lies in memory.
+    return (payload + 1) * (e == column_encoding::zstd ? 32768 : 255);
+}
+
+void decompress_block(std::span<const std::byte> block, column_encoding e, std::span<std::byte> out)
+{
+    if (decompressed_size(block) != out.size())
+        throw std::invalid_argument("yeni: decompress_block output size mismatch");
+    const std::span<const std::byte> payload = block.subspan(sizeof(general_header));
+    switch (e) {
+    case column_encoding::lz4:
+        if (!detail::lz4_decompress(payload.data(), payload.size(), out.data(), out.size()))
+            throw format_error("yeni: corrupt lz4 block");
+        return;
+#if YENI_ZSTD
+    case column_encoding::zstd: {
+        const std::size_t n = ZSTD_decompress(out.data(), out.size(), payload.data(), payload.size());
+        if (ZSTD_isError(n) || n != out.size())
+            throw format_error("yeni: corrupt zstd block");
+        return;
+    }
+#endif
+    default:
+        throw format_error("yeni: cannot decompress " + std::string(to_string(e)) + " blocks");
+    }
+}
+
+template <class T>
+column_encoding choose_encoding(std::span<const T> values, const codec_options& options)
+{
+    using U = bits_t<T>;
+    const std::size_t n = values.size();
+    if (!options.encode || n == 0)
+        return column_encoding::plain;
+
+    const std::size_t pages = (n + packed_page_rows - 1) / packed_page_rows;
+    const std::size_t want = std::clamp<std::size_t>(options.sample_rows / packed_page_rows, 1, pages);
+    std::vector<U> sample;
+    double frame_bytes = 0, delta_bytes = 0;
+    bool frame_ok = std::is_integral_v<T>, delta_ok = std::is_integral_v<T>;
+    std::uint32_t scratch[packed_page_rows];
+    for (std::size_t s = 0; s < want; ++s) {
+        const std::size_t p = s * pages / want;
+        const T* v = values.data() + p * packed_page_rows;
+        const std::size_t rows = page_rows(n, p);
+        page_desc d{};
+        if constexpr (std::is_integral_v<T>) {
+            frame_ok = frame_ok && plan_frame(v, rows, d, scratch);
+            frame_bytes += double(page_words(rows, d.width) * 4 + sizeof(page_desc));
+            delta_ok = delta_ok && plan_delta(v, rows, d, scratch);
+            delta_bytes += double(page_words(rows, d.width) * 4 + sizeof(page_desc));
+        }
+        for (std::size_t i = 0; i < rows; ++i)
+            sample.push_back(to_bits(v[i]));
+    }
+
+    const double plain = double(sample.size() * sizeof(T));
+    const double budget = plain * (1 - options.min_saving);
+    column_encoding best = column_encoding::plain;
+    double best_bytes = budget;
+    auto consider = [&](column_encoding e, double bytes) {
+        if (bytes <= best_bytes) {
+            best = e;
+            best_bytes = bytes;
+        }
+    };
+    if (frame_ok)
+        consider(column_encoding::frame_of_reference, frame_bytes);
+    if (delta_ok)
+        consider(column_encoding::delta, delta_bytes);
+
+    std::vector<U> distinct = sample;
+    std::sort(distinct.begin(), distinct.end());
+    const auto d = std::size_t(std::unique(distinct.begin(), distinct.end()) - distinct.begin());
+    // A sample mostly of distinct values says little about the column's
+    // vocabulary; assume it is too large.
+    if (d <= max_dictionary && 2 * d <= sample.size()) {
+        const unsigned width = d > 1 ? unsigned(std::bit_width(d - 1)) : 0;
+        const double dict_share = double((std::size_t(1) << width) * sizeof(T)) * double(sample.size()) / double(n);
+        consider(column_encoding::dictionary,
+            double(page_words(sample.size(), width) * 4 + want * sizeof(page_desc)) + dict_share);
+    }
+    if (best != column_encoding::plain)
+        return best;
+
+    const column_encoding general = options.general;
+    if ((general == column_encoding::lz4 || (general == column_encoding::zstd && zstd_supported()))
+        && double(compress_block(std::as_bytes(std::span(sample)), general, options.zstd_level).size()) <= budget)
+        return general;
+    return column_encoding::plain;
+}
+
+namespace {
+
+void put_varint(std::vector<std::byte>& out, std::uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(std::byte(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(std::byte(v));
+}
+
+} // namespace
+
+std::vector<std::byte> encode_front_coded(std::span<const std::byte> raw, std::size_t rows)
+{
+    if (raw.size() < (rows + 1) * sizeof(std::uint64_t))
+        throw std::invalid_argument("yeni: binary column shorter than its offsets");
+    const auto offset = [&](std::size_t i) {
+        std::uint64_t v;
+        std::memcpy(&v, raw.data() + i * sizeof(v), sizeof(v));
+        return v;
+    };
+    const std::byte* bytes = raw.data() + (rows + 1) * sizeof(std::uint64_t);
+    const std::uint64_t plain = offset(rows);
+    if (offset(0) != 0 || plain != raw.size() - (rows + 1) * sizeof(std::uint64_t))
+        throw std::invalid_argument("yeni: binary column offsets do not match its size");
+
+    const std::size_t buckets = (rows + front_coded_bucket_rows - 1) / front_coded_bucket_rows;
+    std::vector<std::uint64_t> bucket_offsets;
+    bucket_offsets.reserve(buckets + 1);
+    std::vector<std::byte> data;
+    std::span<const std::byte> prev;
+    for (std::size_t i = 0; i < rows; ++i) {
+        const std::uint64_t b = offset(i), e = offset(i + 1);
+        if (b > e || e > plain)
+            throw std::invalid_argument("yeni: binary column offsets do not match its size");
+        const std::span<const std::byte> cur(bytes + b, std::size_t(e - b));
+        std::size_t shared = 0;
+        if (i % front_coded_bucket_rows == 0) {
+            bucket_offsets.push_back(data.size());
+        } else {
+            const std::size_t n = std::min(prev.size(), cur.size());
+            shared = std::size_t(std::mismatch(cur.begin(), cur.begin() + std::ptrdiff_t(n), prev.begin()).first
+                - cur.begin());
+        }
+        put_varint(data, shared);
+        put_varint(data, cur.size() - shared);
+        data.insert(data.end(), cur.begin() + std::ptrdiff_t(shared), cur.end());
+        prev = cur;
+    }
+    bucket_offsets.push_back(data.size());
+
+    const detail::front_coded_header h{rows, buckets, data.size(), plain};
+    std::vector<std::byte> out(sizeof(h) + bucket_offsets.size() * sizeof(std::uint64_t) + data.size());
+    std::memcpy(out.data(), &h, sizeof(h));
+    std::memcpy(out.data() + sizeof(h), bucket_offsets.data(), bucket_offsets.size() * sizeof(std::uint64_t));
+    if (!data.empty())
+        std::memcpy(out.data() + sizeof(h) + bucket_offsets.size() * sizeof(std::uint64_t), data.data(), data.size());
+    return out;
+}
+
+front_coded_column::front_coded_column(std::span<const std::byte> data)
+{
+    if (data.size() < sizeof(detail::front_coded_header))
+        damaged();
+    header_ = reinterpret_cast<const detail::front_coded_header*>(data.data());
+    const auto& h = *header_;
+    const std::size_t room = data.size() - sizeof(h);
+    if (h.buckets != (h.rows + front_coded_bucket_rows - 1) / front_coded_bucket_rows
+        || h.buckets >= room / sizeof(std::uint64_t)
+        || h.data_bytes != room - (h.buckets + 1) * sizeof(std::uint64_t)
+        // No row is longer than its bucket's data.
+        || h.plain_bytes / front_coded_bucket_rows > h.data_bytes)
+        damaged();
+    offsets_ = reinterpret_cast<const std::uint64_t*>(data.data() + sizeof(h));
+    data_ = data.data() + sizeof(h) + (h.buckets + 1) * sizeof(std::uint64_t);
+    if (offsets_[0] != 0 || offsets_[h.buckets] != h.data_bytes)
+        damaged();
+    for (std::size_t b = 0; b < h.buckets; ++b)
+        if (offsets_[b] > offsets_[b + 1])
+            damaged();
+    size_bytes_ = data.size();
+}
+
+void front_coded_column::damaged()
+{
+    throw format_error("yeni: damaged front-coded column");
+}
+
+std::span<const std::byte> front_coded_column::row(std::size_t i, std::vector<std::byte>& out) const
+{
+    if (i >= size())
+        throw std::out_of_range("yeni: front-coded row out of range");
+    for_each_in_bucket(i / front_coded_bucket_rows, [&](std::size_t r, std::size_t shared, std::span<const std::byte> suffix) {
+        if (r > i)
+            return;
+        out.resize(shared);
+        out.insert(out.end(), suffix.begin(), suffix.end());
+    });
+    return out;
+}
+
+void front_coded_column::decode(std::vector<std::byte>& out) const
+{
+    const std::size_t rows = size();
+    const std::size_t offsets_bytes = (rows + 1) * sizeof(std::uint64_t);
+    out.assign(offsets_bytes, std::byte{0});
+    out.reserve(offsets_bytes + plain_bytes());
+    std::size_t prev = 0; // where the row before starts in out
+    for_each([&](std::size_t r, std::size_t shared, std::span<const std::byte> suffix) {
+        const std::size_t at = out.size();
+        if (at - offsets_bytes + shared + suffix.size() > plain_bytes())
+            damaged();
+        // Grown in place first: inserting from out itself is not allowed.
+        out.resize(at + shared);
+        std::memcpy(out.data() + at, out.data() + prev, shared);
+        out.insert(out.end(), suffix.begin(), suffix.end());
+        prev = at;
+        const std::uint64_t end = out.size() - offsets_bytes;
+        std::memcpy(out.data() + (r + 1) * sizeof(end), &end, sizeof(end));
+    });
+    if (out.size() - offsets_bytes != plain_bytes())
+        damaged();
+}
+
+#define YENI_INSTANTIATE(T)                                                                              \
+    template std::vector<std::byte> encode_packed<T>(std::span<const T>, column_encoding);             \
+    template column_encoding choose_encoding<T>(std::span<const T>, const codec_options&);             \
+    template class packed_column<T>;
+
+YENI_INSTANTIATE(std::uint32_t)
+YENI_INSTANTIATE(std::uint64_t)
+YENI_INSTANTIATE(std::int64_t)
+YENI_INSTANTIATE(double)
+
+#undef YENI_INSTANTIATE
+
+} // namespace yeni
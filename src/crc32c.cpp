@@ -0,0 +1,167 @@
+#include "yeni/crc32c.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace yeni {
+
+namespace {
+
+constexpr std::uint32_t poly = 0x82f63b78; // Castagnoli, bit-reflected
+
+using table = std::array<std::array<std::uint32_t, 256>, 8>;
+
+constexpr table make_slicing_table()
+{
+    table t{};
+    for (std::uint32_t v = 0; v < 256; ++v) {
+        std::uint32_t c = v;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? (c >> 1) ^ poly : c >> 1;
+        t[0][v] = c;
+    }
+    for (std::size_t k = 1; k < 8; ++k)
+        for (std::uint32_t v = 0; v < 256; ++v)
+            t[k][v] = (t[k - 1][v] >> 8) ^ t[0][t[k - 1][v] & 0xff];
+    return t;
+}
+
+constexpr table slicing = make_slicing_table();
+
+std::uint64_t load64(const unsigned char* p) noexcept
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// All kernels work on the raw register (no pre/post inversion).
+std::uint32_t portable(const unsigned char* p, std::size_t n, std::uint32_t c) noexcept
+{
+    // Little-endian hosts only, like the file formats that use this.
+    while (n >= 8) {
+        const std::uint64_t w = load64(p) ^ c;
+        c = slicing[7][w & 0xff] ^ slicing[6][(w >> 8) & 0xff] ^ slicing[5][(w >> 16) & 0xff]
+            ^ slicing[4][(w >> 24) & 0xff] ^ slicing[3][(w >> 32) & 0xff] ^ slicing[2][(w >> 40) & 0xff]
+            ^ slicing[1][(w >> 48) & 0xff] ^ slicing[0][w >> 56];
+        p += 8;
+        n -= 8;
+    }
+    while (n--)
+        c = slicing[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+    return c;
+}
+
+#if defined(__x86_64__)
+
+// The crc32 instruction has a latency of three cycles and a throughput of
+// one, so long inputs run three independent streams over adjacent blocks
+// and fold them together: crc(A || B) = shift_|B|(crc(A)) ^ crc(B), where
+// shift_n advances a register over n zero bytes. shift_n is linear, so it
+// is four table lookups, one per register byte.
+using shift_table = std::array<std::array<std::uint32_t, 256>, 4>;
+
+constexpr shift_table make_shift_table(std::size_t bytes)
+{
+    std::array<std::uint32_t, 32> bit{};
+    for (unsigned b = 0; b < 32; ++b) {
+        std::uint32_t c = std::uint32_t(1) << b;
+        for (std::size_t i = 0; i < bytes; ++i)
+            c = slicing[0][c & 0xff] ^ (c >> 8);
+        bit[b] = c;
+    }
+    shift_table t{};
+    for (unsigned k = 0; k < 4; ++k)
+        for (unsigned v = 0; v < 256; ++v)
+            for (unsigned b = 0; b < 8; ++b)
+                if (v >> b & 1)
+                    t[k][v] ^= bit[k * 8 + b];
+    return t;
+}
+
+constexpr std::size_t long_block = 8192;
+constexpr std::size_t short_block = 256;
+constexpr shift_table long_shift = make_shift_table(long_block);
+constexpr shift_table short_shift = make_shift_table(short_block);
+
+std::uint32_t shift(const shift_table& t, std::uint32_t c) noexcept
+{
+    return t[0][c & 0xff] ^ t[1][(c >> 8) & 0xff] ^ t[2][(c >> 16) & 0xff] ^ t[3][c >> 24];
+}
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+
+template <std::size_t Block>
+void three_way(const unsigned char*& p, std::size_t& n, std::uint32_t& c, const shift_table& t) noexcept
+{
+    while (n >= 3 * Block) {
+        std::uint64_t c0 = c, c1 = 0, c2 = 0;
+        for (const unsigned char* end = p + Block; p < end; p += 8) {
+            c0 = _mm_crc32_u64(c0, load64(p));
+            c1 = _mm_crc32_u64(c1, load64(p + Block));
+            c2 = _mm_crc32_u64(c2, load64(p + 2 * Block));
+        }
+        c = shift(t, shift(t, std::uint32_t(c0)) ^ std::uint32_t(c1)) ^ std::uint32_t(c2);
+        p += 2 * Block;
+        n -= 3 * Block;
+    }
+}
+
+std::uint32_t hardware(const unsigned char* p, std::size_t n, std::uint32_t c) noexcept
+{
+    three_way<long_block>(p, n, c, long_shift);
+    three_way<short_block>(p, n, c, short_shift);
+    std::uint64_t c64 = c;
+    for (; n >= 8; p += 8, n -= 8)
+        c64 = _mm_crc32_u64(c64, load64(p));
+    c = std::uint32_t(c64);
+    while (n--)
+        c = _mm_crc32_u8(c, *p++);
+    return c;
+}
+
+#pragma GCC pop_options
+
+#endif
+
+using kernel = std::uint32_t (*)(const unsigned char*, std::size_t, std::uint32_t) noexcept;
+
+kernel pick() noexcept
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        return &hardware;
+#endif
+    return &portable;
+}
+
+kernel active() noexcept
+{
+    static const kernel k = pick();
+    return k;
+}
+
+} // namespace
+
+std::uint32_t crc32c(std::span<const std::byte> data, std::uint32_t crc) noexcept
+{
+    return ~active()(reinterpret_cast<const unsigned char*>(data.data()), data.size(), ~crc);
+}
+
+bool crc32c_hardware() noexcept
+{
+    return active() != &portable;
+}
+
+std::uint32_t crc32c_portable(std::span<const std::byte> data, std::uint32_t crc) noexcept
+{
+    return ~portable(reinterpret_cast<const unsigned char*>(data.data()), data.size(), ~crc);
+}
+
+} // namespace yeni
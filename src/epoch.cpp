@@ -0,0 +1,163 @@
+#include "yeni/epoch.hpp"
+
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace yeni::epoch {
+
+namespace detail {
+
+std::atomic<std::uint64_t> global_epoch{1};
+
+} // namespace detail
+
+namespace {
+
+using detail::participant;
+
+struct retired {
+    void* p;
+    void (*fn)(void*) noexcept;
+    std::uint64_t epoch;
+};
+
+// Readers only ever touch their own participant. Retiring is rare (a
+// replaced version, a dropped segment, an arena), so the limbo list is a
+// plain vector under a mutex.
+struct domain {
+    static domain& instance()
+    {
+        static domain d;
+        return d;
+    }
+
+    participant* claim()
+    {
+        for (participant* p = head.load(std::memory_order_acquire); p; p = p->next) {
+            bool idle = false;
+            if (p->in_use.compare_exchange_strong(idle, true, std::memory_order_acquire))
+                return p;
+        }
+        auto* p = new participant;
+        p->in_use.store(true, std::memory_order_relaxed);
+        p->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(p->next, p, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return p;
+    }
+
+    static void release(participant* p) noexcept { p->in_use.store(false, std::memory_order_release); }
+
+    /// Move the epoch on by one if no thread is pinned in an older one.
+    bool try_advance() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t e = detail::global_epoch.load(std::memory_order_relaxed);
+        for (participant* p = head.load(std::memory_order_acquire); p; p = p->next) {
+            // Acquire: a reader's accesses happen before it unpins.
+            const std::uint64_t s = p->state.load(std::memory_order_acquire);
+            if ((s & 1) && (s >> 1) != e)
+                return false;
+        }
+        return detail::global_epoch.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+    }
+
+    void collect()
+    {
+        try_advance();
+        const std::uint64_t e = detail::global_epoch.load(std::memory_order_acquire);
+        std::vector<retired> ready;
+        {
+            std::lock_guard lock(mutex);
+            std::erase_if(limbo, [&](const retired& r) {
+                if (r.epoch + 2 > e)
+                    return false;
+                ready.push_back(r);
+                return true;
+            });
+        }
+        for (const retired& r : ready)
+            r.fn(r.p);
+    }
+
+    std::atomic<participant*> head{nullptr};
+    std::mutex mutex;
+    std::vector<retired> limbo;
+};
+
+// As in metrics.cpp: the pointer is the hot read, the holder gives the
+// participant back at thread exit.
+__attribute__((tls_model("initial-exec"))) thread_local participant* tls_participant = nullptr;
+
+struct release_holder {
+    ~release_holder()
+    {
+        if (tls_participant)
+            domain::release(std::exchange(tls_participant, nullptr));
+    }
+};
+
+} // namespace
+
+participant& detail::local() noexcept
+{
+    if (participant* p = tls_participant) [[likely]]
+        return *p;
+    thread_local release_holder holder;
+    tls_participant = domain::instance().claim();
+    return *tls_participant;
+}
+
+std::uint64_t stamp() noexcept
+{
+    // The unlink that made the object unreachable happens before this read.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return detail::global_epoch.load(std::memory_order_relaxed);
+}
+
+bool reclaimable(std::uint64_t stamp) noexcept
+{
+    auto& d = domain::instance();
+    for (int i = 0; i < 2 && detail::global_epoch.load(std::memory_order_acquire) < stamp + 2; ++i)
+        if (!d.try_advance())
+            break;
+    return detail::global_epoch.load(std::memory_order_acquire) >= stamp + 2;
+}
+
+void retire(void* p, void (*fn)(void*) noexcept)
+{
+    auto& d = domain::instance();
+    const std::uint64_t e = stamp();
+    {
+        std::lock_guard lock(d.mutex);
+        d.limbo.push_back({p, fn, e});
+    }
+    d.collect();
+}
+
+void collect()
+{
+    domain::instance().collect();
+}
+
+void synchronize()
+{
+    auto& d = domain::instance();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::uint64_t target = detail::global_epoch.load(std::memory_order_relaxed) + 2;
+    while (detail::global_epoch.load(std::memory_order_acquire) < target)
+        if (!d.try_advance())
+            std::this_thread::yield();
+    d.collect();
+}
+
+std::size_t pending()
+{
+    auto& d = domain::instance();
+    std::lock_guard lock(d.mutex);
+    return d.limbo.size();
+}
+
+} // namespace yeni::epoch
@@ -0,0 +1,449 @@
+#include "yeni/executor.hpp"
+
+#include "yeni/metrics.hpp"
+#include "yeni/numa.hpp"
+#include "yeni/scheduler.hpp"
+#include "yeni/trace.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace yeni {
+
+namespace fmt = segment_format;
+
+namespace detail {
+
+struct morsel {
+    std::size_t source;
+    std::uint64_t begin, end;
+};
+
+namespace {
+
+// Rows of one column a page at a time: in place, or decoded into the
+// caller's buffer when the column is packed.
+template <class T>
+struct column_reader {
+    const T* plain = nullptr;
+    std::optional<packed_column<T>> packed;
+
+    const T* page(std::size_t p, T* buffer) const noexcept
+    {
+        if (packed) {
+            packed->decode_page(p, buffer);
+            return buffer;
+        }
+        return plain + p * packed_page_rows;
+    }
+};
+
+using any_reader = std::variant<column_reader<std::uint32_t>, column_reader<std::uint64_t>,
+    column_reader<std::int64_t>, column_reader<double>>;
+
+template <class T>
+any_reader read_column(const segment& s, std::string_view name)
+{
+    column_reader<T> r;
+    if (const auto e = s.encoding(name); is_packed(e))
+        r.packed.emplace(s.block_data(name), e);
+    else
+        r.plain = s.column<T>(name).data();
+    return r;
+}
+
+} // namespace
+
+// A pipeline bound to its segments.
+struct bound_source {
+    const segment* seg;
+    const selection_bitmap* selection;
+    std::vector<any_reader> filters; // one per filter step
+    std::vector<any_reader> projections;
+    // Per projection, a filter over the same column whose page it reuses,
+    // or npos.
+    std::vector<std::size_t> filtered;
+    std::span<const std::byte> first_column; // locates a morsel's pages
+};
+
+struct query_state {
+    explicit query_state(const pipeline& p);
+
+    pipeline plan;
+    std::vector<bound_source> sources;
+    std::vector<std::vector<morsel>> queues; // per NUMA node
+    std::vector<std::size_t> next;           // first unclaimed of each queue
+    std::size_t total = 0;
+    std::size_t unclaimed = 0;             // under the executor's mutex
+    std::atomic<unsigned> drivers{0};      // on the query right now
+    std::atomic<std::size_t> remaining{0}; // morsels not yet run
+    std::atomic<bool> failed{false};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    static any_reader bind(const segment& s, const pipeline::column_ref& c);
+};
+
+query_state::query_state(const pipeline& p) : plan(p)
+{
+    if (!plan.sink_)
+        throw std::invalid_argument("yeni: pipeline without a sink");
+    sources.reserve(plan.sources_.size());
+    for (const scan_source& in : plan.sources_) {
+        if (!in.seg)
+            throw std::invalid_argument("yeni: pipeline source without a segment");
+        const segment& s = *in.seg;
+        if (in.selection && in.selection->size() != s.rows())
+            throw std::invalid_argument("yeni: pipeline selection of " + std::to_string(in.selection->size())
+                + " rows over " + std::to_string(s.rows()) + " rows of " + s.path().string());
+        bound_source b{&s, in.selection, {}, {}, {}, {}};
+        for (const auto& f : plan.filters_)
+            b.filters.push_back(bind(s, f.column));
+        for (const auto& c : plan.projections_) {
+            b.projections.push_back(bind(s, c));
+            const auto same = std::find_if(plan.filters_.begin(), plan.filters_.end(),
+                [&](const auto& f) { return f.column.name == c.name; });
+            b.filtered.push_back(same == plan.filters_.end() ? std::string::npos
+                                                             : std::size_t(same - plan.filters_.begin()));
+        }
+        if (!plan.filters_.empty())
+            b.first_column = s.block_data(plan.filters_.front().column.name);
+        else if (!plan.projections_.empty())
+            b.first_column = s.block_data(plan.projections_.front().name);
+        sources.push_back(std::move(b));
+    }
+}
+
+any_reader query_state::bind(const segment& s, const pipeline::column_ref& c)
+{
+    const std::string column = "pipeline column '" + c.name + "' of " + s.path().string();
+    const fmt::block_desc* d = s.find_block(c.name);
+    if (!d || d->kind != fmt::block_kind::column)
+        throw std::invalid_argument("yeni: no " + column);
+    if (d->type != c.type)
+        throw std::invalid_argument("yeni: " + column + " is not of the type the pipeline reads");
+    switch (c.type) {
+    case fmt::column_type::u32:
+        return read_column<std::uint32_t>(s, c.name);
+    case fmt::column_type::u64:
+        return read_column<std::uint64_t>(s, c.name);
+    case fmt::column_type::i64:
+        return read_column<std::int64_t>(s, c.name);
+    default:
+        return read_column<double>(s, c.name);
+    }
+}
+
+} // namespace detail
+
+namespace {
+
+constexpr std::size_t vector_words = packed_page_rows / 64;
+
+template <class T>
+T from_bits(std::uint64_t b) noexcept
+{
+    T v;
+    std::memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+// NUMA node of each page in `pages`, -1 where it is not resident:
+// move_pages(2) without libnuma, in its query form.
+std::vector<int> page_nodes(std::vector<void*>& pages)
+{
+    std::vector<int> status(pages.size(), -1);
+    if (::syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+        std::fill(status.begin(), status.end(), -1);
+    return status;
+}
+
+bool none_selected(const selection_bitmap& s, std::uint64_t begin, std::uint64_t end) noexcept
+{
+    const auto words = s.words().subspan(begin / 64, (end - begin + 63) / 64);
+    return std::all_of(words.begin(), words.end(), [](std::uint64_t w) { return w == 0; });
+}
+
+} // namespace
+
+struct query_executor::driver : task {
+    query_executor* exec;
+    unsigned slot;
+    selection_bitmap selection;
+    std::uint64_t words[vector_words];
+    // A decoded page per filter and per projection.
+    std::vector<std::uint64_t> buffer;
+    std::vector<const void*> read; // rows each filter read this vector
+    std::vector<const void*> columns;
+
+    void run_morsel(detail::query_state& q, const detail::morsel& m);
+    static const void* evaluate(const detail::any_reader& reader, const pipeline::filter_step& f, std::size_t page,
+        std::size_t n, std::uint64_t* buffer, std::uint64_t* out);
+    static const void* project(const detail::any_reader& reader, std::size_t page, std::uint64_t* buffer);
+};
+
+// Filter `f` over page `page` of its column, `n` rows, into `out`; returns
+// the rows it read.
+const void* query_executor::driver::evaluate(const detail::any_reader& reader, const pipeline::filter_step& f,
+    std::size_t page, std::size_t n, std::uint64_t* buffer, std::uint64_t* out)
+{
+    return std::visit(
+        [&]<class T>(const detail::column_reader<T>& r) -> const void* {
+            const std::span<const T> rows(r.page(page, reinterpret_cast<T*>(buffer)), n);
+            if (f.range)
+                range_rows<T>(rows, from_bits<T>(f.lo), from_bits<T>(f.hi), out);
+            else
+                compare_rows<T>(rows, f.op, from_bits<T>(f.lo), out);
+            return rows.data();
+        },
+        reader);
+}
+
+const void* query_executor::driver::project(const detail::any_reader& reader, std::size_t page,
+    std::uint64_t* buffer)
+{
+    return std::visit(
+        [&]<class T>(const detail::column_reader<T>& r) -> const void* {
+            return r.page(page, reinterpret_cast<T*>(buffer));
+        },
+        reader);
+}
+
+void query_executor::driver::run_morsel(detail::query_state& q, const detail::morsel& m)
+{
+    const detail::bound_source& src = q.sources[m.source];
+    const auto& filters = q.plan.filters_;
+    buffer.resize((filters.size() + src.projections.size()) * packed_page_rows);
+    read.resize(filters.size());
+    columns.resize(src.projections.size());
+    const trace::span span(trace::span_kind::morsel, m.end - m.begin);
+    auto& counters = metrics::local();
+    counters.add(metrics::counter::morsels);
+    counters.add(metrics::counter::scan_rows, m.end - m.begin);
+
+    for (std::uint64_t first = m.begin; first < m.end; first += packed_page_rows) {
+        // The sink of another driver threw: what is left is wasted work.
+        if (q.failed.load(std::memory_order_relaxed))
+            return;
+        const std::size_t page = std::size_t(first / packed_page_rows);
+        const std::size_t n = std::size_t(std::min<std::uint64_t>(packed_page_rows, m.end - first));
+        if (src.selection) {
+            selection.resize_for_overwrite(n);
+            const auto in = src.selection->words().subspan(std::size_t(first / 64), selection.words().size());
+            std::copy(in.begin(), in.end(), selection.words().begin());
+            selection.clear_tail();
+        } else {
+            selection.assign(n, true);
+        }
+        for (std::size_t f = 0; f < filters.size() && !selection.none(); ++f) {
+            read[f] = evaluate(src.filters[f], filters[f], page, n, buffer.data() + f * packed_page_rows, words);
+            const auto sel = selection.words();
+            for (std::size_t w = 0; w < sel.size(); ++w)
+                sel[w] &= words[w];
+        }
+        if (selection.none())
+            continue;
+        // Every filter ran: the selection would be empty otherwise.
+        for (std::size_t k = 0; k < columns.size(); ++k)
+            columns[k] = src.filtered[k] != std::string::npos
+                ? read[src.filtered[k]]
+                : project(src.projections[k], page, buffer.data() + (filters.size() + k) * packed_page_rows);
+        q.plan.sink_(row_vector{m.source, src.seg, first, n, selection, slot, columns});
+    }
+}
+
+query_executor::query_executor(executor_options options)
+    : sched_(options.sched ? *options.sched : scheduler::instance())
+    , morsel_rows_((std::max<std::size_t>(1, options.morsel_rows) + packed_page_rows - 1) / packed_page_rows
+          * packed_page_rows)
+{
+    for (const auto& n : numa_topology::system().nodes())
+        nodes_.push_back(n.id);
+    if (nodes_.empty())
+        nodes_.push_back(0);
+    const unsigned count = options.max_drivers ? options.max_drivers : std::max(1u, sched_.worker_count());
+    for (unsigned i = 0; i < count; ++i) {
+        auto d = std::make_unique<driver>();
+        d->run = [](task* t) noexcept { drive(*static_cast<driver*>(t)); };
+        d->exec = this;
+        d->slot = i;
+        drivers_.push_back(std::move(d));
+        // Popped from the back: the low slots start first.
+        idle_.push_back(count - 1 - i);
+    }
+}
+
+query_executor::~query_executor()
+{
+    sched_.wait_until([&] { return running_.load(std::memory_order_acquire) == 0; });
+}
+
+std::size_t query_executor::queue_of_node(unsigned node) const noexcept
+{
+    const auto it = std::find(nodes_.begin(), nodes_.end(), node);
+    return it == nodes_.end() ? 0 : std::size_t(it - nodes_.begin());
+}
+
+query_handle query_executor::submit(const pipeline& p)
+{
+    auto q = std::make_shared<detail::query_state>(p);
+    std::vector<detail::morsel> all;
+    for (std::size_t s = 0; s < q->sources.size(); ++s) {
+        const detail::bound_source& src = q->sources[s];
+        for (std::uint64_t b = 0; b < src.seg->rows(); b += morsel_rows_) {
+            const std::uint64_t e = std::min<std::uint64_t>(src.seg->rows(), b + morsel_rows_);
+            // Nothing selected: no need to claim it at all.
+            if (!src.selection || !none_selected(*src.selection, b, e))
+                all.push_back({s, b, e});
+        }
+    }
+
+    // Each morsel goes to the node its first column's pages are on. Pages
+    // not yet faulted in are dealt out in turn, so that the driver reading
+    // them first places them on its node.
+    const std::size_t queues = nodes_.size();
+    std::vector<int> home(all.size(), -1);
+    if (queues > 1 && !all.empty()) {
+        std::vector<void*> pages;
+        for (const auto& m : all) {
+            const auto& src = q->sources[m.source];
+            const auto at = std::uintptr_t(src.first_column.data())
+                + std::uintptr_t(src.first_column.size() * m.begin / src.seg->rows());
+            pages.push_back(reinterpret_cast<void*>(at & ~std::uintptr_t(4095)));
+        }
+        home = page_nodes(pages);
+    }
+    q->queues.resize(queues);
+    q->next.assign(queues, 0);
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        const std::size_t to = home[i] >= 0 ? queue_of_node(unsigned(home[i])) : i % queues;
+        q->queues[to].push_back(all[i]);
+    }
+    q->total = q->unclaimed = all.size();
+    q->remaining.store(all.size(), std::memory_order_relaxed);
+
+    query_handle h;
+    h.state_ = q;
+    h.sched_ = &sched_;
+    if (all.empty())
+        return h;
+    std::vector<driver*> start;
+    {
+        std::lock_guard lock(mutex_);
+        active_.push_back(q);
+        while (start.size() < all.size() && !idle_.empty()) {
+            start.push_back(drivers_[idle_.back()].get());
+            idle_.pop_back();
+        }
+        running_.fetch_add(unsigned(start.size()), std::memory_order_relaxed);
+    }
+    for (driver* d : start)
+        sched_.spawn(d);
+    return h;
+}
+
+std::shared_ptr<detail::query_state> query_executor::claim(driver& d, unsigned node, detail::morsel& m)
+{
+    std::lock_guard lock(mutex_);
+    // Morsels of a failed query are never claimed.
+    std::erase_if(active_, [](const auto& q) {
+        if (!q->failed.load(std::memory_order_relaxed))
+            return false;
+        q->remaining.fetch_sub(std::exchange(q->unclaimed, 0), std::memory_order_acq_rel);
+        return true;
+    });
+    // Fewest drivers first, oldest on a tie: a new query draws drivers
+    // away from the running ones until they are even.
+    auto best = active_.end();
+    for (auto it = active_.begin(); it != active_.end(); ++it)
+        if (best == active_.end() || (*it)->drivers.load(std::memory_order_relaxed)
+                < (*best)->drivers.load(std::memory_order_relaxed))
+            best = it;
+    if (best == active_.end()) {
+        idle_.push_back(d.slot);
+        return nullptr;
+    }
+    std::shared_ptr<detail::query_state> q = *best;
+    const std::size_t home = queue_of_node(node);
+    for (std::size_t k = 0; k < q->queues.size(); ++k) {
+        const std::size_t i = (home + k) % q->queues.size();
+        if (q->next[i] < q->queues[i].size()) {
+            m = q->queues[i][q->next[i]++];
+            if (k != 0)
+                metrics::local().add(metrics::counter::morsel_steals);
+            break;
+        }
+    }
+    q->drivers.fetch_add(1, std::memory_order_relaxed);
+    if (--q->unclaimed == 0)
+        active_.erase(best);
+    return q;
+}
+
+// One morsel per run, then the driver queues itself again: a thread that
+// picked it up while helping in wait_until() gets back to its own check
+// after a morsel, not after every query has drained, and the scheduler
+// sees each morsel boundary.
+void query_executor::drive(driver& d) noexcept
+{
+    query_executor& x = *d.exec;
+    detail::morsel m;
+    auto q = x.claim(d, x.sched_.current_node(), m);
+    if (!q) {
+        // Last touch of the executor: its destructor may return right after.
+        x.running_.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    try {
+        d.run_morsel(*q, m);
+    } catch (...) {
+        {
+            std::lock_guard lock(q->error_mutex);
+            if (!q->error)
+                q->error = std::current_exception();
+        }
+        q->failed.store(true, std::memory_order_relaxed);
+    }
+    q->drivers.fetch_sub(1, std::memory_order_relaxed);
+    q->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    q.reset();
+    x.sched_.spawn(&d);
+}
+
+bool query_handle::done() const noexcept
+{
+    return !state_ || state_->remaining.load(std::memory_order_acquire) == 0;
+}
+
+void query_handle::wait() const
+{
+    if (!state_)
+        return;
+    sched_->wait_until([&] { return done(); });
+    std::exception_ptr e;
+    {
+        std::lock_guard lock(state_->error_mutex);
+        e = state_->error;
+    }
+    if (e)
+        std::rethrow_exception(e);
+}
+
+std::size_t query_handle::morsels() const noexcept
+{
+    return state_ ? state_->total : 0;
+}
+
+unsigned query_handle::dop() const noexcept
+{
+    return state_ ? state_->drivers.load(std::memory_order_relaxed) : 0;
+}
+
+} // namespace yeni
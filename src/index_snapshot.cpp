@@ -0,0 +1,254 @@
+#include "yeni/index_snapshot.hpp"
+
+#include "yeni/crc32c.hpp"
+#include "yeni/error.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/wal.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yeni {
+
+namespace {
+
+namespace fmt = index_snapshot_format;
+
+[[noreturn]] void corrupt(const std::filesystem::path& path, const char* why)
+{
+    throw format_error("yeni: " + path.string() + ": " + why);
+}
+
+std::uint32_t header_crc(fmt::header h) noexcept
+{
+    h.crc = 0;
+    return crc32c(std::as_bytes(std::span(&h, 1)));
+}
+
+std::uint64_t align8(std::uint64_t n) noexcept
+{
+    return (n + 7) & ~std::uint64_t(7);
+}
+
+void sync_directory(const std::filesystem::path& dir)
+{
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("open " + dir.string());
+    const int r = ::fsync(fd);
+    const int e = errno;
+    ::close(fd);
+    if (r != 0) {
+        errno = e;
+        throw_errno("fsync " + dir.string());
+    }
+}
+
+struct entry {
+    std::uint64_t key;
+    std::span<const std::byte> value;
+};
+
+} // namespace
+
+index_snapshot index_snapshot::open(const std::filesystem::path& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("open " + path.string());
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const int e = errno;
+        ::close(fd);
+        errno = e;
+        throw_errno("fstat " + path.string());
+    }
+    const auto size = std::size_t(st.st_size);
+    if (size < sizeof(fmt::header)) {
+        ::close(fd);
+        corrupt(path, "too short for an index snapshot");
+    }
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    const int e = errno;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        errno = e;
+        throw_errno("mmap " + path.string());
+    }
+    // Lookups land anywhere in the slots: read-ahead would only fault in
+    // pages nobody asked for.
+    ::madvise(map, size, MADV_RANDOM);
+
+    index_snapshot s;
+    s.path_ = path;
+    s.base_ = static_cast<const std::byte*>(map);
+    s.size_ = size;
+    std::memcpy(&s.header_, s.base_, sizeof(s.header_));
+    const fmt::header& h = s.header_;
+    if (std::memcmp(h.magic, fmt::magic, sizeof(h.magic)) != 0)
+        corrupt(path, "bad index snapshot magic");
+    if (h.version != fmt::version)
+        corrupt(path, "unsupported index snapshot version");
+    if (h.crc != header_crc(h))
+        corrupt(path, "index snapshot header checksum mismatch");
+    if (h.file_size != size)
+        corrupt(path, "truncated index snapshot");
+    if (!std::has_single_bit(h.slots) || h.slots > (size - sizeof(fmt::header)) / sizeof(fmt::slot)
+        || h.entries > h.slots / 2 || h.values_offset != sizeof(fmt::header) + h.slots * sizeof(fmt::slot))
+        corrupt(path, "corrupt index snapshot header");
+    return s;
+}
+
+index_snapshot::index_snapshot(index_snapshot&& other) noexcept
+    : path_(std::move(other.path_))
+    , base_(std::exchange(other.base_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , header_(other.header_)
+{
+}
+
+index_snapshot& index_snapshot::operator=(index_snapshot&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        path_ = std::move(other.path_);
+        base_ = std::exchange(other.base_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        header_ = other.header_;
+    }
+    return *this;
+}
+
+index_snapshot::~index_snapshot()
+{
+    release();
+}
+
+void index_snapshot::release() noexcept
+{
+    if (base_)
+        ::munmap(const_cast<std::byte*>(base_), size_);
+    base_ = nullptr;
+}
+
+std::span<const std::byte> index_snapshot::value_of(const fmt::slot& s) const
+{
+    const std::uint64_t room = size_ - header_.values_offset;
+    if (s.offset > room || s.size > room - s.offset)
+        corrupt(path_, "index snapshot value out of bounds");
+    return {base_ + header_.values_offset + s.offset, s.size};
+}
+
+std::optional<std::span<const std::byte>> index_snapshot::find(std::uint64_t key) const
+{
+    const std::uint64_t mask = header_.slots - 1;
+    std::uint64_t i = mix64(key) & mask;
+    // Bounded, so that a damaged file full of used slots still ends.
+    for (std::uint64_t probes = 0; probes < header_.slots; ++probes, i = (i + 1) & mask) {
+        const fmt::slot s = slot_at(i);
+        if (!s.used)
+            return std::nullopt;
+        if (s.key == key)
+            return value_of(s);
+    }
+    return std::nullopt;
+}
+
+void write_index_snapshot(const std::filesystem::path& path, const record_store& store, std::uint64_t lsn,
+    const index_snapshot* base)
+{
+    std::vector<entry> entries;
+    entries.reserve(store.size() + (base ? base->size() : 0));
+    std::uint64_t value_bytes = 0;
+    const auto add = [&](std::uint64_t key, std::span<const std::byte> value) {
+        entries.push_back({key, value});
+        value_bytes += align8(value.size());
+    };
+    store.for_each([&](const record& r) {
+        if (store.find(r.key) == &r)
+            add(r.key, r.value());
+    });
+    if (base)
+        base->for_each([&](std::uint64_t key, std::span<const std::byte> value) {
+            if (!store.find(key))
+                add(key, value);
+        });
+
+    fmt::header h{};
+    std::memcpy(h.magic, fmt::magic, sizeof(h.magic));
+    h.version = fmt::version;
+    h.lsn = lsn;
+    h.entries = entries.size();
+    h.slots = std::bit_ceil(std::max<std::uint64_t>(16, 2 * entries.size()));
+    h.values_offset = sizeof(fmt::header) + h.slots * sizeof(fmt::slot);
+    h.file_size = h.values_offset + value_bytes;
+    h.crc = header_crc(h);
+
+    const std::filesystem::path tmp = path.string() + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw_errno("open " + tmp.string());
+    void* map = MAP_FAILED;
+    try {
+        if (::ftruncate(fd, off_t(h.file_size)) != 0)
+            throw_errno("ftruncate " + tmp.string());
+        // Filled in place: the slots are written in hash order, and free
+        // ones are the zeros ftruncate() left.
+        map = ::mmap(nullptr, h.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+            throw_errno("mmap " + tmp.string());
+        auto* out = static_cast<std::byte*>(map);
+        std::memcpy(out, &h, sizeof(h));
+        auto* slots = reinterpret_cast<fmt::slot*>(out + sizeof(fmt::header));
+        const std::uint64_t mask = h.slots - 1;
+        std::uint64_t at = 0;
+        for (const entry& e : entries) {
+            std::uint64_t i = mix64(e.key) & mask;
+            while (slots[i].used)
+                i = (i + 1) & mask;
+            slots[i] = {e.key, at, std::uint32_t(e.value.size()), 1};
+            if (!e.value.empty())
+                std::memcpy(out + h.values_offset + at, e.value.data(), e.value.size());
+            at += align8(e.value.size());
+        }
+        if (::msync(map, h.file_size, MS_SYNC) != 0)
+            throw_errno("msync " + tmp.string());
+        ::munmap(map, h.file_size);
+        map = MAP_FAILED;
+        if (::fdatasync(fd) != 0)
+            throw_errno("fdatasync " + tmp.string());
+    } catch (...) {
+        if (map != MAP_FAILED)
+            ::munmap(map, h.file_size);
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    ::close(fd);
+    if (::rename(tmp.c_str(), path.c_str()) != 0)
+        throw_errno("rename " + path.string());
+    sync_directory(path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path());
+}
+
+std::uint64_t replay_wal_tail(const std::filesystem::path& wal_dir, const index_snapshot& snapshot,
+    const std::function<void(const wal_entry&)>& apply)
+{
+    std::uint64_t last = snapshot.lsn();
+    wal_reader reader(wal_dir, last + 1);
+    wal_entry e;
+    while (reader.next(e)) {
+        apply(e);
+        last = e.lsn;
+    }
+    return last;
+}
+
+} // namespace yeni
@@ -0,0 +1,122 @@
+#include "yeni/intern.hpp"
+
+#include "yeni/segment.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace yeni {
+
+string_interner::string_interner(memory_provider& memory)
+    : memory_(memory)
+    , chunks_(std::make_unique<std::atomic<std::string_view*>[]>(max_size / chunk_size))
+{
+    stripes_.reserve(std::size_t(1) << stripe_bits);
+    for (std::size_t i = 0; i < (std::size_t(1) << stripe_bits); ++i)
+        stripes_.push_back(std::make_unique<stripe>(memory_));
+}
+
+string_interner::~string_interner()
+{
+    for (std::size_t i = 0; i < max_size / chunk_size; ++i)
+        if (std::string_view* c = chunks_[i].load(std::memory_order_relaxed))
+            memory_.deallocate(c, chunk_size * sizeof(std::string_view), alignof(std::string_view));
+}
+
+string_interner& string_interner::global()
+{
+    static string_interner table;
+    return table;
+}
+
+std::string_view* string_interner::chunk_for(std::size_t id)
+{
+    auto& slot = chunks_[id >> chunk_bits];
+    std::string_view* c = slot.load(std::memory_order_acquire);
+    if (c)
+        return c;
+    auto* fresh = static_cast<std::string_view*>(
+        memory_.allocate(chunk_size * sizeof(std::string_view), alignof(std::string_view)));
+    if (slot.compare_exchange_strong(c, fresh, std::memory_order_acq_rel))
+        return fresh;
+    // Another stripe got there first.
+    memory_.deallocate(fresh, chunk_size * sizeof(std::string_view), alignof(std::string_view));
+    return c;
+}
+
+string_id string_interner::intern(std::string_view s)
+{
+    const std::size_t h = hash<std::string_view>{}(s);
+    stripe& st = *stripes_[h >> (64 - stripe_bits)];
+    {
+        std::shared_lock lock(st.mutex);
+        if (auto it = st.map.find(s, h); it != st.map.end())
+            return it->second;
+    }
+    std::lock_guard lock(st.mutex);
+    if (auto it = st.map.find(s, h); it != st.map.end())
+        return it->second;
+
+    std::uint64_t id = next_id_.load(std::memory_order_relaxed);
+    do {
+        if (id >= max_size)
+            throw std::length_error("yeni: string_interner is full");
+    } while (!next_id_.compare_exchange_weak(id, id + 1, std::memory_order_relaxed));
+    auto* copy = static_cast<char*>(st.strings.allocate(s.size(), 1));
+    if (!s.empty())
+        std::memcpy(copy, s.data(), s.size());
+    const std::string_view stored(copy, s.size());
+    // Written before the id escapes, through the map or the return value.
+    chunk_for(std::size_t(id))[id & (chunk_size - 1)] = stored;
+    st.map.try_emplace_hashed(stored, h, string_id(id));
+    return string_id(id);
+}
+
+std::optional<string_id> string_interner::find(std::string_view s) const
+{
+    const std::size_t h = hash<std::string_view>{}(s);
+    const stripe& st = *stripes_[h >> (64 - stripe_bits)];
+    std::shared_lock lock(st.mutex);
+    if (auto it = st.map.find(s, h); it != st.map.end())
+        return it->second;
+    return std::nullopt;
+}
+
+std::size_t string_interner::bytes_reserved() const
+{
+    std::size_t n = 0;
+    for (const auto& st : stripes_) {
+        std::shared_lock lock(st->mutex);
+        n += st->strings.bytes_reserved();
+    }
+    return n;
+}
+
+std::vector<string_id> intern_column(const segment& s, std::string_view column, string_interner& interner)
+{
+    std::vector<string_id> ids;
+    ids.reserve(std::size_t(s.rows()));
+    const auto as_string = [](std::span<const std::byte> b) {
+        return std::string_view(reinterpret_cast<const char*>(b.data()), b.size());
+    };
+    if (s.encoding(column) != column_encoding::front_coded) {
+        const binary_column rows = s.binary(column);
+        for (std::size_t i = 0; i < rows.size(); ++i)
+            ids.push_back(interner.intern(as_string(rows[i])));
+        return ids;
+    }
+    std::vector<std::byte> row;
+    s.front_coded(column).for_each([&](std::size_t r, std::size_t shared, std::span<const std::byte> suffix) {
+        if (r % front_coded_bucket_rows && shared == row.size() && suffix.empty()) {
+            ids.push_back(ids.back());
+            return;
+        }
+        row.resize(shared);
+        row.insert(row.end(), suffix.begin(), suffix.end());
+        ids.push_back(interner.intern(as_string(row)));
+    });
+    return ids;
+}
+
+} // namespace yeni
@@ -0,0 +1,404 @@
+#include "yeni/io.hpp"
+
+#include "yeni/admission.hpp"
+#include "yeni/error.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace yeni {
+
+namespace {
+
+constexpr std::size_t buffer_align = 4096; // one page
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* p) noexcept
+{
+    return int(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept
+{
+    return int(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr) noexcept
+{
+    return int(::syscall(__NR_io_uring_register, fd, opcode, arg, nr));
+}
+
+std::uint32_t load_acquire(const std::uint32_t* p) noexcept
+{
+    return std::atomic_ref<const std::uint32_t>(*p).load(std::memory_order_acquire);
+}
+
+void store_release(std::uint32_t* p, std::uint32_t v) noexcept
+{
+    std::atomic_ref<std::uint32_t>(*p).store(v, std::memory_order_release);
+}
+
+} // namespace
+
+/// The three shared mappings of an io_uring instance.
+struct io_context::ring {
+    void* sq_map = MAP_FAILED;
+    std::size_t sq_map_size = 0;
+    void* cq_map = MAP_FAILED;
+    std::size_t cq_map_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqes_size = 0;
+
+    std::uint32_t* sq_head = nullptr;
+    std::uint32_t* sq_tail = nullptr;
+    std::uint32_t* sq_array = nullptr;
+    std::uint32_t sq_mask = 0;
+    std::uint32_t sq_entries = 0;
+    std::uint32_t* cq_head = nullptr;
+    std::uint32_t* cq_tail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    std::uint32_t cq_mask = 0;
+    std::uint32_t cq_entries = 0;
+
+    ~ring()
+    {
+        if (sqes != MAP_FAILED)
+            ::munmap(sqes, sqes_size);
+        if (cq_map != MAP_FAILED && cq_map != sq_map)
+            ::munmap(cq_map, cq_map_size);
+        if (sq_map != MAP_FAILED)
+            ::munmap(sq_map, sq_map_size);
+    }
+};
+
+io_context::io_context(io_options options)
+    : options_(options)
+    , queue_(std::max(64u, options.queue_depth) * 4)
+{
+    options_.queue_depth = std::max(8u, options_.queue_depth);
+    if (!options_.force_fallback && setup_ring()) {
+        setup_buffers();
+        threads_.emplace_back([this] { ring_main(); });
+        return;
+    }
+    setup_buffers();
+    const unsigned n = std::max(1u, options_.fallback_threads);
+    for (unsigned i = 0; i < n; ++i)
+        threads_.emplace_back([this] { pool_main(); });
+}
+
+io_context::~io_context()
+{
+    stop_.store(true, std::memory_order_seq_cst);
+    if (ring_fd_ >= 0) {
+        wake_armed_.store(false, std::memory_order_relaxed);
+        wake();
+    } else {
+        std::lock_guard lock(pool_mutex_);
+        pool_cv_.notify_all();
+    }
+    for (auto& t : threads_)
+        t.join();
+    ring_.reset();
+    if (ring_fd_ >= 0)
+        ::close(ring_fd_);
+    if (event_fd_ >= 0)
+        ::close(event_fd_);
+    std::free(buffer_memory_);
+}
+
+io_context& io_context::instance()
+{
+    static io_context ctx({.resume_on = &scheduler::instance()});
+    return ctx;
+}
+
+bool io_context::setup_ring()
+{
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CLAMP;
+    int fd = sys_io_uring_setup(options_.queue_depth, &p);
+    if (fd < 0)
+        return false;
+    // IORING_OP_READ/WRITE arrived with the same kernel (5.6) as this
+    // feature bit; older rings only speak readv/writev.
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        ::close(fd);
+        return false;
+    }
+
+    auto r = std::make_unique<ring>();
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(std::uint32_t);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        r->sq_map_size = r->cq_map_size = std::max(r->sq_map_size, r->cq_map_size);
+    r->sq_map = ::mmap(nullptr, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+        IORING_OFF_SQ_RING);
+    if (r->sq_map != MAP_FAILED)
+        r->cq_map = single ? r->sq_map
+                           : ::mmap(nullptr, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                 IORING_OFF_CQ_RING);
+    r->sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    if (r->cq_map != MAP_FAILED)
+        r->sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    event_fd_ = r->sqes != MAP_FAILED ? ::eventfd(0, EFD_CLOEXEC) : -1;
+    if (event_fd_ < 0) {
+        r.reset();
+        ::close(fd);
+        return false;
+    }
+
+    auto* sq = static_cast<std::byte*>(r->sq_map);
+    auto* cq = static_cast<std::byte*>(r->cq_map);
+    r->sq_head = reinterpret_cast<std::uint32_t*>(sq + p.sq_off.head);
+    r->sq_tail = reinterpret_cast<std::uint32_t*>(sq + p.sq_off.tail);
+    r->sq_array = reinterpret_cast<std::uint32_t*>(sq + p.sq_off.array);
+    r->sq_mask = *reinterpret_cast<std::uint32_t*>(sq + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->cq_head = reinterpret_cast<std::uint32_t*>(cq + p.cq_off.head);
+    r->cq_tail = reinterpret_cast<std::uint32_t*>(cq + p.cq_off.tail);
+    r->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    r->cq_mask = *reinterpret_cast<std::uint32_t*>(cq + p.cq_off.ring_mask);
+    r->cq_entries = p.cq_entries;
+
+    ring_ = std::move(r);
+    ring_fd_ = fd;
+    return true;
+}
+
+void io_context::setup_buffers()
+{
+    if (options_.buffers == 0)
+        return;
+    options_.buffers = std::min(options_.buffers, 1u << 16);
+    options_.buffer_size = (std::max<std::size_t>(options_.buffer_size, 1) + buffer_align - 1) & ~(buffer_align - 1);
+    buffer_memory_ = static_cast<std::byte*>(std::aligned_alloc(buffer_align, options_.buffers * options_.buffer_size));
+    if (!buffer_memory_)
+        throw std::bad_alloc();
+    free_buffers_.reserve(options_.buffers);
+    for (unsigned i = options_.buffers; i-- > 0;)
+        free_buffers_.push_back(std::uint16_t(i));
+
+    if (ring_fd_ < 0)
+        return;
+    std::vector<iovec> iov(options_.buffers);
+    for (unsigned i = 0; i < options_.buffers; ++i)
+        iov[i] = {buffer_memory_ + std::size_t(i) * options_.buffer_size, options_.buffer_size};
+    // Registration pins the pages and fails under a low RLIMIT_MEMLOCK;
+    // fixed ops then quietly become plain ones.
+    buffers_registered_ = sys_io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iov.data(), options_.buffers) == 0;
+}
+
+std::optional<io_buffer> io_context::try_acquire_buffer()
+{
+    std::lock_guard lock(buffers_mutex_);
+    if (free_buffers_.empty())
+        return std::nullopt;
+    const std::uint16_t i = free_buffers_.back();
+    free_buffers_.pop_back();
+    return io_buffer{buffer_memory_ + std::size_t(i) * options_.buffer_size, options_.buffer_size, i};
+}
+
+void io_context::release_buffer(const io_buffer& b)
+{
+    std::lock_guard lock(buffers_mutex_);
+    free_buffers_.push_back(b.index);
+}
+
+void io_context::submit(std::span<io_request* const> requests)
+{
+    if (requests.empty())
+        return;
+    if (options_.delay) {
+        const std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        for (io_request* r : requests)
+            r->queued_at = now;
+    }
+    if (ring_fd_ >= 0) {
+        for (io_request* r : requests) {
+            // The completion thread sleeps until woken, so kick it before
+            // waiting for it to drain a full queue.
+            if (!queue_.try_push(r)) {
+                wake();
+                queue_.push(r);
+            }
+        }
+        wake();
+        return;
+    }
+    {
+        std::lock_guard lock(pool_mutex_);
+        pool_queue_.insert(pool_queue_.end(), requests.begin(), requests.end());
+    }
+    if (requests.size() == 1)
+        pool_cv_.notify_one();
+    else
+        pool_cv_.notify_all();
+}
+
+void io_context::wake()
+{
+    // The completion thread clears the flag with an exchange before it
+    // drains the queue, so either it sees our pushes or we see the flag
+    // cleared and kick the eventfd.
+    if (!wake_armed_.exchange(true, std::memory_order_acq_rel)) {
+        const std::uint64_t one = 1;
+        while (::write(event_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void io_context::ring_main()
+{
+    ring& rg = *ring_;
+    std::uint64_t wake_value = 0;
+    io_request wake_read{io_request::op::read, 0, event_fd_, &wake_value, sizeof(wake_value), 0, 0, nullptr};
+    bool arm_wake = true;
+    std::deque<io_request*> backlog;
+    std::size_t in_flight = 0;   // user requests in the kernel
+    std::uint32_t unsubmitted = 0; // SQEs queued but not yet consumed by the kernel
+    io_request* batch[64];
+
+    auto prep = [&](io_request* r) {
+        const std::uint32_t tail = *rg.sq_tail;
+        const std::uint32_t idx = tail & rg.sq_mask;
+        io_uring_sqe& s = rg.sqes[idx];
+        std::memset(&s, 0, sizeof(s));
+        s.fd = r->fd;
+        s.addr = reinterpret_cast<std::uint64_t>(r->data);
+        s.len = r->size;
+        s.off = r->offset;
+        s.user_data = reinterpret_cast<std::uint64_t>(r);
+        switch (r->opcode) {
+        case io_request::op::read:
+            s.opcode = IORING_OP_READ;
+            break;
+        case io_request::op::write:
+            s.opcode = IORING_OP_WRITE;
+            break;
+        case io_request::op::read_fixed:
+            s.opcode = buffers_registered_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            s.buf_index = r->buffer_index;
+            break;
+        case io_request::op::write_fixed:
+            s.opcode = buffers_registered_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+            s.buf_index = r->buffer_index;
+            break;
+        case io_request::op::fsync:
+        case io_request::op::fdatasync:
+            s.opcode = IORING_OP_FSYNC;
+            s.addr = 0;
+            s.len = 0;
+            s.fsync_flags = r->opcode == io_request::op::fdatasync ? IORING_FSYNC_DATASYNC : 0;
+            break;
+        }
+        rg.sq_array[idx] = idx;
+        store_release(rg.sq_tail, tail + 1);
+        ++unsubmitted;
+    };
+
+    while (true) {
+        while (std::size_t n = queue_.try_pop_batch(batch))
+            backlog.insert(backlog.end(), batch, batch + n);
+        if (stop_.load(std::memory_order_acquire) && backlog.empty() && in_flight == 0 && unsubmitted == 0)
+            break;
+
+        std::uint32_t free_sqes = rg.sq_entries - (*rg.sq_tail - load_acquire(rg.sq_head));
+        if (arm_wake && free_sqes) {
+            prep(&wake_read);
+            arm_wake = false;
+            --free_sqes;
+        }
+        // One CQ slot stays reserved for the eventfd read.
+        const auto now = options_.delay ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        while (!backlog.empty() && free_sqes && in_flight + 1 < rg.cq_entries) {
+            if (options_.delay)
+                observe_delay(*backlog.front(), now);
+            prep(backlog.front());
+            backlog.pop_front();
+            ++in_flight;
+            --free_sqes;
+        }
+
+        const int ret = sys_io_uring_enter(ring_fd_, unsubmitted, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            std::abort(); // the ring itself is broken; no way to report per request
+        if (ret > 0)
+            unsubmitted -= std::min(unsubmitted, std::uint32_t(ret));
+
+        std::uint32_t head = *rg.cq_head;
+        const std::uint32_t tail = load_acquire(rg.cq_tail);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& c = rg.cqes[head & rg.cq_mask];
+            auto* r = reinterpret_cast<io_request*>(c.user_data);
+            r->result = c.res;
+            if (r == &wake_read) {
+                wake_armed_.exchange(false, std::memory_order_acq_rel);
+                arm_wake = true;
+                continue;
+            }
+            --in_flight;
+            r->complete(r);
+        }
+        store_release(rg.cq_head, head);
+    }
+}
+
+void io_context::pool_main()
+{
+    while (true) {
+        io_request* r;
+        {
+            std::unique_lock lock(pool_mutex_);
+            pool_cv_.wait(lock, [&] { return stop_.load(std::memory_order_relaxed) || !pool_queue_.empty(); });
+            if (pool_queue_.empty())
+                return;
+            r = pool_queue_.front();
+            pool_queue_.pop_front();
+        }
+        if (options_.delay)
+            observe_delay(*r, std::chrono::steady_clock::now());
+        execute(*r);
+        r->complete(r);
+    }
+}
+
+void io_context::observe_delay(const io_request& r, std::chrono::steady_clock::time_point now) noexcept
+{
+    options_.delay->observe(std::chrono::nanoseconds(now.time_since_epoch().count() - r.queued_at), now);
+}
+
+void io_context::execute(io_request& r) noexcept
+{
+    ssize_t ret;
+    do {
+        switch (r.opcode) {
+        case io_request::op::read:
+        case io_request::op::read_fixed:
+            ret = ::pread(r.fd, r.data, r.size, off_t(r.offset));
+            break;
+        case io_request::op::write:
+        case io_request::op::write_fixed:
+            ret = ::pwrite(r.fd, r.data, r.size, off_t(r.offset));
+            break;
+        case io_request::op::fsync:
+            ret = ::fsync(r.fd);
+            break;
+        default:
+            ret = ::fdatasync(r.fd);
+            break;
+        }
+    } while (ret < 0 && errno == EINTR);
+    r.result = ret < 0 ? -std::int64_t(errno) : std::int64_t(ret);
+}
+
+} // namespace yeni
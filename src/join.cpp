@@ -0,0 +1,671 @@
+#include "yeni/join.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/scheduler.hpp"
+#include "yeni/segment.hpp"
+#include "yeni/selection.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace yeni {
+
+namespace fmt = segment_format;
+
+namespace {
+
+// Key and row of one selected input row. Keys are widened to u64 so that
+// one code path serves every key type; i64 keys get their sign bit
+// flipped on the way, which keeps their numeric order.
+struct tuple {
+    std::uint64_t key;
+    std::uint32_t row;
+};
+
+// Build-side tuples per radix partition: with its table, ~100 KiB, so a
+// partition is built and probed in L2.
+constexpr std::size_t radix_target = 4096;
+// A scatter with more write cursors than this thrashes the TLB.
+constexpr unsigned max_radix_bits = 10;
+// Inputs smaller than this are partitioned by a single task.
+constexpr std::size_t min_chunk_tuples = 1 << 14;
+constexpr std::size_t max_spill_partitions = 1024;
+
+template <class T>
+std::uint64_t widen(T v) noexcept
+{
+    if constexpr (std::is_signed_v<T>)
+        return std::uint64_t(v) ^ (std::uint64_t(1) << 63);
+    else
+        return v;
+}
+
+std::size_t worker_slots(const scheduler& sched) noexcept
+{
+    return std::max(1u, sched.worker_count());
+}
+
+// A checked join_input.
+struct side {
+    const segment& seg;
+    std::string_view key;
+    const selection_bitmap* selection;
+    fmt::column_type type;
+    std::size_t selected;
+
+    template <class F>
+    void with_type(F&& f) const
+    {
+        switch (type) {
+        case fmt::column_type::u32:
+            f(std::type_identity<std::uint32_t>{});
+            break;
+        case fmt::column_type::u64:
+            f(std::type_identity<std::uint64_t>{});
+            break;
+        default:
+            f(std::type_identity<std::int64_t>{});
+            break;
+        }
+    }
+};
+
+side check_input(const join_input& in)
+{
+    if (!in.seg)
+        throw std::invalid_argument("yeni: join input without a segment");
+    const segment& s = *in.seg;
+    const std::string column = "join key column '" + std::string(in.key) + "' of " + s.path().string();
+    const fmt::block_desc* d = s.find_block(in.key);
+    if (!d || d->kind != fmt::block_kind::column)
+        throw std::invalid_argument("yeni: no " + column);
+    if (d->type != fmt::column_type::u32 && d->type != fmt::column_type::u64 && d->type != fmt::column_type::i64)
+        throw std::invalid_argument("yeni: " + column + " is not an integer column");
+    if (s.rows() > std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("yeni: join input " + s.path().string() + " has more than 2^32 rows");
+    if (in.selection && in.selection->size() != s.rows())
+        throw std::invalid_argument("yeni: join selection of " + std::to_string(in.selection->size())
+            + " rows over " + std::to_string(s.rows()) + " rows of " + s.path().string());
+    return {s, in.key, in.selection, d->type, in.selection ? in.selection->count() : std::size_t(s.rows())};
+}
+
+std::pair<side, side> check_inputs(const join_input& left, const join_input& right)
+{
+    side l = check_input(left), r = check_input(right);
+    if ((l.type == fmt::column_type::i64) != (r.type == fmt::column_type::i64))
+        throw std::invalid_argument("yeni: join of a signed and an unsigned key column");
+    return {l, r};
+}
+
+// Tuples of every selected row of `in`, in row order. Each task takes a
+// run of bitmap words; a first pass counts their rows so that the tasks
+// know where to write.
+std::vector<tuple> gather(const side& in, scheduler& sched)
+{
+    std::vector<tuple> out(in.selected);
+    in.with_type([&]<class T>(std::type_identity<T>) {
+        const std::span<const T> keys = in.seg.column<T>(in.key);
+        if (!in.selection) {
+            sched.parallel_for(0, keys.size(), 0, [&](std::size_t b, std::size_t e) {
+                for (std::size_t i = b; i < e; ++i)
+                    out[i] = {widen(keys[i]), std::uint32_t(i)};
+            });
+            return;
+        }
+        const std::span<const std::uint64_t> words = in.selection->words();
+        const std::size_t grain = std::max<std::size_t>(256, words.size() / (worker_slots(sched) * 8));
+        const std::size_t chunks = (words.size() + grain - 1) / grain;
+        std::vector<std::size_t> start(chunks + 1);
+        sched.parallel_for(0, chunks, 1, [&](std::size_t b, std::size_t e) {
+            for (std::size_t c = b; c < e; ++c) {
+                std::size_t n = 0;
+                for (std::size_t w = c * grain; w < std::min(words.size(), (c + 1) * grain); ++w)
+                    n += std::size_t(std::popcount(words[w]));
+                start[c + 1] = n;
+            }
+        });
+        for (std::size_t c = 0; c < chunks; ++c)
+            start[c + 1] += start[c];
+        sched.parallel_for(0, chunks, 1, [&](std::size_t b, std::size_t e) {
+            for (std::size_t c = b; c < e; ++c) {
+                std::size_t at = start[c];
+                for (std::size_t w = c * grain; w < std::min(words.size(), (c + 1) * grain); ++w) {
+                    for (std::uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                        const std::size_t row = w * 64 + std::size_t(std::countr_zero(bits));
+                        out[at++] = {widen(keys[row]), std::uint32_t(row)};
+                    }
+                }
+            }
+        });
+    });
+    return out;
+}
+
+// Tuples grouped by partition: partition p is data[bounds[p], bounds[p + 1]).
+struct partitioned {
+    std::vector<tuple> data;
+    std::vector<std::size_t> bounds;
+
+    std::span<tuple> part(std::size_t p) noexcept { return {data.data() + bounds[p], bounds[p + 1] - bounds[p]}; }
+};
+
+// Scatter `in` into `parts` partitions by `part_of(key)`. Each chunk of the
+// input counts its tuples per partition, a prefix sum over (partition,
+// chunk) turns the counts into private write cursors, and the chunks then
+// scatter in parallel, sharing cache lines only at the edges of their
+// slices. Tuples keep their input order within a partition.
+template <class PartOf>
+partitioned partition(std::span<const tuple> in, std::size_t parts, const PartOf& part_of, scheduler& sched)
+{
+    const std::size_t chunks = std::clamp<std::size_t>(in.size() / min_chunk_tuples, 1, worker_slots(sched) * 4);
+    const std::size_t per = (in.size() + chunks - 1) / chunks;
+    const auto chunk = [&](std::size_t c) {
+        const std::size_t b = std::min(in.size(), c * per);
+        return in.subspan(b, std::min(per, in.size() - b));
+    };
+    std::vector<std::size_t> cursor(chunks * parts);
+    sched.parallel_for(0, chunks, 1, [&](std::size_t b, std::size_t e) {
+        for (std::size_t c = b; c < e; ++c) {
+            std::size_t* count = cursor.data() + c * parts;
+            for (const tuple& t : chunk(c))
+                ++count[part_of(t.key)];
+        }
+    });
+    partitioned out{std::vector<tuple>(in.size()), std::vector<std::size_t>(parts + 1)};
+    std::size_t at = 0;
+    for (std::size_t p = 0; p < parts; ++p) {
+        out.bounds[p] = at;
+        for (std::size_t c = 0; c < chunks; ++c)
+            at += std::exchange(cursor[c * parts + p], at);
+    }
+    out.bounds[parts] = at;
+    sched.parallel_for(0, chunks, 1, [&](std::size_t b, std::size_t e) {
+        for (std::size_t c = b; c < e; ++c) {
+            std::size_t* next = cursor.data() + c * parts;
+            for (const tuple& t : chunk(c))
+                out.data[next[part_of(t.key)]++] = t;
+        }
+    });
+    return out;
+}
+
+// Collects one task's matches into sink-sized batches.
+class emitter {
+public:
+    emitter(const join_sink& sink, std::size_t batch)
+        : sink_(sink)
+        , batch_(std::max<std::size_t>(1, batch))
+    {
+        left_.reserve(batch_);
+        right_.reserve(batch_);
+    }
+
+    void add(std::uint32_t left, std::uint32_t right)
+    {
+        left_.push_back(left);
+        right_.push_back(right);
+        if (left_.size() == batch_)
+            flush();
+    }
+
+    void flush()
+    {
+        if (left_.empty())
+            return;
+        sink_(left_, right_);
+        matches_ += left_.size();
+        left_.clear();
+        right_.clear();
+    }
+
+    std::uint64_t matches() const noexcept { return matches_; }
+
+private:
+    const join_sink& sink_;
+    std::size_t batch_;
+    std::vector<std::uint32_t> left_, right_;
+    std::uint64_t matches_ = 0;
+};
+
+// Shared by the tasks of one join.
+struct join_context {
+    const join_sink& sink;
+    const join_options& options;
+    scheduler& sched;
+    std::atomic<std::uint64_t> matches{0};
+};
+
+// ---------------------------------------------------------------------------
+// Radix hash join.
+
+// Linear-probing table of `build` (positions + 1, 0 for empty) on the
+// low bits of the hash, which the partitioning left alone. Duplicates of
+// a key share a run.
+void build_table(std::span<const tuple> build, std::vector<std::uint32_t>& table)
+{
+    const std::size_t mask = std::bit_ceil(build.size() * 2) - 1;
+    table.assign(mask + 1, 0);
+    for (std::size_t i = 0; i < build.size(); ++i) {
+        std::size_t s = std::size_t(mix64(build[i].key)) & mask;
+        while (table[s])
+            s = (s + 1) & mask;
+        table[s] = std::uint32_t(i + 1);
+    }
+}
+
+void probe_table(std::span<const tuple> build, std::span<const std::uint32_t> table, std::span<const tuple> probe,
+    bool build_is_left, emitter& out)
+{
+    const std::size_t mask = table.size() - 1;
+    for (const tuple& t : probe) {
+        for (std::size_t s = std::size_t(mix64(t.key)) & mask; table[s]; s = (s + 1) & mask) {
+            const tuple& b = build[table[s] - 1];
+            if (b.key != t.key)
+                continue;
+            if (build_is_left)
+                out.add(b.row, t.row);
+            else
+                out.add(t.row, b.row);
+        }
+    }
+}
+
+// Join tuples whose hashes already agree in their top `fixed_bits` (the
+// spill partition they came from).
+void radix_join(std::span<const tuple> left, std::span<const tuple> right, unsigned fixed_bits, join_context& ctx)
+{
+    if (left.empty() || right.empty())
+        return;
+    const bool build_is_left = left.size() <= right.size();
+    const std::span<const tuple> build = build_is_left ? left : right, probe = build_is_left ? right : left;
+    unsigned bits = 0;
+    while (bits < max_radix_bits && (build.size() >> bits) > radix_target)
+        ++bits;
+    if (bits == 0) {
+        // The build side fits in cache as it is: one table, probed in
+        // parallel.
+        std::vector<std::uint32_t> table;
+        build_table(build, table);
+        const std::size_t grain = std::max(min_chunk_tuples, probe.size() / (worker_slots(ctx.sched) * 4));
+        ctx.sched.parallel_for(0, probe.size(), grain, [&](std::size_t first, std::size_t last) {
+            emitter out(ctx.sink, ctx.options.batch_rows);
+            probe_table(build, table, probe.subspan(first, last - first), build_is_left, out);
+            out.flush();
+            ctx.matches.fetch_add(out.matches(), std::memory_order_relaxed);
+        });
+        return;
+    }
+    const unsigned shift = 64 - fixed_bits - bits;
+    const std::uint64_t mask = (std::uint64_t(1) << bits) - 1;
+    const auto part_of = [shift, mask](std::uint64_t key) { return std::size_t((mix64(key) >> shift) & mask); };
+
+    const std::size_t parts = std::size_t(1) << bits;
+    partitioned b = partition(build, parts, part_of, ctx.sched);
+    partitioned p = partition(probe, parts, part_of, ctx.sched);
+    ctx.sched.parallel_for(0, parts, 0, [&](std::size_t first, std::size_t last) {
+        emitter out(ctx.sink, ctx.options.batch_rows);
+        std::vector<std::uint32_t> table;
+        for (std::size_t i = first; i < last; ++i) {
+            if (b.part(i).empty() || p.part(i).empty())
+                continue;
+            build_table(b.part(i), table);
+            probe_table(b.part(i), table, p.part(i), build_is_left, out);
+        }
+        out.flush();
+        ctx.matches.fetch_add(out.matches(), std::memory_order_relaxed);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Sort-merge join.
+
+// Up to `parts - 1` distinct splitters cutting `sample` into even ranges.
+// A key equal to a splitter goes to the range above it, so each key falls
+// into exactly one range.
+std::vector<std::uint64_t> splitters(std::vector<std::uint64_t> sample, std::size_t parts)
+{
+    std::sort(sample.begin(), sample.end());
+    std::vector<std::uint64_t> out;
+    for (std::size_t i = 1; i < parts && !sample.empty(); ++i) {
+        const std::uint64_t k = sample[i * sample.size() / parts];
+        if (out.empty() || k > out.back())
+            out.push_back(k);
+    }
+    return out;
+}
+
+std::size_t range_of(std::span<const std::uint64_t> splitters, std::uint64_t key) noexcept
+{
+    return std::size_t(std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin());
+}
+
+bool tuple_less(const tuple& a, const tuple& b) noexcept
+{
+    return a.key < b.key || (a.key == b.key && a.row < b.row);
+}
+
+void merge(std::span<const tuple> l, std::span<const tuple> r, emitter& out)
+{
+    std::size_t i = 0, j = 0;
+    while (i < l.size() && j < r.size()) {
+        if (l[i].key < r[j].key) {
+            ++i;
+        } else if (r[j].key < l[i].key) {
+            ++j;
+        } else {
+            const std::uint64_t key = l[i].key;
+            std::size_t run = j;
+            while (run < r.size() && r[run].key == key)
+                ++run;
+            for (; i < l.size() && l[i].key == key; ++i)
+                for (std::size_t x = j; x < run; ++x)
+                    out.add(l[i].row, r[x].row);
+            j = run;
+        }
+    }
+}
+
+// Range-partition both sides on splitters sampled from them, then sort
+// and merge each range as its own task.
+void merge_join(std::span<const tuple> left, std::span<const tuple> right, join_context& ctx)
+{
+    if (left.empty() || right.empty())
+        return;
+    const std::size_t total = left.size() + right.size();
+    const std::size_t ranges = std::clamp<std::size_t>(total / min_chunk_tuples, 1, worker_slots(ctx.sched) * 4);
+    std::vector<std::uint64_t> sample;
+    const std::size_t stride = std::max<std::size_t>(1, total / (ranges * 64));
+    for (std::size_t i = 0; i < left.size(); i += stride)
+        sample.push_back(left[i].key);
+    for (std::size_t i = 0; i < right.size(); i += stride)
+        sample.push_back(right[i].key);
+    const std::vector<std::uint64_t> split = splitters(std::move(sample), ranges);
+    const auto part_of = [&split](std::uint64_t key) { return range_of(split, key); };
+
+    const std::size_t parts = split.size() + 1;
+    partitioned l = partition(left, parts, part_of, ctx.sched);
+    partitioned r = partition(right, parts, part_of, ctx.sched);
+    ctx.sched.parallel_for(0, parts, 1, [&](std::size_t first, std::size_t last) {
+        emitter out(ctx.sink, ctx.options.batch_rows);
+        for (std::size_t i = first; i < last; ++i) {
+            const std::span<tuple> a = l.part(i), b = r.part(i);
+            if (a.empty() || b.empty())
+                continue;
+            std::sort(a.begin(), a.end(), tuple_less);
+            std::sort(b.begin(), b.end(), tuple_less);
+            merge(a, b, out);
+        }
+        out.flush();
+        ctx.matches.fetch_add(out.matches(), std::memory_order_relaxed);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Spilling.
+
+int open_spill_file(const std::filesystem::path& dir)
+{
+    int fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0)
+        return fd;
+    if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+        throw_errno("open spill file in " + dir.string());
+    std::string name = (dir / "yeni-join-XXXXXX").string();
+    fd = ::mkostemp(name.data(), O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("create spill file in " + dir.string());
+    ::unlink(name.c_str());
+    return fd;
+}
+
+// One side's tuples split over anonymous temporary files, one per
+// partition, each appended to through its own buffer. Only partitions
+// that receive tuples get a file.
+class spill_set {
+public:
+    spill_set(std::filesystem::path dir, std::size_t parts, std::size_t buffer_tuples)
+        : dir_(std::move(dir))
+        , files_(parts)
+        , buffer_tuples_(buffer_tuples)
+    {
+    }
+
+    ~spill_set()
+    {
+        for (const file& f : files_)
+            if (f.fd >= 0)
+                ::close(f.fd);
+    }
+
+    spill_set(const spill_set&) = delete;
+    spill_set& operator=(const spill_set&) = delete;
+
+    void add(std::size_t part, const tuple& t)
+    {
+        file& f = files_[part];
+        if (f.buffer.capacity() == 0)
+            f.buffer.reserve(buffer_tuples_);
+        f.buffer.push_back(t);
+        if (f.buffer.size() == buffer_tuples_)
+            flush(f);
+    }
+
+    /// Write out and drop every buffer.
+    void finish()
+    {
+        for (file& f : files_) {
+            flush(f);
+            f.buffer = {};
+        }
+    }
+
+    /// Partition `part`, read back; its file is closed, freeing the space.
+    std::vector<tuple> take(std::size_t part)
+    {
+        file& f = files_[part];
+        std::vector<tuple> out(f.size / sizeof(tuple));
+        auto* p = reinterpret_cast<std::byte*>(out.data());
+        for (std::uint64_t at = 0; at < f.size;) {
+            const ssize_t r = ::pread(f.fd, p + at, std::size_t(f.size - at), off_t(at));
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw_errno("read spill file");
+            }
+            if (r == 0)
+                throw format_error("yeni: spill file truncated");
+            at += std::uint64_t(r);
+        }
+        if (f.fd >= 0)
+            ::close(std::exchange(f.fd, -1));
+        return out;
+    }
+
+    std::uint64_t bytes() const noexcept { return bytes_; }
+
+private:
+    struct file {
+        int fd = -1;
+        std::uint64_t size = 0;
+        std::vector<tuple> buffer;
+    };
+
+    void flush(file& f)
+    {
+        if (f.buffer.empty())
+            return;
+        if (f.fd < 0)
+            f.fd = open_spill_file(dir_);
+        const auto* p = reinterpret_cast<const std::byte*>(f.buffer.data());
+        std::size_t n = f.buffer.size() * sizeof(tuple);
+        while (n) {
+            const ssize_t w = ::write(f.fd, p, n);
+            if (w < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw_errno("write spill file in " + dir_.string());
+            }
+            p += w;
+            n -= std::size_t(w);
+            f.size += std::uint64_t(w);
+            bytes_ += std::uint64_t(w);
+        }
+        f.buffer.clear();
+    }
+
+    std::filesystem::path dir_;
+    std::vector<file> files_;
+    std::size_t buffer_tuples_;
+    std::uint64_t bytes_ = 0;
+};
+
+// Spill partitions a join needs to stay within budget, or 0 when it fits
+// in memory: twice the estimate over the budget, so that a partition pair
+// still fits with the hash skewed somewhat.
+std::size_t spill_partitions(const side& l, const side& r, const join_options& o) noexcept
+{
+    const std::uint64_t need = 2 * sizeof(tuple) * (std::uint64_t(l.selected) + r.selected);
+    const std::uint64_t budget = std::max<std::size_t>(o.memory_budget, 1);
+    if (need <= budget)
+        return 0;
+    return std::size_t(std::bit_ceil(std::clamp<std::uint64_t>((need + budget - 1) / budget * 2, 2,
+        max_spill_partitions)));
+}
+
+// Write buffer per partition: a quarter of the budget over both sides.
+std::size_t spill_buffer_tuples(const join_options& o, std::size_t parts) noexcept
+{
+    return std::clamp<std::size_t>(o.memory_budget / (4 * parts * sizeof(tuple)), 256, 65536);
+}
+
+std::filesystem::path spill_dir(const join_options& o)
+{
+    return o.spill_dir.empty() ? std::filesystem::temp_directory_path() : o.spill_dir;
+}
+
+// Stream the selected tuples of `in` into `out`, a page of the key column
+// at a time, so that an encoded column is never decoded whole.
+template <class PartOf>
+void spill(const side& in, spill_set& out, const PartOf& part_of)
+{
+    in.with_type([&]<class T>(std::type_identity<T>) {
+        in.seg.scan<T>(in.key, [&](std::size_t first, std::span<const T> page) {
+            for (std::size_t i = 0; i < page.size(); ++i) {
+                const std::size_t row = first + i;
+                if (in.selection && !in.selection->test(row))
+                    continue;
+                const std::uint64_t key = widen(page[i]);
+                out.add(part_of(key), {key, std::uint32_t(row)});
+            }
+        });
+    });
+    out.finish();
+}
+
+// Every `stride`-th selected key of `in`.
+void sample_keys(const side& in, std::size_t stride, std::vector<std::uint64_t>& out)
+{
+    std::size_t seen = 0;
+    in.with_type([&]<class T>(std::type_identity<T>) {
+        in.seg.scan<T>(in.key, [&](std::size_t first, std::span<const T> page) {
+            for (std::size_t i = 0; i < page.size(); ++i)
+                if ((!in.selection || in.selection->test(first + i)) && seen++ % stride == 0)
+                    out.push_back(widen(page[i]));
+        });
+    });
+}
+
+join_stats finish(join_context& ctx, join_stats stats)
+{
+    stats.matches = ctx.matches.load(std::memory_order_relaxed);
+    metrics::local().add(metrics::counter::join_matches, stats.matches);
+    metrics::local().add(metrics::counter::join_spill_bytes, stats.spill_bytes);
+    return stats;
+}
+
+} // namespace
+
+join_stats radix_hash_join(const join_input& left, const join_input& right, const join_sink& sink,
+    const join_options& options)
+{
+    const auto [l, r] = check_inputs(left, right);
+    join_context ctx{sink, options, options.sched ? *options.sched : scheduler::instance()};
+    join_stats stats;
+    if (!l.selected || !r.selected)
+        return finish(ctx, stats);
+
+    const std::size_t parts = spill_partitions(l, r, options);
+    if (!parts) {
+        const std::vector<tuple> lt = gather(l, ctx.sched), rt = gather(r, ctx.sched);
+        radix_join(lt, rt, 0, ctx);
+        return finish(ctx, stats);
+    }
+    // Grace partitioning on the top hash bits; radix_join() carries on
+    // with the bits below them.
+    const unsigned bits = unsigned(std::countr_zero(parts));
+    const auto part_of = [bits](std::uint64_t key) { return std::size_t(mix64(key) >> (64 - bits)); };
+    spill_set ls(spill_dir(options), parts, spill_buffer_tuples(options, parts));
+    spill_set rs(spill_dir(options), parts, spill_buffer_tuples(options, parts));
+    spill(l, ls, part_of);
+    spill(r, rs, part_of);
+    for (std::size_t p = 0; p < parts; ++p) {
+        const std::vector<tuple> lt = ls.take(p), rt = rs.take(p);
+        radix_join(lt, rt, bits, ctx);
+    }
+    stats.spill_bytes = ls.bytes() + rs.bytes();
+    stats.spill_partitions = parts;
+    return finish(ctx, stats);
+}
+
+join_stats sort_merge_join(const join_input& left, const join_input& right, const join_sink& sink,
+    const join_options& options)
+{
+    const auto [l, r] = check_inputs(left, right);
+    join_context ctx{sink, options, options.sched ? *options.sched : scheduler::instance()};
+    join_stats stats;
+    if (!l.selected || !r.selected)
+        return finish(ctx, stats);
+
+    const std::size_t parts = spill_partitions(l, r, options);
+    if (!parts) {
+        const std::vector<tuple> lt = gather(l, ctx.sched), rt = gather(r, ctx.sched);
+        merge_join(lt, rt, ctx);
+        return finish(ctx, stats);
+    }
+    // Spill by key range, on splitters from a first pass over both key
+    // columns, and join the ranges in key order.
+    std::vector<std::uint64_t> sample;
+    const std::size_t stride = std::max<std::size_t>(1, (l.selected + r.selected) / (parts * 64));
+    sample_keys(l, stride, sample);
+    sample_keys(r, stride, sample);
+    const std::vector<std::uint64_t> split = splitters(std::move(sample), parts);
+    const auto part_of = [&split](std::uint64_t key) { return range_of(split, key); };
+    const std::size_t ranges = split.size() + 1;
+    spill_set ls(spill_dir(options), ranges, spill_buffer_tuples(options, ranges));
+    spill_set rs(spill_dir(options), ranges, spill_buffer_tuples(options, ranges));
+    spill(l, ls, part_of);
+    spill(r, rs, part_of);
+    for (std::size_t p = 0; p < ranges; ++p) {
+        const std::vector<tuple> lt = ls.take(p), rt = rs.take(p);
+        merge_join(lt, rt, ctx);
+    }
+    stats.spill_bytes = ls.bytes() + rs.bytes();
+    stats.spill_partitions = ranges;
+    return finish(ctx, stats);
+}
+
+} // namespace yeni
@@ -0,0 +1,608 @@
+#include "yeni/lsm_tree.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/futex.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/scheduler.hpp"
+#include "yeni/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace yeni {
+
+namespace {
+
+constexpr const char* manifest_name = "MANIFEST";
+constexpr const char* manifest_tag = "yeni-manifest";
+// Version 1 named the segments only; version 2 adds each one's key range
+// and size, which is what lets the tree open without mapping them.
+constexpr int manifest_version = 2;
+
+std::uint64_t min_key(const lsm_segment& s) noexcept
+{
+    return s.min_key();
+}
+
+std::uint64_t max_key(const lsm_segment& s) noexcept
+{
+    return s.max_key();
+}
+
+bool overlaps(const lsm_segment& s, std::uint64_t lo, std::uint64_t hi) noexcept
+{
+    return max_key(s) >= lo && min_key(s) <= hi;
+}
+
+/// Sequence number of a "seg-<16 hex>.yseg[.tmp]" name, or nullopt.
+std::optional<std::uint64_t> segment_sequence(const std::string& name)
+{
+    std::uint64_t sequence;
+    int end = 0;
+    if (std::sscanf(name.c_str(), "seg-%16" SCNx64 ".yseg%n", &sequence, &end) != 1 || end != 25)
+        return std::nullopt;
+    if (name.size() != 25 && name.compare(25, std::string::npos, ".tmp") != 0)
+        return std::nullopt;
+    return sequence;
+}
+
+void write_all(int fd, const char* p, std::size_t n, const std::string& what)
+{
+    while (n) {
+        const ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno(what);
+        }
+        p += w;
+        n -= std::size_t(w);
+    }
+}
+
+void sync_directory(const std::filesystem::path& dir)
+{
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("open " + dir.string());
+    const int r = ::fsync(fd);
+    const int e = errno;
+    ::close(fd);
+    if (r != 0) {
+        errno = e;
+        throw_errno("fsync " + dir.string());
+    }
+}
+
+} // namespace
+
+lsm_segment::lsm_segment(std::filesystem::path path, std::uint64_t min_key, std::uint64_t max_key,
+    std::uint64_t file_size)
+    : path_(std::move(path))
+    , min_key_(min_key)
+    , max_key_(max_key)
+    , file_size_(file_size)
+{
+}
+
+lsm_segment::lsm_segment(segment s)
+    : path_(s.path())
+    , min_key_(s.keys().empty() ? 0 : s.keys().front())
+    , max_key_(s.keys().empty() ? 0 : s.keys().back())
+    , file_size_(s.file_size())
+{
+    if (s.keys().empty())
+        throw format_error("yeni: " + path_.string() + ": segment without keys");
+    segment_ = std::make_unique<const segment>(std::move(s));
+    open_.store(segment_.get(), std::memory_order_release);
+}
+
+lsm_segment::~lsm_segment() = default;
+
+const segment& lsm_segment::open_slow() const
+{
+    std::lock_guard lock(open_mutex_);
+    if (const segment* s = open_.load(std::memory_order_relaxed))
+        return *s;
+    auto seg = std::make_unique<const segment>(segment::open(path_));
+    if (seg->keys().empty() || seg->keys().front() != min_key_ || seg->keys().back() != max_key_
+        || seg->file_size() != file_size_)
+        throw format_error("yeni: " + path_.string() + ": segment does not match the manifest");
+    metrics::local().add(metrics::counter::segment_lazy_opens);
+    segment_ = std::move(seg);
+    open_.store(segment_.get(), std::memory_order_release);
+    return *segment_;
+}
+
+std::uint64_t lsm_version::level_bytes(std::size_t n) const noexcept
+{
+    std::uint64_t total = 0;
+    for (const auto& s : levels_[n])
+        total += s->file_size();
+    return total;
+}
+
+std::optional<std::span<const std::byte>> lsm_version::find(std::uint64_t key) const
+{
+    const trace::span op(trace::span_kind::lookup, key);
+    for (const auto& s : levels_[0]) {
+        if (key < min_key(*s) || key > max_key(*s))
+            continue;
+        const trace::span probe(trace::span_kind::index_probe, 0);
+        const segment& seg = s->get();
+        if (auto row = seg.find(key))
+            return seg.binary(segment::value_column)[*row];
+    }
+    for (std::size_t n = 1; n < max_levels; ++n) {
+        const auto& run = levels_[n];
+        auto it = std::upper_bound(run.begin(), run.end(), key,
+            [](std::uint64_t k, const segment_ptr& s) { return k < min_key(*s); });
+        if (it == run.begin())
+            continue;
+        const lsm_segment& s = **--it;
+        if (key > max_key(s))
+            continue;
+        const trace::span probe(trace::span_kind::index_probe, n);
+        const segment& seg = s.get();
+        if (auto row = seg.find(key))
+            return seg.binary(segment::value_column)[*row];
+    }
+    return std::nullopt;
+}
+
+std::size_t lsm_version::read_amplification() const noexcept
+{
+    std::size_t n = levels_[0].size();
+    for (std::size_t l = 1; l < max_levels; ++l)
+        n += !levels_[l].empty();
+    return n;
+}
+
+/// One merge of `inputs` into level + 1, advanced slice by slice.
+struct lsm_tree::compaction : task {
+    struct cursor {
+        std::uint64_t key;
+        std::uint32_t input; // lower is newer and wins ties
+        std::size_t row;
+    };
+
+    // std heaps are max-heaps; this puts the smallest (key, input) on top.
+    static bool after(const cursor& a, const cursor& b) noexcept
+    {
+        return a.key != b.key ? a.key > b.key : a.input > b.input;
+    }
+
+    void prepare()
+    {
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            const segment& s = inputs[i]->get();
+            keys.push_back(s.keys());
+            values.push_back(s.binary(segment::value_column));
+            heap.push_back({keys[i][0], std::uint32_t(i), 0});
+            bytes_in += inputs[i]->file_size();
+        }
+        std::make_heap(heap.begin(), heap.end(), after);
+        started = std::chrono::steady_clock::now();
+    }
+
+    /// Pop the smallest cursor, returning its value; re-push it if its
+    /// input has rows left.
+    std::span<const std::byte> pop(std::uint64_t& key)
+    {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        cursor& c = heap.back();
+        key = c.key;
+        const std::span<const std::byte> v = values[c.input][c.row];
+        if (++c.row < keys[c.input].size()) {
+            c.key = keys[c.input][c.row];
+            std::push_heap(heap.begin(), heap.end(), after);
+        } else {
+            heap.pop_back();
+        }
+        return v;
+    }
+
+    /// Merge about `budget` bytes; returns the bytes read and written.
+    std::uint64_t step(std::uint64_t budget)
+    {
+        std::uint64_t done = 0;
+        while (!heap.empty() && done < budget) {
+            std::uint64_t key;
+            const std::span<const std::byte> v = pop(key);
+            done += 2 * sizeof(std::uint64_t) + v.size();
+            // Older versions of the same key.
+            while (!heap.empty() && heap.front().key == key) {
+                std::uint64_t dup;
+                done += 2 * sizeof(std::uint64_t) + pop(dup).size();
+            }
+            out_keys.push_back(key);
+            out_values.push_back(v);
+            out_bytes += 2 * sizeof(std::uint64_t) + v.size();
+            if (out_bytes >= tree->options_.segment_bytes)
+                done += write_output();
+        }
+        if (heap.empty() && !out_keys.empty())
+            done += write_output();
+        return done;
+    }
+
+    std::uint64_t write_output()
+    {
+        const std::filesystem::path path = tree->next_segment_path();
+        segment_writer w(path, tree->io_, tree->options_.codec);
+        w.add_column<std::uint64_t>(segment::key_column, out_keys);
+        w.add_block(segment::filter_block, bloom_filter::build(out_keys));
+        w.add_binary_column(segment::value_column, out_keys.size(), [&](std::size_t i) { return out_values[i]; });
+        w.finish();
+        outputs.push_back(std::make_unique<const lsm_segment>(segment::open(path)));
+        out_keys.clear();
+        out_values.clear();
+        out_bytes = 0;
+        bytes_out += w.bytes_written();
+        return w.bytes_written();
+    }
+
+    static void run_slice(task* t) noexcept
+    {
+        auto* job = static_cast<compaction*>(t);
+        lsm_tree& tree = *job->tree;
+        if (tree.stopping_.load(std::memory_order_acquire)) {
+            tree.finish(job, nullptr);
+            return;
+        }
+        try {
+            const std::uint64_t done = job->step(tree.options_.slice_bytes);
+            const auto delay = tree.limiter_.consume(done);
+            if (!job->heap.empty()) {
+                tree.sched_.spawn_background(job, std::chrono::steady_clock::now() + delay);
+                return;
+            }
+        } catch (...) {
+            tree.finish(job, std::current_exception());
+            return;
+        }
+        tree.finish(job, nullptr);
+    }
+
+    lsm_tree* tree;
+    std::size_t level; // inputs come from here and level + 1
+    std::vector<lsm_version::segment_ptr> inputs; // newest first
+    std::vector<std::span<const std::uint64_t>> keys;
+    std::vector<binary_column> values;
+    std::vector<cursor> heap;
+    std::vector<std::uint64_t> out_keys;
+    std::vector<std::span<const std::byte>> out_values;
+    std::uint64_t out_bytes = 0;
+    std::vector<std::unique_ptr<const lsm_segment>> outputs; // the tree's once installed
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    std::chrono::steady_clock::time_point started;
+};
+
+lsm_tree::lsm_tree(std::filesystem::path dir, compaction_options options, scheduler* sched, io_context* io)
+    : dir_(std::move(dir))
+    , options_(options)
+    , sched_(sched ? *sched : scheduler::instance())
+    , io_(io)
+    , own_limiter_(options.bytes_per_second, options.burst_bytes)
+    , limiter_(options.limiter ? *options.limiter : own_limiter_)
+{
+    if (options_.level0_trigger == 0 || options_.level_ratio < 1.0 || options_.segment_bytes == 0
+        || options_.slice_bytes == 0)
+        throw std::invalid_argument("yeni: bad compaction options");
+    std::filesystem::create_directories(dir_);
+    load_manifest();
+    std::lock_guard lock(edit_mutex_);
+    // Planning a compaction may be the first to open a segment; a bad one
+    // fails that compaction, as in finish(), not the tree.
+    try {
+        maybe_compact_locked();
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+}
+
+lsm_tree::~lsm_tree()
+{
+    stopping_.store(true, std::memory_order_release);
+    compaction* job;
+    {
+        std::lock_guard lock(edit_mutex_);
+        job = job_;
+    }
+    // Queued rather than running: nobody else will ever pick it up now.
+    if (job && sched_.cancel_background(job))
+        finish(job, nullptr);
+    wait_for_compactions();
+    // finish() clears busy_ under the mutex; let it release it.
+    std::lock_guard lock(edit_mutex_);
+    const lsm_version* v = current_.load(std::memory_order_relaxed);
+    for (const auto& run : v->levels_)
+        for (const lsm_segment* s : run)
+            delete s;
+    delete v;
+}
+
+void lsm_tree::load_manifest()
+{
+    std::vector<std::unique_ptr<const lsm_segment>> opened;
+    auto v = std::make_unique<lsm_version>();
+    std::set<std::string> live;
+    const std::filesystem::path manifest = dir_ / manifest_name;
+    if (std::filesystem::exists(manifest)) {
+        std::ifstream in(manifest);
+        std::string tag;
+        int version = 0;
+        if (!(in >> tag >> version) || tag != manifest_tag || version < 1 || version > manifest_version)
+            throw format_error("yeni: " + manifest.string() + ": not a manifest");
+        std::size_t level;
+        std::string name;
+        while (in >> level >> name) {
+            if (level >= lsm_version::max_levels || !segment_sequence(name) || !live.insert(name).second)
+                throw format_error("yeni: " + manifest.string() + ": corrupt entry " + name);
+            if (version == 1) {
+                // No key range to go by: open it now. The next change
+                // rewrites the manifest in the current version.
+                opened.push_back(std::make_unique<const lsm_segment>(segment::open(dir_ / name)));
+            } else {
+                std::uint64_t lo, hi, bytes;
+                if (!(in >> lo >> hi >> bytes) || lo > hi)
+                    throw format_error("yeni: " + manifest.string() + ": corrupt entry " + name);
+                opened.push_back(std::make_unique<const lsm_segment>(dir_ / name, lo, hi, bytes));
+            }
+            v->levels_[level].push_back(opened.back().get());
+        }
+        if (!in.eof())
+            throw format_error("yeni: " + manifest.string() + ": corrupt manifest");
+    }
+    std::uint64_t last = 0;
+    for (const auto& e : std::filesystem::directory_iterator(dir_)) {
+        const std::string name = e.path().filename().string();
+        const auto sequence = segment_sequence(name);
+        if (!sequence)
+            continue;
+        last = std::max(last, *sequence);
+        if (!live.count(name))
+            std::filesystem::remove(e.path());
+    }
+    next_file_.store(last + 1, std::memory_order_relaxed);
+    current_.store(v.release(), std::memory_order_release);
+    for (auto& seg : opened)
+        seg.release(); // owned by the version now
+}
+
+void lsm_tree::write_manifest(const lsm_version& v)
+{
+    std::string text = std::string(manifest_tag) + " " + std::to_string(manifest_version) + "\n";
+    for (std::size_t n = 0; n < lsm_version::max_levels; ++n)
+        for (const auto& s : v.levels_[n])
+            text += std::to_string(n) + " " + s->path().filename().string() + " " + std::to_string(s->min_key())
+                + " " + std::to_string(s->max_key()) + " " + std::to_string(s->file_size()) + "\n";
+
+    const std::filesystem::path path = dir_ / manifest_name;
+    const std::filesystem::path tmp = path.string() + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw_errno("open " + tmp.string());
+    try {
+        write_all(fd, text.data(), text.size(), "write " + tmp.string());
+        if (::fdatasync(fd) != 0)
+            throw_errno("fdatasync " + tmp.string());
+    } catch (...) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    ::close(fd);
+    if (::rename(tmp.c_str(), path.c_str()) != 0)
+        throw_errno("rename " + path.string());
+    sync_directory(dir_);
+}
+
+std::filesystem::path lsm_tree::next_segment_path()
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%016" PRIx64 ".yseg", next_file_.fetch_add(1, std::memory_order_relaxed));
+    return dir_ / name;
+}
+
+std::exception_ptr lsm_tree::last_error() const
+{
+    std::lock_guard lock(edit_mutex_);
+    return error_;
+}
+
+void lsm_tree::flush(const record_store& store)
+{
+    if (store.size() == 0)
+        return;
+    const std::filesystem::path path = next_segment_path();
+    write_segment(path, store, io_, options_.codec);
+    auto seg = std::make_unique<const lsm_segment>(segment::open(path));
+    std::lock_guard lock(edit_mutex_);
+    auto v = std::make_unique<lsm_version>(edit_version());
+    v->levels_[0].insert(v->levels_[0].begin(), seg.get());
+    try {
+        install(std::move(v));
+    } catch (...) {
+        std::filesystem::remove(path);
+        throw;
+    }
+    seg.release();
+    maybe_compact_locked();
+}
+
+std::uint64_t lsm_tree::level_target(std::size_t n) const noexcept
+{
+    return std::uint64_t(double(options_.level1_bytes) * std::pow(options_.level_ratio, double(n - 1)));
+}
+
+std::unique_ptr<lsm_tree::compaction> lsm_tree::pick_locked()
+{
+    const lsm_version& v = edit_version();
+    // Highest score, as a fraction of the level's budget, goes first.
+    double best = double(v.levels_[0].size()) / double(options_.level0_trigger);
+    std::size_t level = 0;
+    for (std::size_t n = 1; n + 1 < lsm_version::max_levels; ++n) {
+        const double score = double(v.level_bytes(n)) / double(level_target(n));
+        if (score > best) {
+            best = score;
+            level = n;
+        }
+    }
+    if (best < 1.0)
+        return nullptr;
+
+    auto job = std::make_unique<compaction>();
+    job->run = &compaction::run_slice;
+    job->tree = this;
+    job->level = level;
+    std::uint64_t lo, hi;
+    if (level == 0) {
+        job->inputs = v.levels_[0];
+        lo = std::numeric_limits<std::uint64_t>::max();
+        hi = 0;
+        for (const auto& s : job->inputs) {
+            lo = std::min(lo, min_key(*s));
+            hi = std::max(hi, max_key(*s));
+        }
+    } else {
+        // Round-robin through the key space, so every part of the level
+        // gets pushed down in turn.
+        const auto& run = v.levels_[level];
+        auto it = std::find_if(run.begin(), run.end(),
+            [&](const auto& s) { return min_key(*s) >= compact_cursor_[level]; });
+        const auto& s = it == run.end() ? run.front() : *it;
+        job->inputs.push_back(s);
+        lo = min_key(*s);
+        hi = max_key(*s);
+    }
+    for (const auto& s : v.levels_[level + 1])
+        if (overlaps(*s, lo, hi))
+            job->inputs.push_back(s);
+    return job;
+}
+
+void lsm_tree::install(std::unique_ptr<lsm_version> v, std::span<const lsm_version::segment_ptr> dropped)
+{
+    write_manifest(*v);
+    epoch::retire(current_.exchange(v.release(), std::memory_order_acq_rel));
+    for (const lsm_segment* s : dropped)
+        epoch::retire(s);
+}
+
+void lsm_tree::maybe_compact_locked()
+{
+    while (!job_ && !stopping_.load(std::memory_order_relaxed)) {
+        auto job = pick_locked();
+        if (!job)
+            return;
+        const std::size_t level = job->level;
+        const auto& first = job->inputs.front();
+        compact_cursor_[level] = max_key(*first) == std::numeric_limits<std::uint64_t>::max() ? 0 : max_key(*first) + 1;
+        if (level > 0 && job->inputs.size() == 1) {
+            // Nothing below overlaps: move the segment down a level without
+            // rewriting it.
+            auto v = std::make_unique<lsm_version>(edit_version());
+            auto& from = v->levels_[level];
+            from.erase(std::find(from.begin(), from.end(), first));
+            auto& to = v->levels_[level + 1];
+            to.insert(std::upper_bound(to.begin(), to.end(), min_key(*first),
+                          [](std::uint64_t k, const auto& s) { return k < min_key(*s); }),
+                first);
+            install(std::move(v));
+            continue;
+        }
+        job->prepare();
+        job_ = job.release();
+        busy_.store(1, std::memory_order_relaxed);
+        sched_.spawn_background(job_);
+    }
+}
+
+void lsm_tree::finish(compaction* job, std::exception_ptr error) noexcept
+{
+    std::unique_ptr<compaction> owned(job);
+    const epoch::guard pin; // keeps the retired inputs around for the unlink
+    bool installed = false;
+    if (!error && job->heap.empty()) {
+        try {
+            std::lock_guard lock(edit_mutex_);
+            auto v = std::make_unique<lsm_version>(edit_version());
+            for (std::size_t n : {job->level, job->level + 1}) {
+                auto& run = v->levels_[n];
+                std::erase_if(run, [&](const auto& s) {
+                    return std::find(job->inputs.begin(), job->inputs.end(), s) != job->inputs.end();
+                });
+            }
+            auto& to = v->levels_[job->level + 1];
+            for (const auto& s : job->outputs)
+                to.push_back(s.get());
+            std::sort(to.begin(), to.end(), [](const auto& a, const auto& b) { return min_key(*a) < min_key(*b); });
+            install(std::move(v), job->inputs);
+            installed = true;
+            for (auto& s : job->outputs)
+                s.release();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    // Readers may still map the replaced files; unlinking them now is
+    // fine, the mappings outlive the names.
+    std::error_code ec;
+    if (installed)
+        for (const lsm_segment* s : job->inputs)
+            std::filesystem::remove(s->path(), ec);
+    else
+        for (const auto& s : job->outputs)
+            std::filesystem::remove(s->path(), ec);
+    if (installed) {
+        auto& m = metrics::local();
+        m.add(metrics::counter::compactions);
+        m.add(metrics::counter::compaction_bytes_in, job->bytes_in);
+        m.add(metrics::counter::compaction_bytes_out, job->bytes_out);
+        m.record(metrics::histogram::compaction,
+            std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - job->started)
+                              .count()));
+    }
+    {
+        std::lock_guard lock(edit_mutex_);
+        job_ = nullptr;
+        if (error)
+            error_ = error;
+    }
+    owned.reset();
+
+    std::lock_guard lock(edit_mutex_);
+    if (!error) {
+        try {
+            maybe_compact_locked();
+        } catch (...) {
+            error_ = std::current_exception();
+        }
+    }
+    if (!job_) {
+        busy_.store(0, std::memory_order_release);
+        futex_wake(busy_);
+    }
+}
+
+void lsm_tree::wait_for_compactions()
+{
+    while (busy_.load(std::memory_order_acquire))
+        futex_wait(busy_, 1);
+}
+
+} // namespace yeni
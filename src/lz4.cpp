@@ -0,0 +1,145 @@
+#include "lz4.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace yeni::detail {
+
+namespace {
+
+constexpr std::size_t min_match = 4;
+// A match may not start in the last 12 bytes, and the last 5 bytes are
+// always literals; decoders rely on both.
+constexpr std::size_t match_start_limit = 12;
+constexpr std::size_t last_literals = 5;
+constexpr std::size_t max_offset = 65535;
+constexpr unsigned hash_bits = 12;
+
+std::uint32_t read32(const std::byte* p) noexcept
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::uint32_t hash4(std::uint32_t v) noexcept
+{
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+std::byte* put_length(std::byte* op, std::size_t n) noexcept
+{
+    for (; n >= 255; n -= 255)
+        *op++ = std::byte{255};
+    *op++ = std::byte(n);
+    return op;
+}
+
+std::byte* put_literals(std::byte* op, const std::byte* p, std::size_t n, std::size_t match) noexcept
+{
+    *op++ = std::byte((n >= 15 ? 15 : n) << 4 | (match >= 15 ? 15 : match));
+    if (n >= 15)
+        op = put_length(op, n - 15);
+    if (n)
+        std::memcpy(op, p, n);
+    return op + n;
+}
+
+} // namespace
+
+std::size_t lz4_compress(const std::byte* src, std::size_t n, std::byte* dst) noexcept
+{
+    std::byte* op = dst;
+    std::size_t anchor = 0;
+    if (n > match_start_limit) {
+        std::uint32_t table[std::size_t(1) << hash_bits] = {};
+        const std::size_t limit = n - match_start_limit;
+        const std::size_t match_end = n - last_literals;
+        std::size_t ip = 0;
+        while (ip < limit) {
+            const std::uint32_t h = hash4(read32(src + ip));
+            std::size_t cand = table[h];
+            table[h] = std::uint32_t(ip);
+            if (cand >= ip || ip - cand > max_offset || read32(src + cand) != read32(src + ip)) {
+                // Skip faster through data that does not compress.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            while (ip > anchor && cand > 0 && src[ip - 1] == src[cand - 1]) {
+                --ip;
+                --cand;
+            }
+            std::size_t len = min_match;
+            while (ip + len < match_end && src[cand + len] == src[ip + len])
+                ++len;
+
+            op = put_literals(op, src + anchor, ip - anchor, len - min_match);
+            const std::size_t offset = ip - cand;
+            *op++ = std::byte(offset & 0xff);
+            *op++ = std::byte(offset >> 8);
+            if (len - min_match >= 15)
+                op = put_length(op, len - min_match - 15);
+            ip += len;
+            anchor = ip;
+            if (ip - 2 < limit)
+                table[hash4(read32(src + ip - 2))] = std::uint32_t(ip - 2);
+        }
+    }
+    // The final sequence is literals only; its match nibble is ignored.
+    return std::size_t(put_literals(op, src + anchor, n - anchor, 0) - dst);
+}
+
+bool lz4_decompress(const std::byte* src, std::size_t n, std::byte* dst, std::size_t out_n) noexcept
+{
+    std::size_t ip = 0, op = 0;
+    auto length = [&](std::size_t& len) {
+        std::uint8_t b;
+        do {
+            if (ip >= n)
+                return false;
+            b = std::uint8_t(src[ip++]);
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+    for (;;) {
+        if (ip >= n)
+            return false;
+        const auto token = std::uint8_t(src[ip++]);
+        std::size_t lit = token >> 4;
+        if (lit == 15 && !length(lit))
+            return false;
+        if (lit > n - ip || lit > out_n - op)
+            return false;
+        if (lit)
+            std::memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == n)
+            return op == out_n;
+
+        if (n - ip < 2)
+            return false;
+        const std::size_t offset = std::size_t(src[ip]) | std::size_t(src[ip + 1]) << 8;
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return false;
+        std::size_t len = token & 15;
+        if (len == 15 && !length(len))
+            return false;
+        len += min_match;
+        if (len > out_n - op)
+            return false;
+        const std::byte* from = dst + op - offset;
+        if (offset >= len) {
+            std::memcpy(dst + op, from, len);
+        } else {
+            // Overlapping copy repeats the last `offset` bytes.
+            for (std::size_t i = 0; i < len; ++i)
+                dst[op + i] = from[i];
+        }
+        op += len;
+    }
+}
+
+} // namespace yeni::detail
@@ -0,0 +1,26 @@
+#pragma once
+
+// LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md),
+// compatible with LZ4_compress_default() / LZ4_decompress_safe(). Kept in
+// tree so that segments compress without a build dependency.
+
+#include <cstddef>
+
+namespace yeni::detail {
+
+/// Worst-case compressed size of `n` bytes.
+constexpr std::size_t lz4_bound(std::size_t n) noexcept
+{
+    return n + n / 255 + 16;
+}
+
+/// Compress `n` bytes into `dst`, which holds lz4_bound(n). Returns the
+/// compressed size.
+std::size_t lz4_compress(const std::byte* src, std::size_t n, std::byte* dst) noexcept;
+
+/// Decompress a block into exactly `out_n` bytes. False if the block is
+/// malformed or does not decode to `out_n` bytes; never reads or writes
+/// out of bounds.
+bool lz4_decompress(const std::byte* src, std::size_t n, std::byte* dst, std::size_t out_n) noexcept;
+
+} // namespace yeni::detail
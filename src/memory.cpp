@@ -0,0 +1,288 @@
+#include "yeni/memory.hpp"
+
+#include "yeni/metrics.hpp"
+#include "yeni/numa.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace yeni {
+
+namespace {
+
+class standard_provider final : public memory_provider {
+public:
+    void* allocate(std::size_t size, std::size_t align) override
+    {
+        return ::operator new(size, std::align_val_t(align));
+    }
+    void deallocate(void* p, std::size_t, std::size_t align) noexcept override
+    {
+        ::operator delete(p, std::align_val_t(align));
+    }
+};
+
+constexpr std::size_t base_page = 4096;
+constexpr std::size_t huge_2m = std::size_t(2) << 20;
+constexpr std::size_t huge_1g = std::size_t(1) << 30;
+
+// Size classes: 64 bytes, then four per power of two (80, 96, 112, 128,
+// 160, ...), up to half a chunk.
+constexpr std::size_t min_class = 64;
+constexpr std::size_t max_class = page_provider::chunk_bytes / 2;
+constexpr std::size_t class_count = 1 + 4 * std::size_t(std::bit_width(max_class) - std::bit_width(min_class));
+// Chunk bytes before the first block; holds the owning pool.
+constexpr std::size_t chunk_header = 64;
+
+constexpr std::size_t class_of(std::size_t n) noexcept
+{
+    if (n <= min_class)
+        return 0;
+    const std::size_t m = n - 1;
+    const unsigned e = unsigned(std::bit_width(m)) - 1;
+    return 1 + std::size_t(e - 6) * 4 + ((m >> (e - 2)) - 4);
+}
+
+constexpr std::size_t class_size(std::size_t c) noexcept
+{
+    if (c == 0)
+        return min_class;
+    const std::size_t i = c - 1;
+    return (5 + i % 4) << (i / 4 + 4);
+}
+
+static_assert(class_size(class_of(65)) == 80 && class_size(class_of(128)) == 128);
+static_assert(class_size(class_of(129)) == 160 && class_size(class_of(max_class)) == max_class);
+static_assert(class_of(max_class) == class_count - 1);
+
+// Blocks of a class are aligned to the largest power of two dividing its
+// size, so a run of them packs without padding.
+constexpr std::size_t class_align(std::size_t size) noexcept
+{
+    return std::min(base_page, std::size_t(1) << std::countr_zero(size));
+}
+
+std::size_t round_up(std::size_t n, std::size_t to) noexcept
+{
+    return (n + to - 1) & ~(to - 1);
+}
+
+// mbind(2) without libnuma.
+void bind_to(void* p, std::size_t size, int node) noexcept
+{
+    constexpr int mpol_bind = 2;
+    constexpr std::size_t mask_bits = 1024;
+    if (node < 0 || std::size_t(node) >= mask_bits)
+        return;
+    unsigned long mask[mask_bits / (8 * sizeof(unsigned long))] = {};
+    mask[std::size_t(node) / (8 * sizeof(unsigned long))] = 1UL << (std::size_t(node) % (8 * sizeof(unsigned long)));
+    // The kernel reads maxnode - 1 bits.
+    ::syscall(SYS_mbind, p, size, mpol_bind, mask, mask_bits + 1, 0);
+}
+
+} // namespace
+
+memory_provider& memory_provider::standard() noexcept
+{
+    static standard_provider provider;
+    return provider;
+}
+
+struct alignas(64) page_provider::pool {
+    explicit pool(int n) noexcept : node(n) {}
+
+    const int node;
+    std::mutex mutex;
+    std::byte* cur = nullptr; // bump range in the current chunk
+    std::byte* end = nullptr;
+    std::byte* next_chunk = nullptr; // rest of the current region
+    std::byte* region_end = nullptr;
+    std::array<void*, class_count> free{}; // each block's first word links the next
+    std::vector<std::byte*> regions;
+};
+
+namespace {
+
+std::size_t page_bytes_of(page_size pages) noexcept
+{
+    switch (pages) {
+    case page_size::base:
+        return base_page;
+    case page_size::huge_1g:
+        return huge_1g;
+    default:
+        return huge_2m;
+    }
+}
+
+} // namespace
+
+page_provider::page_provider(page_provider_options options)
+    : options_(options)
+    , page_bytes_(page_bytes_of(options.pages))
+    , region_bytes_(std::max(page_bytes_, chunk_bytes))
+{
+    const auto& nodes = numa_topology::system().nodes();
+    if (options_.node_local && nodes.size() > 1) {
+        for (const auto& n : nodes) {
+            if (n.id >= pool_of_node_.size())
+                pool_of_node_.resize(n.id + 1, 0);
+            pool_of_node_[n.id] = unsigned(pools_.size());
+            pools_.push_back(std::make_unique<pool>(int(n.id)));
+        }
+    } else {
+        pools_.push_back(std::make_unique<pool>(options_.node_local ? -1 : options_.node));
+    }
+}
+
+page_provider::~page_provider()
+{
+    for (const auto& p : pools_)
+        for (std::byte* r : p->regions)
+            unmap(r, region_bytes_);
+}
+
+void* page_provider::map(std::size_t size, std::size_t align, int node)
+{
+    constexpr int prot = PROT_READ | PROT_WRITE;
+    constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    auto& m = metrics::local();
+    const bool want_1g = options_.pages == page_size::huge_1g && size % huge_1g == 0;
+    const bool want_hugetlb = options_.pages == page_size::huge_1g || options_.pages == page_size::huge_2m;
+    void* p = MAP_FAILED;
+    if (want_1g) {
+        p = ::mmap(nullptr, size, prot, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+        if (p == MAP_FAILED)
+            m.add(metrics::counter::huge_page_fallbacks);
+    }
+    if (p == MAP_FAILED && want_hugetlb) {
+        p = ::mmap(nullptr, size, prot, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+        if (p == MAP_FAILED && !want_1g)
+            m.add(metrics::counter::huge_page_fallbacks);
+    }
+    if (p == MAP_FAILED) {
+        // Base pages: map extra and trim to `align`, so that transparent
+        // huge pages can back every aligned 2 MiB of it.
+        const std::size_t span = size + align - base_page;
+        void* raw = ::mmap(nullptr, span, prot, flags, -1, 0);
+        if (raw == MAP_FAILED)
+            throw std::bad_alloc();
+        auto* b = static_cast<std::byte*>(raw);
+        auto* a = reinterpret_cast<std::byte*>(round_up(reinterpret_cast<std::uintptr_t>(b), align));
+        if (a != b)
+            ::munmap(b, std::size_t(a - b));
+        if (const std::size_t tail = span - std::size_t(a - b) - size)
+            ::munmap(a + size, tail);
+        if (options_.pages != page_size::base)
+            ::madvise(a, size, MADV_HUGEPAGE);
+        p = a;
+    }
+    // Before the first touch, which is when pages get placed.
+    bind_to(p, size, node);
+    mapped_.fetch_add(size, std::memory_order_relaxed);
+    m.add(metrics::counter::memory_mapped_bytes, size);
+    return p;
+}
+
+void page_provider::unmap(void* p, std::size_t size) noexcept
+{
+    ::munmap(p, size);
+    mapped_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+page_provider::pool& page_provider::local_pool() noexcept
+{
+    if (pools_.size() == 1)
+        return *pools_[0];
+    const int cpu = ::sched_getcpu();
+    const unsigned node = numa_topology::system().node_of_cpu(cpu < 0 ? 0 : unsigned(cpu));
+    return *pools_[node < pool_of_node_.size() ? pool_of_node_[node] : 0];
+}
+
+namespace {
+
+// Length of the mapping a large block of `n` bytes gets: whole pages, but
+// no 1 GiB page for less than 1 GiB.
+std::size_t large_length(std::size_t n, std::size_t page_bytes) noexcept
+{
+    return round_up(n, n >= huge_1g ? page_bytes : std::min(page_bytes, huge_2m));
+}
+
+} // namespace
+
+void* page_provider::allocate(std::size_t size, std::size_t align)
+{
+    if (align > base_page || !std::has_single_bit(align))
+        throw std::invalid_argument("yeni: page_provider alignment must be a power of two up to 4096");
+    // Rounding up to the alignment picks a class whose size it divides.
+    const std::size_t n = round_up(std::max<std::size_t>(size, 1), align);
+    pool& p = local_pool();
+    if (n > chunk_bytes / 2)
+        return map(large_length(n, page_bytes_), std::min(page_bytes_, huge_2m), p.node);
+
+    const std::size_t c = class_of(n);
+    const std::size_t bytes = class_size(c);
+    std::lock_guard lock(p.mutex);
+    if (void* b = p.free[c]) {
+        p.free[c] = *static_cast<void**>(b);
+        return b;
+    }
+    auto* b = reinterpret_cast<std::byte*>(round_up(reinterpret_cast<std::uintptr_t>(p.cur), class_align(bytes)));
+    if (!p.cur || b + bytes > p.end) {
+        if (p.next_chunk == p.region_end) {
+            p.regions.reserve(p.regions.size() + 1);
+            auto* r = static_cast<std::byte*>(map(region_bytes_, chunk_bytes, p.node));
+            p.regions.push_back(r);
+            p.next_chunk = r;
+            p.region_end = r + region_bytes_;
+        }
+        std::byte* chunk = p.next_chunk;
+        p.next_chunk += chunk_bytes;
+        *reinterpret_cast<pool**>(chunk) = &p;
+        p.end = chunk + chunk_bytes;
+        b = reinterpret_cast<std::byte*>(
+            round_up(reinterpret_cast<std::uintptr_t>(chunk + chunk_header), class_align(bytes)));
+    }
+    p.cur = b + bytes;
+    return b;
+}
+
+void page_provider::deallocate(void* ptr, std::size_t size, std::size_t align) noexcept
+{
+    if (!ptr)
+        return;
+    const std::size_t n = round_up(std::max<std::size_t>(size, 1), align);
+    if (n > chunk_bytes / 2) {
+        unmap(ptr, large_length(n, page_bytes_));
+        return;
+    }
+    // Back to the pool the block came from, whichever node frees it.
+    auto* chunk = reinterpret_cast<std::byte*>(reinterpret_cast<std::uintptr_t>(ptr) & ~(chunk_bytes - 1));
+    pool& p = **reinterpret_cast<pool**>(chunk);
+    const std::size_t c = class_of(n);
+    std::lock_guard lock(p.mutex);
+    *static_cast<void**>(ptr) = p.free[c];
+    p.free[c] = ptr;
+}
+
+} // namespace yeni
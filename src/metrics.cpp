@@ -0,0 +1,374 @@
+#include "yeni/metrics.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace yeni::metrics {
+
+namespace {
+
+constexpr std::string_view counter_names[] = {
+    "inserts",
+    "insert_bytes",
+    "lookups",
+    "lookup_hits",
+    "segment_lookups",
+    "segment_lookup_hits",
+    "segment_filter_skips",
+    "block_cache_hits",
+    "block_cache_misses",
+    "block_cache_evictions",
+    "column_decodes",
+    "column_decode_bytes",
+    "scan_rows",
+    "flushes",
+    "flush_bytes",
+    "compactions",
+    "compaction_bytes_in",
+    "compaction_bytes_out",
+    "wal_appends",
+    "wal_append_bytes",
+    "wal_commits",
+    "import_rows",
+    "import_bytes",
+    "export_rows",
+    "export_bytes",
+    "join_matches",
+    "join_spill_bytes",
+    "memory_mapped_bytes",
+    "huge_page_fallbacks",
+    "replication_batches",
+    "replication_bytes",
+    "replication_records_applied",
+    "shard_messages",
+    "shard_ring_full",
+    "aggregate_rows",
+    "segment_lazy_opens",
+    "morsels",
+    "morsel_steals",
+    "admission_rejected_rate",
+    "admission_rejected_overload",
+    "queue_delay_overloads",
+};
+static_assert(std::size(counter_names) == counter_count);
+
+constexpr std::string_view histogram_names[] = {
+    "insert",
+    "lookup",
+    "scan",
+    "flush",
+    "compaction",
+    "wal_append",
+    "wal_commit",
+    "queue_delay",
+};
+static_assert(std::size(histogram_names) == histogram_count);
+
+// Value of `key` in the query string of a request target, or empty.
+std::string_view query_param(std::string_view target, std::string_view key) noexcept
+{
+    const std::size_t q = target.find('?');
+    if (q == std::string_view::npos)
+        return {};
+    std::string_view rest = target.substr(q + 1);
+    while (!rest.empty()) {
+        const std::string_view pair = rest.substr(0, rest.find('&'));
+        rest.remove_prefix(std::min(rest.size(), pair.size() + 1));
+        if (pair.size() > key.size() && pair.starts_with(key) && pair[key.size()] == '=')
+            return pair.substr(key.size() + 1);
+    }
+    return {};
+}
+
+} // namespace
+
+std::string_view name(counter c) noexcept
+{
+    return counter_names[std::size_t(c)];
+}
+
+std::string_view name(histogram h) noexcept
+{
+    return histogram_names[std::size_t(h)];
+}
+
+#if YENI_METRICS
+
+/// Push-only list of every block ever handed out. Blocks are never freed,
+/// so collect() can walk the list while threads come and go.
+struct registry {
+    static registry& instance()
+    {
+        static registry r;
+        return r;
+    }
+
+    thread_metrics* claim()
+    {
+        for (thread_metrics* m = head.load(std::memory_order_acquire); m; m = m->next_) {
+            bool idle = false;
+            if (m->in_use_.compare_exchange_strong(idle, true, std::memory_order_acquire))
+                return m;
+        }
+        auto* m = new thread_metrics;
+        m->in_use_.store(true, std::memory_order_relaxed);
+        m->next_ = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(m->next_, m, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return m;
+    }
+
+    static void release(thread_metrics* m) noexcept { m->in_use_.store(false, std::memory_order_release); }
+
+    template <class F>
+    void for_each(F&& f) const
+    {
+        for (const thread_metrics* m = head.load(std::memory_order_acquire); m; m = m->next_)
+            f(*m);
+    }
+
+    static std::uint64_t load(const std::atomic<std::uint64_t>& a) noexcept
+    {
+        return a.load(std::memory_order_relaxed);
+    }
+
+    static void add_to(snapshot& s, const thread_metrics& m)
+    {
+        for (std::size_t i = 0; i < counter_count; ++i)
+            s.counters[i] += load(m.counters_[i]);
+        for (std::size_t h = 0; h < histogram_count; ++h) {
+            const auto& cells = m.histograms_[h];
+            auto& out = s.histograms[h];
+            out.count += load(cells.count);
+            out.sum += load(cells.sum);
+            out.max = std::max(out.max, load(cells.max));
+            for (std::size_t b = 0; b < histogram_layout::buckets; ++b)
+                out.buckets[b] += load(cells.buckets[b]);
+        }
+    }
+
+    std::atomic<thread_metrics*> head{nullptr};
+};
+
+namespace {
+
+// The pointer is what the hot path reads; the guard only exists to give
+// the block back when the thread exits. Initial-exec keeps the read a
+// single %fs-relative load instead of a __tls_get_addr call from inside
+// the shared library.
+__attribute__((tls_model("initial-exec"))) thread_local thread_metrics* tls_metrics = nullptr;
+
+struct release_guard {
+    ~release_guard()
+    {
+        if (tls_metrics)
+            registry::release(std::exchange(tls_metrics, nullptr));
+    }
+};
+
+} // namespace
+
+thread_metrics& local() noexcept
+{
+    if (thread_metrics* m = tls_metrics) [[likely]]
+        return *m;
+    thread_local release_guard guard;
+    tls_metrics = registry::instance().claim();
+    return *tls_metrics;
+}
+
+#endif
+
+std::uint64_t histogram_snapshot::percentile(double q) const noexcept
+{
+    if (count == 0 || buckets.empty())
+        return 0;
+    const auto rank = std::uint64_t(std::clamp(q, 0.0, 1.0) * double(count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank)
+            return std::min(histogram_layout::upper_bound(b) - 1, max);
+    }
+    return max;
+}
+
+snapshot collect()
+{
+    snapshot s;
+    for (auto& h : s.histograms)
+        h.buckets.assign(histogram_layout::buckets, 0);
+#if YENI_METRICS
+    registry::instance().for_each([&](const thread_metrics& m) { registry::add_to(s, m); });
+#endif
+    return s;
+}
+
+std::string prometheus_text(const snapshot& s)
+{
+    std::string out;
+    out.reserve(16 << 10);
+    char num[64];
+    auto line = [&](std::string_view a, std::string_view b, std::string_view c, std::uint64_t v) {
+        out.append(a).append(b).append(c);
+        std::snprintf(num, sizeof(num), " %llu\n", static_cast<unsigned long long>(v));
+        out.append(num);
+    };
+
+    for (std::size_t i = 0; i < counter_count; ++i) {
+        const std::string_view n = counter_names[i];
+        out.append("# TYPE yeni_").append(n).append("_total counter\n");
+        line("yeni_", n, "_total", s.counters[i]);
+    }
+    for (std::size_t h = 0; h < histogram_count; ++h) {
+        const std::string_view n = histogram_names[h];
+        const auto& hs = s.histograms[h];
+        out.append("# TYPE yeni_").append(n).append("_latency_seconds histogram\n");
+        // Sub-buckets tile each power of two exactly, so cumulative counts
+        // at powers of two are exact.
+        std::uint64_t cumulative = 0;
+        std::size_t b = 0;
+        for (unsigned e = 0; e <= histogram_layout::max_exponent; ++e) {
+            const std::uint64_t bound = std::uint64_t(1) << e;
+            while (b < hs.buckets.size() - 1 && histogram_layout::upper_bound(b) <= bound)
+                cumulative += hs.buckets[b++];
+            std::snprintf(num, sizeof(num), "_latency_seconds_bucket{le=\"%.9g\"}", double(bound) * 1e-9);
+            line("yeni_", n, num, cumulative);
+        }
+        line("yeni_", n, "_latency_seconds_bucket{le=\"+Inf\"}", hs.count);
+        std::snprintf(num, sizeof(num), "_latency_seconds_sum %.9g\n", double(hs.sum) * 1e-9);
+        out.append("yeni_").append(n).append(num);
+        line("yeni_", n, "_latency_seconds_count", hs.count);
+    }
+    return out;
+}
+
+void write_prometheus(const std::filesystem::path& path)
+{
+    const std::string text = prometheus_text();
+    const std::filesystem::path tmp = path.string() + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(text.data(), std::streamsize(text.size()));
+        if (!f.flush())
+            throw std::system_error(errno, std::generic_category(), "yeni: write " + tmp.string());
+    }
+    std::filesystem::rename(tmp, path);
+}
+
+http_server::http_server(std::uint16_t port, const std::string& address)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        throw std::invalid_argument("yeni: bad metrics listen address " + address);
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+        throw_errno("metrics socket");
+    const int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, 16) != 0
+        || ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        const int e = errno;
+        ::close(listen_fd_);
+        errno = e;
+        throw_errno("metrics listen on " + address + ":" + std::to_string(port));
+    }
+    port_ = ntohs(addr.sin_port);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        const int e = errno;
+        ::close(listen_fd_);
+        errno = e;
+        throw_errno("metrics eventfd");
+    }
+    thread_ = std::thread([this] { serve(); });
+}
+
+http_server::~http_server()
+{
+    const std::uint64_t one = 1;
+    while (::write(wake_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+    thread_.join();
+    ::close(listen_fd_);
+    ::close(wake_fd_);
+}
+
+void http_server::serve()
+{
+    while (true) {
+        pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        const int c = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (c < 0)
+            continue;
+        // One request per connection; a slow client only holds us for the
+        // receive timeout.
+        const timeval timeout{1, 0};
+        ::setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char req[1024];
+        std::size_t got = 0;
+        while (got < sizeof(req) - 1) {
+            const ssize_t r = ::recv(c, req + got, sizeof(req) - 1 - got, 0);
+            if (r <= 0)
+                break;
+            got += std::size_t(r);
+            req[got] = '\0';
+            if (std::strstr(req, "\r\n\r\n") || std::strstr(req, "\n\n"))
+                break;
+        }
+        const std::string_view head(req, got);
+        std::string resp;
+        if (head.starts_with("GET /metrics ") || head.starts_with("GET /metrics?")) {
+            const std::string body = prometheus_text();
+            resp = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n"
+                   "Content-Length: "
+                + std::to_string(body.size()) + "\r\n\r\n" + body;
+        } else if (head.starts_with("GET /trace ") || head.starts_with("GET /trace?")) {
+            const std::string_view target = head.substr(4, head.find(' ', 4) - 4);
+            if (const auto every = query_param(target, "sample_every"); !every.empty())
+                trace::set_sample_every(std::uint32_t(std::strtoul(std::string(every).c_str(), nullptr, 10)));
+            const std::string_view format = query_param(target, "format");
+            const std::string body = format == "otlp" ? trace::otlp_json()
+                : format == "folded"                  ? trace::folded_stacks(trace::collect())
+                                                      : trace::chrome_trace();
+            resp = std::string("HTTP/1.1 200 OK\r\nContent-Type: ")
+                + (format == "folded" ? "text/plain" : "application/json")
+                + "\r\nConnection: close\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        } else {
+            resp = "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+        }
+        for (std::size_t sent = 0; sent < resp.size();) {
+            const ssize_t w = ::send(c, resp.data() + sent, resp.size() - sent, MSG_NOSIGNAL);
+            if (w <= 0)
+                break;
+            sent += std::size_t(w);
+        }
+        ::close(c);
+    }
+}
+
+} // namespace yeni::metrics
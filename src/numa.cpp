@@ -0,0 +1,117 @@
+#include "yeni/numa.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <sched.h>
+
+namespace yeni {
+
+namespace {
+
+std::vector<unsigned> allowed_cpus()
+{
+    std::vector<unsigned> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (unsigned c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &set))
+                cpus.push_back(c);
+    }
+    if (cpus.empty())
+        cpus.push_back(0);
+    return cpus;
+}
+
+} // namespace
+
+std::vector<unsigned> numa_topology::parse_cpulist(std::string_view list)
+{
+    std::vector<unsigned> cpus;
+    while (!list.empty()) {
+        std::size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+        while (!item.empty() && (item.back() == '\n' || item.back() == ' '))
+            item.remove_suffix(1);
+        if (item.empty())
+            continue;
+        unsigned lo = 0, hi = 0;
+        std::size_t dash = item.find('-');
+        auto a = item.substr(0, dash);
+        if (std::from_chars(a.data(), a.data() + a.size(), lo).ec != std::errc{})
+            continue;
+        hi = lo;
+        if (dash != std::string_view::npos) {
+            auto b = item.substr(dash + 1);
+            if (std::from_chars(b.data(), b.data() + b.size(), hi).ec != std::errc{})
+                continue;
+        }
+        // Nothing past what a cpu_set_t can name, which also keeps the
+        // loop from wrapping at UINT_MAX.
+        if (hi >= CPU_SETSIZE)
+            continue;
+        for (unsigned c = lo; c <= hi; ++c)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+numa_topology::numa_topology()
+{
+    const auto allowed = allowed_cpus();
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/sys/devices/system/node", ec)) {
+        const std::string name = entry.path().filename().string();
+        unsigned id = 0;
+        if (name.rfind("node", 0) != 0
+            || std::from_chars(name.data() + 4, name.data() + name.size(), id).ec != std::errc{})
+            continue;
+        std::ifstream in(entry.path() / "cpulist");
+        std::string list;
+        std::getline(in, list);
+        node n{id, {}};
+        for (unsigned c : parse_cpulist(list))
+            if (std::binary_search(allowed.begin(), allowed.end(), c))
+                n.cpus.push_back(c);
+        if (!n.cpus.empty())
+            nodes_.push_back(std::move(n));
+    }
+    if (nodes_.empty())
+        nodes_.push_back(node{0, allowed});
+    std::sort(nodes_.begin(), nodes_.end(), [](const node& a, const node& b) { return a.id < b.id; });
+
+    for (const auto& n : nodes_) {
+        for (unsigned c : n.cpus) {
+            if (c >= cpu_node_.size())
+                cpu_node_.resize(c + 1, 0);
+            cpu_node_[c] = n.id;
+        }
+    }
+}
+
+const numa_topology& numa_topology::system()
+{
+    static const numa_topology topology;
+    return topology;
+}
+
+std::size_t numa_topology::cpu_count() const noexcept
+{
+    std::size_t n = 0;
+    for (const auto& node : nodes_)
+        n += node.cpus.size();
+    return n;
+}
+
+unsigned numa_topology::node_of_cpu(unsigned cpu) const noexcept
+{
+    return cpu < cpu_node_.size() ? cpu_node_[cpu] : 0;
+}
+
+} // namespace yeni
@@ -0,0 +1,340 @@
+#include "yeni/predicate.hpp"
+
+#include "predicate_kernels.hpp"
+
+#include "yeni/metrics.hpp"
+#include "yeni/segment.hpp"
+#include "yeni/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace yeni {
+
+namespace detail {
+
+namespace {
+
+template <class T>
+void scalar_compare(const T* c, std::size_t n, compare_op op, T v, std::uint64_t* out)
+{
+    with_scalar_op(op, v, [&](auto pred) { scalar_rows(c, 0, n, out, pred); });
+}
+
+template <class T>
+void scalar_range(const T* c, std::size_t n, T lo, T hi, std::uint64_t* out)
+{
+    scalar_rows(c, 0, n, out, [lo, hi](T x) { return lo <= x && x <= hi; });
+}
+
+template <class T>
+void scalar_in(const T* c, std::size_t n, const T* values, std::size_t count, std::uint64_t* out)
+{
+    scalar_rows(c, 0, n, out, [values, count](T x) {
+        bool hit = false;
+        for (std::size_t k = 0; k < count; ++k)
+            hit |= x == values[k];
+        return hit;
+    });
+}
+
+template <class T>
+constexpr predicate_kernels<T> scalar_table{&scalar_compare<T>, &scalar_range<T>, &scalar_in<T>};
+
+} // namespace
+
+const kernel_set scalar_kernels{
+    scalar_table<std::uint32_t>,
+    scalar_table<std::uint64_t>,
+    scalar_table<std::int64_t>,
+    scalar_table<double>,
+};
+
+} // namespace detail
+
+namespace {
+
+simd_level cpu_level() noexcept
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return simd_level::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return simd_level::avx2;
+#endif
+    return simd_level::scalar;
+}
+
+simd_level initial_level() noexcept
+{
+    simd_level level = cpu_level();
+    if (const char* env = std::getenv("YENI_SIMD")) {
+        simd_level cap = level;
+        if (std::strcmp(env, "scalar") == 0)
+            cap = simd_level::scalar;
+        else if (std::strcmp(env, "avx2") == 0)
+            cap = simd_level::avx2;
+        else if (std::strcmp(env, "avx512") == 0)
+            cap = simd_level::avx512;
+        level = std::min(level, cap);
+    }
+    return level;
+}
+
+std::atomic<simd_level>& level_ref() noexcept
+{
+    static std::atomic<simd_level> level{initial_level()};
+    return level;
+}
+
+// Scans are timed on every call: one call covers a whole column.
+struct scan_probe {
+    explicit scan_probe(std::size_t rows)
+        : m(metrics::local())
+        , timer(m, metrics::histogram::scan)
+        , span(trace::span_kind::scan, rows)
+    {
+        m.add(metrics::counter::scan_rows, rows);
+    }
+    metrics::thread_metrics& m;
+    metrics::scoped_timer timer;
+    trace::span span;
+};
+
+// Feeds `kernel(rows, n, words)` one scan() chunk at a time; chunks are
+// whole bitmap words apart.
+template <class T, class Kernel>
+void filter_pages(const segment& s, std::string_view column, selection_bitmap& out, Kernel&& kernel)
+{
+    scan_probe probe(s.rows());
+    out.resize_for_overwrite(s.rows());
+    std::uint64_t* words = out.words().data();
+    s.scan<T>(column, [&](std::size_t first, std::span<const T> rows) {
+        kernel(rows.data(), rows.size(), words + first / 64);
+    });
+}
+
+const detail::kernel_set& kernels() noexcept
+{
+    switch (level_ref().load(std::memory_order_relaxed)) {
+#if defined(__x86_64__)
+    case simd_level::avx512:
+        return detail::avx512_kernels;
+    case simd_level::avx2:
+        return detail::avx2_kernels;
+#endif
+    default:
+        return detail::scalar_kernels;
+    }
+}
+
+} // namespace
+
+simd_level active_simd_level() noexcept
+{
+    return level_ref().load(std::memory_order_relaxed);
+}
+
+void set_simd_level(simd_level level) noexcept
+{
+    level_ref().store(std::min(level, cpu_level()), std::memory_order_relaxed);
+}
+
+std::string_view to_string(simd_level level) noexcept
+{
+    switch (level) {
+    case simd_level::avx2:
+        return "avx2";
+    case simd_level::avx512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+template <class T>
+void filter_compare(std::span<const T> column, compare_op op, T value, selection_bitmap& out)
+{
+    scan_probe probe(column.size());
+    out.resize_for_overwrite(column.size());
+    if (!column.empty())
+        kernels().get<T>().compare(column.data(), column.size(), op, value, out.words().data());
+}
+
+template <class T>
+void filter_range(std::span<const T> column, T lo, T hi, selection_bitmap& out)
+{
+    scan_probe probe(column.size());
+    out.resize_for_overwrite(column.size());
+    if (!column.empty())
+        kernels().get<T>().range(column.data(), column.size(), lo, hi, out.words().data());
+}
+
+template <class T>
+void compare_rows(std::span<const T> rows, compare_op op, T value, std::uint64_t* out)
+{
+    if (!rows.empty())
+        kernels().get<T>().compare(rows.data(), rows.size(), op, value, out);
+}
+
+template <class T>
+void range_rows(std::span<const T> rows, T lo, T hi, std::uint64_t* out)
+{
+    if (!rows.empty())
+        kernels().get<T>().range(rows.data(), rows.size(), lo, hi, out);
+}
+
+template <class T>
+void filter_in(std::span<const T> column, std::span<const T> values, selection_bitmap& out)
+{
+    scan_probe probe(column.size());
+    std::vector<T> set(values.begin(), values.end());
+    // NaN never compares equal and would break the sort's ordering.
+    std::erase_if(set, [](T v) { return v != v; });
+    std::sort(set.begin(), set.end());
+    set.erase(std::unique(set.begin(), set.end()), set.end());
+
+    if (set.size() <= detail::max_simd_in_list) {
+        if (set.empty()) {
+            out.assign(column.size(), false);
+            return;
+        }
+        out.resize_for_overwrite(column.size());
+        if (!column.empty())
+            kernels().get<T>().in_list(column.data(), column.size(), set.data(), set.size(), out.words().data());
+        return;
+    }
+    out.resize_for_overwrite(column.size());
+    detail::scalar_rows(column.data(), 0, column.size(), out.words().data(),
+        [&](T x) {
+            // A NaN row is equivalent to every value under <, so look for
+            // an equal one rather than trusting binary_search().
+            const auto it = std::lower_bound(set.begin(), set.end(), x);
+            return it != set.end() && *it == x;
+        });
+}
+
+template <class T>
+void filter_compare(const segment& s, std::string_view column, compare_op op, T value, selection_bitmap& out)
+{
+    const auto& k = kernels().get<T>();
+    filter_pages<T>(s, column, out, [&](const T* rows, std::size_t n, std::uint64_t* words) {
+        k.compare(rows, n, op, value, words);
+    });
+}
+
+template <class T>
+void filter_range(const segment& s, std::string_view column, T lo, T hi, selection_bitmap& out)
+{
+    const auto& k = kernels().get<T>();
+    filter_pages<T>(s, column, out, [&](const T* rows, std::size_t n, std::uint64_t* words) {
+        k.range(rows, n, lo, hi, words);
+    });
+}
+
+namespace {
+
+// How a row compares with a needle: the length of their common prefix,
+// capped at the needle's, and the sign of the comparison.
+struct string_match {
+    std::size_t common = 0;
+    int order = 0;
+};
+
+// `row` given that its first `from` bytes equal the needle's.
+string_match match_from(std::size_t from, std::span<const std::byte> rest, std::string_view needle) noexcept
+{
+    const auto* n = reinterpret_cast<const std::byte*>(needle.data());
+    const std::size_t len = std::min(rest.size(), needle.size() - from);
+    std::size_t i = 0;
+    while (i < len && rest[i] == n[from + i])
+        ++i;
+    string_match m{from + i, 0};
+    if (i < len)
+        m.order = rest[i] < n[from + i] ? -1 : 1;
+    else if (rest.size() != needle.size() - from)
+        m.order = rest.size() < needle.size() - from ? -1 : 1;
+    return m;
+}
+
+bool passes(compare_op op, int order) noexcept
+{
+    switch (op) {
+    case compare_op::eq:
+        return order == 0;
+    case compare_op::ne:
+        return order != 0;
+    case compare_op::lt:
+        return order < 0;
+    case compare_op::le:
+        return order <= 0;
+    case compare_op::gt:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+// Calls `keep(match)` for every row of binary column `column` in order
+// and sets its bit if it returns true.
+template <class Keep>
+void filter_strings(const segment& s, std::string_view column, std::string_view needle, selection_bitmap& out,
+    Keep&& keep)
+{
+    scan_probe probe(s.rows());
+    out.assign(s.rows(), false);
+    if (s.encoding(column) != column_encoding::front_coded) {
+        const binary_column rows = s.binary(column);
+        for (std::size_t i = 0; i < rows.size(); ++i)
+            if (keep(match_from(0, rows[i], needle)))
+                out.set(i);
+        return;
+    }
+    // Row r shares `shared` bytes with row r-1, which matched the needle
+    // for prev.common bytes. Up to min(shared, prev.common) row r matches
+    // too; if it shares more than prev.common, it differs from the needle
+    // exactly where row r-1 does.
+    const front_coded_column rows = s.front_coded(column);
+    string_match prev;
+    rows.for_each([&](std::size_t r, std::size_t shared, std::span<const std::byte> suffix) {
+        if (shared <= prev.common)
+            prev = match_from(shared, suffix, needle);
+        if (keep(prev))
+            out.set(r);
+    });
+}
+
+} // namespace
+
+void filter_string_compare(const segment& s, std::string_view column, compare_op op, std::string_view value,
+    selection_bitmap& out)
+{
+    filter_strings(s, column, value, out, [op](const string_match& m) { return passes(op, m.order); });
+}
+
+void filter_string_prefix(const segment& s, std::string_view column, std::string_view prefix, selection_bitmap& out)
+{
+    filter_strings(s, column, prefix, out, [n = prefix.size()](const string_match& m) { return m.common == n; });
+}
+
+#define YENI_INSTANTIATE(T)                                                                              \
+    template void filter_compare<T>(std::span<const T>, compare_op, T, selection_bitmap&);             \
+    template void filter_range<T>(std::span<const T>, T, T, selection_bitmap&);                         \
+    template void filter_in<T>(std::span<const T>, std::span<const T>, selection_bitmap&);              \
+    template void compare_rows<T>(std::span<const T>, compare_op, T, std::uint64_t*);                   \
+    template void range_rows<T>(std::span<const T>, T, T, std::uint64_t*);                              \
+    template void filter_compare<T>(const segment&, std::string_view, compare_op, T, selection_bitmap&); \
+    template void filter_range<T>(const segment&, std::string_view, T, T, selection_bitmap&);
+
+YENI_INSTANTIATE(std::uint32_t)
+YENI_INSTANTIATE(std::uint64_t)
+YENI_INSTANTIATE(std::int64_t)
+YENI_INSTANTIATE(double)
+
+#undef YENI_INSTANTIATE
+
+} // namespace yeni
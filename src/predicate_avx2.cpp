@@ -0,0 +1,205 @@
+// AVX2 predicate kernels. Only this file is compiled for AVX2 (via the
+// target pragma below, after every include) and it is only entered once
+// predicate.cpp has seen the feature bit, so the library still loads on
+// older CPUs.
+
+#include "predicate_kernels.hpp"
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+#include <type_traits>
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace yeni::detail {
+
+namespace {
+
+// Per-type lane operations. Compares return one bit per lane. AVX2 only
+// has signed greater-than, so unsigned lanes are biased by flipping the
+// sign bit first; prep() applies the bias to both sides.
+
+struct u32_lanes {
+    using value_type = std::uint32_t;
+    using vec = __m256i;
+    static constexpr unsigned lanes = 8, all = 0xff;
+    static vec load(const value_type* p) { return prep(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+    static vec splat(value_type v) { return _mm256_set1_epi32(int(v ^ 0x80000000u)); }
+    static vec prep(vec x) { return _mm256_xor_si256(x, _mm256_set1_epi32(int(0x80000000u))); }
+    static unsigned bits(vec m) { return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(m))); }
+    static unsigned eq(vec a, vec b) { return bits(_mm256_cmpeq_epi32(a, b)); }
+    static unsigned gt(vec a, vec b) { return bits(_mm256_cmpgt_epi32(a, b)); }
+};
+
+template <bool Signed>
+struct x64_lanes {
+    using value_type = std::conditional_t<Signed, std::int64_t, std::uint64_t>;
+    using vec = __m256i;
+    static constexpr unsigned lanes = 4, all = 0xf;
+    static constexpr std::uint64_t bias = Signed ? 0 : std::uint64_t(1) << 63;
+    static vec load(const value_type* p) { return prep(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+    static vec splat(value_type v) { return _mm256_set1_epi64x(std::int64_t(std::uint64_t(v) ^ bias)); }
+    static vec prep(vec x)
+    {
+        if constexpr (Signed)
+            return x;
+        else
+            return _mm256_xor_si256(x, _mm256_set1_epi64x(std::int64_t(bias)));
+    }
+    static unsigned bits(vec m) { return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(m))); }
+    static unsigned eq(vec a, vec b) { return bits(_mm256_cmpeq_epi64(a, b)); }
+    static unsigned gt(vec a, vec b) { return bits(_mm256_cmpgt_epi64(a, b)); }
+};
+
+struct f64_lanes {
+    using value_type = double;
+    using vec = __m256d;
+    static constexpr unsigned lanes = 4;
+    static vec load(const value_type* p) { return _mm256_loadu_pd(p); }
+    static vec splat(value_type v) { return _mm256_set1_pd(v); }
+    template <int Imm>
+    static unsigned cmp(vec a, vec b) { return unsigned(_mm256_movemask_pd(_mm256_cmp_pd(a, b, Imm))); }
+};
+
+/// Full 64-row words through `vec_pred(vector) -> lane bits`; the tail word
+/// through `row_pred`.
+template <class L, class VecPred, class RowPred>
+void run(const typename L::value_type* c, std::size_t n, std::uint64_t* out, VecPred vec_pred, RowPred row_pred)
+{
+    const std::size_t full = n / 64;
+    for (std::size_t w = 0; w < full; ++w) {
+        const typename L::value_type* p = c + w * 64;
+        std::uint64_t bits = 0;
+        for (unsigned k = 0; k < 64 / L::lanes; ++k)
+            bits |= std::uint64_t(vec_pred(L::load(p + k * L::lanes))) << (k * L::lanes);
+        out[w] = bits;
+    }
+    scalar_rows(c, full * 64, n, out, row_pred);
+}
+
+template <class L>
+void int_compare(const typename L::value_type* c, std::size_t n, compare_op op, typename L::value_type v,
+    std::uint64_t* out)
+{
+    const auto s = L::splat(v);
+    with_scalar_op(op, v, [&](auto row_pred) {
+        switch (op) {
+        case compare_op::eq:
+            return run<L>(c, n, out, [s](auto x) { return L::eq(x, s); }, row_pred);
+        case compare_op::ne:
+            return run<L>(c, n, out, [s](auto x) { return ~L::eq(x, s) & L::all; }, row_pred);
+        case compare_op::lt:
+            return run<L>(c, n, out, [s](auto x) { return L::gt(s, x); }, row_pred);
+        case compare_op::le:
+            return run<L>(c, n, out, [s](auto x) { return ~L::gt(x, s) & L::all; }, row_pred);
+        case compare_op::gt:
+            return run<L>(c, n, out, [s](auto x) { return L::gt(x, s); }, row_pred);
+        case compare_op::ge:
+            return run<L>(c, n, out, [s](auto x) { return ~L::gt(s, x) & L::all; }, row_pred);
+        }
+    });
+}
+
+template <class L>
+void int_range(const typename L::value_type* c, std::size_t n, typename L::value_type lo,
+    typename L::value_type hi, std::uint64_t* out)
+{
+    using T = typename L::value_type;
+    const auto l = L::splat(lo), h = L::splat(hi);
+    run<L>(c, n, out, [l, h](auto x) { return ~(L::gt(l, x) | L::gt(x, h)) & L::all; },
+        [lo, hi](T x) { return lo <= x && x <= hi; });
+}
+
+template <class L>
+void int_in(const typename L::value_type* c, std::size_t n, const typename L::value_type* values,
+    std::size_t count, std::uint64_t* out)
+{
+    using T = typename L::value_type;
+    typename L::vec splats[max_simd_in_list];
+    for (std::size_t k = 0; k < count; ++k)
+        splats[k] = L::splat(values[k]);
+    run<L>(c, n, out,
+        [&](auto x) {
+            unsigned m = 0;
+            for (std::size_t k = 0; k < count; ++k)
+                m |= L::eq(x, splats[k]);
+            return m;
+        },
+        [values, count](T x) {
+            bool hit = false;
+            for (std::size_t k = 0; k < count; ++k)
+                hit |= x == values[k];
+            return hit;
+        });
+}
+
+void f64_compare(const double* c, std::size_t n, compare_op op, double v, std::uint64_t* out)
+{
+    using L = f64_lanes;
+    const auto s = L::splat(v);
+    with_scalar_op(op, v, [&](auto row_pred) {
+        switch (op) {
+        case compare_op::eq:
+            return run<L>(c, n, out, [s](auto x) { return L::cmp<_CMP_EQ_OQ>(x, s); }, row_pred);
+        case compare_op::ne:
+            return run<L>(c, n, out, [s](auto x) { return L::cmp<_CMP_NEQ_UQ>(x, s); }, row_pred);
+        case compare_op::lt:
+            return run<L>(c, n, out, [s](auto x) { return L::cmp<_CMP_LT_OQ>(x, s); }, row_pred);
+        case compare_op::le:
+            return run<L>(c, n, out, [s](auto x) { return L::cmp<_CMP_LE_OQ>(x, s); }, row_pred);
+        case compare_op::gt:
+            return run<L>(c, n, out, [s](auto x) { return L::cmp<_CMP_GT_OQ>(x, s); }, row_pred);
+        case compare_op::ge:
+            return run<L>(c, n, out, [s](auto x) { return L::cmp<_CMP_GE_OQ>(x, s); }, row_pred);
+        }
+    });
+}
+
+void f64_range(const double* c, std::size_t n, double lo, double hi, std::uint64_t* out)
+{
+    using L = f64_lanes;
+    const auto l = L::splat(lo), h = L::splat(hi);
+    run<L>(c, n, out, [l, h](auto x) { return L::cmp<_CMP_GE_OQ>(x, l) & L::cmp<_CMP_LE_OQ>(x, h); },
+        [lo, hi](double x) { return lo <= x && x <= hi; });
+}
+
+void f64_in(const double* c, std::size_t n, const double* values, std::size_t count, std::uint64_t* out)
+{
+    using L = f64_lanes;
+    L::vec splats[max_simd_in_list];
+    for (std::size_t k = 0; k < count; ++k)
+        splats[k] = L::splat(values[k]);
+    run<L>(c, n, out,
+        [&](auto x) {
+            unsigned m = 0;
+            for (std::size_t k = 0; k < count; ++k)
+                m |= L::cmp<_CMP_EQ_OQ>(x, splats[k]);
+            return m;
+        },
+        [values, count](double x) {
+            bool hit = false;
+            for (std::size_t k = 0; k < count; ++k)
+                hit |= x == values[k];
+            return hit;
+        });
+}
+
+template <class L>
+constexpr predicate_kernels<typename L::value_type> int_table{&int_compare<L>, &int_range<L>, &int_in<L>};
+
+} // namespace
+
+const kernel_set avx2_kernels{
+    int_table<u32_lanes>,
+    int_table<x64_lanes<false>>,
+    int_table<x64_lanes<true>>,
+    {&f64_compare, &f64_range, &f64_in},
+};
+
+} // namespace yeni::detail
+
+#pragma GCC pop_options
+
+#endif
@@ -0,0 +1,160 @@
+// AVX-512 predicate kernels; compiled and dispatched like predicate_avx2.cpp.
+// Compares write mask registers directly, so every operator is a single
+// instruction per vector and no sign-bias trick is needed.
+
+#include "predicate_kernels.hpp"
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl")
+
+namespace yeni::detail {
+
+namespace {
+
+struct u32_lanes {
+    using value_type = std::uint32_t;
+    using vec = __m512i;
+    static constexpr unsigned lanes = 16;
+    static vec load(const value_type* p) { return _mm512_loadu_si512(p); }
+    static vec splat(value_type v) { return _mm512_set1_epi32(int(v)); }
+    template <int Imm>
+    static unsigned cmp(vec a, vec b) { return _mm512_cmp_epu32_mask(a, b, Imm); }
+};
+
+struct u64_lanes {
+    using value_type = std::uint64_t;
+    using vec = __m512i;
+    static constexpr unsigned lanes = 8;
+    static vec load(const value_type* p) { return _mm512_loadu_si512(p); }
+    static vec splat(value_type v) { return _mm512_set1_epi64(std::int64_t(v)); }
+    template <int Imm>
+    static unsigned cmp(vec a, vec b) { return _mm512_cmp_epu64_mask(a, b, Imm); }
+};
+
+struct i64_lanes {
+    using value_type = std::int64_t;
+    using vec = __m512i;
+    static constexpr unsigned lanes = 8;
+    static vec load(const value_type* p) { return _mm512_loadu_si512(p); }
+    static vec splat(value_type v) { return _mm512_set1_epi64(v); }
+    template <int Imm>
+    static unsigned cmp(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, Imm); }
+};
+
+struct f64_lanes {
+    using value_type = double;
+    using vec = __m512d;
+    static constexpr unsigned lanes = 8;
+    static vec load(const value_type* p) { return _mm512_loadu_pd(p); }
+    static vec splat(value_type v) { return _mm512_set1_pd(v); }
+    template <int Imm>
+    static unsigned cmp(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, Imm); }
+};
+
+// Immediates per operator: integer compares take _MM_CMPINT_*, doubles
+// take ordered predicates (unordered for ne, matching C++ NaN semantics).
+template <class L>
+struct imm {
+    static constexpr int eq = _MM_CMPINT_EQ, ne = _MM_CMPINT_NE, lt = _MM_CMPINT_LT, le = _MM_CMPINT_LE,
+                         gt = _MM_CMPINT_NLE, ge = _MM_CMPINT_NLT;
+};
+template <>
+struct imm<f64_lanes> {
+    static constexpr int eq = _CMP_EQ_OQ, ne = _CMP_NEQ_UQ, lt = _CMP_LT_OQ, le = _CMP_LE_OQ, gt = _CMP_GT_OQ,
+                         ge = _CMP_GE_OQ;
+};
+
+template <class L, class VecPred, class RowPred>
+void run(const typename L::value_type* c, std::size_t n, std::uint64_t* out, VecPred vec_pred, RowPred row_pred)
+{
+    const std::size_t full = n / 64;
+    for (std::size_t w = 0; w < full; ++w) {
+        const typename L::value_type* p = c + w * 64;
+        std::uint64_t bits = 0;
+        for (unsigned k = 0; k < 64 / L::lanes; ++k)
+            bits |= std::uint64_t(vec_pred(L::load(p + k * L::lanes))) << (k * L::lanes);
+        out[w] = bits;
+    }
+    scalar_rows(c, full * 64, n, out, row_pred);
+}
+
+template <class L>
+void compare(const typename L::value_type* c, std::size_t n, compare_op op, typename L::value_type v,
+    std::uint64_t* out)
+{
+    using I = imm<L>;
+    const auto s = L::splat(v);
+    with_scalar_op(op, v, [&](auto row_pred) {
+        switch (op) {
+        case compare_op::eq:
+            return run<L>(c, n, out, [s](auto x) { return L::template cmp<I::eq>(x, s); }, row_pred);
+        case compare_op::ne:
+            return run<L>(c, n, out, [s](auto x) { return L::template cmp<I::ne>(x, s); }, row_pred);
+        case compare_op::lt:
+            return run<L>(c, n, out, [s](auto x) { return L::template cmp<I::lt>(x, s); }, row_pred);
+        case compare_op::le:
+            return run<L>(c, n, out, [s](auto x) { return L::template cmp<I::le>(x, s); }, row_pred);
+        case compare_op::gt:
+            return run<L>(c, n, out, [s](auto x) { return L::template cmp<I::gt>(x, s); }, row_pred);
+        case compare_op::ge:
+            return run<L>(c, n, out, [s](auto x) { return L::template cmp<I::ge>(x, s); }, row_pred);
+        }
+    });
+}
+
+template <class L>
+void range(const typename L::value_type* c, std::size_t n, typename L::value_type lo, typename L::value_type hi,
+    std::uint64_t* out)
+{
+    using I = imm<L>;
+    using T = typename L::value_type;
+    const auto l = L::splat(lo), h = L::splat(hi);
+    run<L>(c, n, out, [l, h](auto x) { return L::template cmp<I::ge>(x, l) & L::template cmp<I::le>(x, h); },
+        [lo, hi](T x) { return lo <= x && x <= hi; });
+}
+
+template <class L>
+void in_list(const typename L::value_type* c, std::size_t n, const typename L::value_type* values,
+    std::size_t count, std::uint64_t* out)
+{
+    using I = imm<L>;
+    using T = typename L::value_type;
+    typename L::vec splats[max_simd_in_list];
+    for (std::size_t k = 0; k < count; ++k)
+        splats[k] = L::splat(values[k]);
+    run<L>(c, n, out,
+        [&](auto x) {
+            unsigned m = 0;
+            for (std::size_t k = 0; k < count; ++k)
+                m |= L::template cmp<I::eq>(x, splats[k]);
+            return m;
+        },
+        [values, count](T x) {
+            bool hit = false;
+            for (std::size_t k = 0; k < count; ++k)
+                hit |= x == values[k];
+            return hit;
+        });
+}
+
+template <class L>
+constexpr predicate_kernels<typename L::value_type> table{&compare<L>, &range<L>, &in_list<L>};
+
+} // namespace
+
+const kernel_set avx512_kernels{
+    table<u32_lanes>,
+    table<u64_lanes>,
+    table<i64_lanes>,
+    table<f64_lanes>,
+};
+
+} // namespace yeni::detail
+
+#pragma GCC pop_options
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+
+// Kernel tables behind yeni/predicate.hpp. One table per instruction set;
+// predicate.cpp picks the table at startup.
+
+#include "yeni/predicate.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yeni::detail {
+
+/// Longest IN-list matched by broadcasting every value; longer lists go
+/// through a sorted probe in predicate.cpp.
+inline constexpr std::size_t max_simd_in_list = 32;
+
+/// All kernels write ceil(n / 64) words to `out`, clearing bits past n.
+template <class T>
+struct predicate_kernels {
+    void (*compare)(const T* column, std::size_t n, compare_op op, T value, std::uint64_t* out);
+    void (*range)(const T* column, std::size_t n, T lo, T hi, std::uint64_t* out);
+    void (*in_list)(const T* column, std::size_t n, const T* values, std::size_t count, std::uint64_t* out);
+};
+
+struct kernel_set {
+    predicate_kernels<std::uint32_t> u32;
+    predicate_kernels<std::uint64_t> u64;
+    predicate_kernels<std::int64_t> i64;
+    predicate_kernels<double> f64;
+
+    template <class T>
+    const predicate_kernels<T>& get() const noexcept;
+};
+
+template <>
+inline const predicate_kernels<std::uint32_t>& kernel_set::get<std::uint32_t>() const noexcept
+{
+    return u32;
+}
+template <>
+inline const predicate_kernels<std::uint64_t>& kernel_set::get<std::uint64_t>() const noexcept
+{
+    return u64;
+}
+template <>
+inline const predicate_kernels<std::int64_t>& kernel_set::get<std::int64_t>() const noexcept
+{
+    return i64;
+}
+template <>
+inline const predicate_kernels<double>& kernel_set::get<double>() const noexcept
+{
+    return f64;
+}
+
+extern const kernel_set scalar_kernels;
+#if defined(__x86_64__)
+extern const kernel_set avx2_kernels;
+extern const kernel_set avx512_kernels;
+#endif
+
+// Internal linkage on purpose: the SIMD translation units instantiate these
+// for their tails, and they must not be merged with copies compiled for a
+// different target.
+namespace {
+
+/// Bits [from, n) of the bitmap, computed one row at a time.
+template <class T, class Pred>
+inline void scalar_rows(const T* column, std::size_t from, std::size_t n, std::uint64_t* out, Pred pred)
+{
+    for (std::size_t w = from / 64; w * 64 < n; ++w) {
+        const std::size_t end = n - w * 64 < 64 ? n - w * 64 : 64;
+        std::uint64_t bits = 0;
+        for (std::size_t j = 0; j < end; ++j)
+            bits |= std::uint64_t(pred(column[w * 64 + j])) << j;
+        out[w] = bits;
+    }
+}
+
+template <class T, class F>
+inline void with_scalar_op(compare_op op, T v, F&& f)
+{
+    switch (op) {
+    case compare_op::eq:
+        return f([v](T x) { return x == v; });
+    case compare_op::ne:
+        return f([v](T x) { return x != v; });
+    case compare_op::lt:
+        return f([v](T x) { return x < v; });
+    case compare_op::le:
+        return f([v](T x) { return x <= v; });
+    case compare_op::gt:
+        return f([v](T x) { return x > v; });
+    case compare_op::ge:
+        return f([v](T x) { return x >= v; });
+    }
+}
+
+} // namespace
+
+} // namespace yeni::detail
@@ -0,0 +1,335 @@
+#include "yeni/record_store.hpp"
+
+#include "yeni/metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace yeni {
+
+namespace {
+
+std::atomic<std::uint64_t> next_store_id{1};
+std::atomic<std::uint64_t> next_thread_id{1};
+
+// Per-thread map from store id to that thread's shard. Ids are never reused,
+// so entries for destroyed stores are merely dead weight until evicted. An
+// evicted shard stays with its store; the next miss finds it by `thread`.
+struct shard_cache {
+    static constexpr std::size_t capacity = 8;
+
+    // Unlike std::thread::id, never reused by a later thread.
+    const std::uint64_t thread = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+
+    struct entry {
+        std::uint64_t id;
+        void* shard;
+    };
+
+    entry last{0, nullptr};
+    std::size_t count = 0;
+    entry entries[capacity];
+
+    void* find(std::uint64_t id) noexcept
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (entries[i].id == id) {
+                last = entries[i];
+                return last.shard;
+            }
+        }
+        return nullptr;
+    }
+
+    void insert(std::uint64_t id, void* shard) noexcept
+    {
+        if (count == capacity) {
+            std::move(entries + 1, entries + capacity, entries);
+            --count;
+        }
+        entries[count++] = {id, shard};
+        last = {id, shard};
+    }
+};
+
+thread_local shard_cache tls_shards;
+
+// Makes `r` the newest version of `key`.
+template <class Map>
+void link(Map& map, std::uint64_t key, std::size_t hash, record* r)
+{
+    auto [it, inserted] = map.try_emplace_hashed(key, hash, r);
+    if (!inserted) {
+        r->prev = it->second;
+        it->second = r;
+    }
+}
+
+// Holds the index stripes whose bits are set in `mask`, taken lowest
+// first so that two batches never wait on each other in a cycle.
+template <bool Shared, class Stripes>
+class stripe_guard {
+public:
+    stripe_guard(const Stripes& stripes, std::uint64_t mask) : stripes_(stripes), mask_(mask)
+    {
+        for (std::uint64_t m = mask; m; m &= m - 1) {
+            auto& mutex = stripes_[std::countr_zero(m)].mutex;
+            if constexpr (Shared)
+                mutex.lock_shared();
+            else
+                mutex.lock();
+        }
+    }
+    ~stripe_guard()
+    {
+        for (std::uint64_t m = mask_; m; m &= m - 1) {
+            auto& mutex = stripes_[std::countr_zero(m)].mutex;
+            if constexpr (Shared)
+                mutex.unlock_shared();
+            else
+                mutex.unlock();
+        }
+    }
+
+    stripe_guard(const stripe_guard&) = delete;
+    stripe_guard& operator=(const stripe_guard&) = delete;
+
+private:
+    const Stripes& stripes_;
+    std::uint64_t mask_;
+};
+
+} // namespace
+
+record_store::record_store(std::size_t arena_block_size, memory_provider& memory)
+    : id_(next_store_id.fetch_add(1, std::memory_order_relaxed))
+    , block_size_(arena_block_size)
+    , memory_(memory)
+    , index_(std::make_unique<index_stripe[]>(std::size_t(1) << index_stripe_bits))
+{
+    for (std::size_t i = 0; i < (std::size_t(1) << index_stripe_bits); ++i)
+        index_[i].map = flat_hash_map<std::uint64_t, const record*>(memory);
+}
+
+record_store::~record_store() = default;
+
+record_store::shard& record_store::local_shard()
+{
+    auto& cache = tls_shards;
+    if (cache.last.id == id_)
+        return *static_cast<shard*>(cache.last.shard);
+    if (void* s = cache.find(id_))
+        return *static_cast<shard*>(s);
+    return register_shard();
+}
+
+record_store::shard& record_store::register_shard()
+{
+    auto& cache = tls_shards;
+    shard* raw = nullptr;
+    {
+        std::lock_guard lock(shards_mutex_);
+        for (const auto& s : shards_) {
+            if (s->owner == cache.thread) {
+                raw = s.get();
+                break;
+            }
+        }
+        if (!raw) {
+            shards_.push_back(std::make_unique<shard>(cache.thread, block_size_, memory_));
+            raw = shards_.back().get();
+        }
+    }
+    cache.insert(id_, raw);
+    return *raw;
+}
+
+const record* record_store::append(std::uint64_t key, std::span<const std::byte> value)
+{
+    if (value.size() > std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("yeni: record value too large");
+    auto& m = metrics::local();
+    metrics::scoped_timer timer(m, metrics::histogram::insert, m.sample(metrics::histogram::insert));
+    m.add(metrics::counter::inserts);
+    m.add(metrics::counter::insert_bytes, value.size());
+    shard& s = local_shard();
+    void* mem = s.records->allocate(record::footprint(value.size()), record::alignment);
+    auto* r = new (mem) record{key, 0, nullptr, static_cast<std::uint32_t>(value.size()), 0};
+    if (!value.empty())
+        std::memcpy(r + 1, value.data(), value.size());
+    s.count.store(s.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    const std::size_t h = yeni::hash<std::uint64_t>{}(key);
+    index_stripe& stripe = index_[stripe_of(h)];
+    {
+        std::lock_guard lock(stripe.mutex);
+        link(stripe.map, key, h, r);
+        // Numbered under the stripe lock: a snapshot taken before this
+        // cannot include it, one taken after waits for the lock to see it.
+        r->seq = next_seq_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    return r;
+}
+
+const record* record_store::find(std::uint64_t key) const
+{
+    auto& m = metrics::local();
+    metrics::scoped_timer timer(m, metrics::histogram::lookup, m.sample(metrics::histogram::lookup));
+    m.add(metrics::counter::lookups);
+    const std::size_t h = yeni::hash<std::uint64_t>{}(key);
+    const index_stripe& stripe = index_[stripe_of(h)];
+    std::shared_lock lock(stripe.mutex);
+    auto it = stripe.map.find(key, h);
+    if (it == stripe.map.end())
+        return nullptr;
+    m.add(metrics::counter::lookup_hits);
+    return it->second;
+}
+
+void record_store::append_many(std::span<const std::uint64_t> keys,
+    std::span<const std::span<const std::byte>> values, std::span<const record*> out)
+{
+    if (values.size() != keys.size() || (!out.empty() && out.size() != keys.size()))
+        throw std::invalid_argument("yeni: append_many needs one value (and output) per key");
+    std::size_t bytes = 0;
+    for (const auto& v : values) {
+        if (v.size() > std::numeric_limits<std::uint32_t>::max())
+            throw std::length_error("yeni: record value too large");
+        bytes += v.size();
+    }
+    static_assert(index_stripe_bits <= 6, "stripe masks are 64 bits");
+    auto& m = metrics::local();
+    m.add(metrics::counter::inserts, keys.size());
+    m.add(metrics::counter::insert_bytes, bytes);
+    shard& s = local_shard();
+
+    record* records[batch_window];
+    std::size_t hashes[batch_window];
+    for (std::size_t base = 0; base < keys.size(); base += batch_window) {
+        const std::size_t n = std::min(batch_window, keys.size() - base);
+        std::uint64_t touched = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto value = values[base + i];
+            void* mem = s.records->allocate(record::footprint(value.size()), record::alignment);
+            auto* r = new (mem) record{keys[base + i], 0, nullptr, static_cast<std::uint32_t>(value.size()), 0};
+            if (!value.empty())
+                std::memcpy(r + 1, value.data(), value.size());
+            records[i] = r;
+            hashes[i] = yeni::hash<std::uint64_t>{}(keys[base + i]);
+            touched |= std::uint64_t(1) << stripe_of(hashes[i]);
+        }
+        s.count.store(s.count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        {
+            stripe_guard<false, std::unique_ptr<index_stripe[]>> lock(index_, touched);
+            for (std::size_t i = 0; i < n; ++i)
+                index_[stripe_of(hashes[i])].map.prefetch(hashes[i]);
+            for (std::size_t i = 0; i < n; ++i)
+                link(index_[stripe_of(hashes[i])].map, keys[base + i], hashes[i], records[i]);
+            const std::uint64_t first = next_seq_.fetch_add(n, std::memory_order_relaxed) + 1;
+            for (std::size_t i = 0; i < n; ++i)
+                records[i]->seq = first + i;
+        }
+        if (!out.empty())
+            std::copy_n(records, n, out.begin() + std::ptrdiff_t(base));
+    }
+}
+
+const record* record_store::find_at(std::uint64_t key, std::uint64_t seq) const
+{
+    auto& m = metrics::local();
+    m.add(metrics::counter::lookups);
+    const std::size_t h = yeni::hash<std::uint64_t>{}(key);
+    const index_stripe& stripe = index_[stripe_of(h)];
+    std::shared_lock lock(stripe.mutex);
+    auto it = stripe.map.find(key, h);
+    if (it == stripe.map.end())
+        return nullptr;
+    const record* r = it->second;
+    while (r && r->seq > seq)
+        r = r->prev;
+    if (r)
+        m.add(metrics::counter::lookup_hits);
+    return r;
+}
+
+std::size_t record_store::find_many(std::span<const std::uint64_t> keys, std::span<const record*> out) const
+{
+    if (out.size() != keys.size())
+        throw std::invalid_argument("yeni: find_many needs one output per key");
+    auto& m = metrics::local();
+    std::size_t hits = 0;
+    std::size_t hashes[batch_window];
+    for (std::size_t base = 0; base < keys.size(); base += batch_window) {
+        const std::size_t n = std::min(batch_window, keys.size() - base);
+        std::uint64_t touched = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            hashes[i] = yeni::hash<std::uint64_t>{}(keys[base + i]);
+            touched |= std::uint64_t(1) << stripe_of(hashes[i]);
+        }
+        stripe_guard<true, std::unique_ptr<index_stripe[]>> lock(index_, touched);
+        for (std::size_t i = 0; i < n; ++i)
+            index_[stripe_of(hashes[i])].map.prefetch(hashes[i]);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto& map = index_[stripe_of(hashes[i])].map;
+            auto it = map.find(keys[base + i], hashes[i]);
+            const record* r = it == map.end() ? nullptr : it->second;
+            out[base + i] = r;
+            hits += r != nullptr;
+        }
+    }
+    m.add(metrics::counter::lookups, keys.size());
+    m.add(metrics::counter::lookup_hits, hits);
+    return hits;
+}
+
+std::size_t record_store::size() const
+{
+    std::lock_guard lock(shards_mutex_);
+    std::size_t total = 0;
+    for (const auto& s : shards_)
+        total += s->count.load(std::memory_order_relaxed);
+    return total;
+}
+
+std::size_t record_store::bytes_reserved() const
+{
+    std::lock_guard lock(shards_mutex_);
+    std::size_t total = 0;
+    for (const auto& s : shards_)
+        total += s->records->bytes_reserved();
+    return total;
+}
+
+void record_store::reset()
+{
+    std::lock_guard lock(shards_mutex_);
+    for (std::size_t i = 0; i < (std::size_t(1) << index_stripe_bits); ++i) {
+        std::lock_guard stripe_lock(index_[i].mutex);
+        index_[i].map.clear();
+    }
+    // Unlinked now, but a reader may still hold records it found earlier.
+    // Alternate between two arenas so that a steady flush-and-reset cycle
+    // keeps reusing warm blocks, falling back to a fresh arena while a
+    // guard outlives a whole cycle.
+    for (auto& s : shards_) {
+        std::unique_ptr<arena> next;
+        if (s->spare && epoch::reclaimable(s->spare_stamp)) {
+            next = std::move(s->spare);
+            next->reset();
+        } else {
+            if (s->spare)
+                epoch::retire(s->spare.release());
+            next = std::make_unique<arena>(block_size_, memory_);
+        }
+        s->spare = std::exchange(s->records, std::move(next));
+        s->spare_stamp = epoch::stamp();
+        s->count.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace yeni
@@ -0,0 +1,478 @@
+#include "yeni/replication.hpp"
+
+#include "yeni/crc32c.hpp"
+#include "yeni/error.hpp"
+#include "yeni/futex.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/scheduler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace yeni {
+
+namespace fmt = replication_format;
+
+namespace {
+
+// How often blocked senders and ackers look up to see whether to stop.
+constexpr std::chrono::milliseconds poll_interval{50};
+
+bool send_all(int fd, const void* p, std::size_t n, int flags = 0) noexcept
+{
+    const auto* b = static_cast<const std::byte*>(p);
+    while (n) {
+        const ssize_t w = ::send(fd, b, n, flags | MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        b += w;
+        n -= std::size_t(w);
+    }
+    return true;
+}
+
+bool send_file(int fd, int file, std::uint64_t offset, std::size_t n) noexcept
+{
+    auto off = off_t(offset);
+    while (n) {
+        const ssize_t w = ::sendfile(fd, file, &off, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        n -= std::size_t(w);
+    }
+    return true;
+}
+
+bool recv_all(int fd, void* p, std::size_t n) noexcept
+{
+    auto* b = static_cast<std::byte*>(p);
+    while (n) {
+        const ssize_t r = ::recv(fd, b, n, 0);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        b += r;
+        n -= std::size_t(r);
+    }
+    return true;
+}
+
+std::uint32_t header_crc(const fmt::batch_header& h) noexcept
+{
+    return crc32c(std::as_bytes(std::span(&h, 1)).subspan(sizeof(h.crc)));
+}
+
+sockaddr_in socket_address(const std::string& address, std::uint16_t port)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        throw std::invalid_argument("yeni: bad replication address " + address);
+    return addr;
+}
+
+void set_nodelay(int fd) noexcept
+{
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+} // namespace
+
+struct replication_leader::follower {
+    int fd = -1;
+    std::uint64_t from_lsn = 0;
+    std::atomic<bool> done{false};
+    // Under the leader's mutex.
+    std::uint64_t applied = 0;
+    std::uint64_t durable = 0;
+    std::uint64_t sent_bytes = 0;
+    std::uint64_t acked_bytes = 0;
+    std::deque<std::pair<std::uint64_t, std::uint64_t>> inflight; // last LSN of a batch, sent_bytes after it
+    std::thread sender;
+    std::thread receiver;
+};
+
+replication_leader::replication_leader(wal& log, replication_leader_options options)
+    : log_(log)
+    , options_(std::move(options))
+{
+    if (options_.max_batch_bytes == 0 || options_.max_inflight_bytes == 0)
+        throw std::invalid_argument("yeni: bad replication options");
+    sockaddr_in addr = socket_address(options_.address, options_.port);
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+        throw_errno("replication socket");
+    const int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, 16) != 0
+        || ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        const int e = errno;
+        ::close(listen_fd_);
+        errno = e;
+        throw_errno("replication listen on " + options_.address + ":" + std::to_string(options_.port));
+    }
+    port_ = ntohs(addr.sin_port);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        const int e = errno;
+        ::close(listen_fd_);
+        errno = e;
+        throw_errno("replication eventfd");
+    }
+    thread_ = std::thread([this] { serve(); });
+}
+
+replication_leader::~replication_leader()
+{
+    const std::uint64_t one = 1;
+    while (::write(wake_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+    thread_.join();
+    for (auto& f : followers_)
+        disconnect(*f);
+    for (auto& f : followers_) {
+        f->sender.join();
+        f->receiver.join();
+        ::close(f->fd);
+    }
+    ::close(listen_fd_);
+    ::close(wake_fd_);
+}
+
+void replication_leader::disconnect(follower& f) noexcept
+{
+    {
+        std::lock_guard lock(mutex_);
+        f.done.store(true, std::memory_order_relaxed);
+    }
+    ::shutdown(f.fd, SHUT_RDWR);
+    acked_cv_.notify_all();
+}
+
+void replication_leader::reap()
+{
+    std::vector<std::unique_ptr<follower>> gone;
+    {
+        std::lock_guard lock(mutex_);
+        const auto live = std::partition(followers_.begin(), followers_.end(),
+            [](const auto& f) { return !f->done.load(std::memory_order_relaxed); });
+        gone.assign(std::make_move_iterator(live), std::make_move_iterator(followers_.end()));
+        followers_.erase(live, followers_.end());
+    }
+    for (auto& f : gone) {
+        f->sender.join();
+        f->receiver.join();
+        ::close(f->fd);
+    }
+}
+
+void replication_leader::serve()
+{
+    while (true) {
+        pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        const int n = ::poll(fds, 2, 1000);
+        if (n < 0 && errno != EINTR)
+            return;
+        if (fds[1].revents)
+            return;
+        reap();
+        if (n <= 0 || !fds[0].revents)
+            continue;
+        const int c = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (c < 0)
+            continue;
+        // A follower that does not say hello only holds us for the receive
+        // timeout.
+        timeval timeout{1, 0};
+        ::setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        fmt::hello h;
+        if (!recv_all(c, &h, sizeof(h)) || std::memcmp(h.magic, fmt::magic, sizeof(h.magic)) != 0
+            || h.version != fmt::version || h.from_lsn == 0) {
+            ::close(c);
+            continue;
+        }
+        timeout = {0, 0};
+        ::setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        set_nodelay(c);
+
+        auto f = std::make_unique<follower>();
+        f->fd = c;
+        f->from_lsn = h.from_lsn;
+        f->applied = f->durable = h.from_lsn - 1;
+        follower& ref = *f;
+        {
+            std::lock_guard lock(mutex_);
+            followers_.push_back(std::move(f));
+        }
+        ref.sender = std::thread([this, &ref] { ship(ref); });
+        ref.receiver = std::thread([this, &ref] { receive_acks(ref); });
+    }
+}
+
+void replication_leader::ship(follower& f) noexcept
+{
+    // sendfile() has no MSG_NOSIGNAL: a follower going away must not raise
+    // SIGPIPE for the process. A signal this blocks dies with the thread.
+    sigset_t pipe;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    ::pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+
+    auto& m = metrics::local();
+    try {
+        wal_cursor cursor(log_, f.from_lsn);
+        while (!f.done.load(std::memory_order_relaxed)) {
+            {
+                std::unique_lock lock(mutex_);
+                if (!acked_cv_.wait_for(lock, poll_interval, [&] {
+                        return f.done.load(std::memory_order_relaxed)
+                            || f.sent_bytes - f.acked_bytes < options_.max_inflight_bytes;
+                    }))
+                    continue;
+            }
+            wal_range r;
+            if (!cursor.next(r, options_.max_batch_bytes, poll_interval))
+                continue;
+            fmt::batch_header h{0, 0, r.first_lsn, r.last_lsn, r.size};
+            h.crc = header_crc(h);
+            // The header waits for the records, so both go out in as few
+            // segments as the TCP window allows.
+            if (!send_all(f.fd, &h, sizeof(h), MSG_MORE) || !send_file(f.fd, r.fd, r.offset, r.size))
+                break;
+            {
+                std::lock_guard lock(mutex_);
+                f.sent_bytes += r.size;
+                f.inflight.emplace_back(r.last_lsn, f.sent_bytes);
+            }
+            m.add(metrics::counter::replication_batches);
+            m.add(metrics::counter::replication_bytes, r.size);
+        }
+    } catch (...) {
+        // Start no longer in the log, or the log failed: drop the follower.
+    }
+    disconnect(f);
+}
+
+void replication_leader::receive_acks(follower& f) noexcept
+{
+    fmt::ack a;
+    while (recv_all(f.fd, &a, sizeof(a))) {
+        {
+            std::lock_guard lock(mutex_);
+            f.applied = std::max(f.applied, a.applied_lsn);
+            f.durable = std::max(f.durable, a.durable_lsn);
+            while (!f.inflight.empty() && f.inflight.front().first <= f.applied) {
+                f.acked_bytes = f.inflight.front().second;
+                f.inflight.pop_front();
+            }
+        }
+        acked_cv_.notify_all();
+    }
+    disconnect(f);
+}
+
+std::size_t replication_leader::followers() const
+{
+    std::lock_guard lock(mutex_);
+    return std::size_t(std::count_if(followers_.begin(), followers_.end(),
+        [](const auto& f) { return !f->done.load(std::memory_order_relaxed); }));
+}
+
+std::uint64_t replication_leader::replicated_locked(std::size_t count) const
+{
+    if (count == 0)
+        return log_.durable_lsn();
+    std::vector<std::uint64_t> durable;
+    for (const auto& f : followers_)
+        if (!f->done.load(std::memory_order_relaxed))
+            durable.push_back(f->durable);
+    if (durable.size() < count)
+        return 0;
+    std::nth_element(durable.begin(), durable.begin() + std::ptrdiff_t(count - 1), durable.end(), std::greater<>());
+    return durable[count - 1];
+}
+
+std::uint64_t replication_leader::replicated_lsn(std::size_t count) const
+{
+    std::lock_guard lock(mutex_);
+    return replicated_locked(count);
+}
+
+bool replication_leader::wait_replicated(std::uint64_t lsn, std::size_t count, std::chrono::nanoseconds timeout)
+{
+    std::unique_lock lock(mutex_);
+    return acked_cv_.wait_for(lock, timeout, [&] { return replicated_locked(count) >= lsn; });
+}
+
+replication_follower::replication_follower(replication_follower_options options) : options_(std::move(options))
+{
+    if (!options_.apply)
+        throw std::invalid_argument("yeni: replication_follower needs an apply function");
+    const std::uint64_t from = options_.log ? options_.log->next_lsn() : options_.from_lsn;
+    if (from == 0)
+        throw std::invalid_argument("yeni: replication starts at LSN 1 or later");
+    unsigned partitions = 1;
+    if (options_.key_of)
+        partitions = options_.partitions ? options_.partitions : std::max(1U, scheduler::instance().worker_count());
+    partitions_.resize(partitions);
+
+    const sockaddr_in addr = socket_address(options_.address, options_.port);
+    fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0)
+        throw_errno("replication socket");
+    fmt::hello h{};
+    std::memcpy(h.magic, fmt::magic, sizeof(h.magic));
+    h.version = fmt::version;
+    h.from_lsn = from;
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || !send_all(fd_, &h, sizeof(h))) {
+        const int e = errno;
+        ::close(fd_);
+        errno = e;
+        throw_errno("replication connect to " + options_.address + ":" + std::to_string(options_.port));
+    }
+    set_nodelay(fd_);
+    applied_lsn_.store(from - 1, std::memory_order_relaxed);
+    receiver_ = std::thread([this] { receive(); });
+    acker_ = std::thread([this] { send_acks(); });
+}
+
+replication_follower::~replication_follower()
+{
+    stop_.store(true, std::memory_order_relaxed);
+    ::shutdown(fd_, SHUT_RDWR);
+    batches_.fetch_add(1, std::memory_order_release);
+    futex_wake(batches_);
+    receiver_.join();
+    acker_.join();
+    ::close(fd_);
+}
+
+void replication_follower::apply(std::span<const wal_entry> records)
+{
+    if (partitions_.size() == 1) {
+        options_.apply(0, records);
+        return;
+    }
+    for (auto& p : partitions_)
+        p.clear();
+    for (const wal_entry& e : records)
+        partitions_[mix64(options_.key_of(e.payload)) % partitions_.size()].push_back(e);
+    scheduler::instance().parallel_for(0, partitions_.size(), 1, [&](std::size_t b, std::size_t e) {
+        for (std::size_t p = b; p < e; ++p)
+            if (!partitions_[p].empty())
+                options_.apply(unsigned(p), partitions_[p]);
+    });
+}
+
+void replication_follower::receive() noexcept
+{
+    auto& m = metrics::local();
+    std::vector<std::byte> bytes;
+    std::vector<wal_entry> records;
+    try {
+        std::uint64_t expected = applied_lsn_.load(std::memory_order_relaxed) + 1;
+        while (true) {
+            fmt::batch_header h;
+            if (!recv_all(fd_, &h, sizeof(h))) {
+                if (stop_.load(std::memory_order_relaxed))
+                    return;
+                throw std::runtime_error("yeni: replication stream closed by the leader");
+            }
+            if (header_crc(h) != h.crc || h.first_lsn != expected || h.last_lsn < h.first_lsn
+                || h.bytes > std::uint64_t(1) << 32)
+                throw format_error("yeni: damaged replication batch header");
+            bytes.resize(std::size_t(h.bytes));
+            if (!recv_all(fd_, bytes.data(), bytes.size()))
+                throw std::runtime_error("yeni: replication stream closed by the leader");
+            records.clear();
+            decode_wal_records(bytes, h.first_lsn, records);
+            if (records.size() != h.last_lsn - h.first_lsn + 1)
+                throw format_error("yeni: replication batch holds the wrong records");
+            // Into the local log before applying, so that its commit
+            // overlaps with the apply.
+            if (options_.log)
+                options_.log->append_records(bytes, h.first_lsn);
+            apply(records);
+            m.add(metrics::counter::replication_records_applied, records.size());
+            applied_lsn_.store(h.last_lsn, std::memory_order_release);
+            expected = h.last_lsn + 1;
+            batches_.fetch_add(1, std::memory_order_release);
+            futex_wake(batches_);
+        }
+    } catch (...) {
+        if (!stop_.load(std::memory_order_relaxed)) {
+            error_ = std::current_exception();
+            failed_.store(true, std::memory_order_release);
+        }
+    }
+    ::shutdown(fd_, SHUT_RDWR);
+    batches_.fetch_add(1, std::memory_order_release);
+    futex_wake(batches_);
+}
+
+void replication_follower::send_acks() noexcept
+{
+    fmt::ack sent{applied_lsn_.load(std::memory_order_relaxed), applied_lsn_.load(std::memory_order_relaxed)};
+    try {
+        while (!stop_.load(std::memory_order_relaxed) && !failed_.load(std::memory_order_acquire)) {
+            const std::uint32_t seen = batches_.load(std::memory_order_acquire);
+            fmt::ack a{applied_lsn_.load(std::memory_order_acquire), 0};
+            a.durable_lsn = a.applied_lsn;
+            if (options_.log) {
+                // Applied records are in the log already; wait for it to
+                // commit them, but ack what is applied meanwhile.
+                options_.log->wait_durable_for(a.applied_lsn, poll_interval);
+                a.durable_lsn = options_.log->durable_lsn();
+            }
+            if (a.applied_lsn != sent.applied_lsn || a.durable_lsn != sent.durable_lsn) {
+                if (!send_all(fd_, &a, sizeof(a)))
+                    return;
+                sent = a;
+            } else {
+                futex_wait_for(batches_, seen, poll_interval);
+            }
+        }
+    } catch (...) {
+        // The local log failed; the receiver finds out on its next append.
+    }
+}
+
+bool replication_follower::wait_applied(std::uint64_t lsn, std::chrono::nanoseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        const std::uint32_t seen = batches_.load(std::memory_order_acquire);
+        if (applied_lsn_.load(std::memory_order_acquire) >= lsn)
+            return true;
+        if (failed_.load(std::memory_order_acquire))
+            std::rethrow_exception(error_);
+        if (!futex_wait_for(batches_, seen, deadline - std::chrono::steady_clock::now())
+            && std::chrono::steady_clock::now() >= deadline)
+            return false;
+    }
+}
+
+} // namespace yeni
@@ -0,0 +1,344 @@
+#include "yeni/scheduler.hpp"
+
+#include "yeni/futex.hpp"
+#include "yeni/numa.hpp"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace yeni {
+
+struct scheduler::worker {
+    unsigned index;
+    unsigned node;
+    int cpu; // -1 when not pinned
+    work_stealing_deque<task*> deque;
+    std::vector<unsigned> near; // other workers on the same node
+    std::vector<unsigned> far;
+    std::uint64_t rng;
+    std::thread thread;
+};
+
+namespace {
+
+struct current_context {
+    const scheduler* owner = nullptr;
+    void* worker = nullptr;
+};
+
+thread_local current_context tls_current;
+
+std::uint64_t next_random(std::uint64_t& s) noexcept
+{
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+} // namespace
+
+scheduler::scheduler(scheduler_options options)
+{
+    const auto& topo = numa_topology::system();
+    std::vector<std::pair<unsigned, unsigned>> cpus; // (cpu, node), node-major
+    for (const auto& n : topo.nodes())
+        for (unsigned c : n.cpus)
+            cpus.emplace_back(c, n.id);
+
+    const unsigned count = options.threads ? options.threads : unsigned(cpus.size());
+    const bool pin = options.pin_workers && count <= cpus.size();
+
+    workers_.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        auto w = std::make_unique<worker>();
+        w->index = i;
+        w->node = cpus[i % cpus.size()].second;
+        w->cpu = pin ? int(cpus[i].first) : -1;
+        w->rng = 0x9e3779b97f4a7c15ULL * (i + 1);
+        workers_.push_back(std::move(w));
+    }
+    for (auto& w : workers_) {
+        for (auto& other : workers_) {
+            if (other.get() == w.get())
+                continue;
+            (other->node == w->node ? w->near : w->far).push_back(other->index);
+        }
+    }
+    for (auto& w : workers_)
+        w->thread = std::thread([this, i = w->index] { worker_main(i); });
+}
+
+scheduler::~scheduler()
+{
+    stop_.store(true, std::memory_order_seq_cst);
+    wake_epoch_.fetch_add(1, std::memory_order_seq_cst);
+    futex_wake(wake_epoch_);
+    for (auto& w : workers_)
+        w->thread.join();
+}
+
+scheduler& scheduler::instance()
+{
+    static scheduler pool;
+    return pool;
+}
+
+int scheduler::current_worker() const noexcept
+{
+    if (tls_current.owner != this)
+        return -1;
+    return int(static_cast<worker*>(tls_current.worker)->index);
+}
+
+unsigned scheduler::current_node() const noexcept
+{
+    if (tls_current.owner != this)
+        return 0;
+    return static_cast<worker*>(tls_current.worker)->node;
+}
+
+void scheduler::spawn(task* t)
+{
+    if (tls_current.owner == this) {
+        static_cast<worker*>(tls_current.worker)->deque.push(t);
+    } else {
+        std::lock_guard lock(inject_mutex_);
+        inject_.push_back(t);
+        inject_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    notify();
+}
+
+void scheduler::notify()
+{
+    // Pairs with the sleepers_ increment in worker_main(): either the
+    // sleeper's recheck sees the new task or we see the sleeper.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) == 0)
+        return;
+    wake_epoch_.fetch_add(1, std::memory_order_seq_cst);
+    futex_wake(wake_epoch_, 1);
+}
+
+namespace {
+
+constexpr auto due_later = [](const auto& a, const auto& b) { return a.first > b.first; };
+
+} // namespace
+
+void scheduler::spawn_background(task* t, std::chrono::steady_clock::time_point not_before)
+{
+    {
+        std::lock_guard lock(background_mutex_);
+        background_.emplace_back(not_before, t);
+        std::push_heap(background_.begin(), background_.end(), due_later);
+        background_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // A sleeper with an older deadline must recompute it; once is enough.
+    notify();
+}
+
+bool scheduler::cancel_background(task* t)
+{
+    std::lock_guard lock(background_mutex_);
+    auto it = std::find_if(background_.begin(), background_.end(), [t](const auto& e) { return e.second == t; });
+    if (it == background_.end())
+        return false;
+    background_.erase(it);
+    std::make_heap(background_.begin(), background_.end(), due_later);
+    background_size_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+task* scheduler::find_background(std::chrono::steady_clock::time_point& next_due)
+{
+    next_due = std::chrono::steady_clock::time_point::max();
+    if (background_size_.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+    std::lock_guard lock(background_mutex_);
+    if (background_.empty())
+        return nullptr;
+    if (background_.front().first > std::chrono::steady_clock::now()) {
+        next_due = background_.front().first;
+        return nullptr;
+    }
+    std::pop_heap(background_.begin(), background_.end(), due_later);
+    task* t = background_.back().second;
+    background_.pop_back();
+    background_size_.fetch_sub(1, std::memory_order_relaxed);
+    return t;
+}
+
+task* scheduler::find_task(worker* self)
+{
+    if (self) {
+        if (task* t = self->deque.pop())
+            return t;
+        for (const auto* victims : {&self->near, &self->far}) {
+            const std::size_t n = victims->size();
+            if (n == 0)
+                continue;
+            const std::size_t start = next_random(self->rng) % n;
+            for (std::size_t k = 0; k < n; ++k)
+                if (task* t = workers_[(*victims)[(start + k) % n]]->deque.steal())
+                    return t;
+        }
+    } else {
+        for (auto& w : workers_)
+            if (task* t = w->deque.steal())
+                return t;
+    }
+    if (inject_size_.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard lock(inject_mutex_);
+        if (!inject_.empty()) {
+            task* t = inject_.front();
+            inject_.pop_front();
+            inject_size_.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+bool scheduler::run_one()
+{
+    worker* self = tls_current.owner == this ? static_cast<worker*>(tls_current.worker) : nullptr;
+    task* t = find_task(self);
+    if (!t)
+        return false;
+    t->run(t);
+    return true;
+}
+
+void scheduler::worker_main(unsigned index)
+{
+    worker* self = workers_[index].get();
+    tls_current = {this, self};
+    if (self->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(self->cpu, &set);
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    }
+
+    unsigned idle = 0;
+    std::chrono::steady_clock::time_point next_due; // of the earliest delayed background task
+    while (!stop_.load(std::memory_order_relaxed)) {
+        if (task* t = find_task(self)) {
+            t->run(t);
+            idle = 0;
+            continue;
+        }
+        if (++idle < 64) {
+            cpu_relax();
+            continue;
+        }
+        if (idle < 96) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Background tasks are only considered here, on the way to sleep,
+        // and after the foreground recheck.
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        const std::uint32_t epoch = wake_epoch_.load(std::memory_order_seq_cst);
+        task* t = find_task(self);
+        if (!t)
+            t = find_background(next_due);
+        if (!t && !stop_.load(std::memory_order_relaxed)) {
+            if (next_due == std::chrono::steady_clock::time_point::max())
+                futex_wait(wake_epoch_, epoch);
+            else
+                futex_wait_for(wake_epoch_, epoch, next_due - std::chrono::steady_clock::now());
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        if (t)
+            t->run(t);
+        idle = 0;
+    }
+    tls_current = {};
+}
+
+void scheduler::run_chunks(range_job& job) noexcept
+{
+    while (!job.failed.load(std::memory_order_relaxed)) {
+        const std::size_t c = job.next.fetch_add(1, std::memory_order_relaxed);
+        if (c >= job.chunks)
+            return;
+        const std::size_t b = job.begin + c * job.grain;
+        const std::size_t e = std::min(job.end, b + job.grain);
+        try {
+            job.body(job.ctx, c, b, e);
+        } catch (...) {
+            std::lock_guard lock(job.error_mutex);
+            if (!job.error)
+                job.error = std::current_exception();
+            job.failed.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+void scheduler::run_job(range_job& job)
+{
+    const std::size_t helpers = std::min<std::size_t>(job.chunks - 1, workers_.size());
+    auto tasks = std::make_unique<helper_task[]>(helpers);
+    job.helpers.store(helpers, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < helpers; ++i) {
+        tasks[i].run = [](task* t) noexcept {
+            range_job& j = *static_cast<helper_task*>(t)->job;
+            run_chunks(j);
+            // Last touch of the job: the caller may return right after.
+            j.helpers.fetch_sub(1, std::memory_order_release);
+        };
+        tasks[i].job = &job;
+        spawn(&tasks[i]);
+    }
+    run_chunks(job);
+    wait_until([&] { return job.helpers.load(std::memory_order_acquire) == 0; });
+    if (job.error)
+        std::rethrow_exception(job.error);
+}
+
+void task_group::run(std::function<void()> fn)
+{
+    auto* t = new fn_task;
+    t->fn = std::move(fn);
+    t->group = this;
+    t->run = [](task* p) noexcept {
+        auto* ft = static_cast<fn_task*>(p);
+        task_group* g = ft->group;
+        try {
+            ft->fn();
+        } catch (...) {
+            std::lock_guard lock(g->error_mutex_);
+            if (!g->error_)
+                g->error_ = std::current_exception();
+        }
+        delete ft;
+        g->pending_.fetch_sub(1, std::memory_order_release);
+    };
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    sched_.spawn(t);
+}
+
+void task_group::wait()
+{
+    wait_noexcept();
+    std::exception_ptr e;
+    {
+        std::lock_guard lock(error_mutex_);
+        e = std::exchange(error_, nullptr);
+    }
+    if (e)
+        std::rethrow_exception(e);
+}
+
+void task_group::wait_noexcept() noexcept
+{
+    sched_.wait_until([&] { return pending_.load(std::memory_order_acquire) == 0; });
+}
+
+} // namespace yeni
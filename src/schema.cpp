@@ -0,0 +1,177 @@
+#include "yeni/schema.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace yeni {
+
+namespace fmt = segment_format;
+
+namespace {
+
+template <class T>
+void add_fixed_column(segment_writer& w, const schema& s, std::size_t i, std::span<const std::span<const std::byte>> rows)
+{
+    std::vector<T> column(rows.size());
+    for (std::size_t r = 0; r < rows.size(); ++r)
+        std::memcpy(&column[r], rows[r].data() + s.offset(i), sizeof(T));
+    w.add_column<T>(s.fields()[i].name, column);
+}
+
+} // namespace
+
+schema::schema(std::vector<field> fields)
+    : fields_(std::move(fields))
+    , offsets_(fields_.size())
+{
+    if (fields_.empty())
+        throw std::invalid_argument("yeni: schema without fields");
+    std::vector<fmt::column_type> types(fields_.size());
+    for (std::size_t i = 0; i < fields_.size(); ++i) {
+        const field& f = fields_[i];
+        if (f.name.empty() || f.name.size() >= fmt::max_name)
+            throw std::invalid_argument("yeni: schema field name must be 1 to "
+                + std::to_string(fmt::max_name - 1) + " bytes");
+        if (f.type == fmt::column_type::none || f.type > fmt::column_type::binary)
+            throw std::invalid_argument("yeni: schema field '" + f.name + "' has no type");
+        for (std::size_t j = 0; j < i; ++j)
+            if (fields_[j].name == f.name)
+                throw std::invalid_argument("yeni: schema field '" + f.name + "' appears twice");
+        types[i] = f.type;
+    }
+    fixed_size_ = detail::layout_fields(types, offsets_);
+}
+
+std::optional<std::size_t> schema::index_of(std::string_view name) const noexcept
+{
+    for (std::size_t i = 0; i < fields_.size(); ++i)
+        if (fields_[i].name == name)
+            return i;
+    return std::nullopt;
+}
+
+schema::value schema::get(std::span<const std::byte> record, std::size_t i) const noexcept
+{
+    const std::byte* p = record.data() + offsets_[i];
+    switch (fields_[i].type) {
+    case fmt::column_type::u32: {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case fmt::column_type::u64: {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case fmt::column_type::i64: {
+        std::int64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case fmt::column_type::f64: {
+        double v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    default:
+        return detail::read_binary_field(record, offsets_[i]);
+    }
+}
+
+void schema::encode_into(std::vector<std::byte>& out, std::span<const value> values) const
+{
+    out.clear();
+    append(out, values);
+}
+
+void schema::append(std::vector<std::byte>& out, std::span<const value> values) const
+{
+    if (values.size() != fields_.size())
+        throw std::invalid_argument("yeni: schema expects " + std::to_string(fields_.size()) + " values, got "
+            + std::to_string(values.size()));
+    std::uint64_t tail = 0;
+    for (std::size_t i = 0; i < fields_.size(); ++i) {
+        if (values[i].index() != std::size_t(fields_[i].type) - 1)
+            throw std::invalid_argument("yeni: wrong value type for schema field '" + fields_[i].name + "'");
+        if (const auto* b = std::get_if<std::span<const std::byte>>(&values[i]))
+            tail += b->size();
+    }
+    const std::size_t base = out.size();
+    out.resize(base + detail::record_size(fixed_size_, tail));
+    std::byte* const record = out.data() + base;
+    std::uint32_t at = fixed_size_;
+    for (std::size_t i = 0; i < fields_.size(); ++i) {
+        std::byte* p = record + offsets_[i];
+        std::visit(
+            [&]<class T>(const T& v) {
+                if constexpr (std::is_same_v<T, std::span<const std::byte>>) {
+                    const std::uint32_t ref[2] = {at, std::uint32_t(v.size())};
+                    std::memcpy(p, ref, sizeof(ref));
+                    if (!v.empty())
+                        std::memcpy(record + at, v.data(), v.size());
+                    at += std::uint32_t(v.size());
+                } else {
+                    std::memcpy(p, &v, sizeof(v));
+                }
+            },
+            values[i]);
+    }
+}
+
+std::vector<std::byte> schema::encode(std::span<const value> values) const
+{
+    std::vector<std::byte> out;
+    encode_into(out, values);
+    return out;
+}
+
+bool schema::validate(std::span<const std::byte> record) const noexcept
+{
+    if (record.size() < fixed_size_)
+        return false;
+    for (std::size_t i = 0; i < fields_.size(); ++i)
+        if (fields_[i].type == fmt::column_type::binary && !detail::binary_field_ok(record, offsets_[i]))
+            return false;
+    return true;
+}
+
+int schema::compare(std::span<const std::byte> a, std::span<const std::byte> b,
+    std::span<const std::size_t> fields) const noexcept
+{
+    for (const std::size_t i : fields) {
+        const value x = get(a, i), y = get(b, i);
+        const int c = std::visit(
+            [&]<class T>(const T& v) { return detail::compare_field(v, std::get<T>(y)); }, x);
+        if (c)
+            return c;
+    }
+    return 0;
+}
+
+void schema::add_columns(segment_writer& w, std::span<const std::span<const std::byte>> rows) const
+{
+    for (std::size_t i = 0; i < fields_.size(); ++i) {
+        switch (fields_[i].type) {
+        case fmt::column_type::u32:
+            add_fixed_column<std::uint32_t>(w, *this, i, rows);
+            break;
+        case fmt::column_type::u64:
+            add_fixed_column<std::uint64_t>(w, *this, i, rows);
+            break;
+        case fmt::column_type::i64:
+            add_fixed_column<std::int64_t>(w, *this, i, rows);
+            break;
+        case fmt::column_type::f64:
+            add_fixed_column<double>(w, *this, i, rows);
+            break;
+        default:
+            w.add_binary_column(fields_[i].name, rows.size(),
+                [&](std::size_t r) { return detail::read_binary_field(rows[r], offsets_[i]); });
+            break;
+        }
+    }
+}
+
+} // namespace yeni
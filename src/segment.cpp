@@ -0,0 +1,771 @@
+#include "yeni/segment.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/futex.hpp"
+#include "yeni/io.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yeni {
+
+static_assert(std::endian::native == std::endian::little, "segment files are little-endian");
+
+namespace fmt = segment_format;
+
+namespace {
+
+constexpr std::size_t write_buffer_size = 1 << 20;
+
+std::uint64_t align_up(std::uint64_t v) noexcept
+{
+    return (v + fmt::alignment - 1) & ~std::uint64_t(fmt::alignment - 1);
+}
+
+void write_all(int fd, const std::byte* p, std::size_t n)
+{
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("segment write");
+        }
+        p += w;
+        n -= std::size_t(w);
+    }
+}
+
+void pwrite_all(int fd, const std::byte* p, std::size_t n, std::uint64_t offset)
+{
+    while (n) {
+        ssize_t w = ::pwrite(fd, p, n, off_t(offset));
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("segment write");
+        }
+        p += w;
+        n -= std::size_t(w);
+        offset += std::uint64_t(w);
+    }
+}
+
+void pread_all(int fd, std::byte* p, std::size_t n, std::uint64_t offset, const std::filesystem::path& path)
+{
+    while (n) {
+        ssize_t r = ::pread(fd, p, n, off_t(offset));
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("read " + path.string());
+        }
+        if (r == 0)
+            throw format_error("yeni: " + path.string() + ": truncated");
+        p += r;
+        n -= std::size_t(r);
+        offset += std::uint64_t(r);
+    }
+}
+
+std::atomic<std::uint64_t> next_segment_id{1};
+
+[[noreturn]] void corrupt(const std::filesystem::path& path, const char* why)
+{
+    throw format_error("yeni: " + path.string() + ": " + why);
+}
+
+bool general_codec(column_encoding e) noexcept
+{
+    return e == column_encoding::lz4 || e == column_encoding::zstd;
+}
+
+void check_codec(column_encoding e, bool binary)
+{
+    if (e != column_encoding::plain && !general_codec(e) && !(binary && e == column_encoding::front_coded))
+        throw std::invalid_argument("yeni: " + std::string(to_string(e)) + " is not a general-purpose codec");
+    if (e == column_encoding::zstd && !zstd_supported())
+        throw std::invalid_argument("yeni: built without zstd");
+}
+
+// Encoded form of a fixed-width column, or empty to store it plain.
+template <class T>
+std::vector<std::byte> encode_fixed(const void* data, std::size_t rows, const codec_options& codec,
+    column_encoding& e)
+{
+    const std::span<const T> values(static_cast<const T*>(data), rows);
+    e = choose_encoding(values, codec);
+    std::vector<std::byte> out;
+    if (is_packed(e)) {
+        out = encode_packed(values, e);
+        // The sample missed a page too wide to pack.
+        if (out.empty())
+            e = codec.general;
+    }
+    if (general_codec(e))
+        out = compress_block(std::as_bytes(values), e, codec.zstd_level);
+    if (out.size() >= values.size_bytes())
+        out.clear();
+    if (out.empty())
+        e = column_encoding::plain;
+    return out;
+}
+
+template <class T>
+void decode_packed(std::span<const std::byte> block, column_encoding e, std::vector<std::byte>& out)
+{
+    const packed_column<T> c(block, e);
+    out.resize(c.size() * sizeof(T));
+    c.decode({reinterpret_cast<T*>(out.data()), c.size()});
+}
+
+std::uint64_t type_width(fmt::column_type type) noexcept
+{
+    switch (type) {
+    case fmt::column_type::u32:
+        return 4;
+    case fmt::column_type::u64:
+    case fmt::column_type::i64:
+    case fmt::column_type::f64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+namespace detail {
+
+/// A column block decoded on first access.
+struct decoded_block {
+    std::once_flag once;
+    std::vector<std::byte> bytes;
+};
+
+} // namespace detail
+
+/// Write-behind buffers of an io_context-backed writer. Slots are reused
+/// round-robin; a slot is settled (waited for, its result checked) before
+/// it is refilled.
+struct segment_writer::pipeline {
+    static constexpr std::size_t depth = 4;
+
+    struct slot : io_request {
+        std::vector<std::byte> bytes;
+        std::atomic<std::uint32_t> busy{0};
+        bool checked = true;
+    };
+
+    explicit pipeline(io_context& ctx) : io(ctx)
+    {
+        for (auto& s : slots) {
+            s.bytes.reserve(write_buffer_size);
+            s.complete = &on_complete;
+        }
+    }
+
+    static void on_complete(io_request* r) noexcept
+    {
+        auto* s = static_cast<slot*>(r);
+        s->busy.store(0, std::memory_order_release);
+        futex_wake(s->busy);
+    }
+
+    void submit(slot& s)
+    {
+        s.busy.store(1, std::memory_order_relaxed);
+        s.checked = false;
+        io.submit(&s);
+    }
+
+    static void wait(slot& s) noexcept
+    {
+        while (s.busy.load(std::memory_order_acquire))
+            futex_wait(s.busy, 1);
+    }
+
+    /// Wait for `s`; rethrow its error and finish a short write in place.
+    static void settle(slot& s, const std::string& what)
+    {
+        wait(s);
+        if (std::exchange(s.checked, true))
+            return;
+        if (s.result < 0) {
+            errno = int(-s.result);
+            throw_errno(what);
+        }
+        if (std::uint64_t(s.result) < s.size)
+            pwrite_all(s.fd, s.bytes.data() + s.result, s.size - std::size_t(s.result), s.offset + std::uint64_t(s.result));
+    }
+
+    void drain() noexcept
+    {
+        for (auto& s : slots)
+            wait(s);
+    }
+
+    io_context& io;
+    slot slots[depth];
+    std::size_t next = 0;
+};
+
+void binary_column::out_of_range()
+{
+    throw format_error("yeni: binary column offsets out of range");
+}
+
+segment_writer::segment_writer(std::filesystem::path path, io_context* io, const codec_options& codec)
+    : path_(std::move(path))
+    , tmp_path_(path_.string() + ".tmp")
+    , codec_(codec)
+{
+    check_codec(codec_.general, false);
+    check_codec(codec_.binary, true);
+    fd_ = ::open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw_errno("open " + tmp_path_.string());
+    buffer_.reserve(write_buffer_size);
+    if (io)
+        pipeline_ = std::make_unique<pipeline>(*io);
+
+    fmt::header h{};
+    std::memcpy(h.magic, fmt::magic, sizeof(h.magic));
+    h.version = fmt::version;
+    put_pod(h);
+}
+
+segment_writer::~segment_writer()
+{
+    if (pipeline_)
+        pipeline_->drain();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        if (!finished_)
+            ::unlink(tmp_path_.c_str());
+    }
+}
+
+void segment_writer::put(const void* data, std::size_t size)
+{
+    auto* p = static_cast<const std::byte*>(data);
+    if (buffer_.size() + size > write_buffer_size) {
+        flush_buffer();
+        if (size >= write_buffer_size && !pipeline_) {
+            write_all(fd_, p, size);
+            offset_ += size;
+            return;
+        }
+        // Pipelined writes only ever come from the slot buffers.
+        for (; size > write_buffer_size; p += write_buffer_size, size -= write_buffer_size) {
+            buffer_.insert(buffer_.end(), p, p + write_buffer_size);
+            flush_buffer();
+        }
+    }
+    buffer_.insert(buffer_.end(), p, p + size);
+}
+
+void segment_writer::flush_buffer()
+{
+    if (!pipeline_) {
+        write_all(fd_, buffer_.data(), buffer_.size());
+        offset_ += buffer_.size();
+        buffer_.clear();
+        return;
+    }
+    if (buffer_.empty())
+        return;
+    auto& s = pipeline_->slots[std::exchange(pipeline_->next, (pipeline_->next + 1) % pipeline::depth)];
+    pipeline::settle(s, "segment write");
+    s.bytes.swap(buffer_);
+    buffer_.clear();
+    s.opcode = io_request::op::write;
+    s.fd = fd_;
+    s.data = s.bytes.data();
+    s.size = std::uint32_t(s.bytes.size());
+    s.offset = offset_;
+    offset_ += s.bytes.size();
+    pipeline_->submit(s);
+}
+
+void segment_writer::pad_to_alignment()
+{
+    static constexpr std::byte zeros[fmt::alignment] = {};
+    std::uint64_t pos = bytes_written();
+    put(zeros, align_up(pos) - pos);
+}
+
+void segment_writer::begin_block(std::string_view name, fmt::block_kind kind, fmt::column_type type,
+    std::size_t rows)
+{
+    if (name.empty() || name.size() >= fmt::max_name)
+        throw std::invalid_argument("yeni: segment block name must be 1-31 bytes");
+    for (const auto& b : blocks_)
+        if (b.name_view() == name)
+            throw std::invalid_argument("yeni: duplicate segment block " + std::string(name));
+    if (kind == fmt::block_kind::column) {
+        if (rows_ && *rows_ != rows)
+            throw std::invalid_argument("yeni: segment columns must have equal row counts");
+        rows_ = rows;
+    }
+
+    pad_to_alignment();
+    fmt::block_desc d{};
+    std::memcpy(d.name, name.data(), name.size());
+    d.kind = kind;
+    d.type = type;
+    d.offset = bytes_written();
+    d.rows = rows;
+    blocks_.push_back(d);
+}
+
+void segment_writer::end_block()
+{
+    blocks_.back().size = bytes_written() - blocks_.back().offset;
+}
+
+void segment_writer::add_fixed(std::string_view name, fmt::column_type type, const void* data, std::size_t rows,
+    std::size_t width)
+{
+    begin_block(name, fmt::block_kind::column, type, rows);
+    column_encoding e = column_encoding::plain;
+    std::vector<std::byte> encoded;
+    if (codec_.encode) {
+        switch (type) {
+        case fmt::column_type::u32:
+            encoded = encode_fixed<std::uint32_t>(data, rows, codec_, e);
+            break;
+        case fmt::column_type::u64:
+            encoded = encode_fixed<std::uint64_t>(data, rows, codec_, e);
+            break;
+        case fmt::column_type::i64:
+            encoded = encode_fixed<std::int64_t>(data, rows, codec_, e);
+            break;
+        default:
+            encoded = encode_fixed<double>(data, rows, codec_, e);
+            break;
+        }
+    }
+    blocks_.back().encoding = std::uint8_t(e);
+    if (e == column_encoding::plain)
+        put(data, rows * width);
+    else
+        put(encoded.data(), encoded.size());
+    end_block();
+}
+
+void segment_writer::add_compressed_binary(std::string_view name, std::size_t rows, std::span<const std::byte> raw)
+{
+    begin_block(name, fmt::block_kind::column, fmt::column_type::binary, rows);
+    const std::vector<std::byte> c = codec_.binary == column_encoding::front_coded
+        ? encode_front_coded(raw, rows)
+        : compress_block(raw, codec_.binary, codec_.zstd_level);
+    if (c.size() < raw.size()) {
+        blocks_.back().encoding = std::uint8_t(codec_.binary);
+        put(c.data(), c.size());
+    } else {
+        put(raw.data(), raw.size());
+    }
+    end_block();
+}
+
+void segment_writer::add_block(std::string_view name, std::span<const std::byte> data, std::uint8_t encoding)
+{
+    begin_block(name, fmt::block_kind::aux, fmt::column_type::none, 0);
+    blocks_.back().encoding = encoding;
+    put(data.data(), data.size());
+    end_block();
+}
+
+void segment_writer::finish()
+{
+    if (finished_)
+        return;
+    pad_to_alignment();
+    fmt::trailer t{};
+    t.footer_offset = bytes_written();
+    t.rows = rows_.value_or(0);
+    t.block_count = static_cast<std::uint32_t>(blocks_.size());
+    std::memcpy(t.magic, fmt::trailer_magic, sizeof(t.magic));
+    put(blocks_.data(), blocks_.size() * sizeof(fmt::block_desc));
+    put_pod(t);
+    flush_buffer();
+
+    if (pipeline_) {
+        for (auto& s : pipeline_->slots)
+            pipeline::settle(s, "segment write");
+        auto& s = pipeline_->slots[0];
+        s.opcode = io_request::op::fdatasync;
+        s.size = 0;
+        pipeline_->submit(s);
+        pipeline::settle(s, "fdatasync " + tmp_path_.string());
+    } else if (::fdatasync(fd_) != 0) {
+        throw_errno("fdatasync " + tmp_path_.string());
+    }
+    if (::close(std::exchange(fd_, -1)) != 0)
+        throw_errno("close " + tmp_path_.string());
+    if (::rename(tmp_path_.c_str(), path_.c_str()) != 0)
+        throw_errno("rename " + path_.string());
+    finished_ = true;
+}
+
+segment segment::open(const std::filesystem::path& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("open " + path.string());
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        int e = errno;
+        ::close(fd);
+        errno = e;
+        throw_errno("fstat " + path.string());
+    }
+    const auto size = std::size_t(st.st_size);
+    if (size < sizeof(fmt::header) + sizeof(fmt::trailer)) {
+        ::close(fd);
+        throw format_error("yeni: " + path.string() + ": too short for a segment");
+    }
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int e = errno;
+        ::close(fd);
+        errno = e;
+        throw_errno("mmap " + path.string());
+    }
+
+    segment s;
+    s.path_ = path;
+    s.id_ = next_segment_id.fetch_add(1, std::memory_order_relaxed);
+    s.fd_ = fd;
+    s.base_ = static_cast<const std::byte*>(map);
+    s.size_ = size;
+
+    auto fail = [&](const char* why) { corrupt(path, why); };
+
+    const auto* h = reinterpret_cast<const fmt::header*>(s.base_);
+    if (std::memcmp(h->magic, fmt::magic, sizeof(h->magic)) != 0)
+        fail("bad segment magic");
+    if (h->version != fmt::version)
+        fail("unsupported segment version");
+
+    // Every block, the footer and the trailer are whole alignment units.
+    if (size % fmt::alignment != 0)
+        fail("truncated segment");
+    const auto* t = reinterpret_cast<const fmt::trailer*>(s.base_ + size - sizeof(fmt::trailer));
+    if (std::memcmp(t->magic, fmt::trailer_magic, sizeof(t->magic)) != 0)
+        fail("bad trailer magic");
+    const std::uint64_t footer_end = size - sizeof(fmt::trailer);
+    if (t->footer_offset % fmt::alignment != 0 || t->footer_offset > footer_end
+        || (footer_end - t->footer_offset) / sizeof(fmt::block_desc) != t->block_count
+        || (footer_end - t->footer_offset) % sizeof(fmt::block_desc) != 0)
+        fail("corrupt footer");
+
+    s.rows_ = t->rows;
+    s.blocks_ = {reinterpret_cast<const fmt::block_desc*>(s.base_ + t->footer_offset), t->block_count};
+    bool encoded = false;
+    for (const auto& d : s.blocks_) {
+        if (d.offset % fmt::alignment != 0 || d.offset < sizeof(fmt::header) || d.offset > t->footer_offset
+            || d.size > t->footer_offset - d.offset)
+            fail("block out of bounds");
+        if (d.kind == fmt::block_kind::column) {
+            if (d.rows != s.rows_)
+                fail("column row count mismatch");
+            const std::uint64_t width = type_width(d.type);
+            if (!width && d.type != fmt::column_type::binary)
+                fail("unknown column type");
+            const auto e = column_encoding(d.encoding);
+            if (e != column_encoding::plain) {
+                if (const char* why = s.check_encoded(d))
+                    fail(why);
+                encoded = true;
+            } else if (d.type == fmt::column_type::binary) {
+                if (d.rows >= d.size / 8)
+                    fail("binary column too short");
+                const auto* offs = reinterpret_cast<const std::uint64_t*>(s.base_ + d.offset);
+                const std::uint64_t data_size = d.size - (d.rows + 1) * 8;
+                if (offs[0] != 0 || offs[d.rows] != data_size)
+                    fail("binary column offsets corrupt");
+            } else if (d.size % width != 0 || d.size / width != d.rows) {
+                fail("column size mismatch");
+            }
+        } else if (d.kind != fmt::block_kind::aux) {
+            fail("unknown block kind");
+        }
+    }
+    if (encoded)
+        s.decoded_ = std::make_unique<detail::decoded_block[]>(s.blocks_.size());
+
+    if (const auto* k = s.find_block(key_column); k && k->type == fmt::column_type::u64)
+        s.keys_ = s.column<std::uint64_t>(key_column);
+    if (const auto* f = s.find_block(filter_block); f && f->kind == fmt::block_kind::aux) {
+        try {
+            s.filter_ = bloom_filter(s.block_data(filter_block));
+        } catch (const format_error&) {
+            fail("bad key filter");
+        }
+    }
+    return s;
+}
+
+segment::segment(segment&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+segment& segment::operator=(segment&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        path_ = std::move(other.path_);
+        id_ = std::exchange(other.id_, 0);
+        fd_ = std::exchange(other.fd_, -1);
+        base_ = std::exchange(other.base_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        rows_ = std::exchange(other.rows_, 0);
+        blocks_ = std::exchange(other.blocks_, {});
+        keys_ = std::exchange(other.keys_, {});
+        filter_ = std::exchange(other.filter_, {});
+        decoded_ = std::move(other.decoded_);
+    }
+    return *this;
+}
+
+segment::~segment()
+{
+    release();
+}
+
+void segment::release() noexcept
+{
+    if (base_)
+        ::munmap(const_cast<std::byte*>(base_), size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+    base_ = nullptr;
+    fd_ = -1;
+}
+
+const fmt::block_desc* segment::find_block(std::string_view name) const noexcept
+{
+    for (const auto& d : blocks_)
+        if (d.name_view() == name)
+            return &d;
+    return nullptr;
+}
+
+std::span<const std::byte> segment::block_data(std::string_view name) const
+{
+    const auto* d = find_block(name);
+    if (!d)
+        throw format_error("yeni: " + path_.string() + ": no block " + std::string(name));
+    return {base_ + d->offset, std::size_t(d->size)};
+}
+
+const fmt::block_desc& segment::typed_block(std::string_view name, fmt::column_type type) const
+{
+    const auto* d = find_block(name);
+    if (!d || d->kind != fmt::block_kind::column)
+        throw format_error("yeni: " + path_.string() + ": no column " + std::string(name));
+    if (d->type != type)
+        throw format_error("yeni: " + path_.string() + ": column " + std::string(name) + " has a different type");
+    return *d;
+}
+
+const char* segment::check_encoded(const fmt::block_desc& d) const noexcept
+{
+    const auto e = column_encoding(d.encoding);
+    const std::span<const std::byte> block(base_ + d.offset, std::size_t(d.size));
+    try {
+        if (is_packed(e)) {
+            std::uint64_t rows = 0;
+            switch (d.type) {
+            case fmt::column_type::u32:
+                rows = packed_column<std::uint32_t>(block, e).size();
+                break;
+            case fmt::column_type::u64:
+                rows = packed_column<std::uint64_t>(block, e).size();
+                break;
+            case fmt::column_type::i64:
+                rows = packed_column<std::int64_t>(block, e).size();
+                break;
+            case fmt::column_type::f64:
+                rows = packed_column<double>(block, e).size();
+                break;
+            default:
+                return "packed binary column";
+            }
+            return rows == d.rows ? nullptr : "column row count mismatch";
+        }
+        if (e == column_encoding::front_coded) {
+            if (d.type != fmt::column_type::binary)
+                return "front-coded fixed-width column";
+            return front_coded_column(block).size() == d.rows ? nullptr : "column row count mismatch";
+        }
+        if (!general_codec(e))
+            return "unknown column encoding";
+        if (e == column_encoding::zstd && !zstd_supported())
+            return "zstd column, but built without zstd";
+        const std::uint64_t raw = decompressed_size(block);
+        if (raw > max_decompressed_size(block, e))
+            return "compressed column size implausible";
+        const std::uint64_t width = type_width(d.type);
+        if (d.type == fmt::column_type::binary ? raw / 8 <= d.rows : raw % width != 0 || raw / width != d.rows)
+            return "compressed column size mismatch";
+        return nullptr;
+    } catch (const format_error&) {
+        return "bad column encoding";
+    }
+}
+
+const std::byte* segment::column_data(const fmt::block_desc& d) const
+{
+    const auto e = column_encoding(d.encoding);
+    if (e == column_encoding::plain)
+        return base_ + d.offset;
+    detail::decoded_block& slot = decoded_[std::size_t(&d - blocks_.data())];
+    std::call_once(slot.once, [&] {
+        const trace::span span(trace::span_kind::decode, d.rows);
+        const std::span<const std::byte> block(base_ + d.offset, std::size_t(d.size));
+        std::vector<std::byte> out;
+        switch (d.type) {
+        case fmt::column_type::u32:
+        case fmt::column_type::u64:
+        case fmt::column_type::i64:
+        case fmt::column_type::f64:
+            if (is_packed(e)) {
+                if (d.type == fmt::column_type::u32)
+                    decode_packed<std::uint32_t>(block, e, out);
+                else if (d.type == fmt::column_type::u64)
+                    decode_packed<std::uint64_t>(block, e, out);
+                else if (d.type == fmt::column_type::i64)
+                    decode_packed<std::int64_t>(block, e, out);
+                else
+                    decode_packed<double>(block, e, out);
+                break;
+            }
+            [[fallthrough]];
+        default:
+            if (e == column_encoding::front_coded) {
+                front_coded_column(block).decode(out);
+                break;
+            }
+            out.resize(decompressed_size(block));
+            decompress_block(block, e, out);
+            break;
+        }
+        if (d.type == fmt::column_type::binary) {
+            const auto* offs = reinterpret_cast<const std::uint64_t*>(out.data());
+            if (offs[0] != 0 || offs[d.rows] != out.size() - (d.rows + 1) * 8)
+                corrupt(path_, "binary column offsets corrupt");
+        }
+        auto& m = metrics::local();
+        m.add(metrics::counter::column_decodes);
+        m.add(metrics::counter::column_decode_bytes, out.size());
+        slot.bytes = std::move(out);
+    });
+    return slot.bytes.data();
+}
+
+column_encoding segment::encoding(std::string_view name) const
+{
+    const auto* d = find_block(name);
+    if (!d || d->kind != fmt::block_kind::column)
+        throw format_error("yeni: " + path_.string() + ": no column " + std::string(name));
+    return column_encoding(d->encoding);
+}
+
+binary_column segment::binary(std::string_view name) const
+{
+    const auto& d = typed_block(name, fmt::column_type::binary);
+    const auto* offs = reinterpret_cast<const std::uint64_t*>(column_data(d));
+    return binary_column(offs, reinterpret_cast<const std::byte*>(offs + d.rows + 1), std::size_t(d.rows),
+        offs[d.rows]);
+}
+
+front_coded_column segment::front_coded(std::string_view name) const
+{
+    const auto& d = typed_block(name, fmt::column_type::binary);
+    if (column_encoding(d.encoding) != column_encoding::front_coded)
+        throw format_error("yeni: " + path_.string() + ": column " + std::string(name) + " is not front-coded");
+    return front_coded_column({base_ + d.offset, std::size_t(d.size)});
+}
+
+std::optional<std::size_t> segment::find(std::uint64_t key) const
+{
+    auto& m = metrics::local();
+    m.add(metrics::counter::segment_lookups);
+    if (!filter_.may_contain(key)) {
+        m.add(metrics::counter::segment_filter_skips);
+        return std::nullopt;
+    }
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || *it != key)
+        return std::nullopt;
+    m.add(metrics::counter::segment_lookup_hits);
+    return std::size_t(it - keys_.begin());
+}
+
+io_awaitable segment::read_async(io_context& io, std::string_view name, std::span<std::byte> out,
+    std::uint64_t from) const
+{
+    const auto* d = find_block(name);
+    if (!d)
+        throw format_error("yeni: " + path_.string() + ": no block " + std::string(name));
+    const std::uint64_t n = from < d->size ? std::min<std::uint64_t>(out.size(), d->size - from) : 0;
+    return io.read(fd_, out.first(std::size_t(n)), d->offset + std::min(from, d->size));
+}
+
+block_cache::handle segment::read_cached(block_cache& cache, std::string_view name, std::uint64_t chunk) const
+{
+    const auto* d = find_block(name);
+    if (!d)
+        throw format_error("yeni: " + path_.string() + ": no block " + std::string(name));
+    const std::uint64_t from = chunk * cache.block_bytes();
+    if (from >= d->size)
+        throw std::out_of_range("yeni: " + path_.string() + ": chunk past the end of block " + std::string(name));
+    const auto n = std::size_t(std::min<std::uint64_t>(cache.block_bytes(), d->size - from));
+    const std::uint64_t offset = d->offset + from;
+    return cache.get({id_, offset}, n, [&](std::span<std::byte> out) { pread_all(fd_, out.data(), n, offset, path_); });
+}
+
+void write_segment(const std::filesystem::path& path, const record_store& store, io_context* io,
+    const codec_options& codec)
+{
+    auto& m = metrics::local();
+    metrics::scoped_timer timer(m, metrics::histogram::flush);
+    std::vector<const record*> live;
+    live.reserve(store.size());
+    store.for_each([&](const record& r) {
+        if (store.find(r.key) == &r)
+            live.push_back(&r);
+    });
+    std::sort(live.begin(), live.end(), [](const record* a, const record* b) { return a->key < b->key; });
+
+    std::vector<std::uint64_t> keys(live.size());
+    for (std::size_t i = 0; i < live.size(); ++i)
+        keys[i] = live[i]->key;
+
+    segment_writer w(path, io, codec);
+    w.add_column<std::uint64_t>(segment::key_column, keys);
+    w.add_block(segment::filter_block, bloom_filter::build(keys));
+    w.add_binary_column(segment::value_column, live.size(), [&](std::size_t i) { return live[i]->value(); });
+    w.finish();
+    m.add(metrics::counter::flushes);
+    m.add(metrics::counter::flush_bytes, w.bytes_written());
+}
+
+} // namespace yeni
@@ -0,0 +1,244 @@
+#include "yeni/shard_group.hpp"
+
+#include "yeni/epoch.hpp"
+#include "yeni/futex.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/numa.hpp"
+#include "yeni/scheduler.hpp"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace yeni {
+
+namespace {
+
+struct current_context {
+    const shard_group* owner = nullptr;
+    shard* self = nullptr;
+};
+
+thread_local current_context tls_current;
+
+// Messages a shard takes out of one ring at a time.
+constexpr std::size_t poll_batch = 32;
+
+} // namespace
+
+shard_group::shard_group(shard_group_options options) : options_(std::move(options))
+{
+    const auto& topo = numa_topology::system();
+    std::vector<std::pair<unsigned, unsigned>> cpus; // (cpu, node), node-major
+    for (const auto& n : topo.nodes())
+        for (unsigned c : n.cpus)
+            cpus.emplace_back(c, n.id);
+
+    const unsigned count = options_.shards ? options_.shards : unsigned(cpus.size());
+    const bool pin = options_.pin && count <= cpus.size();
+    shards_.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        auto s = std::make_unique<shard>();
+        s->id_ = i;
+        s->node_ = cpus[i % cpus.size()].second;
+        s->cpu_ = pin ? int(cpus[i].first) : -1;
+        shards_.push_back(std::move(s));
+    }
+    mailboxes_ = std::make_unique<mailbox[]>(count);
+    for (unsigned i = 0; i < count; ++i)
+        mailboxes_[i].inject = std::make_unique<mpsc_queue<shard_message*>>(options_.ring_capacity);
+    rings_.resize(std::size_t(count) * count);
+    start_errors_.resize(count);
+
+    threads_.reserve(count);
+    for (unsigned i = 0; i < count; ++i)
+        threads_.emplace_back([this, i] { shard_main(i); });
+    while (true) {
+        const std::uint32_t ready = ready_.load(std::memory_order_acquire);
+        if (ready == count)
+            break;
+        futex_wait(ready_, ready);
+    }
+    for (auto& e : start_errors_) {
+        if (e) {
+            stop();
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+shard_group::~shard_group()
+{
+    stop();
+}
+
+void shard_group::stop() noexcept
+{
+    stop_.store(true, std::memory_order_seq_cst);
+    for (unsigned i = 0; i < size(); ++i) {
+        mailboxes_[i].doorbell.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(mailboxes_[i].doorbell);
+    }
+    for (auto& t : threads_)
+        t.join();
+    threads_.clear();
+}
+
+shard* shard_group::current() const noexcept
+{
+    return tls_current.owner == this ? tls_current.self : nullptr;
+}
+
+void shard_group::shard_main(unsigned index)
+{
+    shard& self = *shards_[index];
+    tls_current = {this, &self};
+    if (self.cpu_ >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(self.cpu_, &set);
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    }
+    // Everything the shard owns is created here, after pinning, so that
+    // it is first touched from the shard's CPU.
+    try {
+        for (unsigned from = 0; from < size(); ++from)
+            rings_[std::size_t(index) * size() + from]
+                = std::make_unique<spsc_queue<shard_message*>>(options_.ring_capacity);
+        self.memory_ = std::make_unique<page_provider>(
+            page_provider_options{.pages = options_.pages, .node_local = false, .node = int(self.node_)});
+        self.store_ = std::make_unique<record_store>(options_.arena_block_size, *self.memory_);
+        block_cache_options cache = options_.cache;
+        cache.memory = self.memory_.get();
+        self.cache_ = std::make_unique<block_cache>(cache);
+    } catch (...) {
+        start_errors_[index] = std::current_exception();
+    }
+    ready_.fetch_add(1, std::memory_order_release);
+    futex_wake(ready_);
+
+    mailbox& mb = mailboxes_[index];
+    unsigned idle = 0;
+    while (true) {
+        if (!start_errors_[index] && poll(self)) {
+            idle = 0;
+            continue;
+        }
+        if (stop_.load(std::memory_order_acquire))
+            break;
+        if (++idle < 64) {
+            scheduler::cpu_relax();
+            continue;
+        }
+        if (idle < 96) {
+            std::this_thread::yield();
+            continue;
+        }
+        // Pairs with the fence in ring_doorbell(): either the recheck sees
+        // the message or the poster sees us asleep.
+        mb.sleeping.store(1, std::memory_order_seq_cst);
+        const std::uint32_t bell = mb.doorbell.load(std::memory_order_seq_cst);
+        if (!poll(self) && !stop_.load(std::memory_order_relaxed))
+            futex_wait(mb.doorbell, bell);
+        mb.sleeping.store(0, std::memory_order_relaxed);
+        idle = 0;
+    }
+
+    self.cache_.reset();
+    // Arenas a reset() retired still point into the provider.
+    self.store_.reset();
+    epoch::synchronize();
+    self.memory_.reset();
+    tls_current = {};
+}
+
+bool shard_group::poll(shard& self)
+{
+    shard_message* batch[poll_batch];
+    std::size_t ran = 0;
+    const auto run = [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+            batch[i]->run(batch[i], self);
+        ran += n;
+    };
+    for (unsigned from = 0; from < size(); ++from)
+        run(ring(from, self.id()).try_pop_batch(batch));
+    run(mailboxes_[self.id()].inject->try_pop_batch(batch));
+    if (ran)
+        metrics::local().add(metrics::counter::shard_messages, ran);
+    return ran != 0;
+}
+
+void shard_group::ring_doorbell(unsigned to) noexcept
+{
+    mailbox& mb = mailboxes_[to];
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mb.sleeping.load(std::memory_order_relaxed)) {
+        mb.doorbell.fetch_add(1, std::memory_order_relaxed);
+        futex_wake(mb.doorbell, 1);
+    }
+}
+
+void shard_group::post(unsigned to, shard_message& m)
+{
+    if (shard* self = current()) {
+        auto& q = ring(self->id(), to);
+        if (!q.try_push(&m)) {
+            metrics::local().add(metrics::counter::shard_ring_full);
+            // The receiver may be waiting on us: run what it sent while
+            // it drains the ring.
+            do {
+                ring_doorbell(to);
+                if (!poll(*self))
+                    scheduler::cpu_relax();
+            } while (!q.try_push(&m));
+        }
+    } else {
+        mailboxes_[to].inject->push(&m);
+    }
+    ring_doorbell(to);
+}
+
+void shard_group::complete(reply& r) noexcept
+{
+    // `r` may be gone once done is set: read what we need first.
+    const int waiter = r.waiter;
+    if (waiter >= 0) {
+        r.done.store(1, std::memory_order_seq_cst);
+        ring_doorbell(unsigned(waiter));
+    } else {
+        r.done.store(1, std::memory_order_release);
+        futex_wake(r.done);
+    }
+}
+
+void shard_group::await(reply& r)
+{
+    shard* self = current();
+    if (!self) {
+        while (!r.done.load(std::memory_order_acquire))
+            futex_wait(r.done, 0);
+        return;
+    }
+    mailbox& mb = mailboxes_[self->id()];
+    unsigned idle = 0;
+    while (!r.done.load(std::memory_order_acquire)) {
+        if (poll(*self)) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < 64) {
+            scheduler::cpu_relax();
+            continue;
+        }
+        mb.sleeping.store(1, std::memory_order_seq_cst);
+        const std::uint32_t bell = mb.doorbell.load(std::memory_order_seq_cst);
+        if (!r.done.load(std::memory_order_seq_cst) && !poll(*self))
+            futex_wait(mb.doorbell, bell);
+        mb.sleeping.store(0, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+} // namespace yeni
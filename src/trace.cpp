@@ -0,0 +1,484 @@
+#include "yeni/trace.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yeni::trace {
+
+namespace {
+
+constexpr std::string_view span_names[] = {
+    "lookup",
+    "scan",
+    "morsel",
+    "queue_wait",
+    "index_probe",
+    "cache_miss",
+    "io_wait",
+    "decode",
+};
+static_assert(std::size(span_names) == span_kind_count);
+
+constexpr std::uint64_t arg_mask = (std::uint64_t(1) << 56) - 1;
+
+#if YENI_TRACE
+
+std::uint64_t now_ns() noexcept
+{
+    return std::uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+/// Events of one thread. Only the owner writes; readers copy a window of
+/// cells and then check `claimed` to throw away the ones the owner may have
+/// been overwriting meanwhile, the seqlock pattern stretched over a ring.
+/// Every cell is an atomic, so a torn copy is discarded, never undefined.
+struct ring {
+    struct cell {
+        std::atomic<std::uint64_t> start{0};
+        std::atomic<std::uint64_t> duration{0};
+        std::atomic<std::uint64_t> id{0};
+        std::atomic<std::uint64_t> parent{0};
+        std::atomic<std::uint64_t> trace{0};
+        std::atomic<std::uint64_t> kind_arg{0}; // kind << 56 | arg
+    };
+
+    void push(span_kind kind, std::uint64_t start_ns, std::uint64_t duration_ns, std::uint64_t span_id,
+        std::uint64_t parent_id, std::uint64_t trace_id, std::uint64_t arg) noexcept
+    {
+        const std::uint64_t i = head.load(std::memory_order_relaxed);
+        claimed.store(i + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        cell& c = cells[i % ring_capacity];
+        c.start.store(start_ns, std::memory_order_relaxed);
+        c.duration.store(duration_ns, std::memory_order_relaxed);
+        c.id.store(span_id, std::memory_order_relaxed);
+        c.parent.store(parent_id, std::memory_order_relaxed);
+        c.trace.store(trace_id, std::memory_order_relaxed);
+        c.kind_arg.store(std::uint64_t(kind) << 56 | (arg & arg_mask), std::memory_order_relaxed);
+        head.store(i + 1, std::memory_order_release);
+    }
+
+    void copy_to(std::vector<event>& out) const
+    {
+        const std::uint64_t end = head.load(std::memory_order_acquire);
+        const std::uint64_t begin = end > ring_capacity ? end - ring_capacity : 0;
+        const std::size_t first = out.size();
+        for (std::uint64_t i = begin; i < end; ++i) {
+            const cell& c = cells[i % ring_capacity];
+            event e;
+            e.thread = index;
+            e.start_ns = c.start.load(std::memory_order_relaxed);
+            e.duration_ns = c.duration.load(std::memory_order_relaxed);
+            e.id = c.id.load(std::memory_order_relaxed);
+            e.parent = c.parent.load(std::memory_order_relaxed);
+            e.trace = c.trace.load(std::memory_order_relaxed);
+            const std::uint64_t kind_arg = c.kind_arg.load(std::memory_order_relaxed);
+            e.kind = span_kind(kind_arg >> 56);
+            e.arg = kind_arg & arg_mask;
+            out.push_back(e);
+        }
+        // Index i lives in the cell that index i + capacity overwrites, and
+        // the owner claims an index before it touches its cell.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t c = claimed.load(std::memory_order_relaxed);
+        const std::uint64_t valid = c > ring_capacity ? c - ring_capacity : 0;
+        if (valid > begin) {
+            const auto drop = std::ptrdiff_t(std::min(valid - begin, end - begin));
+            out.erase(out.begin() + std::ptrdiff_t(first), out.begin() + std::ptrdiff_t(first) + drop);
+        }
+    }
+
+    std::array<cell, ring_capacity> cells;
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    std::atomic<std::uint64_t> claimed{0};
+    std::uint64_t next_id = 0; // owner only
+    unsigned index = 0;        // 1-based
+    std::atomic<bool> in_use{false};
+    ring* next = nullptr;
+};
+
+/// Push-only list of every ring, like the metrics registry: rings are
+/// never freed, so collect() walks it while threads come and go.
+struct registry {
+    static registry& instance()
+    {
+        static registry r;
+        return r;
+    }
+
+    ring* claim() noexcept
+    {
+        for (ring* r = head.load(std::memory_order_acquire); r; r = r->next) {
+            bool idle = false;
+            if (r->in_use.compare_exchange_strong(idle, true, std::memory_order_acquire))
+                return r;
+        }
+        auto* r = new (std::nothrow) ring;
+        if (!r)
+            return nullptr;
+        r->in_use.store(true, std::memory_order_relaxed);
+        r->index = rings.fetch_add(1, std::memory_order_relaxed) + 1;
+        r->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return r;
+    }
+
+    static void release(ring* r) noexcept { r->in_use.store(false, std::memory_order_release); }
+
+    std::atomic<ring*> head{nullptr};
+    std::atomic<unsigned> rings{0};
+};
+
+/// Where the calling thread is: how deep in spans, whether its operation
+/// is sampled, and the span new ones nest under.
+struct thread_state {
+    ring* r;
+    std::uint32_t tick;
+    unsigned depth;
+    bool sampled;
+    std::uint64_t current;
+    std::uint64_t trace;
+};
+
+// Trivially constructible and initial-exec, like metrics' pointer, so
+// every access is a single %fs-relative load.
+__attribute__((tls_model("initial-exec"))) thread_local thread_state tls{};
+
+struct release_guard {
+    ~release_guard()
+    {
+        if (tls.r)
+            registry::release(std::exchange(tls.r, nullptr));
+    }
+};
+
+ring* own_ring() noexcept
+{
+    if (ring* r = tls.r) [[likely]]
+        return r;
+    thread_local release_guard guard;
+    tls.r = registry::instance().claim();
+    return tls.r;
+}
+
+std::uint64_t new_id(ring& r) noexcept { return std::uint64_t(r.index) << 40 | ++r.next_id; }
+
+// The sampling decision for a span that is not nested in an operation.
+bool sample_root(thread_state& st) noexcept
+{
+    const std::uint32_t every = detail::sample_every.load(std::memory_order_relaxed);
+    return every && ++st.tick % every == 0;
+}
+
+#endif
+
+} // namespace
+
+std::string_view name(span_kind k) noexcept
+{
+    return span_names[std::size_t(k)];
+}
+
+#if YENI_TRACE
+
+void span::begin() noexcept
+{
+    thread_state& st = tls;
+    entered_ = true;
+    if (st.depth++ == 0)
+        st.sampled = sample_root(st);
+    if (!st.sampled)
+        return;
+    ring* r = own_ring();
+    if (!r)
+        return;
+    id_ = new_id(*r);
+    parent_ = st.current;
+    trace_ = parent_ ? st.trace : id_;
+    st.current = id_;
+    st.trace = trace_;
+    start_ = now_ns();
+}
+
+void span::end() noexcept
+{
+    thread_state& st = tls;
+    --st.depth;
+    if (!id_)
+        return;
+    const std::uint64_t t = now_ns();
+    st.current = parent_;
+    st.r->push(kind_, start_, t - start_, id_, parent_, trace_, arg_);
+}
+
+void async_span::start(span_kind kind) noexcept
+{
+    thread_state& st = tls;
+    if (st.depth ? !st.sampled : !sample_root(st))
+        return;
+    ring* r = own_ring();
+    if (!r)
+        return;
+    kind_ = kind;
+    id_ = new_id(*r);
+    parent_ = st.depth ? st.current : 0;
+    trace_ = parent_ ? st.trace : id_;
+    start_ = now_ns();
+}
+
+void async_span::finish(std::uint64_t arg) noexcept
+{
+    const std::uint64_t t = now_ns();
+    if (ring* r = own_ring())
+        r->push(kind_, start_, t - start_, id_, parent_, trace_, arg);
+    id_ = 0;
+}
+
+void detail::record_sampled(span_kind kind, std::chrono::steady_clock::time_point start,
+    std::chrono::nanoseconds duration, std::uint64_t arg) noexcept
+{
+    thread_state& st = tls;
+    if (st.depth ? !st.sampled : !sample_root(st))
+        return;
+    ring* r = own_ring();
+    if (!r)
+        return;
+    const std::uint64_t id = new_id(*r);
+    const std::uint64_t parent = st.depth ? st.current : 0;
+    r->push(kind, std::uint64_t(start.time_since_epoch().count()), std::uint64_t(std::max<std::int64_t>(0, duration.count())),
+        id, parent, parent ? st.trace : id, arg);
+}
+
+#endif
+
+std::vector<event> collect()
+{
+    std::vector<event> out;
+#if YENI_TRACE
+    for (const ring* r = registry::instance().head.load(std::memory_order_acquire); r; r = r->next)
+        r->copy_to(out);
+#endif
+    return out;
+}
+
+namespace {
+
+template <class... A>
+void append_format(std::string& out, const char* format, A... args)
+{
+    char buf[256];
+    const int n = std::snprintf(buf, sizeof(buf), format, args...);
+    out.append(buf, std::size_t(std::clamp(n, 0, int(sizeof(buf)) - 1)));
+}
+
+} // namespace
+
+std::string chrome_trace(const std::vector<event>& events)
+{
+    const int pid = int(::getpid());
+    std::string out;
+    out.reserve(64 + events.size() * 160);
+    out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const event& e = events[i];
+        const std::string_view n = name(e.kind);
+        append_format(out,
+            "%s\n{\"name\":\"%.*s\",\"cat\":\"yeni\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%" PRIu64
+            ".%03u,\"dur\":%" PRIu64 ".%03u,\"args\":{\"arg\":%" PRIu64 ",\"id\":\"%016" PRIx64
+            "\",\"parent\":\"%016" PRIx64 "\",\"trace\":\"%016" PRIx64 "\"}}",
+            i ? "," : "", int(n.size()), n.data(), pid, e.thread, e.start_ns / 1000, unsigned(e.start_ns % 1000),
+            e.duration_ns / 1000, unsigned(e.duration_ns % 1000), e.arg, e.id, e.parent, e.trace);
+    }
+    out.append("\n]}\n");
+    return out;
+}
+
+std::string otlp_json(const std::vector<event>& events)
+{
+    // Random enough to keep traces of different runs apart in a collector.
+    static const std::uint64_t prefix =
+        mix64(std::uint64_t(std::chrono::system_clock::now().time_since_epoch().count()) ^ std::uint64_t(::getpid()) << 32)
+        | 1;
+    const auto unix_offset = std::uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+        - std::chrono::steady_clock::now().time_since_epoch().count());
+
+    std::string out;
+    out.reserve(256 + events.size() * 320);
+    out.append("{\"resourceSpans\":[{\"resource\":{\"attributes\":[");
+    out.append("{\"key\":\"service.name\",\"value\":{\"stringValue\":\"yeni\"}},");
+    append_format(out, "{\"key\":\"process.pid\",\"value\":{\"intValue\":\"%d\"}}", int(::getpid()));
+    out.append("]},\"scopeSpans\":[{\"scope\":{\"name\":\"yeni\"},\"spans\":[");
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const event& e = events[i];
+        const std::string_view n = name(e.kind);
+        append_format(out, "%s\n{\"traceId\":\"%016" PRIx64 "%016" PRIx64 "\",\"spanId\":\"%016" PRIx64 "\",", i ? "," : "",
+            prefix, e.trace, e.id);
+        if (e.parent)
+            append_format(out, "\"parentSpanId\":\"%016" PRIx64 "\",", e.parent);
+        append_format(out,
+            "\"name\":\"%.*s\",\"kind\":1,\"startTimeUnixNano\":\"%" PRIu64 "\",\"endTimeUnixNano\":\"%" PRIu64 "\",",
+            int(n.size()), n.data(), e.start_ns + unix_offset, e.start_ns + e.duration_ns + unix_offset);
+        append_format(out,
+            "\"attributes\":[{\"key\":\"yeni.arg\",\"value\":{\"intValue\":\"%" PRIu64
+            "\"}},{\"key\":\"thread.id\",\"value\":{\"intValue\":\"%u\"}}]}",
+            e.arg, e.thread);
+    }
+    out.append("\n]}]}]}\n");
+    return out;
+}
+
+std::string folded_stacks(const std::vector<event>& events)
+{
+    std::unordered_map<std::uint64_t, std::size_t> by_id;
+    by_id.reserve(events.size());
+    for (std::size_t i = 0; i < events.size(); ++i)
+        by_id.emplace(events[i].id, i);
+    std::vector<std::uint64_t> children(events.size(), 0);
+    for (const event& e : events)
+        if (auto it = by_id.find(e.parent); e.parent && it != by_id.end())
+            children[it->second] += e.duration_ns;
+
+    std::map<std::string, std::uint64_t> stacks;
+    std::vector<std::string_view> path;
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        path.clear();
+        for (std::size_t j = i;;) {
+            path.push_back(name(events[j].kind));
+            const auto it = by_id.find(events[j].parent);
+            if (!events[j].parent || it == by_id.end())
+                break;
+            j = it->second;
+        }
+        std::string key;
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+            key.append(key.empty() ? "" : ";").append(*it);
+        stacks[key] += events[i].duration_ns - std::min(children[i], events[i].duration_ns);
+    }
+    std::string out;
+    for (const auto& [stack, ns] : stacks)
+        out.append(stack).append(" ").append(std::to_string(ns)).append("\n");
+    return out;
+}
+
+namespace {
+
+struct loaded_object {
+    std::string path;
+    std::uintptr_t bias;
+};
+
+// Function symbols of one ELF file, from .symtab if it has one and else
+// .dynsym, appended to `out` relocated by `bias`. Files that cannot be
+// read or parsed add nothing.
+std::size_t append_symbols(const loaded_object& obj, std::string& out)
+{
+    const int fd = ::open(obj.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && std::size_t(st.st_size) >= sizeof(Elf64_Ehdr))
+        map = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    const auto* base = static_cast<const std::uint8_t*>(map);
+    const auto size = std::size_t(st.st_size);
+    const auto in_file = [&](std::uint64_t off, std::uint64_t len) { return off <= size && len <= size - off; };
+
+    std::size_t written = 0;
+    const auto* eh = reinterpret_cast<const Elf64_Ehdr*>(base);
+    if (std::memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 && eh->e_ident[EI_CLASS] == ELFCLASS64
+        && eh->e_shentsize == sizeof(Elf64_Shdr) && in_file(eh->e_shoff, std::uint64_t(eh->e_shnum) * sizeof(Elf64_Shdr))) {
+        const auto* sh = reinterpret_cast<const Elf64_Shdr*>(base + eh->e_shoff);
+        const Elf64_Shdr* symtab = nullptr;
+        for (unsigned pass = 0; pass < 2 && !symtab; ++pass)
+            for (unsigned i = 0; i < eh->e_shnum && !symtab; ++i)
+                if (sh[i].sh_type == (pass == 0 ? SHT_SYMTAB : SHT_DYNSYM))
+                    symtab = &sh[i];
+        if (symtab && symtab->sh_link < eh->e_shnum && in_file(symtab->sh_offset, symtab->sh_size)
+            && in_file(sh[symtab->sh_link].sh_offset, sh[symtab->sh_link].sh_size)) {
+            const auto* syms = reinterpret_cast<const Elf64_Sym*>(base + symtab->sh_offset);
+            const auto* strings = reinterpret_cast<const char*>(base + sh[symtab->sh_link].sh_offset);
+            const std::size_t strings_size = sh[symtab->sh_link].sh_size;
+            for (std::size_t i = 0; i < symtab->sh_size / sizeof(Elf64_Sym); ++i) {
+                const Elf64_Sym& s = syms[i];
+                const unsigned type = ELF64_ST_TYPE(s.st_info);
+                if ((type != STT_FUNC && type != STT_GNU_IFUNC) || s.st_shndx == SHN_UNDEF || !s.st_value
+                    || !s.st_size || s.st_name >= strings_size)
+                    continue;
+                const char* mangled = strings + s.st_name;
+                if (!std::memchr(mangled, '\0', strings_size - s.st_name))
+                    continue;
+                int status = 0;
+                std::unique_ptr<char, decltype(&std::free)> demangled(
+                    abi::__cxa_demangle(mangled, nullptr, nullptr, &status), &std::free);
+                append_format(out, "%" PRIxPTR " %" PRIx64 " ", obj.bias + std::uintptr_t(s.st_value),
+                    std::uint64_t(s.st_size));
+                out.append(status == 0 && demangled ? demangled.get() : mangled).append("\n");
+                ++written;
+            }
+        }
+    }
+    ::munmap(map, size);
+    return written;
+}
+
+} // namespace
+
+std::size_t write_perf_map(const std::filesystem::path& path)
+{
+    std::vector<loaded_object> objects;
+    ::dl_iterate_phdr(
+        [](dl_phdr_info* info, std::size_t, void* data) {
+            auto& objs = *static_cast<std::vector<loaded_object>*>(data);
+            // The executable comes first and without a name.
+            const bool exe = objs.empty() && (!info->dlpi_name || !*info->dlpi_name);
+            if (exe || (info->dlpi_name && *info->dlpi_name == '/'))
+                objs.push_back({exe ? "/proc/self/exe" : info->dlpi_name, std::uintptr_t(info->dlpi_addr)});
+            return 0;
+        },
+        &objects);
+
+    std::string text;
+    std::size_t symbols = 0;
+    for (const auto& obj : objects)
+        symbols += append_symbols(obj, text);
+
+    const std::filesystem::path target =
+        path.empty() ? std::filesystem::path("/tmp/perf-" + std::to_string(::getpid()) + ".map") : path;
+    const std::filesystem::path tmp = target.string() + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(text.data(), std::streamsize(text.size()));
+        if (!f.flush())
+            throw_errno("write " + tmp.string());
+    }
+    std::filesystem::rename(tmp, target);
+    return symbols;
+}
+
+} // namespace yeni::trace
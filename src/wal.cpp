@@ -0,0 +1,744 @@
+#include "yeni/wal.hpp"
+
+#include "yeni/crc32c.hpp"
+#include "yeni/error.hpp"
+#include "yeni/futex.hpp"
+#include "yeni/metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yeni {
+
+static_assert(std::endian::native == std::endian::little, "log files are little-endian");
+
+namespace fmt = wal_format;
+
+namespace {
+
+constexpr std::size_t header_size = sizeof(fmt::header);
+
+std::filesystem::path segment_path(const std::filesystem::path& dir, std::uint64_t sequence)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "wal-%016" PRIx64 ".log", sequence);
+    return dir / name;
+}
+
+/// Segment files in `dir`, oldest first.
+std::vector<std::pair<std::uint64_t, std::filesystem::path>> list_segments(const std::filesystem::path& dir)
+{
+    std::vector<std::pair<std::uint64_t, std::filesystem::path>> out;
+    for (const auto& e : std::filesystem::directory_iterator(dir)) {
+        const std::string name = e.path().filename().string();
+        std::uint64_t sequence;
+        int end = 0;
+        if (name.size() == 24 && std::sscanf(name.c_str(), "wal-%16" SCNx64 ".log%n", &sequence, &end) == 1
+            && end == 24)
+            out.emplace_back(sequence, e.path());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void pwrite_all(int fd, const std::byte* p, std::size_t n, std::uint64_t offset)
+{
+    while (n) {
+        ssize_t w = ::pwrite(fd, p, n, off_t(offset));
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("wal write");
+        }
+        p += w;
+        n -= std::size_t(w);
+        offset += std::uint64_t(w);
+    }
+}
+
+void sync_directory(const std::filesystem::path& dir)
+{
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("open " + dir.string());
+    const int r = ::fsync(fd);
+    const int e = errno;
+    ::close(fd);
+    if (r != 0) {
+        errno = e;
+        throw_errno("fsync " + dir.string());
+    }
+}
+
+fmt::header read_header(int fd, const std::filesystem::path& path)
+{
+    fmt::header h;
+    if (::pread(fd, &h, sizeof(h), 0) != ssize_t(sizeof(h)) || std::memcmp(h.magic, fmt::magic, sizeof(h.magic)) != 0
+        || h.version != fmt::version)
+        throw format_error("yeni: " + path.string() + ": not a log segment");
+    return h;
+}
+
+fmt::header make_header(std::uint64_t sequence, std::uint64_t first_lsn) noexcept
+{
+    fmt::header h{};
+    std::memcpy(h.magic, fmt::magic, sizeof(h.magic));
+    h.version = fmt::version;
+    h.sequence = sequence;
+    h.first_lsn = first_lsn;
+    return h;
+}
+
+std::uint32_t record_crc(const fmt::record_header& h, std::uint32_t payload_crc) noexcept
+{
+    return crc32c(std::as_bytes(std::span(&h, 1)).subspan(sizeof(h.crc)), payload_crc);
+}
+
+/// The record header at `off` if it carries `lsn` and its record fits,
+/// else null. Only for records known to be durable; see record_at().
+const fmt::record_header* header_at(const std::byte* base, std::size_t size, std::size_t off, std::uint64_t lsn)
+{
+    if (size - off < sizeof(fmt::record_header))
+        return nullptr;
+    const auto* h = reinterpret_cast<const fmt::record_header*>(base + off);
+    if (h->lsn != lsn || fmt::footprint(h->size) > size - off)
+        return nullptr;
+    return h;
+}
+
+/// The record at `off` if it is intact and carries `lsn`, else null.
+const fmt::record_header* record_at(const std::byte* base, std::size_t size, std::size_t off, std::uint64_t lsn)
+{
+    const auto* h = header_at(base, size, off, lsn);
+    if (!h)
+        return nullptr;
+    const std::uint32_t payload_crc = crc32c({reinterpret_cast<const std::byte*>(h + 1), h->size});
+    return record_crc(*h, payload_crc) == h->crc ? h : nullptr;
+}
+
+/// Read-only mapping of a whole segment file.
+struct mapped_segment {
+    explicit mapped_segment(const std::filesystem::path& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw_errno("open " + path.string());
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            const int e = errno;
+            ::close(fd);
+            errno = e;
+            throw_errno("stat " + path.string());
+        }
+        size = std::size_t(st.st_size);
+        if (size < header_size) {
+            ::close(fd);
+            throw format_error("yeni: " + path.string() + ": not a log segment");
+        }
+        void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        const int e = errno;
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            errno = e;
+            throw_errno("mmap " + path.string());
+        }
+        ::madvise(map, size, MADV_SEQUENTIAL);
+        base = static_cast<const std::byte*>(map);
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, fmt::magic, sizeof(header.magic)) != 0 || header.version != fmt::version) {
+            release();
+            throw format_error("yeni: " + path.string() + ": not a log segment");
+        }
+    }
+    ~mapped_segment() { release(); }
+
+    mapped_segment(const mapped_segment&) = delete;
+    mapped_segment& operator=(const mapped_segment&) = delete;
+
+    void release() noexcept
+    {
+        if (base)
+            ::munmap(const_cast<std::byte*>(base), size);
+        base = nullptr;
+    }
+
+    const std::byte* base = nullptr;
+    std::size_t size = 0;
+    fmt::header header;
+};
+
+} // namespace
+
+wal::wal(std::filesystem::path dir, wal_options options)
+    : dir_(std::move(dir))
+    , options_(options)
+{
+    if (options_.segment_size < header_size + fmt::footprint(0) || options_.max_batch_bytes == 0)
+        throw std::invalid_argument("yeni: bad wal options");
+    std::filesystem::create_directories(dir_);
+    open_.bytes.reserve(options_.max_batch_bytes);
+    committing_.bytes.reserve(options_.max_batch_bytes);
+    try {
+        recover();
+        roll(next_lsn_);
+    } catch (...) {
+        if (spare_fd_ >= 0)
+            ::close(spare_fd_);
+        throw;
+    }
+    segment_used_ = header_size;
+    committer_ = std::thread([this] { run(); });
+}
+
+wal::~wal()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_one();
+    committer_.join();
+    if (fd_ >= 0)
+        ::close(fd_);
+    if (spare_fd_ >= 0)
+        ::close(spare_fd_);
+}
+
+void wal::recover()
+{
+    const auto segments = list_segments(dir_);
+    sequence_ = segments.empty() ? 0 : segments.back().first;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        mapped_segment s(it->second);
+        if (s.header.first_lsn == 0) {
+            // An unused spare: take the newest one over if it has the
+            // right size, drop any other.
+            if (it == segments.rbegin() && s.size == options_.segment_size) {
+                spare_fd_ = ::open(it->second.c_str(), O_RDWR | O_CLOEXEC);
+                if (spare_fd_ < 0)
+                    throw_errno("open " + it->second.string());
+                sequence_ = it->first - 1;
+            } else {
+                std::filesystem::remove(it->second);
+            }
+            continue;
+        }
+        std::uint64_t lsn = s.header.first_lsn;
+        for (std::size_t off = header_size; const auto* h = record_at(s.base, s.size, off, lsn); ++lsn)
+            off += fmt::footprint(h->size);
+        next_lsn_ = lsn;
+        durable_lsn_.store(lsn - 1, std::memory_order_relaxed);
+        break;
+    }
+}
+
+int wal::create_segment(std::uint64_t sequence)
+{
+    const std::filesystem::path path = segment_path(dir_, sequence);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw_errno("create " + path.string());
+    try {
+        if (const int e = ::posix_fallocate(fd, 0, off_t(options_.segment_size)); e != 0) {
+            errno = e;
+            throw_errno("fallocate " + path.string());
+        }
+        const fmt::header h = make_header(sequence, 0);
+        pwrite_all(fd, reinterpret_cast<const std::byte*>(&h), sizeof(h), 0);
+        // Size and extents now, so that commits into this file only ever
+        // need fdatasync.
+        if (::fsync(fd) != 0)
+            throw_errno("fsync " + path.string());
+        sync_directory(dir_);
+    } catch (...) {
+        ::close(fd);
+        std::filesystem::remove(path);
+        throw;
+    }
+    return fd;
+}
+
+void wal::prepare_spare()
+{
+    if (spare_fd_ < 0)
+        spare_fd_ = create_segment(sequence_ + 1);
+}
+
+void wal::roll(std::uint64_t first_lsn)
+{
+    prepare_spare();
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = std::exchange(spare_fd_, -1);
+    ++sequence_;
+    // Becomes durable with the first commit into the segment; a crash
+    // before that leaves a spare, which is just as good.
+    const fmt::header h = make_header(sequence_, first_lsn);
+    pwrite_all(fd_, reinterpret_cast<const std::byte*>(&h), sizeof(h), 0);
+    offset_ = header_size;
+}
+
+void wal::write_out(const std::byte* p, std::size_t n)
+{
+    pwrite_all(fd_, p, n, offset_);
+    offset_ += n;
+    if (options_.sync && ::fdatasync(fd_) != 0)
+        throw_errno("fdatasync " + segment_path(dir_, sequence_).string());
+}
+
+void wal::commit(const group& g)
+{
+    std::size_t from = 0;
+    for (const auto& [at, first_lsn] : g.rolls) {
+        write_out(g.bytes.data() + from, at - from);
+        roll(first_lsn);
+        from = at;
+    }
+    write_out(g.bytes.data() + from, g.bytes.size() - from);
+}
+
+void wal::run() noexcept
+{
+    auto& m = metrics::local();
+    std::unique_lock lock(mutex_);
+    while (true) {
+        if (open_.bytes.empty()) {
+            if (stop_)
+                return;
+            if (spare_fd_ < 0 && !error_) {
+                // Idle: get the next segment ready so rolling over never
+                // waits for an allocation. On failure roll() retries and
+                // reports it.
+                lock.unlock();
+                try {
+                    prepare_spare();
+                } catch (...) {
+                }
+                lock.lock();
+                if (stop_ || !open_.bytes.empty())
+                    continue;
+            }
+            committer_idle_ = true;
+            work_cv_.wait(lock, [&] { return stop_ || !open_.bytes.empty(); });
+            committer_idle_ = false;
+            continue;
+        }
+        if (options_.max_latency.count() > 0 && !stop_) {
+            committer_idle_ = true;
+            work_cv_.wait_until(lock, open_.opened + options_.max_latency, [&] { return stop_ || open_.full; });
+            committer_idle_ = false;
+        }
+
+        std::swap(open_, committing_);
+        if (committing_.full)
+            room_cv_.notify_all();
+        lock.unlock();
+
+        std::exception_ptr failed;
+        if (!error_) {
+            metrics::scoped_timer timer(m, metrics::histogram::wal_commit);
+            try {
+                commit(committing_);
+            } catch (...) {
+                failed = std::current_exception();
+            }
+            m.add(metrics::counter::wal_commits);
+        }
+
+        lock.lock();
+        if (failed) {
+            error_ = failed;
+            failed_.store(true, std::memory_order_release);
+            room_cv_.notify_all();
+        } else if (!error_) {
+            durable_lsn_.store(committing_.last_lsn, std::memory_order_release);
+        }
+        committing_.bytes.clear();
+        committing_.rolls.clear();
+        committing_.full = false;
+        commits_.fetch_add(1, std::memory_order_release);
+        futex_wake(commits_);
+    }
+}
+
+std::uint64_t wal::append_nowait(std::span<const std::byte> payload)
+{
+    const std::size_t footprint = fmt::footprint(payload.size());
+    if (payload.size() > std::numeric_limits<std::uint32_t>::max() || footprint > options_.segment_size - header_size)
+        throw std::length_error("yeni: wal record larger than a segment");
+    auto& m = metrics::local();
+    m.add(metrics::counter::wal_appends);
+    m.add(metrics::counter::wal_append_bytes, payload.size());
+    const std::uint32_t payload_crc = crc32c(payload);
+
+    std::unique_lock lock(mutex_);
+    // A record that does not fit waits for the next group, unless it is
+    // too big for any group: then it goes alone.
+    while (!error_ && !open_.bytes.empty() && open_.bytes.size() + footprint > options_.max_batch_bytes) {
+        if (!std::exchange(open_.full, true) && committer_idle_)
+            work_cv_.notify_one();
+        room_cv_.wait(lock);
+    }
+    if (error_)
+        std::rethrow_exception(error_);
+
+    const bool first = open_.bytes.empty();
+    const std::uint64_t lsn = next_lsn_++;
+    if (segment_used_ + footprint > options_.segment_size) {
+        open_.rolls.emplace_back(open_.bytes.size(), lsn);
+        segment_used_ = header_size;
+    }
+    segment_used_ += footprint;
+
+    const std::size_t at = open_.bytes.size();
+    open_.bytes.resize(at + footprint);
+    std::byte* p = open_.bytes.data() + at;
+    fmt::record_header h{0, std::uint32_t(payload.size()), lsn};
+    h.crc = record_crc(h, payload_crc);
+    std::memcpy(p, &h, sizeof(h));
+    if (!payload.empty())
+        std::memcpy(p + sizeof(h), payload.data(), payload.size());
+    std::memset(p + sizeof(h) + payload.size(), 0, footprint - sizeof(h) - payload.size());
+    open_.last_lsn = lsn;
+
+    if (first) {
+        if (options_.max_latency.count() > 0)
+            open_.opened = std::chrono::steady_clock::now();
+        if (committer_idle_)
+            work_cv_.notify_one();
+    } else if (open_.bytes.size() >= options_.max_batch_bytes && !std::exchange(open_.full, true) && committer_idle_) {
+        work_cv_.notify_one();
+    }
+    return lsn;
+}
+
+std::uint64_t wal::append_records(std::span<const std::byte> records, std::uint64_t first_lsn)
+{
+    std::uint64_t count = 0;
+    for (std::size_t off = 0; off < records.size(); ++count) {
+        const auto* h = header_at(records.data(), records.size(), off, first_lsn + count);
+        if (!h)
+            throw std::invalid_argument("yeni: wal append_records given a broken run of records");
+        if (fmt::footprint(h->size) > options_.segment_size - header_size)
+            throw std::length_error("yeni: wal record larger than a segment");
+        off += fmt::footprint(h->size);
+    }
+    if (count == 0)
+        throw std::invalid_argument("yeni: wal append_records given no records");
+    auto& m = metrics::local();
+    m.add(metrics::counter::wal_appends, count);
+    m.add(metrics::counter::wal_append_bytes, records.size());
+
+    std::unique_lock lock(mutex_);
+    while (!error_ && !open_.bytes.empty() && open_.bytes.size() + records.size() > options_.max_batch_bytes) {
+        if (!std::exchange(open_.full, true) && committer_idle_)
+            work_cv_.notify_one();
+        room_cv_.wait(lock);
+    }
+    if (error_)
+        std::rethrow_exception(error_);
+    if (first_lsn != next_lsn_)
+        throw std::invalid_argument("yeni: wal append_records out of sequence");
+
+    // One copy for the whole run; rolls still fall between records.
+    const bool first = open_.bytes.empty();
+    const std::size_t at = open_.bytes.size();
+    open_.bytes.insert(open_.bytes.end(), records.begin(), records.end());
+    for (std::size_t off = 0; off < records.size();) {
+        const std::size_t footprint =
+            fmt::footprint(reinterpret_cast<const fmt::record_header*>(records.data() + off)->size);
+        if (segment_used_ + footprint > options_.segment_size) {
+            open_.rolls.emplace_back(at + off, next_lsn_);
+            segment_used_ = header_size;
+        }
+        segment_used_ += footprint;
+        off += footprint;
+        ++next_lsn_;
+    }
+    open_.last_lsn = next_lsn_ - 1;
+
+    if (first) {
+        if (options_.max_latency.count() > 0)
+            open_.opened = std::chrono::steady_clock::now();
+        if (committer_idle_)
+            work_cv_.notify_one();
+    } else if (open_.bytes.size() >= options_.max_batch_bytes && !std::exchange(open_.full, true) && committer_idle_) {
+        work_cv_.notify_one();
+    }
+    return open_.last_lsn;
+}
+
+void wal::wait_durable(std::uint64_t lsn)
+{
+    while (true) {
+        const std::uint32_t seen = commits_.load(std::memory_order_acquire);
+        if (durable_lsn_.load(std::memory_order_acquire) >= lsn)
+            return;
+        if (failed_.load(std::memory_order_acquire)) {
+            std::lock_guard lock(mutex_);
+            std::rethrow_exception(error_);
+        }
+        futex_wait(commits_, seen);
+    }
+}
+
+bool wal::wait_durable_for(std::uint64_t lsn, std::chrono::nanoseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        const std::uint32_t seen = commits_.load(std::memory_order_acquire);
+        if (durable_lsn_.load(std::memory_order_acquire) >= lsn)
+            return true;
+        if (failed_.load(std::memory_order_acquire)) {
+            std::lock_guard lock(mutex_);
+            std::rethrow_exception(error_);
+        }
+        if (!futex_wait_for(commits_, seen, deadline - std::chrono::steady_clock::now())
+            && std::chrono::steady_clock::now() >= deadline)
+            return false;
+    }
+}
+
+std::uint64_t wal::append(std::span<const std::byte> payload)
+{
+    auto& m = metrics::local();
+    metrics::scoped_timer timer(m, metrics::histogram::wal_append, m.sample(metrics::histogram::wal_append));
+    const std::uint64_t lsn = append_nowait(payload);
+    wait_durable(lsn);
+    return lsn;
+}
+
+std::uint64_t wal::durable_lsn() const
+{
+    return durable_lsn_.load(std::memory_order_acquire);
+}
+
+std::uint64_t wal::next_lsn() const
+{
+    std::lock_guard lock(mutex_);
+    return next_lsn_;
+}
+
+void wal::truncate_before(std::uint64_t lsn)
+{
+    // Headers are read rather than tracked: a segment can go once its
+    // successor is in use and starts at or below `lsn`. The open segment
+    // has no such successor.
+    const auto segments = list_segments(dir_);
+    std::vector<std::uint64_t> first(segments.size(), 0);
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        const int fd = ::open(segments[i].second.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw_errno("open " + segments[i].second.string());
+        try {
+            first[i] = read_header(fd, segments[i].second).first_lsn;
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+    bool removed = false;
+    for (std::size_t i = 0; i + 1 < segments.size(); ++i) {
+        if (first[i] == 0 || first[i + 1] == 0 || first[i + 1] > lsn)
+            break;
+        std::filesystem::remove(segments[i].second);
+        removed = true;
+    }
+    if (removed)
+        sync_directory(dir_);
+}
+
+wal_reader::wal_reader(const std::filesystem::path& dir, std::uint64_t from_lsn)
+    : from_lsn_(from_lsn)
+{
+    for (auto& [sequence, path] : list_segments(dir))
+        segments_.push_back(std::move(path));
+    // Start in the last segment beginning at or below `from_lsn`: the ones
+    // before it are passed over on their headers, without being mapped.
+    for (std::size_t i = 1; from_lsn_ > 1 && i < segments_.size(); ++i) {
+        const int fd = ::open(segments_[i].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            break;
+        std::uint64_t first = 0;
+        try {
+            first = read_header(fd, segments_[i]).first_lsn;
+        } catch (const format_error&) {
+        }
+        ::close(fd);
+        if (first == 0 || first > from_lsn_)
+            break;
+        segment_index_ = i;
+    }
+}
+
+wal_reader::~wal_reader()
+{
+    unmap();
+}
+
+void wal_reader::unmap() noexcept
+{
+    if (map_)
+        ::munmap(const_cast<std::byte*>(map_), map_size_);
+    map_ = nullptr;
+}
+
+bool wal_reader::open_next_segment()
+{
+    while (segment_index_ < segments_.size()) {
+        mapped_segment s(segments_[segment_index_++]);
+        if (s.header.first_lsn == 0)
+            continue;
+        map_ = std::exchange(s.base, nullptr);
+        map_size_ = s.size;
+        offset_ = header_size;
+        expected_lsn_ = s.header.first_lsn;
+        return true;
+    }
+    return false;
+}
+
+bool wal_reader::next(wal_entry& out)
+{
+    while (map_ || open_next_segment()) {
+        const auto* h = record_at(map_, map_size_, offset_, expected_lsn_);
+        if (!h) {
+            unmap();
+            continue;
+        }
+        offset_ += fmt::footprint(h->size);
+        if (expected_lsn_++ < from_lsn_)
+            continue;
+        out = {h->lsn, {reinterpret_cast<const std::byte*>(h + 1), h->size}};
+        return true;
+    }
+    return false;
+}
+
+void decode_wal_records(std::span<const std::byte> records, std::uint64_t first_lsn, std::vector<wal_entry>& out)
+{
+    std::uint64_t lsn = first_lsn;
+    for (std::size_t off = 0; off < records.size(); ++lsn) {
+        const auto* h = record_at(records.data(), records.size(), off, lsn);
+        if (!h)
+            throw format_error("yeni: damaged wal record " + std::to_string(lsn));
+        out.push_back({lsn, {reinterpret_cast<const std::byte*>(h + 1), h->size}});
+        off += fmt::footprint(h->size);
+    }
+}
+
+wal_cursor::wal_cursor(wal& log, std::uint64_t from_lsn) : log_(log)
+{
+    const std::uint64_t durable = log_.durable_lsn();
+    if (from_lsn == 0 || from_lsn > durable + 1)
+        throw std::out_of_range("yeni: wal_cursor start beyond the durable log");
+    // The newest segment in use that starts at or below `from_lsn`.
+    std::uint64_t first = 0;
+    for (const auto& [sequence, path] : list_segments(log_.directory())) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue; // truncated away meanwhile
+        fmt::header h;
+        try {
+            h = read_header(fd, path);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        if (h.first_lsn == 0 || h.first_lsn > from_lsn)
+            break;
+        sequence_ = sequence;
+        first = h.first_lsn;
+    }
+    if (first == 0)
+        throw std::out_of_range("yeni: wal_cursor start truncated from the log");
+    open_segment(sequence_);
+    // Everything below `from_lsn` is durable, so its headers can be
+    // trusted without checking the CRCs.
+    while (expected_lsn_ < from_lsn) {
+        const auto* h = header_at(map_, map_size_, offset_, expected_lsn_);
+        if (!h) {
+            close();
+            throw format_error("yeni: wal segment " + std::to_string(sequence_) + " ends before its successor");
+        }
+        offset_ += fmt::footprint(h->size);
+        ++expected_lsn_;
+    }
+}
+
+wal_cursor::~wal_cursor()
+{
+    close();
+}
+
+void wal_cursor::close() noexcept
+{
+    if (map_)
+        ::munmap(const_cast<std::byte*>(map_), map_size_);
+    map_ = nullptr;
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+}
+
+void wal_cursor::open_segment(std::uint64_t sequence)
+{
+    const std::filesystem::path path = segment_path(log_.directory(), sequence);
+    mapped_segment s(path);
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno("open " + path.string());
+    close();
+    fd_ = fd;
+    map_ = std::exchange(s.base, nullptr);
+    map_size_ = s.size;
+    offset_ = header_size;
+    sequence_ = sequence;
+    // Only the first segment may start below the cursor; a successor has
+    // to start right where its predecessor ended.
+    if (expected_lsn_ != 0 && s.header.first_lsn != expected_lsn_)
+        throw format_error("yeni: wal segment " + path.string() + " does not continue its predecessor");
+    expected_lsn_ = s.header.first_lsn;
+}
+
+bool wal_cursor::next(wal_range& out, std::size_t max_bytes, std::chrono::nanoseconds timeout)
+{
+    if (log_.durable_lsn() < expected_lsn_ && !log_.wait_durable_for(expected_lsn_, timeout))
+        return false;
+    const std::uint64_t durable = log_.durable_lsn();
+    while (true) {
+        const std::size_t begin = offset_;
+        const std::uint64_t first = expected_lsn_;
+        while (expected_lsn_ <= durable) {
+            const auto* h = header_at(map_, map_size_, offset_, expected_lsn_);
+            if (!h)
+                break;
+            const std::size_t footprint = fmt::footprint(h->size);
+            if (offset_ > begin && offset_ - begin + footprint > max_bytes)
+                break;
+            offset_ += footprint;
+            ++expected_lsn_;
+        }
+        if (expected_lsn_ > first) {
+            out = {fd_, begin, offset_ - begin, first, expected_lsn_ - 1};
+            return true;
+        }
+        // A durable record that is not here starts the next segment.
+        open_segment(sequence_ + 1);
+    }
+}
+
+} // namespace yeni
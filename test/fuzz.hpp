@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+/// Fuzz targets for the parsers of untrusted bytes: segment files, their
+/// B+tree aux blocks, WAL segments and text imports. Each takes one input
+/// in libFuzzer's form and returns 0. A rejected input may only throw the
+/// errors the parser documents, which the target swallows; anything else
+/// escapes, and memory errors are left for the sanitizers to catch.
+///
+/// test_fuzz.cpp drives them from seeds and a deterministic mutator as
+/// part of yeni_test; with YENI_FUZZ (Clang only) each also builds into a
+/// libFuzzer binary, yeni_fuzz_<name>.
+namespace yeni::test {
+
+int fuzz_segment(const std::uint8_t* data, std::size_t size);
+int fuzz_btree_view(const std::uint8_t* data, std::size_t size);
+int fuzz_wal(const std::uint8_t* data, std::size_t size);
+int fuzz_bulk(const std::uint8_t* data, std::size_t size);
+
+/// A property a target checks beyond not crashing did not hold.
+inline void fuzz_check(bool ok, const char* what)
+{
+    if (!ok)
+        throw std::logic_error(std::string("fuzz check failed: ") + what);
+}
+
+/// Per-process scratch path for targets that need their input in a file.
+inline std::filesystem::path fuzz_path(const char* name)
+{
+    return std::filesystem::temp_directory_path() /
+        ("yeni-fuzz-" + std::to_string(::getpid()) + "-" + name);
+}
+
+} // namespace yeni::test
@@ -0,0 +1,68 @@
+#include "fuzz.hpp"
+
+#include "yeni/btree.hpp"
+#include "yeni/error.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace yeni::test {
+
+namespace {
+
+void probe_view(std::span<const std::byte> bytes)
+{
+    try {
+        const btree_view tree(bytes);
+        // Keys taken from the input, so that some of them hit.
+        for (std::size_t off = 0; off < bytes.size(); off += 509)
+            tree.find(bytes.subspan(off, std::min<std::size_t>(bytes.size() - off, 1 + off % 24)));
+        const std::vector<std::byte> last(btree_index::max_key_size, std::byte{0xff});
+        std::size_t entries = 0;
+        tree.scan({}, last, [&](std::span<const std::byte>, std::uint64_t) { ++entries; });
+        if (entries < 100000) {
+            const btree_index copy(tree);
+            fuzz_check(copy.size() <= entries, "a reload holds no more than the scan saw");
+        }
+    } catch (const format_error&) {
+    }
+}
+
+// Gives one node fences and a prefix longer than any key, but consistent
+// with each other and with the node size, which byte mutations alone
+// almost never produce. The offsets are those of the node header in
+// btree.cpp; the nodes follow a file header shorter than one node.
+void stretch_node(std::byte* data, std::size_t size, const std::uint8_t* input)
+{
+    constexpr std::size_t node = btree_index::node_bytes, header = 32;
+    const std::size_t nodes = size / node;
+    std::byte* n = data + size % node + input[0] % nodes * node;
+    const auto room = std::uint16_t(node - header - btree_index::max_key_size - 1);
+    const auto lower = std::uint16_t(btree_index::max_key_size + 1 + (input[1] | input[2] << 8) % room);
+    const auto upper = std::uint16_t((input[3] | input[4] << 8) % (node - header - lower + 1));
+    const auto prefix = std::uint16_t(input[5] & 1 ? lower : std::min<std::size_t>(lower, upper));
+    n[19] |= std::byte{3}; // has_lower | has_upper
+    std::memcpy(n + 20, &prefix, 2);
+    std::memcpy(n + 26, &lower, 2);
+    std::memcpy(n + 28, &upper, 2);
+}
+
+} // namespace
+
+int fuzz_btree_view(const std::uint8_t* data, std::size_t size)
+{
+    // btree_view wants its bytes 8-byte aligned, as a segment block is.
+    std::vector<std::uint64_t> storage((size + 7) / 8);
+    if (size)
+        std::memcpy(storage.data(), data, size);
+    auto* raw = reinterpret_cast<std::byte*>(storage.data());
+    probe_view({raw, size});
+    if (size >= btree_index::node_bytes + 6) {
+        stretch_node(raw, size, data + size - 6);
+        probe_view({raw, size});
+    }
+    return 0;
+}
+
+} // namespace yeni::test
@@ -0,0 +1,53 @@
+#include "fuzz.hpp"
+
+#include "yeni/bulk.hpp"
+#include "yeni/error.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+
+namespace yeni::test {
+
+// The first byte picks the format and options, the rest is the text.
+int fuzz_bulk(const std::uint8_t* data, std::size_t size)
+{
+    using column_type = segment_format::column_type;
+    static const schema s({{"id", column_type::u64}, {"n", column_type::i64}, {"x", column_type::f64},
+        {"q", column_type::u32}, {"name", column_type::binary}});
+    if (size == 0)
+        return 0;
+    bulk_options o;
+    o.format = data[0] & 1 ? text_format::ndjson : text_format::csv;
+    o.header = !(data[0] & 2);
+    o.delimiter = data[0] & 4 ? ';' : ',';
+    o.chunk_bytes = std::size_t(1) << (data[0] >> 3 & 15);
+    o.threads = 1 + (data[0] >> 7);
+    o.queue_depth = 1;
+
+    const std::filesystem::path path = fuzz_path("bulk");
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f)
+        throw std::system_error(errno, std::generic_category(), "fopen " + path.string());
+    const bool written = std::fwrite(data + 1, 1, size - 1, f) == size - 1;
+    if (std::fclose(f) != 0 || !written)
+        throw std::system_error(errno, std::generic_category(), "write " + path.string());
+    try {
+        std::uint64_t rows = 0;
+        const bulk_stats st = import_text(
+            path, s,
+            [&](std::span<const std::span<const std::byte>> records) {
+                for (const auto r : records)
+                    fuzz_check(s.validate(r), "imported records validate");
+                rows += records.size();
+            },
+            o);
+        fuzz_check(st.rows == rows, "stats count the rows delivered");
+        fuzz_check(st.bytes == size - 1, "stats count the whole input");
+    } catch (const format_error&) {
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
+
+} // namespace yeni::test
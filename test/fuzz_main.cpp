@@ -0,0 +1,8 @@
+// libFuzzer entry point; YENI_FUZZ_ENTRY names the target (see fuzz.hpp).
+
+#include "fuzz.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    return YENI_FUZZ_ENTRY(data, size);
+}
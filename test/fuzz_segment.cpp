@@ -0,0 +1,110 @@
+#include "fuzz.hpp"
+
+#include "yeni/block_cache.hpp"
+#include "yeni/btree.hpp"
+#include "yeni/error.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/segment.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+namespace yeni::test {
+
+namespace {
+
+void write_input(const std::filesystem::path& path, const std::uint8_t* data, std::size_t size)
+{
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f)
+        throw std::system_error(errno, std::generic_category(), "fopen " + path.string());
+    const bool ok = std::fwrite(data, 1, size, f) == size;
+    if (std::fclose(f) != 0 || !ok)
+        throw std::system_error(errno, std::generic_category(), "write " + path.string());
+}
+
+template <class T>
+void read_fixed(const segment& s, std::string_view name)
+{
+    const std::span<const T> all = s.column<T>(name);
+    std::size_t rows = 0;
+    s.scan<T>(name, [&](std::size_t first, std::span<const T> page) {
+        fuzz_check(first == rows, "scan() pages are consecutive");
+        for (std::size_t i = 0; i < page.size(); ++i)
+            fuzz_check(std::memcmp(&page[i], &all[first + i], sizeof(T)) == 0, "scan() agrees with column()");
+        rows += page.size();
+    });
+    fuzz_check(rows == all.size(), "scan() covers the column");
+}
+
+// Touch everything a reader can reach through the public interface.
+void read_all(const segment& s)
+{
+    block_cache cache({.capacity_bytes = 64 << 10, .shards = 1, .block_bytes = 4096});
+    for (const auto& d : s.blocks()) {
+        const std::string_view name = d.name_view();
+        try {
+            const std::span<const std::byte> raw = s.block_data(name);
+            for (std::uint64_t chunk = 0; chunk * cache.block_bytes() < raw.size() && chunk < 4; ++chunk)
+                s.read_cached(cache, name, chunk);
+            if (d.kind == segment_format::block_kind::aux) {
+                const btree_view tree = btree_view::open(s, name);
+                tree.find(raw.first(std::min<std::size_t>(raw.size(), 16)));
+                continue;
+            }
+            s.encoding(name);
+            switch (d.type) {
+            case segment_format::column_type::u32:
+                read_fixed<std::uint32_t>(s, name);
+                break;
+            case segment_format::column_type::u64:
+                read_fixed<std::uint64_t>(s, name);
+                break;
+            case segment_format::column_type::i64:
+                read_fixed<std::int64_t>(s, name);
+                break;
+            case segment_format::column_type::f64:
+                read_fixed<double>(s, name);
+                break;
+            case segment_format::column_type::binary: {
+                const binary_column c = s.binary(name);
+                for (std::size_t i = 0; i < c.size(); ++i)
+                    c[i];
+                selection_bitmap rows;
+                filter_string_compare(s, name, compare_op::lt, "https://tenant-1", rows);
+                filter_string_prefix(s, name, "https://", rows);
+                break;
+            }
+            default:
+                break;
+            }
+        } catch (const format_error&) {
+        }
+    }
+    const std::span<const std::uint64_t> keys = s.keys();
+    for (std::size_t i = 0; i < keys.size() && i < 64; ++i) {
+        s.key_filter().may_contain(keys[i]);
+        s.find(keys[i]);
+    }
+    s.find(0);
+}
+
+} // namespace
+
+int fuzz_segment(const std::uint8_t* data, std::size_t size)
+{
+    const std::filesystem::path path = fuzz_path("segment");
+    write_input(path, data, size);
+    try {
+        const segment s = segment::open(path);
+        read_all(s);
+    } catch (const format_error&) {
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
+
+} // namespace yeni::test
@@ -0,0 +1,69 @@
+#include "fuzz.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/wal.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+#include <vector>
+
+namespace yeni::test {
+
+namespace {
+
+struct replay {
+    std::uint64_t records = 0;
+    std::uint64_t last_lsn = 0;
+};
+
+replay read_log(const std::filesystem::path& dir)
+{
+    replay r;
+    wal_reader reader(dir);
+    wal_entry e;
+    while (reader.next(e)) {
+        fuzz_check(r.records == 0 || e.lsn == r.last_lsn + 1, "LSNs are consecutive");
+        ++r.records;
+        r.last_lsn = e.lsn;
+    }
+    return r;
+}
+
+} // namespace
+
+// The input is the first segment of a log. Replay must stop cleanly at
+// whatever garbage it holds, and a log opened over it must continue right
+// after the last record replay returned.
+int fuzz_wal(const std::uint8_t* data, std::size_t size)
+{
+    const std::filesystem::path dir = fuzz_path("wal");
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::filesystem::path segment = dir / "wal-0000000000000001.log";
+    std::FILE* f = std::fopen(segment.c_str(), "wb");
+    if (!f)
+        throw std::system_error(errno, std::generic_category(), "fopen " + segment.string());
+    const bool written = std::fwrite(data, 1, size, f) == size;
+    if (std::fclose(f) != 0 || !written)
+        throw std::system_error(errno, std::generic_category(), "write " + segment.string());
+
+    try {
+        const replay before = read_log(dir);
+        std::uint64_t appended = 0;
+        {
+            wal log(dir, {.segment_size = 64 << 10, .sync = false});
+            if (before.records)
+                fuzz_check(log.next_lsn() == before.last_lsn + 1, "a reopened log continues after replay");
+            const std::vector<std::byte> payload(24, std::byte{0x5a});
+            appended = log.append(payload);
+        }
+        const replay after = read_log(dir);
+        fuzz_check(after.last_lsn == appended, "the appended record replays last");
+    } catch (const format_error&) {
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
+
+} // namespace yeni::test
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace yeni::test {
+
+/// How long each stress test keeps going: YENI_STRESS_MS, 250 ms by
+/// default so that the suite stays quick under ctest. Sanitizer runs want
+/// more (the check target passes whatever the environment holds).
+inline std::chrono::milliseconds stress_duration()
+{
+    const char* v = std::getenv("YENI_STRESS_MS");
+    return std::chrono::milliseconds(v ? std::strtoull(v, nullptr, 10) : 250);
+}
+
+/// Threads a stress test runs: one per CPU, but at least four, so that
+/// even a small machine interleaves them preemptively.
+inline unsigned stress_threads()
+{
+    return std::max(4u, std::thread::hardware_concurrency());
+}
+
+inline std::uint64_t now_ns() noexcept
+{
+    return std::uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/// Run `f(thread_index)` on `n` threads, released together from a spin
+/// barrier so that their first operations overlap, and join them. The
+/// first exception a thread throws is rethrown here.
+template <class F>
+void run_threads(unsigned n, F&& f)
+{
+    std::atomic<unsigned> ready{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    for (unsigned i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            ready.fetch_add(1);
+            while (ready.load() < n)
+                std::this_thread::yield();
+            try {
+                f(i);
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/// Repeat `round()` until the stress duration is up; returns the rounds run.
+template <class F>
+std::size_t for_duration(F&& round)
+{
+    const auto deadline = std::chrono::steady_clock::now() + stress_duration();
+    std::size_t rounds = 0;
+    do {
+        round();
+        ++rounds;
+    } while (std::chrono::steady_clock::now() < deadline);
+    return rounds;
+}
+
+/// Fresh directory under the system temp directory, removed with
+/// everything in it on destruction.
+class scratch_dir {
+public:
+    explicit scratch_dir(const std::string& name)
+        : path_(std::filesystem::temp_directory_path() /
+              ("yeni-test-" + name + "-" + std::to_string(now_ns())))
+    {
+        std::filesystem::create_directories(path_);
+    }
+    ~scratch_dir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    scratch_dir(const scratch_dir&) = delete;
+    scratch_dir& operator=(const scratch_dir&) = delete;
+
+    const std::filesystem::path& path() const noexcept { return path_; }
+    std::filesystem::path operator/(const std::string& name) const { return path_ / name; }
+
+private:
+    std::filesystem::path path_;
+};
+
+/// One completed operation of a recorded history: called at `call`,
+/// returned `result` at `ret` (now_ns() before and after).
+template <class Op, class Result>
+struct history_entry {
+    std::uint64_t call = 0;
+    std::uint64_t ret = 0;
+    Op op{};
+    Result result{};
+};
+
+/// Thread-safe collector of history entries.
+template <class Entry>
+class history {
+public:
+    void add(const Entry& e)
+    {
+        std::lock_guard lock(mutex_);
+        entries_.push_back(e);
+    }
+
+    std::vector<Entry> take()
+    {
+        std::lock_guard lock(mutex_);
+        return std::move(entries_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+};
+
+/// Whether `entries` is linearizable with respect to the sequential
+/// specification `Model`: is there a total order of the operations that
+/// respects real time (one that returned before another was called comes
+/// first) in which replaying them on `initial` yields every recorded
+/// result. Wing and Gong's search with Lowe's memoisation of (operations
+/// linearized, model state) pairs already found to be dead ends.
+///
+/// `Model` is a small value type with ==, a `std::size_t hash() const`,
+/// and `bool step(const Entry& e)` that applies e.op, returning false
+/// (state unspecified) if the specification could not produce e.result.
+/// Histories are limited to 64 operations; record them in short rounds.
+template <class Model, class Entry>
+bool linearizable(std::span<const Entry> entries, const Model& initial)
+{
+    if (entries.size() > 64)
+        throw std::invalid_argument("linearizable(): more than 64 operations");
+    std::vector<Entry> ops(entries.begin(), entries.end());
+    std::sort(ops.begin(), ops.end(), [](const Entry& a, const Entry& b) { return a.call < b.call; });
+    const std::uint64_t all = ops.size() == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << ops.size()) - 1;
+
+    struct config {
+        std::uint64_t done;
+        Model state;
+        bool operator==(const config&) const = default;
+    };
+    struct config_hash {
+        std::size_t operator()(const config& c) const noexcept
+        {
+            return std::hash<std::uint64_t>{}(c.done) * 31 ^ c.state.hash();
+        }
+    };
+    std::unordered_set<config, config_hash> dead;
+
+    const std::function<bool(std::uint64_t, const Model&)> search = [&](std::uint64_t done, const Model& state) {
+        if (done == all)
+            return true;
+        if (dead.count({done, state}))
+            return false;
+        // An operation can go next if no pending one returned before it
+        // was called.
+        std::uint64_t first_ret = ~std::uint64_t(0);
+        for (std::size_t i = 0; i < ops.size(); ++i)
+            if (!(done >> i & 1))
+                first_ret = std::min(first_ret, ops[i].ret);
+        for (std::size_t i = 0; i < ops.size() && ops[i].call <= first_ret; ++i) {
+            if (done >> i & 1)
+                continue;
+            Model next = state;
+            if (next.step(ops[i]) && search(done | std::uint64_t(1) << i, next))
+                return true;
+        }
+        dead.insert({done, state});
+        return false;
+    };
+    return search(0, initial);
+}
+
+} // namespace yeni::test
@@ -0,0 +1,133 @@
+#include "yeni/admission.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/record_store.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+using namespace std::chrono_literals;
+using clock_type = yeni::codel_monitor::clock;
+
+// Delays that dip under the target once per interval are a burst being
+// worked off; only a window whose every delay is over the target makes
+// the queue overloaded, and the verdict lapses without dequeues.
+TEST(admission, codel_flags_only_a_standing_queue)
+{
+    const auto t0 = clock_type::now();
+    yeni::codel_monitor m({.target = 5ms, .interval = 100ms}, t0);
+    EXPECT_FALSE(m.overloaded(t0));
+    EXPECT_EQ(m.tolerance(t0), 100ms);
+
+    // Two windows of a large backlog that drains to 1 ms at some point.
+    for (int ms = 0; ms <= 200; ms += 10)
+        m.observe(ms % 100 == 50 ? 1ms : 40ms, t0 + std::chrono::milliseconds(ms));
+    EXPECT_FALSE(m.overloaded(t0 + 200ms));
+    EXPECT_EQ(m.standing_delay(), 1ms);
+
+    // A window that never gets under 20 ms.
+    for (int ms = 210; ms <= 300; ms += 10)
+        m.observe(20ms + std::chrono::milliseconds(ms % 30), t0 + std::chrono::milliseconds(ms));
+    EXPECT_TRUE(m.overloaded(t0 + 300ms));
+    EXPECT_EQ(m.standing_delay(), 20ms);
+    EXPECT_EQ(m.tolerance(t0 + 300ms), 5ms);
+    EXPECT_TRUE(m.expired(6ms, t0 + 300ms));
+    EXPECT_FALSE(m.expired(6ms, t0 + 550ms));
+
+    // Caught up again.
+    for (int ms = 310; ms <= 400; ms += 10)
+        m.observe(2ms, t0 + std::chrono::milliseconds(ms));
+    EXPECT_FALSE(m.overloaded(t0 + 400ms));
+    EXPECT_EQ(m.standing_delay(), 2ms);
+}
+
+// Batches remember when the producer handed them over, so the consumer
+// side measures their time in the queue.
+TEST(admission, consumers_report_ingest_queue_delay)
+{
+    using batch = yeni::handoff_batch<const yeni::record*>;
+    constexpr std::size_t records = 2 * batch::capacity + 1;
+    yeni::record_store store;
+    yeni::ingest_queue queue(64);
+    yeni::ingest_producer producer(queue);
+    for (std::uint64_t k = 0; k < records; ++k)
+        producer.push(store.append(k, {}));
+    producer.flush();
+    std::this_thread::sleep_for(3ms);
+
+    // An interval of one tick closes a window on every observation.
+    yeni::codel_monitor m({.target = 1ms, .interval = 1ns}, clock_type::now() - 1s);
+    const auto histogram_before = yeni::metrics::collect()[yeni::metrics::histogram::queue_delay].count;
+    std::size_t seen = 0;
+    EXPECT_EQ(yeni::consume_batches(queue, [&](const yeni::record*) { ++seen; }, m, 0ns), records);
+    EXPECT_EQ(seen, records);
+    EXPECT_GE(m.standing_delay(), 3ms);
+    if (yeni::metrics::enabled) {
+        EXPECT_EQ(yeni::metrics::collect()[yeni::metrics::histogram::queue_delay].count, histogram_before + 3);
+    }
+}
+
+// Requests are shed on overload before their tenant is charged, and each
+// tenant runs out of its own budget only; both say when to come back.
+TEST(admission, rejects_over_budget_tenants_and_overload)
+{
+    const auto t0 = clock_type::now();
+    yeni::codel_monitor queue_delay({.target = 5ms, .interval = 100ms}, t0);
+    yeni::admission_controller ac({.rate = 1000, .burst = 10});
+    ac.watch(queue_delay);
+    ac.tenants().set_limits(7, {.rate = 100, .burst = 1});
+    const auto before = yeni::metrics::collect();
+
+    for (int i = 0; i < 10; ++i)
+        EXPECT_TRUE(ac.admit(1, 1, t0));
+    const yeni::admission limited = ac.admit(1, 1, t0);
+    EXPECT_EQ(limited.verdict, yeni::admission_verdict::rate_limited);
+    EXPECT_EQ(limited.retry_after, 1ms);
+    EXPECT_TRUE(ac.admit(1, 1, t0 + 1ms));
+    EXPECT_TRUE(ac.admit(2, 10, t0));
+    EXPECT_TRUE(ac.admit(7, 1, t0));
+    EXPECT_EQ(ac.admit(7, 1, t0).retry_after, 10ms);
+    EXPECT_EQ(ac.tenants().tenants(), 3u);
+
+    for (int ms = 0; ms <= 100; ms += 10)
+        queue_delay.observe(30ms, t0 + std::chrono::milliseconds(ms));
+    const yeni::admission shed = ac.admit(3, 1, t0 + 100ms);
+    EXPECT_EQ(shed.verdict, yeni::admission_verdict::overloaded);
+    EXPECT_EQ(shed.retry_after, 30ms);
+    // Tenant 3 was turned away before it got a bucket.
+    EXPECT_EQ(ac.tenants().tenants(), 3u);
+    // With no dequeues for an interval past the window the verdict lapses.
+    EXPECT_TRUE(ac.admit(3, 1, t0 + 300ms));
+
+    if (yeni::metrics::enabled) {
+        const auto after = yeni::metrics::collect();
+        using c = yeni::metrics::counter;
+        EXPECT_EQ(after[c::admission_rejected_rate], before[c::admission_rejected_rate] + 2);
+        EXPECT_EQ(after[c::admission_rejected_overload], before[c::admission_rejected_overload] + 1);
+        EXPECT_EQ(after[c::queue_delay_overloads], before[c::queue_delay_overloads] + 1);
+    }
+}
+
+// A request costing more than the tenant's burst gets through once the
+// bucket is full and leaves the tenant in debt; until it is paid off the
+// hint says when the bucket will be full again.
+TEST(admission, costs_over_the_burst_go_into_debt)
+{
+    const auto t0 = clock_type::now();
+    yeni::admission_controller ac;
+    ac.tenants().set_limits(1, {.rate = 10, .burst = 1});
+
+    EXPECT_TRUE(ac.admit(1, 5, t0));
+    const yeni::admission limited = ac.admit(1, 5, t0 + 100ms);
+    EXPECT_EQ(limited.verdict, yeni::admission_verdict::rate_limited);
+    EXPECT_EQ(limited.retry_after, 400ms);
+    EXPECT_EQ(ac.admit(1, 1, t0 + 300ms).retry_after, 200ms);
+    EXPECT_TRUE(ac.admit(1, 5, t0 + 500ms));
+    EXPECT_EQ(ac.admit(1, 5, t0 + 500ms).retry_after, 500ms);
+}
+
+} // namespace
@@ -0,0 +1,211 @@
+#include "stress.hpp"
+
+#include "yeni/aggregate.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/record_store.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using order = yeni::static_schema<yeni::field<"region", std::uint32_t>, yeni::field<"qty", std::uint64_t>,
+    yeni::field<"delta", std::int64_t>, yeni::field<"price", double>,
+    yeni::field<"sku", std::span<const std::byte>>>;
+
+yeni::schema order_schema()
+{
+    using t = yeni::segment_format::column_type;
+    return yeni::schema({{"region", t::u32}, {"qty", t::u64}, {"delta", t::i64}, {"price", t::f64},
+        {"sku", t::binary}});
+}
+
+std::vector<yeni::aggregate_spec> order_specs()
+{
+    using op = yeni::aggregate_op;
+    return {{op::count, ""}, {op::sum, "qty"}, {op::min, "delta"}, {op::max, "delta"}, {op::max, "price"},
+        {op::min, "qty"}};
+}
+
+std::string sku_of(std::uint64_t i)
+{
+    return "sku-" + std::to_string(i % 7);
+}
+
+std::vector<std::byte> make_order(std::uint64_t i)
+{
+    const std::string sku = sku_of(i);
+    return order::encode(std::uint32_t(yeni::mix64(i) % 5), i % 100, std::int64_t(i % 41) - 20,
+        double(i % 1000) / 8, std::as_bytes(std::span(sku.data(), sku.size())));
+}
+
+struct expected_group {
+    std::uint64_t count = 0;
+    std::uint64_t qty = 0;
+    std::int64_t min_delta = INT64_MAX;
+    std::int64_t max_delta = INT64_MIN;
+    double max_price = -1;
+    std::uint64_t min_qty = UINT64_MAX;
+
+    void add(std::uint64_t i)
+    {
+        ++count;
+        qty += i % 100;
+        min_delta = std::min(min_delta, std::int64_t(i % 41) - 20);
+        max_delta = std::max(max_delta, std::int64_t(i % 41) - 20);
+        max_price = std::max(max_price, double(i % 1000) / 8);
+        min_qty = std::min(min_qty, i % 100);
+    }
+};
+
+void expect_group(const std::vector<yeni::aggregate_value>& v, const expected_group& e)
+{
+    ASSERT_EQ(v.size(), 6u);
+    EXPECT_EQ(std::get<std::uint64_t>(v[0]), e.count);
+    EXPECT_EQ(std::get<std::uint64_t>(v[1]), e.qty);
+    EXPECT_EQ(std::get<std::int64_t>(v[2]), e.min_delta);
+    EXPECT_EQ(std::get<std::int64_t>(v[3]), e.max_delta);
+    EXPECT_EQ(std::get<double>(v[4]), e.max_price);
+    EXPECT_EQ(std::get<std::uint64_t>(v[5]), e.min_qty);
+}
+
+// Threads fold disjoint records into one view while a reader merges it;
+// counts only ever grow, and the end state is what a scan would give.
+TEST(aggregate, concurrent_appliers_merge_to_the_scanned_result)
+{
+    const yeni::schema s = order_schema();
+    yeni::aggregate_view view(s, "region", order_specs());
+    const unsigned threads = yeni::test::stress_threads();
+    constexpr std::uint64_t per_thread = 20000;
+
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        std::uint64_t last = 0;
+        while (!done.load()) {
+            std::uint64_t total = 0;
+            for (const auto& g : view.read())
+                total += std::get<std::uint64_t>(g.values[0]);
+            EXPECT_GE(total, last);
+            last = total;
+        }
+    });
+    yeni::test::run_threads(threads, [&](unsigned t) {
+        for (std::uint64_t i = t * per_thread; i < (t + 1) * per_thread; ++i)
+            view.apply(make_order(i));
+    });
+    done = true;
+    reader.join();
+
+    std::map<std::uint32_t, expected_group> expected;
+    for (std::uint64_t i = 0; i < threads * per_thread; ++i)
+        expected[std::uint32_t(yeni::mix64(i) % 5)].add(i);
+    const auto groups = view.read();
+    ASSERT_EQ(groups.size(), expected.size());
+    auto it = expected.begin();
+    for (const auto& g : groups) {
+        EXPECT_EQ(std::get<std::uint32_t>(g.key), it->first);
+        expect_group(g.values, it->second);
+        ++it;
+    }
+    const auto one = view.read(yeni::schema::value(std::uint32_t(3)));
+    ASSERT_TRUE(one);
+    expect_group(*one, expected[3]);
+    EXPECT_FALSE(view.read(yeni::schema::value(std::uint32_t(9))));
+    EXPECT_FALSE(view.read(yeni::schema::value(std::uint64_t(3))));
+
+    view.clear();
+    EXPECT_TRUE(view.read().empty());
+}
+
+// A registry drains the ingest queue into every view; binary keys are
+// looked up by their bytes.
+TEST(aggregate, registry_consumes_the_ingest_queue)
+{
+    const yeni::schema s = order_schema();
+    yeni::aggregate_registry views;
+    yeni::aggregate_view& by_sku = views.add("by_sku", s, "sku", order_specs());
+    EXPECT_THROW(views.add("by_sku", s, "region", order_specs()), std::invalid_argument);
+    EXPECT_THROW(views.add("bad", s, "price", order_specs()), std::invalid_argument);
+    EXPECT_THROW(views.add("bad", s, "region", {{yeni::aggregate_op::sum, "sku"}}), std::invalid_argument);
+    EXPECT_THROW(views.add("bad", s, "region", {{yeni::aggregate_op::count, "qty"}}), std::invalid_argument);
+    EXPECT_THROW(views.add("bad", s, "nope", order_specs()), std::invalid_argument);
+    EXPECT_EQ(views.find("bad"), nullptr);
+    views.add("by_region", s, "region", {{yeni::aggregate_op::count, ""}});
+
+    yeni::record_store store;
+    yeni::ingest_queue queue(64);
+    const unsigned producers = 3;
+    constexpr std::uint64_t per_producer = 5000;
+    std::thread consumer([&] {
+        while (views.consume(queue) || !queue.closed()) {
+        }
+    });
+    yeni::test::run_threads(producers, [&](unsigned t) {
+        yeni::ingest_producer producer(queue);
+        for (std::uint64_t i = t * per_producer; i < (t + 1) * per_producer; ++i)
+            producer.push(store.append(i, make_order(i)));
+    });
+    queue.close();
+    consumer.join();
+
+    std::map<std::string, expected_group> expected;
+    for (std::uint64_t i = 0; i < producers * per_producer; ++i)
+        expected[sku_of(i)].add(i);
+    const auto groups = by_sku.read();
+    ASSERT_EQ(groups.size(), expected.size());
+    auto it = expected.begin();
+    for (const auto& g : groups) {
+        const auto key = std::get<std::span<const std::byte>>(g.key);
+        EXPECT_EQ(std::string(reinterpret_cast<const char*>(key.data()), key.size()), it->first);
+        expect_group(g.values, it->second);
+        ++it;
+    }
+    const std::string sku = sku_of(4);
+    const auto one = by_sku.read(yeni::schema::value(std::as_bytes(std::span(sku.data(), sku.size()))));
+    ASSERT_TRUE(one);
+    expect_group(*one, expected[sku]);
+
+    std::uint64_t total = 0;
+    for (const auto& g : views.find("by_region")->read())
+        total += std::get<std::uint64_t>(g.values[0]);
+    EXPECT_EQ(total, producers * per_producer);
+    EXPECT_TRUE(views.remove("by_region"));
+    EXPECT_FALSE(views.remove("by_region"));
+    EXPECT_EQ(views.find("by_region"), nullptr);
+}
+
+// A thread applying to more views than it caches keeps folding into the
+// partial it has in each, so every view merges one partial.
+TEST(aggregate, more_views_than_cached_reuse_their_partial)
+{
+    const yeni::schema s = order_schema();
+    yeni::aggregate_registry views;
+    constexpr std::size_t view_count = 12;
+    for (std::size_t v = 0; v < view_count; ++v)
+        views.add(std::to_string(v), s, "region", {{yeni::aggregate_op::count, ""}});
+    yeni::record_store store;
+    constexpr std::uint64_t records = 1000;
+    for (std::uint64_t i = 0; i < records; ++i) {
+        const yeni::record* r = store.append(i, make_order(i));
+        views.apply(std::span(&r, 1));
+    }
+    for (std::size_t v = 0; v < view_count; ++v) {
+        const yeni::aggregate_view* view = views.find(std::to_string(v));
+        ASSERT_NE(view, nullptr);
+        EXPECT_EQ(view->partial_count(), 1u);
+        std::uint64_t total = 0;
+        for (const auto& g : view->read())
+            total += std::get<std::uint64_t>(g.values[0]);
+        EXPECT_EQ(total, records);
+    }
+}
+
+} // namespace
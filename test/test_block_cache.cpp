@@ -0,0 +1,131 @@
+#include "stress.hpp"
+
+#include "yeni/block_cache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::byte fill_of(std::uint64_t key)
+{
+    return std::byte(key * 131 % 251);
+}
+
+bool holds(const yeni::block_cache::handle& h, std::uint64_t key, std::size_t size)
+{
+    if (h.data().size() != size)
+        return false;
+    for (const std::byte b : h.data())
+        if (b != fill_of(key))
+            return false;
+    return true;
+}
+
+std::size_t size_of(std::uint64_t key)
+{
+    return 512 + key % 3 * 256;
+}
+
+// Threads read a key space five times the capacity, holding some blocks
+// pinned for a while and failing one load in fifty. Every handle must
+// hold its own block's bytes, and the budget must hold at every step.
+TEST(block_cache, blocks_stay_intact_under_eviction)
+{
+    yeni::block_cache cache({.capacity_bytes = 64 * 1024, .shards = 2, .block_bytes = 1024});
+    constexpr std::uint64_t keys = 320;
+    std::atomic<std::uint64_t> loads{0}, failed{0};
+    const auto deadline = std::chrono::steady_clock::now() + yeni::test::stress_duration();
+    yeni::test::run_threads(yeni::test::stress_threads(), [&](unsigned t) {
+        std::mt19937_64 rng(t);
+        std::vector<std::pair<std::uint64_t, yeni::block_cache::handle>> held;
+        while (std::chrono::steady_clock::now() < deadline) {
+            const std::uint64_t k = rng() % keys;
+            try {
+                yeni::block_cache::handle h = cache.get({7, k}, size_of(k), [&](std::span<std::byte> out) {
+                    loads.fetch_add(1, std::memory_order_relaxed);
+                    if (rng() % 50 == 0) {
+                        failed.fetch_add(1, std::memory_order_relaxed);
+                        throw std::runtime_error("load failed");
+                    }
+                    std::memset(out.data(), int(fill_of(k)), out.size());
+                });
+                ASSERT_TRUE(holds(h, k, size_of(k))) << "key " << k;
+                if (rng() % 8 == 0) {
+                    held.emplace_back(k, std::move(h));
+                    if (held.size() > 4)
+                        held.erase(held.begin());
+                }
+            } catch (const std::runtime_error&) {
+            }
+            ASSERT_LE(cache.usage(), cache.capacity());
+            const std::uint64_t other = rng() % keys;
+            if (const auto h = cache.lookup({7, other})) {
+                ASSERT_TRUE(holds(h, other, size_of(other))) << "key " << other;
+            }
+        }
+        for (const auto& [k, h] : held)
+            ASSERT_TRUE(holds(h, k, size_of(k))) << "key " << k;
+    });
+    EXPECT_GT(loads.load(), failed.load());
+}
+
+// Threads missing on the same key together share one load; a failed load
+// leaves them to retry.
+TEST(block_cache, concurrent_misses_load_once)
+{
+    yeni::block_cache cache({.capacity_bytes = 16 << 20, .shards = 1, .block_bytes = 1024});
+    const unsigned threads = yeni::test::stress_threads();
+    std::uint64_t key = 0;
+    yeni::test::for_duration([&] {
+        ++key;
+        std::atomic<int> loads{0};
+        const bool fail_first = key % 4 == 0;
+        yeni::test::run_threads(threads, [&](unsigned) {
+            for (;;) {
+                try {
+                    const auto h = cache.get({1, key}, 1024, [&](std::span<std::byte> out) {
+                        const int n = loads.fetch_add(1) + 1;
+                        std::this_thread::yield();
+                        if (fail_first && n == 1)
+                            throw std::runtime_error("load failed");
+                        std::memset(out.data(), int(fill_of(key)), out.size());
+                    });
+                    ASSERT_TRUE(holds(h, key, 1024));
+                    return;
+                } catch (const std::runtime_error&) {
+                }
+            }
+        });
+        ASSERT_EQ(loads.load(), fail_first ? 2 : 1) << "key " << key;
+    });
+}
+
+// A pinned block is never evicted, however much else goes through.
+TEST(block_cache, pinned_blocks_survive)
+{
+    yeni::block_cache cache({.capacity_bytes = 32 * 1024, .shards = 1, .block_bytes = 1024});
+    const auto fill = [](std::uint64_t k) {
+        return [k](std::span<std::byte> out) { std::memset(out.data(), int(fill_of(k)), out.size()); };
+    };
+    const yeni::block_cache::handle pinned = cache.get({9, 0}, 1024, fill(0));
+    ASSERT_TRUE(pinned.cached());
+    for (std::uint64_t k = 1; k < 1000; ++k)
+        cache.get({9, k}, 1024, fill(k));
+    EXPECT_TRUE(holds(pinned, 0, 1024));
+    const auto again = cache.lookup({9, 0});
+    ASSERT_TRUE(again);
+    EXPECT_EQ(again.data().data(), pinned.data().data());
+}
+
+} // namespace
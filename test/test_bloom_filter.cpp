@@ -0,0 +1,74 @@
+#include "yeni/bloom_filter.hpp"
+#include "yeni/error.hpp"
+#include "yeni/hash.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Every key built in passes, on both probes, and keys never added pass
+// at about the documented rate, fewer with more bits per key.
+TEST(bloom_filter, no_false_negatives_and_bounded_false_positives)
+{
+    constexpr std::uint64_t keys = 100000, probes = 1000000;
+    std::vector<std::uint64_t> in(keys);
+    for (std::uint64_t i = 0; i < keys; ++i)
+        in[i] = yeni::mix64(i) | 1; // odd: probes below are even
+    double previous = 1.0;
+    for (const double bits_per_key : {10.0, 16.0}) {
+        const std::vector<std::byte> data = yeni::bloom_filter::build(in, bits_per_key);
+        const yeni::bloom_filter filter(data);
+        ASSERT_FALSE(filter.empty());
+        EXPECT_EQ(filter.size_bytes(), data.size());
+        for (const std::uint64_t k : in) {
+            ASSERT_TRUE(filter.may_contain(k)) << k;
+            ASSERT_TRUE(filter.may_contain_portable(k)) << k;
+        }
+        std::uint64_t passed = 0;
+        for (std::uint64_t i = 0; i < probes; ++i) {
+            const std::uint64_t k = yeni::mix64(keys + i) & ~std::uint64_t(1);
+            const bool simd = filter.may_contain(k);
+            ASSERT_EQ(simd, filter.may_contain_portable(k)) << k;
+            passed += simd;
+        }
+        const double rate = double(passed) / double(probes);
+        if (bits_per_key == 10.0) {
+            EXPECT_LT(rate, 0.02);
+        }
+        EXPECT_LT(rate, previous);
+        previous = rate;
+    }
+}
+
+// Anything but build() output is rejected. A default filter passes every
+// key, one built over no keys none.
+TEST(bloom_filter, rejects_malformed_data)
+{
+    const std::vector<std::uint64_t> keys = {1, 2, 3};
+    std::vector<std::byte> data = yeni::bloom_filter::build(keys);
+    EXPECT_THROW(yeni::bloom_filter(std::span(data).first(yeni::bloom_filter::header_bytes - 1)), yeni::format_error);
+    EXPECT_THROW(yeni::bloom_filter(std::span(data).first(data.size() - 4)), yeni::format_error);
+    std::vector<std::byte> longer = data;
+    longer.resize(data.size() + yeni::bloom_filter::block_bytes);
+    EXPECT_THROW(yeni::bloom_filter{longer}, yeni::format_error);
+    std::vector<std::byte> bad_magic = data;
+    bad_magic[0] ^= std::byte{1};
+    EXPECT_THROW(yeni::bloom_filter{bad_magic}, yeni::format_error);
+
+    const yeni::bloom_filter none;
+    EXPECT_TRUE(none.empty());
+    EXPECT_EQ(none.size_bytes(), 0u);
+    EXPECT_TRUE(none.may_contain(42));
+
+    const std::vector<std::byte> empty = yeni::bloom_filter::build({});
+    const yeni::bloom_filter over_nothing(empty);
+    for (std::uint64_t k : keys) {
+        EXPECT_FALSE(over_nothing.may_contain(k));
+        EXPECT_FALSE(over_nothing.may_contain_portable(k));
+    }
+}
+
+} // namespace
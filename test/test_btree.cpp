@@ -0,0 +1,226 @@
+#include "stress.hpp"
+
+#include "yeni/btree.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using yeni::test::history_entry;
+
+std::span<const std::byte> as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+std::string as_string(std::span<const std::byte> b)
+{
+    return {reinterpret_cast<const char*>(b.data()), b.size()};
+}
+
+// Keys sharing a long prefix, as the node format compresses them.
+std::string key_of(std::uint64_t i)
+{
+    return "customer/region-eu-west/" + std::to_string(i);
+}
+
+const std::string last_key(yeni::btree_index::max_key_size, '\xff');
+
+TEST(btree, matches_a_map)
+{
+    std::mt19937_64 rng(5);
+    yeni::btree_index tree;
+    std::map<std::string, std::uint64_t> model;
+    for (std::uint64_t i = 0; i < 100000; ++i) {
+        const std::string k = rng() % 4 ? key_of(rng() % 30000) : std::string(rng() % 400, char('a' + rng() % 3));
+        switch (rng() % 10) {
+        case 0:
+        case 1:
+            ASSERT_EQ(tree.erase(as_bytes(k)), model.erase(k) == 1);
+            break;
+        case 2: {
+            const auto it = model.find(k);
+            const std::optional<std::uint64_t> v = tree.find(as_bytes(k));
+            ASSERT_EQ(v.has_value(), it != model.end());
+            if (v) {
+                ASSERT_EQ(*v, it->second);
+            }
+            break;
+        }
+        default:
+            ASSERT_EQ(tree.insert(as_bytes(k), i), model.emplace(k, i).second);
+        }
+    }
+    ASSERT_EQ(tree.size(), model.size());
+
+    auto it = model.begin();
+    tree.scan(as_bytes(""), as_bytes(last_key), [&](std::span<const std::byte> k, std::uint64_t v) {
+        ASSERT_NE(it, model.end());
+        EXPECT_EQ(as_string(k), it->first);
+        EXPECT_EQ(v, it->second);
+        ++it;
+    });
+    EXPECT_EQ(it, model.end());
+
+    const std::vector<std::byte> blob = tree.serialize();
+    const yeni::btree_view view(blob);
+    ASSERT_EQ(view.size(), model.size());
+    for (const auto& [k, v] : model)
+        ASSERT_EQ(view.find(as_bytes(k)), v) << k;
+    const yeni::btree_index reloaded(view);
+    ASSERT_EQ(reloaded.size(), model.size());
+    for (const auto& [k, v] : model)
+        ASSERT_EQ(reloaded.find(as_bytes(k)), v) << k;
+}
+
+TEST(btree, rejects_oversized_keys)
+{
+    yeni::btree_index tree;
+    EXPECT_THROW(tree.insert(as_bytes(std::string(yeni::btree_index::max_key_size + 1, 'k')), 1),
+        std::invalid_argument);
+    EXPECT_TRUE(tree.insert(as_bytes(std::string(yeni::btree_index::max_key_size, 'k')), 1));
+}
+
+enum class verb { insert, erase, find };
+
+struct set_op {
+    verb kind = verb::find;
+    std::uint64_t value = 0;
+};
+
+struct set_result {
+    bool ok = false;
+    std::uint64_t value = 0;
+};
+
+using set_entry = history_entry<set_op, set_result>;
+
+// One key of the tree: absent, or present with a value.
+struct key_model {
+    std::optional<std::uint64_t> value;
+
+    bool operator==(const key_model&) const = default;
+    std::size_t hash() const noexcept { return value ? std::size_t(*value) + 1 : 0; }
+
+    bool step(const set_entry& e)
+    {
+        switch (e.op.kind) {
+        case verb::insert:
+            if (value)
+                return !e.result.ok;
+            value = e.op.value;
+            return e.result.ok;
+        case verb::erase:
+            if (!value)
+                return !e.result.ok;
+            value.reset();
+            return e.result.ok;
+        default:
+            return e.result.ok == value.has_value() && (!value || e.result.value == *value);
+        }
+    }
+};
+
+// Inserts, erases and finds of a few keys in a tree big enough to split
+// under them, each key's history checked on its own.
+TEST(btree, histories_are_linearizable)
+{
+    constexpr std::uint64_t keys = 3;
+    constexpr int ops_per_thread = 8;
+    std::size_t checked = 0;
+    yeni::test::for_duration([&] {
+        yeni::btree_index tree;
+        // Fillers sort between the contended keys' neighbours, so that
+        // their leaf keeps splitting while the threads run.
+        for (std::uint64_t i = 0; i < 2000; i += 2)
+            tree.insert(as_bytes(key_of(i)), i);
+        yeni::test::history<set_entry> h[keys];
+        std::atomic<std::uint64_t> filler{0};
+        yeni::test::run_threads(4, [&](unsigned t) {
+            for (int i = 0; i < ops_per_thread; ++i) {
+                const std::uint64_t k = (t + std::uint64_t(i)) % keys;
+                const std::string key = key_of(1001 + 2 * k);
+                set_entry e;
+                e.op = {verb((t + unsigned(i) / 2) % 3), std::uint64_t(t + 1) << 32 | unsigned(i)};
+                e.call = yeni::test::now_ns();
+                switch (e.op.kind) {
+                case verb::insert:
+                    e.result.ok = tree.insert(as_bytes(key), e.op.value);
+                    break;
+                case verb::erase:
+                    e.result.ok = tree.erase(as_bytes(key));
+                    break;
+                default:
+                    if (const auto v = tree.find(as_bytes(key))) {
+                        e.result.ok = true;
+                        e.result.value = *v;
+                    }
+                }
+                e.ret = yeni::test::now_ns();
+                h[k].add(e);
+                for (int j = 0; j < 50; ++j) {
+                    const std::uint64_t f = filler.fetch_add(1);
+                    tree.insert(as_bytes(key_of(1000000 + f)), f);
+                }
+            }
+        });
+        for (std::uint64_t k = 0; k < keys; ++k) {
+            const std::vector<set_entry> entries = h[k].take();
+            ASSERT_TRUE(yeni::test::linearizable(std::span<const set_entry>(entries), key_model{})) << "key " << k;
+        }
+        ++checked;
+    });
+    RecordProperty("rounds", int(checked));
+}
+
+// Writers insert disjoint keys while readers scan: every scan is ascending
+// and sees each key that was in before it began.
+TEST(btree, scans_stay_ordered_under_inserts)
+{
+    constexpr std::uint64_t preloaded = 5000;
+    yeni::btree_index tree;
+    for (std::uint64_t i = 0; i < preloaded; ++i)
+        tree.insert(as_bytes(key_of(i * 1000)), i * 1000);
+    const unsigned threads = yeni::test::stress_threads();
+    const unsigned writers = threads / 2;
+    std::atomic<unsigned> writing{writers};
+    yeni::test::run_threads(threads, [&](unsigned t) {
+        if (t < writers) {
+            const auto deadline = std::chrono::steady_clock::now() + yeni::test::stress_duration();
+            for (std::uint64_t i = 0; std::chrono::steady_clock::now() < deadline; ++i) {
+                const std::uint64_t v = i % preloaded * 1000 + 1 + t + i / preloaded * writers;
+                if (v % 1000 != 0)
+                    tree.insert(as_bytes(key_of(v)), v);
+            }
+            writing.fetch_sub(1);
+            return;
+        }
+        while (writing.load() > 0) {
+            std::string prev;
+            std::uint64_t seen = 0;
+            tree.scan(as_bytes(""), as_bytes(last_key), [&](std::span<const std::byte> k, std::uint64_t v) {
+                std::string s = as_string(k);
+                ASSERT_LT(prev, s);
+                ASSERT_EQ(s, key_of(v));
+                seen += v % 1000 == 0;
+                prev = std::move(s);
+            });
+            ASSERT_EQ(seen, preloaded);
+        }
+    });
+    for (std::uint64_t i = 0; i < preloaded; ++i)
+        ASSERT_EQ(tree.find(as_bytes(key_of(i * 1000))), i * 1000);
+}
+
+} // namespace
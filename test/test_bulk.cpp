@@ -0,0 +1,318 @@
+#include "stress.hpp"
+
+#include "yeni/bulk.hpp"
+#include "yeni/error.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/segment.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+using bytes = std::span<const std::byte>;
+using column_type = yeni::segment_format::column_type;
+
+bytes as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+std::string as_string(bytes b)
+{
+    return {reinterpret_cast<const char*>(b.data()), b.size()};
+}
+
+void write_file(const std::filesystem::path& path, const std::string& text)
+{
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+std::string read_file(const std::filesystem::path& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+struct row {
+    std::uint64_t id = 0;
+    std::int64_t n = 0;
+    double x = 0;
+    std::uint32_t q = 0;
+    std::string name;
+
+    bool operator==(const row&) const = default;
+};
+
+std::ostream& operator<<(std::ostream& os, const row& r)
+{
+    return os << "{" << r.id << ", " << r.n << ", " << r.x << ", " << r.q << ", \"" << r.name << "\"}";
+}
+
+const yeni::schema rows_schema(
+    {{"id", column_type::u64}, {"n", column_type::i64}, {"x", column_type::f64}, {"q", column_type::u32},
+        {"name", column_type::binary}});
+
+std::vector<row> import_rows(const std::filesystem::path& path, const yeni::bulk_options& o)
+{
+    const yeni::schema& s = rows_schema;
+    std::vector<row> out;
+    yeni::import_text(
+        path, s,
+        [&](std::span<const bytes> records) {
+            for (const bytes r : records) {
+                EXPECT_TRUE(s.validate(r));
+                out.push_back({std::get<std::uint64_t>(s.get(r, 0)), std::get<std::int64_t>(s.get(r, 1)),
+                    std::get<double>(s.get(r, 2)), std::get<std::uint32_t>(s.get(r, 3)),
+                    as_string(std::get<bytes>(s.get(r, 4)))});
+            }
+        },
+        o);
+    return out;
+}
+
+TEST(bulk, csv_quoting_headers_and_delimiters)
+{
+    const yeni::test::scratch_dir dir("bulk");
+    write_file(dir / "a.csv",
+        "name,q,junk,x,n,id\r\n\"he said \"\"hi\"\"\",7,zz,2.5,-3,1\r\n\n\"multi\nline, ok\",8,,1e3,4,2\n"
+        "plain,9,\"q,\",0,0,3");
+    yeni::bulk_options o;
+    o.threads = 2;
+    o.chunk_bytes = 16;
+    EXPECT_EQ(import_rows(dir / "a.csv", o),
+        (std::vector<row>{{1, -3, 2.5, 7, "he said \"hi\""}, {2, 4, 1000, 8, "multi\nline, ok"}, {3, 0, 0, 9, "plain"}}));
+
+    write_file(dir / "b.csv", "5;-1;0.5;2;x\n");
+    o.header = false;
+    o.delimiter = ';';
+    EXPECT_EQ(import_rows(dir / "b.csv", o), (std::vector<row>{{5, -1, 0.5, 2, "x"}}));
+
+    for (const char* empty : {"", "id,n,x,q,name\n", "id,n,x,q,name"}) {
+        write_file(dir / "e.csv", empty);
+        EXPECT_TRUE(import_rows(dir / "e.csv", {}).empty()) << empty;
+    }
+}
+
+TEST(bulk, ndjson_escapes_nesting_and_missing_keys)
+{
+    const yeni::test::scratch_dir dir("bulk");
+    write_file(dir / "a.json",
+        "{\"id\": 1, \"name\": \"a\\\"b\\\\\\u00e9\\ud83d\\ude00\\n\", \"extra\": {\"k\": [1, \"}\"]}, \"x\": -0.25}\r\n"
+        "\n  {}\n{\"q\":4,\"n\":-9,\"name\":{\"raw\":true},\"id\":null}\n{\"name\":12.5,\"q\":true}");
+    yeni::bulk_options o;
+    o.format = yeni::text_format::ndjson;
+    o.chunk_bytes = 8;
+    o.threads = 2;
+    EXPECT_EQ(import_rows(dir / "a.json", o),
+        (std::vector<row>{{1, 0, -0.25, 0, "a\"b\\\xc3\xa9\xf0\x9f\x98\x80\n"}, {0, 0, 0, 0, ""},
+            {0, -9, 0, 4, "{\"raw\":true}"}, {0, 0, 0, 1, "12.5"}}));
+}
+
+TEST(bulk, malformed_input_is_rejected)
+{
+    const yeni::test::scratch_dir dir("bulk");
+    yeni::bulk_options csv;
+    csv.threads = 3;
+    yeni::bulk_options json;
+    json.format = yeni::text_format::ndjson;
+    const std::pair<const char*, const yeni::bulk_options*> cases[] = {
+        {"id,n,x,q\n1,2,3,4\n", &csv},                     // missing column
+        {"id,n,x,q,name\n1,2,3,4,a\n1,2,3,4\n", &csv},     // short row
+        {"id,n,x,q,name\n1,2,3,4,a,b\n", &csv},            // long row
+        {"id,n,x,q,name\n1,-2,3,x4,a\n", &csv},            // bad number
+        {"id,n,x,q,name\n-1,2,3,4,a\n", &csv},             // negative u64
+        {"id,n,x,q,name\n1,2,3,4,\"abc\n", &csv},          // unterminated quote
+        {"id,n,x,q,name\n1,2,3,4,\"ab\"c\"\n", &csv},      // stray quote
+        {"{\"id\":1}\n{\"id\":\"x\"}\n", &json},           // string for a number
+        {"{\"id\":1,}\n", &json},                          // trailing comma
+        {"{\"id\":1} x\n", &json},                         // trailing text
+        {"{\"name\":\"abc}\n", &json},                     // unterminated string
+        {"[1]\n", &json},                                  // not an object
+        {"{\"name\":\"a\\qb\"}\n", &json},                 // bad escape
+    };
+    for (const auto& [text, o] : cases) {
+        write_file(dir / "e.txt", text);
+        EXPECT_THROW(import_rows(dir / "e.txt", *o), yeni::format_error) << text;
+    }
+    EXPECT_THROW(import_rows(dir / "missing.csv", csv), std::system_error);
+
+    // The error names the offset of the bad record, far from the start.
+    std::string text = "id,n,x,q,name\n";
+    for (int i = 0; i < 50000; ++i)
+        text += "1,2,3,4,abc\n";
+    const std::size_t bad = text.size();
+    text += "1,2,3,4\n";
+    for (int i = 0; i < 50000; ++i)
+        text += "1,2,3,4,abc\n";
+    write_file(dir / "big.csv", text);
+    csv.chunk_bytes = 1000;
+    try {
+        import_rows(dir / "big.csv", csv);
+        ADD_FAILURE() << "no error";
+    } catch (const yeni::format_error& e) {
+        EXPECT_NE(std::string(e.what()).find("byte " + std::to_string(bad) + ":"), std::string::npos) << e.what();
+    }
+}
+
+std::string random_name(std::mt19937_64& rng)
+{
+    static const char alphabet[] = "ab,\"\n\r\\/ {}[]:\t\x01\xc3\xa9xyz";
+    if (rng() % 10 == 0)
+        return std::string(rng() % 5000, 'L');
+    std::string s(rng() % 30, 'a');
+    for (char& c : s)
+        c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    return s;
+}
+
+class bulk_round_trip : public testing::TestWithParam<yeni::text_format> {
+};
+
+// Export then import random rows through both parsers, with random chunk
+// sizes and pipeline shapes.
+TEST_P(bulk_round_trip, rows_come_back_unchanged)
+{
+    const yeni::test::scratch_dir dir("bulk");
+    const yeni::schema& s = rows_schema;
+    for (int seed = 0; seed < 3; ++seed) {
+        std::mt19937_64 rng(seed);
+        std::vector<row> want;
+        std::vector<std::vector<std::byte>> records;
+        for (int i = 0; i < 5000; ++i) {
+            const double x = rng() % 3 == 0 ? double(std::int64_t(rng())) / 7 : double(rng() % 100);
+            want.push_back({rng(), std::int64_t(rng()), x, std::uint32_t(rng()), random_name(rng)});
+            const row& r = want.back();
+            records.push_back(s.encode(std::vector<yeni::schema::value>{r.id, r.n, r.x, r.q, as_bytes(r.name)}));
+        }
+        yeni::bulk_options o;
+        o.format = GetParam();
+        o.chunk_bytes = 1 + rng() % 20000;
+        o.threads = 1 + rng() % 4;
+        o.queue_depth = 1 + rng() % 3;
+        const yeni::bulk_stats st = yeni::export_text(
+            dir / "rt.txt", s,
+            [&](const yeni::bulk_emit& emit) {
+                for (const auto& r : records)
+                    emit(r);
+            },
+            o);
+        EXPECT_EQ(st.rows, want.size());
+        EXPECT_EQ(st.bytes, read_file(dir / "rt.txt").size());
+        const yeni::simd_level was = yeni::active_simd_level();
+        for (const yeni::simd_level level : {yeni::simd_level::scalar, was}) {
+            yeni::set_simd_level(level);
+            o.chunk_bytes = 1 + rng() % 20000;
+            const std::vector<row> got = import_rows(dir / "rt.txt", o);
+            yeni::set_simd_level(was);
+            ASSERT_EQ(got.size(), want.size());
+            for (std::size_t i = 0; i < want.size(); ++i)
+                ASSERT_EQ(got[i], want[i]) << "seed " << seed << " row " << i;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(bulk, bulk_round_trip, testing::Values(yeni::text_format::csv, yeni::text_format::ndjson),
+    [](const testing::TestParamInfo<yeni::text_format>& info) {
+        return info.param == yeni::text_format::csv ? "csv" : "ndjson";
+    });
+
+TEST(bulk, segments_and_record_stores)
+{
+    const yeni::test::scratch_dir dir("bulk");
+    const yeni::schema& s = rows_schema;
+    std::string text = "id,n,x,q,name\n";
+    for (int i = 0; i < 2500; ++i)
+        text += std::to_string(i) + "," + std::to_string(-i) + "," + std::to_string(i / 4.0) + ",3,name" +
+            std::to_string(i) + "\n";
+    write_file(dir / "s.csv", text);
+    yeni::bulk_options o;
+    o.chunk_bytes = 1000;
+
+    yeni::segment_sink sink(dir / "seg", s, 1000);
+    const yeni::bulk_stats st = yeni::import_text(dir / "s.csv", s, std::ref(sink), o);
+    sink.finish();
+    EXPECT_EQ(st.rows, 2500u);
+    EXPECT_EQ(st.bytes, text.size());
+    ASSERT_EQ(sink.files().size(), 3u);
+    const yeni::segment seg = yeni::segment::open(sink.files()[2]);
+    ASSERT_EQ(seg.rows(), 500u);
+    EXPECT_EQ(seg.column<std::uint64_t>("id")[0], 2000u);
+    EXPECT_EQ(as_string(seg.binary("name")[1]), "name2001");
+    ASSERT_EQ(yeni::segment_schema(seg).size(), 5u);
+
+    yeni::export_text(dir / "seg.csv", seg, o);
+    const std::string csv = read_file(dir / "seg.csv");
+    EXPECT_EQ(csv.substr(0, 14), "id,n,x,q,name\n");
+    EXPECT_NE(csv.find("2001,-2001,500.25,3,name2001\n"), std::string::npos);
+    yeni::bulk_options json;
+    json.format = yeni::text_format::ndjson;
+    yeni::export_text(dir / "seg.json", seg, json);
+    const std::string js = read_file(dir / "seg.json");
+    EXPECT_EQ(js.substr(0, js.find('\n')), "{\"id\":2000,\"n\":-2000,\"x\":500,\"q\":3,\"name\":\"name2000\"}");
+
+    yeni::record_store store;
+    yeni::import_text(dir / "s.csv", s, store, "id", o);
+    EXPECT_EQ(store.size(), 2500u);
+    const yeni::record* r = store.find(77);
+    ASSERT_TRUE(r);
+    EXPECT_EQ(as_string(std::get<bytes>(s.get(r->value(), 4))), "name77");
+    EXPECT_THROW(yeni::import_text(dir / "s.csv", s, store, "name", o), std::invalid_argument);
+
+    const auto nan = s.encode(std::vector<yeni::schema::value>{
+        std::uint64_t(1), std::int64_t(1), std::nan(""), std::uint32_t(1), as_bytes("")});
+    yeni::export_text(dir / "nan.json", s, [&](const yeni::bulk_emit& emit) { emit(nan); }, json);
+    EXPECT_EQ(read_file(dir / "nan.json"), "{\"id\":1,\"n\":1,\"x\":null,\"q\":1,\"name\":\"\"}\n");
+}
+
+// A failing sink or source stops the pipeline and is rethrown; a failed
+// export leaves no file behind.
+TEST(bulk, failures_stop_the_pipeline)
+{
+    const yeni::test::scratch_dir dir("bulk");
+    const yeni::schema& s = rows_schema;
+    std::string text = "id,n,x,q,name\n";
+    for (int i = 0; i < 20000; ++i)
+        text += "1,2,3,4,abc\n";
+    write_file(dir / "s.csv", text);
+    yeni::bulk_options o;
+    o.chunk_bytes = 1000;
+    o.threads = 3;
+    int calls = 0;
+    EXPECT_THROW(yeni::import_text(
+                     dir / "s.csv", s,
+                     [&](std::span<const bytes>) {
+                         if (++calls == 2)
+                             throw std::runtime_error("sink failed");
+                     },
+                     o),
+        std::runtime_error);
+
+    const auto rec = s.encode(std::vector<yeni::schema::value>{
+        std::uint64_t(1), std::int64_t(1), 1.0, std::uint32_t(1), as_bytes("")});
+    EXPECT_THROW(yeni::export_text(
+                     dir / "f.csv", s,
+                     [&](const yeni::bulk_emit& emit) {
+                         for (int i = 0; i < 100000; ++i)
+                             emit(rec);
+                         throw std::runtime_error("source failed");
+                     },
+                     o),
+        std::runtime_error);
+    EXPECT_FALSE(std::filesystem::exists(dir / "f.csv"));
+    EXPECT_FALSE(std::filesystem::exists(dir / "f.csv.tmp"));
+}
+
+} // namespace
@@ -0,0 +1,175 @@
+#include "stress.hpp"
+
+#include "yeni/codec.hpp"
+#include "yeni/error.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/segment.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Tenant-prefixed URLs: long shared prefixes, runs of repeats, and a few
+// rows that are prefixes of their neighbours.
+std::vector<std::string> redundant_strings(std::size_t n, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> out;
+    out.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::string s = "https://tenant-" + std::to_string(rng() % 7) + ".example.com/";
+        switch (rng() % 5) {
+        case 0:
+            break;
+        case 1:
+            s += "api/v1";
+            break;
+        default:
+            s += "items/" + std::to_string(rng() % 50) + "/" + std::string(rng() % 4, 'x');
+            break;
+        }
+        if (!out.empty() && rng() % 4 == 0)
+            s = out.back();
+        out.push_back(std::move(s));
+    }
+    if (!out.empty())
+        out[n / 2].clear();
+    return out;
+}
+
+std::span<const std::byte> bytes_of(const std::string& s)
+{
+    return std::as_bytes(std::span(s.data(), s.size()));
+}
+
+void write_strings(const std::filesystem::path& path, const std::vector<std::string>& rows, yeni::column_encoding e)
+{
+    yeni::codec_options codec;
+    codec.binary = e;
+    yeni::segment_writer w(path, nullptr, codec);
+    w.add_binary_column("s", rows.size(), [&](std::size_t i) { return bytes_of(rows[i]); });
+    w.finish();
+}
+
+bool compares(yeni::compare_op op, std::string_view a, std::string_view b)
+{
+    switch (op) {
+    case yeni::compare_op::eq:
+        return a == b;
+    case yeni::compare_op::ne:
+        return a != b;
+    case yeni::compare_op::lt:
+        return a < b;
+    case yeni::compare_op::le:
+        return a <= b;
+    case yeni::compare_op::gt:
+        return a > b;
+    default:
+        return a >= b;
+    }
+}
+
+TEST(codec, front_coded_columns_round_trip)
+{
+    const yeni::test::scratch_dir dir("codec");
+    for (const std::size_t n : {std::size_t(0), std::size_t(1), std::size_t(16), std::size_t(17), std::size_t(5000)}) {
+        const auto rows = redundant_strings(n, n);
+        const auto path = dir / std::to_string(n);
+        write_strings(path, rows, yeni::column_encoding::front_coded);
+        const auto s = yeni::segment::open(path);
+        const auto all = s.binary("s");
+        ASSERT_EQ(all.size(), n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto want = bytes_of(rows[i]);
+            ASSERT_TRUE(std::equal(all[i].begin(), all[i].end(), want.begin(), want.end())) << i;
+        }
+        // Too few rows to save anything are written plain.
+        if (s.encoding("s") != yeni::column_encoding::front_coded) {
+            EXPECT_LE(n, 16u);
+            continue;
+        }
+        const auto fc = s.front_coded("s");
+        ASSERT_EQ(fc.size(), n);
+        std::size_t plain = 0;
+        for (const auto& r : rows)
+            plain += r.size();
+        EXPECT_EQ(fc.plain_bytes(), plain);
+        if (n >= 5000) {
+            EXPECT_LT(fc.size_bytes(), plain * 6 / 10);
+        }
+        std::vector<std::byte> buf;
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto want = bytes_of(rows[i]);
+            const auto got = fc.row(i, buf);
+            ASSERT_TRUE(std::equal(got.begin(), got.end(), want.begin(), want.end())) << i;
+        }
+    }
+}
+
+// The string predicates give the same rows on a front-coded column as on a
+// plain one and as std::string_view compares, for needles that are rows,
+// prefixes of rows, and neither.
+TEST(codec, string_predicates_agree_across_encodings)
+{
+    const yeni::test::scratch_dir dir("codec");
+    const auto rows = redundant_strings(3000, 42);
+    write_strings(dir / "plain", rows, yeni::column_encoding::plain);
+    write_strings(dir / "front", rows, yeni::column_encoding::front_coded);
+    const auto plain = yeni::segment::open(dir / "plain");
+    const auto front = yeni::segment::open(dir / "front");
+    ASSERT_EQ(front.encoding("s"), yeni::column_encoding::front_coded);
+
+    const std::vector<std::string> needles = {"", rows[7], rows[100], rows[100].substr(0, 20),
+        "https://tenant-3.example.com/items/2", "https://tenant-3.example.com/items/2/", "https://tenant-9", "zzz",
+        "a"};
+    yeni::selection_bitmap a, b;
+    for (const auto& needle : needles) {
+        for (const auto op : {yeni::compare_op::eq, yeni::compare_op::ne, yeni::compare_op::lt, yeni::compare_op::le,
+                 yeni::compare_op::gt, yeni::compare_op::ge}) {
+            yeni::filter_string_compare(plain, "s", op, needle, a);
+            yeni::filter_string_compare(front, "s", op, needle, b);
+            ASSERT_EQ(a.size(), rows.size());
+            for (std::size_t i = 0; i < rows.size(); ++i) {
+                ASSERT_EQ(a.test(i), compares(op, rows[i], needle)) << "'" << needle << "' row " << i;
+                ASSERT_EQ(b.test(i), a.test(i)) << "'" << needle << "' row " << i;
+            }
+        }
+        yeni::filter_string_prefix(plain, "s", needle, a);
+        yeni::filter_string_prefix(front, "s", needle, b);
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            ASSERT_EQ(a.test(i), rows[i].starts_with(needle)) << "'" << needle << "' row " << i;
+            ASSERT_EQ(b.test(i), a.test(i)) << "'" << needle << "' row " << i;
+        }
+    }
+}
+
+TEST(codec, damaged_front_coded_columns_are_rejected)
+{
+    const auto rows = redundant_strings(100, 7);
+    std::vector<std::byte> raw((rows.size() + 1) * sizeof(std::uint64_t));
+    std::uint64_t off = 0;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        raw.insert(raw.end(), bytes_of(rows[i]).begin(), bytes_of(rows[i]).end());
+        off += rows[i].size();
+        std::memcpy(raw.data() + (i + 1) * sizeof(off), &off, sizeof(off));
+    }
+    const auto good = yeni::encode_front_coded(raw, rows.size());
+    std::vector<std::byte> out;
+    yeni::front_coded_column(good).decode(out);
+    EXPECT_EQ(out, raw);
+
+    EXPECT_THROW(yeni::front_coded_column(std::span(good).first(good.size() - 1)), yeni::format_error);
+    // A shared prefix longer than the row before it.
+    const std::size_t data_at = sizeof(yeni::detail::front_coded_header) + 8 * (7 + 1) + 0;
+    auto bad = good;
+    bad[data_at] = std::byte{0x7f};
+    EXPECT_THROW(yeni::front_coded_column(bad).decode(out), yeni::format_error);
+}
+
+} // namespace
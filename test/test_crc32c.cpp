@@ -0,0 +1,78 @@
+#include "yeni/crc32c.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::span<const std::byte> bytes_of(std::string_view s)
+{
+    return std::as_bytes(std::span(s.data(), s.size()));
+}
+
+struct known_vector {
+    std::vector<std::byte> data;
+    std::uint32_t crc;
+};
+
+// The check value of the Castagnoli CRC and the iSCSI test patterns of
+// RFC 3720, B.4.
+std::vector<known_vector> known_vectors()
+{
+    std::vector<known_vector> v;
+    const auto check = bytes_of("123456789");
+    v.push_back({{check.begin(), check.end()}, 0xe3069283});
+    v.push_back({std::vector<std::byte>(32, std::byte{0x00}), 0x8a9136aa});
+    v.push_back({std::vector<std::byte>(32, std::byte{0xff}), 0x62a8ab43});
+    std::vector<std::byte> up(32), down(32);
+    for (std::size_t i = 0; i < 32; ++i) {
+        up[i] = std::byte(i);
+        down[i] = std::byte(31 - i);
+    }
+    v.push_back({up, 0x46dd794e});
+    v.push_back({down, 0x113fdb5c});
+    v.push_back({{}, 0});
+    return v;
+}
+
+// Both implementations give the published values, whole and fed in two
+// pieces split anywhere.
+TEST(crc32c, matches_known_vectors)
+{
+    for (const auto& [data, crc] : known_vectors()) {
+        EXPECT_EQ(yeni::crc32c(data), crc);
+        EXPECT_EQ(yeni::crc32c_portable(data), crc);
+        const std::span<const std::byte> all(data);
+        for (std::size_t cut = 0; cut <= data.size(); ++cut) {
+            EXPECT_EQ(yeni::crc32c(all.subspan(cut), yeni::crc32c(all.first(cut))), crc) << cut;
+            EXPECT_EQ(yeni::crc32c_portable(all.subspan(cut), yeni::crc32c_portable(all.first(cut))), crc) << cut;
+        }
+    }
+}
+
+// The hardware path, whose three interleaved streams only kick in on long
+// inputs, agrees with the table at every length and alignment.
+TEST(crc32c, hardware_agrees_with_portable)
+{
+    if (!yeni::crc32c_hardware())
+        return; // the table is all there is
+    std::mt19937_64 rng(42);
+    std::vector<std::byte> buf(70000);
+    for (auto& b : buf)
+        b = std::byte(rng());
+    const std::span<const std::byte> all(buf);
+    for (std::size_t len : {std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(8), std::size_t(63),
+             std::size_t(255), std::size_t(256), std::size_t(1000), std::size_t(4096), std::size_t(65536)}) {
+        for (std::size_t align = 0; align < 8; ++align) {
+            const auto piece = all.subspan(align, len);
+            const std::uint32_t seed = std::uint32_t(rng());
+            ASSERT_EQ(yeni::crc32c(piece, seed), yeni::crc32c_portable(piece, seed)) << len << " at " << align;
+        }
+    }
+}
+
+} // namespace
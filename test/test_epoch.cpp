@@ -0,0 +1,91 @@
+#include "stress.hpp"
+
+#include "yeni/epoch.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+struct node {
+    static constexpr std::uint64_t live = 0x6c6976656e6f6465;
+
+    explicit node(std::uint64_t v) : value(v) {}
+    ~node() { magic = 0; }
+
+    std::uint64_t magic = live;
+    std::uint64_t value;
+};
+
+// A writer keeps swapping the shared node and retiring the old one while
+// readers dereference it under guards: a reader must never see a node
+// that has been freed. ASan turns a premature free into a report even
+// when the memory still looks intact.
+TEST(epoch, retired_objects_outlive_their_readers)
+{
+    std::atomic<node*> current{new node(0)};
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> reads{0};
+    yeni::test::run_threads(yeni::test::stress_threads(), [&](unsigned t) {
+        if (t == 0) {
+            struct stopper {
+                std::atomic<bool>& stop;
+                ~stopper() { stop.store(true); }
+            } stop_readers{stop};
+            std::uint64_t v = 0;
+            yeni::test::for_duration([&] {
+                for (int i = 0; i < 100; ++i)
+                    yeni::epoch::retire(current.exchange(new node(++v), std::memory_order_acq_rel));
+            });
+            return;
+        }
+        while (!stop.load(std::memory_order_relaxed)) {
+            const yeni::epoch::guard pin;
+            const node* n = current.load(std::memory_order_acquire);
+            const std::uint64_t first = n->value;
+            {
+                const yeni::epoch::guard nested;
+                ASSERT_EQ(n->magic, node::live);
+            }
+            ASSERT_EQ(n->value, first);
+            ASSERT_EQ(n->magic, node::live);
+            reads.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    delete current.load();
+    yeni::epoch::synchronize();
+    EXPECT_EQ(yeni::epoch::pending(), 0u);
+    EXPECT_GT(reads.load(), 0u);
+}
+
+// A stamp becomes reclaimable only once guards older than it are gone.
+TEST(epoch, stamps_wait_for_older_guards)
+{
+    std::atomic<bool> pinned{false}, release{false};
+    std::uint64_t stamp = 0;
+    yeni::test::run_threads(2, [&](unsigned t) {
+        if (t == 0) {
+            const yeni::epoch::guard pin;
+            pinned.store(true);
+            while (!release.load())
+                yeni::epoch::collect();
+            return;
+        }
+        while (!pinned.load())
+            std::this_thread::yield();
+        stamp = yeni::epoch::stamp();
+        for (int i = 0; i < 100; ++i) {
+            yeni::epoch::collect();
+            ASSERT_FALSE(yeni::epoch::reclaimable(stamp));
+        }
+        release.store(true);
+    });
+    for (int i = 0; i < 3 && !yeni::epoch::reclaimable(stamp); ++i)
+        yeni::epoch::collect();
+    EXPECT_TRUE(yeni::epoch::reclaimable(stamp));
+}
+
+} // namespace
@@ -0,0 +1,172 @@
+#include "stress.hpp"
+
+#include "yeni/executor.hpp"
+#include "yeni/hash.hpp"
+#include "yeni/scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct table {
+    std::vector<std::uint64_t> a;
+    std::vector<std::uint32_t> b;
+    std::vector<double> c;
+    std::vector<std::int64_t> d;
+};
+
+table write_table(const std::filesystem::path& path, std::size_t rows, std::uint64_t seed, bool encode)
+{
+    table t;
+    for (std::size_t i = 0; i < rows; ++i) {
+        const std::uint64_t h = yeni::mix64(seed * 1000003 + i);
+        t.a.push_back(h % 100000);
+        t.b.push_back(std::uint32_t(h >> 20) % 100);
+        t.c.push_back(double(h % 64) / 4);
+        t.d.push_back(std::int64_t(h >> 40) % 50 - 25);
+    }
+    yeni::codec_options codec;
+    codec.encode = encode;
+    yeni::segment_writer w(path, nullptr, codec);
+    w.add_column<std::uint64_t>("a", t.a);
+    w.add_column<std::uint32_t>("b", t.b);
+    w.add_column<double>("c", t.c);
+    w.add_column<std::int64_t>("d", t.d);
+    w.finish();
+    return t;
+}
+
+// Per-driver partial sums, merged once the query is done.
+struct partial {
+    std::uint64_t rows = 0;
+    std::uint64_t sum_a = 0;
+    double sum_c = 0;
+};
+
+// Filters over both encodings and a source selection, with projections
+// read per vector, give what a row-at-a-time scan gives.
+TEST(executor, pipelines_match_a_row_scan)
+{
+    const yeni::test::scratch_dir dir("executor");
+    yeni::scheduler sched({.threads = 3, .pin_workers = false});
+    yeni::query_executor exec({.sched = &sched, .morsel_rows = 5000});
+    EXPECT_EQ(exec.morsel_rows(), 5120u);
+    EXPECT_EQ(exec.slots(), 3u);
+
+    const table plain = write_table(dir / "plain.seg", 70001, 1, false);
+    const table packed = write_table(dir / "packed.seg", 45000, 2, true);
+    const yeni::segment s0 = yeni::segment::open(dir / "plain.seg"), s1 = yeni::segment::open(dir / "packed.seg");
+    ASSERT_TRUE(yeni::is_packed(s1.encoding("b")));
+    yeni::selection_bitmap odd(s1.rows());
+    for (std::size_t i = 1; i < s1.rows(); i += 2)
+        odd.set(i);
+    // Leaves the morsels past the first without a row, which are skipped.
+    for (std::size_t i = 6000; i < s1.rows(); ++i)
+        odd.reset(i);
+
+    std::vector<partial> parts(exec.slots());
+    std::atomic<bool> misaligned{false};
+    yeni::pipeline p({{&s0}, {&s1, &odd}});
+    p.where<std::uint32_t>("b", yeni::compare_op::lt, 70)
+        .where_between<std::int64_t>("d", -10, 20)
+        .project<std::uint64_t>("a")
+        .project<double>("c")
+        .sink([&](const yeni::row_vector& v) {
+            if (v.first_row % yeni::packed_page_rows != 0 || v.rows > yeni::packed_page_rows || v.selection.none())
+                misaligned = true;
+            partial& part = parts[v.slot];
+            const auto a = v.column<std::uint64_t>(0);
+            const auto c = v.column<double>(1);
+            v.selection.for_each([&](std::size_t i) {
+                ++part.rows;
+                part.sum_a += a[i] * (v.source + 1);
+                part.sum_c += c[i];
+            });
+        });
+    const auto h = exec.submit(p);
+    h.wait();
+    EXPECT_TRUE(h.done());
+    EXPECT_EQ(h.dop(), 0u);
+    EXPECT_EQ(h.morsels(), 14u + 2u);
+    EXPECT_FALSE(misaligned);
+
+    partial want;
+    for (const auto* t : {&plain, &packed}) {
+        for (std::size_t i = 0; i < t->a.size(); ++i) {
+            if (t == &packed && !odd.test(i))
+                continue;
+            if (t->b[i] < 70 && t->d[i] >= -10 && t->d[i] <= 20) {
+                ++want.rows;
+                want.sum_a += t->a[i] * (t == &packed ? 2 : 1);
+                want.sum_c += t->c[i];
+            }
+        }
+    }
+    partial got;
+    for (const auto& part : parts) {
+        got.rows += part.rows;
+        got.sum_a += part.sum_a;
+        got.sum_c += part.sum_c;
+    }
+    EXPECT_EQ(got.rows, want.rows);
+    EXPECT_EQ(got.sum_a, want.sum_a);
+    // Quarters sum exactly in any order.
+    EXPECT_EQ(got.sum_c, want.sum_c);
+
+    const auto sink = [](const yeni::row_vector&) {};
+    EXPECT_THROW(exec.submit(yeni::pipeline({{&s0}})), std::invalid_argument);
+    EXPECT_THROW(exec.submit(yeni::pipeline({{nullptr}}).sink(sink)), std::invalid_argument);
+    EXPECT_THROW(exec.submit(yeni::pipeline({{&s0, &odd}}).sink(sink)), std::invalid_argument);
+    EXPECT_THROW(exec.submit(yeni::pipeline({{&s0}}).project<std::uint32_t>("a").sink(sink)), std::invalid_argument);
+    EXPECT_THROW(exec.submit(yeni::pipeline({{&s0}}).where<double>("e", yeni::compare_op::eq, 1.0).sink(sink)),
+        std::invalid_argument);
+}
+
+// A query submitted while another holds every driver gets drivers at the
+// next morsel boundary and finishes first; a failing sink stops only its
+// own query.
+TEST(executor, concurrent_queries_share_the_drivers)
+{
+    const yeni::test::scratch_dir dir("executor_share");
+    yeni::scheduler sched({.threads = 3, .pin_workers = false});
+    yeni::query_executor exec({.sched = &sched, .morsel_rows = 1024});
+    write_table(dir / "t.seg", 300 * 1024, 3, false);
+    const yeni::segment s = yeni::segment::open(dir / "t.seg");
+
+    std::atomic<std::uint64_t> long_rows{0};
+    const auto long_query = exec.submit(yeni::pipeline({{&s}}).sink([&](const yeni::row_vector& v) {
+        long_rows += v.selection.count();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }));
+    EXPECT_EQ(long_query.morsels(), 300u);
+    while (long_query.dop() == 0)
+        std::this_thread::yield();
+
+    std::atomic<std::uint64_t> short_rows{0};
+    exec.run(yeni::pipeline({{&s}})
+                 .where<std::uint32_t>("b", yeni::compare_op::eq, 7)
+                 .sink([&](const yeni::row_vector& v) { short_rows += v.selection.count(); }));
+    EXPECT_GT(short_rows.load(), 0u);
+    EXPECT_FALSE(long_query.done());
+
+    std::atomic<unsigned> calls{0};
+    const auto failing = exec.submit(yeni::pipeline({{&s}}).sink([&](const yeni::row_vector& v) {
+        ++calls;
+        if (v.first_row == 10 * 1024)
+            throw std::runtime_error("sink failed");
+    }));
+    EXPECT_THROW(failing.wait(), std::runtime_error);
+    EXPECT_LT(calls.load(), 300u);
+
+    long_query.wait();
+    EXPECT_EQ(long_rows.load(), s.rows());
+}
+
+} // namespace
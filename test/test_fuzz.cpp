@@ -0,0 +1,248 @@
+#include "fuzz.hpp"
+#include "stress.hpp"
+
+#include "yeni/btree.hpp"
+#include "yeni/bulk.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/segment.hpp"
+#include "yeni/wal.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using input = std::vector<std::uint8_t>;
+using target = int (*)(const std::uint8_t*, std::size_t);
+
+/// Mutated inputs per target: YENI_FUZZ_RUNS, 500 by default.
+std::size_t fuzz_runs()
+{
+    const char* v = std::getenv("YENI_FUZZ_RUNS");
+    return v ? std::strtoull(v, nullptr, 10) : 500;
+}
+
+input read_file(const std::filesystem::path& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+input as_input(const std::string& s)
+{
+    return {s.begin(), s.end()};
+}
+
+std::span<const std::byte> as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+/// libFuzzer-style mutations, seeded per run so that a failure replays:
+/// bit flips, bytes and words set to boundary values, truncation,
+/// erased and duplicated ranges, and splices from another seed.
+class mutator {
+public:
+    explicit mutator(std::uint64_t seed) : rng_(seed) {}
+
+    input operator()(const std::vector<input>& seeds)
+    {
+        input out = seeds[rng_() % seeds.size()];
+        for (std::size_t n = 1 + rng_() % 4; n > 0; --n)
+            mutate(out, seeds[rng_() % seeds.size()]);
+        return out;
+    }
+
+private:
+    void mutate(input& v, const input& other)
+    {
+        static constexpr std::uint64_t boundary[] = {0, 1, 0x7f, 0x80, 0xff, 0x7fff, 0xffff, 0x7fffffff, 0x80000000,
+            0xffffffff, 0x7fffffffffffffff, ~std::uint64_t(0)};
+        if (v.empty()) {
+            v.push_back(std::uint8_t(rng_()));
+            return;
+        }
+        const std::size_t at = rng_() % v.size();
+        switch (rng_() % 8) {
+        case 0:
+            v[at] ^= std::uint8_t(1u << rng_() % 8);
+            break;
+        case 1:
+            v[at] = std::uint8_t(rng_());
+            break;
+        case 2:
+        case 3: {
+            // A width-aligned field, where sizes and offsets live.
+            const std::size_t width = rng_() % 2 ? 4 : 8;
+            const std::size_t pos = at / width * width;
+            std::uint64_t value = boundary[rng_() % std::size(boundary)];
+            if (rng_() % 3 == 0)
+                value = v.size() + rng_() % 129 - 64;
+            std::memcpy(&v[pos], &value, std::min(width, v.size() - pos));
+            break;
+        }
+        case 4:
+            v.resize(at);
+            break;
+        case 5:
+            v.erase(v.begin() + std::ptrdiff_t(at), v.begin() + std::ptrdiff_t(std::min(v.size(), at + 1 + rng_() % 64)));
+            break;
+        case 6: {
+            const std::size_t len = std::min(v.size() - at, std::size_t(1 + rng_() % 64));
+            const input chunk(v.begin() + std::ptrdiff_t(at), v.begin() + std::ptrdiff_t(at + len));
+            v.insert(v.begin() + std::ptrdiff_t(rng_() % v.size()), chunk.begin(), chunk.end());
+            break;
+        }
+        default:
+            if (!other.empty()) {
+                const std::size_t from = rng_() % other.size();
+                const std::size_t len = std::min(other.size() - from, std::size_t(1 + rng_() % 256));
+                std::memcpy(&v[at], &other[from], std::min(len, v.size() - at));
+            }
+        }
+    }
+
+    std::mt19937_64 rng_;
+};
+
+/// Run `fuzz` over every seed as it is, then over fuzz_runs() mutations.
+/// With YENI_FUZZ_SEEDS=<dir> the seeds are also written there, as a
+/// starting corpus for the libFuzzer binaries.
+void run(const char* name, target fuzz, const std::vector<input>& seeds)
+{
+    if (const char* dir = std::getenv("YENI_FUZZ_SEEDS")) {
+        const std::filesystem::path out = std::filesystem::path(dir) / name;
+        std::filesystem::create_directories(out);
+        for (std::size_t i = 0; i < seeds.size(); ++i)
+            std::ofstream(out / ("seed-" + std::to_string(i)), std::ios::binary)
+                .write(reinterpret_cast<const char*>(seeds[i].data()), std::streamsize(seeds[i].size()));
+    }
+    for (const input& s : seeds)
+        ASSERT_EQ(fuzz(s.data(), s.size()), 0);
+    const std::size_t runs = fuzz_runs();
+    for (std::size_t i = 0; i < runs; ++i) {
+        const input in = mutator(i)(seeds);
+        SCOPED_TRACE(testing::Message() << name << " run " << i);
+        ASSERT_NO_THROW(fuzz(in.data(), in.size()));
+    }
+}
+
+std::vector<std::byte> sample_tree()
+{
+    yeni::btree_index tree;
+    for (std::uint64_t i = 0; i < 3000; ++i)
+        tree.insert(as_bytes("customer/" + std::to_string(i * 7919 % 3000)), i);
+    return tree.serialize();
+}
+
+std::vector<input> segment_seeds()
+{
+    const yeni::test::scratch_dir dir("fuzz");
+    std::vector<input> seeds;
+    {
+        yeni::record_store store;
+        for (std::uint64_t k = 0; k < 300; ++k)
+            store.append(k * 3, as_bytes("value-" + std::to_string(k)));
+        yeni::write_segment(dir / "store.seg", store);
+        seeds.push_back(read_file(dir / "store.seg"));
+    }
+    {
+        // Packed, general-purpose compressed and plain columns, and a
+        // B+tree aux block.
+        std::vector<std::uint32_t> small(2000);
+        std::vector<std::uint64_t> wide(2000);
+        std::vector<double> real(2000);
+        std::vector<std::string> names(2000);
+        for (std::size_t i = 0; i < small.size(); ++i) {
+            small[i] = std::uint32_t(i % 13);
+            wide[i] = std::uint64_t(i) << 40 | i % 5;
+            real[i] = double(i) / 3;
+            names[i].assign(i % 9, 'n');
+        }
+        yeni::codec_options codec;
+        codec.binary = yeni::column_encoding::lz4;
+        yeni::segment_writer w(dir / "encoded.seg", nullptr, codec);
+        w.add_column<std::uint32_t>("small", small);
+        w.add_column<std::uint64_t>("wide", wide);
+        w.add_column<double>("real", real);
+        w.add_binary_column("name", small.size(), [&](std::size_t i) { return as_bytes(names[i]); });
+        yeni::btree_index tree;
+        for (std::uint64_t i = 0; i < 500; ++i)
+            tree.insert(as_bytes("order/" + std::to_string(i)), i);
+        tree.save(w, "tree");
+        w.finish();
+        seeds.push_back(read_file(dir / "encoded.seg"));
+    }
+    {
+        std::vector<std::string> urls(1000);
+        for (std::size_t i = 0; i < urls.size(); ++i)
+            urls[i] = "https://tenant-" + std::to_string(i % 3) + ".example.com/" + std::to_string(i / 7);
+        yeni::codec_options codec;
+        codec.binary = yeni::column_encoding::front_coded;
+        yeni::segment_writer w(dir / "strings.seg", nullptr, codec);
+        w.add_binary_column("url", urls.size(), [&](std::size_t i) { return as_bytes(urls[i]); });
+        w.finish();
+        seeds.push_back(read_file(dir / "strings.seg"));
+    }
+    return seeds;
+}
+
+TEST(fuzz, segment)
+{
+    run("segment", yeni::test::fuzz_segment, segment_seeds());
+}
+
+TEST(fuzz, btree_view)
+{
+    const std::vector<std::byte> tree = sample_tree();
+    const std::vector<std::byte> empty = yeni::btree_index().serialize();
+    run("btree_view", yeni::test::fuzz_btree_view,
+        {input(reinterpret_cast<const std::uint8_t*>(tree.data()),
+             reinterpret_cast<const std::uint8_t*>(tree.data() + tree.size())),
+            input(reinterpret_cast<const std::uint8_t*>(empty.data()),
+                reinterpret_cast<const std::uint8_t*>(empty.data() + empty.size()))});
+}
+
+TEST(fuzz, wal)
+{
+    const yeni::test::scratch_dir dir("fuzz");
+    {
+        yeni::wal log(dir.path(), {.segment_size = 64 << 10, .sync = false});
+        for (int i = 0; i < 200; ++i)
+            log.append_nowait(as_bytes(std::string(std::size_t(i % 40), char('a' + i % 26))));
+    }
+    // Only the part holding records: the preallocated rest is zeros.
+    input seed = read_file(dir / "wal-0000000000000001.log");
+    yeni::wal_reader reader(dir.path());
+    yeni::wal_entry e;
+    std::size_t end = 64;
+    while (reader.next(e))
+        end += yeni::wal_format::footprint(e.payload.size());
+    seed.resize(end + 64);
+    run("wal", yeni::test::fuzz_wal, {seed});
+}
+
+TEST(fuzz, bulk)
+{
+    const auto with_options = [](std::uint8_t options, const std::string& text) {
+        input in = as_input(text);
+        in.insert(in.begin(), options);
+        return in;
+    };
+    run("bulk", yeni::test::fuzz_bulk,
+        {with_options(5 << 3, "id,n,x,q,name\n1,-2,2.5,7,\"quoted, \"\"name\"\"\"\n2,3,1e3,8,plain\n"),
+            with_options(2 | 4 | 3 << 3, "5;-1;0.5;2;x\r\n6;-2;0.25;3;\"multi\nline\"\n"),
+            with_options(1 | 6 << 3 | 0x80,
+                "{\"id\": 1, \"name\": \"a\\\"b\\u00e9\\ud83d\\ude00\", \"x\": -0.25, \"extra\": {\"k\": [1, \"}\"]}}\n"
+                "{\"q\":4,\"n\":-9,\"name\":{\"raw\":true},\"id\":null}\n")});
+}
+
+} // namespace
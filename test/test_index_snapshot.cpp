@@ -0,0 +1,143 @@
+#include "stress.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/index_snapshot.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/wal.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Log payload: the u64 key, then the value.
+std::vector<std::byte> put(std::uint64_t key, const std::string& value)
+{
+    std::vector<std::byte> p(sizeof(key) + value.size());
+    std::memcpy(p.data(), &key, sizeof(key));
+    std::memcpy(p.data() + sizeof(key), value.data(), value.size());
+    return p;
+}
+
+void apply_to(yeni::record_store& store, const yeni::wal_entry& e)
+{
+    std::uint64_t key;
+    std::memcpy(&key, e.payload.data(), sizeof(key));
+    store.append(key, e.payload.subspan(sizeof(key)));
+}
+
+std::string as_string(std::span<const std::byte> b)
+{
+    return {reinterpret_cast<const char*>(b.data()), b.size()};
+}
+
+// A restart maps the snapshot, replays only the log past it, and sees
+// every key as it was; a checkpoint over the snapshot carries it forward.
+TEST(index_snapshot, restart_replays_only_the_tail)
+{
+    const yeni::test::scratch_dir dir("index_snapshot");
+    const auto wal_dir = dir / "wal";
+    const auto path = dir / "index";
+    std::map<std::uint64_t, std::string> expected;
+    std::uint64_t snapshot_lsn = 0;
+    constexpr std::uint64_t before = 20000, after = 3000;
+    {
+        yeni::wal log(wal_dir, {.segment_size = 64 << 10, .max_batch_bytes = 16 << 10, .sync = false});
+        yeni::record_store store;
+        for (std::uint64_t i = 0; i < before; ++i) {
+            const std::uint64_t key = i % 15000;
+            const std::string value = std::to_string(i) + std::string(i % 40, 'x');
+            const auto payload = put(key, value);
+            log.append(payload);
+            store.append(key, std::span(payload).subspan(sizeof(key)));
+            expected[key] = value;
+        }
+        snapshot_lsn = log.durable_lsn();
+        write_index_snapshot(path, store, snapshot_lsn);
+        // Written after the snapshot, then the process "stops".
+        for (std::uint64_t i = 0; i < after; ++i) {
+            const std::uint64_t key = i * 7 % 20000;
+            const std::string value = std::to_string(i) + "-tail";
+            log.append(put(key, value));
+            expected[key] = value;
+        }
+    }
+
+    auto snap = yeni::index_snapshot::open(path);
+    EXPECT_EQ(snap.lsn(), snapshot_lsn);
+    EXPECT_EQ(snap.size(), 15000u);
+    yeni::record_store tail;
+    std::uint64_t replayed = 0, first = 0;
+    const std::uint64_t last = yeni::replay_wal_tail(wal_dir, snap, [&](const yeni::wal_entry& e) {
+        if (!replayed++)
+            first = e.lsn;
+        apply_to(tail, e);
+    });
+    EXPECT_EQ(replayed, after);
+    EXPECT_EQ(first, snapshot_lsn + 1);
+    EXPECT_EQ(last, snapshot_lsn + after);
+
+    const auto lookup = [&](std::uint64_t key) -> std::optional<std::string> {
+        if (const yeni::record* r = tail.find(key))
+            return as_string(r->value());
+        if (const auto v = snap.find(key))
+            return as_string(*v);
+        return std::nullopt;
+    };
+    for (const auto& [key, value] : expected)
+        ASSERT_EQ(lookup(key), value) << key;
+    EXPECT_FALSE(lookup(1u << 30));
+
+    write_index_snapshot(path, tail, last, &snap);
+    const auto next = yeni::index_snapshot::open(path);
+    EXPECT_EQ(next.lsn(), last);
+    EXPECT_EQ(next.size(), expected.size());
+    std::size_t seen = 0;
+    next.for_each([&](std::uint64_t key, std::span<const std::byte> value) {
+        EXPECT_EQ(as_string(value), expected.at(key));
+        ++seen;
+    });
+    EXPECT_EQ(seen, expected.size());
+}
+
+// Damage to the header is caught on open, before any lookup.
+TEST(index_snapshot, damaged_snapshots_are_rejected)
+{
+    const yeni::test::scratch_dir dir("index_snapshot_damage");
+    const auto path = dir / "index";
+    yeni::record_store store;
+    for (std::uint64_t k = 0; k < 100; ++k)
+        store.append(k, put(k, "value"));
+    write_index_snapshot(path, store, 42);
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    const auto write = [&](const std::vector<char>& b) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(b.data(), std::streamsize(b.size()));
+    };
+
+    auto flipped = bytes;
+    flipped[24] ^= 1; // in the entry count
+    write(flipped);
+    EXPECT_THROW(yeni::index_snapshot::open(path), yeni::format_error);
+    write(std::vector<char>(bytes.begin(), bytes.end() - 8));
+    EXPECT_THROW(yeni::index_snapshot::open(path), yeni::format_error);
+    write(std::vector<char>(bytes.begin(), bytes.begin() + 10));
+    EXPECT_THROW(yeni::index_snapshot::open(path), yeni::format_error);
+    write(bytes);
+    const auto snap = yeni::index_snapshot::open(path);
+    EXPECT_EQ(snap.lsn(), 42u);
+    EXPECT_EQ(snap.size(), 100u);
+    EXPECT_TRUE(snap.find(99));
+}
+
+} // namespace
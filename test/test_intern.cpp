@@ -0,0 +1,78 @@
+#include "stress.hpp"
+
+#include "yeni/intern.hpp"
+#include "yeni/segment.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Threads interning overlapping sets agree on every id, ids are dense, and
+// each id views back to its string.
+TEST(intern, concurrent_interning_agrees_on_ids)
+{
+    yeni::string_interner table;
+    constexpr std::size_t distinct = 20000;
+    const unsigned threads = yeni::test::stress_threads();
+    std::vector<std::vector<yeni::string_id>> ids(threads, std::vector<yeni::string_id>(distinct));
+    yeni::test::run_threads(threads, [&](unsigned t) {
+        // Each thread walks the strings from a different starting point.
+        for (std::size_t k = 0; k < distinct; ++k) {
+            const std::size_t i = (k + t * 7919) % distinct;
+            ids[t][i] = table.intern("tenant-" + std::to_string(i % 13) + "/user/" + std::to_string(i));
+        }
+    });
+    ASSERT_EQ(table.size(), distinct);
+    std::vector<bool> seen(distinct);
+    for (std::size_t i = 0; i < distinct; ++i) {
+        const std::string s = "tenant-" + std::to_string(i % 13) + "/user/" + std::to_string(i);
+        for (unsigned t = 1; t < threads; ++t)
+            ASSERT_EQ(ids[t][i], ids[0][i]);
+        ASSERT_LT(ids[0][i], distinct);
+        ASSERT_FALSE(seen[ids[0][i]]);
+        seen[ids[0][i]] = true;
+        ASSERT_EQ(table.view(ids[0][i]), s);
+        ASSERT_EQ(table.find(s), ids[0][i]);
+    }
+    EXPECT_FALSE(table.find("tenant-0/user/none"));
+    EXPECT_EQ(table.intern(""), table.intern(std::string()));
+    EXPECT_GT(table.bytes_reserved(), 0u);
+}
+
+// Interning a column gives equal ids exactly for equal rows, front-coded
+// or not.
+TEST(intern, columns_intern_to_equal_ids_for_equal_rows)
+{
+    const yeni::test::scratch_dir dir("intern");
+    std::vector<std::string> rows;
+    for (std::size_t i = 0; i < 4000; ++i)
+        rows.push_back("https://example.com/" + std::to_string(i / 3 % 500));
+    for (const auto e : {yeni::column_encoding::plain, yeni::column_encoding::front_coded}) {
+        const auto path = dir / std::string(yeni::to_string(e));
+        yeni::codec_options codec;
+        codec.binary = e;
+        yeni::segment_writer w(path, nullptr, codec);
+        w.add_binary_column("url", rows.size(),
+            [&](std::size_t i) { return std::as_bytes(std::span(rows[i].data(), rows[i].size())); });
+        w.finish();
+        const auto s = yeni::segment::open(path);
+        ASSERT_EQ(s.encoding("url"), e);
+
+        yeni::string_interner table;
+        const auto ids = yeni::intern_column(s, "url", table);
+        ASSERT_EQ(ids.size(), rows.size());
+        EXPECT_EQ(table.size(), 500u);
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            ASSERT_EQ(table.view(ids[i]), rows[i]);
+            if (i) {
+                ASSERT_EQ(ids[i] == ids[i - 1], rows[i] == rows[i - 1]);
+            }
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,213 @@
+#include "stress.hpp"
+
+#include "yeni/futex.hpp"
+#include "yeni/io.hpp"
+#include "yeni/scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t block = 4096;
+
+// A file opened for reading and writing, closed with the test.
+class scratch_file {
+public:
+    explicit scratch_file(const yeni::test::scratch_dir& dir)
+        : fd(::open((dir / "data").c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    {
+    }
+    ~scratch_file() { ::close(fd); }
+
+    scratch_file(const scratch_file&) = delete;
+    scratch_file& operator=(const scratch_file&) = delete;
+
+    const int fd;
+};
+
+std::vector<std::byte> pattern(std::size_t size, std::uint8_t seed)
+{
+    std::vector<std::byte> v(size);
+    for (std::size_t i = 0; i < size; ++i)
+        v[i] = std::byte(std::uint8_t(i * 31 + seed));
+    return v;
+}
+
+// Both backends: io_uring where the kernel allows it, and the thread pool.
+std::vector<yeni::io_options> backends()
+{
+    yeni::io_options uring, pool;
+    pool.force_fallback = true;
+    uring.buffers = pool.buffers = 2;
+    uring.buffer_size = pool.buffer_size = block;
+    return {uring, pool};
+}
+
+yeni::io_task<std::size_t> write_read_back(yeni::io_context& io, int fd)
+{
+    std::size_t written = 0;
+    for (std::uint8_t b = 0; b < 3; ++b) {
+        const auto data = pattern(block, b);
+        written += co_await io.write(fd, data, b * block);
+    }
+    co_await io.fsync(fd);
+    co_await io.fsync(fd, false);
+    std::vector<std::byte> back(block);
+    for (std::uint8_t b = 0; b < 3; ++b) {
+        EXPECT_EQ(co_await io.read(fd, back, b * block), block);
+        EXPECT_EQ(back, pattern(block, b));
+    }
+    // Short at the end of the file, and nothing past it.
+    EXPECT_EQ(co_await io.read(fd, back, 3 * block - 100), 100u);
+    EXPECT_EQ(co_await io.read(fd, back, 3 * block), 0u);
+    co_return written;
+}
+
+yeni::io_task<std::size_t> read_one(yeni::io_context& io, int fd)
+{
+    std::vector<std::byte> buf(16);
+    co_return co_await io.read(fd, buf, 0);
+}
+
+yeni::io_task<int> fixed_round_trip(yeni::io_context& io, int fd)
+{
+    const auto a = io.try_acquire_buffer();
+    const auto b = io.try_acquire_buffer();
+    EXPECT_TRUE(a && b);
+    EXPECT_FALSE(io.try_acquire_buffer());
+    if (!a || !b)
+        co_return 0;
+    EXPECT_NE(a->index, b->index);
+    const auto data = pattern(block, 9);
+    std::copy(data.begin(), data.end(), a->data);
+    EXPECT_EQ(co_await io.write_fixed(fd, *a, block, block), block);
+    EXPECT_EQ(co_await io.read_fixed(fd, *b, block, block), block);
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), b->data));
+    io.release_buffer(*a);
+    io.release_buffer(*b);
+    co_return 1;
+}
+
+yeni::io_task<int> resumed_on_worker(yeni::io_context& io, int fd, yeni::scheduler& sched)
+{
+    std::vector<std::byte> buf(16);
+    co_await io.read(fd, buf, 0);
+    co_return sched.current_worker();
+}
+
+// Writes, syncs and reads come back with the bytes and counts the
+// system calls would give, errors as std::system_error, on either
+// backend.
+TEST(io, awaited_requests_round_trip)
+{
+    for (const auto& options : backends()) {
+        const yeni::test::scratch_dir dir("io");
+        const scratch_file f(dir);
+        yeni::io_context io(options);
+        SCOPED_TRACE(io.backend() == yeni::io_backend::io_uring ? "io_uring" : "thread_pool");
+        if (options.force_fallback) {
+            EXPECT_EQ(io.backend(), yeni::io_backend::thread_pool);
+        }
+        EXPECT_EQ(sync_wait(write_read_back(io, f.fd)), 3 * block);
+        EXPECT_EQ(sync_wait(fixed_round_trip(io, f.fd)), 1);
+        try {
+            sync_wait(read_one(io, -1));
+            ADD_FAILURE() << "read of a bad fd succeeded";
+        } catch (const std::system_error& e) {
+            EXPECT_EQ(e.code().value(), EBADF);
+        }
+    }
+}
+
+// Submits `per_thread` reads from each of `threads` threads in one batch
+// apiece and checks that each completes once, with its own result.
+void expect_batches_complete(const yeni::io_options& options, unsigned threads, unsigned per_thread)
+{
+    const yeni::test::scratch_dir dir("io");
+    const scratch_file f(dir);
+    const auto data = pattern(64 * block, 3);
+    ASSERT_EQ(::pwrite(f.fd, data.data(), data.size(), 0), ssize_t(data.size()));
+
+    struct counted : yeni::io_request {
+        std::atomic<std::uint32_t>* remaining;
+        std::atomic<int> completions{0};
+    };
+    // Outlive the context, whose completion thread wakes `remaining`.
+    std::atomic<std::uint32_t> remaining{threads * per_thread};
+    std::vector<counted> reqs(threads * per_thread);
+    std::vector<std::vector<std::byte>> bufs(reqs.size(), std::vector<std::byte>(block));
+    yeni::io_context io(options);
+    yeni::test::run_threads(threads, [&](unsigned t) {
+        std::vector<yeni::io_request*> batch;
+        for (unsigned i = t * per_thread; i < (t + 1) * per_thread; ++i) {
+            counted& r = reqs[i];
+            r.fd = f.fd;
+            r.data = bufs[i].data();
+            r.size = block;
+            r.offset = i % 64 * block;
+            r.remaining = &remaining;
+            r.complete = [](yeni::io_request* p) noexcept {
+                auto* c = static_cast<counted*>(p);
+                c->completions.fetch_add(1);
+                if (c->remaining->fetch_sub(1) == 1)
+                    yeni::futex_wake(*c->remaining);
+            };
+            batch.push_back(&r);
+        }
+        io.submit(batch);
+    });
+    for (std::uint32_t v; (v = remaining.load()) != 0;)
+        yeni::futex_wait(remaining, v);
+    for (std::size_t i = 0; i < reqs.size(); ++i) {
+        ASSERT_EQ(reqs[i].completions.load(), 1) << i;
+        ASSERT_EQ(reqs[i].result, std::int64_t(block)) << i;
+        ASSERT_TRUE(std::equal(bufs[i].begin(), bufs[i].end(), data.begin() + std::ptrdiff_t(i % 64 * block)));
+    }
+}
+
+// Requests submitted together from several threads each complete once,
+// with their own result.
+TEST(io, batches_complete_each_request_once)
+{
+    for (const auto& options : backends())
+        expect_batches_complete(options, 4, 64);
+}
+
+// A batch larger than the submission queue, alone or racing others,
+// wakes the completion thread to drain it rather than waiting on it.
+TEST(io, batches_larger_than_the_queue_complete)
+{
+    yeni::io_options options;
+    options.queue_depth = 8; // a queue of 256
+    if (yeni::io_context(options).backend() != yeni::io_backend::io_uring)
+        return; // the thread pool's queue is unbounded
+    expect_batches_complete(options, 1, 600);
+    expect_batches_complete(options, 4, 300);
+}
+
+// A context with resume_on hands the awaiting coroutine to a worker of
+// that scheduler.
+TEST(io, resumes_on_the_given_scheduler)
+{
+    const yeni::test::scratch_dir dir("io");
+    const scratch_file f(dir);
+    const auto data = pattern(16, 1);
+    ASSERT_EQ(::pwrite(f.fd, data.data(), data.size(), 0), 16);
+    yeni::scheduler sched({.threads = 2, .pin_workers = false});
+    yeni::io_options options;
+    options.resume_on = &sched;
+    yeni::io_context io(options);
+    EXPECT_GE(sync_wait(resumed_on_worker(io, f.fd, sched)), 0);
+}
+
+} // namespace
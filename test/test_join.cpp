@@ -0,0 +1,145 @@
+#include "stress.hpp"
+
+#include "yeni/hash.hpp"
+#include "yeni/join.hpp"
+#include "yeni/predicate.hpp"
+#include "yeni/scheduler.hpp"
+#include "yeni/segment.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using row_pairs = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+template <class T>
+void write_side(const std::filesystem::path& path, const std::vector<T>& keys, bool encode)
+{
+    std::vector<std::uint32_t> q(keys.size());
+    for (std::size_t i = 0; i < q.size(); ++i)
+        q[i] = std::uint32_t(yeni::mix64(i) % 100);
+    yeni::codec_options codec;
+    codec.encode = encode;
+    yeni::segment_writer w(path, nullptr, codec);
+    w.add_column<T>("k", keys);
+    w.add_column<std::uint32_t>("q", q);
+    w.finish();
+}
+
+template <class T>
+row_pairs nested_loops(const std::vector<T>& left, const yeni::selection_bitmap* ls, const std::vector<T>& right,
+    const yeni::selection_bitmap* rs)
+{
+    std::multimap<T, std::uint32_t> build;
+    for (std::size_t j = 0; j < right.size(); ++j)
+        if (!rs || rs->test(j))
+            build.emplace(right[j], std::uint32_t(j));
+    row_pairs out;
+    for (std::size_t i = 0; i < left.size(); ++i) {
+        if (ls && !ls->test(i))
+            continue;
+        const auto [b, e] = build.equal_range(left[i]);
+        for (auto it = b; it != e; ++it)
+            out.emplace_back(std::uint32_t(i), it->second);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+template <class T>
+class join : public testing::Test {
+};
+
+using key_types = testing::Types<std::uint64_t, std::int64_t, std::uint32_t>;
+TYPED_TEST_SUITE(join, key_types);
+
+// Random inputs, with and without selections, encodings and spilling,
+// against a nested-loop join; sort-merge batches must also come out in
+// (key, left row, right row) order.
+TYPED_TEST(join, both_algorithms_match_nested_loops)
+{
+    using T = TypeParam;
+    const yeni::test::scratch_dir dir("join");
+    yeni::scheduler sched({.threads = 3, .pin_workers = false});
+    std::mt19937_64 rng(sizeof(T) * 2 + std::is_signed_v<T>);
+    for (int round = 0; round < 12; ++round) {
+        const std::size_t nl = round % 4 == 0 ? rng() % 10 : rng() % 20000, nr = rng() % 30000;
+        const std::uint64_t range = 1000 + rng() % 20000;
+        const bool select = rng() & 1, encode = rng() & 1, spill = round % 3 == 1;
+        std::vector<T> left(nl), right(nr);
+        for (auto* side : {&left, &right})
+            for (T& k : *side)
+                k = T(rng() % range) - (std::is_signed_v<T> ? T(range / 2) : T(0));
+        write_side(dir / "l.seg", left, encode);
+        write_side(dir / "r.seg", right, encode);
+        const yeni::segment ls = yeni::segment::open(dir / "l.seg"), rs = yeni::segment::open(dir / "r.seg");
+        yeni::selection_bitmap lsel, rsel;
+        if (select) {
+            yeni::filter_compare<std::uint32_t>(ls, "q", yeni::compare_op::lt, 60, lsel);
+            yeni::filter_compare<std::uint32_t>(rs, "q", yeni::compare_op::ge, 20, rsel);
+        }
+        const row_pairs want = nested_loops(left, select ? &lsel : nullptr, right, select ? &rsel : nullptr);
+
+        yeni::join_options o;
+        o.sched = &sched;
+        o.memory_budget = spill ? 1 + rng() % 100000 : o.memory_budget;
+        o.batch_rows = 1 + rng() % 300;
+        o.spill_dir = dir.path();
+        for (const bool merge : {false, true}) {
+            SCOPED_TRACE(testing::Message() << "round " << round << (merge ? " sort-merge" : " radix hash"));
+            row_pairs got;
+            std::mutex m;
+            bool ordered = true;
+            const yeni::join_sink sink = [&](std::span<const std::uint32_t> l, std::span<const std::uint32_t> r) {
+                EXPECT_EQ(l.size(), r.size());
+                EXPECT_LE(l.size(), o.batch_rows);
+                bool in_order = true;
+                for (std::size_t i = 1; merge && i < l.size(); ++i) {
+                    const T k0 = left[l[i - 1]], k1 = left[l[i]];
+                    in_order &= k0 < k1 || (k0 == k1 && std::pair(l[i - 1], r[i - 1]) < std::pair(l[i], r[i]));
+                }
+                std::lock_guard lock(m);
+                ordered &= in_order;
+                for (std::size_t i = 0; i < l.size(); ++i)
+                    got.emplace_back(l[i], r[i]);
+            };
+            const yeni::join_input li{&ls, "k", select ? &lsel : nullptr}, ri{&rs, "k", select ? &rsel : nullptr};
+            const yeni::join_stats st = merge ? yeni::sort_merge_join(li, ri, sink, o) : yeni::radix_hash_join(li, ri, sink, o);
+            std::sort(got.begin(), got.end());
+            EXPECT_TRUE(ordered);
+            EXPECT_EQ(st.matches, want.size());
+            ASSERT_EQ(got, want);
+            if (spill && nl + nr > 1000) {
+                EXPECT_GT(st.spill_partitions, 0u);
+            }
+        }
+    }
+}
+
+TEST(join_errors, bad_inputs_and_sink_failures_throw)
+{
+    const yeni::test::scratch_dir dir("join");
+    write_side<std::uint64_t>(dir / "s.seg", {1, 2, 3}, false);
+    const yeni::segment s = yeni::segment::open(dir / "s.seg");
+    const auto ignore = [](std::span<const std::uint32_t>, std::span<const std::uint32_t>) {};
+    EXPECT_THROW(yeni::radix_hash_join({&s, "missing"}, {&s, "k"}, ignore), std::invalid_argument);
+    const yeni::selection_bitmap wrong_size(5);
+    EXPECT_THROW(yeni::radix_hash_join({&s, "k", &wrong_size}, {&s, "k"}, ignore), std::invalid_argument);
+    const auto fail = [](std::span<const std::uint32_t>, std::span<const std::uint32_t>) {
+        throw std::runtime_error("sink failed");
+    };
+    EXPECT_THROW(yeni::sort_merge_join({&s, "k"}, {&s, "k"}, fail, {.memory_budget = 1, .spill_dir = dir.path()}),
+        std::runtime_error);
+}
+
+} // namespace
@@ -0,0 +1,124 @@
+#include "stress.hpp"
+
+#include "yeni/lsm_tree.hpp"
+#include "yeni/metrics.hpp"
+#include "yeni/record_store.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+yeni::compaction_options no_compaction()
+{
+    yeni::compaction_options options;
+    options.level0_trigger = 100;
+    options.bytes_per_second = 0;
+    return options;
+}
+
+std::vector<std::string> segment_names(const yeni::lsm_tree& tree)
+{
+    const yeni::epoch::guard pin;
+    std::vector<std::string> names;
+    for (const auto& s : tree.current(pin).level(0))
+        names.push_back(s->path().filename().string());
+    return names;
+}
+
+// Reopening maps nothing; a lookup opens only the segment whose key range
+// holds the key, and a manifest of the first version still loads.
+TEST(lsm_tree, reopened_segments_are_mapped_on_first_read)
+{
+    const yeni::test::scratch_dir dir("lsm_lazy");
+    constexpr std::uint64_t per_flush = 1000;
+    const std::vector<std::byte> value(16, std::byte{0x3c});
+    std::vector<std::string> names;
+    {
+        yeni::lsm_tree tree(dir.path(), no_compaction());
+        for (std::uint64_t f = 0; f < 3; ++f) {
+            yeni::record_store store;
+            for (std::uint64_t k = f * per_flush; k < (f + 1) * per_flush; ++k)
+                store.append(k, value);
+            tree.flush(store);
+        }
+        names = segment_names(tree);
+    }
+
+    {
+        yeni::lsm_tree tree(dir.path(), no_compaction());
+        const yeni::epoch::guard pin;
+        const auto& v = tree.current(pin);
+        ASSERT_EQ(v.level(0).size(), 3u);
+        for (const auto& s : v.level(0))
+            EXPECT_FALSE(s->is_open());
+        const auto opens = yeni::metrics::collect()[yeni::metrics::counter::segment_lazy_opens];
+        EXPECT_FALSE(tree.find(10 * per_flush, pin));
+        const auto found = tree.find(per_flush + 5, pin);
+        ASSERT_TRUE(found);
+        EXPECT_EQ(found->size(), value.size());
+        std::size_t open = 0;
+        for (const auto& s : v.level(0)) {
+            open += s->is_open();
+            if (s->is_open()) {
+                EXPECT_EQ(s->min_key(), per_flush);
+            }
+        }
+        EXPECT_EQ(open, 1u);
+        if (yeni::metrics::enabled) {
+            EXPECT_EQ(yeni::metrics::collect()[yeni::metrics::counter::segment_lazy_opens], opens + 1);
+        }
+    }
+
+    {
+        std::ofstream manifest(dir / "MANIFEST", std::ios::trunc);
+        manifest << "yeni-manifest 1\n";
+        for (const auto& name : names)
+            manifest << "0 " << name << "\n";
+    }
+    {
+        yeni::lsm_tree tree(dir.path(), no_compaction());
+        const yeni::epoch::guard pin;
+        for (const auto& s : tree.current(pin).level(0))
+            EXPECT_TRUE(s->is_open());
+        for (std::uint64_t k = 0; k < 3 * per_flush; k += 97)
+            EXPECT_TRUE(tree.find(k, pin));
+    }
+    // Free the versions the flushes replaced.
+    yeni::epoch::synchronize();
+}
+
+// A segment that only turns out to be bad when a compaction planned on
+// reopening maps it fails that compaction, not the tree.
+TEST(lsm_tree, a_bad_segment_fails_the_compaction_planned_on_open)
+{
+    const yeni::test::scratch_dir dir("lsm_bad_segment");
+    const std::vector<std::byte> value(16, std::byte{0x5a});
+    std::vector<std::string> names;
+    {
+        yeni::lsm_tree tree(dir.path(), no_compaction());
+        for (std::uint64_t f = 0; f < 3; ++f) {
+            yeni::record_store store;
+            for (std::uint64_t k = f * 100; k < (f + 1) * 100; ++k)
+                store.append(k, value);
+            tree.flush(store);
+        }
+        names = segment_names(tree);
+    }
+    std::filesystem::resize_file(dir / names.back(), 16);
+
+    yeni::compaction_options options = no_compaction();
+    options.level0_trigger = 2;
+    yeni::lsm_tree tree(dir.path(), options);
+    tree.wait_for_compactions();
+    EXPECT_TRUE(tree.last_error());
+    const yeni::epoch::guard pin;
+    EXPECT_EQ(tree.current(pin).level(0).size(), 3u);
+}
+
+} // namespace
@@ -0,0 +1,85 @@
+// Test driver. Results go to the console as usual and, one line per test
+// sorted by name, to test_output.txt (or --yeni_out=<path>), headed by the
+// sanitizer the build used so that a run under TSan or ASan is told apart
+// from a plain one.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef YENI_SANITIZE
+#define YENI_SANITIZE ""
+#endif
+
+namespace {
+
+struct result {
+    const char* status;
+    long long ms;
+};
+
+class output_listener : public testing::EmptyTestEventListener {
+public:
+    void OnTestEnd(const testing::TestInfo& info) override
+    {
+        const testing::TestResult& r = *info.result();
+        const char* status = r.Skipped() ? "skipped" : r.Failed() ? "FAILED" : "ok";
+        results_[std::string(info.test_suite_name()) + "." + info.name()] = {status, (long long)r.elapsed_time()};
+    }
+
+    bool write(const char* path) const
+    {
+        std::FILE* f = std::fopen(path, "w");
+        if (!f)
+            return false;
+        std::size_t passed = 0, failed = 0, skipped = 0;
+        std::fprintf(f, "# yeni test results v1\n");
+        std::fprintf(f, "# sanitizer: %s\n", *YENI_SANITIZE ? YENI_SANITIZE : "none");
+        std::fprintf(f, "%-64s %8s %10s\n", "# name", "result", "ms");
+        for (const auto& [name, r] : results_) {
+            std::fprintf(f, "%-64s %8s %10lld\n", name.c_str(), r.status, r.ms);
+            passed += r.status[0] == 'o';
+            failed += r.status[0] == 'F';
+            skipped += r.status[0] == 's';
+        }
+        std::fprintf(f, "# %zu passed, %zu failed, %zu skipped\n", passed, failed, skipped);
+        return std::fclose(f) == 0;
+    }
+
+private:
+    std::map<std::string, result> results_;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* out = "test_output.txt";
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--yeni_out=", 11) == 0)
+            out = argv[i] + 11;
+        else
+            args.push_back(argv[i]);
+    }
+    int n = int(args.size());
+    args.push_back(nullptr); // InitGoogleTest() moves argv[argc] down too
+    testing::InitGoogleTest(&n, args.data());
+
+    auto* listener = new output_listener;
+    testing::UnitTest::GetInstance()->listeners().Append(listener);
+    const int status = RUN_ALL_TESTS();
+    // ctest runs the tests one at a time; only a whole run writes the file.
+    const std::string filter = testing::GTEST_FLAG(filter);
+    if (testing::GTEST_FLAG(list_tests) || (!filter.empty() && filter != "*"))
+        return status;
+    if (!listener->write(out)) {
+        std::fprintf(stderr, "yeni_test: cannot write %s\n", out);
+        return 1;
+    }
+    return status;
+}
@@ -0,0 +1,161 @@
+#include "stress.hpp"
+
+#include "yeni/arena.hpp"
+#include "yeni/block_cache.hpp"
+#include "yeni/epoch.hpp"
+#include "yeni/memory.hpp"
+#include "yeni/record_store.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct block {
+    std::byte* p;
+    std::size_t size;
+    std::size_t align;
+    std::byte fill;
+};
+
+block take(yeni::memory_provider& memory, std::mt19937_64& rng)
+{
+    // Mostly small, some over half a chunk to get mappings of their own.
+    const std::size_t size = rng() % 16 == 0 ? 1 + rng() % (3 << 20) : 1 + rng() % 5000;
+    const std::size_t align = std::size_t(1) << rng() % 13;
+    auto* p = static_cast<std::byte*>(memory.allocate(size, align));
+    const auto fill = std::byte(rng());
+    std::memset(p, int(fill), size);
+    return {p, size, align, fill};
+}
+
+bool intact(const block& b)
+{
+    return std::all_of(b.p, b.p + b.size, [&](std::byte x) { return x == b.fill; });
+}
+
+// Live blocks are aligned, never overlap and keep their bytes while others
+// come and go; for every page size, whether or not huge pages are reserved.
+TEST(memory, blocks_are_aligned_and_disjoint)
+{
+    for (const auto pages : {yeni::page_size::base, yeni::page_size::transparent, yeni::page_size::huge_2m,
+             yeni::page_size::huge_1g}) {
+        yeni::page_provider memory({.pages = pages});
+        std::mt19937_64 rng(static_cast<unsigned>(pages));
+        std::vector<block> live;
+        for (int i = 0; i < 4000; ++i) {
+            if (live.empty() || rng() % 3) {
+                live.push_back(take(memory, rng));
+                ASSERT_EQ(reinterpret_cast<std::uintptr_t>(live.back().p) % live.back().align, 0u);
+                continue;
+            }
+            const std::size_t j = rng() % live.size();
+            ASSERT_TRUE(intact(live[j])) << "size " << live[j].size;
+            memory.deallocate(live[j].p, live[j].size, live[j].align);
+            live[j] = live.back();
+            live.pop_back();
+        }
+        std::map<std::uintptr_t, std::size_t> ranges;
+        for (const block& b : live) {
+            ASSERT_TRUE(intact(b)) << "size " << b.size;
+            ranges.emplace(reinterpret_cast<std::uintptr_t>(b.p), b.size);
+        }
+        for (auto it = ranges.begin(); it != ranges.end() && std::next(it) != ranges.end(); ++it)
+            ASSERT_LE(it->first + it->second, std::next(it)->first);
+        for (const block& b : live)
+            memory.deallocate(b.p, b.size, b.align);
+    }
+}
+
+TEST(memory, freed_blocks_are_reused)
+{
+    yeni::page_provider memory;
+    void* a = memory.allocate(1000, 8);
+    memory.deallocate(a, 1000, 8);
+    EXPECT_EQ(memory.allocate(1000, 8), a);
+    const std::size_t chunks = memory.bytes_mapped();
+
+    // Large blocks are unmapped again.
+    void* big = memory.allocate(yeni::page_provider::chunk_bytes, 64);
+    EXPECT_GT(memory.bytes_mapped(), chunks);
+    memory.deallocate(big, yeni::page_provider::chunk_bytes, 64);
+    EXPECT_EQ(memory.bytes_mapped(), chunks);
+    EXPECT_THROW(memory.allocate(64, 8192), std::invalid_argument);
+}
+
+// Threads hand blocks to each other, so most are freed by a thread other
+// than the one that allocated them.
+TEST(memory, blocks_move_between_threads)
+{
+    yeni::page_provider memory({.pages = yeni::page_size::transparent});
+    std::mutex mutex;
+    std::vector<block> shared;
+    yeni::test::run_threads(yeni::test::stress_threads(), [&](unsigned t) {
+        std::mt19937_64 rng(t);
+        yeni::test::for_duration([&] {
+            block b = take(memory, rng);
+            {
+                std::lock_guard lock(mutex);
+                shared.push_back(b);
+                const std::size_t j = rng() % shared.size();
+                b = shared[j];
+                shared[j] = shared.back();
+                shared.pop_back();
+            }
+            ASSERT_TRUE(intact(b)) << "size " << b.size;
+            memory.deallocate(b.p, b.size, b.align);
+        });
+    });
+    for (const block& b : shared) {
+        EXPECT_TRUE(intact(b));
+        memory.deallocate(b.p, b.size, b.align);
+    }
+}
+
+// The arenas and index of a record store and the blocks of a cache all
+// draw from the provider they are given.
+TEST(memory, stores_and_caches_use_the_provider)
+{
+    yeni::page_provider memory;
+    {
+        yeni::record_store store(yeni::arena::default_block_size, memory);
+        for (std::uint64_t k = 0; k < 20000; ++k)
+            store.append(k, std::as_bytes(std::span(&k, 1)));
+        for (std::uint64_t k = 0; k < 20000; ++k) {
+            const yeni::record* r = store.find(k);
+            ASSERT_TRUE(r);
+            ASSERT_EQ(std::memcmp(r->value().data(), &k, sizeof(k)), 0);
+        }
+        EXPECT_GE(memory.bytes_mapped(), store.bytes_reserved());
+        store.reset();
+        yeni::epoch::synchronize();
+    }
+    const std::size_t mapped = memory.bytes_mapped();
+    {
+        yeni::block_cache cache({.capacity_bytes = 1 << 20, .shards = 1, .block_bytes = 4096, .memory = &memory});
+        for (std::uint64_t k = 0; k < 1000; ++k) {
+            const auto h = cache.get({3, k}, 4096, [&](std::span<std::byte> out) {
+                std::memset(out.data(), int(k % 251), out.size());
+            });
+            ASSERT_EQ(h.data()[4095], std::byte(k % 251));
+        }
+        // Bigger than the cache, handed out uncached.
+        const auto h = cache.get({3, 5000}, 2 << 20, [](std::span<std::byte> out) {
+            std::memset(out.data(), 1, out.size());
+        });
+        EXPECT_FALSE(h.cached());
+        EXPECT_GT(memory.bytes_mapped(), mapped);
+    }
+    EXPECT_EQ(memory.bytes_mapped(), mapped);
+}
+
+} // namespace
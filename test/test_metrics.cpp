@@ -0,0 +1,137 @@
+#include "stress.hpp"
+
+#include "yeni/metrics.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using yeni::metrics::counter;
+using yeni::metrics::histogram;
+using yeni::metrics::histogram_layout;
+
+yeni::metrics::snapshot sample_snapshot()
+{
+    yeni::metrics::snapshot s;
+    for (auto& h : s.histograms)
+        h.buckets.assign(histogram_layout::buckets, 0);
+    s.counters[std::size_t(counter::inserts)] = 7;
+    auto& lookup = s.histograms[std::size_t(histogram::lookup)];
+    for (const std::uint64_t ns : {1u, 1000u, 2500u}) {
+        ++lookup.buckets[histogram_layout::bucket_of(ns)];
+        ++lookup.count;
+        lookup.sum += ns;
+        lookup.max = ns;
+    }
+    return s;
+}
+
+bool has_line(const std::string& text, const std::string& line)
+{
+    return text.find("\n" + line + "\n") != std::string::npos || text.starts_with(line + "\n");
+}
+
+// The full response to `GET <target>` from a server on localhost.
+std::string http_get(std::uint16_t port, const std::string& target)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    std::string out;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        const std::string req = "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::send(fd, req.data(), req.size(), 0);
+        char buf[4096];
+        for (ssize_t n; (n = ::recv(fd, buf, sizeof(buf), 0)) > 0;)
+            out.append(buf, std::size_t(n));
+    }
+    ::close(fd);
+    return out;
+}
+
+// Counters are exported as yeni_<name>_total and histograms with
+// cumulative buckets at every power of two of nanoseconds, in seconds.
+TEST(metrics, prometheus_text_follows_the_exposition_format)
+{
+    const std::string text = yeni::metrics::prometheus_text(sample_snapshot());
+    EXPECT_TRUE(has_line(text, "# TYPE yeni_inserts_total counter"));
+    EXPECT_TRUE(has_line(text, "yeni_inserts_total 7"));
+    EXPECT_TRUE(has_line(text, "yeni_lookups_total 0"));
+    for (std::size_t c = 0; c < yeni::metrics::counter_count; ++c) {
+        const std::string name = "yeni_" + std::string(yeni::metrics::name(counter(c))) + "_total";
+        EXPECT_TRUE(has_line(text, "# TYPE " + name + " counter")) << name;
+    }
+
+    EXPECT_TRUE(has_line(text, "# TYPE yeni_lookup_latency_seconds histogram"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"1e-09\"} 0"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"2e-09\"} 1"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"5.12e-07\"} 1"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"1.024e-06\"} 2"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"2.048e-06\"} 2"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"4.096e-06\"} 3"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_bucket{le=\"+Inf\"} 3"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_sum 3.501e-06"));
+    EXPECT_TRUE(has_line(text, "yeni_lookup_latency_seconds_count 3"));
+
+    // One bucket per power of two up to the last, then +Inf; never falling.
+    std::istringstream lines(text);
+    std::size_t buckets = 0;
+    std::uint64_t last = 0;
+    for (std::string line; std::getline(lines, line);) {
+        if (!line.starts_with("yeni_insert_latency_seconds_bucket")
+            && !line.starts_with("yeni_lookup_latency_seconds_bucket"))
+            continue;
+        const std::uint64_t v = std::stoull(line.substr(line.rfind(' ') + 1));
+        if (line.find("le=\"1e-09\"") != std::string::npos)
+            last = 0;
+        EXPECT_GE(v, last) << line;
+        last = v;
+        ++buckets;
+    }
+    EXPECT_EQ(buckets, 2 * (histogram_layout::max_exponent + 2));
+}
+
+// The textfile export lands whole under its name; the HTTP endpoint
+// serves the same text, and 404 for anything else.
+TEST(metrics, exports_through_a_file_and_http)
+{
+    yeni::metrics::local().add(counter::flushes, 3);
+    if (yeni::metrics::enabled) {
+        EXPECT_GE(yeni::metrics::collect()[counter::flushes], 3u);
+    }
+
+    const yeni::test::scratch_dir dir("metrics");
+    yeni::metrics::write_prometheus(dir / "yeni.prom");
+    EXPECT_FALSE(std::filesystem::exists(dir / "yeni.prom.tmp"));
+    std::ifstream in(dir / "yeni.prom");
+    const std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(file.starts_with("# TYPE yeni_inserts_total counter\n"));
+    EXPECT_TRUE(has_line(file, "# TYPE yeni_queue_delay_latency_seconds histogram"));
+
+    const yeni::metrics::http_server server;
+    ASSERT_NE(server.port(), 0);
+    const std::string ok = http_get(server.port(), "/metrics");
+    EXPECT_TRUE(ok.starts_with("HTTP/1.1 200 OK\r\n"));
+    EXPECT_NE(ok.find("Content-Type: text/plain; version=0.0.4\r\n"), std::string::npos);
+    const std::size_t body = ok.find("\r\n\r\n");
+    ASSERT_NE(body, std::string::npos);
+    EXPECT_TRUE(ok.substr(body + 4).starts_with("# TYPE yeni_inserts_total counter\n"));
+    EXPECT_NE(ok.find("Content-Length: " + std::to_string(ok.size() - body - 4) + "\r\n"), std::string::npos);
+    EXPECT_TRUE(http_get(server.port(), "/nope").starts_with("HTTP/1.1 404 Not Found\r\n"));
+}
+
+} // namespace
@@ -0,0 +1,177 @@
+#include "stress.hpp"
+
+#include "yeni/mpsc_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using yeni::test::history_entry;
+
+struct queue_op {
+    bool push = false;
+    int value = 0;
+};
+
+struct queue_result {
+    bool ok = false;
+    int value = 0;
+};
+
+using queue_entry = history_entry<queue_op, queue_result>;
+
+// Bounded FIFO. Only pops that returned an item are checked against it: a
+// pop can miss the item of a producer that has claimed its slot but not
+// yet published it even when a later push has completed, which no
+// sequential queue explains, so empty pops are left out of the history.
+struct fifo_model {
+    std::size_t capacity = 0;
+    std::vector<int> items;
+
+    bool operator==(const fifo_model&) const = default;
+
+    std::size_t hash() const noexcept
+    {
+        std::size_t h = items.size();
+        for (const int v : items)
+            h = h * 1000003 ^ std::size_t(v);
+        return h;
+    }
+
+    bool step(const queue_entry& e)
+    {
+        if (e.op.push) {
+            const bool room = items.size() < capacity;
+            if (room)
+                items.push_back(e.op.value);
+            return room == e.result.ok;
+        }
+        if (items.empty() || items.front() != e.result.value)
+            return false;
+        items.erase(items.begin());
+        return true;
+    }
+};
+
+TEST(mpsc_queue, histories_are_linearizable)
+{
+    constexpr unsigned producers = 3;
+    constexpr int pushes = 5;
+    std::size_t checked = 0;
+    yeni::test::for_duration([&] {
+        yeni::mpsc_queue<int> q(4);
+        yeni::test::history<queue_entry> h;
+        yeni::test::run_threads(producers + 1, [&](unsigned t) {
+            if (t == producers) {
+                for (int i = 0; i < int(producers) * pushes; ++i) {
+                    queue_entry e;
+                    e.call = yeni::test::now_ns();
+                    int v = 0;
+                    e.result.ok = q.try_pop(v);
+                    e.ret = yeni::test::now_ns();
+                    e.result.value = v;
+                    if (e.result.ok)
+                        h.add(e);
+                }
+                return;
+            }
+            for (int i = 0; i < pushes; ++i) {
+                queue_entry e;
+                e.op = {true, int(t) * 100 + i};
+                e.call = yeni::test::now_ns();
+                e.result.ok = q.try_push(e.op.value);
+                e.ret = yeni::test::now_ns();
+                h.add(e);
+            }
+        });
+        for (int v = 0;;) {
+            queue_entry e;
+            e.call = yeni::test::now_ns();
+            if (!q.try_pop(v))
+                break;
+            e.ret = yeni::test::now_ns();
+            e.result = {true, v};
+            h.add(e);
+        }
+        const std::vector<queue_entry> entries = h.take();
+        ASSERT_TRUE(yeni::test::linearizable(std::span<const queue_entry>(entries), fifo_model{q.capacity(), {}}));
+        ++checked;
+    });
+    RecordProperty("histories", int(checked));
+}
+
+TEST(mpsc_queue, blocking_producers_keep_order_and_lose_nothing)
+{
+    struct item {
+        std::uint32_t producer = 0;
+        std::uint32_t n = 0;
+    };
+    const unsigned producers = yeni::test::stress_threads() - 1;
+    yeni::mpsc_queue<item> q(8);
+    std::vector<std::uint32_t> pushed(producers), next(producers);
+    bool ordered = true;
+    std::thread consumer([&] {
+        item batch[16];
+        while (const std::size_t n = q.pop_batch(batch)) {
+            for (std::size_t i = 0; i < n; ++i)
+                ordered &= batch[i].n == next[batch[i].producer]++;
+        }
+    });
+    const auto deadline = std::chrono::steady_clock::now() + yeni::test::stress_duration();
+    yeni::test::run_threads(producers, [&](unsigned p) {
+        std::uint32_t n = 0;
+        while (std::chrono::steady_clock::now() < deadline)
+            EXPECT_TRUE(q.push({p, n++}));
+        pushed[p] = n;
+    });
+    q.close();
+    consumer.join();
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(next, pushed);
+    EXPECT_FALSE(q.push({0, 0}));
+}
+
+TEST(mpsc_queue, batches_arrive_whole_and_in_order)
+{
+    const unsigned producers = yeni::test::stress_threads() - 1;
+    yeni::mpsc_queue<yeni::handoff_batch<std::uint64_t>> q(4);
+    std::vector<std::uint64_t> pushed(producers), next(producers);
+    bool ordered = true;
+    std::thread consumer([&] {
+        while (yeni::consume_batches(q, [&](std::uint64_t v) { ordered &= (v & 0xffffffff) == next[v >> 32]++; }))
+            ;
+    });
+    const auto deadline = std::chrono::steady_clock::now() + yeni::test::stress_duration();
+    yeni::test::run_threads(producers, [&](unsigned p) {
+        yeni::batching_producer<std::uint64_t> out(q);
+        std::uint64_t n = 0;
+        while (std::chrono::steady_clock::now() < deadline) {
+            // Odd-sized bursts leave partial batches for flush().
+            for (int i = int(n % 7); i >= 0; --i)
+                EXPECT_TRUE(out.push(std::uint64_t(p) << 32 | n++));
+            EXPECT_TRUE(out.flush());
+        }
+        pushed[p] = n;
+    });
+    q.close();
+    consumer.join();
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(next, pushed);
+}
+
+TEST(mpsc_queue, pop_times_out_when_empty)
+{
+    yeni::mpsc_queue<int> q(2);
+    int v[1];
+    const auto t0 = std::chrono::steady_clock::now();
+    EXPECT_EQ(q.pop_batch(v, std::chrono::milliseconds(20)), 0u);
+    EXPECT_GE(std::chrono::steady_clock::now() - t0, std::chrono::milliseconds(20));
+}
+
+} // namespace
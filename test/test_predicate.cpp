@@ -0,0 +1,155 @@
+#include "yeni/predicate.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr yeni::simd_level levels[] = {yeni::simd_level::scalar, yeni::simd_level::avx2, yeni::simd_level::avx512};
+constexpr yeni::compare_op ops[] = {yeni::compare_op::eq, yeni::compare_op::ne, yeni::compare_op::lt,
+    yeni::compare_op::le, yeni::compare_op::gt, yeni::compare_op::ge};
+// Whole words, a partial last word, and vectors with a ragged tail.
+constexpr std::size_t row_counts[] = {0, 1, 7, 63, 64, 65, 200, 1027};
+
+// Restores the level the process started with.
+class simd_level_guard {
+public:
+    ~simd_level_guard() { yeni::set_simd_level(saved_); }
+
+private:
+    yeni::simd_level saved_ = yeni::active_simd_level();
+};
+
+template <class T>
+bool compares(yeni::compare_op op, T a, T b)
+{
+    switch (op) {
+    case yeni::compare_op::eq:
+        return a == b;
+    case yeni::compare_op::ne:
+        return a != b;
+    case yeni::compare_op::lt:
+        return a < b;
+    case yeni::compare_op::le:
+        return a <= b;
+    case yeni::compare_op::gt:
+        return a > b;
+    default:
+        return a >= b;
+    }
+}
+
+// Values at the edges of each type: sign bits of unsigned words, the
+// extremes, and for doubles NaN, signed zeros and infinities.
+template <class T>
+std::vector<T> edge_values()
+{
+    using lim = std::numeric_limits<T>;
+    std::vector<T> v = {T(0), T(1), lim::max(), lim::min(), lim::lowest(), T(lim::max() / 2)};
+    if constexpr (std::is_unsigned_v<T>)
+        v.push_back(T(lim::max() / 2 + 1)); // only the sign bit
+    if constexpr (std::is_signed_v<T>)
+        v.push_back(T(-1));
+    if constexpr (std::is_floating_point_v<T>)
+        v.insert(v.end(), {lim::quiet_NaN(), -0.0, lim::infinity(), -lim::infinity(), lim::denorm_min(), -2.5});
+    return v;
+}
+
+template <class T>
+std::vector<T> column_of(std::size_t rows, std::uint64_t seed)
+{
+    const std::vector<T> edges = edge_values<T>();
+    std::mt19937_64 rng(seed);
+    std::vector<T> column(rows);
+    for (auto& x : column) {
+        if (rng() % 2)
+            x = edges[rng() % edges.size()];
+        else if constexpr (std::is_floating_point_v<T>)
+            x = T(std::int64_t(rng() % 41) - 20) / 4;
+        else
+            x = T(rng() % 41);
+    }
+    return column;
+}
+
+// Bits for `rows` rows as `pass(x)` says, with nothing set past the end.
+template <class T, class Pass>
+void expect_rows(const std::vector<T>& column, const std::uint64_t* words, Pass&& pass)
+{
+    for (std::size_t w = 0; w < (column.size() + 63) / 64; ++w) {
+        std::uint64_t want = 0;
+        for (std::size_t i = w * 64; i < std::min(column.size(), w * 64 + 64); ++i)
+            want |= std::uint64_t(pass(column[i])) << (i % 64);
+        ASSERT_EQ(words[w], want) << "word " << w;
+    }
+}
+
+template <class T>
+void check_kernels()
+{
+    SCOPED_TRACE(sizeof(T) == 4 ? "u32" : std::is_floating_point_v<T> ? "f64" : std::is_signed_v<T> ? "i64" : "u64");
+    const std::vector<T> needles = edge_values<T>();
+    for (const std::size_t rows : row_counts) {
+        SCOPED_TRACE(testing::Message() << rows << " rows");
+        const std::vector<T> column = column_of<T>(rows, rows);
+        // Poisoned, so a kernel that skips a word or leaves tail bits shows.
+        std::vector<std::uint64_t> words((rows + 63) / 64 + 1, 0xa5a5a5a5a5a5a5a5);
+        for (const auto op : ops) {
+            for (const T v : needles) {
+                SCOPED_TRACE(testing::Message() << "op " << int(op) << " value " << v);
+                yeni::compare_rows<T>(column, op, v, words.data());
+                expect_rows(column, words.data(), [&](T x) { return compares(op, x, v); });
+                EXPECT_EQ(words.back(), 0xa5a5a5a5a5a5a5a5u);
+
+                yeni::selection_bitmap bits;
+                yeni::filter_compare<T>(column, op, v, bits);
+                ASSERT_EQ(bits.size(), rows);
+                expect_rows(column, bits.words().data(), [&](T x) { return compares(op, x, v); });
+            }
+        }
+        for (const T lo : needles) {
+            for (const T hi : needles) {
+                SCOPED_TRACE(testing::Message() << "range " << lo << ".." << hi);
+                yeni::range_rows<T>(column, lo, hi, words.data());
+                expect_rows(column, words.data(), [&](T x) { return lo <= x && x <= hi; });
+            }
+        }
+        // A list short enough for broadcasts, and one probed sorted.
+        std::vector<T> in = needles;
+        yeni::selection_bitmap bits;
+        for (const std::size_t extra : {std::size_t(0), std::size_t(64)}) {
+            for (std::size_t i = 0; i < extra; ++i)
+                in.push_back(T(100 + i));
+            yeni::filter_in<T>(column, in, bits);
+            expect_rows(
+                column, bits.words().data(), [&](T x) { return std::find(in.begin(), in.end(), x) != in.end(); });
+        }
+    }
+}
+
+// Every kernel level gives what C++ compares give, per type and operator:
+// NaN passes only ne, unsigned words with the sign bit set are large, and
+// the rows of a last partial vector or word are neither dropped nor
+// invented.
+TEST(predicate, kernels_agree_with_scalar_compares)
+{
+    const simd_level_guard restore;
+    for (const auto level : levels) {
+        yeni::set_simd_level(level);
+        if (yeni::active_simd_level() != level)
+            continue; // not on this CPU
+        SCOPED_TRACE(yeni::to_string(level));
+        check_kernels<std::uint32_t>();
+        check_kernels<std::uint64_t>();
+        check_kernels<std::int64_t>();
+        check_kernels<double>();
+    }
+}
+
+} // namespace
@@ -0,0 +1,236 @@
+#include "stress.hpp"
+
+#include "yeni/epoch.hpp"
+#include "yeni/record_store.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using yeni::test::history_entry;
+
+std::span<const std::byte> as_bytes(const std::uint64_t& v)
+{
+    return {reinterpret_cast<const std::byte*>(&v), sizeof(v)};
+}
+
+std::uint64_t value_of(const yeni::record* r)
+{
+    std::uint64_t v;
+    std::memcpy(&v, r->value().data(), sizeof(v));
+    return v;
+}
+
+struct register_op {
+    bool write = false;
+    std::uint64_t value = 0;
+};
+
+// Value read, 0 for none.
+struct register_result {
+    std::uint64_t value = 0;
+};
+
+using register_entry = history_entry<register_op, register_result>;
+
+// The newest value of one key; values are never 0.
+struct register_model {
+    std::uint64_t value = 0;
+
+    bool operator==(const register_model&) const = default;
+    std::size_t hash() const noexcept { return std::size_t(value); }
+
+    bool step(const register_entry& e)
+    {
+        if (e.op.write) {
+            value = e.op.value;
+            return true;
+        }
+        return e.result.value == value;
+    }
+};
+
+// Appends and lookups, single and batched, on a handful of keys. Batched
+// calls are not atomic across keys, so each key's history is checked on
+// its own; linearizability composes, so that is all a caller can rely on.
+TEST(record_store, index_histories_are_linearizable)
+{
+    constexpr std::uint64_t keys = 3;
+    constexpr int ops_per_thread = 8;
+    std::size_t checked = 0;
+    yeni::test::for_duration([&] {
+        yeni::record_store store;
+        yeni::test::history<register_entry> h[keys];
+        yeni::test::run_threads(4, [&](unsigned t) {
+            std::uint64_t seq = 0;
+            for (int i = 0; i < ops_per_thread; ++i) {
+                const std::uint64_t k = (t + std::uint64_t(i)) % keys, k2 = (k + 1) % keys;
+                const std::uint64_t v = std::uint64_t(t + 1) << 32 | ++seq, v2 = v | std::uint64_t(1) << 31;
+                register_entry e, e2;
+                switch ((t * 3 + unsigned(i)) % 4) {
+                case 0:
+                    e.op = {true, v};
+                    e.call = yeni::test::now_ns();
+                    store.append(k, as_bytes(v));
+                    e.ret = yeni::test::now_ns();
+                    h[k].add(e);
+                    break;
+                case 1: {
+                    const std::uint64_t ks[2] = {k, k2};
+                    const std::span<const std::byte> vs[2] = {as_bytes(v), as_bytes(v2)};
+                    e.op = {true, v};
+                    e2.op = {true, v2};
+                    e.call = e2.call = yeni::test::now_ns();
+                    store.append_many(ks, vs);
+                    e.ret = e2.ret = yeni::test::now_ns();
+                    h[k].add(e);
+                    h[k2].add(e2);
+                    break;
+                }
+                case 2: {
+                    e.call = yeni::test::now_ns();
+                    const yeni::record* r = store.find(k);
+                    e.ret = yeni::test::now_ns();
+                    e.result.value = r ? value_of(r) : 0;
+                    h[k].add(e);
+                    break;
+                }
+                default: {
+                    const std::uint64_t ks[2] = {k, k2};
+                    const yeni::record* rs[2];
+                    e.call = e2.call = yeni::test::now_ns();
+                    store.find_many(ks, rs);
+                    e.ret = e2.ret = yeni::test::now_ns();
+                    e.result.value = rs[0] ? value_of(rs[0]) : 0;
+                    e2.result.value = rs[1] ? value_of(rs[1]) : 0;
+                    h[k].add(e);
+                    h[k2].add(e2);
+                    break;
+                }
+                }
+            }
+        });
+        for (std::uint64_t k = 0; k < keys; ++k) {
+            const std::vector<register_entry> entries = h[k].take();
+            ASSERT_TRUE(yeni::test::linearizable(std::span<const register_entry>(entries), register_model{}))
+                << "key " << k;
+        }
+        ++checked;
+    });
+    RecordProperty("rounds", int(checked));
+}
+
+// A pinned sequence number reads the same store however many appends
+// land after it, through find_at() and for_each_at() alike.
+TEST(record_store, snapshots_do_not_move)
+{
+    constexpr std::uint64_t keys = 500;
+    yeni::record_store store;
+    std::atomic<bool> stop{false};
+    std::size_t snapshots = 0;
+    yeni::test::run_threads(yeni::test::stress_threads(), [&](unsigned t) {
+        if (t > 0) {
+            std::vector<std::uint64_t> ks(16), vs(16);
+            std::vector<std::span<const std::byte>> values(16);
+            for (std::uint64_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                if (i % 2) {
+                    store.append((i * t) % keys, as_bytes(i));
+                    continue;
+                }
+                for (std::size_t j = 0; j < ks.size(); ++j) {
+                    ks[j] = (i + j) % keys;
+                    vs[j] = i;
+                    values[j] = as_bytes(vs[j]);
+                }
+                store.append_many(ks, values);
+            }
+            return;
+        }
+        struct stopper {
+            std::atomic<bool>& stop;
+            ~stopper() { stop.store(true); }
+        } stop_writers{stop};
+        yeni::test::for_duration([&] {
+            const yeni::epoch::guard pin;
+            const std::uint64_t seq = store.sequence();
+            std::map<std::uint64_t, std::uint64_t> first, second;
+            store.for_each_at(seq, [&](const yeni::record& r) {
+                EXPECT_LE(r.seq, seq);
+                first[r.key] = r.seq;
+            });
+            std::this_thread::yield();
+            store.for_each_at(seq, [&](const yeni::record& r) { second[r.key] = r.seq; });
+            ASSERT_EQ(first, second);
+            for (const auto& [key, s] : first) {
+                const yeni::record* r = store.find_at(key, seq);
+                ASSERT_TRUE(r);
+                ASSERT_EQ(r->seq, s);
+            }
+            ++snapshots;
+        });
+    });
+    RecordProperty("snapshots", int(snapshots));
+}
+
+// Records found under a guard survive reset() until the guard goes; the
+// arenas are only reused after that.
+TEST(record_store, reset_waits_for_guards)
+{
+    yeni::record_store store;
+    for (std::uint64_t k = 0; k < 1000; ++k)
+        store.append(k, as_bytes(k));
+    std::atomic<bool> found{false}, release{false};
+    std::thread reader([&] {
+        const yeni::epoch::guard pin;
+        const yeni::record* r = store.find(7);
+        found.store(true);
+        while (!release.load())
+            std::this_thread::yield();
+        EXPECT_EQ(value_of(r), 7u);
+    });
+    while (!found.load())
+        std::this_thread::yield();
+    store.reset();
+    for (std::uint64_t k = 0; k < 1000; ++k)
+        store.append(k, as_bytes(k));
+    store.reset();
+    EXPECT_GT(yeni::epoch::pending(), 0u);
+    release.store(true);
+    reader.join();
+    yeni::epoch::synchronize();
+    EXPECT_EQ(store.find(7), nullptr);
+    EXPECT_EQ(store.size(), 0u);
+}
+
+// A thread appending round-robin to more stores than it caches keeps
+// going back to the shard it has in each, rather than starting new ones.
+TEST(record_store, more_stores_than_cached_reuse_their_shard)
+{
+    std::vector<std::unique_ptr<yeni::record_store>> stores(12);
+    for (auto& s : stores)
+        s = std::make_unique<yeni::record_store>();
+    std::vector<std::size_t> reserved;
+    for (std::uint64_t k = 0; k < 200; ++k) {
+        for (auto& s : stores)
+            s->append(k, as_bytes(k));
+        if (k == 0)
+            for (const auto& s : stores)
+                reserved.push_back(s->bytes_reserved());
+    }
+    for (std::size_t i = 0; i < stores.size(); ++i) {
+        EXPECT_EQ(stores[i]->bytes_reserved(), reserved[i]);
+        EXPECT_EQ(stores[i]->size(), 200u);
+        EXPECT_EQ(value_of(stores[i]->find(199)), 199u);
+    }
+}
+
+} // namespace
@@ -0,0 +1,156 @@
+#include "stress.hpp"
+
+#include "yeni/replication.hpp"
+#include "yeni/wal.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+struct tag {
+    std::uint32_t thread;
+    std::uint32_t n;
+};
+
+std::uint64_t key_of(std::span<const std::byte> payload)
+{
+    tag t;
+    std::memcpy(&t, payload.data(), sizeof(t));
+    return t.thread;
+}
+
+// What a follower builds from the stream: the sequence numbers seen per
+// appending thread, which must arrive in order.
+struct state {
+    std::mutex mutex;
+    std::map<std::uint32_t, std::uint32_t> next;
+    bool in_order = true;
+
+    void apply(std::span<const yeni::wal_entry> records)
+    {
+        std::lock_guard lock(mutex);
+        for (const auto& e : records) {
+            tag t;
+            std::memcpy(&t, e.payload.data(), sizeof(t));
+            in_order = in_order && t.n == next[t.thread];
+            next[t.thread] = t.n + 1;
+        }
+    }
+};
+
+std::vector<std::pair<std::uint64_t, std::vector<std::byte>>> read_log(const std::filesystem::path& dir)
+{
+    std::vector<std::pair<std::uint64_t, std::vector<std::byte>>> out;
+    yeni::wal_reader reader(dir);
+    yeni::wal_entry e;
+    while (reader.next(e))
+        out.emplace_back(e.lsn, std::vector<std::byte>(e.payload.begin(), e.payload.end()));
+    return out;
+}
+
+// Two followers with logs of their own follow concurrent appenders across
+// segment rolls: each applies every record once, per key in order, and
+// ends up with a byte-for-byte copy of the leader's log.
+TEST(replication, followers_copy_the_log_and_apply_in_key_order)
+{
+    const yeni::test::scratch_dir dir("replication");
+    const auto leader_dir = dir.path() / "leader";
+    const unsigned threads = yeni::test::stress_threads();
+    std::vector<std::uint32_t> appended(threads);
+    std::uint64_t last = 0;
+    {
+        yeni::wal log(leader_dir, {.segment_size = 256 << 10, .sync = false});
+        yeni::replication_leader leader(log, {.max_batch_bytes = 32 << 10, .max_inflight_bytes = 128 << 10});
+        state states[2];
+        std::unique_ptr<yeni::wal> logs[2];
+        std::unique_ptr<yeni::replication_follower> followers[2];
+        for (int i = 0; i < 2; ++i) {
+            logs[i] = std::make_unique<yeni::wal>(dir.path() / std::to_string(i),
+                yeni::wal_options{.segment_size = 256 << 10, .sync = false});
+            followers[i] = std::make_unique<yeni::replication_follower>(yeni::replication_follower_options{
+                .port = leader.port(),
+                .log = logs[i].get(),
+                .partitions = 4,
+                .key_of = key_of,
+                .apply = [&s = states[i]](unsigned, std::span<const yeni::wal_entry> r) { s.apply(r); },
+            });
+        }
+
+        yeni::test::run_threads(threads, [&](unsigned t) {
+            std::vector<std::byte> payload;
+            std::uint32_t n = 0;
+            yeni::test::for_duration([&] {
+                payload.assign(sizeof(tag) + n % 200, std::byte(t));
+                const tag tg{t, n++};
+                std::memcpy(payload.data(), &tg, sizeof(tg));
+                log.append(payload);
+            });
+            appended[t] = n;
+        });
+        last = log.next_lsn() - 1;
+        ASSERT_TRUE(leader.wait_replicated(last, 2, 30s));
+        EXPECT_EQ(leader.followers(), 2u);
+        EXPECT_EQ(leader.replicated_lsn(3), 0u);
+        for (int i = 0; i < 2; ++i) {
+            ASSERT_TRUE(followers[i]->wait_applied(last, 1s));
+            EXPECT_EQ(followers[i]->applied_lsn(), last);
+            EXPECT_TRUE(states[i].in_order);
+            for (unsigned t = 0; t < threads; ++t)
+                EXPECT_EQ(states[i].next[t], appended[t]);
+        }
+    }
+    const auto expected = read_log(leader_dir);
+    ASSERT_EQ(expected.size(), last);
+    for (int i = 0; i < 2; ++i)
+        EXPECT_EQ(read_log(dir.path() / std::to_string(i)), expected);
+}
+
+// A follower that restarts on its log picks up where it left off, and one
+// without a log can start anywhere the leader still has.
+TEST(replication, followers_resume_from_their_log)
+{
+    const yeni::test::scratch_dir dir("replication");
+    yeni::wal log(dir.path() / "leader", {.segment_size = 64 << 10, .sync = false});
+    yeni::replication_leader leader(log);
+    const std::vector<std::byte> payload(40, std::byte{3});
+    std::vector<std::uint64_t> applied;
+    std::mutex mutex;
+    const auto record = [&](unsigned, std::span<const yeni::wal_entry> r) {
+        std::lock_guard lock(mutex);
+        for (const auto& e : r)
+            applied.push_back(e.lsn);
+    };
+
+    for (int round = 0; round < 3; ++round) {
+        yeni::wal local(dir.path() / "follower", {.segment_size = 64 << 10, .sync = false});
+        ASSERT_EQ(local.next_lsn(), std::uint64_t(round) * 1000 + 1);
+        yeni::replication_follower follower({.port = leader.port(), .log = &local, .key_of = {}, .apply = record});
+        std::uint64_t lsn = 0;
+        for (int i = 0; i < 1000; ++i)
+            lsn = log.append_nowait(payload);
+        ASSERT_TRUE(follower.wait_applied(lsn, 30s));
+    }
+    ASSERT_EQ(applied.size(), 3000u);
+    for (std::size_t i = 0; i < applied.size(); ++i)
+        ASSERT_EQ(applied[i], i + 1);
+
+    applied.clear();
+    {
+        yeni::replication_follower follower({.port = leader.port(), .from_lsn = 2500, .key_of = {}, .apply = record});
+        ASSERT_TRUE(follower.wait_applied(3000, 30s));
+        EXPECT_TRUE(leader.wait_replicated(3000, 1, 30s));
+    }
+    ASSERT_EQ(applied.size(), 501u);
+    EXPECT_EQ(applied.front(), 2500u);
+}
+
+} // namespace
@@ -0,0 +1,111 @@
+#include "stress.hpp"
+
+#include "yeni/numa.hpp"
+#include "yeni/scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Every index is visited exactly once, whatever the grain, also when the
+// loops are nested and started from several threads at once.
+TEST(scheduler, parallel_for_covers_each_index_once)
+{
+    yeni::scheduler sched({.threads = 3, .pin_workers = false});
+    constexpr std::size_t n = 10000;
+    yeni::test::for_duration([&] {
+        yeni::test::run_threads(3, [&](unsigned t) {
+            auto hits = std::make_unique<std::atomic<std::uint8_t>[]>(n);
+            sched.parallel_for(0, n / 100, t, [&](std::size_t b, std::size_t e) {
+                for (std::size_t i = b; i < e; ++i)
+                    sched.parallel_for(i * 100, i * 100 + 100, 7, [&](std::size_t ib, std::size_t ie) {
+                        for (std::size_t j = ib; j < ie; ++j)
+                            hits[j].fetch_add(1, std::memory_order_relaxed);
+                    });
+            });
+            for (std::size_t i = 0; i < n; ++i)
+                ASSERT_EQ(hits[i].load(), 1) << "index " << i;
+        });
+    });
+}
+
+TEST(scheduler, parallel_reduce_is_deterministic)
+{
+    yeni::scheduler sched({.threads = 3, .pin_workers = false});
+    // Floating point addition does not associate, so only a fixed fold
+    // order gives the same sum every time.
+    const auto sum = [&] {
+        return sched.parallel_reduce(
+            0, 100000, 64, 0.0,
+            [](std::size_t b, std::size_t e) {
+                double s = 0;
+                for (std::size_t i = b; i < e; ++i)
+                    s += 1.0 / double(i + 1);
+                return s;
+            },
+            [](double a, double b) { return a + b; });
+    };
+    const double first = sum();
+    yeni::test::for_duration([&] { ASSERT_EQ(sum(), first); });
+}
+
+TEST(scheduler, exceptions_reach_the_caller)
+{
+    yeni::scheduler sched({.threads = 2, .pin_workers = false});
+    std::atomic<int> ran{0};
+    EXPECT_THROW(sched.parallel_for(0, 1000, 1,
+                     [&](std::size_t b, std::size_t) {
+                         ran.fetch_add(1);
+                         if (b == 500)
+                             throw std::runtime_error("chunk failed");
+                     }),
+        std::runtime_error);
+    EXPECT_GT(ran.load(), 0);
+
+    yeni::task_group g(sched);
+    for (int i = 0; i < 100; ++i)
+        g.run([i] {
+            if (i == 42)
+                throw std::logic_error("task failed");
+        });
+    EXPECT_THROW(g.wait(), std::logic_error);
+}
+
+// Tasks spawned from tasks all run before wait() returns.
+TEST(scheduler, task_groups_wait_for_nested_work)
+{
+    yeni::scheduler sched({.threads = 3, .pin_workers = false});
+    yeni::test::for_duration([&] {
+        std::atomic<int> leaves{0};
+        yeni::task_group outer(sched);
+        for (int i = 0; i < 16; ++i)
+            outer.run([&] {
+                yeni::task_group inner(sched);
+                for (int j = 0; j < 16; ++j)
+                    inner.run([&] { leaves.fetch_add(1); });
+                inner.wait();
+            });
+        outer.wait();
+        ASSERT_EQ(leaves.load(), 256);
+    });
+}
+
+// sysfs cpulists parse to their CPUs; items that are malformed or name a
+// CPU no cpu_set_t can hold are skipped, however large the range.
+TEST(scheduler, cpulists_skip_what_they_cannot_hold)
+{
+    using v = std::vector<unsigned>;
+    EXPECT_EQ(yeni::numa_topology::parse_cpulist("0-3,8,10-11\n"), (v{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(yeni::numa_topology::parse_cpulist("x,2-y,5"), v{5});
+    EXPECT_EQ(yeni::numa_topology::parse_cpulist("1,4-4294967295"), v{1});
+    EXPECT_EQ(yeni::numa_topology::parse_cpulist("4294967295,2"), v{2});
+    EXPECT_EQ(yeni::numa_topology::parse_cpulist("0-99999999"), v{});
+}
+
+} // namespace
@@ -0,0 +1,126 @@
+#include "stress.hpp"
+
+#include "yeni/schema.hpp"
+#include "yeni/segment.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using bytes = std::span<const std::byte>;
+
+bytes as_bytes(const std::string& s)
+{
+    return {reinterpret_cast<const std::byte*>(s.data()), s.size()};
+}
+
+std::string as_string(bytes b)
+{
+    return {reinterpret_cast<const char*>(b.data()), b.size()};
+}
+
+using people = yeni::static_schema<yeni::field<"q", std::uint32_t>, yeni::field<"name", bytes>,
+    yeni::field<"id", std::uint64_t>, yeni::field<"x", double>, yeni::field<"tag", bytes>,
+    yeni::field<"n", std::int64_t>>;
+
+// Fields are laid out widest first, then in declaration order.
+static_assert(people::fixed_size == 4 + 16 + 24);
+static_assert(people::offsets[2] == 0 && people::offsets[3] == 8 && people::offsets[5] == 16 &&
+    people::offsets[1] == 24 && people::offsets[4] == 32 && people::offsets[0] == 40);
+static_assert(people::index_of<"tag"> == 4);
+
+TEST(schema, static_and_dynamic_schemas_agree)
+{
+    const std::string alice = "alice", empty;
+    const auto r = people::encode(7, as_bytes(alice), 99, 2.5, as_bytes(empty), -3);
+    ASSERT_EQ(r.size(), people::fixed_size + alice.size());
+    ASSERT_TRUE(people::validate(r));
+    EXPECT_EQ(people::get<"q">(r), 7u);
+    EXPECT_EQ(as_string(people::get<"name">(r)), alice);
+    EXPECT_EQ(people::get<"id">(r), 99u);
+    EXPECT_EQ(people::get<3>(r), 2.5);
+    EXPECT_TRUE(people::get<"tag">(r).empty());
+    EXPECT_EQ(people::get<"n">(r), -3);
+    const auto [q, name, id, x, tag, n] = people::decode(r);
+    EXPECT_EQ(q, 7u);
+    EXPECT_EQ(as_string(name), alice);
+    EXPECT_EQ(n, -3);
+
+    const yeni::schema d = people::dynamic();
+    ASSERT_EQ(d.fixed_size(), people::fixed_size);
+    for (std::size_t i = 0; i < d.size(); ++i)
+        EXPECT_EQ(d.offset(i), people::offsets[i]);
+    EXPECT_EQ(std::get<std::uint64_t>(d.get(r, 2)), 99u);
+    EXPECT_EQ(as_string(std::get<bytes>(d.get(r, 1))), alice);
+    std::vector<yeni::schema::value> values{
+        std::uint32_t(7), as_bytes(alice), std::uint64_t(99), 2.5, as_bytes(empty), std::int64_t(-3)};
+    EXPECT_EQ(d.encode(values), r);
+    values[0] = std::uint64_t(1);
+    EXPECT_THROW(d.encode(values), std::invalid_argument);
+}
+
+TEST(schema, rejects_bad_records_and_definitions)
+{
+    using column_type = yeni::segment_format::column_type;
+    EXPECT_THROW(yeni::schema({{"a", column_type::u32}, {"a", column_type::u64}}), std::invalid_argument);
+    const auto r = people::encode(7, as_bytes("alice"), 99, 2.5, as_bytes(""), -3);
+    auto bad = r;
+    bad[24] = std::byte(200); // the name's offset
+    EXPECT_FALSE(people::validate(bad));
+    EXPECT_FALSE(people::dynamic().validate(bad));
+    EXPECT_FALSE(people::validate(bytes(r).first(10)));
+}
+
+TEST(schema, comparisons_follow_field_order)
+{
+    const auto r = people::encode(7, as_bytes("alice"), 99, 2.5, as_bytes(""), -3);
+    const auto r2 = people::encode(7, as_bytes("alicf"), 1, 0, as_bytes(""), 0);
+    const auto r3 = people::encode(7, as_bytes("alic"), 1, 0, as_bytes(""), 0);
+    EXPECT_LT((people::compare<"q", "name">(r, r2)), 0);
+    EXPECT_GT(people::compare<"id">(r, r2), 0);
+    EXPECT_EQ(people::compare<"q">(r, r2), 0);
+    EXPECT_LT(people::compare<"name">(r3, r), 0);
+    const std::array<std::size_t, 2> keys{0, 1};
+    EXPECT_LT(people::dynamic().compare(r, r2, keys), 0);
+}
+
+TEST(schema, records_become_segment_columns)
+{
+    const yeni::test::scratch_dir dir("schema");
+    std::vector<std::vector<std::byte>> records;
+    std::vector<bytes> rows;
+    for (int i = 0; i < 1000; ++i)
+        records.push_back(people::encode(std::uint32_t(i), as_bytes("name" + std::to_string(i)), std::uint64_t(i) * 3,
+            i / 2.0, as_bytes(std::string(std::size_t(i % 7), 'z')), -i));
+    for (const auto& r : records)
+        rows.push_back(r);
+    for (const bool dynamic : {false, true}) {
+        {
+            yeni::segment_writer w(dir / "s.seg");
+            if (dynamic)
+                people::dynamic().add_columns(w, rows);
+            else
+                people::add_columns(w, rows);
+            w.finish();
+        }
+        const yeni::segment s = yeni::segment::open(dir / "s.seg");
+        const auto ids = s.column<std::uint64_t>("id");
+        const auto ns = s.column<std::int64_t>("n");
+        const auto qs = s.column<std::uint32_t>("q");
+        const auto names = s.binary("name");
+        for (std::size_t i = 0; i < 1000; ++i) {
+            ASSERT_EQ(ids[i], i * 3);
+            ASSERT_EQ(ns[i], -std::int64_t(i));
+            ASSERT_EQ(qs[i], i);
+            ASSERT_EQ(as_string(names[i]), "name" + std::to_string(i));
+        }
+    }
+}
+
+} // namespace
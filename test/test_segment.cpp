@@ -0,0 +1,149 @@
+#include "stress.hpp"
+
+#include "yeni/error.hpp"
+#include "yeni/io.hpp"
+#include "yeni/record_store.hpp"
+#include "yeni/segment.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::span<const std::byte> bytes_of(const std::string& s)
+{
+    return std::as_bytes(std::span(s.data(), s.size()));
+}
+
+std::string string_of(std::span<const std::byte> b)
+{
+    return {reinterpret_cast<const char*>(b.data()), b.size()};
+}
+
+// A store flushed with and without an io_context reopens as one row per
+// key, keys sorted, each with its newest value; find() and the key filter
+// agree with it.
+TEST(segment, store_round_trips_through_a_file)
+{
+    yeni::record_store store;
+    std::map<std::uint64_t, std::string> latest;
+    for (std::uint64_t i = 0; i < 5000; ++i) {
+        const std::uint64_t key = i * 7919 % 3001 * 3; // repeats, out of order
+        const std::string value = std::to_string(i) + std::string(i % 17, '.');
+        store.append(key, bytes_of(value));
+        latest[key] = value;
+    }
+    const yeni::test::scratch_dir dir("segment");
+    yeni::io_context io;
+    for (yeni::io_context* ctx : {static_cast<yeni::io_context*>(nullptr), &io}) {
+        const auto path = dir / (ctx ? "io.seg" : "plain.seg");
+        yeni::write_segment(path, store, ctx);
+        const auto s = yeni::segment::open(path);
+        EXPECT_EQ(s.file_size(), std::filesystem::file_size(path));
+        ASSERT_EQ(s.rows(), latest.size());
+        const auto keys = s.keys();
+        const auto values = s.binary(yeni::segment::value_column);
+        ASSERT_EQ(keys.size(), latest.size());
+        std::size_t row = 0;
+        for (const auto& [key, value] : latest) {
+            ASSERT_EQ(keys[row], key);
+            ASSERT_EQ(string_of(values[row]), value);
+            ASSERT_TRUE(s.key_filter().may_contain(key));
+            ASSERT_EQ(s.find(key), row);
+            ++row;
+        }
+        EXPECT_FALSE(s.find(1));
+        EXPECT_FALSE(s.find(3001 * 3));
+    }
+}
+
+template <class T>
+void expect_column(const yeni::segment& s, std::string_view name, const std::vector<T>& want)
+{
+    const auto got = s.column<T>(name);
+    ASSERT_TRUE(std::equal(got.begin(), got.end(), want.begin(), want.end())) << name;
+    std::vector<T> scanned;
+    s.scan<T>(name, [&](std::size_t first, std::span<const T> rows) {
+        EXPECT_EQ(first, scanned.size());
+        scanned.insert(scanned.end(), rows.begin(), rows.end());
+    });
+    EXPECT_EQ(scanned, want) << name;
+}
+
+// Every column type and an aux block read back as written, encoded or
+// not; asking for a column that is not there, or under another type,
+// is a format_error, as is a truncated file.
+TEST(segment, writer_columns_round_trip)
+{
+    constexpr std::size_t rows = 10000;
+    std::vector<std::uint32_t> small(rows);
+    std::vector<std::uint64_t> wide(rows);
+    std::vector<std::int64_t> signed_(rows);
+    std::vector<double> real(rows);
+    std::vector<std::string> names(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        small[i] = std::uint32_t(i % 100);
+        wide[i] = std::uint64_t(i) << 33 | i % 3;
+        signed_[i] = std::int64_t(i % 201) - 100;
+        real[i] = double(i) / 7;
+        names[i] = "name-" + std::to_string(i % 13);
+    }
+    const std::string aux = "opaque aux block";
+
+    const yeni::test::scratch_dir dir("segment");
+    for (const bool encode : {false, true}) {
+        SCOPED_TRACE(encode ? "encoded" : "plain");
+        const auto path = dir / (encode ? "encoded.seg" : "plain.seg");
+        {
+            yeni::codec_options codec;
+            codec.encode = encode;
+            codec.binary = encode ? yeni::column_encoding::lz4 : yeni::column_encoding::plain;
+            yeni::segment_writer w(path, nullptr, codec);
+            w.add_column<std::uint32_t>("small", small);
+            w.add_column<std::uint64_t>("wide", wide);
+            w.add_column<std::int64_t>("signed", signed_);
+            w.add_column<double>("real", real);
+            w.add_binary_column("name", rows, [&](std::size_t i) { return bytes_of(names[i]); });
+            w.add_block("aux", bytes_of(aux));
+            EXPECT_THROW(w.add_column<std::uint32_t>("short", std::span(small).first(rows - 1)),
+                std::invalid_argument);
+            EXPECT_THROW(w.add_block("aux", bytes_of(aux)), std::invalid_argument);
+            w.finish();
+        }
+        const auto s = yeni::segment::open(path);
+        EXPECT_EQ(s.rows(), rows);
+        expect_column(s, "small", small);
+        expect_column(s, "wide", wide);
+        expect_column(s, "signed", signed_);
+        expect_column(s, "real", real);
+        if (!encode) {
+            EXPECT_EQ(s.encoding("small"), yeni::column_encoding::plain);
+        } else {
+            EXPECT_NE(s.encoding("small"), yeni::column_encoding::plain);
+        }
+        const auto name = s.binary("name");
+        ASSERT_EQ(name.size(), rows);
+        for (std::size_t i = 0; i < rows; ++i)
+            ASSERT_EQ(string_of(name[i]), names[i]) << i;
+        EXPECT_EQ(string_of(s.block_data("aux")), aux);
+        EXPECT_TRUE(s.keys().empty());
+
+        EXPECT_THROW(s.column<std::uint64_t>("small"), yeni::format_error);
+        EXPECT_THROW(s.column<std::uint32_t>("missing"), yeni::format_error);
+        EXPECT_THROW(s.block_data("missing"), yeni::format_error);
+    }
+
+    const auto cut = dir / "cut.seg";
+    std::filesystem::copy_file(dir / "plain.seg", cut);
+    std::filesystem::resize_file(cut, std::filesystem::file_size(cut) - 8);
+    EXPECT_THROW(yeni::segment::open(cut), yeni::format_error);
+}
+
+} // namespace
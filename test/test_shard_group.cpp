@@ -0,0 +1,101 @@
+#include "stress.hpp"
+
+#include "yeni/shard_group.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Keys land on their own shard, whose store alone sees them, whichever
+// thread asks and however many ask at once.
+TEST(shard_group, keys_live_on_their_shard)
+{
+    yeni::shard_group group({.shards = 4, .pin = false});
+    ASSERT_EQ(group.size(), 4u);
+    EXPECT_EQ(group.current(), nullptr);
+    const unsigned threads = yeni::test::stress_threads();
+    constexpr std::uint64_t keys_per_thread = 2000;
+    yeni::test::run_threads(threads, [&](unsigned t) {
+        for (std::uint64_t i = 0; i < keys_per_thread; ++i) {
+            const std::uint64_t k = t * keys_per_thread + i;
+            group.append(k, std::as_bytes(std::span(&k, 1)));
+        }
+    });
+    for (std::uint64_t k = 0; k < threads * keys_per_thread; ++k) {
+        const yeni::record* r = group.find(k);
+        ASSERT_TRUE(r);
+        ASSERT_EQ(std::memcmp(r->value().data(), &k, sizeof(k)), 0);
+    }
+
+    std::atomic<std::size_t> total{0};
+    group.invoke_on_all([&](yeni::shard& s) {
+        ASSERT_EQ(group.current(), &s);
+        s.store().for_each([&](const yeni::record& r) { ASSERT_EQ(group.shard_of(r.key), s.id()); });
+        total += s.store().size();
+    });
+    EXPECT_EQ(total.load(), threads * keys_per_thread);
+}
+
+// Shards calling each other, directly and in chains, while outside
+// threads call them too: nothing deadlocks, every call returns its own
+// result, and exceptions come back to the caller.
+TEST(shard_group, shards_call_each_other)
+{
+    yeni::shard_group group({.shards = 3, .pin = false, .ring_capacity = 4});
+    const auto hop = [&](auto& self, unsigned from, unsigned depth, std::uint64_t v) -> std::uint64_t {
+        if (depth == 0)
+            return v;
+        return group.invoke_on((from + 1) % group.size(),
+            [&](yeni::shard& s) { return self(self, s.id(), depth - 1, v + s.id()); });
+    };
+    yeni::test::run_threads(yeni::test::stress_threads(), [&](unsigned t) {
+        yeni::test::for_duration([&] {
+            const unsigned start = t % group.size();
+            // Hops visit start+1, start+2, ... so the sum of ids is known.
+            std::uint64_t expected = t;
+            for (unsigned d = 1; d <= 7; ++d)
+                expected += (start + d) % group.size();
+            ASSERT_EQ(group.invoke_on(start, [&](yeni::shard& s) { return hop(hop, s.id(), 7, t); }), expected);
+        });
+    });
+    EXPECT_THROW(group.invoke_on(1,
+                     [&](yeni::shard&) {
+                         return group.invoke_on(2, [](yeni::shard&) -> int { throw std::runtime_error("x"); });
+                     }),
+        std::runtime_error);
+}
+
+// Messages posted without waiting keep their order from one sender and
+// all run before the group is gone.
+TEST(shard_group, posted_messages_run_in_order)
+{
+    struct note : yeni::shard_message {
+        std::vector<unsigned>* seen;
+        unsigned n;
+    };
+    std::vector<unsigned> seen;
+    std::vector<note> notes(1000);
+    {
+        yeni::shard_group group({.shards = 2, .pin = false, .ring_capacity = 8});
+        for (unsigned i = 0; i < notes.size(); ++i) {
+            notes[i].run = [](yeni::shard_message* m, yeni::shard&) noexcept {
+                auto* n = static_cast<note*>(m);
+                n->seen->push_back(n->n);
+            };
+            notes[i].seen = &seen;
+            notes[i].n = i;
+            group.post(1, notes[i]);
+        }
+    }
+    ASSERT_EQ(seen.size(), notes.size());
+    for (unsigned i = 0; i < seen.size(); ++i)
+        ASSERT_EQ(seen[i], i);
+}
+
+} // namespace
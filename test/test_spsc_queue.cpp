@@ -0,0 +1,68 @@
+#include "stress.hpp"
+
+#include "yeni/spsc_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+TEST(spsc_queue, fills_to_capacity_and_empties_in_order)
+{
+    yeni::spsc_queue<int> q(5);
+    ASSERT_EQ(q.capacity(), 8u);
+    EXPECT_TRUE(q.empty());
+    for (int i = 0; i < 8; ++i)
+        ASSERT_TRUE(q.try_push(i));
+    EXPECT_FALSE(q.try_push(8));
+    EXPECT_EQ(q.size_approx(), 8u);
+
+    int out[3];
+    ASSERT_EQ(q.try_pop_batch(out), 3u);
+    EXPECT_EQ(out[2], 2);
+    for (int i = 8; i < 11; ++i)
+        ASSERT_TRUE(q.try_push(i));
+    for (int i = 3; i < 11; ++i) {
+        int v = -1;
+        ASSERT_TRUE(q.try_pop(v));
+        ASSERT_EQ(v, i);
+    }
+    int v;
+    EXPECT_FALSE(q.try_pop(v));
+    EXPECT_TRUE(q.empty());
+}
+
+// A producer and a consumer racing around a small ring, in batches of
+// varying size: everything arrives once, in order.
+TEST(spsc_queue, concurrent_transfer_keeps_order)
+{
+    yeni::spsc_queue<std::uint64_t> q(64);
+    std::uint64_t produced = 0;
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+        yeni::test::for_duration([&] {
+            while (!q.try_push(std::uint64_t(produced)))
+                std::this_thread::yield();
+            ++produced;
+        });
+        done.store(true, std::memory_order_release);
+    });
+    std::uint64_t next = 0;
+    std::vector<std::uint64_t> out(1);
+    while (true) {
+        const bool finished = done.load(std::memory_order_acquire);
+        out.resize(1 + next % 50);
+        const std::size_t n = q.try_pop_batch(out);
+        for (std::size_t i = 0; i < n; ++i)
+            ASSERT_EQ(out[i], next++);
+        if (finished && n == 0)
+            break;
+    }
+    producer.join();
+    EXPECT_EQ(next, produced);
+}
+
+} // namespace
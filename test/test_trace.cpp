@@ -0,0 +1,187 @@
+#include "stress.hpp"
+
+#include "yeni/trace.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using yeni::trace::span_kind;
+
+// Events whose argument lies in [lo, hi), the test's own among whatever
+// other threads recorded.
+std::vector<yeni::trace::event> tagged(std::uint64_t lo, std::uint64_t hi)
+{
+    std::vector<yeni::trace::event> out;
+    for (const auto& e : yeni::trace::collect())
+        if (e.arg >= lo && e.arg < hi)
+            out.push_back(e);
+    return out;
+}
+
+// The outermost span decides for everything nested in it, including
+// spans measured after the fact; one operation in N is kept.
+TEST(trace, operations_are_sampled_with_their_nested_spans)
+{
+    if (!yeni::trace::enabled)
+        return; // nothing is recorded
+    constexpr std::uint64_t tag = 0x7e57000000;
+    yeni::trace::set_sample_every(1);
+    std::thread([&] {
+        const yeni::trace::span op(span_kind::lookup, tag);
+        EXPECT_TRUE(op.sampled());
+        {
+            yeni::trace::span probe(span_kind::index_probe);
+            probe.set_arg(tag + 1);
+            const yeni::trace::span decode(span_kind::decode, tag + 2);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        yeni::trace::record(span_kind::queue_wait, now - std::chrono::microseconds(5), std::chrono::microseconds(5),
+            tag + 3);
+    }).join();
+
+    const auto events = tagged(tag, tag + 4);
+    ASSERT_EQ(events.size(), 4u);
+    const yeni::trace::event* by_arg[4] = {};
+    for (const auto& e : events)
+        by_arg[e.arg - tag] = &e;
+    const auto& root = *by_arg[0];
+    EXPECT_EQ(root.kind, span_kind::lookup);
+    EXPECT_EQ(root.parent, 0u);
+    EXPECT_EQ(root.trace, root.id);
+    EXPECT_EQ(by_arg[1]->parent, root.id);
+    EXPECT_EQ(by_arg[2]->parent, by_arg[1]->id);
+    EXPECT_EQ(by_arg[3]->parent, root.id);
+    EXPECT_EQ(by_arg[3]->duration_ns, 5000u);
+    for (const auto* e : by_arg) {
+        EXPECT_EQ(e->trace, root.id);
+        EXPECT_EQ(e->thread, root.thread);
+    }
+    for (const auto* e : {by_arg[1], by_arg[2]}) {
+        EXPECT_GE(e->start_ns, root.start_ns);
+        EXPECT_LE(e->start_ns + e->duration_ns, root.start_ns + root.duration_ns);
+    }
+
+    yeni::trace::set_sample_every(4);
+    std::thread([&] {
+        for (std::uint64_t i = 0; i < 8; ++i) {
+            const yeni::trace::span op(span_kind::scan, tag + 100 + i);
+            const yeni::trace::span decode(span_kind::decode, tag + 200 + i);
+            EXPECT_EQ(decode.sampled(), op.sampled());
+        }
+    }).join();
+    EXPECT_EQ(tagged(tag + 100, tag + 108).size(), 2u);
+    EXPECT_EQ(tagged(tag + 200, tag + 208).size(), 2u);
+
+    yeni::trace::set_sample_every(0);
+    const yeni::trace::span off(span_kind::lookup, tag + 300);
+    EXPECT_FALSE(off.sampled());
+}
+
+// A ring keeps the newest ring_capacity events of its thread, and a
+// reader copying it while the thread keeps recording gets whole events
+// only.
+TEST(trace, rings_keep_the_newest_events)
+{
+    if (!yeni::trace::enabled)
+        return; // nothing is recorded
+    constexpr std::uint64_t tag = 0x7e58000000;
+    constexpr std::uint64_t spans = 3 * yeni::trace::ring_capacity + 100;
+    yeni::trace::set_sample_every(1);
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (std::uint64_t i = 0; i < spans; ++i) {
+            const yeni::trace::span s(span_kind::decode, tag + i);
+        }
+        done = true;
+    });
+    while (!done) {
+        std::uint64_t last = 0;
+        for (const auto& e : tagged(tag, tag + spans)) {
+            ASSERT_EQ(e.kind, span_kind::decode);
+            ASSERT_EQ(e.trace, e.id);
+            ASSERT_GT(e.arg, last);
+            last = e.arg;
+        }
+    }
+    writer.join();
+    yeni::trace::set_sample_every(0);
+
+    const auto events = tagged(tag, tag + spans);
+    ASSERT_EQ(events.size(), yeni::trace::ring_capacity);
+    EXPECT_EQ(events.front().arg, tag + spans - yeni::trace::ring_capacity);
+    EXPECT_EQ(events.back().arg, tag + spans - 1);
+}
+
+// The exports of a two-span trace, and folded stacks weighted by self
+// time.
+TEST(trace, exports_follow_the_trace_formats)
+{
+    std::vector<yeni::trace::event> events(2);
+    events[0] = {span_kind::lookup, 3, 1500, 1000, 1, 0, 1, 42};
+    events[1] = {span_kind::index_probe, 3, 1600, 300, 2, 1, 1, 1};
+
+    const std::string chrome = yeni::trace::chrome_trace(events);
+    EXPECT_EQ(chrome.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+    EXPECT_NE(chrome.find("\"name\":\"lookup\",\"cat\":\"yeni\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(chrome.find("\"tid\":3,\"ts\":1.500,\"dur\":1.000,\"args\":{\"arg\":42,"), std::string::npos);
+    EXPECT_NE(chrome.find("\"parent\":\"0000000000000001\""), std::string::npos);
+
+    const std::string otlp = yeni::trace::otlp_json(events);
+    EXPECT_EQ(otlp.find("{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\""), 0u);
+    EXPECT_NE(otlp.find("\"spanId\":\"0000000000000002\",\"parentSpanId\":\"0000000000000001\",\"name\":\"index_probe\""),
+        std::string::npos);
+    EXPECT_NE(otlp.find("0000000000000001\",\"spanId\":\"0000000000000001\",\"name\":\"lookup\""), std::string::npos);
+    // A valid trace id is 32 hex digits, not all zero.
+    const std::size_t id = otlp.find("\"traceId\":\"") + 11;
+    EXPECT_EQ(otlp.find('"', id), id + 32);
+    EXPECT_NE(otlp.substr(id, 16), std::string(16, '0'));
+
+    EXPECT_EQ(yeni::trace::folded_stacks(events), "lookup 700\nlookup;index_probe 300\n");
+    // Without its parent, the probe is a stack of its own.
+    EXPECT_EQ(yeni::trace::folded_stacks({events[1]}), "index_probe 300\n");
+}
+
+__attribute__((noinline)) int perf_map_probe(int x)
+{
+    return x * 3 + 1;
+}
+
+// The map lists functions of the executable at their mapped address, and
+// those of the library.
+TEST(trace, perf_map_resolves_loaded_code)
+{
+    const yeni::test::scratch_dir dir("trace_perf_map");
+    EXPECT_GT(yeni::trace::write_perf_map(dir / "perf.map"), 0u);
+    std::ifstream in(dir / "perf.map");
+    const auto probe = reinterpret_cast<std::uintptr_t>(&perf_map_probe);
+    bool found_probe = false, found_library = false;
+    for (std::string line; std::getline(in, line);) {
+        std::istringstream fields(line);
+        std::uintptr_t start = 0, size = 0;
+        std::string name;
+        fields >> std::hex >> start >> size;
+        std::getline(fields >> std::ws, name);
+        ASSERT_FALSE(name.empty()) << line;
+        if (name == "(anonymous namespace)::perf_map_probe(int)") {
+            found_probe = true;
+            EXPECT_LE(start, probe);
+            EXPECT_LT(probe, start + size);
+        }
+        found_library |= name == "yeni::trace::write_perf_map(std::filesystem::__cxx11::path const&)";
+    }
+    EXPECT_TRUE(found_probe);
+    EXPECT_TRUE(found_library);
+    EXPECT_EQ(perf_map_probe(1), 4);
+}
+
+} // namespace
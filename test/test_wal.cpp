@@ -0,0 +1,86 @@
+#include "stress.hpp"
+
+#include "yeni/wal.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct tag {
+    std::uint32_t thread;
+    std::uint32_t n;
+};
+
+// Concurrent appenders, sync and async, across segment rolls: replay
+// returns every record once, with consecutive LSNs, each thread's in the
+// order it appended them.
+TEST(wal, replay_returns_every_append_in_order)
+{
+    const yeni::test::scratch_dir dir("wal");
+    const unsigned threads = yeni::test::stress_threads();
+    std::vector<std::uint32_t> appended(threads);
+    std::uint64_t last = 0;
+    {
+        yeni::wal log(dir.path(), {.segment_size = 1 << 20, .max_batch_bytes = 16 << 10, .sync = false});
+        const auto deadline = std::chrono::steady_clock::now() + yeni::test::stress_duration();
+        yeni::test::run_threads(threads, [&](unsigned t) {
+            std::vector<std::byte> payload;
+            std::uint32_t n = 0;
+            for (; std::chrono::steady_clock::now() < deadline; ++n) {
+                payload.assign(sizeof(tag) + n % 300, std::byte(t));
+                const tag tg{t, n};
+                std::memcpy(payload.data(), &tg, sizeof(tg));
+                if (n % 3)
+                    log.append(payload);
+                else
+                    log.wait_durable(log.append_nowait(payload));
+            }
+            appended[t] = n;
+        });
+        last = log.next_lsn() - 1;
+        EXPECT_EQ(log.durable_lsn(), last);
+    }
+
+    std::vector<std::uint32_t> next(threads);
+    yeni::wal_reader reader(dir.path());
+    yeni::wal_entry e;
+    std::uint64_t lsn = 0;
+    while (reader.next(e)) {
+        ASSERT_EQ(e.lsn, ++lsn);
+        ASSERT_GE(e.payload.size(), sizeof(tag));
+        tag tg;
+        std::memcpy(&tg, e.payload.data(), sizeof(tg));
+        ASSERT_LT(tg.thread, threads);
+        ASSERT_EQ(tg.n, next[tg.thread]++);
+        ASSERT_EQ(e.payload.size(), sizeof(tag) + tg.n % 300);
+    }
+    EXPECT_EQ(lsn, last);
+    EXPECT_EQ(next, appended);
+}
+
+// Reopening continues after the last record, and the reader starts
+// wherever it is asked to.
+TEST(wal, reopen_continues_the_sequence)
+{
+    const yeni::test::scratch_dir dir("wal");
+    const std::vector<std::byte> payload(40, std::byte{7});
+    for (int round = 0; round < 3; ++round) {
+        yeni::wal log(dir.path(), {.segment_size = 64 << 10});
+        ASSERT_EQ(log.next_lsn(), std::uint64_t(round) * 1000 + 1);
+        for (int i = 0; i < 1000; ++i)
+            log.append_nowait(payload);
+    }
+    yeni::wal_reader reader(dir.path(), 1500);
+    yeni::wal_entry e;
+    std::uint64_t lsn = 1499;
+    while (reader.next(e))
+        ASSERT_EQ(e.lsn, ++lsn);
+    EXPECT_EQ(lsn, 3000u);
+}
+
+} // namespace
@@ -0,0 +1,71 @@
+#include "stress.hpp"
+
+#include "yeni/work_stealing_deque.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// The owner pushes bursts and pops some back while thieves steal, across
+// ring growth; every item must be taken exactly once.
+TEST(work_stealing_deque, every_item_is_taken_once)
+{
+    const unsigned thieves = yeni::test::stress_threads() - 1;
+    std::size_t rounds = 0;
+    yeni::test::for_duration([&] {
+        constexpr std::size_t items = 20000;
+        auto taken = std::make_unique<std::atomic<std::uint8_t>[]>(items);
+        std::vector<std::uint32_t> values(items);
+        yeni::work_stealing_deque<std::uint32_t*> dq(2);
+        std::atomic<bool> done{false};
+        const auto take = [&](std::uint32_t* p) { taken[std::size_t(p - values.data())].fetch_add(1); };
+
+        yeni::test::run_threads(thieves + 1, [&](unsigned t) {
+            if (t > 0) {
+                while (!done.load(std::memory_order_acquire) || !dq.empty()) {
+                    if (std::uint32_t* p = dq.steal())
+                        take(p);
+                }
+                return;
+            }
+            std::size_t next = 0;
+            while (next < items) {
+                const std::size_t burst = std::min<std::size_t>(items - next, 1 + next % 97);
+                for (std::size_t i = 0; i < burst; ++i)
+                    dq.push(&values[next++]);
+                for (std::size_t i = 0; i < burst / 2; ++i)
+                    if (std::uint32_t* p = dq.pop())
+                        take(p);
+            }
+            while (std::uint32_t* p = dq.pop())
+                take(p);
+            done.store(true, std::memory_order_release);
+        });
+
+        for (std::size_t i = 0; i < items; ++i)
+            ASSERT_EQ(taken[i].load(), 1) << "item " << i;
+        ++rounds;
+    });
+    RecordProperty("rounds", int(rounds));
+}
+
+// With no thieves the owner end is a plain stack.
+TEST(work_stealing_deque, owner_pops_in_lifo_order)
+{
+    yeni::work_stealing_deque<int*> dq(4);
+    std::vector<int> v(1000);
+    for (auto& x : v)
+        dq.push(&x);
+    for (std::size_t i = v.size(); i-- > 0;)
+        ASSERT_EQ(dq.pop(), &v[i]);
+    EXPECT_EQ(dq.pop(), nullptr);
+    EXPECT_EQ(dq.steal(), nullptr);
+}
+
+} // namespace